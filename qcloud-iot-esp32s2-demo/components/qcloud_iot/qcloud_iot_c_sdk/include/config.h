@@ -16,6 +16,7 @@
 /* #undef AT_OS_USED */
 /* #undef AT_DEBUG */
 //#define OTA_USE_HTTPS
+//#define MQTT_OFFLINE_QUEUE_ENABLED
 
 #ifdef GATEWAY_ENABLED
 #define MULTITHREAD_ENABLED
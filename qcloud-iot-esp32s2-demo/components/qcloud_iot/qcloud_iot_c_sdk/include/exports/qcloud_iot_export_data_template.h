@@ -106,13 +106,16 @@ typedef struct {
 	uint8_t 					auto_connect_enable;		// flag of auto reconnection, 1 is enable and recommended
 
     MQTTEventHandler            event_handle;             	// event callback
+
+    uint32_t                    tx_buf_size;                // size of MQTT Tx buffer, 0 for QCLOUD_IOT_MQTT_TX_BUF_LEN, otherwise at least 512
+    uint32_t                    rx_buf_size;                // size of MQTT Rx buffer, 0 for QCLOUD_IOT_MQTT_RX_BUF_LEN, otherwise at least 512
 	
 } TemplateInitParams;
 
 #ifdef AUTH_MODE_CERT
-    #define DEFAULT_TEMPLATE_INIT_PARAMS { NULL, NULL, NULL, NULL, 2000, 240 * 1000, 1, 1, {0}}
+    #define DEFAULT_TEMPLATE_INIT_PARAMS { NULL, NULL, NULL, NULL, 2000, 240 * 1000, 1, 1, {0}, 0, 0}
 #else
-    #define DEFAULT_TEMPLATE_INIT_PARAMS { NULL, NULL, NULL, 2000, 240 * 1000, 1, 1, {0}}
+    #define DEFAULT_TEMPLATE_INIT_PARAMS { NULL, NULL, NULL, 2000, 240 * 1000, 1, 1, {0}, 0, 0}
 #endif
 
 
@@ -278,7 +281,69 @@ int IOT_Template_UnRegister_Action(void *handle, DeviceAction *pAction);
  * @param pDeviceProperties         array of properties
  * @return              QCLOUD_RET_SUCCESS when success, or err code for failure
  */ 
-int IOT_Template_JSON_ConstructReportArray(void *handle, char *jsonBuffer, size_t sizeOfBuffer, uint8_t count, DeviceProperty *pDeviceProperties[]); 
+int IOT_Template_JSON_ConstructReportArray(void *handle, char *jsonBuffer, size_t sizeOfBuffer, uint8_t count, DeviceProperty *pDeviceProperties[]);
+
+/**
+ * @brief Create property store, which tracks changes of properties and picks the changed ones for report.
+ *        Property store is not locked, use it in the thread reporting properties
+ *
+ * @param max_count     max number of properties in store
+ * @return              handle to property store when success, or NULL otherwise
+ */
+void *IOT_Template_PropertyStore_Create(uint16_t max_count);
+
+/**
+ * @brief Destroy property store
+ *
+ * @param store         handle to property store
+ */
+void IOT_Template_PropertyStore_Destroy(void *store);
+
+/**
+ * @brief Add property into store, it would be reported at the first collect
+ *
+ * @param store             handle to property store
+ * @param pProperty         reference to device property, value is read from its data when collecting
+ * @param deadband          change of number property not larger than it is not reported, 0 for any change
+ * @param min_interval_ms   min interval between two reports of the property, 0 for no limit
+ * @return                  QCLOUD_RET_SUCCESS when success, or err code for failure
+ */
+int IOT_Template_PropertyStore_Add(void *store, DeviceProperty *pProperty, float deadband, uint32_t min_interval_ms);
+
+/**
+ * @brief Mark property to be reported at next collect, even if its change is within deadband
+ *
+ * @param store         handle to property store
+ * @param pProperty     reference to device property added
+ * @return              QCLOUD_RET_SUCCESS when success, or err code for failure
+ */
+int IOT_Template_PropertyStore_SetChanged(void *store, DeviceProperty *pProperty);
+
+/**
+ * @brief Mark all properties to be reported at next collect, for cycle report
+ *
+ * @param store         handle to property store
+ */
+void IOT_Template_PropertyStore_SetAllChanged(void *store);
+
+/**
+ * @brief Collect properties changed since last report, whose min report interval has passed.
+ *        Pass them to IOT_Template_JSON_ConstructReportArray, and call IOT_Template_PropertyStore_Reported
+ *        when report success, otherwise they are collected again next time
+ *
+ * @param store                 handle to property store
+ * @param pDeviceProperties     array to store the properties collected
+ * @param max_count             size of array
+ * @return                      number of properties collected, or err code (<0) for failure
+ */
+int IOT_Template_PropertyStore_Collect(void *store, DeviceProperty *pDeviceProperties[], uint8_t max_count);
+
+/**
+ * @brief Take values of properties from last collect as reported, and clear their changed state
+ *
+ * @param store         handle to property store
+ */
+void IOT_Template_PropertyStore_Reported(void *store);
 
 
 /**
@@ -294,6 +359,63 @@ int IOT_Template_JSON_ConstructReportArray(void *handle, char *jsonBuffer, size_
  */ 
 int IOT_Template_Report(void *handle, char *pJsonDoc, size_t sizeOfBuffer, OnReplyCallback callback, void *userContext, uint32_t timeout_ms);
 
+/**
+ * @brief Parameters of report scheduler
+ */
+typedef struct {
+    uint32_t            window_ms;          // changes within the window are merged into one report
+    uint16_t            rate_per_min;       // max reports per minute in the long run, refill rate of token bucket
+    uint16_t            burst;              // max reports sent back to back, capacity of token bucket
+    uint16_t            max_properties;     // max number of properties waiting for report
+    uint16_t            buffer_size;        // size of JSON buffer for report
+    uint32_t            timeout_ms;         // timeout value of report reply
+    OnReplyCallback     callback;           // callback when report reply arrives
+    void                *user_context;      // user data for callback
+} ReportSchedParams;
+
+#define DEFAULT_REPORT_SCHED_PARAMS { 500, 60, 5, 16, 1024, 5000, NULL, NULL }
+
+/**
+ * @brief Statistics of report scheduler
+ */
+typedef struct {
+    uint16_t            queue_depth;        // number of properties waiting for report
+    uint32_t            merged;             // changes merged into a property already waiting
+    uint32_t            dropped;            // changes dropped as the queue is full or report can't be built
+    uint32_t            throttled;          // times a report is delayed by rate limit
+    uint32_t            reports;            // number of reports sent
+} ReportSchedStats;
+
+/**
+ * @brief Init report scheduler of data_template client. Scheduled reports are sent in IOT_Template_Yield
+ *        or IOT_Template_Yield_Without_MQTT_Yield
+ *
+ * @param pClient           handle to data_template client
+ * @param pParams           parameters of report scheduler
+ * @return                  QCLOUD_RET_SUCCESS when success, or err code for failure
+ */
+int IOT_Template_ReportSched_Init(void *handle, ReportSchedParams *pParams);
+
+/**
+ * @brief Schedule properties for report. Properties changed within the window are merged into one report,
+ *        and their values are read when the report is sent, so the last value wins
+ *
+ * @param pClient           handle to data_template client
+ * @param count             number of properties
+ * @param pDeviceProperties array of properties
+ * @return                  QCLOUD_RET_SUCCESS when success, or QCLOUD_ERR_MAX_APPENDING_REQUEST when some are dropped
+ */
+int IOT_Template_Report_Schedule(void *handle, uint8_t count, DeviceProperty *pDeviceProperties[]);
+
+/**
+ * @brief Get statistics of report scheduler
+ *
+ * @param pClient           handle to data_template client
+ * @param pStats            statistics output
+ * @return                  QCLOUD_RET_SUCCESS when success, or err code for failure
+ */
+int IOT_Template_ReportSched_GetStats(void *handle, ReportSchedStats *pStats);
+
 /**
  * @brief report data_template data in synchronized way
  *
@@ -527,6 +649,46 @@ int IOT_Post_Event(void *pClient, char *pJsonDoc, size_t sizeOfBuffer, uint8_t e
  */
 int IOT_Post_Event_Raw(void *pClient, char *pJsonDoc, size_t sizeOfBuffer, char *pEventMsg, OnEventReplyCallback replyCb);            
 
+/**
+ * @brief Parameters of event queue
+ */
+typedef struct {
+    uint16_t                buffer_size;    // size of buffer for the events queued, and for the batch being delivered
+    uint8_t                 max_events;     // post the events queued when so many events are queued
+    uint32_t                max_age_ms;     // post the events queued when the first one is queued so long
+    OnEventReplyCallback    reply_cb;       // callback when reply of a batch arrives
+} EventQueueParams;
+
+#define DEFAULT_EVENT_QUEUE_PARAMS { 2048, 10, 1000, NULL }
+
+/**
+ * @brief Init event queue of data_template client. Events queued are posted as one events_post message
+ *        in IOT_Template_Yield or IOT_Template_Yield_Without_MQTT_Yield. A batch is kept until its reply arrives,
+ *        and sent again if the reply times out, one batch at a time
+ *
+ * @param pClient	  handle to data_template client
+ * @param pParams	  parameters of event queue
+ * @return @see IoT_Error_Code
+ */
+int IOT_Event_Queue_Init(void *pClient, EventQueueParams *pParams);
+
+/**
+ * @brief Put event into queue. Event is written into queue at once, so its data can be reused after return.
+ *        Set timestamp of event when it occurs, as it may be posted much later
+ *
+ * @param pClient	  handle to data_template client
+ * @param pEvent	  event to post
+ * @return QCLOUD_RET_SUCCESS when success, QCLOUD_ERR_BUF_TOO_SHORT when queue is full, or other err code
+ */
+int IOT_Event_Queue_Push(void *pClient, sEvent *pEvent);
+
+/**
+ * @brief Post the events queued at next yield, whatever the size and age thresholds
+ *
+ * @param pClient	  handle to data_template client
+ */
+void IOT_Event_Queue_Flush(void *pClient);
+
 #endif
 
 #ifdef ACTION_ENABLED
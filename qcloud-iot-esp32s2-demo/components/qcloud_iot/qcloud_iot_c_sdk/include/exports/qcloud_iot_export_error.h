@@ -70,6 +70,10 @@ typedef enum {
     QCLOUD_ERR_BUF_TOO_SHORT                                 = -119,    // MQTT recv buffer not enough
     QCLOUD_ERR_MQTT_QOS_NOT_SUPPORT                          = -120,    // MQTT QoS level not supported
     QCLOUD_ERR_MQTT_UNSUB_FAIL                               = -121,    // MQTT unsubscribe failed
+    QCLOUD_ERR_MQTT_INFLIGHT_FULL                            = -122,    // MQTT publishes waiting for PUBACK out of range
+    QCLOUD_ERR_MQTT_TX_QUEUE_FULL                            = -123,    // MQTT packets waiting for writer task out of range
+    QCLOUD_ERR_MQTT_DEFERRED_FULL                            = -124,    // MQTT deferred publishes waiting for yield out of range
+    QCLOUD_ERR_MQTT_OFFLINE_PENDING                          = -126,    // MQTT publish with callback refused until offline queue is replayed
 
     QCLOUD_ERR_JSON_PARSE                                    = -132,    // JSON parsing error
     QCLOUD_ERR_JSON_BUFFER_TRUNCATED                         = -133,    // JSON buffer truncated
@@ -37,6 +37,10 @@ typedef enum _QoS {
 
 /**
  * @brief MQTT message parameter for pub/sub
+ *
+ * For a received message, ptopic and payload point into the receive buffer of MQTT client
+ * and are only valid inside the callback. ptopic is NOT null terminated, use topic_len.
+ * payload is null terminated so it can be parsed in place.
  */
 typedef struct {
     QoS         			qos;          // MQTT QoS level
@@ -102,6 +106,9 @@ typedef enum {
     /* MQTT unsubscribe */
     MQTT_EVENT_UNSUBSCRIBE = 14,
 
+    /* MQTT publish not sent, e.g. deferred publish could not be sent in time */
+    MQTT_EVENT_PUBLISH_FAIL = 15,
+
 } MQTTEventType;
 
 /**
@@ -109,11 +116,34 @@ typedef enum {
  */
 typedef void (*OnMessageHandler)(void *pClient, MQTTMessage *message, void *pUserData);
 
+/**
+ * @brief Define MQTT SUBSCRIBE callback to receive message payload chunk by chunk
+ *
+ * Payload of a large message is delivered in order through the receive buffer of MQTT client,
+ * so messages larger than QCLOUD_IOT_MQTT_RX_BUF_LEN can be received.
+ * message->payload and message->payload_len are the current chunk, and the chunk is null terminated.
+ *
+ * @param offset     offset of this chunk in payload
+ * @param total_len  length of the whole payload
+ */
+typedef void (*OnMessageChunkHandler)(void *pClient, MQTTMessage *message, size_t offset, size_t total_len,
+                                      void *pUserData);
+
 /**
  * @brief Define MQTT SUBSCRIBE callback when event happened
  */
 typedef void (*OnSubEventHandler)(void *pClient, MQTTEventType event_type, void *pUserData);
 
+/**
+ * @brief Define MQTT async publish callback when publish is completed
+ *
+ * result is MQTT_EVENT_PUBLISH_SUCCESS when PUBACK arrived (or QoS0 packet was sent),
+ * MQTT_EVENT_PUBLISH_TIMEOUT when PUBACK not arrived within command timeout,
+ * MQTT_EVENT_CLIENT_DESTROY when client is destroyed before PUBACK arrived,
+ * MQTT_EVENT_PUBLISH_FAIL (packet id 0) when deferred publish failed to be sent
+ */
+typedef void (*OnPublishCompleteHandler)(void *pClient, uint16_t packet_id, MQTTEventType result, void *pUserData);
+
 /**
  * @brief Define structure to do MQTT subscription
  */
@@ -122,12 +152,15 @@ typedef struct {
     OnMessageHandler        on_message_handler;     // callback when message arrived 
     OnSubEventHandler       on_sub_event_handler;   // callback when event happened
     void                    *user_data;             // user context for callback
+    OnMessageChunkHandler   on_message_chunk_handler;   // optional, callback for payload chunks of message
+                                                    // larger than receive buffer, or of every message
+                                                    // if on_message_handler is NULL
 } SubscribeParams;
 
 /**
  * Default MQTT subscription parameters
  */
-#define DEFAULT_SUB_PARAMS {QOS0, NULL, NULL, NULL}
+#define DEFAULT_SUB_PARAMS {QOS0, NULL, NULL, NULL, NULL}
 
 
 typedef struct {
@@ -177,15 +210,22 @@ typedef struct {
 
     MQTTEventHandler            event_handle;               // event callback
 
+    uint16_t                    max_inflight;               // max QoS1 publishes waiting for PUBACK, 0 for QCLOUD_IOT_MQTT_MAX_INFLIGHT
+
+    uint32_t                    tx_buf_size;                // size of Tx buffer allocated for this client, 0 for QCLOUD_IOT_MQTT_TX_BUF_LEN,
+                                                            // otherwise at least 512
+    uint32_t                    rx_buf_size;                // size of Rx buffer allocated for this client, 0 for QCLOUD_IOT_MQTT_RX_BUF_LEN,
+                                                            // otherwise at least 512
+
 } MQTTInitParams;
 
 /**
  * Default MQTT init parameters
  */
 #ifdef AUTH_MODE_CERT
-	#define DEFAULT_MQTTINIT_PARAMS { NULL, NULL, NULL, NULL, 5000, 240 * 1000, 1, 1, {0}}
+	#define DEFAULT_MQTTINIT_PARAMS { NULL, NULL, NULL, NULL, 5000, 240 * 1000, 1, 1, {0}, 0, 0, 0}
 #else
-    #define DEFAULT_MQTTINIT_PARAMS { NULL, NULL, NULL, 5000, 240 * 1000, 1, 1, {0}}
+    #define DEFAULT_MQTTINIT_PARAMS { NULL, NULL, NULL, 5000, 240 * 1000, 1, 1, {0}, 0, 0, 0}
 #endif
 
 /**
@@ -200,6 +240,9 @@ void* IOT_MQTT_Construct(MQTTInitParams *pParams);
 /**
  * @brief Close connection and destroy MQTT client
  *
+ * If the reader or writer task does not stop in time, QCLOUD_ERR_FAILURE is returned and the client is
+ * not destroyed, the call can be made again later.
+ *
  * @param pClient    pointer of handle to MQTT client
  *
  * @return QCLOUD_RET_SUCCESS for success, or err code for failure
@@ -216,6 +259,129 @@ int IOT_MQTT_Destroy(void **pClient);
  */
 int IOT_MQTT_Yield(void *pClient, uint32_t timeout_ms);
 
+/**
+ * @brief Get socket fd of MQTT client, for readiness notification (select/poll/epoll) of user event loop
+ *
+ * When the fd is readable, call IOT_MQTT_ProcessReadable; call IOT_MQTT_ProcessTimers periodically
+ * (at least every 100ms or so) no matter the fd is readable or not. Together they replace IOT_MQTT_Yield.
+ *
+ * @param pClient    handle to MQTT client
+ *
+ * @return fd (>=0), or -1 if not connected or not supported by network type (AT/UDP)
+ */
+int IOT_MQTT_GetFd(void *pClient);
+
+/**
+ * @brief Read and handle MQTT packets already arrived, without blocking for network
+ *
+ * @param pClient    handle to MQTT client
+ *
+ * @return QCLOUD_RET_SUCCESS when success, QCLOUD_ERR_MQTT_ATTEMPTING_RECONNECT when try reconnecing, or err code for failure
+ */
+int IOT_MQTT_ProcessReadable(void *pClient);
+
+/**
+ * @brief Handle reconnect, ACK timeout and keep alive, without reading network
+ *
+ * @param pClient    handle to MQTT client
+ *
+ * @return QCLOUD_RET_SUCCESS when success, QCLOUD_ERR_MQTT_ATTEMPTING_RECONNECT when try reconnecing, or err code for failure
+ */
+int IOT_MQTT_ProcessTimers(void *pClient);
+
+/* IOT_MQTT_YieldMulti handles timers of clients not readable at this interval */
+#define MQTT_YIELD_MULTI_TIMERS_INTERVAL_MS     100
+
+/**
+ * @brief Create the context of IOT_MQTT_YieldMulti, which keeps the sockets of clients registered between calls
+ *
+ * @param max_clients max number of clients served by one IOT_MQTT_YieldMulti call
+ *
+ * @return handle of the context, or NULL for failure
+ */
+void *IOT_MQTT_YieldMulti_Construct(int max_clients);
+
+/**
+ * @brief Destroy the context of IOT_MQTT_YieldMulti, the clients are not touched
+ *
+ * @param pYield     handle of the context
+ */
+void IOT_MQTT_YieldMulti_Destroy(void *pYield);
+
+/**
+ * @brief Serve several MQTT clients in one thread: wait until any of them is readable, then process
+ *
+ * Clients whose fd is not available (disconnected, AT/UDP) are only served by IOT_MQTT_ProcessTimers.
+ * A readable client has its timers handled right after the read, the others every
+ * MQTT_YIELD_MULTI_TIMERS_INTERVAL_MS. Clients may be added, removed or reordered between calls, a client is best kept at the same index.
+ *
+ * @param pYield     handle of the context from IOT_MQTT_YieldMulti_Construct
+ * @param clients    handles to MQTT client, no more than max_clients of the context
+ * @param count      number of clients
+ * @param timeout_ms max time (unit: ms) to wait for network
+ *
+ * @return QCLOUD_RET_SUCCESS when success, or the first err code of clients (reconnecting is not considered as error)
+ */
+int IOT_MQTT_YieldMulti(void *pYield, void *clients[], int count, uint32_t timeout_ms);
+
+#ifdef MULTITHREAD_ENABLED
+/**
+ * @brief Start dual-task mode: a writer task is created to own network writing
+ *
+ * The thread calling IOT_MQTT_Yield then only reads and dispatches inbound packets. Publish, subscribe
+ * and the ACKs of inbound packets are serialized and queued (no more than MQTT_TX_QUEUE_MAX_BYTES)
+ * without waiting for network, so a slow write does not block reading and vice versa.
+ * Return value of publish means the packet is queued, not sent. A packet larger than MQTT_TX_QUEUE_MAX_BYTES
+ * is written by the calling thread once the packets queued ahead of it are written.
+ *
+ * @param pClient    handle to MQTT client
+ * @param priority   priority of writer task
+ *
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int IOT_MQTT_StartTxTask(void *pClient, int priority);
+
+/**
+ * @brief Stop writer task and go back to write in calling thread, packets queued are written before it returns
+ *
+ * It is called by IOT_MQTT_Destroy. No other thread should use the client during the call.
+ * The task finishes the packet it is writing and returns. If it does not return in time, QCLOUD_ERR_FAILURE
+ * is returned and packets are written in place after it, the call can be made again later.
+ *
+ * @param pClient    handle to MQTT client
+ *
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int IOT_MQTT_StopTxTask(void *pClient);
+
+/**
+ * @brief Start a reader task calling IOT_MQTT_Yield for the client, message handlers and callbacks run on it
+ *
+ * With IOT_MQTT_StartTxTask as well, the reader task deframes and dispatches inbound packets while the writer
+ * task drains outbound ones, and publishing threads never wait for the socket. IOT_MQTT_Yield must not
+ * be called by the application while the reader task is running.
+ *
+ * @param pClient    handle to MQTT client
+ * @param priority   priority of reader task
+ *
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int IOT_MQTT_StartRxTask(void *pClient, int priority);
+
+/**
+ * @brief Stop reader task after the yield in progress returns
+ *
+ * It is called by IOT_MQTT_Destroy. Do not call it from message handlers or callbacks, which run on the task.
+ * If the task does not return in time, QCLOUD_ERR_FAILURE is returned and the task is left to finish,
+ * the call can be made again later.
+ *
+ * @param pClient    handle to MQTT client
+ *
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int IOT_MQTT_StopRxTask(void *pClient);
+#endif
+
 /**
  * @brief Publish MQTT message
  *
@@ -223,10 +389,58 @@ int IOT_MQTT_Yield(void *pClient, uint32_t timeout_ms);
  * @param topicName     MQTT topic name
  * @param pParams       publish parameters
  *
+ * With MQTT_OFFLINE_QUEUE_ENABLED, QoS1 message is stored while offline (or while earlier stored ones are
+ * not replayed yet) and 0 is returned, it is published in order after connected, maybe more than once.
+ *
  * @return packet id (>=0) when success, or err code (<0) for failure
  */
 int IOT_MQTT_Publish(void *pClient, char *topicName, PublishParams *pParams);
 
+/**
+ * @brief Publish MQTT message and get notified by callback when it is completed
+ *
+ * Up to max_inflight QoS1 messages can wait for PUBACK at the same time, so messages
+ * can be published one after another without waiting for PUBACK of the previous one.
+ * on_complete is called from IOT_MQTT_Yield (or IOT_MQTT_Destroy), and is called
+ * before return for QoS0 message.
+ * With MQTT_OFFLINE_QUEUE_ENABLED, a QoS1 message with on_complete is not stored in the offline queue:
+ * it is refused while records stored offline are not replayed yet, so it could not overtake them.
+ *
+ * @param pClient       handle to MQTT client
+ * @param topicName     MQTT topic name
+ * @param pParams       publish parameters
+ * @param on_complete   callback when publish is completed, can be NULL
+ * @param user_data     user context for on_complete
+ *
+ * @return packet id (>=0) when success, QCLOUD_ERR_MQTT_INFLIGHT_FULL when inflight window is full,
+ *         QCLOUD_ERR_MQTT_OFFLINE_PENDING when offline queue is being replayed,
+ *         or other err code (<0) for failure. on_complete is NOT called on failure
+ */
+int IOT_MQTT_PublishAsync(void *pClient, char *topicName, PublishParams *pParams,
+                          OnPublishCompleteHandler on_complete, void *user_data);
+
+/**
+ * @brief Publish MQTT message from a task which could not wait for network or locks, e.g. sensor task
+ *
+ * The publish is pushed into a lock-free ring (QCLOUD_IOT_MQTT_DEFERRED_PUB_LEN) and published in order
+ * by the next IOT_MQTT_Yield, no more than QCLOUD_IOT_MQTT_DEFERRED_PUB_BATCH each time.
+ * topicName and payload are NOT copied, they must be kept until on_complete is called (static buffers
+ * if on_complete is NULL). on_complete is called from yield context as IOT_MQTT_PublishAsync, or with
+ * MQTT_EVENT_PUBLISH_FAIL and packet id 0 if publish failed to be sent: at once for an error which would
+ * not clear, or when no inflight room, connection or end of offline replay was found for it within command timeout.
+ *
+ * @param pClient       handle to MQTT client
+ * @param topicName     MQTT topic name
+ * @param pParams       publish parameters
+ * @param on_complete   callback when publish is completed, can be NULL
+ * @param user_data     user context for on_complete
+ *
+ * @return QCLOUD_RET_SUCCESS when pushed, QCLOUD_ERR_MQTT_DEFERRED_FULL when ring is full,
+ *         or other err code (<0) for failure. Never blocks
+ */
+int IOT_MQTT_PublishDeferred(void *pClient, char *topicName, PublishParams *pParams,
+                             OnPublishCompleteHandler on_complete, void *user_data);
+
 /**
  * @brief Subscribe MQTT topic
  *
@@ -256,6 +470,61 @@ int IOT_MQTT_Unsubscribe(void *pClient, char *topicFilter);
  */
 bool IOT_MQTT_IsConnected(void *pClient);
 
+/* number of buckets of PUBACK latency histogram, bucket 0 counts latency < 1ms, bucket i counts [2^(i-1), 2^i) ms */
+#define MQTT_STATS_LATENCY_BUCKETS      (16)
+
+/**
+ * @brief Define MQTT client statistics, counted since client is created or stats are reset
+ */
+typedef struct {
+    uint32_t    elapsed_ms;                 // time since statistics started
+
+    uint32_t    pub_count;                  // publish packets sent
+    uint32_t    pub_bytes;                  // bytes of publish packets sent, including headers
+
+    uint32_t    puback_count;               // QoS1 publishes acknowledged
+    uint32_t    puback_timeout;             // QoS1 publishes not acknowledged in command timeout
+    uint32_t    puback_latency_max_ms;      // max time from publish sent to PUBACK arrived
+    uint32_t    puback_latency_p50_ms;      // median latency, upper bound of histogram bucket
+    uint32_t    puback_latency_p99_ms;      // 99th percentile latency, upper bound of histogram bucket
+    uint32_t    puback_latency_hist[MQTT_STATS_LATENCY_BUCKETS];
+
+    uint32_t    recv_count;                 // publish packets received
+    uint32_t    recv_bytes;                 // payload bytes of publish packets received
+    uint32_t    dispatch_time_ms;           // total time spent in message handlers
+
+    uint32_t    reconnect_count;            // successful reconnections
+    uint32_t    reconnect_last_ms;          // time from disconnection to reconnected, of the last reconnection
+    uint32_t    reconnect_max_ms;           // max time from disconnection to reconnected
+} MQTTStats;
+
+/**
+ * @brief Get statistics of MQTT client, for throughput and latency measurement
+ *
+ * @param pClient       handle to MQTT client
+ * @param stats         statistics output, percentiles are calculated from histogram
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int IOT_MQTT_GetStats(void *pClient, MQTTStats *stats);
+
+/**
+ * @brief Reset statistics of MQTT client and start counting again
+ *
+ * @param pClient       handle to MQTT client
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int IOT_MQTT_ResetStats(void *pClient);
+
+/**
+ * @brief Format statistics as JSON object, with msgs/sec and bytes per message derived from counters
+ *
+ * @param stats         statistics got by IOT_MQTT_GetStats
+ * @param buf           buffer of JSON string
+ * @param buf_len       size of buffer
+ * @return length of JSON string, or err code (<0) for failure
+ */
+int IOT_MQTT_StatsToJson(const MQTTStats *stats, char *buf, size_t buf_len);
+
 /**
  * @brief Get error code of last IOT_MQTT_Construct operation
  *
@@ -86,6 +86,35 @@ int 			LITE_get_boolean(bool *value, char *src);
 int 			LITE_get_string(int8_t        *value, char *src, uint16_t max_len);
 
 
+/* value of JSON in source string, not copied and not '\0' terminated, quotes of string are excluded */
+typedef struct _json_span_t {
+    const char     *str;
+    int             len;
+    int             type;   /* enum JSONTYPE */
+} json_span_t;
+
+int             LITE_json_span_of(const char *key, const char *src, json_span_t *span);
+int             LITE_json_span_at(const char *key, const char *src, int src_len, json_span_t *span);
+
+/*
+ * Conversions take the whole span or fail, unlike LITE_get_xxx which parse a leading number only.
+ * Integers accept a float form of integral value ("1.0", "1e2" is 100), fractions like "1.5"
+ * are rejected instead of truncated. LITE_span_get_string fails with QCLOUD_ERR_JSON_BUFFER_TOO_SMALL
+ * if value and '\0' do not fit in size, as a truncated token, method or secret is never valid.
+ */
+int             LITE_span_get_int32(int32_t *value, const json_span_t *span);
+int             LITE_span_get_int16(int16_t *value, const json_span_t *span);
+int             LITE_span_get_int8(int8_t *value, const json_span_t *span);
+int             LITE_span_get_uint32(uint32_t *value, const json_span_t *span);
+int             LITE_span_get_uint16(uint16_t *value, const json_span_t *span);
+int             LITE_span_get_uint8(uint8_t *value, const json_span_t *span);
+int             LITE_span_get_float(float *value, const json_span_t *span);
+int             LITE_span_get_double(double *value, const json_span_t *span);
+int             LITE_span_get_boolean(bool *value, const json_span_t *span);
+int             LITE_span_get_string(char *value, size_t size, const json_span_t *span);
+bool            LITE_span_equal(const json_span_t *span, const char *str);
+
+
 typedef struct _json_key_t {
     char           *key;
     list_head_t     list;
@@ -33,6 +33,50 @@
 /* default MQTT Rx buffer size, MAX: 16*1024 */
 #define QCLOUD_IOT_MQTT_RX_BUF_LEN                                  (2048)
 
+/* default MQTT Rx stream buffer size, network data is read into it in bulk and then deframed */
+#define QCLOUD_IOT_MQTT_RX_STREAM_BUF_LEN                           (512)
+
+/* default max number of MQTT QoS1 publishes waiting for PUBACK */
+#define QCLOUD_IOT_MQTT_MAX_INFLIGHT                                (32)
+
+/* default size of buffer to keep copies of MQTT publishes waiting for PUBACK */
+#define QCLOUD_IOT_MQTT_INFLIGHT_BUF_LEN                            (4 * QCLOUD_IOT_MQTT_TX_BUF_LEN)
+
+/* directory of MQTT offline queue files, the partition (SPIFFS/FATFS) must be mounted by app */
+#ifndef MQTT_OFFLINE_QUEUE_DIR
+#define MQTT_OFFLINE_QUEUE_DIR                                      "/spiffs"
+#endif
+
+/* max size of one MQTT offline queue segment file */
+#define MQTT_OFFLINE_SEGMENT_SIZE                                   (16 * 1024)
+
+/* max number of MQTT offline queue segment files, the oldest one is dropped when exceeded */
+#define MQTT_OFFLINE_MAX_SEGMENTS                                   (8)
+
+/* max number of publishes replayed from MQTT offline queue waiting for PUBACK */
+#define MQTT_OFFLINE_REPLAY_WINDOW                                  (8)
+
+/* max number of MQTT publishes pushed by IOT_MQTT_PublishDeferred and not published yet, power of 2 */
+#define QCLOUD_IOT_MQTT_DEFERRED_PUB_LEN                            (16)
+
+/* max number of deferred MQTT publishes published by one yield */
+#define QCLOUD_IOT_MQTT_DEFERRED_PUB_BATCH                          (8)
+
+/* max bytes of MQTT packets queued for writer task in dual-task mode */
+#define MQTT_TX_QUEUE_MAX_BYTES                                     (8 * 1024)
+
+/* stack size of MQTT writer task in dual-task mode, TLS write needs a deep stack */
+#define MQTT_TX_TASK_STACK_SIZE                                     (4096)
+
+/* stack size of MQTT reader task, message handlers run on it */
+#define MQTT_RX_TASK_STACK_SIZE                                     (4096)
+
+/* timeout (unit: ms) of each yield of MQTT reader task, also the time to notice it is stopped */
+#define MQTT_RX_TASK_YIELD_MS                                       (200)
+
+/* max number of JSON tokens of one data template message, 12 bytes each, 2 token arrays per template client */
+#define QCLOUD_IOT_TEMPLATE_MAX_JSON_TOKENS                         (128)
+
 /* default COAP Tx buffer size, MAX: 1*1024 */
 #define COAP_SENDMSG_MAX_BUFLEN                                     (512)
 
@@ -65,6 +65,17 @@ void * HAL_ThreadCreate(uint16_t stack_size, int priority, char * taskname,void
  */
 int HAL_ThreadDestroy(void *thread_t);
 
+/**
+ * @brief Wait for a thread/task to return from its function, and release its handle
+ *
+ * On timeout the thread is left running and its handle stays valid, it can be joined again later.
+ *
+ * @param thread_t      thread handle
+ * @param timeout_ms    time to wait for the thread to return
+ * @return QCLOUD_RET_SUCCESS for success, or QCLOUD_ERR_FAILURE if not returned in time
+ */
+int HAL_ThreadJoin(void *thread_t, uint32_t timeout_ms);
+
 /**
  * @brief create semaphore
  *
@@ -175,9 +186,18 @@ int HAL_Snprintf(_IN_ char *str, const int len, const char *fmt, ...);
 int HAL_Vsnprintf(_OU_ char *str, _IN_ const int len, _IN_ const char *fmt, _IN_ va_list ap);
 
 /**
- * @brief Get timestamp in millisecond
+ * @brief Get monotonic time in millisecond, not affected by wall clock adjustment
  *
- * @return   timestamp in millisecond
+ * @return   milliseconds since an arbitrary point such as system boot, never wraps
+ */
+uint64_t HAL_GetTimeMs64(void);
+
+/**
+ * @brief Get monotonic time in millisecond, low 32 bits of HAL_GetTimeMs64
+ *
+ * It wraps every 49.7 days, so compare two values by their unsigned difference.
+ *
+ * @return   time in millisecond
  */
 uint32_t HAL_GetTimeMs(void);
 
@@ -230,16 +250,85 @@ int HAL_GetGwDevInfo(void *pgwDeviceInfo);
  */
 int HAL_SetDevInfoFile(const char *file_name);
 
+/**
+ * @brief Open a file
+ *
+ * @param filename  path of file
+ * @param mode      open mode, same as fopen, e.g. "rb", "ab"
+ * @return          file handle, or NULL for failure
+ */
+void *HAL_FileOpen(const char *filename, const char *mode);
+
+/**
+ * @brief Read data from file
+ *
+ * @param ptr       destination buffer
+ * @param size      size of each element
+ * @param nmemb     number of elements
+ * @param fp        file handle
+ * @return          number of elements read
+ */
+size_t HAL_FileRead(void *ptr, size_t size, size_t nmemb, void *fp);
+
+/**
+ * @brief Write data to file
+ *
+ * @param ptr       source buffer
+ * @param size      size of each element
+ * @param nmemb     number of elements
+ * @param fp        file handle
+ * @return          number of elements written
+ */
+size_t HAL_FileWrite(const void *ptr, size_t size, size_t nmemb, void *fp);
+
+/**
+ * @brief Set position of file
+ *
+ * @param fp        file handle
+ * @param offset    offset from origin
+ * @param origin    SEEK_SET, SEEK_CUR or SEEK_END
+ * @return          0 for success, or non-zero for failure
+ */
+int HAL_FileSeek(void *fp, long int offset, int origin);
+
+/**
+ * @brief Get position of file
+ *
+ * @param fp        file handle
+ * @return          current position, or -1 for failure
+ */
+long HAL_FileTell(void *fp);
+
+/**
+ * @brief Flush written data of file to storage
+ *
+ * @param fp        file handle
+ * @return          0 for success, or non-zero for failure
+ */
+int HAL_FileFlush(void *fp);
+
+/**
+ * @brief Close file
+ *
+ * @param fp        file handle
+ * @return          0 for success, or non-zero for failure
+ */
+int HAL_FileClose(void *fp);
+
+/**
+ * @brief Remove file
+ *
+ * @param filename  path of file
+ * @return          0 for success, or non-zero for failure
+ */
+int HAL_FileRemove(const char *filename);
+
 
 /**
  * Define timer structure, platform dependant
  */
 struct Timer {
-#if defined(__linux__) && defined(__GLIBC__)
-	struct timeval end_time;
-#else
-	uintptr_t end_time;
-#endif
+    uint64_t end_time;      /* deadline on the clock of HAL_GetTimeMs64 */
 };
 
 typedef struct Timer Timer;
@@ -311,6 +400,18 @@ int HAL_AT_Uart_Recv(void *data, uint32_t expect_size, uint32_t *recv_size, uint
 #endif
 
 
+/**
+ * @brief Define a segment of data for vectored write
+ */
+typedef struct {
+    const unsigned char *data;
+    size_t              len;
+} NetIoVec;
+
+/* max number of segments for one vectored write */
+#define NET_IOV_MAX     (4)
+
+
 /********** TLS/DTLS network sturcture and operations **********/
 
 #ifndef AUTH_WITH_NOTLS
@@ -375,6 +476,19 @@ void HAL_TLS_Disconnect(uintptr_t handle);
 int HAL_TLS_Write(uintptr_t handle, unsigned char *data, size_t totalLen, uint32_t timeout_ms,
                                  size_t *written_len);
 
+/**
+ * @brief Write several segments of data via TLS connection, in order
+ *
+ * @param handle        TLS connect handle
+ * @param iov           segments to write
+ * @param iovcnt        number of segments, no more than NET_IOV_MAX
+ * @param timeout_ms    timeout value in millisecond
+ * @param written_len   total length of data written successfully
+ * @return              QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int HAL_TLS_Writev(uintptr_t handle, const NetIoVec *iov, int iovcnt, uint32_t timeout_ms,
+                   size_t *written_len);
+
 /**
  * @brief Read data via TLS connection
  *
@@ -388,6 +502,40 @@ int HAL_TLS_Write(uintptr_t handle, unsigned char *data, size_t totalLen, uint32
 int HAL_TLS_Read(uintptr_t handle, unsigned char *data, size_t totalLen, uint32_t timeout_ms,
                                 size_t *read_len);
 
+/**
+ * @brief Read whatever data is available via TLS connection
+ *
+ * Wait up to timeout_ms for the first bytes, then return as soon as the
+ * decrypted data already pending in the TLS layer has been drained
+ *
+ * @param handle        TLS connect handle
+ * @param data          destination data buffer where to put data
+ * @param totalLen      size of destination buffer
+ * @param timeout_ms    timeout value in millisecond
+ * @param read_len      length of data read successfully
+ * @return              QCLOUD_RET_SUCCESS if any data is read, or err code for failure
+ */
+int HAL_TLS_ReadSome(uintptr_t handle, unsigned char *data, size_t totalLen, uint32_t timeout_ms,
+                                size_t *read_len);
+
+/**
+ * @brief Get socket descriptor of TLS connection, to wait for it readable
+ *
+ * @param handle        TLS connect handle
+ * @return              socket descriptor, or -1 if not available
+ */
+int HAL_TLS_GetFd(uintptr_t handle);
+
+/**
+ * @brief Check if decrypted data is pending in TLS layer
+ *
+ * The socket may not be readable while such data is pending, so it should be read without waiting
+ *
+ * @param handle        TLS connect handle
+ * @return              true if data is pending
+ */
+bool HAL_TLS_HasPending(uintptr_t handle);
+
 /********** DTLS network **********/
 #ifdef COAP_COMM_ENABLED
 typedef SSLConnectParams DTLSConnectParams;
@@ -469,6 +617,19 @@ int HAL_TCP_Disconnect(uintptr_t fd);
 int HAL_TCP_Write(uintptr_t fd, const unsigned char *data, uint32_t len, uint32_t timeout_ms,
                 size_t *written_len);
 
+/**
+ * @brief Write several segments of data via TCP connection, in order
+ *
+ * @param fd            TCP socket handle
+ * @param iov           segments to write
+ * @param iovcnt        number of segments, no more than NET_IOV_MAX
+ * @param timeout_ms    timeout value in millisecond
+ * @param written_len   total length of data written successfully
+ * @return              QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int HAL_TCP_Writev(uintptr_t fd, const NetIoVec *iov, int iovcnt, uint32_t timeout_ms,
+                size_t *written_len);
+
 /**
  * @brief Read data via TCP connection
  *
@@ -482,6 +643,61 @@ int HAL_TCP_Write(uintptr_t fd, const unsigned char *data, uint32_t len, uint32_
 int HAL_TCP_Read(uintptr_t fd, unsigned char *data, uint32_t len, uint32_t timeout_ms,
                 size_t *read_len);
 
+/**
+ * @brief Read whatever data is available via TCP connection
+ *
+ * Wait up to timeout_ms for the socket to become readable, then do one recv
+ *
+ * @param fd            TCP socket handle
+ * @param data          destination data buffer where to put data
+ * @param len           size of destination buffer
+ * @param timeout_ms    timeout value in millisecond
+ * @param read_len      length of data read successfully
+ * @return              QCLOUD_RET_SUCCESS if any data is read, or err code for failure
+ */
+int HAL_TCP_ReadSome(uintptr_t fd, unsigned char *data, uint32_t len, uint32_t timeout_ms,
+                size_t *read_len);
+
+/**
+ * @brief Get socket descriptor of TCP connection, to wait for it readable
+ *
+ * @param fd            TCP socket handle
+ * @return              socket descriptor, or -1 if not available
+ */
+int HAL_TCP_GetFd(uintptr_t fd);
+
+/**
+ * @brief Create a set of sockets to wait on, which keeps its sockets registered between waits
+ *
+ * @param max_fds       max number of sockets in one wait
+ * @return              handle of the set, or NULL for failure
+ */
+void *HAL_Net_WaitSetCreate(int max_fds);
+
+/**
+ * @brief Destroy a set created by HAL_Net_WaitSetCreate, the sockets are not closed
+ *
+ * @param set           handle of the set
+ */
+void HAL_Net_WaitSetDestroy(void *set);
+
+/**
+ * @brief Wait until any of the sockets is readable
+ *
+ * Socket i is kept in slot i of the set. A slot is registered again when its descriptor differs from
+ * the last wait, or when changed[i] is set because the socket was closed and its descriptor reused.
+ *
+ * @param set           handle of the set
+ * @param fds           socket descriptors got by HAL_TCP_GetFd/HAL_TLS_GetFd, negative ones are skipped
+ * @param changed       1 for a socket connected since the last wait, even with the same descriptor
+ * @param readable      output, 1 for readable socket and 0 for the others
+ * @param count         number of sockets, no more than max_fds of the set
+ * @param timeout_ms    timeout value in millisecond
+ * @return              number of readable sockets, 0 for timeout, or err code (<0) for failure
+ */
+int HAL_Net_WaitReadable(void *set, const int *fds, const uint8_t *changed, uint8_t *readable, int count,
+                         uint32_t timeout_ms);
+
 /********** UDP network **********/
 #ifdef COAP_COMM_ENABLED
 /**
@@ -0,0 +1,60 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdio.h>
+
+#include "qcloud_iot_import.h"
+
+/* files are accessed through stdio of ESP-IDF VFS, so the partition (SPIFFS/FATFS) must be mounted by app */
+
+void *HAL_FileOpen(const char *filename, const char *mode)
+{
+    return (void *)fopen(filename, mode);
+}
+
+size_t HAL_FileRead(void *ptr, size_t size, size_t nmemb, void *fp)
+{
+    return fread(ptr, size, nmemb, (FILE *)fp);
+}
+
+size_t HAL_FileWrite(const void *ptr, size_t size, size_t nmemb, void *fp)
+{
+    return fwrite(ptr, size, nmemb, (FILE *)fp);
+}
+
+int HAL_FileSeek(void *fp, long int offset, int origin)
+{
+    return fseek((FILE *)fp, offset, origin);
+}
+
+long HAL_FileTell(void *fp)
+{
+    return ftell((FILE *)fp);
+}
+
+int HAL_FileFlush(void *fp)
+{
+    return fflush((FILE *)fp);
+}
+
+int HAL_FileClose(void *fp)
+{
+    return fclose((FILE *)fp);
+}
+
+int HAL_FileRemove(const char *filename)
+{
+    return remove(filename);
+}
@@ -145,16 +145,53 @@ void HAL_MutexUnlock(_IN_ void *mutex)
     }
 }
 
+/* a task must not return, so the function runs in a wrapper which reports it returned and deletes the task */
+typedef struct {
+    void *(*fn)(void *);
+    void                *arg;
+    TaskHandle_t        task;
+    SemaphoreHandle_t   done;               /* given once fn returned */
+} FreeRTOSThread;
+
+static void _thread_entry(void *param)
+{
+    FreeRTOSThread *thread = (FreeRTOSThread *)param;
+
+    thread->fn(thread->arg);
+
+    /* the handle may be freed by HAL_ThreadJoin from now on */
+    xSemaphoreGive(thread->done);
+    vTaskDelete(NULL);
+}
+
 void * HAL_ThreadCreate(uint16_t stack_size, int priority, char * taskname, void *(*fn)(void*), void* arg)
 {
 #define DEFAULT_STACK_SIZE 1024
-    TaskHandle_t threadId;
+    FreeRTOSThread *thread;
     uint16_t stacksize;
 
+    thread = (FreeRTOSThread *)HAL_Malloc(sizeof(FreeRTOSThread));
+    if (NULL == thread) {
+        return NULL;
+    }
+
+    thread->fn = fn;
+    thread->arg = arg;
+    thread->done = xSemaphoreCreateBinary();
+    if (NULL == thread->done) {
+        HAL_Free(thread);
+        return NULL;
+    }
+
     stacksize = (stack_size == 0) ? DEFAULT_STACK_SIZE : stack_size;
-    xTaskCreate(fn, taskname, stacksize, arg, priority, &threadId);
+    if (xTaskCreate(_thread_entry, taskname, stacksize, thread, priority, &thread->task) != pdPASS) {
+        HAL_Printf("%s: create task %s failed\n", __FUNCTION__, taskname);
+        vSemaphoreDelete(thread->done);
+        HAL_Free(thread);
+        return NULL;
+    }
 
-    return (void *)threadId;
+    return (void *)thread;
 
 #undef  DEFAULT_STACK_SIZE
 
@@ -162,12 +199,37 @@ void * HAL_ThreadCreate(uint16_t stack_size, int priority, char * taskname, void
 
 int HAL_ThreadDestroy(void* threadId)
 {
+    FreeRTOSThread *thread = (FreeRTOSThread *)threadId;
+
+    if (NULL == thread) {
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    /* a task whose function returned deletes itself */
+    if (xSemaphoreTake(thread->done, 0) != pdTRUE) {
+        vTaskDelete(thread->task);
+    }
+
+    vSemaphoreDelete(thread->done);
+    HAL_Free(thread);
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+int HAL_ThreadJoin(void *threadId, uint32_t timeout_ms)
+{
+    FreeRTOSThread *thread = (FreeRTOSThread *)threadId;
+
+    if (NULL == thread) {
+        return QCLOUD_ERR_FAILURE;
+    }
 
-    if (NULL == threadId) {
+    if (xSemaphoreTake(thread->done, timeout_ms / portTICK_PERIOD_MS) != pdTRUE) {
         return QCLOUD_ERR_FAILURE;
     }
 
-    vTaskDelete( (TaskHandle_t) threadId );
+    vSemaphoreDelete(thread->done);
+    HAL_Free(thread);
 
     return QCLOUD_RET_SUCCESS;
 }
@@ -242,4 +304,38 @@ int HAL_SemaphoreWait(void *sem, uint32_t timeout_ms)
     return osSemaphoreWait ((osSemaphoreId)sem, timeout_ms);
 
 }
+#else
+
+void *HAL_SemaphoreCreate(void)
+{
+#define SEMAPHORE_MAX_COUNT 0xFFFF
+    SemaphoreHandle_t sem = xSemaphoreCreateCounting(SEMAPHORE_MAX_COUNT, 0);
+    if (NULL == sem) {
+        HAL_Printf("%s: xSemaphoreCreateCounting failed\n", __FUNCTION__);
+        return NULL;
+    }
+
+    return sem;
+#undef  SEMAPHORE_MAX_COUNT
+}
+
+void HAL_SemaphoreDestroy(void *sem)
+{
+    vSemaphoreDelete(sem);
+}
+
+void HAL_SemaphorePost(void *sem)
+{
+    /* fails only if the count is saturated, waiter is awake anyway */
+    xSemaphoreGive(sem);
+}
+
+int HAL_SemaphoreWait(void *sem, uint32_t timeout_ms)
+{
+    if (xSemaphoreTake(sem, timeout_ms / portTICK_PERIOD_MS) != pdTRUE) {
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    return QCLOUD_RET_SUCCESS;
+}
 #endif
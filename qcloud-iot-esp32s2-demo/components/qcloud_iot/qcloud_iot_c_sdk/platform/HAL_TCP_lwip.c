@@ -101,13 +101,13 @@ int HAL_TCP_Disconnect(uintptr_t fd)
 
     fd -= LWIP_SOCKET_FD_SHIFT;
 
-    /* Shutdown both send and receive operations. */
+    /* Shutdown both send and receive operations, fails with ENOTCONN once the peer reset the link. */
     rc = shutdown((int) fd, 2);
-    if (0 != rc) {
+    if (0 != rc && ENOTCONN != errno) {
         Log_e("shutdown error: %s", strerror(errno));
-        return -1;
     }
 
+    /* the socket is closed either way, or its fd leaks at every link drop */
     rc = close((int) fd);
     if (0 != rc) {
         Log_e("closesocket error: %s", strerror(errno));
@@ -194,6 +194,98 @@ int HAL_TCP_Write(uintptr_t fd, const unsigned char *buf, uint32_t len, uint32_t
 }
 
 
+int HAL_TCP_Writev(uintptr_t fd, const NetIoVec *iov, int iovcnt, uint32_t timeout_ms, size_t *written_len)
+{
+    int ret, i, cnt;
+    size_t len, len_sent, skip;
+    uint32_t t_end, t_left;
+    fd_set sets;
+    struct iovec vec[NET_IOV_MAX];
+
+    *written_len = 0;
+    if (iovcnt <= 0 || iovcnt > NET_IOV_MAX) {
+        return QCLOUD_ERR_INVAL;
+    }
+
+    for (i = 0, len = 0; i < iovcnt; i++) {
+        len += iov[i].len;
+    }
+
+    fd -= LWIP_SOCKET_FD_SHIFT;
+
+    t_end = HAL_GetTimeMs() + timeout_ms;
+    len_sent = 0;
+    ret = 1; /* send one time if timeout_ms is value 0 */
+
+    do {
+        t_left = _time_left(t_end, HAL_GetTimeMs());
+
+        if (0 != t_left) {
+            struct timeval timeout;
+
+            FD_ZERO(&sets);
+            FD_SET(fd, &sets);
+
+            timeout.tv_sec = t_left / 1000;
+            timeout.tv_usec = (t_left % 1000) * 1000;
+
+            ret = select(fd + 1, NULL, &sets, NULL, &timeout);
+            if (0 == ret) {
+                ret = QCLOUD_ERR_TCP_WRITE_TIMEOUT;
+                Log_e("select-write timeout %d", (int)fd);
+                break;
+            } else if (ret < 0) {
+                if (EINTR == errno) {
+                    Log_e("EINTR be caught");
+                    continue;
+                }
+
+                ret = QCLOUD_ERR_TCP_WRITE_FAIL;
+                Log_e("select-write fail: %s", strerror(errno));
+                break;
+            }
+        } else {
+            ret = QCLOUD_ERR_TCP_WRITE_TIMEOUT;
+        }
+
+        if (ret > 0) {
+            /* segments not sent yet, the first one may be partly sent */
+            skip = len_sent;
+            for (i = 0, cnt = 0; i < iovcnt; i++) {
+                if (skip >= iov[i].len) {
+                    skip -= iov[i].len;
+                    continue;
+                }
+                vec[cnt].iov_base = (void *)(iov[i].data + skip);
+                vec[cnt].iov_len = iov[i].len - skip;
+                skip = 0;
+                cnt++;
+            }
+
+            ret = writev(fd, vec, cnt);
+            if (ret > 0) {
+                len_sent += ret;
+            } else if (0 == ret) {
+                Log_e("No data be sent. Should NOT arrive");
+            } else {
+                if (EINTR == errno) {
+                    Log_e("EINTR be caught");
+                    continue;
+                }
+
+                ret = QCLOUD_ERR_TCP_WRITE_FAIL;
+                Log_e("writev fail: %s", strerror(errno));
+                break;
+            }
+        }
+    } while ((len_sent < len) && (_time_left(t_end, HAL_GetTimeMs()) > 0));
+
+    *written_len = len_sent;
+
+    return len_sent > 0 ? QCLOUD_RET_SUCCESS : ret;
+}
+
+
 int HAL_TCP_Read(uintptr_t fd, unsigned char *buf, uint32_t len, uint32_t timeout_ms, size_t *read_len)
 {
     int ret, err_code;
@@ -267,3 +359,130 @@ int HAL_TCP_Read(uintptr_t fd, unsigned char *buf, uint32_t len, uint32_t timeou
 
     return (len == len_recv) ? QCLOUD_RET_SUCCESS : err_code;
 }
+
+
+int HAL_TCP_ReadSome(uintptr_t fd, unsigned char *buf, uint32_t len, uint32_t timeout_ms, size_t *read_len)
+{
+    int ret;
+    fd_set sets;
+    struct timeval timeout;
+
+    fd -= LWIP_SOCKET_FD_SHIFT;
+    *read_len = 0;
+
+    do {
+        FD_ZERO(&sets);
+        FD_SET(fd, &sets);
+
+        timeout.tv_sec = timeout_ms / 1000;
+        timeout.tv_usec = (timeout_ms % 1000) * 1000;
+
+        ret = select(fd + 1, &sets, NULL, NULL, &timeout);
+        if (0 == ret) {
+            return QCLOUD_ERR_TCP_NOTHING_TO_READ;
+        } else if (ret < 0) {
+            if (EINTR == errno) {
+                Log_e("EINTR be caught");
+                continue;
+            }
+            Log_e("select-recv error: %s", strerror(errno));
+            return QCLOUD_ERR_TCP_READ_FAIL;
+        }
+
+        ret = recv(fd, buf, len, 0);
+        if (ret > 0) {
+            *read_len = (size_t)ret;
+            return QCLOUD_RET_SUCCESS;
+        } else if (0 == ret) {
+            Log_e("connection is closed by server");
+            return QCLOUD_ERR_TCP_PEER_SHUTDOWN;
+        } else {
+            if (EINTR == errno) {
+                Log_e("EINTR be caught");
+                continue;
+            }
+            Log_e("recv error: %s", strerror(errno));
+            return QCLOUD_ERR_TCP_READ_FAIL;
+        }
+    } while (1);
+}
+
+int HAL_TCP_GetFd(uintptr_t fd)
+{
+    return (int)fd - LWIP_SOCKET_FD_SHIFT;
+}
+
+/* select keeps nothing between waits, the set only bounds the number of sockets */
+typedef struct {
+    int max_fds;
+} NetWaitSet;
+
+void *HAL_Net_WaitSetCreate(int max_fds)
+{
+    NetWaitSet *set;
+
+    if (max_fds <= 0) {
+        return NULL;
+    }
+
+    set = (NetWaitSet *)HAL_Malloc(sizeof(NetWaitSet));
+    if (NULL == set) {
+        Log_e("malloc wait set failed");
+        return NULL;
+    }
+    set->max_fds = max_fds;
+
+    return set;
+}
+
+void HAL_Net_WaitSetDestroy(void *set)
+{
+    HAL_Free(set);
+}
+
+int HAL_Net_WaitReadable(void *set, const int *fds, const uint8_t *changed, uint8_t *readable, int count,
+                         uint32_t timeout_ms)
+{
+    int i, ret;
+    int max_fd = -1;
+    fd_set sets;
+    struct timeval timeout;
+
+    if (NULL == set || count < 0 || count > ((NetWaitSet *)set)->max_fds) {
+        return QCLOUD_ERR_INVAL;
+    }
+
+    FD_ZERO(&sets);
+    for (i = 0; i < count; i++) {
+        readable[i] = 0;
+        if (fds[i] >= 0) {
+            FD_SET(fds[i], &sets);
+            max_fd = Max(max_fd, fds[i]);
+        }
+    }
+
+    if (max_fd < 0) {
+        HAL_SleepMs(timeout_ms);
+        return 0;
+    }
+
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_usec = (timeout_ms % 1000) * 1000;
+
+    ret = select(max_fd + 1, &sets, NULL, NULL, &timeout);
+    if (ret < 0) {
+        if (EINTR == errno) {
+            return 0;
+        }
+        Log_e("select error: %s", strerror(errno));
+        return QCLOUD_ERR_TCP_READ_FAIL;
+    }
+
+    for (i = 0; i < count && ret > 0; i++) {
+        if (fds[i] >= 0 && FD_ISSET(fds[i], &sets)) {
+            readable[i] = 1;
+        }
+    }
+
+    return ret;
+}
@@ -362,6 +362,36 @@ int HAL_TLS_Write(uintptr_t handle, unsigned char *msg, size_t totalLen, uint32_
     return QCLOUD_RET_SUCCESS;
 }
 
+int HAL_TLS_Writev(uintptr_t handle, const NetIoVec *iov, int iovcnt, uint32_t timeout_ms,
+                   size_t *written_len)
+{
+    Timer timer;
+    InitTimer(&timer);
+    countdown_ms(&timer, (unsigned int) timeout_ms);
+    size_t len;
+    int i, rc;
+
+    *written_len = 0;
+    if (iovcnt <= 0 || iovcnt > NET_IOV_MAX) {
+        return QCLOUD_ERR_INVAL;
+    }
+
+    /* mbedtls has no vectored write, segments are written one after another into the TLS stream */
+    for (i = 0; i < iovcnt; i++) {
+        if (0 == iov[i].len) {
+            continue;
+        }
+
+        rc = HAL_TLS_Write(handle, (unsigned char *)iov[i].data, iov[i].len, left_ms(&timer), &len);
+        *written_len += len;
+        if (QCLOUD_RET_SUCCESS != rc) {
+            return rc;
+        }
+    }
+
+    return QCLOUD_RET_SUCCESS;
+}
+
 int HAL_TLS_Read(uintptr_t handle, unsigned char *msg, size_t totalLen, uint32_t timeout_ms, size_t *read_len)
 {
 
@@ -403,6 +433,58 @@ int HAL_TLS_Read(uintptr_t handle, unsigned char *msg, size_t totalLen, uint32_t
     }
 }
 
+int HAL_TLS_ReadSome(uintptr_t handle, unsigned char *msg, size_t totalLen, uint32_t timeout_ms, size_t *read_len)
+{
+    Timer timer;
+    InitTimer(&timer);
+    countdown_ms(&timer, (unsigned int) timeout_ms);
+    *read_len = 0;
+
+    TLSDataParams *pParams = (TLSDataParams *)handle;
+
+    do {
+        int read_rc = mbedtls_ssl_read(&(pParams->ssl), msg + *read_len, totalLen - *read_len);
+
+        if (read_rc > 0) {
+            *read_len += read_rc;
+            /* keep draining records which are already buffered in mbedtls, they won't block */
+            if (*read_len < totalLen && mbedtls_ssl_check_pending(&(pParams->ssl))) {
+                continue;
+            }
+            break;
+        } else if (read_rc == 0 || (read_rc != MBEDTLS_ERR_SSL_WANT_WRITE
+                                    && read_rc != MBEDTLS_ERR_SSL_WANT_READ && read_rc != MBEDTLS_ERR_SSL_TIMEOUT)) {
+            Log_e("cloud_iot_network_tls_read failed: 0x%04x", read_rc < 0 ? -read_rc : read_rc);
+            return QCLOUD_ERR_SSL_READ;
+        }
+
+        if (*read_len > 0) {
+            break;
+        }
+    } while (!expired(&timer));
+
+    if (*read_len == 0) {
+        return QCLOUD_ERR_SSL_NOTHING_TO_READ;
+    }
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+int HAL_TLS_GetFd(uintptr_t handle)
+{
+    TLSDataParams *pParams = (TLSDataParams *)handle;
+
+    return pParams->socket_fd.fd;
+}
+
+bool HAL_TLS_HasPending(uintptr_t handle)
+{
+    TLSDataParams *pParams = (TLSDataParams *)handle;
+
+    /* records received but not decrypted yet, or decrypted but not read yet */
+    return mbedtls_ssl_check_pending(&(pParams->ssl)) || mbedtls_ssl_get_bytes_avail(&(pParams->ssl)) > 0;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -21,9 +21,16 @@ extern "C" {
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
+#include <limits.h>
 #include "qcloud_iot_import.h"
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/* PLATFORM_TIME_FROM_TICKS drops time functions, as the host tests of tick wrap do */
+#ifndef PLATFORM_TIME_FROM_TICKS
 #define PLATFORM_HAS_TIME_FUNCS
+#endif
 //#define PLATFORM_HAS_CMSIS
 
 #ifdef PLATFORM_HAS_TIME_FUNCS
@@ -39,23 +46,58 @@ extern "C" {
 
 static char now_time_str[20] = {0};
 
+#if !defined(PLATFORM_HAS_TIME_FUNCS) || !defined(CLOCK_MONOTONIC)
+/* extend 32-bit tick counter to 64 bits, it should be read at least once in each wrap period */
+static uint64_t _extend_tick_count(uint32_t now)
+{
+    static uint32_t last_tick = 0;
+    static uint32_t wrap_count = 0;
+    uint64_t ticks;
+
+    vTaskSuspendAll();
+    if (now < last_tick) {
+        wrap_count++;
+    }
+    last_tick = now;
+    ticks = ((uint64_t)wrap_count << 32) | now;
+    xTaskResumeAll();
+
+    return ticks;
+}
+#endif
 
-uint32_t HAL_GetTimeMs(void)
+uint64_t HAL_GetTimeMs64(void)
 {
-#if defined PLATFORM_HAS_TIME_FUNCS
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+#if defined(PLATFORM_HAS_TIME_FUNCS) && defined(CLOCK_MONOTONIC)
+    /* monotonic clock is not stepped by SNTP or settimeofday */
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
 
 #elif defined PLATFORM_HAS_CMSIS
-    return HAL_GetTick();
+    return _extend_tick_count(HAL_GetTick());
+
+#else
+    return _extend_tick_count((uint32_t)xTaskGetTickCount()) * portTICK_PERIOD_MS;
 #endif
 }
 
+uint32_t HAL_GetTimeMs(void)
+{
+    return (uint32_t)HAL_GetTimeMs64();
+}
+
 /*Get timestamp*/
 long HAL_Timer_current_sec(void)
 {
-    return HAL_GetTimeMs() / 1000;
+#if defined PLATFORM_HAS_TIME_FUNCS
+    /* wall clock, for timestamps sent to server */
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec;
+#else
+    return (long)(HAL_GetTimeMs64() / 1000);
+#endif
 }
 
 char* HAL_Timer_current(void)
@@ -78,29 +120,28 @@ char* HAL_Timer_current(void)
 
 bool HAL_Timer_expired(Timer *timer)
 {
-    uint32_t now_ts;
-
-    now_ts  = HAL_GetTimeMs();
-
-
-    return (now_ts > timer->end_time) ? true : false;
+    return (HAL_GetTimeMs64() >= timer->end_time) ? true : false;
 }
 
 void HAL_Timer_countdown_ms(Timer *timer, unsigned int timeout_ms)
 {
-    timer->end_time = HAL_GetTimeMs();
-    timer->end_time += timeout_ms;
+    timer->end_time = HAL_GetTimeMs64() + timeout_ms;
 }
 
 void HAL_Timer_countdown(Timer *timer, unsigned int timeout)
 {
-    timer->end_time = HAL_GetTimeMs();
-    timer->end_time += timeout * 1000;
+    timer->end_time = HAL_GetTimeMs64() + (uint64_t)timeout * 1000;
 }
 
 int HAL_Timer_remain(Timer *timer)
 {
-    return (int)(timer->end_time - HAL_GetTimeMs());
+    uint64_t now = HAL_GetTimeMs64();
+
+    if (now >= timer->end_time) {
+        return 0;
+    }
+
+    return (timer->end_time - now > INT_MAX) ? INT_MAX : (int)(timer->end_time - now);
 }
 
 void HAL_Timer_init(Timer *timer)
@@ -0,0 +1,241 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "qcloud_iot_import.h"
+#include "qcloud_iot_export.h"
+
+/* POSIX port, used for host builds and tests */
+
+void HAL_SleepMs(_IN_ uint32_t ms)
+{
+    usleep(1000 * ms);
+}
+
+void HAL_DelayMs(_IN_ uint32_t ms)
+{
+    usleep(1000 * ms);
+}
+
+void HAL_Printf(_IN_ const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+
+    fflush(stdout);
+}
+
+int HAL_Snprintf(_IN_ char *str, const int len, const char *fmt, ...)
+{
+    va_list args;
+    int rc;
+
+    va_start(args, fmt);
+    rc = vsnprintf(str, len, fmt, args);
+    va_end(args);
+
+    return rc;
+}
+
+int HAL_Vsnprintf(_IN_ char *str, _IN_ const int len, _IN_ const char *format, va_list ap)
+{
+    return vsnprintf(str, len, format, ap);
+}
+
+void *HAL_Malloc(_IN_ uint32_t size)
+{
+    return malloc(size);
+}
+
+void HAL_Free(_IN_ void *ptr)
+{
+    free(ptr);
+}
+
+void *HAL_MutexCreate(void)
+{
+    int err_num;
+    pthread_mutex_t *mutex = (pthread_mutex_t *)HAL_Malloc(sizeof(pthread_mutex_t));
+    if (NULL == mutex) {
+        return NULL;
+    }
+
+    if (0 != (err_num = pthread_mutex_init(mutex, NULL))) {
+        HAL_Printf("%s: create mutex failed: %s\n", __FUNCTION__, strerror(err_num));
+        HAL_Free(mutex);
+        return NULL;
+    }
+
+    return mutex;
+}
+
+void HAL_MutexDestroy(_IN_ void *mutex)
+{
+    int err_num;
+
+    if (0 != (err_num = pthread_mutex_destroy((pthread_mutex_t *)mutex))) {
+        HAL_Printf("%s: destroy mutex failed: %s\n", __FUNCTION__, strerror(err_num));
+    }
+
+    HAL_Free(mutex);
+}
+
+void HAL_MutexLock(_IN_ void *mutex)
+{
+    int err_num;
+
+    if (0 != (err_num = pthread_mutex_lock((pthread_mutex_t *)mutex))) {
+        HAL_Printf("%s: lock mutex failed: %s\n", __FUNCTION__, strerror(err_num));
+    }
+}
+
+int HAL_MutexTryLock(_IN_ void *mutex)
+{
+    return pthread_mutex_trylock((pthread_mutex_t *)mutex) ? -1 : 0;
+}
+
+void HAL_MutexUnlock(_IN_ void *mutex)
+{
+    int err_num;
+
+    if (0 != (err_num = pthread_mutex_unlock((pthread_mutex_t *)mutex))) {
+        HAL_Printf("%s: unlock mutex failed: %s\n", __FUNCTION__, strerror(err_num));
+    }
+}
+
+void *HAL_ThreadCreate(uint16_t stack_size, int priority, char *taskname, void *(*fn)(void *), void *arg)
+{
+    int err_num;
+    pthread_t *thread_t = (pthread_t *)HAL_Malloc(sizeof(pthread_t));
+
+    /* stack size and priority of FreeRTOS tasks are ignored, pthread defaults are much larger */
+    (void)stack_size;
+    (void)priority;
+
+    if (NULL == thread_t) {
+        return NULL;
+    }
+
+    if (0 != (err_num = pthread_create(thread_t, NULL, fn, arg))) {
+        HAL_Printf("%s: create thread %s failed: %s\n", __FUNCTION__, taskname, strerror(err_num));
+        HAL_Free(thread_t);
+        return NULL;
+    }
+
+    return thread_t;
+}
+
+int HAL_ThreadDestroy(void *thread_t)
+{
+    if (NULL == thread_t) {
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    /* for threads which never return, parked in a sleep loop which is a cancellation point */
+    pthread_cancel(*(pthread_t *)thread_t);
+    pthread_join(*(pthread_t *)thread_t, NULL);
+    HAL_Free(thread_t);
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+int HAL_ThreadJoin(void *thread_t, uint32_t timeout_ms)
+{
+    int err_num;
+    struct timespec ts;
+
+    if (NULL == thread_t) {
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += timeout_ms / 1000;
+    ts.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+
+    /* on timeout the thread keeps running, and its handle stays valid for another join */
+    if (0 != (err_num = pthread_timedjoin_np(*(pthread_t *)thread_t, NULL, &ts))) {
+        if (ETIMEDOUT != err_num) {
+            HAL_Printf("%s: join thread failed: %s\n", __FUNCTION__, strerror(err_num));
+        }
+        return QCLOUD_ERR_FAILURE;
+    }
+    HAL_Free(thread_t);
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+void *HAL_SemaphoreCreate(void)
+{
+    sem_t *sem = (sem_t *)HAL_Malloc(sizeof(sem_t));
+    if (NULL == sem) {
+        return NULL;
+    }
+
+    if (0 != sem_init(sem, 0, 0)) {
+        HAL_Printf("%s: create semaphore failed: %s\n", __FUNCTION__, strerror(errno));
+        HAL_Free(sem);
+        return NULL;
+    }
+
+    return sem;
+}
+
+void HAL_SemaphoreDestroy(void *sem)
+{
+    sem_destroy((sem_t *)sem);
+    HAL_Free(sem);
+}
+
+void HAL_SemaphorePost(void *sem)
+{
+    sem_post((sem_t *)sem);
+}
+
+int HAL_SemaphoreWait(void *sem, uint32_t timeout_ms)
+{
+    int rc;
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += timeout_ms / 1000;
+    ts.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+
+    do {
+        rc = sem_timedwait((sem_t *)sem, &ts);
+    } while (0 != rc && EINTR == errno);
+
+    return (0 == rc) ? QCLOUD_RET_SUCCESS : QCLOUD_ERR_FAILURE;
+}
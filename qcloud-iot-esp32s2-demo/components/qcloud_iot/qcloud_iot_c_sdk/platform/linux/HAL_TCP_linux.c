@@ -0,0 +1,525 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "qcloud_iot_import.h"
+#include "qcloud_iot_export_log.h"
+#include "qcloud_iot_export_error.h"
+#include "qcloud_iot_common.h"
+
+/* handle 0 means failure while fd 0 is a valid descriptor */
+#define LINUX_SOCKET_FD_SHIFT 3
+
+/* poll rather than select, a process hosting many clients has fds beyond FD_SETSIZE */
+static int _wait_fd(int fd, short events, uint32_t timeout_ms)
+{
+    struct pollfd pfd;
+
+    pfd.fd = fd;
+    pfd.events = events;
+    pfd.revents = 0;
+
+    return poll(&pfd, 1, (int)timeout_ms);
+}
+
+
+static uint32_t _time_left(uint32_t t_end, uint32_t t_now)
+{
+    uint32_t t_left;
+
+    if (t_end > t_now) {
+        t_left = t_end - t_now;
+    } else {
+        t_left = 0;
+    }
+
+    return t_left;
+}
+
+uintptr_t HAL_TCP_Connect(const char *host, uint16_t port)
+{
+    int ret;
+    struct addrinfo hints, *addr_list, *cur;
+    int fd = 0;
+
+    char port_str[6];
+    HAL_Snprintf(port_str, 6, "%d", port);
+
+    memset(&hints, 0x00, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+
+    ret = getaddrinfo(host, port_str, &hints, &addr_list);
+    if (ret) {
+        Log_e("getaddrinfo(%s:%s) error", host, port_str);
+        return 0;
+    }
+
+    for (cur = addr_list; cur != NULL; cur = cur->ai_next) {
+        fd = (int) socket( cur->ai_family, cur->ai_socktype, cur->ai_protocol );
+        if ( fd < 0 ) {
+            ret = 0;
+            continue;
+        }
+
+        if (connect(fd, cur->ai_addr, cur->ai_addrlen) == 0) {
+            int one = 1;
+            /* MQTT packets are small and latency sensitive */
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            ret = fd + LINUX_SOCKET_FD_SHIFT;
+            break;
+        }
+
+        close( fd );
+        ret = 0;
+    }
+
+    if (ret == 0) {
+        Log_e("failed to connect with TCP server: %s:%s", host, port_str);
+    } else {
+        /* reduce log print due to frequent log server connect/disconnect */
+        if (0 == strncmp(host, LOG_UPLOAD_SERVER_DOMAIN, HOST_STR_LENGTH))
+            UPLOAD_DBG("connected with TCP server: %s:%s", host, port_str);
+        else
+            Log_i("connected with TCP server: %s:%s", host, port_str);
+    }
+
+    freeaddrinfo(addr_list);
+
+    return (uintptr_t)ret;
+}
+
+
+int HAL_TCP_Disconnect(uintptr_t fd)
+{
+    int rc;
+
+    fd -= LINUX_SOCKET_FD_SHIFT;
+
+    /* Shutdown both send and receive operations, fails with ENOTCONN once the peer reset the link. */
+    rc = shutdown((int) fd, 2);
+    if (0 != rc && ENOTCONN != errno) {
+        Log_e("shutdown error: %s", strerror(errno));
+    }
+
+    /* the socket is closed either way, or its fd leaks at every link drop */
+    rc = close((int) fd);
+    if (0 != rc) {
+        Log_e("closesocket error: %s", strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+
+int HAL_TCP_Write(uintptr_t fd, const unsigned char *buf, uint32_t len, uint32_t timeout_ms, size_t *written_len)
+{
+    int ret;
+    uint32_t len_sent;
+    uint32_t t_end, t_left;
+
+    fd -= LINUX_SOCKET_FD_SHIFT;
+
+    t_end = HAL_GetTimeMs() + timeout_ms;
+    len_sent = 0;
+    ret = 1; /* send one time if timeout_ms is value 0 */
+
+    do {
+        t_left = _time_left(t_end, HAL_GetTimeMs());
+
+        if (0 != t_left) {
+            ret = _wait_fd(fd, POLLOUT, t_left);
+            if (ret > 0) {
+                /* POLLERR and POLLHUP come out of send */
+            } else if (0 == ret) {
+                ret = QCLOUD_ERR_TCP_WRITE_TIMEOUT;
+                Log_e("poll-write timeout %d", (int)fd);
+                break;
+            } else {
+                if (EINTR == errno) {
+                    Log_e("EINTR be caught");
+                    continue;
+                }
+
+                ret = QCLOUD_ERR_TCP_WRITE_FAIL;
+                Log_e("poll-write fail: %s", strerror(errno));
+                break;
+            }
+        } else {
+            ret = QCLOUD_ERR_TCP_WRITE_TIMEOUT;
+        }
+
+        if (ret > 0) {
+            ret = send(fd, buf + len_sent, len - len_sent, MSG_NOSIGNAL);
+            if (ret > 0) {
+                len_sent += ret;
+            } else if (0 == ret) {
+                Log_e("No data be sent. Should NOT arrive");
+            } else {
+                if (EINTR == errno) {
+                    Log_e("EINTR be caught");
+                    continue;
+                }
+
+                ret = QCLOUD_ERR_TCP_WRITE_FAIL;
+                Log_e("send fail: %s", strerror(errno));
+                break;
+            }
+        }
+    } while ((len_sent < len) && (_time_left(t_end, HAL_GetTimeMs()) > 0));
+
+    *written_len = (size_t)len_sent;
+
+    return len_sent > 0 ? QCLOUD_RET_SUCCESS : ret;
+}
+
+
+int HAL_TCP_Writev(uintptr_t fd, const NetIoVec *iov, int iovcnt, uint32_t timeout_ms, size_t *written_len)
+{
+    int ret, i, cnt;
+    size_t len, len_sent, skip;
+    uint32_t t_end, t_left;
+    struct iovec vec[NET_IOV_MAX];
+    struct msghdr msg;
+
+    *written_len = 0;
+    if (iovcnt <= 0 || iovcnt > NET_IOV_MAX) {
+        return QCLOUD_ERR_INVAL;
+    }
+
+    for (i = 0, len = 0; i < iovcnt; i++) {
+        len += iov[i].len;
+    }
+
+    fd -= LINUX_SOCKET_FD_SHIFT;
+
+    t_end = HAL_GetTimeMs() + timeout_ms;
+    len_sent = 0;
+    ret = 1; /* send one time if timeout_ms is value 0 */
+
+    do {
+        t_left = _time_left(t_end, HAL_GetTimeMs());
+
+        if (0 != t_left) {
+            ret = _wait_fd(fd, POLLOUT, t_left);
+            if (0 == ret) {
+                ret = QCLOUD_ERR_TCP_WRITE_TIMEOUT;
+                Log_e("poll-write timeout %d", (int)fd);
+                break;
+            } else if (ret < 0) {
+                if (EINTR == errno) {
+                    Log_e("EINTR be caught");
+                    continue;
+                }
+
+                ret = QCLOUD_ERR_TCP_WRITE_FAIL;
+                Log_e("poll-write fail: %s", strerror(errno));
+                break;
+            }
+        } else {
+            ret = QCLOUD_ERR_TCP_WRITE_TIMEOUT;
+        }
+
+        if (ret > 0) {
+            /* segments not sent yet, the first one may be partly sent */
+            skip = len_sent;
+            for (i = 0, cnt = 0; i < iovcnt; i++) {
+                if (skip >= iov[i].len) {
+                    skip -= iov[i].len;
+                    continue;
+                }
+                vec[cnt].iov_base = (void *)(iov[i].data + skip);
+                vec[cnt].iov_len = iov[i].len - skip;
+                skip = 0;
+                cnt++;
+            }
+
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = vec;
+            msg.msg_iovlen = cnt;
+            /* peer reset must be an error code, not SIGPIPE */
+            ret = sendmsg(fd, &msg, MSG_NOSIGNAL);
+            if (ret > 0) {
+                len_sent += ret;
+            } else if (0 == ret) {
+                Log_e("No data be sent. Should NOT arrive");
+            } else {
+                if (EINTR == errno) {
+                    Log_e("EINTR be caught");
+                    continue;
+                }
+
+                ret = QCLOUD_ERR_TCP_WRITE_FAIL;
+                Log_e("sendmsg fail: %s", strerror(errno));
+                break;
+            }
+        }
+    } while ((len_sent < len) && (_time_left(t_end, HAL_GetTimeMs()) > 0));
+
+    *written_len = len_sent;
+
+    return len_sent > 0 ? QCLOUD_RET_SUCCESS : ret;
+}
+
+
+int HAL_TCP_Read(uintptr_t fd, unsigned char *buf, uint32_t len, uint32_t timeout_ms, size_t *read_len)
+{
+    int ret, err_code;
+    uint32_t len_recv;
+    uint32_t t_end, t_left;
+
+    fd -= LINUX_SOCKET_FD_SHIFT;
+    t_end = HAL_GetTimeMs() + timeout_ms;
+    len_recv = 0;
+    err_code = 0;
+
+    do {
+        t_left = _time_left(t_end, HAL_GetTimeMs());
+        if (0 == t_left) {
+            err_code = QCLOUD_ERR_TCP_READ_TIMEOUT;
+            break;
+        }
+
+        ret = _wait_fd(fd, POLLIN, t_left);
+        if (ret > 0) {
+            ret = recv(fd, buf + len_recv, len - len_recv, 0);
+            if (ret > 0) {
+                len_recv += ret;
+            } else if (0 == ret) {
+                struct sockaddr_in peer;
+                socklen_t sLen = sizeof(peer);
+                int peer_port = 0;
+                getpeername(fd, (struct sockaddr*)&peer, &sLen);
+                peer_port = ntohs(peer.sin_port);
+
+                /* reduce log print due to frequent log server connect/disconnect */
+                if (peer_port == LOG_UPLOAD_SERVER_PORT)
+                    UPLOAD_DBG("connection is closed by server: %s:%d", inet_ntoa(peer.sin_addr), peer_port);
+                else
+                    Log_e("connection is closed by server: %s:%d", inet_ntoa(peer.sin_addr), peer_port);
+
+                err_code = QCLOUD_ERR_TCP_PEER_SHUTDOWN;
+                break;
+            } else {
+                if (EINTR == errno) {
+                    Log_e("EINTR be caught");
+                    continue;
+                }
+                Log_e("recv error: %s", strerror(errno));
+                err_code = QCLOUD_ERR_TCP_READ_FAIL;
+                break;
+            }
+        } else if (0 == ret) {
+            err_code = QCLOUD_ERR_TCP_READ_TIMEOUT;
+            break;
+        } else {
+            if (EINTR == errno) {
+                continue;
+            }
+            Log_e("poll-recv error: %s", strerror(errno));
+            err_code = QCLOUD_ERR_TCP_READ_FAIL;
+            break;
+        }
+    } while ((len_recv < len));
+
+    *read_len = (size_t)len_recv;
+
+    if (err_code == QCLOUD_ERR_TCP_READ_TIMEOUT && len_recv == 0)
+        err_code = QCLOUD_ERR_TCP_NOTHING_TO_READ;
+
+    return (len == len_recv) ? QCLOUD_RET_SUCCESS : err_code;
+}
+
+
+int HAL_TCP_ReadSome(uintptr_t fd, unsigned char *buf, uint32_t len, uint32_t timeout_ms, size_t *read_len)
+{
+    int ret;
+
+    fd -= LINUX_SOCKET_FD_SHIFT;
+    *read_len = 0;
+
+    do {
+        ret = _wait_fd(fd, POLLIN, timeout_ms);
+        if (0 == ret) {
+            return QCLOUD_ERR_TCP_NOTHING_TO_READ;
+        } else if (ret < 0) {
+            if (EINTR == errno) {
+                Log_e("EINTR be caught");
+                continue;
+            }
+            Log_e("poll-recv error: %s", strerror(errno));
+            return QCLOUD_ERR_TCP_READ_FAIL;
+        }
+
+        ret = recv(fd, buf, len, 0);
+        if (ret > 0) {
+            *read_len = (size_t)ret;
+            return QCLOUD_RET_SUCCESS;
+        } else if (0 == ret) {
+            Log_e("connection is closed by server");
+            return QCLOUD_ERR_TCP_PEER_SHUTDOWN;
+        } else {
+            if (EINTR == errno) {
+                Log_e("EINTR be caught");
+                continue;
+            }
+            Log_e("recv error: %s", strerror(errno));
+            return QCLOUD_ERR_TCP_READ_FAIL;
+        }
+    } while (1);
+}
+
+int HAL_TCP_GetFd(uintptr_t fd)
+{
+    return (int)fd - LINUX_SOCKET_FD_SHIFT;
+}
+
+/* epoll set of HAL_Net_WaitReadable, slot i of the caller is registered with data u32 = i */
+typedef struct {
+    int                epfd;
+    int                max_fds;
+    int                count;   // slots used by the last wait
+    int                *fds;    // descriptor registered for each slot, -1 for none
+    struct epoll_event *events;
+} NetWaitSet;
+
+void *HAL_Net_WaitSetCreate(int max_fds)
+{
+    NetWaitSet *set;
+    int i;
+
+    if (max_fds <= 0) {
+        return NULL;
+    }
+
+    set = (NetWaitSet *)HAL_Malloc(sizeof(NetWaitSet) + max_fds * (sizeof(int) + sizeof(struct epoll_event)));
+    if (NULL == set) {
+        Log_e("malloc wait set failed");
+        return NULL;
+    }
+
+    set->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (set->epfd < 0) {
+        Log_e("epoll_create1 error: %s", strerror(errno));
+        HAL_Free(set);
+        return NULL;
+    }
+
+    set->max_fds = max_fds;
+    set->count = 0;
+    set->events = (struct epoll_event *)(set + 1);
+    set->fds = (int *)(set->events + max_fds);
+    for (i = 0; i < max_fds; i++) {
+        set->fds[i] = -1;
+    }
+
+    return set;
+}
+
+void HAL_Net_WaitSetDestroy(void *set)
+{
+    NetWaitSet *wait_set = (NetWaitSet *)set;
+
+    if (NULL == wait_set) {
+        return;
+    }
+
+    close(wait_set->epfd);
+    HAL_Free(wait_set);
+}
+
+int HAL_Net_WaitReadable(void *set, const int *fds, const uint8_t *changed, uint8_t *readable, int count,
+                         uint32_t timeout_ms)
+{
+    NetWaitSet *wait_set = (NetWaitSet *)set;
+    struct epoll_event ev;
+    int i, j, ret;
+    int valid = 0;
+
+    if (NULL == wait_set || count < 0 || count > wait_set->max_fds) {
+        return QCLOUD_ERR_INVAL;
+    }
+
+    /*
+     * all stale slots leave the set before any socket joins it, as a descriptor may move to another slot.
+     * a closed socket has left epoll by itself, so ENOENT and EBADF are expected here.
+     */
+    for (i = 0; i < wait_set->count; i++) {
+        if (wait_set->fds[i] >= 0 && (i >= count || fds[i] != wait_set->fds[i] || changed[i])) {
+            epoll_ctl(wait_set->epfd, EPOLL_CTL_DEL, wait_set->fds[i], NULL);
+            wait_set->fds[i] = -1;
+        }
+    }
+
+    for (i = 0; i < count; i++) {
+        readable[i] = 0;
+        if (fds[i] >= 0 && wait_set->fds[i] != fds[i]) {
+            ev.events = EPOLLIN;
+            ev.data.u32 = (uint32_t)i;
+            if (epoll_ctl(wait_set->epfd, EPOLL_CTL_ADD, fds[i], &ev) != 0) {
+                Log_e("epoll_ctl add fd %d error: %s", fds[i], strerror(errno));
+                continue;
+            }
+            /* the fd was closed under another slot not updated yet, which must not remove it later */
+            for (j = 0; j < wait_set->max_fds; j++) {
+                if (j != i && wait_set->fds[j] == fds[i]) {
+                    wait_set->fds[j] = -1;
+                }
+            }
+            wait_set->fds[i] = fds[i];
+        }
+        valid += (wait_set->fds[i] >= 0);
+    }
+    wait_set->count = count;
+
+    if (0 == valid) {
+        HAL_SleepMs(timeout_ms);
+        return 0;
+    }
+
+    ret = epoll_wait(wait_set->epfd, wait_set->events, wait_set->max_fds, (int)timeout_ms);
+    if (ret < 0) {
+        if (EINTR == errno) {
+            return 0;
+        }
+        Log_e("epoll_wait error: %s", strerror(errno));
+        return QCLOUD_ERR_TCP_READ_FAIL;
+    }
+
+    for (i = 0; i < ret; i++) {
+        /* errors are reported by the read */
+        if (wait_set->events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+            readable[wait_set->events[i].data.u32] = 1;
+        }
+    }
+
+    return ret;
+}
@@ -0,0 +1,322 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "qcloud_iot_import.h"
+
+#ifndef AUTH_WITH_NOTLS
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+
+#include "qcloud_iot_export_error.h"
+#include "qcloud_iot_export_log.h"
+#include "utils_param_check.h"
+#include "utils_timer.h"
+
+/* OpenSSL port of HAL_TLS_mbedtls.c for host builds, PSK devices only */
+
+#ifdef AUTH_MODE_CERT
+#error "host TLS port supports PSK devices only"
+#endif
+
+/* the same PSK suites as the mbedtls port */
+#define TLS_PSK_CIPHERS "PSK-AES128-CBC-SHA:PSK-AES256-CBC-SHA"
+
+/**
+ * @brief data structure for OpenSSL connection
+ */
+typedef struct {
+    uintptr_t         tcp_handle;
+    int               fd;
+    SSL_CTX          *ctx;
+    SSL              *ssl;
+    TLSConnectParams *params;
+} TLSDataParams;
+
+static void _free_openssl(TLSDataParams *pParams)
+{
+    if (pParams->ssl) {
+        SSL_free(pParams->ssl);
+    }
+    if (pParams->ctx) {
+        SSL_CTX_free(pParams->ctx);
+    }
+    if (pParams->tcp_handle) {
+        HAL_TCP_Disconnect(pParams->tcp_handle);
+    }
+
+    HAL_Free(pParams);
+}
+
+static unsigned int _psk_client_cb(SSL *ssl, const char *hint, char *identity, unsigned int max_identity_len,
+                                   unsigned char *psk, unsigned int max_psk_len)
+{
+    TLSDataParams *pParams = (TLSDataParams *)SSL_get_app_data(ssl);
+    TLSConnectParams *pConnectParams = pParams->params;
+
+    if (strlen(pConnectParams->psk_id) + 1 > max_identity_len || pConnectParams->psk_length > max_psk_len) {
+        Log_e("psk id or psk too long");
+        return 0;
+    }
+
+    strcpy(identity, pConnectParams->psk_id);
+    memcpy(psk, pConnectParams->psk, pConnectParams->psk_length);
+
+    return (unsigned int)pConnectParams->psk_length;
+}
+
+/* wait until the socket is ready, or there is decrypted data buffered already */
+static int _wait_fd(TLSDataParams *pParams, short events, uint32_t timeout_ms)
+{
+    struct pollfd pfd;
+    int rc;
+
+    if ((events & POLLIN) && SSL_pending(pParams->ssl) > 0) {
+        return 1;
+    }
+
+    pfd.fd = pParams->fd;
+    pfd.events = events;
+    pfd.revents = 0;
+
+    do {
+        rc = poll(&pfd, 1, (int)timeout_ms);
+    } while (rc < 0 && EINTR == errno);
+
+    return rc;
+}
+
+uintptr_t HAL_TLS_Connect(TLSConnectParams *pConnectParams, const char *host, int port)
+{
+    int ret;
+    TLSDataParams *pDataParams;
+
+    if (pConnectParams->psk == NULL || pConnectParams->psk_id == NULL) {
+        Log_e("psk/pskid is empty!");
+        return 0;
+    }
+
+    pDataParams = (TLSDataParams *)HAL_Malloc(sizeof(TLSDataParams));
+    if (NULL == pDataParams) {
+        return 0;
+    }
+    memset(pDataParams, 0, sizeof(TLSDataParams));
+    pDataParams->params = pConnectParams;
+
+    pDataParams->ctx = SSL_CTX_new(TLS_client_method());
+    if (NULL == pDataParams->ctx) {
+        Log_e("SSL_CTX_new failed");
+        goto error;
+    }
+
+    /* TLS 1.3 PSK needs session tickets, the cloud only negotiates TLS 1.2 PSK suites */
+    SSL_CTX_set_max_proto_version(pDataParams->ctx, TLS1_2_VERSION);
+    SSL_CTX_set_security_level(pDataParams->ctx, 0);
+    if (1 != SSL_CTX_set_cipher_list(pDataParams->ctx, TLS_PSK_CIPHERS)) {
+        Log_e("SSL_CTX_set_cipher_list failed");
+        goto error;
+    }
+    SSL_CTX_set_psk_client_callback(pDataParams->ctx, _psk_client_cb);
+
+    pDataParams->tcp_handle = HAL_TCP_Connect(host, port);
+    if (0 == pDataParams->tcp_handle) {
+        goto error;
+    }
+    pDataParams->fd = HAL_TCP_GetFd(pDataParams->tcp_handle);
+
+    pDataParams->ssl = SSL_new(pDataParams->ctx);
+    if (NULL == pDataParams->ssl) {
+        Log_e("SSL_new failed");
+        goto error;
+    }
+    SSL_set_app_data(pDataParams->ssl, pDataParams);
+    SSL_set_fd(pDataParams->ssl, pDataParams->fd);
+    SSL_set_tlsext_host_name(pDataParams->ssl, host);
+
+    Log_d("Performing the SSL/TLS handshake...");
+    if ((ret = SSL_connect(pDataParams->ssl)) != 1) {
+        Log_e("SSL_connect failed returned %d, ssl err %d", ret, SSL_get_error(pDataParams->ssl, ret));
+        goto error;
+    }
+
+    Log_i("connected with /%s/%d...", host, port);
+
+    return (uintptr_t)pDataParams;
+
+error:
+    _free_openssl(pDataParams);
+    return 0;
+}
+
+void HAL_TLS_Disconnect(uintptr_t handle)
+{
+    TLSDataParams *pParams = (TLSDataParams *)handle;
+
+    if ((uintptr_t)NULL == handle) {
+        Log_d("handle is NULL");
+        return;
+    }
+
+    SSL_shutdown(pParams->ssl);
+    _free_openssl(pParams);
+}
+
+int HAL_TLS_Write(uintptr_t handle, unsigned char *msg, size_t totalLen, uint32_t timeout_ms,
+                  size_t *written_len)
+{
+    Timer timer;
+    size_t written_so_far = 0;
+    int write_rc;
+
+    TLSDataParams *pParams = (TLSDataParams *)handle;
+
+    InitTimer(&timer);
+    countdown_ms(&timer, (unsigned int) timeout_ms);
+
+    while (written_so_far < totalLen) {
+        if (_wait_fd(pParams, POLLOUT, left_ms(&timer)) <= 0) {
+            break;
+        }
+
+        write_rc = SSL_write(pParams->ssl, msg + written_so_far, (int)(totalLen - written_so_far));
+        if (write_rc <= 0) {
+            Log_e("HAL_TLS_write failed, ssl err %d", SSL_get_error(pParams->ssl, write_rc));
+            *written_len = written_so_far;
+            return QCLOUD_ERR_SSL_WRITE;
+        }
+        written_so_far += write_rc;
+
+        if (expired(&timer)) {
+            break;
+        }
+    }
+
+    *written_len = written_so_far;
+
+    if (written_so_far != totalLen) {
+        return QCLOUD_ERR_SSL_WRITE_TIMEOUT;
+    }
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+int HAL_TLS_Writev(uintptr_t handle, const NetIoVec *iov, int iovcnt, uint32_t timeout_ms,
+                   size_t *written_len)
+{
+    Timer timer;
+    size_t len;
+    int i, rc;
+
+    InitTimer(&timer);
+    countdown_ms(&timer, (unsigned int) timeout_ms);
+
+    *written_len = 0;
+    if (iovcnt <= 0 || iovcnt > NET_IOV_MAX) {
+        return QCLOUD_ERR_INVAL;
+    }
+
+    for (i = 0; i < iovcnt; i++) {
+        if (0 == iov[i].len) {
+            continue;
+        }
+
+        rc = HAL_TLS_Write(handle, (unsigned char *)iov[i].data, iov[i].len, left_ms(&timer), &len);
+        *written_len += len;
+        if (QCLOUD_RET_SUCCESS != rc) {
+            return rc;
+        }
+    }
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+static int _tls_read(TLSDataParams *pParams, unsigned char *msg, size_t totalLen, uint32_t timeout_ms,
+                     size_t *read_len, bool read_some)
+{
+    Timer timer;
+    int read_rc;
+
+    InitTimer(&timer);
+    countdown_ms(&timer, (unsigned int) timeout_ms);
+    *read_len = 0;
+
+    do {
+        if (_wait_fd(pParams, POLLIN, left_ms(&timer)) <= 0) {
+            break;
+        }
+
+        read_rc = SSL_read(pParams->ssl, msg + *read_len, (int)(totalLen - *read_len));
+        if (read_rc > 0) {
+            *read_len += read_rc;
+            if (read_some && SSL_pending(pParams->ssl) <= 0) {
+                break;
+            }
+        } else if (SSL_ERROR_WANT_READ != SSL_get_error(pParams->ssl, read_rc)) {
+            /* a record split across TCP segments ends in WANT_READ, everything else is fatal */
+            Log_e("cloud_iot_network_tls_read failed, ssl err %d", SSL_get_error(pParams->ssl, read_rc));
+            return QCLOUD_ERR_SSL_READ;
+        }
+    } while (*read_len < totalLen && !expired(&timer));
+
+    if (totalLen == *read_len || (read_some && *read_len > 0)) {
+        return QCLOUD_RET_SUCCESS;
+    }
+
+    if (*read_len == 0) {
+        return QCLOUD_ERR_SSL_NOTHING_TO_READ;
+    } else {
+        return QCLOUD_ERR_SSL_READ_TIMEOUT;
+    }
+}
+
+int HAL_TLS_Read(uintptr_t handle, unsigned char *msg, size_t totalLen, uint32_t timeout_ms, size_t *read_len)
+{
+    return _tls_read((TLSDataParams *)handle, msg, totalLen, timeout_ms, read_len, false);
+}
+
+int HAL_TLS_ReadSome(uintptr_t handle, unsigned char *msg, size_t totalLen, uint32_t timeout_ms, size_t *read_len)
+{
+    return _tls_read((TLSDataParams *)handle, msg, totalLen, timeout_ms, read_len, true);
+}
+
+int HAL_TLS_GetFd(uintptr_t handle)
+{
+    TLSDataParams *pParams = (TLSDataParams *)handle;
+
+    return pParams->fd;
+}
+
+bool HAL_TLS_HasPending(uintptr_t handle)
+{
+    TLSDataParams *pParams = (TLSDataParams *)handle;
+
+    return SSL_has_pending(pParams->ssl) ? true : false;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
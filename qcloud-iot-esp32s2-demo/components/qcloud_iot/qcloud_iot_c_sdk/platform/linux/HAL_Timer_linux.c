@@ -0,0 +1,98 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "qcloud_iot_import.h"
+
+static char now_time_str[20] = {0};
+
+uint64_t HAL_GetTimeMs64(void)
+{
+    /* monotonic clock is not stepped by NTP or settimeofday */
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+uint32_t HAL_GetTimeMs(void)
+{
+    return (uint32_t)HAL_GetTimeMs64();
+}
+
+/*Get timestamp*/
+long HAL_Timer_current_sec(void)
+{
+    /* wall clock, for timestamps sent to server */
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec;
+}
+
+char* HAL_Timer_current(void)
+{
+    struct timeval tv;
+    struct tm tm_tmp;
+    time_t now_time;
+
+    gettimeofday(&tv, NULL);
+    now_time = tv.tv_sec;
+    localtime_r(&now_time, &tm_tmp);
+    strftime(now_time_str, 20, "%F %T", &tm_tmp);
+    return now_time_str;
+}
+
+bool HAL_Timer_expired(Timer *timer)
+{
+    return (HAL_GetTimeMs64() >= timer->end_time) ? true : false;
+}
+
+void HAL_Timer_countdown_ms(Timer *timer, unsigned int timeout_ms)
+{
+    timer->end_time = HAL_GetTimeMs64() + timeout_ms;
+}
+
+void HAL_Timer_countdown(Timer *timer, unsigned int timeout)
+{
+    timer->end_time = HAL_GetTimeMs64() + (uint64_t)timeout * 1000;
+}
+
+int HAL_Timer_remain(Timer *timer)
+{
+    uint64_t now = HAL_GetTimeMs64();
+
+    if (now >= timer->end_time) {
+        return 0;
+    }
+
+    return (timer->end_time - now > INT_MAX) ? INT_MAX : (int)(timer->end_time - now);
+}
+
+void HAL_Timer_init(Timer *timer)
+{
+    timer->end_time = 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
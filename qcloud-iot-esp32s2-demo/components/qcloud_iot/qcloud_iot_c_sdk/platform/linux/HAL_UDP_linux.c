@@ -0,0 +1,137 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <unistd.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "qcloud_iot_import.h"
+#include "qcloud_iot_export_log.h"
+#include "qcloud_iot_export_error.h"
+
+#ifdef COAP_COMM_ENABLED
+
+/* handle 0 means failure while fd 0 is a valid descriptor, as in HAL_TCP_linux.c */
+#define LINUX_SOCKET_FD_SHIFT 3
+
+uintptr_t HAL_UDP_Connect(const char *host, unsigned short port)
+{
+    int             ret = 0;
+    struct addrinfo hints, *addr_list, *cur;
+    int             fd = 0;
+
+    char port_str[6];
+    HAL_Snprintf(port_str, 6, "%d", port);
+
+    memset(&hints, 0x00, sizeof(hints));
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_protocol = IPPROTO_UDP;
+
+    if (getaddrinfo(host, port_str, &hints, &addr_list) != 0) {
+        Log_e("getaddrinfo(%s:%s) error", host, port_str);
+        return 0;
+    }
+
+    for (cur = addr_list; cur != NULL; cur = cur->ai_next) {
+        fd = socket(cur->ai_family, cur->ai_socktype, cur->ai_protocol);
+        if (fd < 0) {
+            ret = 0;
+            continue;
+        }
+
+        if (connect(fd, cur->ai_addr, cur->ai_addrlen) == 0) {
+            ret = fd + LINUX_SOCKET_FD_SHIFT;
+            break;
+        }
+
+        close(fd);
+        ret = 0;
+    }
+
+    if (ret == 0) {
+        Log_e("failed to connect with UDP server: %s:%s", host, port_str);
+    } else {
+        Log_d("connected with UDP server: %s:%s", host, port_str);
+    }
+
+    freeaddrinfo(addr_list);
+
+    return (uintptr_t)ret;
+}
+
+void HAL_UDP_Disconnect(uintptr_t fd)
+{
+    close((int)(fd - LINUX_SOCKET_FD_SHIFT));
+}
+
+int HAL_UDP_Write(uintptr_t fd, const unsigned char *p_data, unsigned int datalen)
+{
+    int rc;
+
+    rc = (int)send((int)(fd - LINUX_SOCKET_FD_SHIFT), p_data, datalen, 0);
+    if (rc < 0) {
+        return -1;
+    }
+
+    return rc;
+}
+
+int HAL_UDP_Read(uintptr_t fd, unsigned char *p_data, unsigned int datalen)
+{
+    return (int)recv((int)(fd - LINUX_SOCKET_FD_SHIFT), p_data, datalen, 0);
+}
+
+int HAL_UDP_ReadTimeout(uintptr_t fd, unsigned char *p_data, unsigned int datalen, unsigned int timeout_ms)
+{
+    struct pollfd pfd;
+    int           ret;
+
+    pfd.fd      = (int)(fd - LINUX_SOCKET_FD_SHIFT);
+    pfd.events  = POLLIN;
+    pfd.revents = 0;
+    if (pfd.fd < 0) {
+        return -1;
+    }
+
+    /* timeout 0 blocks, as select with no timeval does in HAL_UDP_lwip.c */
+    ret = poll(&pfd, 1, timeout_ms == 0 ? -1 : (int)timeout_ms);
+
+    /* Zero fds ready means we timed out */
+    if (ret == 0) {
+        return QCLOUD_ERR_SSL_READ_TIMEOUT;
+    }
+
+    if (ret < 0) {
+        if (errno == EINTR) {
+            return -3; /* want read */
+        }
+
+        return QCLOUD_ERR_SSL_READ;
+    }
+
+    /* This call will not block */
+    return HAL_UDP_Read(fd, p_data, datalen);
+}
+
+#endif
@@ -29,53 +29,56 @@
 #include "qcloud_iot_export_data_template.h"
 
 //Action Subscribe
-static int _parse_action_input(DeviceAction *pAction, char *pInput)
+static int _parse_action_input(DeviceAction *pAction, TemplateJsonDoc *pDoc, int input)
 {
-    int i;
-    char *temp;
+    int i, len;
+    int rc = QCLOUD_RET_SUCCESS;
+    json_span_t value;
     DeviceProperty *pActionInput = pAction->pInput;
 
     //check and copy
     for (i = 0; i < pAction->input_num; i++) {
+        if (!template_json_span_of(pDoc, input, pActionInput[i].key, &value)) {
+            Log_e("action input data [%s] not found!", pActionInput[i].key);
+            return -1;
+        }
+
         if (JSTRING == pActionInput[i].type) {
-            pActionInput[i].data = LITE_json_value_of(pActionInput[i].key, pInput);
-            if (NULL == pActionInput[i].data) {
-                Log_e("action input data [%s] not found!", pActionInput[i].key);
-                return -1;
+            if (pActionInput[i].data_buff_len > 0 && NULL != pActionInput[i].data) {
+                // copy into the buffer of input, truncated as string property
+                len = Min(value.len, pActionInput[i].data_buff_len);
+                memcpy(pActionInput[i].data, value.str, len);
+                ((char *)pActionInput[i].data)[len] = '\0';
+            } else {
+                // input without buffer, keep the data allocated as before
+                pActionInput[i].data = HAL_Malloc(value.len + 1);
+                if (NULL == pActionInput[i].data) {
+                    Log_e("malloc action input data [%s] failed!", pActionInput[i].key);
+                    return -1;
+                }
+                memcpy(pActionInput[i].data, value.str, value.len);
+                ((char *)pActionInput[i].data)[value.len] = '\0';
             }
         } else {
-            temp = LITE_json_value_of(pActionInput[i].key, pInput);
-            if (NULL == temp) {
-                Log_e("action input data [%s] not found!", pActionInput[i].key);
-                return -1;
-            }
             if (JINT32 == pActionInput[i].type) {
-                if (sscanf(temp, "%" SCNi32, (int32_t *)pActionInput[i].data) != 1) {
-                    HAL_Free(temp);
-                    Log_e("parse code failed, errCode: %d", QCLOUD_ERR_JSON_PARSE);
-                    return -1;
-                }
+                rc = LITE_span_get_int32((int32_t *)pActionInput[i].data, &value);
             } else if ( JFLOAT == pActionInput[i].type) {
-                if (sscanf(temp, "%f", (float *)pActionInput[i].data) != 1) {
-                    HAL_Free(temp);
-                    Log_e("parse code failed, errCode: %d", QCLOUD_ERR_JSON_PARSE);
-                    return -1;
-                }
+                rc = LITE_span_get_float((float *)pActionInput[i].data, &value);
             } else if ( JUINT32 == pActionInput[i].type) {
-                if (sscanf(temp, "%" SCNu32, (uint32_t *) pActionInput[i].data) != 1) {
-                    HAL_Free(temp);
-                    Log_e("parse code failed, errCode: %d", QCLOUD_ERR_JSON_PARSE);
-                    return -1;
-                }
+                rc = LITE_span_get_uint32((uint32_t *) pActionInput[i].data, &value);
+            }
+
+            if (rc != QCLOUD_RET_SUCCESS) {
+                Log_e("parse code failed, errCode: %d", QCLOUD_ERR_JSON_PARSE);
+                return -1;
             }
-            HAL_Free(temp);
         }
     }
 
     return 0;
 }
 
-static void _handle_aciton(Qcloud_IoT_Template *pTemplate, List *list, const char *pClientToken, const char *pActionId, uint32_t timestamp, char *pInput)
+static void _handle_aciton(Qcloud_IoT_Template *pTemplate, List *list, const char *pClientToken, const char *pActionId, uint32_t timestamp, int input)
 {
     IOT_FUNC_ENTRY;
 
@@ -106,7 +109,7 @@ static void _handle_aciton(Qcloud_IoT_Template *pTemplate, List *list, const cha
             // check action id and call callback
             if (0 == strcmp(pActionId, ((DeviceAction*)pActionHandle->action)->pActionId)) {
                 if (NULL != pActionHandle->callback) {
-                    if (!_parse_action_input(pActionHandle->action, pInput)) {
+                    if (!_parse_action_input(pActionHandle->action, &pTemplate->inner_data.rx_doc, input)) {
                         ((DeviceAction*)pActionHandle->action)->timestamp = timestamp;
                         pActionHandle->callback(pTemplate, pClientToken, pActionHandle->action);
                     }
@@ -126,16 +129,26 @@ static void _on_action_handle_callback(void *pClient, MQTTMessage *message, void
 //  Qcloud_IoT_Template *template_client = (Qcloud_IoT_Template*)mqtt_client->event_handle.context;
     Qcloud_IoT_Template *template_client = (Qcloud_IoT_Template *)pUserData;
 
-    char *type_str = NULL;
-    char* client_token = NULL;
-    char* action_id = NULL;
-    char *pInput = NULL;
+    char type_str[MAX_SIZE_OF_TEMPLATE_METHOD];
+    char client_token[MAX_SIZE_OF_CLIENT_TOKEN];
+    char action_id[MAX_SIZE_OF_ACTION_ID];
+    int input;
     int timestamp = 0;
+    TemplateJsonDoc *doc;
+
+    POINTER_SANITY_CHECK_RTN(template_client);
+    doc = &template_client->inner_data.rx_doc;
 
     Log_d("recv:%.*s", (int) message->payload_len, (char *) message->payload);
 
+    // tokenize once, all the fields are looked up in the tokens
+    if (template_json_parse(doc, (char *) message->payload) != QCLOUD_RET_SUCCESS) {
+        Log_e("Fail to parse json!");
+        goto EXIT;
+    }
+
     // prase_method
-    if (!parse_template_method_type((char *) message->payload, &type_str)) {
+    if (!parse_template_method_type(doc, type_str, sizeof(type_str))) {
         Log_e("Fail to parse method!");
         goto EXIT;
     }
@@ -145,37 +158,33 @@ static void _on_action_handle_callback(void *pClient, MQTTMessage *message, void
     }
 
     // prase client Token
-    if (!parse_client_token((char *) message->payload, &client_token)) {
+    if (!parse_client_token(doc, client_token, sizeof(client_token))) {
         Log_e("fail to parse client token!");
         goto EXIT;
     }
 
     // prase action ID
-    if (!parse_action_id((char *) message->payload, &action_id)) {
+    if (!parse_action_id(doc, action_id, sizeof(action_id))) {
         Log_e("fail to parse action id!");
         goto EXIT;
     }
 
     // prase timestamp
-    if (!parse_time_stamp((char *) message->payload, &timestamp)) {
+    if (!parse_time_stamp(doc, &timestamp)) {
         Log_e("fail to parse timestamp!");
         goto EXIT;
     }
 
     // prase action input
-    if (!parse_action_input((char *) message->payload, &pInput)) {
+    if (!parse_action_input(doc, &input)) {
         Log_e("fail to parse action input!");
         goto EXIT;
     }
 
     //find action ID in register list and call handle
-    if (template_client != NULL)
-        _handle_aciton(template_client, template_client->inner_data.action_handle_list, client_token, action_id, timestamp, pInput);
+    _handle_aciton(template_client, template_client->inner_data.action_handle_list, client_token, action_id, timestamp, input);
 
 EXIT:
-    HAL_Free(type_str);
-    HAL_Free(client_token);
-    HAL_Free(pInput);
     return;
 }
 
@@ -275,21 +284,11 @@ int IOT_Action_Remove(void *pTemplate, DeviceAction *pAction)
 }
 
 //Action post to server
-static int _iot_action_json_init(void *handle, char *jsonBuffer, size_t sizeOfBuffer, const char *pClientToken, DeviceAction *pAction)
-{
-    POINTER_SANITY_CHECK(jsonBuffer, QCLOUD_ERR_INVAL);
-    int32_t rc_of_snprintf;
-    memset(jsonBuffer, 0, sizeOfBuffer);
-    rc_of_snprintf = HAL_Snprintf(jsonBuffer, sizeOfBuffer, "{\"method\":\"%s\", \"clientToken\":\"%s\", ", REPORT_ACTION, pClientToken);
-
-    return check_snprintf_return(rc_of_snprintf, sizeOfBuffer);
-}
-
 static int _iot_construct_action_json(void *handle, char *jsonBuffer, size_t sizeOfBuffer, const char *pClientToken, DeviceAction *pAction, sReplyPara *replyPara)
 {
-    size_t remain_size = 0;
-    int32_t rc_of_snprintf = 0;
+    json_writer_t writer;
     uint8_t i;
+    int rc;
     Qcloud_IoT_Template* ptemplate = (Qcloud_IoT_Template *)handle;
 
     POINTER_SANITY_CHECK(ptemplate, QCLOUD_ERR_INVAL);
@@ -297,33 +296,18 @@ static int _iot_construct_action_json(void *handle, char *jsonBuffer, size_t siz
     POINTER_SANITY_CHECK(pClientToken, QCLOUD_ERR_INVAL);
     POINTER_SANITY_CHECK(pAction, QCLOUD_ERR_INVAL);
 
-    int rc = _iot_action_json_init(ptemplate, jsonBuffer, sizeOfBuffer, pClientToken, pAction);
-    if (rc != QCLOUD_RET_SUCCESS) {
-        Log_e("event json init failed: %d", rc);
-        return rc;
-    }
-
-    if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
-        return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
-    }
-
-
-    rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "\"code\":%d, \"status\":\"%s\", \"response\":{", \
-                                  replyPara->code, replyPara->status_msg);
-
-    rc = check_snprintf_return(rc_of_snprintf, remain_size);
-    if (rc != QCLOUD_RET_SUCCESS) {
-        return rc;
-    }
-
-    if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
-        return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
-    }
+    json_writer_init(&writer, jsonBuffer, sizeOfBuffer);
+    json_writer_object_begin(&writer, NULL);
+    json_writer_string(&writer, "method", REPORT_ACTION);
+    json_writer_string(&writer, "clientToken", pClientToken);
+    json_writer_int32(&writer, "code", replyPara->code);
+    json_writer_string(&writer, "status", replyPara->status_msg);
 
+    json_writer_object_begin(&writer, "response");
     DeviceProperty *pJsonNode = pAction->pOutput;
     for (i = 0; i < pAction->output_num; i++) {
         if (pJsonNode != NULL && pJsonNode->key != NULL) {
-            rc = template_put_json_node(jsonBuffer, remain_size, pJsonNode->key, pJsonNode->data, pJsonNode->type);
+            rc = template_put_json_node(&writer, pJsonNode->key, pJsonNode->data, pJsonNode->type);
 
             if (rc != QCLOUD_RET_SUCCESS) {
                 return rc;
@@ -334,24 +318,13 @@ static int _iot_construct_action_json(void *handle, char *jsonBuffer, size_t siz
         }
         pJsonNode++;
     }
-    if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
-        return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
-    }
-
-    rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer) - 1, remain_size, "}" );
-
-    rc = check_snprintf_return(rc_of_snprintf, remain_size);
-    if (rc != QCLOUD_RET_SUCCESS) {
-        return rc;
-    }
+    json_writer_object_end(&writer);
 
     //finish json
-    if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) < 1) {
-        return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
-    }
-    rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "}");
+    json_writer_object_end(&writer);
 
-    return check_snprintf_return(rc_of_snprintf, remain_size);
+    rc = json_writer_finish(&writer);
+    return rc < 0 ? rc : QCLOUD_RET_SUCCESS;
 }
 
 static int _publish_action_to_cloud(void *c, char *pJsonDoc)
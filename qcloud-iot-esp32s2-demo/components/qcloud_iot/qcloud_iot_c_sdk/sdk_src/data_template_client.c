@@ -29,6 +29,7 @@ extern "C" {
 #include "data_template_client.h"
 #include "data_template_action.h"
 #include "data_template_client_common.h"
+#include "data_template_event.h"
 
 
 static void _init_request_params(RequestParams *pParams, Method method, OnReplyCallback callback, void *userContext, uint8_t timeout_sec)
@@ -161,6 +162,8 @@ static void _copy_template_init_params_to_mqtt(MQTTInitParams *pMqttInitParams,
     pMqttInitParams->keep_alive_interval_ms = templateInitParams->keep_alive_interval_ms;
     pMqttInitParams->clean_session = templateInitParams->clean_session;
     pMqttInitParams->auto_connect_enable = templateInitParams->auto_connect_enable;
+    pMqttInitParams->tx_buf_size = templateInitParams->tx_buf_size;
+    pMqttInitParams->rx_buf_size = templateInitParams->rx_buf_size;
 }
 
 static void _reply_ack_cb(void *pClient, Method method, ReplyAck replyAck, const char *pReceivedJsonDocument, void *pUserdata)
@@ -201,34 +204,20 @@ static int _template_ConstructControlReply(char *jsonBuffer, size_t sizeOfBuffer
 
     POINTER_SANITY_CHECK(jsonBuffer, QCLOUD_ERR_INVAL);
 
+    json_writer_t writer;
     int rc;
-    size_t remain_size = 0;
-    int32_t rc_of_snprintf;
-
-    if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
-        return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
-    }
-
-    rc_of_snprintf = HAL_Snprintf(jsonBuffer, remain_size, "{\"code\":%d, \"clientToken\":\"%s\",", replyPara->code, get_control_clientToken());
-    rc = check_snprintf_return(rc_of_snprintf, remain_size);
-
-    if (rc != QCLOUD_RET_SUCCESS) {
-        return rc;
-    }
-
-    if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
-        return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
-    }
 
+    json_writer_init(&writer, jsonBuffer, sizeOfBuffer);
+    json_writer_object_begin(&writer, NULL);
+    json_writer_int32(&writer, "code", replyPara->code);
+    json_writer_string(&writer, "clientToken", get_control_clientToken());
     if (strlen(replyPara->status_msg) > 0) {
-        rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "\"status\":\"%s\"}", replyPara->status_msg);
-    } else {
-        rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer) - 1, remain_size, "}");
+        json_writer_string(&writer, "status", replyPara->status_msg);
     }
+    json_writer_object_end(&writer);
 
-    rc = check_snprintf_return(rc_of_snprintf, remain_size);
-
-    return rc;
+    rc = json_writer_finish(&writer);
+    return rc < 0 ? rc : QCLOUD_RET_SUCCESS;
 }
 
 static void _template_mqtt_event_handler(void *pclient, void *context, MQTTEventMsg *msg)
@@ -277,28 +266,22 @@ int IOT_Template_JSON_ConstructReportArray(void *handle, char *jsonBuffer, size_
     Qcloud_IoT_Template* ptemplate = (Qcloud_IoT_Template*)handle;
     POINTER_SANITY_CHECK(ptemplate, QCLOUD_ERR_INVAL);
 
-    size_t remain_size = 0;
-    int32_t rc_of_snprintf = 0;
+    json_writer_t writer;
+    char client_token[MAX_SIZE_OF_CLIENT_TOKEN];
     int rc;
-    int8_t i;
-
-
-    build_empty_json(&(ptemplate->inner_data.token_num), jsonBuffer);
-    if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
-        return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
-    }
+    int i;
 
-    rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer) - 1, remain_size, ", \"params\":{");
-    rc = check_snprintf_return(rc_of_snprintf, remain_size);
+    generate_client_token(client_token, sizeof(client_token), &(ptemplate->inner_data.token_num));
 
-    if (rc != QCLOUD_RET_SUCCESS) {
-        return rc;
-    }
+    json_writer_init(&writer, jsonBuffer, sizeOfBuffer);
+    json_writer_object_begin(&writer, NULL);
+    json_writer_string(&writer, "clientToken", client_token);
+    json_writer_object_begin(&writer, "params");
 
     for (i = 0; i < count; i++) {
         DeviceProperty *pJsonNode = pDeviceProperties[i];
         if (pJsonNode != NULL && pJsonNode->key != NULL) {
-            rc = put_json_node(jsonBuffer, remain_size, pJsonNode->key, pJsonNode->data, pJsonNode->type);
+            rc = put_json_node(&writer, pJsonNode->key, pJsonNode->data, pJsonNode->type);
 
             if (rc != QCLOUD_RET_SUCCESS) {
                 return rc;
@@ -308,18 +291,16 @@ int IOT_Template_JSON_ConstructReportArray(void *handle, char *jsonBuffer, size_
         }
     }
 
-    if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
-        return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
-    }
-    rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer) - 1, remain_size, "}}");
-    rc = check_snprintf_return(rc_of_snprintf, remain_size);
+    json_writer_object_end(&writer);
+    json_writer_object_end(&writer);
 
-    if (rc != QCLOUD_RET_SUCCESS) {
+    rc = json_writer_finish(&writer);
+    if (rc < 0) {
         Log_e("construct datatemplate report array failed: %d", rc);
         return rc;
     }
 
-    return rc;
+    return QCLOUD_RET_SUCCESS;
 }
 
 int IOT_Template_ClearControl(void *handle, char *pClientToken, OnReplyCallback callback, uint32_t timeout_ms)
@@ -442,80 +423,46 @@ int IOT_Template_JSON_ConstructSysInfo(void *handle, char *jsonBuffer, size_t si
     Qcloud_IoT_Template* ptemplate = (Qcloud_IoT_Template*)handle;
     POINTER_SANITY_CHECK(ptemplate, QCLOUD_ERR_INVAL);
 
-    size_t remain_size = 0;
-    int32_t rc_of_snprintf = 0;
+    json_writer_t writer;
+    char client_token[MAX_SIZE_OF_CLIENT_TOKEN];
     int rc;
 
+    generate_client_token(client_token, sizeof(client_token), &(ptemplate->inner_data.token_num));
 
-    build_empty_json(&(ptemplate->inner_data.token_num), jsonBuffer);
-    if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
-        return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
-    }
-
-    rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer) - 1, remain_size, ", \"params\":{");
-    rc = check_snprintf_return(rc_of_snprintf, remain_size);
-
-    if (rc != QCLOUD_RET_SUCCESS) {
-        return rc;
-    }
+    json_writer_init(&writer, jsonBuffer, sizeOfBuffer);
+    json_writer_object_begin(&writer, NULL);
+    json_writer_string(&writer, "clientToken", client_token);
+    json_writer_object_begin(&writer, "params");
 
     DeviceProperty *pJsonNode = pPlatInfo;
     while ((NULL != pJsonNode) && (NULL != pJsonNode->key)) {
-        rc = put_json_node(jsonBuffer, remain_size, pJsonNode->key, pJsonNode->data, pJsonNode->type);
+        rc = put_json_node(&writer, pJsonNode->key, pJsonNode->data, pJsonNode->type);
         if (rc != QCLOUD_RET_SUCCESS) {
             return rc;
         }
         pJsonNode++;
     }
 
-    if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
-        return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
-    }
-    rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer) - 1, remain_size, "},");
-    rc = check_snprintf_return(rc_of_snprintf, remain_size);
-
-    if (rc != QCLOUD_RET_SUCCESS) {
-        return rc;
-    }
-
-    if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
-        return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
-    }
-
     pJsonNode = pSelfInfo;
     if ((NULL == pJsonNode) || (NULL == pJsonNode->key)) {
         Log_d("No self define info");
-        goto end;
-    }
-    rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer) - 2, remain_size, ", \"device_label\":{");
-    rc = check_snprintf_return(rc_of_snprintf, remain_size);
-
-    if (rc != QCLOUD_RET_SUCCESS) {
-        return rc;
-    }
-
-    while ((NULL != pJsonNode) && (NULL != pJsonNode->key)) {
-        rc = put_json_node(jsonBuffer, remain_size, pJsonNode->key, pJsonNode->data, pJsonNode->type);
-        if (rc != QCLOUD_RET_SUCCESS) {
-            return rc;
+    } else {
+        json_writer_object_begin(&writer, "device_label");
+        while ((NULL != pJsonNode) && (NULL != pJsonNode->key)) {
+            rc = put_json_node(&writer, pJsonNode->key, pJsonNode->data, pJsonNode->type);
+            if (rc != QCLOUD_RET_SUCCESS) {
+                return rc;
+            }
+            pJsonNode++;
         }
-        pJsonNode++;
+        json_writer_object_end(&writer);
     }
 
-    rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer) - 1, remain_size, "}},");
-    rc = check_snprintf_return(rc_of_snprintf, remain_size);
-    if (rc != QCLOUD_RET_SUCCESS) {
-        return rc;
-    }
-
-end:
-    if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
-        return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
-    }
-    rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer) - 1, remain_size, "}");
-    rc = check_snprintf_return(rc_of_snprintf, remain_size);
+    json_writer_object_end(&writer);
+    json_writer_object_end(&writer);
 
-    return rc;
+    rc = json_writer_finish(&writer);
+    return rc < 0 ? rc : QCLOUD_RET_SUCCESS;
 }
 
 int IOT_Template_Report_SysInfo(void *handle, char *pJsonDoc, size_t sizeOfBuffer, OnReplyCallback callback, void *userContext, uint32_t timeout_ms)
@@ -718,8 +665,11 @@ int IOT_Template_Yield(void *handle, uint32_t timeout_ms)
 
     handle_template_expired_reply(ptemplate);
 
+    handle_template_report_sched(ptemplate);
+
 #ifdef EVENT_POST_ENABLED
     handle_template_expired_event(ptemplate);
+    handle_template_event_queue(ptemplate);
 #endif
     rc = IOT_MQTT_Yield(ptemplate->mqtt, timeout_ms);
 
@@ -736,7 +686,7 @@ void* IOT_Template_Construct(TemplateInitParams *pParams, void *pMqttClient)
         Log_e("memory not enough to malloc TemplateClient");
     }
 
-    MQTTInitParams mqtt_init_params;
+    MQTTInitParams mqtt_init_params = DEFAULT_MQTTINIT_PARAMS;
     _copy_template_init_params_to_mqtt(&mqtt_init_params, pParams);
 
     mqtt_init_params.event_handle.h_fp = _template_mqtt_event_handler;
@@ -857,8 +807,11 @@ int IOT_Template_Yield_Without_MQTT_Yield(void *handle, uint32_t timeout_ms)
 
     handle_template_expired_reply(ptemplate);
 
+    handle_template_report_sched(ptemplate);
+
 #ifdef EVENT_POST_ENABLED
     handle_template_expired_event(ptemplate);
+    handle_template_event_queue(ptemplate);
 #endif
 
     IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
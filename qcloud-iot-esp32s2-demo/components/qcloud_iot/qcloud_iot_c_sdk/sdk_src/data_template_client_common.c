@@ -20,6 +20,109 @@ extern "C" {
 #include "data_template_client_common.h"
 #include "qcloud_iot_import.h"
 
+#include <string.h>
+
+#define PROPERTY_INDEX_INIT_SIZE    (8)
+
+/* compare key with the string of len chars, which is not '\0' terminated */
+static int _property_key_compare(const char *pKey, const char *pStr, size_t len)
+{
+    int rc = strncmp(pKey, pStr, len);
+    if (rc != 0) {
+        return rc;
+    }
+
+    return (pKey[len] == '\0') ? 0 : 1;
+}
+
+/* position of the first handler whose key is not less than the string */
+static int _property_index_lower_bound(Qcloud_IoT_Template *pTemplate, const char *pKey, size_t keyLen)
+{
+    PropertyHandler **index = pTemplate->inner_data.property_index;
+    int low = 0;
+    int high = pTemplate->inner_data.property_count;
+
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (_property_key_compare(index[mid]->property->key, pKey, keyLen) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+/* position of handler of the property in index, -1 if not registered */
+static int _property_index_find(Qcloud_IoT_Template *pTemplate, DeviceProperty *pProperty)
+{
+    PropertyHandler **handlers = NULL;
+    int count = template_common_find_property(pTemplate, pProperty->key, strlen(pProperty->key), &handlers);
+    int i;
+
+    for (i = 0; i < count; i++) {
+        if (handlers[i]->property == pProperty) {
+            return (int)(handlers - pTemplate->inner_data.property_index) + i;
+        }
+    }
+
+    return -1;
+}
+
+static int _property_index_insert(Qcloud_IoT_Template *pTemplate, PropertyHandler *property_handle)
+{
+    TemplateInnerData *inner = &pTemplate->inner_data;
+    const char *key = property_handle->property->key;
+    int pos;
+
+    if (inner->property_count == inner->property_index_size) {
+        uint32_t size = inner->property_index_size ? inner->property_index_size * 2 : PROPERTY_INDEX_INIT_SIZE;
+        PropertyHandler **index;
+
+        if (size > UINT16_MAX) {
+            Log_e("too many properties registered");
+            return QCLOUD_ERR_FAILURE;
+        }
+
+        index = (PropertyHandler **)HAL_Malloc(size * sizeof(PropertyHandler *));
+        if (NULL == index) {
+            Log_e("run memory malloc is error!");
+            return QCLOUD_ERR_FAILURE;
+        }
+        if (inner->property_count) {
+            memcpy(index, inner->property_index, inner->property_count * sizeof(PropertyHandler *));
+        }
+        if (inner->property_index) {
+            HAL_Free(inner->property_index);
+        }
+        inner->property_index = index;
+        inner->property_index_size = size;
+    }
+
+    // after the handlers of the same key, so they are dispatched in order of registration
+    pos = _property_index_lower_bound(pTemplate, key, strlen(key));
+    while (pos < inner->property_count && !strcmp(inner->property_index[pos]->property->key, key)) {
+        pos++;
+    }
+
+    memmove(&inner->property_index[pos + 1], &inner->property_index[pos],
+            (inner->property_count - pos) * sizeof(PropertyHandler *));
+    inner->property_index[pos] = property_handle;
+    inner->property_count++;
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+static void _property_index_remove(Qcloud_IoT_Template *pTemplate, int pos)
+{
+    TemplateInnerData *inner = &pTemplate->inner_data;
+
+    memmove(&inner->property_index[pos], &inner->property_index[pos + 1],
+            (inner->property_count - pos - 1) * sizeof(PropertyHandler *));
+    inner->property_count--;
+}
+
 /**
  * @brief add registered propery's call back to data_template handle list
  */
@@ -39,6 +142,13 @@ static int _add_property_handle_to_template_list(Qcloud_IoT_Template *pTemplate,
     ListNode *node = list_node_new(property_handle);
     if (NULL == node) {
         Log_e("run list_node_new is error!");
+        HAL_Free(property_handle);
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
+    }
+
+    if (QCLOUD_RET_SUCCESS != _property_index_insert(pTemplate, property_handle)) {
+        HAL_Free(node);
+        HAL_Free(property_handle);
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
     }
     list_rpush(pTemplate->inner_data.property_handle_list, node);
@@ -46,28 +156,50 @@ static int _add_property_handle_to_template_list(Qcloud_IoT_Template *pTemplate,
     IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
 }
 
+int template_common_find_property(Qcloud_IoT_Template *pTemplate, const char *pKey, size_t keyLen,
+                                  PropertyHandler ***pHandlers)
+{
+    PropertyHandler **index = pTemplate->inner_data.property_index;
+    int pos = _property_index_lower_bound(pTemplate, pKey, keyLen);
+    int end = pos;
+
+    while (end < pTemplate->inner_data.property_count &&
+           0 == _property_key_compare(index[end]->property->key, pKey, keyLen)) {
+        end++;
+    }
+
+    *pHandlers = (index != NULL) ? &index[pos] : NULL;
+    return end - pos;
+}
+
 int template_common_check_property_existence(Qcloud_IoT_Template *ptemplate, DeviceProperty *pProperty)
 {
-    ListNode *node;
+    int pos;
 
     HAL_MutexLock(ptemplate->mutex);
-    node = list_find(ptemplate->inner_data.property_handle_list, pProperty);
+    pos = _property_index_find(ptemplate, pProperty);
     HAL_MutexUnlock(ptemplate->mutex);
 
-    return (NULL != node);
+    return (pos >= 0);
 }
 
 int template_common_remove_property(Qcloud_IoT_Template *ptemplate, DeviceProperty *pProperty)
 {
     int rc = QCLOUD_RET_SUCCESS;
 
-    ListNode *node;
+    ListNode *node = NULL;
+    int pos;
+
     HAL_MutexLock(ptemplate->mutex);
-    node = list_find(ptemplate->inner_data.property_handle_list, pProperty);
+    pos = _property_index_find(ptemplate, pProperty);
+    if (pos >= 0) {
+        node = list_find(ptemplate->inner_data.property_handle_list, ptemplate->inner_data.property_index[pos]);
+    }
     if (NULL == node) {
         rc = QCLOUD_ERR_NOT_PROPERTY_EXIST;
         Log_e("Try to remove a non-existent property.");
     } else {
+        _property_index_remove(ptemplate, pos);
         list_remove(ptemplate->inner_data.property_handle_list, node);
     }
     HAL_MutexUnlock(ptemplate->mutex);
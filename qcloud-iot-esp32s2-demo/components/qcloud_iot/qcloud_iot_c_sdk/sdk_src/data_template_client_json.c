@@ -27,6 +27,7 @@ extern "C" {
 #include "lite-utils.h"
 #include "data_template_client_json.h"
 #include "qcloud_iot_export_method.h"
+#include "utils_param_check.h"
 
 
 int check_snprintf_return(int32_t returnCode, size_t maxSizeOfWrite)
@@ -41,49 +42,36 @@ int check_snprintf_return(int32_t returnCode, size_t maxSizeOfWrite)
     return QCLOUD_RET_SUCCESS;
 }
 
-void insert_str(char *pDestStr, char *pSourceStr, int pos)
-{
-    int len = strlen(pDestStr);
-    int nlen = strlen(pSourceStr);
-    int i;
-    for (i = len - 1; i >= pos; --i) {
-        *(pDestStr + i + nlen) = *(pDestStr + i);
-    }
-
-    int n;
-    for (n = 0; n < nlen; n++)
-        *(pDestStr + pos + n) = *pSourceStr++;
-    *(pDestStr + len + nlen) = 0;
-}
-
-
-static int _direct_update_value(char *value, DeviceProperty *pProperty)
+static int _direct_update_value(const json_span_t *value, DeviceProperty *pProperty)
 {
 
     int rc = QCLOUD_RET_SUCCESS;
 
     if (pProperty->type == JBOOL) {
-        rc = LITE_get_boolean(pProperty->data, value);
+        rc = LITE_span_get_boolean(pProperty->data, value);
     } else if (pProperty->type == JINT32) {
-        rc = LITE_get_int32(pProperty->data, value);
+        rc = LITE_span_get_int32(pProperty->data, value);
     } else if (pProperty->type == JINT16) {
-        rc = LITE_get_int16(pProperty->data, value);
+        rc = LITE_span_get_int16(pProperty->data, value);
     } else if (pProperty->type == JINT8) {
-        rc = LITE_get_int8(pProperty->data, value);
+        rc = LITE_span_get_int8(pProperty->data, value);
     } else if (pProperty->type == JUINT32) {
-        rc = LITE_get_uint32(pProperty->data, value);
+        rc = LITE_span_get_uint32(pProperty->data, value);
     } else if (pProperty->type == JUINT16) {
-        rc = LITE_get_uint16(pProperty->data, value);
+        rc = LITE_span_get_uint16(pProperty->data, value);
     } else if (pProperty->type == JUINT8) {
-        rc = LITE_get_uint8(pProperty->data, value);
+        rc = LITE_span_get_uint8(pProperty->data, value);
     } else if (pProperty->type == JFLOAT) {
-        rc = LITE_get_float(pProperty->data, value);
+        rc = LITE_span_get_float(pProperty->data, value);
     } else if (pProperty->type == JDOUBLE) {
-        rc = LITE_get_double(pProperty->data, value);
+        rc = LITE_span_get_double(pProperty->data, value);
     } else if (pProperty->type == JSTRING) {
-        rc = LITE_get_string(pProperty->data, value, pProperty->data_buff_len);
+        // truncated to data_buff_len as LITE_get_string does
+        int len = Min(value->len, pProperty->data_buff_len);
+        memcpy(pProperty->data, value->str, len);
+        ((char *)pProperty->data)[len] = '\0';
     } else if (pProperty->type == JOBJECT) {
-        Log_d("Json type wait to be deal,%s", value);
+        Log_d("Json type wait to be deal,%.*s", value->len, value->str);
     } else {
         Log_e("pProperty type unknow,%d", pProperty->type);
     }
@@ -106,245 +94,218 @@ static int32_t _add_client_token(char *pJsonDocument, size_t maxSizeOfJsonDocume
     return rc_of_snprintf;
 }
 
-int put_json_node(char *jsonBuffer, size_t sizeOfBuffer, const char *pKey, void *pData, JsonDataType type)
+static int _put_json_value(json_writer_t *pWriter, const char *pKey, void *pData, JsonDataType type,
+                           bool boolAsNumber)
 {
-
-    int rc;
-    int32_t rc_of_snprintf = 0;
-    size_t remain_size = 0;
-
-    if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
-        return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
-    }
-
-    rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "\"%s\":", pKey);
-    rc = check_snprintf_return(rc_of_snprintf, remain_size);
-    if (rc != QCLOUD_RET_SUCCESS) {
-        return rc;
+    if (pData == NULL) {
+        json_writer_null(pWriter, pKey);
+        return pWriter->err;
     }
 
-    if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
-        return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
+    switch (type) {
+        case JINT32:
+            json_writer_int32(pWriter, pKey, *(int32_t *)pData);
+            break;
+        case JINT16:
+            json_writer_int32(pWriter, pKey, *(int16_t *)pData);
+            break;
+        case JINT8:
+            json_writer_int32(pWriter, pKey, *(int8_t *)pData);
+            break;
+        case JUINT32:
+            json_writer_uint32(pWriter, pKey, *(uint32_t *)pData);
+            break;
+        case JUINT16:
+            json_writer_uint32(pWriter, pKey, *(uint16_t *)pData);
+            break;
+        case JUINT8:
+            json_writer_uint32(pWriter, pKey, *(uint8_t *)pData);
+            break;
+        case JDOUBLE:
+            json_writer_double(pWriter, pKey, *(double *)pData);
+            break;
+        case JFLOAT:
+            json_writer_float(pWriter, pKey, *(float *)pData);
+            break;
+        case JBOOL:
+            if (boolAsNumber) {
+                json_writer_uint32(pWriter, pKey, *(bool *)pData ? 1 : 0);
+            } else {
+                json_writer_bool(pWriter, pKey, *(bool *)pData);
+            }
+            break;
+        case JSTRING:
+            json_writer_string(pWriter, pKey, (char *)pData);
+            break;
+        case JOBJECT:
+            json_writer_raw(pWriter, pKey, (char *)pData);
+            break;
+        default:
+            return QCLOUD_ERR_INVAL;
     }
 
-    if (pData == NULL) {
-        rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "null,");
-    } else {
-        if (type == JINT32) {
-            rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "%"
-                                          PRIi32
-                                          ",", *(int32_t *) (pData));
-        } else if (type == JINT16) {
-            rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "%"
-                                          PRIi16
-                                          ",", *(int16_t *) (pData));
-        } else if (type == JINT8) {
-            rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "%"
-                                          PRIi8
-                                          ",", *(int8_t *) (pData));
-        } else if (type == JUINT32) {
-            rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "%"
-                                          PRIu32
-                                          ",", *(uint32_t *) (pData));
-        } else if (type == JUINT16) {
-            rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "%"
-                                          PRIu16
-                                          ",", *(uint16_t *) (pData));
-        } else if (type == JUINT8) {
-            rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "%"
-                                          PRIu8
-                                          ",", *(uint8_t *) (pData));
-        } else if (type == JDOUBLE) {
-            rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "%f,", *(double *) (pData));
-        } else if (type == JFLOAT) {
-            rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "%f,", *(float *) (pData));
-        } else if (type == JBOOL) {
-            rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "%s,",
-                                          *(bool *) (pData) ? "true" : "false");
-        } else if (type == JSTRING) {
-            rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "\"%s\",", (char *) (pData));
-        } else if (type == JOBJECT) {
-            rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "%s,", (char *) (pData));
-        }
-    }
+    return pWriter->err;
+}
 
-    rc = check_snprintf_return(rc_of_snprintf, remain_size);
+int put_json_node(json_writer_t *pWriter, const char *pKey, void *pData, JsonDataType type)
+{
+    return _put_json_value(pWriter, pKey, pData, type, false);
+}
 
-    return rc;
+int template_put_json_node(json_writer_t *pWriter, const char *pKey, void *pData, JsonDataType type)
+{
+    return _put_json_value(pWriter, pKey, pData, type, true);
 }
 
-int template_put_json_node(char *jsonBuffer, size_t sizeOfBuffer, const char *pKey, void *pData, JsonDataType type)
+int generate_client_token(char *pStrBuffer, size_t sizeOfBuffer, uint32_t *tokenNumber)
 {
+    return _add_client_token(pStrBuffer, sizeOfBuffer, tokenNumber);
+}
 
-    int rc;
-    int32_t rc_of_snprintf = 0;
-    size_t remain_size = 0;
+void build_empty_json(uint32_t *tokenNumber, char *pJsonBuffer)
+{
+    HAL_Snprintf(pJsonBuffer, MAX_SIZE_OF_JSON_WITH_CLIENT_TOKEN, "{\"clientToken\":\"%s-%u\"}", iot_device_info_get()->product_id, (*tokenNumber)++);
+}
 
-    if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
-        return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
+int template_json_parse(TemplateJsonDoc *pDoc, char *pJsonDoc)
+{
+    POINTER_SANITY_CHECK(pDoc, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(pJsonDoc, QCLOUD_ERR_INVAL);
+
+    pDoc->json = pJsonDoc;
+    pDoc->token_count = json_tokenize(pJsonDoc, strlen(pJsonDoc), pDoc->tokens, QCLOUD_IOT_TEMPLATE_MAX_JSON_TOKENS);
+    if (pDoc->token_count < 0) {
+        Log_e("tokenize json failed: %d", pDoc->token_count);
+        pDoc->token_count = 0;
+        return QCLOUD_ERR_JSON_PARSE;
     }
 
-    rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "\"%s\":", pKey);
-    rc = check_snprintf_return(rc_of_snprintf, remain_size);
-    if (rc != QCLOUD_RET_SUCCESS) {
-        return rc;
+    if (pDoc->tokens[0].type != JSOBJECT) {
+        Log_e("json is not an object");
+        pDoc->token_count = 0;
+        return QCLOUD_ERR_JSON_PARSE;
     }
 
-    if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
-        return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
+    return QCLOUD_RET_SUCCESS;
+}
+
+/* find value token by key path of object, -1 if not found */
+static int _find_value(TemplateJsonDoc *pDoc, int object, const char *pKey)
+{
+    if (pDoc->token_count <= 0) {
+        return -1;
     }
 
-    if (pData == NULL) {
-        rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "null,");
-    } else {
-        if (type == JINT32) {
-            rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "%"
-                                          PRIi32
-                                          ",", *(int32_t *) (pData));
-        } else if (type == JINT16) {
-            rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "%"
-                                          PRIi16
-                                          ",", *(int16_t *) (pData));
-        } else if (type == JINT8) {
-            rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "%"
-                                          PRIi8
-                                          ",", *(int8_t *) (pData));
-        } else if (type == JUINT32) {
-            rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "%"
-                                          PRIu32
-                                          ",", *(uint32_t *) (pData));
-        } else if (type == JUINT16) {
-            rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "%"
-                                          PRIu16
-                                          ",", *(uint16_t *) (pData));
-        } else if (type == JUINT8) {
-            rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "%"
-                                          PRIu8
-                                          ",", *(uint8_t *) (pData));
-        } else if (type == JDOUBLE) {
-            rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "%f,", *(double *) (pData));
-        } else if (type == JFLOAT) {
-            rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "%f,", *(float *) (pData));
-        } else if (type == JBOOL) {
-            rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "%u,",
-                                          *(bool *) (pData) ? 1 : 0);
-        } else if (type == JSTRING) {
-            rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "\"%s\",", (char *) (pData));
-        } else if (type == JOBJECT) {
-            rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "%s,", (char *) (pData));
-        }
+    return json_token_lookup(pDoc->json, pDoc->tokens, object, pKey);
+}
+
+bool template_json_span_of(TemplateJsonDoc *pDoc, int object, const char *pKey, json_span_t *pSpan)
+{
+    int index = _find_value(pDoc, object, pKey);
+    if (index < 0) {
+        return false;
     }
 
-    rc = check_snprintf_return(rc_of_snprintf, remain_size);
+    pSpan->str = pDoc->json + pDoc->tokens[index].start;
+    pSpan->len = pDoc->tokens[index].end - pDoc->tokens[index].start;
+    pSpan->type = pDoc->tokens[index].type;
 
-    return rc;
+    return true;
 }
 
-int generate_client_token(char *pStrBuffer, size_t sizeOfBuffer, uint32_t *tokenNumber)
+/* copy string value into buffer of caller, fail if it is not long enough */
+static bool _parse_string(TemplateJsonDoc *pDoc, const char *pKey, char *pValue, size_t size)
 {
-    return _add_client_token(pStrBuffer, sizeOfBuffer, tokenNumber);
+    json_span_t span;
+
+    if (!template_json_span_of(pDoc, 0, pKey, &span)) {
+        return false;
+    }
+
+    if (LITE_span_get_string(pValue, size, &span) != QCLOUD_RET_SUCCESS) {
+        Log_e("value of %s is too long: %d", pKey, span.len);
+        return false;
+    }
+
+    return true;
 }
 
-void build_empty_json(uint32_t *tokenNumber, char *pJsonBuffer)
+static bool _parse_object(TemplateJsonDoc *pDoc, const char *pKey, int *pObject)
 {
-    HAL_Snprintf(pJsonBuffer, MAX_SIZE_OF_JSON_WITH_CLIENT_TOKEN, "{\"clientToken\":\"%s-%u\"}", iot_device_info_get()->product_id, (*tokenNumber)++);
+    *pObject = _find_value(pDoc, 0, pKey);
+    return (*pObject < 0 || pDoc->tokens[*pObject].type != JSOBJECT) ? false : true;
 }
 
-bool parse_client_token(char *pJsonDoc, char **pClientToken)
+bool parse_client_token(TemplateJsonDoc *pDoc, char *pClientToken, size_t size)
 {
-    *pClientToken = LITE_json_value_of(CLIENT_TOKEN_FIELD, pJsonDoc);
-    return *pClientToken == NULL ? false : true;
+    return _parse_string(pDoc, CLIENT_TOKEN_FIELD, pClientToken, size);
 }
 
-bool parse_action_id(char *pJsonDoc, char **pActionID)
+bool parse_action_id(TemplateJsonDoc *pDoc, char *pActionID, size_t size)
 {
-    *pActionID = LITE_json_value_of(ACTION_ID_FIELD, pJsonDoc);
-    return *pActionID == NULL ? false : true;
+    return _parse_string(pDoc, ACTION_ID_FIELD, pActionID, size);
 }
 
-bool parse_time_stamp(char *pJsonDoc, int32_t *pTimestamp)
+bool parse_time_stamp(TemplateJsonDoc *pDoc, int32_t *pTimestamp)
 {
+    json_span_t span;
 
-    bool ret = false;
-
-    char *timestamp = LITE_json_value_of(TIME_STAMP_FIELD, pJsonDoc);
-    if (timestamp == NULL) return false;
+    if (!template_json_span_of(pDoc, 0, TIME_STAMP_FIELD, &span)) {
+        return false;
+    }
 
-    if (sscanf(timestamp, "%" SCNu32, pTimestamp) != 1) {
+    if (LITE_span_get_uint32((uint32_t *)pTimestamp, &span) != QCLOUD_RET_SUCCESS) {
         Log_e("parse code failed, errCode: %d", QCLOUD_ERR_JSON_PARSE);
-    } else {
-        ret = true;
+        return false;
     }
 
-    HAL_Free(timestamp);
-
-    return ret;
+    return true;
 }
 
-bool parse_action_input(char *pJsonDoc, char **pActionInput)
+bool parse_action_input(TemplateJsonDoc *pDoc, int *pActionInput)
 {
-    *pActionInput = LITE_json_value_of(CMD_CONTROL_PARA, pJsonDoc);
-    return *pActionInput == NULL ? false : true;
+    return _parse_object(pDoc, CMD_CONTROL_PARA, pActionInput);
 }
 
-bool parse_code_return(char *pJsonDoc, int32_t *pCode)
+bool parse_code_return(TemplateJsonDoc *pDoc, int32_t *pCode)
 {
+    json_span_t span;
 
-    bool ret = false;
-
-    char *code = LITE_json_value_of(REPLY_CODE, pJsonDoc);
-    if (code == NULL) return false;
+    if (!template_json_span_of(pDoc, 0, REPLY_CODE, &span)) {
+        return false;
+    }
 
-    if (sscanf(code, "%" SCNi32, pCode) != 1) {
+    if (LITE_span_get_int32(pCode, &span) != QCLOUD_RET_SUCCESS) {
         Log_e("parse code failed, errCode: %d", QCLOUD_ERR_JSON_PARSE);
-    } else {
-        ret = true;
+        return false;
     }
 
-    HAL_Free(code);
-
-    return ret;
+    return true;
 }
 
-bool parse_status_return(char *pJsonDoc, char **pStatus)
+bool parse_status_return(TemplateJsonDoc *pDoc, json_span_t *pStatus)
 {
-    *pStatus = LITE_json_value_of(REPLY_STATUS, pJsonDoc);
-    return *pStatus == NULL ? false : true;
+    return template_json_span_of(pDoc, 0, REPLY_STATUS, pStatus);
 }
 
-bool update_value_if_key_match(char *pJsonDoc, DeviceProperty *pProperty)
+int update_property_value(const json_span_t *pValue, DeviceProperty *pProperty)
 {
-
-    bool ret = false;
-
-    char* property_data = LITE_json_value_of(pProperty->key, pJsonDoc);
-    if ((property_data == NULL) || !(strncmp(property_data, "null", 4))
-        || !(strncmp(property_data, "NULL", 4))) {
-    } else {
-        _direct_update_value(property_data, pProperty);
-        ret = true;
-        HAL_Free(property_data);
-    }
-
-    return ret;
+    return _direct_update_value(pValue, pProperty);
 }
 
-bool parse_template_method_type(char *pJsonDoc, char **pMethod)
+bool parse_template_method_type(TemplateJsonDoc *pDoc, char *pMethod, size_t size)
 {
-    *pMethod = LITE_json_value_of(METHOD_FIELD, pJsonDoc);
-    return *pMethod == NULL ? false : true;
+    return _parse_string(pDoc, METHOD_FIELD, pMethod, size);
 }
 
-bool parse_template_get_control(char *pJsonDoc, char **control)
+bool parse_template_get_control(TemplateJsonDoc *pDoc, int *control)
 {
-    *control = LITE_json_value_of(GET_CONTROL_PARA, pJsonDoc);
-    return *control == NULL ? false : true;
+    return _parse_object(pDoc, GET_CONTROL_PARA, control);
 }
 
-bool parse_template_cmd_control(char *pJsonDoc, char **control)
+bool parse_template_cmd_control(TemplateJsonDoc *pDoc, int *control)
 {
-    *control = LITE_json_value_of(CMD_CONTROL_PARA, pJsonDoc);
-    return *control == NULL ? false : true;
+    return _parse_object(pDoc, CMD_CONTROL_PARA, control);
 }
 
 
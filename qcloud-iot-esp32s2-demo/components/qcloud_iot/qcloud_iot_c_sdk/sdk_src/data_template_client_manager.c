@@ -21,6 +21,7 @@ extern "C" {
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stddef.h>
 
 #include "qcloud_iot_import.h"
 #include "utils_param_check.h"
@@ -28,11 +29,12 @@ extern "C" {
 
 #include "data_template_client.h"
 #include "data_template_client_json.h"
+#include "data_template_client_common.h"
+#include "data_template_event.h"
+#include "utils_number.h"
 
 
-typedef void (*TraverseTemplateHandle)(Qcloud_IoT_Template *pTemplate, ListNode **node, List *list, const char *pClientToken, const char *pType);
 
-static char sg_template_cloud_rcv_buf[CLOUD_IOT_JSON_RX_BUF_LEN];
 static char sg_template_clientToken[MAX_SIZE_OF_CLIENT_TOKEN];
 
 /**
@@ -60,43 +62,95 @@ static char sg_template_clientToken[MAX_SIZE_OF_CLIENT_TOKEN];
 //}
 
 
+/* numeric suffix of clientToken "productId-N" generated by SDK, 0 for other tokens */
+static uint32_t _client_token_key(const char *pClientToken)
+{
+    const char *suffix = strrchr(pClientToken, '-');
+    uint32_t key = 0;
+    size_t len;
+
+    if (suffix == NULL) {
+        return 0;
+    }
+
+    suffix++;
+    len = strlen(suffix);
+    if (len == 0 || utils_strn_to_uint32(suffix, len, &key) != (int)len) {
+        return 0;
+    }
+
+    return key;
+}
+
+/* slot of the request waiting for reply of clientToken, probing from the slot of its key, call with mutex locked */
+static Request *_find_reply_slot(Qcloud_IoT_Template *pTemplate, uint32_t key, const char *pClientToken)
+{
+    Request *request;
+    int i;
+
+    if (pTemplate->inner_data.reply_count == 0) {
+        return NULL;
+    }
+
+    for (i = 0; i < TEMPLATE_REPLY_SLOT_COUNT; i++) {
+        request = &pTemplate->inner_data.reply_slots[(key + i) & (TEMPLATE_REPLY_SLOT_COUNT - 1)];
+        if (request->in_use && request->token_key == key && strcmp(request->client_token, pClientToken) == 0) {
+            return request;
+        }
+    }
+
+    return NULL;
+}
+
+/* release slot of request, call with mutex locked */
+static void _free_reply_slot(Qcloud_IoT_Template *pTemplate, Request *request)
+{
+    request->in_use = false;
+    pTemplate->inner_data.reply_count--;
+}
+
 /**
-* @brief add request to data_template request wait for reply list
+* @brief add request to the slot indexed by its clientToken, and wait for reply
 */
 static int _add_request_to_template_list(Qcloud_IoT_Template *pTemplate, const char *pClientToken, RequestParams *pParams)
 {
     IOT_FUNC_ENTRY;
 
+    uint32_t key = _client_token_key(pClientToken);
+    size_t token_len = strlen(pClientToken);
+    Request *request = NULL;
+    int i;
+
     HAL_MutexLock(pTemplate->mutex);
-    if (pTemplate->inner_data.reply_list->len >= MAX_APPENDING_REQUEST_AT_ANY_GIVEN_TIME) {
+    if (pTemplate->inner_data.reply_count >= MAX_APPENDING_REQUEST_AT_ANY_GIVEN_TIME) {
         HAL_MutexUnlock(pTemplate->mutex);
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_MAX_APPENDING_REQUEST);
     }
 
-    Request *request = (Request *)HAL_Malloc(sizeof(Request));
-    if (NULL == request) {
-        HAL_MutexUnlock(pTemplate->mutex);
-        Log_e("run memory malloc is error!");
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
+    // tokens are sequential, so the slot of key is free unless a request of 16 tokens before is still waiting
+    for (i = 0; i < TEMPLATE_REPLY_SLOT_COUNT; i++) {
+        request = &pTemplate->inner_data.reply_slots[(key + i) & (TEMPLATE_REPLY_SLOT_COUNT - 1)];
+        if (!request->in_use) {
+            break;
+        }
     }
 
     request->callback = pParams->request_callback;
-    strncpy(request->client_token, pClientToken, MAX_SIZE_OF_CLIENT_TOKEN);
+    if (token_len > MAX_SIZE_OF_CLIENT_TOKEN - 1) {
+        token_len = MAX_SIZE_OF_CLIENT_TOKEN - 1;
+    }
+    memcpy(request->client_token, pClientToken, token_len);
+    request->client_token[token_len] = '\0';
+    request->token_key = key;
+    request->in_use = true;
 
     request->user_context = pParams->user_context;
     request->method = pParams->method;
+    pTemplate->inner_data.reply_count++;
 
-    InitTimer(&(request->timer));
-    countdown(&(request->timer), pParams->timeout_sec);
-
-    ListNode *node = list_node_new(request);
-    if (NULL == node) {
-        HAL_MutexUnlock(pTemplate->mutex);
-        Log_e("run list_node_new is error!");
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
-    }
-
-    list_rpush(pTemplate->inner_data.reply_list, node);
+    timer_wheel_entry_init(&request->timer_entry);
+    timer_wheel_add(TEMPLATE_TIMER_WHEEL(pTemplate), &request->timer_entry, pParams->timeout_sec * 1000,
+                    &pTemplate->inner_data.reply_expired);
 
     HAL_MutexUnlock(pTemplate->mutex);
 
@@ -141,7 +195,8 @@ int _publish_to_template_upstream_topic(Qcloud_IoT_Template *pTemplate, Method m
 /**
  * @brief fill method json filed with the value of RequestParams and Method
  */
-static int _set_template_json_type(char *pJsonDoc, size_t sizeOfBuffer, Method method)
+/* add method into the root object of document, end is the offset after its closing brace */
+static int _set_template_json_type(char *pJsonDoc, size_t sizeOfBuffer, size_t end, bool empty, Method method)
 {
     IOT_FUNC_ENTRY;
 
@@ -173,93 +228,50 @@ static int _set_template_json_type(char *pJsonDoc, size_t sizeOfBuffer, Method m
     if (rc != QCLOUD_RET_SUCCESS)
         IOT_FUNC_EXIT_RC(rc);
 
-    size_t json_len = strlen(pJsonDoc);
-    size_t remain_size = sizeOfBuffer - json_len;
-
+    // members of JSON object are unordered, so method is put before the closing brace in place,
+    // rather than shifting the whole document after the opening brace
     char json_node_str[64] = {0};
-    HAL_Snprintf(json_node_str, 64, "\"method\":\"%s\", ", method_str);
+    int json_node_len = HAL_Snprintf(json_node_str, 64, "%s\"method\":\"%s\"}", empty ? "" : ",", method_str);
 
-    size_t json_node_len = strlen(json_node_str);
-    if (json_node_len >= remain_size - 1) {
+    if (json_node_len < 0 || end - 1 + json_node_len >= sizeOfBuffer) {
         rc = QCLOUD_ERR_INVAL;
     } else {
-        insert_str(pJsonDoc, json_node_str, 1);
+        memcpy(pJsonDoc + end - 1, json_node_str, json_node_len + 1);
     }
 
     IOT_FUNC_EXIT_RC(rc);
 }
 
-/**
- * @brief iterator list and call traverseHandle for each node
- */
-static void _traverse_template_list(Qcloud_IoT_Template *pTemplate, List *list, const char *pClientToken, const char *pType, TraverseTemplateHandle traverseHandle)
+static void _set_control_clientToken(const char *pClientToken)
 {
-    IOT_FUNC_ENTRY;
-
-    HAL_MutexLock(pTemplate->mutex);
-
-    if (list->len) {
-        ListIterator *iter;
-        ListNode *node = NULL;
-
-        if (NULL == (iter = list_iterator_new(list, LIST_TAIL))) {
-            HAL_MutexUnlock(pTemplate->mutex);
-            IOT_FUNC_EXIT;
-        }
-
-        for (;;) {
-            node = list_iterator_next(iter);
-            if (NULL == node) {
-                break;
-            }
-
-            if (NULL == node->val) {
-                Log_e("node's value is invalid!");
-                continue;
-            }
-
-            traverseHandle(pTemplate, &node, list, pClientToken, pType);
-        }
-
-        list_iterator_destroy(iter);
-    }
-    HAL_MutexUnlock(pTemplate->mutex);
+    memset(sg_template_clientToken, '\0', MAX_SIZE_OF_CLIENT_TOKEN);
+    strncpy(sg_template_clientToken, pClientToken, MAX_SIZE_OF_CLIENT_TOKEN);
+}
 
-    IOT_FUNC_EXIT;
+char * get_control_clientToken(void)
+{
+    return sg_template_clientToken;
 }
 
 /**
- * @brief handle the timeout request wait for reply
+ * @brief remove timers of the nodes in list from timer wheel before the list is destroyed
  */
-static void _handle_template_expired_reply_callback(Qcloud_IoT_Template *pTemplate, ListNode **node, List *list, const char *pClientToken, const char *pType)
+static void _cancel_template_list_timers(Qcloud_IoT_Template *pTemplate, List *list, size_t timer_offset)
 {
-    IOT_FUNC_ENTRY;
+    ListIterator *iter;
+    ListNode *node;
 
-    Request *request = (Request *)(*node)->val;
-    if (NULL == request)
-        IOT_FUNC_EXIT;
+    if (NULL == (iter = list_iterator_new(list, LIST_TAIL))) {
+        return;
+    }
 
-    if (expired(&request->timer)) {
-        if (request->callback != NULL) {
-            request->callback(pTemplate, request->method, ACK_TIMEOUT, sg_template_cloud_rcv_buf, request);
+    while (NULL != (node = list_iterator_next(iter))) {
+        if (NULL != node->val) {
+            timer_wheel_del(TEMPLATE_TIMER_WHEEL(pTemplate), (TimerWheelEntry *)((char *)node->val + timer_offset));
         }
-
-        list_remove(list, *node);
-        *node = NULL;
     }
 
-    IOT_FUNC_EXIT;
-}
-
-static void _set_control_clientToken(const char *pClientToken)
-{
-    memset(sg_template_clientToken, '\0', MAX_SIZE_OF_CLIENT_TOKEN);
-    strncpy(sg_template_clientToken, pClientToken, MAX_SIZE_OF_CLIENT_TOKEN);
-}
-
-char * get_control_clientToken(void)
-{
-    return sg_template_clientToken;
+    list_iterator_destroy(iter);
 }
 
 void qcloud_iot_template_reset(void *pClient)
@@ -267,6 +279,7 @@ void qcloud_iot_template_reset(void *pClient)
     POINTER_SANITY_CHECK_RTN(pClient);
 
     Qcloud_IoT_Template *template_client = (Qcloud_IoT_Template *)pClient;
+    int i;
 
     //_unsubscribe_template_downstream_topic(); //new mem need be malloced whick will leaked
 
@@ -275,12 +288,29 @@ void qcloud_iot_template_reset(void *pClient)
         template_client->inner_data.property_handle_list = NULL;
     }
 
-    if (template_client->inner_data.reply_list) {
-        list_destroy(template_client->inner_data.reply_list);
-        template_client->inner_data.reply_list = NULL;
+    if (template_client->inner_data.property_index) {
+        HAL_Free(template_client->inner_data.property_index);
+        template_client->inner_data.property_index = NULL;
+    }
+    template_client->inner_data.property_count = 0;
+    template_client->inner_data.property_index_size = 0;
+
+    template_report_sched_deinit(template_client);
+
+    for (i = 0; i < TEMPLATE_REPLY_SLOT_COUNT; i++) {
+        if (template_client->inner_data.reply_slots[i].in_use) {
+            timer_wheel_del(TEMPLATE_TIMER_WHEEL(template_client), &template_client->inner_data.reply_slots[i].timer_entry);
+            template_client->inner_data.reply_slots[i].in_use = false;
+        }
     }
+    template_client->inner_data.reply_count = 0;
+
+#ifdef EVENT_POST_ENABLED
+    template_event_queue_deinit(template_client);
+#endif
 
     if (template_client->inner_data.event_list) {
+        _cancel_template_list_timers(template_client, template_client->inner_data.event_list, offsetof(sEventReply, timer_entry));
         list_destroy(template_client->inner_data.event_list);
         template_client->inner_data.event_list = NULL;
     }
@@ -308,14 +338,14 @@ int qcloud_iot_template_init(Qcloud_IoT_Template *pTemplate)
         Log_e("no memory to allocate property_handle_list");
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
     }
+    pTemplate->inner_data.property_index = NULL;
+    pTemplate->inner_data.property_count = 0;
+    pTemplate->inner_data.property_index_size = 0;
+    pTemplate->inner_data.report_sched = NULL;
 
-    pTemplate->inner_data.reply_list = list_new();
-    if (pTemplate->inner_data.reply_list) {
-        pTemplate->inner_data.reply_list->free = HAL_Free;
-    } else {
-        Log_e("no memory to allocate reply_list");
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
-    }
+    memset(pTemplate->inner_data.reply_slots, 0, sizeof(pTemplate->inner_data.reply_slots));
+    pTemplate->inner_data.reply_count = 0;
+    timer_wheel_list_init(&pTemplate->inner_data.reply_expired);
 
     pTemplate->inner_data.event_list = list_new();
     if (pTemplate->inner_data.event_list) {
@@ -324,6 +354,8 @@ int qcloud_iot_template_init(Qcloud_IoT_Template *pTemplate)
         Log_e("no memory to allocate event_list");
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
     }
+    timer_wheel_list_init(&pTemplate->inner_data.event_expired);
+    pTemplate->inner_data.event_queue = NULL;
 
     pTemplate->inner_data.action_handle_list = list_new();
     if (pTemplate->inner_data.action_handle_list) {
@@ -340,7 +372,25 @@ void handle_template_expired_reply(Qcloud_IoT_Template *pTemplate)
 {
     IOT_FUNC_ENTRY;
 
-    _traverse_template_list(pTemplate, pTemplate->inner_data.reply_list, NULL, NULL, _handle_template_expired_reply_callback);
+    TimerWheelEntry *entry;
+    Request request;
+
+    /* only requests whose deadline is passed are visited, callback is called on a copy out of mutex,
+     * as it may send another request */
+    HAL_MutexLock(pTemplate->mutex);
+    while (NULL != (entry = timer_wheel_pop_expired(TEMPLATE_TIMER_WHEEL(pTemplate),
+                                                     &pTemplate->inner_data.reply_expired))) {
+        request = *TIMER_WHEEL_ENTRY(entry, Request, timer_entry);
+        _free_reply_slot(pTemplate, TIMER_WHEEL_ENTRY(entry, Request, timer_entry));
+        HAL_MutexUnlock(pTemplate->mutex);
+
+        if (request.callback != NULL) {
+            request.callback(pTemplate, request.method, ACK_TIMEOUT, "", &request);
+        }
+
+        HAL_MutexLock(pTemplate->mutex);
+    }
+    HAL_MutexUnlock(pTemplate->mutex);
 
     IOT_FUNC_EXIT;
 }
@@ -354,18 +404,26 @@ int send_template_request(Qcloud_IoT_Template *pTemplate, RequestParams *pParams
     POINTER_SANITY_CHECK(pJsonDoc, QCLOUD_ERR_INVAL);
     POINTER_SANITY_CHECK(pParams, QCLOUD_ERR_INVAL);
 
-    char* client_token = NULL;
+    char client_token[MAX_SIZE_OF_CLIENT_TOKEN];
+    size_t root_end;
+    bool root_empty;
 
     // parse clientToken in pJsonDoc, return err if parse failed
-    if (!parse_client_token(pJsonDoc, &client_token)) {
+    HAL_MutexLock(pTemplate->mutex);
+    if (template_json_parse(&pTemplate->inner_data.tx_doc, pJsonDoc) != QCLOUD_RET_SUCCESS
+        || !parse_client_token(&pTemplate->inner_data.tx_doc, client_token, sizeof(client_token))) {
+        HAL_MutexUnlock(pTemplate->mutex);
         Log_e("fail to parse client token!");
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_INVAL);
     }
+    root_end = pTemplate->inner_data.tx_doc.tokens[0].end;
+    root_empty = (pTemplate->inner_data.tx_doc.tokens[0].size == 0);
+    HAL_MutexUnlock(pTemplate->mutex);
 
     if (rc != QCLOUD_RET_SUCCESS)
         IOT_FUNC_EXIT_RC(rc);
 
-    rc = _set_template_json_type(pJsonDoc, sizeOfBuffer, pParams->method);
+    rc = _set_template_json_type(pJsonDoc, sizeOfBuffer, root_end, root_empty, pParams->method);
     if (rc != QCLOUD_RET_SUCCESS)
         IOT_FUNC_EXIT_RC(rc);
 
@@ -377,49 +435,51 @@ int send_template_request(Qcloud_IoT_Template *pTemplate, RequestParams *pParams
         rc = _add_request_to_template_list(pTemplate, client_token, pParams);
     }
 
-    HAL_Free(client_token);
-
     IOT_FUNC_EXIT_RC(rc);
 }
 
-static void _handle_control(Qcloud_IoT_Template *pTemplate, char* control_str)
+static void _handle_control(Qcloud_IoT_Template *pTemplate, TemplateJsonDoc *pDoc, int control)
 {
     IOT_FUNC_ENTRY;
-    if (pTemplate->inner_data.property_handle_list->len) {
-        ListIterator *iter;
-        ListNode *node = NULL;
-        PropertyHandler *property_handle = NULL;
-
-        if (NULL == (iter = list_iterator_new(pTemplate->inner_data.property_handle_list, LIST_TAIL))) {
-            HAL_MutexUnlock(pTemplate->mutex);
-            IOT_FUNC_EXIT;
-        }
-
-        for (;;) {
-            node = list_iterator_next(iter);
-            if (NULL == node) {
-                break;
+    if (pTemplate->inner_data.property_count) {
+        json_token_t *tokens = pDoc->tokens;
+        json_token_t *tok = &tokens[control];
+        char *control_str = pDoc->json + tok->start;
+        size_t control_len = tok->end - tok->start;
+        char last_char;
+        PropertyHandler **handlers;
+        json_span_t value;
+        int key, count, i, n;
+
+        // control object is terminated in place for the callbacks
+        backup_json_str_last_char(pDoc->json, tok->end, last_char);
+
+        // walk the keys of control once, each key is dispatched by binary search in the sorted property index
+        for (key = control + 1, n = 0; n < tok->size; key = tokens[key].next, n++) {
+            if (tokens[key + 1].type == JSNULL) {
+                continue;
             }
 
-            property_handle = (PropertyHandler *)(node->val);
-            if (NULL == property_handle) {
-                Log_e("node's value is invalid!");
+            count = template_common_find_property(pTemplate, pDoc->json + tokens[key].start,
+                                                  tokens[key].end - tokens[key].start, &handlers);
+            if (count == 0) {
                 continue;
             }
 
-            if (property_handle->property != NULL) {
-                if (update_value_if_key_match(control_str, property_handle->property)) {
+            value.str = pDoc->json + tokens[key + 1].start;
+            value.len = tokens[key + 1].end - tokens[key + 1].start;
+            value.type = tokens[key + 1].type;
 
-                    if (property_handle->callback != NULL) {
-                        property_handle->callback(pTemplate, control_str, strlen(control_str), property_handle->property);
-                    }
-                    node = NULL;
+            for (i = 0; i < count; i++) {
+                if (update_property_value(&value, handlers[i]->property) != QCLOUD_RET_SUCCESS) {
+                    Log_e("invalid value of property %s: %.*s", handlers[i]->property->key, value.len, value.str);
+                }
+                if (handlers[i]->callback != NULL) {
+                    handlers[i]->callback(pTemplate, control_str, control_len, handlers[i]->property);
                 }
             }
-
         }
-
-        list_iterator_destroy(iter);
+        restore_json_str_last_char(pDoc->json, tok->end, last_char);
     }
 
     IOT_FUNC_EXIT;
@@ -427,50 +487,63 @@ static void _handle_control(Qcloud_IoT_Template *pTemplate, char* control_str)
 
 
 
-static void _handle_template_reply_callback(Qcloud_IoT_Template *pTemplate, ListNode **node, List *list, const char *pClientToken, const char *pType)
+/**
+ * @brief find the request of reply by clientToken in slots, and call its callback
+ */
+/* pJsonDoc is the payload of reply message, valid until the message handler returns */
+static void _handle_template_reply(Qcloud_IoT_Template *pTemplate, const char *pClientToken, const char *pType,
+                                   const char *pJsonDoc)
 {
     IOT_FUNC_ENTRY;
 
-    Request *request = (Request *)(*node)->val;
-    if (NULL == request)
-        IOT_FUNC_EXIT;
+    Request *slot;
+    Request request;
 
-    if (strcmp(request->client_token, pClientToken) == 0) {
-        ReplyAck status = ACK_NONE;
+    HAL_MutexLock(pTemplate->mutex);
+    slot = _find_reply_slot(pTemplate, _client_token_key(pClientToken), pClientToken);
+    if (NULL == slot) {
+        HAL_MutexUnlock(pTemplate->mutex);
+        IOT_FUNC_EXIT;
+    }
 
-        // check operation success or not according to code field of reply message
-        int32_t reply_code = 0;
+    // slot is released before callback, which may send another request
+    request = *slot;
+    timer_wheel_del(TEMPLATE_TIMER_WHEEL(pTemplate), &slot->timer_entry);
+    _free_reply_slot(pTemplate, slot);
+    HAL_MutexUnlock(pTemplate->mutex);
 
-        bool parse_success = parse_code_return(sg_template_cloud_rcv_buf, &reply_code);
-        if (parse_success) {
-            if (reply_code == 0) {
-                status = ACK_ACCEPTED;
-            } else {
-                status = ACK_REJECTED;
-            }
+    ReplyAck status = ACK_NONE;
 
-            if (strcmp(pType, GET_STATUS_REPLY) == 0 && status == ACK_ACCEPTED) {
-                char* control_str = NULL;
-                if (parse_template_get_control(sg_template_cloud_rcv_buf, &control_str)) {
-                    Log_d("control data from get_status_reply");
-                    _set_control_clientToken(pClientToken);
-                    _handle_control(pTemplate, control_str);
-                    HAL_Free(control_str);
-                    *((ReplyAck *)request->user_context) = ACK_ACCEPTED; //prepare for clear_control
-                }
-            }
+    // check operation success or not according to code field of reply message
+    int32_t reply_code = 0;
 
+    TemplateJsonDoc *doc = &pTemplate->inner_data.rx_doc;
+    bool parse_success = parse_code_return(doc, &reply_code);
+    if (parse_success) {
+        if (reply_code == 0) {
+            status = ACK_ACCEPTED;
+        } else {
+            status = ACK_REJECTED;
+        }
 
-            if (request->callback != NULL) {
-                request->callback(pTemplate, request->method, status, sg_template_cloud_rcv_buf, request);
+        if (strcmp(pType, GET_STATUS_REPLY) == 0 && status == ACK_ACCEPTED) {
+            int control;
+            if (parse_template_get_control(doc, &control)) {
+                Log_d("control data from get_status_reply");
+                _set_control_clientToken(pClientToken);
+                HAL_MutexLock(pTemplate->mutex);
+                _handle_control(pTemplate, doc, control);
+                HAL_MutexUnlock(pTemplate->mutex);
+                *((ReplyAck *)request.user_context) = ACK_ACCEPTED; //prepare for clear_control
             }
-        } else {
-            Log_e("parse template operation result code failed.");
         }
 
-        list_remove(list, *node);
-        *node = NULL;
 
+        if (request.callback != NULL) {
+            request.callback(pTemplate, request.method, status, pJsonDoc, &request);
+        }
+    } else {
+        Log_e("parse template operation result code failed.");
     }
 
     IOT_FUNC_EXIT;
@@ -482,6 +555,7 @@ static void _on_template_downstream_topic_handler(void *pClient, MQTTMessage *me
 
     POINTER_SANITY_CHECK_RTN(pClient);
     POINTER_SANITY_CHECK_RTN(message);
+    POINTER_SANITY_CHECK_RTN(pUserdata);
 
 //    Qcloud_IoT_Client *mqtt_client = (Qcloud_IoT_Client *)pClient;
 //    Qcloud_IoT_Template *template_client = (Qcloud_IoT_Template*)mqtt_client->event_handle.context;
@@ -494,53 +568,48 @@ static void _on_template_downstream_topic_handler(void *pClient, MQTTMessage *me
         IOT_FUNC_EXIT;
     }
 
-    char *client_token = NULL;
-    char *type_str = NULL;
+    char client_token[MAX_SIZE_OF_CLIENT_TOKEN];
+    char type_str[MAX_SIZE_OF_TEMPLATE_METHOD];
+    TemplateJsonDoc *doc = &template_client->inner_data.rx_doc;
 
-    if (message->payload_len > CLOUD_IOT_JSON_RX_BUF_LEN) {
-        Log_e("The length of the received message exceeds the specified length!");
+    // payload is null terminated by MQTT client and parsed in place, it is not valid after handler returns
+    char *payload = (char *)message->payload;
+
+    // tokenize once, all the fields are looked up in the tokens
+    if (template_json_parse(doc, payload) != QCLOUD_RET_SUCCESS) {
+        Log_e("Fail to parse json: %s", payload);
         goto End;
     }
 
-    int cloud_rcv_len = min(CLOUD_IOT_JSON_RX_BUF_LEN - 1, message->payload_len);
-    memset(sg_template_cloud_rcv_buf, 0, sizeof(sg_template_cloud_rcv_buf));
-    memcpy(sg_template_cloud_rcv_buf, message->payload, cloud_rcv_len + 1);
-    sg_template_cloud_rcv_buf[cloud_rcv_len] = '\0';    // jsmn_parse relies on a string
-    //Log_d("recv:%s", sg_template_cloud_rcv_buf);
-
     //parse the message type from topic $thing/down/property
-    if (!parse_template_method_type(sg_template_cloud_rcv_buf, &type_str)) {
+    if (!parse_template_method_type(doc, type_str, sizeof(type_str))) {
         Log_e("Fail to parse method!");
         goto End;
     }
 
-    if (!parse_client_token(sg_template_cloud_rcv_buf, &client_token)) {
-        Log_e("Fail to parse client token! Json=%s", sg_template_cloud_rcv_buf);
+    if (!parse_client_token(doc, client_token, sizeof(client_token))) {
+        Log_e("Fail to parse client token! Json=%s", payload);
         goto End;
     }
 
     //handle control message
     if (!strcmp(type_str, CONTROL_CMD)) {
         HAL_MutexLock(template_client->mutex);
-        char* control_str = NULL;
-        if (parse_template_cmd_control(sg_template_cloud_rcv_buf, &control_str)) {
-            Log_d("control_str:%s", control_str);
+        int control;
+        if (parse_template_cmd_control(doc, &control)) {
+            Log_d("control_str:%.*s", doc->tokens[control].end - doc->tokens[control].start,
+                  doc->json + doc->tokens[control].start);
             _set_control_clientToken(client_token);
-            _handle_control(template_client, control_str);
-            HAL_Free(control_str);
+            _handle_control(template_client, doc, control);
         }
 
         HAL_MutexUnlock(template_client->mutex);
         goto End;
     }
 
-    if (template_client != NULL)
-        _traverse_template_list(template_client, template_client->inner_data.reply_list, client_token, type_str, _handle_template_reply_callback);
+    _handle_template_reply(template_client, client_token, type_str, payload);
 
 End:
-    HAL_Free(type_str);
-    HAL_Free(client_token);
-
     IOT_FUNC_EXIT;
 }
 
@@ -32,6 +32,7 @@ extern "C" {
 #include "lite-utils.h"
 #include "data_template_client.h"
 #include "data_template_event.h"
+#include "utils_number.h"
 
 /**
  * @brief iterator event list and call traverseHandle for each node
@@ -40,6 +41,8 @@ static void _traverse_event_list(Qcloud_IoT_Template *pTemplate, List *list, con
 {
     IOT_FUNC_ENTRY;
 
+    OnEventReplyCallback callback = NULL;
+
     HAL_MutexLock(pTemplate->mutex);
 
     if (list->len) {
@@ -63,22 +66,17 @@ static void _traverse_event_list(Qcloud_IoT_Template *pTemplate, List *list, con
             }
 
             sEventReply *pReply =  (sEventReply *)node->val;
-            /*timeout check*/
-            if (eDEAL_EXPIRED == eDealType) {
-                if (expired(&pReply->timer)) {
-                    Log_e("eventToken[%s] timeout", pReply->client_token);
-                    list_remove(list, node);
-                    node = NULL;
-                }
-            }
 
             /*match event wait for reply by clientToken*/
             if ((eDEAL_REPLY_CB == eDealType) && (0 == strcmp(pClientToken, pReply->client_token))) {
                 if (NULL != pReply->callback) {
-                    pReply->callback(pTemplate, message);
+                    // called after unlock, the callback may call template APIs
+                    callback = pReply->callback;
                     Log_d("eventToken[%s] released", pReply->client_token);
+                    timer_wheel_del(TEMPLATE_TIMER_WHEEL(pTemplate), &pReply->timer_entry);
                     list_remove(list, node);
                     node = NULL;
+                    break;
                 }
             }
         }
@@ -87,6 +85,10 @@ static void _traverse_event_list(Qcloud_IoT_Template *pTemplate, List *list, con
     }
     HAL_MutexUnlock(pTemplate->mutex);
 
+    if (NULL != callback) {
+        callback(pTemplate, message);
+    }
+
     IOT_FUNC_EXIT;
 }
 
@@ -99,35 +101,41 @@ static void _on_event_reply_callback(void *pClient, MQTTMessage *message, void *
 
 
     int32_t code;
-    char* client_token = NULL;
-    char* status = NULL;
+    char client_token[MAX_SIZE_OF_CLIENT_TOKEN];
+    json_span_t status;
+    TemplateJsonDoc *doc;
+
+    POINTER_SANITY_CHECK_RTN(template_client);
+    doc = &template_client->inner_data.rx_doc;
 
     Log_d("recv:%.*s", (int) message->payload_len, (char *) message->payload);
 
+    // tokenize once, all the fields are looked up in the tokens
+    if (template_json_parse(doc, (char *) message->payload) != QCLOUD_RET_SUCCESS) {
+        Log_e("fail to parse json!");
+        return;
+    }
+
     // parse clientToken from payload
-    if (!parse_client_token((char *) message->payload, &client_token)) {
+    if (!parse_client_token(doc, client_token, sizeof(client_token))) {
         Log_e("fail to parse client token!");
         return;
     }
 
     // parse code from payload
-    if (!parse_code_return((char *) message->payload, &code)) {
+    if (!parse_code_return(doc, &code)) {
         Log_e("fail to parse code");
         return;
     }
 
-    if (!parse_status_return((char *) message->payload, &status)) {
+    if (!parse_status_return(doc, &status)) {
         // Log_d("no status return");
     }
 
-    // Log_d("eventToken:%s code:%d status:%s", client_token, code, status);
-
-    if (template_client != NULL)
-        _traverse_event_list(template_client, template_client->inner_data.event_list, client_token, message, eDEAL_REPLY_CB);
+    // Log_d("eventToken:%s code:%d status:%.*s", client_token, code, status.len, status.str);
 
+    _traverse_event_list(template_client, template_client->inner_data.event_list, client_token, message, eDEAL_REPLY_CB);
 
-    HAL_Free(client_token);
-    HAL_Free(status);
 
     return;
 }
@@ -146,7 +154,7 @@ static sEventReply * _create_event_add_to_list(Qcloud_IoT_Template *pTemplate, O
         IOT_FUNC_EXIT_RC(NULL);
     }
 
-    sEventReply *pReply = (sEventReply *)HAL_Malloc(sizeof(Request));
+    sEventReply *pReply = (sEventReply *)HAL_Malloc(sizeof(sEventReply));
     if (NULL == pReply) {
         HAL_MutexUnlock(pTemplate->mutex);
         Log_e("run memory malloc is error!");
@@ -156,8 +164,6 @@ static sEventReply * _create_event_add_to_list(Qcloud_IoT_Template *pTemplate, O
     pReply->callback = replyCb;
     pReply->user_context = pTemplate;
 
-    InitTimer(&(pReply->timer));
-    countdown(&(pReply->timer), reply_timeout_ms);
     HAL_Snprintf(pReply->client_token, EVENT_TOKEN_MAX_LEN, "%s-%u", iot_device_info_get()->product_id, pTemplate->inner_data.token_num++);
 
 
@@ -170,18 +176,20 @@ static sEventReply * _create_event_add_to_list(Qcloud_IoT_Template *pTemplate, O
     }
 
     list_rpush(pTemplate->inner_data.event_list, node);
+    pReply->node = node;
+
+    timer_wheel_entry_init(&pReply->timer_entry);
+    timer_wheel_add(TEMPLATE_TIMER_WHEEL(pTemplate), &pReply->timer_entry, reply_timeout_ms,
+                    &pTemplate->inner_data.event_expired);
 
     HAL_MutexUnlock(pTemplate->mutex);
 
     IOT_FUNC_EXIT_RC(pReply);
 }
 
-static int _iot_event_json_init(void *handle, char *jsonBuffer, size_t sizeOfBuffer, uint8_t event_count, OnEventReplyCallback replyCb, uint32_t reply_timeout_ms)
+static int _iot_event_json_init(void *handle, json_writer_t *pWriter, uint8_t event_count, OnEventReplyCallback replyCb, uint32_t reply_timeout_ms)
 {
-    POINTER_SANITY_CHECK(jsonBuffer, QCLOUD_ERR_INVAL);
-
     Qcloud_IoT_Template* ptemplate = (Qcloud_IoT_Template *)handle;
-    int32_t rc_of_snprintf;
     sEventReply *pReply;
 
     pReply = _create_event_add_to_list(ptemplate, replyCb, reply_timeout_ms);
@@ -190,16 +198,48 @@ static int _iot_event_json_init(void *handle, char *jsonBuffer, size_t sizeOfBuf
         return QCLOUD_ERR_FAILURE;
     }
 
-    memset(jsonBuffer, 0, sizeOfBuffer);
-    if (event_count > SIGLE_EVENT) {
-        rc_of_snprintf = HAL_Snprintf(jsonBuffer, sizeOfBuffer, "{\"method\":\"%s\", \"clientToken\":\"%s\", ", \
-                                      POST_EVENTS, pReply->client_token);
-    } else {
-        rc_of_snprintf = HAL_Snprintf(jsonBuffer, sizeOfBuffer, "{\"method\":\"%s\", \"clientToken\":\"%s\", ", \
-                                      POST_EVENT, pReply->client_token);
+    json_writer_object_begin(pWriter, NULL);
+    json_writer_string(pWriter, "method", (event_count > SIGLE_EVENT) ? POST_EVENTS : POST_EVENT);
+    json_writer_string(pWriter, "clientToken", pReply->client_token);
+
+    return pWriter->err;
+}
+
+/* members of an event, into the object opened by caller */
+static int _iot_put_event_json(json_writer_t *pWriter, sEvent *pEvent)
+{
+    char timestamp[UTILS_INT_STR_LEN + 3];
+    uint8_t i;
+    int rc;
+
+    json_writer_string(pWriter, "eventId", pEvent->event_name);
+    json_writer_string(pWriter, "type", pEvent->type);
+    if (0 == pEvent->timestamp) { //no accurate UTC time, set 0
+        json_writer_uint32(pWriter, "timestamp", 0);
+    } else { // accurate UTC time is second,change to ms
+        int len = utils_uint32_to_str(pEvent->timestamp, timestamp);
+        memcpy(timestamp + len, "000", 4);
+        json_writer_raw(pWriter, "timestamp", timestamp);
     }
 
-    return check_snprintf_return(rc_of_snprintf, sizeOfBuffer);
+    json_writer_object_begin(pWriter, "params");
+    DeviceProperty *pJsonNode = pEvent->pEventData;
+    for (i = 0; i < pEvent->eventDataNum; i++) {
+        if (pJsonNode != NULL && pJsonNode->key != NULL) {
+            rc = template_put_json_node(pWriter, pJsonNode->key, pJsonNode->data, pJsonNode->type);
+
+            if (rc != QCLOUD_RET_SUCCESS) {
+                return rc;
+            }
+        } else {
+            Log_e("%dth/%d null event property data", i, pEvent->eventDataNum);
+            return QCLOUD_ERR_INVAL;
+        }
+        pJsonNode++;
+    }
+    json_writer_object_end(pWriter);
+
+    return pWriter->err;
 }
 
 static int _iot_construct_event_json(void *handle, char *jsonBuffer, size_t sizeOfBuffer,
@@ -208,38 +248,24 @@ static int _iot_construct_event_json(void *handle, char *jsonBuffer, size_t size
                                      OnEventReplyCallback replyCb,
                                      uint32_t reply_timeout_ms)
 {
-    size_t remain_size = 0;
-    int32_t rc_of_snprintf = 0;
-    uint8_t i, j;
+    json_writer_t writer;
+    uint8_t i;
     Qcloud_IoT_Template* ptemplate = (Qcloud_IoT_Template *)handle;
 
     POINTER_SANITY_CHECK(ptemplate, QCLOUD_ERR_INVAL);
     POINTER_SANITY_CHECK(jsonBuffer, QCLOUD_ERR_INVAL);
     POINTER_SANITY_CHECK(pEventArry, QCLOUD_ERR_INVAL);
 
-    int rc = _iot_event_json_init(ptemplate, jsonBuffer, sizeOfBuffer, event_count, replyCb, reply_timeout_ms);
+    json_writer_init(&writer, jsonBuffer, sizeOfBuffer);
+    int rc = _iot_event_json_init(ptemplate, &writer, event_count, replyCb, reply_timeout_ms);
 
     if (rc != QCLOUD_RET_SUCCESS) {
         Log_e("event json init failed: %d", rc);
         return rc;
     }
-    //Log_d("event_count:%d, Doc_init:%s",event_count, jsonBuffer);
-
-    if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
-        return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
-    }
 
     if (event_count > SIGLE_EVENT) { //mutlti event
-        rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "\"events\":[");
-        rc = check_snprintf_return(rc_of_snprintf, remain_size);
-        if (rc != QCLOUD_RET_SUCCESS) {
-            return rc;
-        }
-
-        if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
-            return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
-        }
-
+        json_writer_array_begin(&writer, "events");
         for (i = 0; i < event_count; i++) {
             sEvent *pEvent = pEventArry[i];
             if (NULL == pEvent) {
@@ -247,114 +273,29 @@ static int _iot_construct_event_json(void *handle, char *jsonBuffer, size_t size
                 return QCLOUD_ERR_INVAL;
             }
 
-            if (0 == pEvent->timestamp) { //no accurate UTC time, set 0
-                rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "{\"eventId\":\"%s\", \"type\":\"%s\", \"timestamp\":0, \"params\":{", \
-                                              pEvent->event_name, pEvent->type);
-            } else { // accurate UTC time is second,change to ms
-                rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "{\"eventId\":\"%s\", \"type\":\"%s\", \"timestamp\":%u000, \"params\":{", \
-                                              pEvent->event_name, pEvent->type, pEvent->timestamp);
-
-            }
-
-
-            rc = check_snprintf_return(rc_of_snprintf, remain_size);
-            if (rc != QCLOUD_RET_SUCCESS) {
-                return rc;
-            }
-
-            if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
-                return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
-            }
-
-            DeviceProperty *pJsonNode = pEvent->pEventData;
-            for (j = 0; j < pEvent->eventDataNum; j++) {
-                if (pJsonNode != NULL && pJsonNode->key != NULL) {
-                    rc = template_put_json_node(jsonBuffer, remain_size, pJsonNode->key, pJsonNode->data, pJsonNode->type);
-
-                    if (rc != QCLOUD_RET_SUCCESS) {
-                        return rc;
-                    }
-                } else {
-                    Log_e("%dth/%d null event property data", i, pEvent->eventDataNum);
-                    return QCLOUD_ERR_INVAL;
-                }
-                pJsonNode++;
-            }
-            if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
-                return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
-            }
-
-            rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer) - 1, remain_size, "}}," );
-
-            rc = check_snprintf_return(rc_of_snprintf, remain_size);
+            json_writer_object_begin(&writer, NULL);
+            rc = _iot_put_event_json(&writer, pEvent);
             if (rc != QCLOUD_RET_SUCCESS) {
                 return rc;
             }
-
-            pEvent++;
+            json_writer_object_end(&writer);
         }
-
-        if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
-            return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
-        }
-        rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer) - 1, remain_size, "]");
-        rc = check_snprintf_return(rc_of_snprintf, remain_size);
-        if (rc != QCLOUD_RET_SUCCESS) {
-            return rc;
-        }
-
+        json_writer_array_end(&writer);
     } else { //single
         sEvent *pEvent = pEventArry[0];
-        if (0 == pEvent->timestamp) { //no accurate UTC time, set 0
-            rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "\"eventId\":\"%s\", \"type\":\"%s\", \"timestamp\":0, \"params\":{", \
-                                          pEvent->event_name, pEvent->type);
-        } else { // accurate UTC time is second,change to ms
-            rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "\"eventId\":\"%s\", \"type\":\"%s\", \"timestamp\":%u000, \"params\":{", \
-                                          pEvent->event_name, pEvent->type, pEvent->timestamp);
-        }
+        POINTER_SANITY_CHECK(pEvent, QCLOUD_ERR_INVAL);
 
-        rc = check_snprintf_return(rc_of_snprintf, remain_size);
-        if (rc != QCLOUD_RET_SUCCESS) {
-            return rc;
-        }
-
-        if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
-            return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
-        }
-
-        DeviceProperty *pJsonNode = pEvent->pEventData;
-        for (i = 0; i < pEvent->eventDataNum; i++) {
-            if (pJsonNode != NULL && pJsonNode->key != NULL) {
-                rc = template_put_json_node(jsonBuffer, remain_size, pJsonNode->key, pJsonNode->data, pJsonNode->type);
-
-                if (rc != QCLOUD_RET_SUCCESS) {
-                    return rc;
-                }
-            } else {
-                Log_e("%dth/%d null event property data", i, pEvent->eventDataNum);
-                return QCLOUD_ERR_INVAL;
-            }
-            pJsonNode++;
-        }
-        if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
-            return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
-        }
-
-        rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer) - 1, remain_size, "}" );
-
-        rc = check_snprintf_return(rc_of_snprintf, remain_size);
+        rc = _iot_put_event_json(&writer, pEvent);
         if (rc != QCLOUD_RET_SUCCESS) {
             return rc;
         }
     }
 
     //finish json
-    if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) < 1) {
-        return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
-    }
-    rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "}");
+    json_writer_object_end(&writer);
 
-    return check_snprintf_return(rc_of_snprintf, remain_size);
+    rc = json_writer_finish(&writer);
+    return rc < 0 ? rc : QCLOUD_RET_SUCCESS;
 }
 
 static int _publish_event_to_cloud(void *c, char *pJsonDoc)
@@ -381,12 +322,91 @@ static int _publish_event_to_cloud(void *c, char *pJsonDoc)
     IOT_FUNC_EXIT_RC(rc);
 }
 
+typedef struct {
+    EventQueueParams    params;
+    char                *events;            // events waiting, JSON objects separated by comma
+    size_t              events_len;
+    uint16_t            event_count;
+    uint32_t            first_time;         // time of the first event waiting, HAL_GetTimeMs
+    bool                flush;              // flush at next yield whatever the thresholds
+    char                *batch;             // events of the batch being delivered
+    size_t              batch_len;
+    uint16_t            batch_count;
+    bool                batch_waiting;      // batch is sent and waiting for reply
+    char                batch_token[EVENT_TOKEN_MAX_LEN];   // clientToken of the batch sent
+    char                *doc;               // document of the batch, in yield context only
+    size_t              doc_size;
+} EventQueue;
+
+/* reply of the batch sent, called in event list traverse after the reply is removed */
+static void _event_queue_reply_cb(void *pClient, MQTTMessage *message)
+{
+    Qcloud_IoT_Template *pTemplate = (Qcloud_IoT_Template *)pClient;
+    EventQueue *pQueue;
+    OnEventReplyCallback reply_cb;
+    char client_token[MAX_SIZE_OF_CLIENT_TOKEN];
+    int32_t code = -1;
+
+    // reply of an earlier try of the batch, whose publish was taken as failed
+    if (!parse_client_token(&pTemplate->inner_data.rx_doc, client_token, sizeof(client_token))) {
+        return;
+    }
+
+    HAL_MutexLock(pTemplate->mutex);
+    pQueue = (EventQueue *)pTemplate->inner_data.event_queue;
+    if (pQueue == NULL || !pQueue->batch_waiting || strcmp(client_token, pQueue->batch_token) != 0) {
+        HAL_MutexUnlock(pTemplate->mutex);
+        return;
+    }
+
+    parse_code_return(&pTemplate->inner_data.rx_doc, &code);
+    if (code != 0) {
+        // rejected by server, sending it again would not help
+        Log_e("batch of %d events rejected: %d", pQueue->batch_count, code);
+    }
+
+    pQueue->batch_waiting = false;
+    pQueue->batch_len = 0;
+    pQueue->batch_count = 0;
+    reply_cb = pQueue->params.reply_cb;
+    HAL_MutexUnlock(pTemplate->mutex);
+
+    if (reply_cb != NULL) {
+        reply_cb(pClient, message);
+    }
+}
+
+/* batch sent is not replied in time, it would be sent again, called with mutex locked */
+static void _event_queue_reply_timeout(Qcloud_IoT_Template *pTemplate, sEventReply *pReply)
+{
+    EventQueue *pQueue = (EventQueue *)pTemplate->inner_data.event_queue;
+
+    if (pQueue != NULL && pQueue->batch_waiting && strcmp(pQueue->batch_token, pReply->client_token) == 0) {
+        Log_w("batch of %d events not replied, send again", pQueue->batch_count);
+        pQueue->batch_waiting = false;
+    }
+}
+
 void handle_template_expired_event(void *client)
 {
     IOT_FUNC_ENTRY;
     Qcloud_IoT_Template *pTemplate = (Qcloud_IoT_Template *)client;
 
-    _traverse_event_list(pTemplate, pTemplate->inner_data.event_list, NULL, NULL, eDEAL_EXPIRED);
+    TimerWheelEntry *entry;
+    sEventReply *pReply;
+
+    /* only events whose deadline is passed are visited */
+    HAL_MutexLock(pTemplate->mutex);
+    while (NULL != (entry = timer_wheel_pop_expired(TEMPLATE_TIMER_WHEEL(pTemplate),
+                                                     &pTemplate->inner_data.event_expired))) {
+        pReply = TIMER_WHEEL_ENTRY(entry, sEventReply, timer_entry);
+        Log_e("eventToken[%s] timeout", pReply->client_token);
+        if (pReply->callback == _event_queue_reply_cb) {
+            _event_queue_reply_timeout(pTemplate, pReply);
+        }
+        list_remove(pTemplate->inner_data.event_list, pReply->node);
+    }
+    HAL_MutexUnlock(pTemplate->mutex);
 
     IOT_FUNC_EXIT;
 }
@@ -452,8 +472,7 @@ int IOT_Post_Event(void *pClient, char *pJsonDoc, size_t sizeOfBuffer, uint8_t e
 int IOT_Post_Event_Raw(void *pClient, char *pJsonDoc, size_t sizeOfBuffer, char *pEventMsg, OnEventReplyCallback replyCb)
 {
     int rc;
-    size_t remain_size = 0;
-    int32_t rc_of_snprintf;
+    json_writer_t writer;
 
     Qcloud_IoT_Template* ptemplate = (Qcloud_IoT_Template *)pClient;
 
@@ -461,19 +480,21 @@ int IOT_Post_Event_Raw(void *pClient, char *pJsonDoc, size_t sizeOfBuffer, char
     POINTER_SANITY_CHECK(pJsonDoc, QCLOUD_ERR_INVAL);
     POINTER_SANITY_CHECK(pEventMsg, QCLOUD_ERR_INVAL);
 
-    rc = _iot_event_json_init(ptemplate, pJsonDoc, sizeOfBuffer, MUTLTI_EVENTS, replyCb, QCLOUD_IOT_MQTT_COMMAND_TIMEOUT);
+    json_writer_init(&writer, pJsonDoc, sizeOfBuffer);
+    rc = _iot_event_json_init(ptemplate, &writer, MUTLTI_EVENTS, replyCb, QCLOUD_IOT_MQTT_COMMAND_TIMEOUT);
     if (rc != QCLOUD_RET_SUCCESS) {
         Log_e("event json init failed: %d", rc);
         return rc;
     }
 
-    if ((remain_size = sizeOfBuffer - strlen(pJsonDoc)) <= 1) {
-        return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
-    }
+    // events of the message are written as they are
+    json_writer_array_begin(&writer, "events");
+    json_writer_raw(&writer, NULL, pEventMsg);
+    json_writer_array_end(&writer);
+    json_writer_object_end(&writer);
 
-    rc_of_snprintf = HAL_Snprintf(pJsonDoc + strlen(pJsonDoc), remain_size, "\"events\":[%s]}", pEventMsg);
-    rc = check_snprintf_return(rc_of_snprintf, remain_size);
-    if (rc != QCLOUD_RET_SUCCESS) {
+    rc = json_writer_finish(&writer);
+    if (rc < 0) {
         return rc;
     }
 
@@ -487,6 +508,222 @@ int IOT_Post_Event_Raw(void *pClient, char *pJsonDoc, size_t sizeOfBuffer, char
     return rc;
 }
 
+int IOT_Event_Queue_Init(void *pClient, EventQueueParams *pParams)
+{
+    IOT_FUNC_ENTRY;
+
+    POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(pParams, QCLOUD_ERR_INVAL);
+    NUMBERIC_SANITY_CHECK(pParams->buffer_size, QCLOUD_ERR_INVAL);
+    NUMBERIC_SANITY_CHECK(pParams->max_events, QCLOUD_ERR_INVAL);
+
+    Qcloud_IoT_Template *pTemplate = (Qcloud_IoT_Template *)pClient;
+    EventQueue *pQueue;
+
+    if (pTemplate->inner_data.event_queue != NULL) {
+        Log_e("event queue is inited");
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_INVAL);
+    }
+
+    pQueue = (EventQueue *)HAL_Malloc(sizeof(EventQueue));
+    if (pQueue == NULL) {
+        Log_e("malloc event queue failed");
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_MALLOC);
+    }
+    memset(pQueue, 0, sizeof(EventQueue));
+
+    pQueue->params = *pParams;
+    pQueue->doc_size = pParams->buffer_size + EVENT_QUEUE_DOC_HEAD_LEN;
+    pQueue->events = (char *)HAL_Malloc(pParams->buffer_size);
+    pQueue->batch = (char *)HAL_Malloc(pParams->buffer_size);
+    pQueue->doc = (char *)HAL_Malloc(pQueue->doc_size);
+    if (pQueue->events == NULL || pQueue->batch == NULL || pQueue->doc == NULL) {
+        Log_e("malloc event queue failed");
+        HAL_Free(pQueue->events);
+        HAL_Free(pQueue->batch);
+        HAL_Free(pQueue->doc);
+        HAL_Free(pQueue);
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_MALLOC);
+    }
+    pQueue->events[0] = '\0';
+    pQueue->batch[0] = '\0';
+
+    HAL_MutexLock(pTemplate->mutex);
+    pTemplate->inner_data.event_queue = pQueue;
+    HAL_MutexUnlock(pTemplate->mutex);
+
+    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+}
+
+void template_event_queue_deinit(void *client)
+{
+    Qcloud_IoT_Template *pTemplate = (Qcloud_IoT_Template *)client;
+    EventQueue *pQueue = (EventQueue *)pTemplate->inner_data.event_queue;
+
+    if (pQueue == NULL) {
+        return;
+    }
+
+    if (pQueue->event_count + pQueue->batch_count > 0) {
+        Log_w("%d events not delivered are dropped", pQueue->event_count + pQueue->batch_count);
+    }
+
+    HAL_Free(pQueue->events);
+    HAL_Free(pQueue->batch);
+    HAL_Free(pQueue->doc);
+    HAL_Free(pQueue);
+    pTemplate->inner_data.event_queue = NULL;
+}
+
+int IOT_Event_Queue_Push(void *pClient, sEvent *pEvent)
+{
+    IOT_FUNC_ENTRY;
+
+    POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(pEvent, QCLOUD_ERR_INVAL);
+
+    Qcloud_IoT_Template *pTemplate = (Qcloud_IoT_Template *)pClient;
+    EventQueue *pQueue = (EventQueue *)pTemplate->inner_data.event_queue;
+    json_writer_t writer;
+    size_t pos;
+    int rc;
+
+    if (pQueue == NULL) {
+        Log_e("event queue is not inited");
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_INVAL);
+    }
+
+    HAL_MutexLock(pTemplate->mutex);
+    if (pQueue->event_count >= pQueue->params.max_events) {
+        pQueue->flush = true;
+        HAL_MutexUnlock(pTemplate->mutex);
+        Log_e("event queue is full, %d events waiting", pQueue->event_count);
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_BUF_TOO_SHORT);
+    }
+
+    // event is written at once, as data of event may be changed by caller after push
+    pos = pQueue->events_len;
+    if (pQueue->event_count > 0) {
+        pQueue->events[pos++] = ',';
+    }
+
+    json_writer_init(&writer, pQueue->events + pos, pQueue->params.buffer_size - pos);
+    json_writer_object_begin(&writer, NULL);
+    rc = _iot_put_event_json(&writer, pEvent);
+    json_writer_object_end(&writer);
+    rc = (rc == QCLOUD_RET_SUCCESS) ? json_writer_finish(&writer) : rc;
+    if (rc < 0) {
+        pQueue->events[pQueue->events_len] = '\0';
+        if (rc == QCLOUD_ERR_JSON_BUFFER_TRUNCATED) {
+            pQueue->flush = (pQueue->event_count > 0);
+            rc = QCLOUD_ERR_BUF_TOO_SHORT;
+        }
+        HAL_MutexUnlock(pTemplate->mutex);
+        Log_e("push event %s failed: %d", pEvent->event_name, rc);
+        IOT_FUNC_EXIT_RC(rc);
+    }
+
+    if (pQueue->event_count == 0) {
+        pQueue->first_time = HAL_GetTimeMs();
+    }
+    pQueue->events_len = pos + rc;
+    pQueue->event_count++;
+    HAL_MutexUnlock(pTemplate->mutex);
+
+    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+}
+
+void IOT_Event_Queue_Flush(void *pClient)
+{
+    POINTER_SANITY_CHECK_RTN(pClient);
+
+    Qcloud_IoT_Template *pTemplate = (Qcloud_IoT_Template *)pClient;
+    EventQueue *pQueue = (EventQueue *)pTemplate->inner_data.event_queue;
+
+    if (pQueue != NULL) {
+        HAL_MutexLock(pTemplate->mutex);
+        pQueue->flush = (pQueue->event_count > 0);
+        HAL_MutexUnlock(pTemplate->mutex);
+    }
+}
+
+void handle_template_event_queue(void *client)
+{
+    Qcloud_IoT_Template *pTemplate = (Qcloud_IoT_Template *)client;
+    EventQueue *pQueue = (EventQueue *)pTemplate->inner_data.event_queue;
+    sEventReply *pReply;
+    json_writer_t writer;
+    char *swap;
+    int rc;
+
+    if (pQueue == NULL) {
+        return;
+    }
+
+    HAL_MutexLock(pTemplate->mutex);
+    if (pQueue->batch_waiting) {
+        HAL_MutexUnlock(pTemplate->mutex);
+        return;
+    }
+
+    // take the events waiting as the next batch, when the last one is delivered
+    if (pQueue->batch_count == 0) {
+        if (pQueue->event_count == 0 || (!pQueue->flush && pQueue->event_count < pQueue->params.max_events &&
+                                         (uint32_t)(HAL_GetTimeMs() - pQueue->first_time) < pQueue->params.max_age_ms)) {
+            HAL_MutexUnlock(pTemplate->mutex);
+            return;
+        }
+
+        swap = pQueue->batch;
+        pQueue->batch = pQueue->events;
+        pQueue->batch_len = pQueue->events_len;
+        pQueue->batch_count = pQueue->event_count;
+        pQueue->events = swap;
+        pQueue->events[0] = '\0';
+        pQueue->events_len = 0;
+        pQueue->event_count = 0;
+        pQueue->flush = false;
+    }
+    HAL_MutexUnlock(pTemplate->mutex);
+
+    if (!IOT_MQTT_IsConnected(pTemplate->mqtt)) {
+        return;
+    }
+
+    pReply = _create_event_add_to_list(pTemplate, _event_queue_reply_cb, QCLOUD_IOT_MQTT_COMMAND_TIMEOUT);
+    if (pReply == NULL) {
+        return;
+    }
+
+    json_writer_init(&writer, pQueue->doc, pQueue->doc_size);
+    json_writer_object_begin(&writer, NULL);
+    json_writer_string(&writer, "method", POST_EVENTS);
+    json_writer_string(&writer, "clientToken", pReply->client_token);
+    json_writer_array_begin(&writer, "events");
+    json_writer_raw(&writer, NULL, pQueue->batch);
+    json_writer_array_end(&writer);
+    json_writer_object_end(&writer);
+
+    HAL_MutexLock(pTemplate->mutex);
+    strncpy(pQueue->batch_token, pReply->client_token, EVENT_TOKEN_MAX_LEN - 1);
+    pQueue->batch_token[EVENT_TOKEN_MAX_LEN - 1] = '\0';
+    pQueue->batch_waiting = true;
+    HAL_MutexUnlock(pTemplate->mutex);
+
+    rc = json_writer_finish(&writer);
+    if (rc >= 0) {
+        rc = _publish_event_to_cloud(pTemplate, pQueue->doc);
+    }
+
+    if (rc < 0) {
+        // batch is kept and sent again with a new clientToken
+        Log_e("post batch of %d events failed: %d", pQueue->batch_count, rc);
+        HAL_MutexLock(pTemplate->mutex);
+        pQueue->batch_waiting = false;
+        HAL_MutexUnlock(pTemplate->mutex);
+    }
+}
+
 #endif
 #ifdef __cplusplus
 }
@@ -0,0 +1,342 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+#include <stdbool.h>
+
+#include "qcloud_iot_export.h"
+#include "qcloud_iot_import.h"
+#include "utils_param_check.h"
+
+#define BITMAP_WORD_BITS            (32)
+#define BITMAP_WORDS(n)             (((n) + BITMAP_WORD_BITS - 1) / BITMAP_WORD_BITS)
+
+#define FNV_OFFSET_BASIS            (2166136261U)
+#define FNV_PRIME                   (16777619U)
+
+/* value of property taken as snapshot, number for numeric types and hash for string/object */
+typedef union {
+    double      number;
+    uint32_t    hash;
+} PropertySnapshot;
+
+typedef struct {
+    DeviceProperty      *property;
+    float               deadband;           // change of number not larger than it is not reported
+    uint32_t            min_interval_ms;    // min interval between two reports of the property
+    uint32_t            reported_time;      // time of last report, HAL_GetTimeMs
+    PropertySnapshot    reported;           // value of last report
+    PropertySnapshot    pending;            // value picked by last collect, waiting for report
+} PropertyStoreEntry;
+
+typedef struct {
+    uint16_t            count;
+    uint16_t            max_count;
+    uint32_t            collect_time;       // time of last collect, HAL_GetTimeMs
+    uint32_t            *dirty;             // bit set when property changed and not reported yet
+    uint32_t            *forced;            // bit set when property should be reported whatever the deadband
+    uint32_t            *reported;          // bit set when property has been reported once
+    uint32_t            *pending;           // bit set when property is picked by last collect
+    PropertyStoreEntry  *entries;
+} PropertyStore;
+
+static bool _bit_test(const uint32_t *bitmap, int index)
+{
+    return (bitmap[index / BITMAP_WORD_BITS] & (1U << (index % BITMAP_WORD_BITS))) != 0;
+}
+
+static void _bit_set(uint32_t *bitmap, int index)
+{
+    bitmap[index / BITMAP_WORD_BITS] |= (1U << (index % BITMAP_WORD_BITS));
+}
+
+static void _bit_clear(uint32_t *bitmap, int index)
+{
+    bitmap[index / BITMAP_WORD_BITS] &= ~(1U << (index % BITMAP_WORD_BITS));
+}
+
+/* get value of numeric property, false for string and object */
+static bool _property_number(DeviceProperty *pProperty, double *pNumber)
+{
+    switch (pProperty->type) {
+        case JINT32:
+            *pNumber = *(int32_t *)pProperty->data;
+            break;
+        case JINT16:
+            *pNumber = *(int16_t *)pProperty->data;
+            break;
+        case JINT8:
+            *pNumber = *(int8_t *)pProperty->data;
+            break;
+        case JUINT32:
+            *pNumber = *(uint32_t *)pProperty->data;
+            break;
+        case JUINT16:
+            *pNumber = *(uint16_t *)pProperty->data;
+            break;
+        case JUINT8:
+            *pNumber = *(uint8_t *)pProperty->data;
+            break;
+        case JFLOAT:
+            *pNumber = *(float *)pProperty->data;
+            break;
+        case JDOUBLE:
+            *pNumber = *(double *)pProperty->data;
+            break;
+        case JBOOL:
+            *pNumber = *(bool *)pProperty->data ? 1 : 0;
+            break;
+        default:
+            return false;
+    }
+
+    return true;
+}
+
+/* FNV-1a hash of string, so that string property is not copied for comparing */
+static uint32_t _string_hash(const char *pStr)
+{
+    uint32_t hash = FNV_OFFSET_BASIS;
+
+    while (*pStr != '\0') {
+        hash ^= (uint8_t) * pStr++;
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+static bool _is_number_type(JsonDataType type)
+{
+    return type != JSTRING && type != JOBJECT;
+}
+
+static void _take_snapshot(PropertyStoreEntry *pEntry, PropertySnapshot *pSnapshot)
+{
+    if (pEntry->property->data == NULL) {
+        memset(pSnapshot, 0, sizeof(PropertySnapshot));
+    } else if (!_property_number(pEntry->property, &pSnapshot->number)) {
+        pSnapshot->hash = _string_hash((const char *)pEntry->property->data);
+    }
+}
+
+/* whether current value differs from the reported one by more than deadband */
+static bool _value_changed(PropertyStoreEntry *pEntry, PropertySnapshot *pCurrent)
+{
+    double diff;
+
+    if (!_is_number_type(pEntry->property->type)) {
+        return pCurrent->hash != pEntry->reported.hash;
+    }
+
+    diff = pCurrent->number - pEntry->reported.number;
+    if (diff < 0) {
+        diff = -diff;
+    }
+
+    return (pEntry->deadband > 0) ? (diff > pEntry->deadband) : (diff != 0);
+}
+
+static int _find_entry(PropertyStore *pStore, DeviceProperty *pProperty)
+{
+    int i;
+
+    for (i = 0; i < pStore->count; i++) {
+        if (pStore->entries[i].property == pProperty) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void *IOT_Template_PropertyStore_Create(uint16_t max_count)
+{
+    PropertyStore *pStore;
+    size_t         words = BITMAP_WORDS(max_count);
+
+    if (max_count == 0) {
+        Log_e("max count of property store should be larger than 0");
+        return NULL;
+    }
+
+    /* store, entries and bitmaps in one block */
+    pStore = (PropertyStore *)HAL_Malloc(sizeof(PropertyStore) + max_count * sizeof(PropertyStoreEntry) +
+                                         4 * words * sizeof(uint32_t));
+    if (pStore == NULL) {
+        Log_e("malloc property store failed");
+        return NULL;
+    }
+
+    memset(pStore, 0, sizeof(PropertyStore));
+    pStore->max_count = max_count;
+    pStore->entries = (PropertyStoreEntry *)(pStore + 1);
+    pStore->dirty = (uint32_t *)(pStore->entries + max_count);
+    pStore->forced = pStore->dirty + words;
+    pStore->reported = pStore->forced + words;
+    pStore->pending = pStore->reported + words;
+    memset(pStore->dirty, 0, 4 * words * sizeof(uint32_t));
+
+    return pStore;
+}
+
+void IOT_Template_PropertyStore_Destroy(void *store)
+{
+    HAL_Free(store);
+}
+
+int IOT_Template_PropertyStore_Add(void *store, DeviceProperty *pProperty, float deadband, uint32_t min_interval_ms)
+{
+    IOT_FUNC_ENTRY;
+
+    POINTER_SANITY_CHECK(store, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(pProperty, QCLOUD_ERR_INVAL);
+
+    PropertyStore      *pStore = (PropertyStore *)store;
+    PropertyStoreEntry *pEntry;
+
+    if (_find_entry(pStore, pProperty) >= 0) {
+        Log_e("property %s exists in store", pProperty->key);
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_INVAL);
+    }
+
+    if (pStore->count >= pStore->max_count) {
+        Log_e("property store is full, max count: %d", pStore->max_count);
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_MALLOC);
+    }
+
+    pEntry = &pStore->entries[pStore->count];
+    memset(pEntry, 0, sizeof(PropertyStoreEntry));
+    pEntry->property = pProperty;
+    pEntry->deadband = deadband;
+    pEntry->min_interval_ms = min_interval_ms;
+
+    /* property is reported once at the first collect */
+    _bit_set(pStore->dirty, pStore->count);
+    _bit_set(pStore->forced, pStore->count);
+    pStore->count++;
+
+    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+}
+
+int IOT_Template_PropertyStore_SetChanged(void *store, DeviceProperty *pProperty)
+{
+    POINTER_SANITY_CHECK(store, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(pProperty, QCLOUD_ERR_INVAL);
+
+    PropertyStore *pStore = (PropertyStore *)store;
+    int            index = _find_entry(pStore, pProperty);
+
+    if (index < 0) {
+        Log_e("property %s not in store", pProperty->key);
+        return QCLOUD_ERR_INVAL;
+    }
+
+    /* value picked by collect is stale, not to be taken as reported */
+    _bit_set(pStore->dirty, index);
+    _bit_set(pStore->forced, index);
+    _bit_clear(pStore->pending, index);
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+void IOT_Template_PropertyStore_SetAllChanged(void *store)
+{
+    POINTER_SANITY_CHECK_RTN(store);
+
+    PropertyStore *pStore = (PropertyStore *)store;
+    int            i;
+
+    for (i = 0; i < pStore->count; i++) {
+        _bit_set(pStore->dirty, i);
+        _bit_set(pStore->forced, i);
+        _bit_clear(pStore->pending, i);
+    }
+}
+
+int IOT_Template_PropertyStore_Collect(void *store, DeviceProperty *pDeviceProperties[], uint8_t max_count)
+{
+    POINTER_SANITY_CHECK(store, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(pDeviceProperties, QCLOUD_ERR_INVAL);
+
+    PropertyStore      *pStore = (PropertyStore *)store;
+    PropertyStoreEntry *pEntry;
+    PropertySnapshot    current;
+    uint32_t            now = HAL_GetTimeMs();
+    int                 i, count = 0;
+
+    memset(pStore->pending, 0, BITMAP_WORDS(pStore->max_count) * sizeof(uint32_t));
+    pStore->collect_time = now;
+
+    for (i = 0; i < pStore->count && count < max_count; i++) {
+        pEntry = &pStore->entries[i];
+        _take_snapshot(pEntry, &current);
+
+        if (!_bit_test(pStore->forced, i)) {
+            if (_value_changed(pEntry, &current)) {
+                _bit_set(pStore->dirty, i);
+            } else {
+                /* changed back within deadband before it is reported */
+                _bit_clear(pStore->dirty, i);
+            }
+        }
+
+        if (!_bit_test(pStore->dirty, i)) {
+            continue;
+        }
+
+        if (_bit_test(pStore->reported, i) && pEntry->min_interval_ms > 0 &&
+            (uint32_t)(now - pEntry->reported_time) < pEntry->min_interval_ms) {
+            continue;
+        }
+
+        pEntry->pending = current;
+        _bit_set(pStore->pending, i);
+        pDeviceProperties[count++] = pEntry->property;
+    }
+
+    return count;
+}
+
+void IOT_Template_PropertyStore_Reported(void *store)
+{
+    POINTER_SANITY_CHECK_RTN(store);
+
+    PropertyStore      *pStore = (PropertyStore *)store;
+    PropertyStoreEntry *pEntry;
+    int                 i;
+
+    for (i = 0; i < pStore->count; i++) {
+        if (!_bit_test(pStore->pending, i)) {
+            continue;
+        }
+
+        pEntry = &pStore->entries[i];
+        pEntry->reported = pEntry->pending;
+        pEntry->reported_time = pStore->collect_time;
+        _bit_set(pStore->reported, i);
+        _bit_clear(pStore->dirty, i);
+        _bit_clear(pStore->forced, i);
+        _bit_clear(pStore->pending, i);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
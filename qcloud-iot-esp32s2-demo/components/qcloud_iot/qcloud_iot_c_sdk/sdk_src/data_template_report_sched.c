@@ -0,0 +1,288 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "qcloud_iot_export.h"
+#include "qcloud_iot_import.h"
+#include "utils_param_check.h"
+#include "data_template_client.h"
+
+/* token bucket counts in 1/1000 of a report */
+#define REPORT_TOKEN_UNIT           (1000)
+
+typedef struct {
+    ReportSchedParams   params;
+    ReportSchedStats    stats;
+    DeviceProperty      **pending;          // properties waiting for report, each once
+    DeviceProperty      **sending;          // properties of the report being sent, in yield context only
+    char                *json_buf;          // buffer of the report being sent, in yield context only
+    uint32_t            first_change_time;  // time of the first change waiting, HAL_GetTimeMs
+    uint32_t            tokens;             // tokens of bucket, in REPORT_TOKEN_UNIT
+    uint32_t            refill_time;        // time of last refill, HAL_GetTimeMs
+    uint32_t            refill_rem;         // part of a token not added at last refill, in 1/60000 of REPORT_TOKEN_UNIT
+} TemplateReportSched;
+
+static int _pending_find(TemplateReportSched *pSched, DeviceProperty *pProperty)
+{
+    int i;
+
+    for (i = 0; i < pSched->stats.queue_depth; i++) {
+        if (pSched->pending[i] == pProperty) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/* add property into pending set, call with mutex locked */
+static int _pending_merge(TemplateReportSched *pSched, DeviceProperty *pProperty, uint32_t now)
+{
+    if (_pending_find(pSched, pProperty) >= 0) {
+        pSched->stats.merged++;
+        return QCLOUD_RET_SUCCESS;
+    }
+
+    if (pSched->stats.queue_depth >= pSched->params.max_properties) {
+        pSched->stats.dropped++;
+        return QCLOUD_ERR_MAX_APPENDING_REQUEST;
+    }
+
+    if (pSched->stats.queue_depth == 0) {
+        pSched->first_change_time = now;
+    }
+    pSched->pending[pSched->stats.queue_depth++] = pProperty;
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+static void _put_tokens(TemplateReportSched *pSched, uint64_t add)
+{
+    uint32_t capacity = (uint32_t)pSched->params.burst * REPORT_TOKEN_UNIT;
+
+    if (pSched->tokens + add >= capacity) {
+        pSched->tokens = capacity;
+        /* bucket is full, nothing is carried over */
+        pSched->refill_rem = 0;
+    } else {
+        pSched->tokens += (uint32_t)add;
+    }
+}
+
+static void _refill_tokens(TemplateReportSched *pSched, uint32_t now)
+{
+    uint64_t part = (uint64_t)(uint32_t)(now - pSched->refill_time) * pSched->params.rate_per_min * REPORT_TOKEN_UNIT +
+                    pSched->refill_rem;
+
+    pSched->refill_time = now;
+    pSched->refill_rem = (uint32_t)(part % 60000);
+    _put_tokens(pSched, part / 60000);
+}
+
+static void _report_sched_free(TemplateReportSched *pSched)
+{
+    HAL_Free(pSched->pending);
+    HAL_Free(pSched->sending);
+    HAL_Free(pSched->json_buf);
+    HAL_Free(pSched);
+}
+
+int IOT_Template_ReportSched_Init(void *handle, ReportSchedParams *pParams)
+{
+    IOT_FUNC_ENTRY;
+
+    POINTER_SANITY_CHECK(handle, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(pParams, QCLOUD_ERR_INVAL);
+    NUMBERIC_SANITY_CHECK(pParams->rate_per_min, QCLOUD_ERR_INVAL);
+    NUMBERIC_SANITY_CHECK(pParams->burst, QCLOUD_ERR_INVAL);
+    NUMBERIC_SANITY_CHECK(pParams->max_properties, QCLOUD_ERR_INVAL);
+    NUMBERIC_SANITY_CHECK(pParams->buffer_size, QCLOUD_ERR_INVAL);
+    NUMBERIC_SANITY_CHECK(pParams->timeout_ms, QCLOUD_ERR_INVAL);
+
+    Qcloud_IoT_Template *pTemplate = (Qcloud_IoT_Template *)handle;
+    TemplateReportSched *pSched;
+
+    if (pTemplate->inner_data.report_sched != NULL) {
+        Log_e("report scheduler is inited");
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_INVAL);
+    }
+
+    pSched = (TemplateReportSched *)HAL_Malloc(sizeof(TemplateReportSched));
+    if (pSched == NULL) {
+        Log_e("malloc report scheduler failed");
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_MALLOC);
+    }
+    memset(pSched, 0, sizeof(TemplateReportSched));
+
+    pSched->pending = (DeviceProperty **)HAL_Malloc(pParams->max_properties * sizeof(DeviceProperty *));
+    pSched->sending = (DeviceProperty **)HAL_Malloc(pParams->max_properties * sizeof(DeviceProperty *));
+    pSched->json_buf = (char *)HAL_Malloc(pParams->buffer_size);
+    if (pSched->pending == NULL || pSched->sending == NULL || pSched->json_buf == NULL) {
+        Log_e("malloc report scheduler failed");
+        _report_sched_free(pSched);
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_MALLOC);
+    }
+
+    pSched->params = *pParams;
+    pSched->tokens = (uint32_t)pParams->burst * REPORT_TOKEN_UNIT;
+    pSched->refill_time = HAL_GetTimeMs();
+
+    HAL_MutexLock(pTemplate->mutex);
+    pTemplate->inner_data.report_sched = pSched;
+    HAL_MutexUnlock(pTemplate->mutex);
+
+    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+}
+
+void template_report_sched_deinit(Qcloud_IoT_Template *pTemplate)
+{
+    if (pTemplate->inner_data.report_sched != NULL) {
+        _report_sched_free((TemplateReportSched *)pTemplate->inner_data.report_sched);
+        pTemplate->inner_data.report_sched = NULL;
+    }
+}
+
+int IOT_Template_Report_Schedule(void *handle, uint8_t count, DeviceProperty *pDeviceProperties[])
+{
+    IOT_FUNC_ENTRY;
+
+    POINTER_SANITY_CHECK(handle, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(pDeviceProperties, QCLOUD_ERR_INVAL);
+
+    Qcloud_IoT_Template *pTemplate = (Qcloud_IoT_Template *)handle;
+    TemplateReportSched *pSched = (TemplateReportSched *)pTemplate->inner_data.report_sched;
+    uint32_t             now = HAL_GetTimeMs();
+    int                  rc = QCLOUD_RET_SUCCESS;
+    int                  i;
+
+    if (pSched == NULL) {
+        Log_e("report scheduler is not inited");
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_INVAL);
+    }
+
+    HAL_MutexLock(pTemplate->mutex);
+    for (i = 0; i < count; i++) {
+        if (pDeviceProperties[i] == NULL || pDeviceProperties[i]->key == NULL) {
+            rc = QCLOUD_ERR_INVAL;
+            continue;
+        }
+
+        if (_pending_merge(pSched, pDeviceProperties[i], now) != QCLOUD_RET_SUCCESS) {
+            rc = QCLOUD_ERR_MAX_APPENDING_REQUEST;
+        }
+    }
+    HAL_MutexUnlock(pTemplate->mutex);
+
+    if (rc == QCLOUD_ERR_MAX_APPENDING_REQUEST) {
+        Log_w("report queue is full, %d properties waiting", pSched->params.max_properties);
+    }
+
+    IOT_FUNC_EXIT_RC(rc);
+}
+
+int IOT_Template_ReportSched_GetStats(void *handle, ReportSchedStats *pStats)
+{
+    POINTER_SANITY_CHECK(handle, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(pStats, QCLOUD_ERR_INVAL);
+
+    Qcloud_IoT_Template *pTemplate = (Qcloud_IoT_Template *)handle;
+
+    if (pTemplate->inner_data.report_sched == NULL) {
+        return QCLOUD_ERR_INVAL;
+    }
+
+    HAL_MutexLock(pTemplate->mutex);
+    *pStats = ((TemplateReportSched *)pTemplate->inner_data.report_sched)->stats;
+    HAL_MutexUnlock(pTemplate->mutex);
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+void handle_template_report_sched(Qcloud_IoT_Template *pTemplate)
+{
+    TemplateReportSched *pSched = (TemplateReportSched *)pTemplate->inner_data.report_sched;
+    uint32_t             now = HAL_GetTimeMs();
+    uint16_t             count;
+    int                  rc, i;
+
+    if (pSched == NULL) {
+        return;
+    }
+
+    HAL_MutexLock(pTemplate->mutex);
+    if (pSched->stats.queue_depth == 0 || (uint32_t)(now - pSched->first_change_time) < pSched->params.window_ms) {
+        HAL_MutexUnlock(pTemplate->mutex);
+        return;
+    }
+
+    _refill_tokens(pSched, now);
+    if (pSched->tokens < REPORT_TOKEN_UNIT) {
+        pSched->stats.throttled++;
+        HAL_MutexUnlock(pTemplate->mutex);
+        return;
+    }
+
+    if (pTemplate->inner_data.reply_count >= MAX_APPENDING_REQUEST_AT_ANY_GIVEN_TIME) {
+        HAL_MutexUnlock(pTemplate->mutex);
+        return;
+    }
+
+    /* take the pending properties, changes from now on go into next report */
+    count = pSched->stats.queue_depth;
+    memcpy(pSched->sending, pSched->pending, count * sizeof(DeviceProperty *));
+    pSched->stats.queue_depth = 0;
+    pSched->tokens -= REPORT_TOKEN_UNIT;
+    HAL_MutexUnlock(pTemplate->mutex);
+
+    /* values are read now, the last one wins */
+    rc = IOT_Template_JSON_ConstructReportArray(pTemplate, pSched->json_buf, pSched->params.buffer_size, count,
+                                                pSched->sending);
+    if (rc == QCLOUD_RET_SUCCESS) {
+        rc = IOT_Template_Report(pTemplate, pSched->json_buf, pSched->params.buffer_size, pSched->params.callback,
+                                 pSched->params.user_context, pSched->params.timeout_ms);
+    } else {
+        /* report could not be built, retrying would never succeed */
+        Log_e("construct scheduled report failed, %d properties dropped: %d", count, rc);
+        HAL_MutexLock(pTemplate->mutex);
+        pSched->stats.dropped += count;
+        HAL_MutexUnlock(pTemplate->mutex);
+        return;
+    }
+
+    HAL_MutexLock(pTemplate->mutex);
+    if (rc == QCLOUD_RET_SUCCESS) {
+        pSched->stats.reports++;
+    } else {
+        /* put back for next try, token is refunded */
+        Log_w("scheduled report failed, retry later: %d", rc);
+        for (i = 0; i < count; i++) {
+            if (_pending_find(pSched, pSched->sending[i]) < 0 &&
+                _pending_merge(pSched, pSched->sending[i], now) != QCLOUD_RET_SUCCESS) {
+                break;
+            }
+        }
+        _put_tokens(pSched, REPORT_TOKEN_UNIT);
+    }
+    HAL_MutexUnlock(pTemplate->mutex);
+}
+
+#ifdef __cplusplus
+}
+#endif
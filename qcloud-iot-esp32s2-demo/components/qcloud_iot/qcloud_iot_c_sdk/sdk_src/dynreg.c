@@ -106,80 +106,71 @@ void srand_d(unsigned int i)
 
 static int _get_json_resault_code(char *json)
 {
-    int   resault = -1;
-    char *v       = LITE_json_value_of(CODE_RESAULT, json);
+    int32_t     resault = -1;
+    json_span_t v;
 
-    if (v == NULL) {
+    if (LITE_json_span_of(CODE_RESAULT, json, &v) != QCLOUD_RET_SUCCESS) {
         Log_e("Invalid json content: %s", json);
         return -1;
     }
 
-    if (LITE_get_int32(&resault, v) != QCLOUD_RET_SUCCESS) {
+    if (LITE_span_get_int32(&resault, &v) != QCLOUD_RET_SUCCESS) {
         Log_e("Invalid json content: %s", json);
-        HAL_Free(v);
         return -1;
     }
 
-    HAL_Free(v);
-
     return resault;
 }
 
 static int _get_json_encry_type(char *json)
 {
-    int   type = -1;
-    char *v    = LITE_json_value_of(ENCRYPT_TYPE, json);
+    int32_t     type = -1;
+    json_span_t v;
 
-    if (v == NULL) {
+    if (LITE_json_span_of(ENCRYPT_TYPE, json, &v) != QCLOUD_RET_SUCCESS) {
         Log_e("Get encrypt type fail, %s", json);
         return -1;
     }
 
-    if (LITE_get_int32(&type, v) != QCLOUD_RET_SUCCESS) {
+    if (LITE_span_get_int32(&type, &v) != QCLOUD_RET_SUCCESS) {
         Log_e("Invalid json content: %s", json);
-        HAL_Free(v);
         return -1;
     }
 
-    HAL_Free(v);
-
     return type;
 }
 
 #ifndef AUTH_MODE_CERT
 
-static char *_get_json_psk(char *json)
+static bool _get_json_psk(char *json, json_span_t *psk)
 {
-    char *psk = LITE_json_value_of(PSK_DATA, json);
-
-    if (psk == NULL) {
+    if (LITE_json_span_of(PSK_DATA, json, psk) != QCLOUD_RET_SUCCESS) {
         Log_e("Get psk fail: %s", json);
+        return false;
     }
 
-    return psk;
+    return true;
 }
 
 #else
-static char *_get_json_cert_data(char *json)
+static bool _get_json_cert_data(char *json, json_span_t *cert)
 {
-    char *cert = LITE_json_value_of(CERT_DATA, json);
-
-    if (cert == NULL) {
+    if (LITE_json_span_of(CERT_DATA, json, cert) != QCLOUD_RET_SUCCESS) {
         Log_e("Get clientCert fail: %s", json);
+        return false;
     }
 
-    return cert;
+    return true;
 }
 
-static char *_get_json_key_data(char *json)
+static bool _get_json_key_data(char *json, json_span_t *key)
 {
-    char *key = LITE_json_value_of(KEY_DATA, json);
-
-    if (key == NULL) {
+    if (LITE_json_span_of(KEY_DATA, json, key) != QCLOUD_RET_SUCCESS) {
         Log_e("Get clientCert fail: %s", json);
+        return false;
     }
 
-    return key;
+    return true;
 }
 
 /*\\n in data change to '\n'*/
@@ -211,7 +202,7 @@ static int _cert_file_save(const char *fileName, char *data, uint32_t dataLen)
     }
 
     _deal_transfer(data, dataLen);
-    len = fprintf(fp, "%s", data);
+    len = fprintf(fp, "%.*s", (int)dataLen, data);
     fclose(fp);
 
     if (len == dataLen) {
@@ -292,13 +283,13 @@ static int _parse_devinfo(char *jdoc, DeviceInfo *pDevInfo)
     char          key[UTILS_AES_BLOCK_LEN + 1];
     char          decodeBuff[DECODE_BUFF_LEN] = {0};
     unsigned char iv[16];
-    char *        payload = NULL;
+    json_span_t   payload;
 
 #ifdef AUTH_MODE_CERT
-    char *clientCert;
-    char *clientKey;
+    json_span_t clientCert;
+    json_span_t clientKey;
 #else
-    char *psk;
+    json_span_t psk;
 #endif
 
     Log_d("Recv msg: %s", jdoc);
@@ -309,17 +300,16 @@ static int _parse_devinfo(char *jdoc, DeviceInfo *pDevInfo)
         return ret;
     }
 
-    payload = LITE_json_value_of("payload", jdoc);
-    if (payload == NULL) {
+    if (LITE_json_span_of("payload", jdoc, &payload) != QCLOUD_RET_SUCCESS) {
         Log_e("Invalid json content: %s", jdoc);
         ret = QCLOUD_ERR_FAILURE;
         goto exit;
     }
 
-    ret = qcloud_iot_utils_base64decode((uint8_t *)decodeBuff, sizeof(decodeBuff), &len, (uint8_t *)payload,
-                                        strlen(payload));
+    ret = qcloud_iot_utils_base64decode((uint8_t *)decodeBuff, sizeof(decodeBuff), &len, (uint8_t *)payload.str,
+                                        payload.len);
     if (ret != QCLOUD_RET_SUCCESS) {
-        Log_e("Response decode err, response:%s", payload);
+        Log_e("Response decode err, response:%.*s", payload.len, payload.str);
         ret = QCLOUD_ERR_FAILURE;
         goto exit;
     }
@@ -350,35 +340,31 @@ static int _parse_devinfo(char *jdoc, DeviceInfo *pDevInfo)
         goto exit;
     }
 
-    clientCert = _get_json_cert_data(decodeBuff);
-    if (NULL != clientCert) {
+    if (_get_json_cert_data(decodeBuff, &clientCert)) {
         memset(pDevInfo->device_cert_file_name, 0, MAX_SIZE_OF_DEVICE_CERT_FILE_NAME);
         HAL_Snprintf(pDevInfo->device_cert_file_name, MAX_SIZE_OF_DEVICE_CERT_FILE_NAME, "%s_cert.crt",
                      pDevInfo->device_name);
-        if (QCLOUD_RET_SUCCESS != _cert_file_save(pDevInfo->device_cert_file_name, clientCert, strlen(clientCert))) {
+        if (QCLOUD_RET_SUCCESS != _cert_file_save(pDevInfo->device_cert_file_name, (char *)clientCert.str,
+                                                  clientCert.len)) {
             Log_e("save %s file fail", pDevInfo->device_cert_file_name);
             ret = QCLOUD_ERR_FAILURE;
         }
 
-        HAL_Free(clientCert);
-
     } else {
         Log_e("Get clientCert data fail");
         ret = QCLOUD_ERR_FAILURE;
     }
 
-    clientKey = _get_json_key_data(decodeBuff);
-    if (NULL != clientKey) {
+    if (_get_json_key_data(decodeBuff, &clientKey)) {
         memset(pDevInfo->device_key_file_name, 0, MAX_SIZE_OF_DEVICE_KEY_FILE_NAME);
         HAL_Snprintf(pDevInfo->device_key_file_name, MAX_SIZE_OF_DEVICE_KEY_FILE_NAME, "%s_private.key",
                      pDevInfo->device_name);
-        if (QCLOUD_RET_SUCCESS != _cert_file_save(pDevInfo->device_key_file_name, clientKey, strlen(clientKey))) {
+        if (QCLOUD_RET_SUCCESS != _cert_file_save(pDevInfo->device_key_file_name, (char *)clientKey.str,
+                                                  clientKey.len)) {
             Log_e("save %s file fail", pDevInfo->device_key_file_name);
             ret = QCLOUD_ERR_FAILURE;
         }
 
-        HAL_Free(clientKey);
-
     } else {
         Log_e("Get clientCert data fail");
         ret = QCLOUD_ERR_FAILURE;
@@ -391,16 +377,11 @@ static int _parse_devinfo(char *jdoc, DeviceInfo *pDevInfo)
         goto exit;
     }
 
-    psk = _get_json_psk(decodeBuff);
-    if (NULL != psk) {
-        if (strlen(psk) > MAX_SIZE_OF_DEVICE_SECRET) {
-            Log_e("psk exceed max len,%s", psk);
-            strcpy(pDevInfo->device_secret, psk);
-        } else {
-            strncpy(pDevInfo->device_secret, psk, MAX_SIZE_OF_DEVICE_SECRET);
-            pDevInfo->device_secret[MAX_SIZE_OF_DEVICE_SECRET] = '\0';
+    if (_get_json_psk(decodeBuff, &psk)) {
+        if (LITE_span_get_string(pDevInfo->device_secret, MAX_SIZE_OF_DEVICE_SECRET + 1, &psk) != QCLOUD_RET_SUCCESS) {
+            Log_e("psk exceed max len,%.*s", psk.len, psk.str);
+            ret = QCLOUD_ERR_FAILURE;
         }
-        HAL_Free(psk);
         // Just for test,release should be deleted
         // Log_d("Get PSK: %s", pDevInfo->device_secret);
     } else {
@@ -411,10 +392,6 @@ static int _parse_devinfo(char *jdoc, DeviceInfo *pDevInfo)
 
 exit:
 
-    if (payload) {
-        HAL_Free(payload);
-    }
-
     return ret;
 }
 
@@ -1,49 +1,41 @@
 
 #include "lite-utils.h"
+#include "json_parser.h"
 #include "mqtt_client.h"
 #include "gateway_common.h"
 
 
-static char cloud_rcv_buf[GATEWAY_RECEIVE_BUFFER_LEN];
-
-
-static bool get_json_type(char *json, char **v)
+static bool get_json_type(char *json, json_span_t *v)
 {
-    *v = LITE_json_value_of("type", json);
-    return *v == NULL ? false : true;
+    return LITE_json_span_of("type", json, v) == QCLOUD_RET_SUCCESS ? true : false;
 }
 
-static bool get_json_devices(char *json, char **v)
+static bool get_json_devices(char *json, json_span_t *v)
 {
-    *v = LITE_json_value_of("payload.devices", json);
-    return *v == NULL ? false : true;
+    return LITE_json_span_of("payload.devices", json, v) == QCLOUD_RET_SUCCESS ? true : false;
 }
 
-static bool get_json_result(char *json, int32_t* res)
+static bool get_json_result(json_span_t *devices, int32_t* res)
 {
-    char *v = LITE_json_value_of("result", json);
-    if (v == NULL) {
+    json_span_t v;
+    if (LITE_json_span_at("result", devices->str, devices->len, &v) != QCLOUD_RET_SUCCESS) {
         return false;
     }
-    if (LITE_get_int32(res, v) != QCLOUD_RET_SUCCESS) {
-        HAL_Free(v);
+    if (LITE_span_get_int32(res, &v) != QCLOUD_RET_SUCCESS) {
         return false;
     }
-    HAL_Free(v);
     return true;
 }
 
-static bool get_json_product_id(char *json, char **v)
+static bool get_json_product_id(json_span_t *devices, json_span_t *v)
 {
-    *v = LITE_json_value_of("product_id", json);
-    return *v == NULL ? false : true;
+    return LITE_json_span_at("product_id", devices->str, devices->len, v) == QCLOUD_RET_SUCCESS ? true : false;
 }
 
 
-static bool get_json_device_name(char *json, char **v)
+static bool get_json_device_name(json_span_t *devices, json_span_t *v)
 {
-    *v = LITE_json_value_of("device_name", json);
-    return *v == NULL ? false : true;
+    return LITE_json_span_at("device_name", devices->str, devices->len, v) == QCLOUD_RET_SUCCESS ? true : false;
 }
 
 static void _gateway_message_handler(void *client, MQTTMessage *message, void *user_data)
@@ -52,11 +44,11 @@ static void _gateway_message_handler(void *client, MQTTMessage *message, void *u
     Gateway *gateway = NULL;
     char *topic = NULL;
     size_t topic_len = 0;
-    int cloud_rcv_len = 0;
-    char *type = NULL;
-    char *devices = NULL, *devices_strip = NULL;
-    char *product_id = NULL;
-    char *device_name = NULL;
+    char *cloud_rcv_buf = NULL;
+    json_span_t type;
+    json_span_t devices;
+    json_span_t product_id;
+    json_span_t device_name;
     int32_t result = 0;
     char client_id[MAX_SIZE_OF_CLIENT_ID + 1] = {0};
     int size = 0;
@@ -75,14 +67,8 @@ static void _gateway_message_handler(void *client, MQTTMessage *message, void *u
         return;
     }
 
-    if (message->payload_len > GATEWAY_RECEIVE_BUFFER_LEN) {
-        Log_e("message->payload_len > GATEWAY_RECEIVE_BUFFER_LEN.");
-        return;
-    }
-
-    cloud_rcv_len = Min(GATEWAY_RECEIVE_BUFFER_LEN - 1, message->payload_len);
-    memcpy(cloud_rcv_buf, message->payload, cloud_rcv_len + 1);
-    cloud_rcv_buf[cloud_rcv_len] = '\0';    // jsmn_parse relies on a string
+    // payload is null terminated by MQTT client, values are looked up in place
+    cloud_rcv_buf = (char *)message->payload;
 //      Log_d("recv:%s", cloud_rcv_buf);
 
     if (!get_json_type(cloud_rcv_buf, &type)) {
@@ -92,63 +78,52 @@ static void _gateway_message_handler(void *client, MQTTMessage *message, void *u
 
     if (!get_json_devices(cloud_rcv_buf, &devices)) {
         Log_e("Fail to parse devices from msg: %s", cloud_rcv_buf);
-        HAL_Free(type);
         return;
     }
 
-    if (devices[0] == '[') {
-        devices_strip = devices + 1;
-    } else {
-        devices_strip = devices;
+    // look up in the first device of array
+    if (devices.type == JSARRAY) {
+        devices.str++;
+        devices.len--;
+        while (devices.len > 0 && devices.str[0] != '{') {
+            devices.str++;
+            devices.len--;
+        }
     }
 
-    if (!get_json_result(devices_strip, &result)) {
+    if (!get_json_result(&devices, &result)) {
         Log_e("Fail to parse result from msg: %s", cloud_rcv_buf);
-        HAL_Free(type);
-        HAL_Free(devices);
         return;
     }
-    if (!get_json_product_id(devices_strip, &product_id)) {
+    if (!get_json_product_id(&devices, &product_id)) {
         Log_e("Fail to parse product_id from msg: %s", cloud_rcv_buf);
-        HAL_Free(type);
-        HAL_Free(devices);
         return;
     }
-    if (!get_json_device_name(devices_strip, &device_name)) {
+    if (!get_json_device_name(&devices, &device_name)) {
         Log_e("Fail to parse device_name from msg: %s", cloud_rcv_buf);
-        HAL_Free(type);
-        HAL_Free(devices);
-        HAL_Free(product_id);
         return;
     }
 
-    size = HAL_Snprintf(client_id, MAX_SIZE_OF_CLIENT_ID + 1, GATEWAY_CLIENT_ID_FMT, product_id, device_name);
+    size = HAL_Snprintf(client_id, MAX_SIZE_OF_CLIENT_ID + 1, GATEWAY_CLIENT_ID_FMT_SPAN, product_id.len, product_id.str,
+                        device_name.len, device_name.str);
     if (size < 0 || size > MAX_SIZE_OF_CLIENT_ID) {
         Log_e("generate client_id fail.");
-        HAL_Free(type);
-        HAL_Free(devices);
-        HAL_Free(product_id);
-        HAL_Free(device_name);
         return;
     }
 
 
-    if (strncmp(type, "online", sizeof("online") - 1) == 0) {
+    if (LITE_span_equal(&type, "online")) {
         if (strncmp(client_id,  gateway->gateway_data.online.client_id, size) == 0) {
             Log_i("client_id(%s), online result %d", client_id, result);
             gateway->gateway_data.online.result = result;
         }
-    } else if (strncmp(type, "offline", sizeof("offline") - 1) == 0) {
+    } else if (LITE_span_equal(&type, "offline")) {
         if (strncmp(client_id,  gateway->gateway_data.offline.client_id, size) == 0) {
             Log_i("client_id(%s), offline result %d", client_id, result);
             gateway->gateway_data.offline.result = result;
         }
     }
 
-    HAL_Free(type);
-    HAL_Free(devices);
-    HAL_Free(product_id);
-    HAL_Free(device_name);
     return;
 
 }
@@ -36,16 +36,34 @@ extern "C" {
 
 #define MAX_CLEAE_DOC_LEN		256
 
+/* slots of requests waiting for reply, power of 2 and not less than MAX_APPENDING_REQUEST_AT_ANY_GIVEN_TIME */
+#define TEMPLATE_REPLY_SLOT_COUNT       (16)
+
+#if (TEMPLATE_REPLY_SLOT_COUNT < MAX_APPENDING_REQUEST_AT_ANY_GIVEN_TIME) || \
+    (TEMPLATE_REPLY_SLOT_COUNT & (TEMPLATE_REPLY_SLOT_COUNT - 1))
+#error "TEMPLATE_REPLY_SLOT_COUNT must be a power of 2 not less than MAX_APPENDING_REQUEST_AT_ANY_GIVEN_TIME"
+#endif
+
 typedef struct _TemplateInnerData {
     uint32_t token_num;
     int32_t sync_status;
 	uint32_t eventflags;
 	List *event_list;
-    List *reply_list;
+    void *event_queue;              // queue of events posted in batch, NULL if not inited
+    Request reply_slots[TEMPLATE_REPLY_SLOT_COUNT];    // requests waiting for reply, indexed by clientToken suffix
+    uint8_t reply_count;            // number of slots in use
+    TimerWheelList reply_expired;   // requests in reply_slots timed out
+    TimerWheelList event_expired;   // events in event_list timed out
 	List *action_handle_list;
     List *property_handle_list;   
+    PropertyHandler **property_index;   // handlers of property_handle_list sorted by key, for dispatch of control
+    uint16_t property_count;
+    uint16_t property_index_size;
 	char *upstream_topic;		//upstream topic
     char *downstream_topic;		//downstream topic
+    TemplateJsonDoc rx_doc;         // downstream message being handled, used in MQTT yield context only
+    TemplateJsonDoc tx_doc;         // upstream request being sent, protected by mutex
+    void *report_sched;             // report scheduler, NULL if not inited
 } TemplateInnerData;
 
 typedef struct _Template {
@@ -55,6 +73,9 @@ typedef struct _Template {
     TemplateInnerData inner_data;
 } Qcloud_IoT_Template;
 
+/* reply deadlines are registered in the timer wheel of MQTT client */
+#define TEMPLATE_TIMER_WHEEL(pTemplate)     (&((Qcloud_IoT_Client *)(pTemplate)->mqtt)->timer_wheel)
+
 
 /**
  * @brief init data template client
@@ -78,6 +99,20 @@ void qcloud_iot_template_reset(void *pClient);
  */
 void handle_template_expired_reply(Qcloud_IoT_Template *pTemplate);
 
+/**
+ * @brief send the scheduled report if its window passed and rate limit allows
+ * 
+ * @param pTemplate   data template client
+ */
+void handle_template_report_sched(Qcloud_IoT_Template *pTemplate);
+
+/**
+ * @brief release report scheduler of data template client
+ * 
+ * @param pTemplate   data template client
+ */
+void template_report_sched_deinit(Qcloud_IoT_Template *pTemplate);
+
 /**
  * @brief get the clientToken of control message for control_reply
  * 
@@ -51,6 +51,18 @@ int template_common_remove_property(Qcloud_IoT_Template *ptemplate, DeviceProper
  */ 
 int template_common_check_property_existence(Qcloud_IoT_Template *ptemplate, DeviceProperty *pProperty);
 
+/**
+ * @brief find handlers of property by key in the sorted index, should be called with mutex locked
+ *
+ * @param pTemplate handle to data_template client
+ * @param pKey      key, not necessarily '\0' terminated
+ * @param keyLen    length of key
+ * @param pHandlers first handler of the key in index
+ * @return          number of handlers registered with the key, 0 if not found
+ */
+int template_common_find_property(Qcloud_IoT_Template *pTemplate, const char *pKey, size_t keyLen,
+                                  PropertyHandler ***pHandlers);
+
 
 #ifdef __cplusplus
 }
@@ -21,21 +21,28 @@ extern "C" {
 #endif
 #include "qcloud_iot_export.h"
 #include "qcloud_iot_import.h"
+#include "utils_list.h"
+#include "utils_timer_wheel.h"
+#include "json_parser.h"
+#include "json_writer.h"
 
 #define min(a,b) (a) < (b) ? (a) : (b)
 
 /* Max number of requests in appending state */
 #define MAX_APPENDING_REQUEST_AT_ANY_GIVEN_TIME                     (10)
 
-/* Size of buffer to receive JSON document from server */
-#define CLOUD_IOT_JSON_RX_BUF_LEN                                   (QCLOUD_IOT_MQTT_RX_BUF_LEN + 1)
-
 /* Max size of clientToken */
 #define MAX_SIZE_OF_CLIENT_TOKEN                                    (MAX_SIZE_OF_CLIENT_ID + 10)
 
 /* Max size of JSON string which only contain clientToken field */
 #define MAX_SIZE_OF_JSON_WITH_CLIENT_TOKEN                          (MAX_SIZE_OF_CLIENT_TOKEN + 20)
 
+/* Max size of method field */
+#define MAX_SIZE_OF_TEMPLATE_METHOD                                 (32)
+
+/* Max size of actionId field */
+#define MAX_SIZE_OF_ACTION_ID                                       (64)
+
 
 #define CLIENT_TOKEN_FIELD     		"clientToken"
 #define METHOD_FIELD	         	"method"
@@ -91,7 +98,9 @@ typedef struct {
     Method                 method;                                          // method type
 
     void                   *user_context;                                   // user context
-    Timer                  timer;                                           // timer for timeout
+    TimerWheelEntry        timer_entry;                                     // timer for timeout
+    uint32_t               token_key;                                       // numeric suffix of clientToken
+    bool                   in_use;                                          // slot is waiting for reply
 
     OnReplyCallback      callback;                                        // request response callback
 } Request;
@@ -102,12 +111,21 @@ typedef struct {
  */
 typedef struct {
 
-    void *property;							
+    DeviceProperty *property;
 
-    OnPropRegCallback callback;      		
+    OnPropRegCallback callback;
 
 } PropertyHandler;
 
+/**
+ * @brief JSON document tokenized once, and looked up by the parse_* helpers
+ */
+typedef struct {
+    char                   *json;                                           // JSON string, not copied
+    int                    token_count;                                     // number of tokens parsed
+    json_token_t           tokens[QCLOUD_IOT_TEMPLATE_MAX_JSON_TOKENS];     // token index of JSON string
+} TemplateJsonDoc;
+
 
 /**
  * @brief save the action registed and its callback
@@ -132,38 +150,26 @@ typedef struct {
 int check_snprintf_return(int32_t returnCode, size_t maxSizeOfWrite);
 
 /**
- * @brief insert source string to the dest string with specified position
+ * add a JSON node to the document of writer
  *
- * @param pSourceStr   source string
- * @param pDestStr     dest string
- * @param pos          dest string positon
- */
-void insert_str(char *pDestStr, char *pSourceStr, int pos);
-
-
-/**
- * add a JSON node to JSON string
- *
- * @param jsonBuffer   	JSON string buffer
- * @param sizeOfBuffer  size of buffer
- * @param pKey          key of JSON node
+ * @param pWriter       JSON writer
+ * @param pKey          key of JSON node, NULL for entry of array
  * @param pData         value of JSON node
  * @param type          value type of JSON node
  * @return              QCLOUD_RET_SUCCESS for success, or err code for failure
  */
-int put_json_node(char *jsonBuffer, size_t sizeOfBuffer, const char *pKey, void *pData, JsonDataType type);
+int put_json_node(json_writer_t *pWriter, const char *pKey, void *pData, JsonDataType type);
 
 /**
- * add a JSON node to JSON string, data_template's bool type not the same to put_json_node
+ * add a JSON node to the document of writer, data_template's bool type not the same to put_json_node
  *
- * @param jsonBuffer   	JSON string buffer
- * @param sizeOfBuffer  size of buffer
- * @param pKey          key of JSON node
+ * @param pWriter       JSON writer
+ * @param pKey          key of JSON node, NULL for entry of array
  * @param pData         value of JSON node
  * @param type          value type of JSON node
  * @return              QCLOUD_RET_SUCCESS for success, or err code for failure
- */ 
-int template_put_json_node(char *jsonBuffer, size_t sizeOfBuffer, const char *pKey, void *pData, JsonDataType type);
+ */
+int template_put_json_node(json_writer_t *pWriter, const char *pKey, void *pData, JsonDataType type);
 
 /**
  * @brief generate a ClientToken
@@ -184,97 +190,120 @@ int generate_client_token(char *pStrBuffer, size_t sizeOfBuffer, uint32_t *token
 void build_empty_json(uint32_t *tokenNumber, char *pJsonBuffer);
 
 /**
- * @brief parse field of clientToken from JSON string
+ * @brief tokenize JSON string once for the parse_* helpers
+ *
+ * @param pDoc           document to hold tokens
+ * @param pJsonDoc       source JSON string, should be valid until pDoc is not used
+ * @return               QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int template_json_parse(TemplateJsonDoc *pDoc, char *pJsonDoc);
+
+/**
+ * @brief get value of key path in the object of JSON document, without copy
  *
- * @param pJsonDoc       source JSON string
- * @param pClientToken   pointer to field of ClientToken
+ * @param pDoc           tokenized JSON document
+ * @param object         token index of object to search the key, 0 for the root
+ * @param pKey           key path
+ * @param pSpan          value in the JSON string
  * @return               true for success
  */
-bool parse_client_token(char *pJsonDoc, char **pClientToken);
+bool template_json_span_of(TemplateJsonDoc *pDoc, int object, const char *pKey, json_span_t *pSpan);
 
 /**
- * @brief parse field of aciont_id from JSON string
+ * @brief parse field of clientToken from JSON document
  *
- * @param pJsonDoc       source JSON string
- * @param pActionID   	 pointer to field of action_id
+ * @param pDoc           tokenized JSON document
+ * @param pClientToken   buffer for field of ClientToken
+ * @param size           size of buffer
  * @return               true for success
  */
-bool parse_action_id(char *pJsonDoc, char **pActionID);
+bool parse_client_token(TemplateJsonDoc *pDoc, char *pClientToken, size_t size);
 
 /**
- * @brief parse field of timestamp from JSON string
+ * @brief parse field of aciont_id from JSON document
  *
- * @param pJsonDoc       source JSON string
+ * @param pDoc           tokenized JSON document
+ * @param pActionID   	 buffer for field of action_id
+ * @param size           size of buffer
+ * @return               true for success
+ */
+bool parse_action_id(TemplateJsonDoc *pDoc, char *pActionID, size_t size);
+
+/**
+ * @brief parse field of timestamp from JSON document
+ *
+ * @param pDoc           tokenized JSON document
  * @param pTimestamp     pointer to field of timestamp
  * @return               true for success
  */
-bool parse_time_stamp(char *pJsonDoc, int32_t *pTimestamp);
+bool parse_time_stamp(TemplateJsonDoc *pDoc, int32_t *pTimestamp);
 
 
 /**
- * @brief parse field of input from JSON string
+ * @brief parse field of input from JSON document
  *
- * @param pJsonDoc       source JSON string
- * @param pActionInput   filed of params as action input parameters
+ * @param pDoc           tokenized JSON document
+ * @param pActionInput   token index of params object as action input parameters
  * @return               true for success
  */ 
-bool parse_action_input(char *pJsonDoc, char **pActionInput);
+bool parse_action_input(TemplateJsonDoc *pDoc, int *pActionInput);
 
 /**
- * @brief parse field of status from JSON string
+ * @brief parse field of status from JSON document
  *
- * @param pJsonDoc       source JSON string
- * @param pStatus   	 pointer to field of status
+ * @param pDoc           tokenized JSON document
+ * @param pStatus   	 field of status in the JSON string
  * @return               true for success
  */
-bool parse_status_return(char *pJsonDoc, char **pStatus);
+bool parse_status_return(TemplateJsonDoc *pDoc, json_span_t *pStatus);
 
 /**
- * @brief parse field of code from JSON string
+ * @brief parse field of code from JSON document
  *
- * @param pJsonDoc       source JSON string
+ * @param pDoc           tokenized JSON document
  * @param pCode   		 pointer to field of Code
  * @return               true for success
  */
-bool parse_code_return(char *pJsonDoc, int32_t *pCode);
+bool parse_code_return(TemplateJsonDoc *pDoc, int32_t *pCode);
 
 
 /**
- * @brief update value in JSON if key is matched, not for OBJECT type
+ * @brief update property value by the JSON value converted to its type, not for OBJECT type
  *
- * @param pJsonDoc       JSON string
+ * @param pValue         JSON value
  * @param pProperty      device property
- * @return               true for success
+ * @return               QCLOUD_RET_SUCCESS for success, or err code for failure
  */
-bool update_value_if_key_match(char *pJsonDoc, DeviceProperty *pProperty);
+int update_property_value(const json_span_t *pValue, DeviceProperty *pProperty);
 
 
 /**
- * @brief parse field of method from JSON string
+ * @brief parse field of method from JSON document
  *
- * @param pJsonDoc		 source JSON string
- * @param pMethod 		 pointer to field of method
+ * @param pDoc			 tokenized JSON document
+ * @param pMethod 		 buffer for field of method
+ * @param size			 size of buffer
  * @return				 true for success
  */
-bool parse_template_method_type(char *pJsonDoc, char **pMethod);
+bool parse_template_method_type(TemplateJsonDoc *pDoc, char *pMethod, size_t size);
  
 /**
- * @brief parse field of control from get_status_reply JSON string 
+ * @brief parse field of control from get_status_reply JSON document
  *
- * @param pJsonDoc		 source JSON string
- * @param control 		 pointer to field of control
+ * @param pDoc			 tokenized JSON document
+ * @param control 		 token index of control object
  * @return				 true for success
  */ 
-bool parse_template_get_control(char *pJsonDoc, char **control);
+bool parse_template_get_control(TemplateJsonDoc *pDoc, int *control);
 
 /**
- * @brief parse field of control from control JSON string 
+ * @brief parse field of control from control JSON document
  *
- * @param pJsonDoc		 source JSON string
- * @param control 		 pointer to field of control
+ * @param pDoc			 tokenized JSON document
+ * @param control 		 token index of control object
  * @return				 true for success
  */ 
-bool parse_template_cmd_control(char *pJsonDoc, char **control);
+bool parse_template_cmd_control(TemplateJsonDoc *pDoc, int *control);
 
 #ifdef __cplusplus
 }
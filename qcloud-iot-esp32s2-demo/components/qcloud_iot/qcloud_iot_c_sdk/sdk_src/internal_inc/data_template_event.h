@@ -25,6 +25,9 @@ extern "C" {
 #include <stdarg.h>
 #include <stddef.h>
 
+#include "utils_list.h"
+#include "utils_timer_wheel.h"
+
 #define NAME_MAX_LEN			(32)
 #define TYPE_MAX_LEN			(32)
 #define EVENT_TOKEN_MAX_LEN		(32)
@@ -33,6 +36,7 @@ extern "C" {
 
 
 #define MAX_EVENT_WAIT_REPLY    (10) 
+#define EVENT_QUEUE_DOC_HEAD_LEN    (96)     // method, clientToken and events array around the events of a batch
 #define EVENT_MAX_DATA_NUM		(255)
 
 #define POST_EVENT				"event_post"
@@ -57,11 +61,26 @@ typedef enum _eEventDealType_{
 typedef struct _sReply_{
     char       client_token[EVENT_TOKEN_MAX_LEN];               // clientToken for this event reply
     void       *user_context;                                   // user context
-    Timer      timer;                                           // timer for request timeout
+    TimerWheelEntry timer_entry;                                // timer for request timeout
+    ListNode   *node;                                           // node in event list
 
     OnEventReplyCallback      callback;                         // callback for this event reply
 } sEventReply;
 
+/**
+ * @brief post the events queued as a batch if size or age threshold is hit, in yield context
+ *
+ * @param client    handle to data_template client
+ */
+void handle_template_event_queue(void *client);
+
+/**
+ * @brief release event queue of data_template client
+ *
+ * @param client    handle to data_template client
+ */
+void template_event_queue_deinit(void *client);
+
 
 #ifdef __cplusplus
 }
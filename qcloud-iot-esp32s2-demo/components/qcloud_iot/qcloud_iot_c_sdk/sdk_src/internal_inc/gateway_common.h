@@ -4,7 +4,6 @@
 #include "qcloud_iot_export.h"
 
 #define GATEWAY_PAYLOAD_BUFFER_LEN 1024
-#define GATEWAY_RECEIVE_BUFFER_LEN 1024
 #define GATEWAY_LOOP_MAX_COUNT     100
 
 
@@ -16,6 +15,7 @@
 
 /* The format of gateway client id */
 #define GATEWAY_CLIENT_ID_FMT            "%s/%s"
+#define GATEWAY_CLIENT_ID_FMT_SPAN       "%.*s/%.*s"
 
 /* The format of operation result of gateway topic */
 #define GATEWAY_PAYLOAD_STATUS_FMT            "{\"type\":\"%s\",\"payload\":{\"devices\":[{\"product_id\":\"%s\",\"device_name\":\"%s\"}]}}"
@@ -55,6 +55,78 @@ enum JSON_PARSE_RESULT {
     JSON_RESULT_OK
 };
 
+/**
+The error codes produced by the JSON tokenizer
+**/
+enum JSON_TOKEN_ERR {
+    JSON_TOKEN_ERR_NOMEM = -1,      /* not enough tokens */
+    JSON_TOKEN_ERR_INVAL = -2,      /* invalid character or structure */
+    JSON_TOKEN_ERR_PART  = -3       /* string is not a complete JSON value */
+};
+
+/* no parent token */
+#define JSON_TOKEN_NONE         (0xFFFF)
+
+/* max length of JSON string and max number of tokens, limited by the offsets of token */
+#define JSON_TOKEN_MAX_LEN      (0xFFFE)
+
+/**
+The token of a JSON value. All the tokens of a document are kept in a flat array in document order,
+so the children of an object or array follow their parent, and key of object is a JSSTRING token
+followed by its value.
+**/
+typedef struct {
+    int8_t      type;       /* enum JSONTYPE */
+    uint16_t    start;      /* offset of the first char, quotes of string are excluded */
+    uint16_t    end;        /* offset after the last char */
+    uint16_t    size;       /* number of keys of object or entries of array, 1 for key with value */
+    uint16_t    parent;     /* index of parent token, JSON_TOKEN_NONE for root */
+    uint16_t    next;       /* index of the token after this value and all of its children */
+} json_token_t;
+
+/**
+ * @brief Tokenize the JSON string once, into a flat token array provided by caller.
+ *
+ * @param[in]  p_cJsonStr @n  The JSON string, parsing stops at '\0'
+ * @param[in]  iStrLen    @n  The JSON string length
+ * @param[out] pTokens    @n  Token array
+ * @param[in]  iTokenNum  @n  Number of tokens of the array
+ * @return number of tokens used, or enum JSON_TOKEN_ERR for failure
+ * @see None.
+ * @note string values are not unescaped, the tokens keep offsets into the original string.
+ **/
+int json_tokenize(const char *p_cJsonStr, int iStrLen, json_token_t *pTokens, int iTokenNum);
+
+/**
+ * @brief Find a value by key path in the tokens, cost is in proportion to the depth of path.
+ *
+ * @param[in]  p_cJsonStr @n  The JSON string tokenized
+ * @param[in]  pTokens    @n  Tokens from json_tokenize
+ * @param[in]  iParent    @n  Index of object token to search from, 0 for the root
+ * @param[in]  p_cPath    @n  Key path, nested keys are separated by '.', e.g. "data.control"
+ * @return index of the value token, or -1 if not found
+ * @see None.
+ * @note None.
+ **/
+int json_token_lookup(const char *p_cJsonStr, const json_token_t *pTokens, int iParent, const char *p_cPath);
+
+/**
+ * @brief Find a value by key path in a single scan of the JSON string, without tokens and without
+ * modifying the string. Values of keys not matched are skipped.
+ *
+ * @param[in]  p_cJsonStr   @n  The JSON string, scanning stops at '\0'
+ * @param[in]  iStrLen      @n  The JSON string length
+ * @param[in]  p_cPath      @n  Key path, nested keys are separated by '.'
+ * @param[out] p_cValue     @n  Value in the JSON string, quotes of string are excluded
+ * @param[out] p_iValueLen  @n  The value length
+ * @param[out] p_iValueType @n  The value type, could be NULL
+ * @return JSON_RESULT_OK success, JSON_RESULT_ERR not found or invalid JSON
+ * @see None.
+ * @note None.
+ **/
+int json_value_lookup(const char *p_cJsonStr, int iStrLen, const char *p_cPath, const char **p_cValue,
+                      int *p_iValueLen, int *p_iValueType);
+
 typedef int (*json_parse_cb)(char *p_cName, int iNameLen, char *p_cValue, int iValueLen, int iValueType,
                              void *p_Result);
 
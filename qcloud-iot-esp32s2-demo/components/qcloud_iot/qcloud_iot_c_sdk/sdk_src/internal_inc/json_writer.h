@@ -0,0 +1,92 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef QCLOUD_IOT_JSON_WRITER_H_
+#define QCLOUD_IOT_JSON_WRITER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* max nesting depth of objects and arrays */
+#define JSON_WRITER_MAX_DEPTH       (16)
+
+/**
+ * @brief append-only JSON writer
+ *
+ * The writer keeps the position and remaining capacity of the buffer, so each value is appended in
+ * place without scanning the document, and commas between members are inserted by the writer.
+ * The buffer is always '\0' terminated. The first error is kept and later writes are ignored, so
+ * callers may write the whole document and check the result once by json_writer_finish.
+ */
+typedef struct {
+    char       *buf;
+    size_t      size;
+    size_t      len;
+    uint8_t     depth;
+    uint32_t    has_member;     /* bit per nesting level, set after the first member is written */
+    int         err;
+} json_writer_t;
+
+/**
+ * @brief init writer with buffer
+ *
+ * @param writer    writer
+ * @param buf       buffer of document
+ * @param size      size of buffer, including '\0'
+ */
+void json_writer_init(json_writer_t *writer, char *buf, size_t size);
+
+/**
+ * @brief begin object or array, key is NULL for root or entry of array
+ */
+void json_writer_object_begin(json_writer_t *writer, const char *key);
+void json_writer_object_end(json_writer_t *writer);
+void json_writer_array_begin(json_writer_t *writer, const char *key);
+void json_writer_array_end(json_writer_t *writer);
+
+/**
+ * @brief write member with value, key is NULL for entry of array
+ *
+ * String is escaped, raw is written as it is and should be valid JSON.
+ * A NULL string or raw is written as null.
+ */
+void json_writer_string(json_writer_t *writer, const char *key, const char *value);
+void json_writer_raw(json_writer_t *writer, const char *key, const char *value);
+void json_writer_int32(json_writer_t *writer, const char *key, int32_t value);
+void json_writer_uint32(json_writer_t *writer, const char *key, uint32_t value);
+void json_writer_double(json_writer_t *writer, const char *key, double value);
+void json_writer_float(json_writer_t *writer, const char *key, float value);
+void json_writer_bool(json_writer_t *writer, const char *key, bool value);
+void json_writer_null(json_writer_t *writer, const char *key);
+
+/**
+ * @brief check the document written
+ *
+ * @param writer    writer
+ * @return length of document, or QCLOUD_ERR_JSON_BUFFER_TRUNCATED if buffer is not enough,
+ *         QCLOUD_ERR_JSON if objects or arrays are not closed or nested too deep
+ */
+int json_writer_finish(json_writer_t *writer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //QCLOUD_IOT_JSON_WRITER_H_
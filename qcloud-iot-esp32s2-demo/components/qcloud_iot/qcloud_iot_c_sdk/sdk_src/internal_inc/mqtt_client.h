@@ -31,7 +31,11 @@ extern "C" {
 #include "mqtt_client_net.h"
 
 #include "utils_timer.h"
+#include "utils_timer_wheel.h"
 #include "utils_list.h"
+#include "mqtt_client_topic_trie.h"
+#include "mqtt_client_inflight.h"
+#include "utils_ringbuff_mpsc.h"
 
 /* packet id, random from [1 - 65536] */
 #define MAX_PACKET_ID               								(65535)
@@ -39,11 +43,11 @@ extern "C" {
 /* Max size of conn Id  */
 #define MAX_CONN_ID_LEN												(6)
 
-/* Max number of topic subscribed */
+/* Max number of subscribe/unsubscribe requests waiting for ACK */
 #define MAX_MESSAGE_HANDLERS        								(20)
 
-/* Max number in repub list */
-#define MAX_REPUB_NUM                                               (20)
+/* Max number of topics in one SUBSCRIBE packet when resubscribing */
+#define MAX_TOPICS_PER_SUBSCRIBE                                    (32)
 
 /* Minimal wait interval when reconnect */
 #define MIN_RECONNECT_WAIT_INTERVAL 								(1000)
@@ -51,6 +55,10 @@ extern "C" {
 /* Minimal MQTT timeout value */
 #define MIN_COMMAND_TIMEOUT         								(500)
 
+/* Minimal size of MQTT Tx/Rx buffer, a CONNECT of the longest client id and password, or a PUBLISH header of
+ * the longest topic fits in it */
+#define MIN_MQTT_BUF_LEN                                            (512)
+
 /* Maxmal MQTT timeout value  */
 #define MAX_COMMAND_TIMEOUT         								(20000)
 
@@ -155,17 +163,6 @@ typedef struct {
 #define DEFAULT_MQTTCONNECT_PARAMS { NULL, NULL, NULL, {0}, {'M', 'Q', 'T', 'C'}, 0, 4, 240, 1, 1}
 #endif
 
-/**
- * @brief data structure for topic subscription handle
- */
-typedef struct SubTopicHandle {
-    const char              *topic_filter;               // topic name, wildcard filter is supported
-    OnMessageHandler        message_handler;             // callback when msg of this subscription arrives
-    OnSubEventHandler       sub_event_handler;           // callback when event of this subscription happens
-    void                    *handler_user_data;          // user context for callback
-    QoS                     qos;                         // QoS
-} SubTopicHandle;
-
 /**
  * @brief MQTT QCloud IoT Client structure
  */
@@ -182,28 +179,55 @@ typedef struct Client {
 
     size_t                   write_buf_size;                                // size of MQTT write buffer
     size_t                   read_buf_size;                                 // size of MQTT read buffer
-    unsigned char            write_buf[QCLOUD_IOT_MQTT_TX_BUF_LEN];         // MQTT write buffer
-    unsigned char            read_buf[QCLOUD_IOT_MQTT_RX_BUF_LEN];          // MQTT read buffer
+    unsigned char            *write_buf;                                    // MQTT write buffer, allocated by client
+    unsigned char            *read_buf;                                     // MQTT read buffer, allocated by client
+
+    size_t                   recv_stream_pos;                               // read position in recv_stream_buf
+    size_t                   recv_stream_len;                               // valid data length in recv_stream_buf
+    unsigned char            recv_stream_buf[QCLOUD_IOT_MQTT_RX_STREAM_BUF_LEN];   // network input buffer
+    uint32_t                 recv_payload_left;                             // payload of large PUBLISH not read yet
 
     void                     *lock_generic;                                 // mutex/lock for this client struture
     void                     *lock_write_buf;                          		// mutex/lock for write buffer 
 
-    void                     *lock_list_pub;                                // mutex/lock for puback waiting list
+    void                     *lock_list_pub;                                // mutex/lock for puback waiting table
     void                     *lock_list_sub;                                // mutex/lock for suback waiting list
+    void                     *lock_stats;                                   // mutex/lock for statistics, no other lock is taken under it
 
-    List                     *list_pub_wait_ack;                            // puback waiting list
+    PubInflightTable         pub_inflight;                                  // puback waiting table
     List                     *list_sub_wait_ack;                            // suback waiting list
+    TimerWheelList           sub_expired;                                   // suback waiting requests timed out
+
+    TimerWheel               timer_wheel;                                   // deadlines of requests waiting for reply
 
     MQTTEventHandler         event_handle;                                  // callback for MQTT event
 
     MQTTConnectParams        options;                                       // handle to connection parameters
 
     Network                  network_stack;                                 // MQTT network stack
+    uint32_t                 network_epoch;                                 // bumped at each network connect and disconnect, see IOT_MQTT_YieldMulti
 
     Timer                    ping_timer;                                    // MQTT ping timer
     Timer                    reconnect_delay_timer;                         // MQTT reconnect delay timer
 
-    SubTopicHandle           sub_handles[MAX_MESSAGE_HANDLERS];             // subscription handle array
+    TopicTrie                sub_trie;                                      // subscription handles, guarded by lock_generic
+
+    MQTTStats                stats;                                         // statistics, guarded by lock_stats
+    uint32_t                 stats_start_time;                              // time when statistics started, guarded by lock_stats
+    uint32_t                 disconnect_time;                               // time of last disconnection, for reconnect time
+
+    sMpscRing                deferred_pub;                                  // publishes pushed by other tasks without lock, drained by yield
+    Timer                    deferred_timer;                                // deadline of the oldest deferred publish waiting for room
+    uint8_t                  deferred_waiting;                              // deferred_timer is set, owned by yield context
+
+#ifdef MQTT_OFFLINE_QUEUE_ENABLED
+    void                     *offline_queue;                                // QoS1 publishes stored while offline, NULL if storage unavailable
+#endif
+
+#ifdef MULTITHREAD_ENABLED
+    void                     *tx_queue;                                     // packets waiting for writer task, NULL if not in dual-task mode
+    void                     *rx_task;                                      // reader task running yield, NULL if not started
+#endif
 
 } Qcloud_IoT_Client;
 
@@ -220,22 +244,15 @@ typedef enum MQTT_NODE_STATE {
     MQTT_NODE_STATE_INVALID,
 } MQTTNodeState;
 
-/* topic publish info */
-typedef struct REPUBLISH_INFO {
-    Timer                   pub_start_time;     /* timer for puback waiting */
-    MQTTNodeState           node_state;         /* node state in wait list */
-    uint16_t                msg_id;             /* packet id */
-    uint32_t                len;                /* msg length */
-    unsigned char          *buf;                /* msg buffer */
-} QcloudIotPubInfo;
-
 /* topic subscribe/unsubscribe info */
 typedef struct SUBSCRIBE_INFO {
     enum msgTypes           type;           /* type: sub or unsub */
     uint16_t                msg_id;         /* packet id */
-    Timer                   sub_start_time; /* timer for suback waiting */
+    TimerWheelEntry         timer_entry;    /* timer for suback waiting */
+    ListNode               *node;           /* node in wait list */
     MQTTNodeState           node_state;     /* node state in wait list */
-    SubTopicHandle          handler;        /* handle of topic subscribed(unsubcribed) */
+    uint16_t                handler_count;  /* number of topics in the request */
+    SubTopicHandle          *handlers;      /* handles of topics subscribed(unsubcribed), in packet order */
     uint16_t                len;            /* msg length */
     unsigned char          *buf;            /* msg buffer */
 } QcloudIotSubInfo;
@@ -299,6 +316,55 @@ int qcloud_iot_mqtt_disconnect(Qcloud_IoT_Client *pClient);
  */
 int qcloud_iot_mqtt_publish(Qcloud_IoT_Client *pClient, char *topicName, PublishParams *pParams);
 
+/**
+ * @brief Publish MQTT message with completion callback
+ *
+ * @param pClient       handle to MQTT client
+ * @param topicName     MQTT topic name
+ * @param pParams       publish parameters
+ * @param on_complete   callback when PUBACK arrived or timeout, can be NULL
+ * @param user_data     user context for on_complete
+ *
+ * @return packet id (>=0) when success, or err code (<0) for failure
+ */
+int qcloud_iot_mqtt_publish_async(Qcloud_IoT_Client *pClient, char *topicName, PublishParams *pParams,
+                                  OnPublishCompleteHandler on_complete, void *user_data);
+
+/**
+ * @brief Init ring of deferred publishes
+ *
+ * @param pClient       handle to MQTT client
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int qcloud_iot_mqtt_deferred_init(Qcloud_IoT_Client *pClient);
+
+/**
+ * @brief Release ring of deferred publishes, on_complete of those left is called with MQTT_EVENT_CLIENT_DESTROY
+ *
+ * @param pClient       handle to MQTT client
+ */
+void qcloud_iot_mqtt_deferred_deinit(Qcloud_IoT_Client *pClient);
+
+/**
+ * @brief Push a publish into ring without lock, to be published by yield context
+ *
+ * @param pClient       handle to MQTT client
+ * @param topicName     MQTT topic name, kept by reference
+ * @param pParams       publish parameters, payload kept by reference
+ * @param on_complete   callback when publish is completed or failed, can be NULL
+ * @param user_data     user context for on_complete
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int qcloud_iot_mqtt_publish_deferred(Qcloud_IoT_Client *pClient, char *topicName, PublishParams *pParams,
+                                     OnPublishCompleteHandler on_complete, void *user_data);
+
+/**
+ * @brief Publish deferred publishes in order, no more than QCLOUD_IOT_MQTT_DEFERRED_PUB_BATCH each call
+ *
+ * @param pClient       handle to MQTT client
+ */
+void qcloud_iot_mqtt_deferred_drain(Qcloud_IoT_Client *pClient);
+
 /**
  * @brief Subscribe MQTT topic
  *
@@ -339,6 +405,24 @@ int qcloud_iot_mqtt_unsubscribe(Qcloud_IoT_Client *pClient, char *topicFilter);
  */
 int qcloud_iot_mqtt_yield(Qcloud_IoT_Client *pClient, uint32_t timeout_ms);
 
+/**
+ * @brief Handle MQTT packets already arrived, without waiting for network
+ *
+ * @param pClient    handle to MQTT client
+ *
+ * @return QCLOUD_RET_SUCCESS when success, QCLOUD_ERR_MQTT_ATTEMPTING_RECONNECT when try reconnecing, or err code for failure
+ */
+int qcloud_iot_mqtt_process_readable(Qcloud_IoT_Client *pClient);
+
+/**
+ * @brief Handle reconnect, ACK timeout, offline replay and keep alive, without reading network
+ *
+ * @param pClient    handle to MQTT client
+ *
+ * @return QCLOUD_RET_SUCCESS when success, QCLOUD_ERR_MQTT_ATTEMPTING_RECONNECT when try reconnecing, or err code for failure
+ */
+int qcloud_iot_mqtt_process_timers(Qcloud_IoT_Client *pClient);
+
 /**
  * @brief Check if auto reconnect is enabled or not
  *
@@ -399,6 +483,13 @@ void get_next_conn_id(char *conn_id);
  */
 int mqtt_init_packet_header(unsigned char *header, MessageTypes message_type, QoS qos, uint8_t dup, uint8_t retained);
 
+/**
+ * @brief Drop the data left in network input buffer, called when a new connection is setup
+ *
+ * @param pClient
+ */
+void reset_recv_stream(Qcloud_IoT_Client *pClient);
+
 /**
  * @brief Read and handle one MQTT msg/ack from server
  *
@@ -420,6 +511,28 @@ int cycle_for_read(Qcloud_IoT_Client *pClient, Timer *timer, uint8_t *packet_typ
  */
 int send_mqtt_packet(Qcloud_IoT_Client *pClient, size_t length, Timer *timer);
 
+/**
+ * @brief Send a packet made of several segments, without copying them into write buffer
+ *
+ * @param pClient
+ * @param iov           segments of packet
+ * @param iovcnt        number of segments, no more than NET_IOV_MAX
+ * @param timer
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int send_mqtt_packet_vec(Qcloud_IoT_Client *pClient, const NetIoVec *iov, int iovcnt, Timer *timer);
+
+/**
+ * @brief Write a packet made of several segments to network, bypassing the writer task
+ *
+ * @param pClient
+ * @param iov           segments of packet
+ * @param iovcnt        number of segments, no more than NET_IOV_MAX
+ * @param timer
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int write_mqtt_packet_vec(Qcloud_IoT_Client *pClient, const NetIoVec *iov, int iovcnt, Timer *timer);
+
 /**
  * @brief wait for a specific packet with timeout
  *
@@ -465,8 +578,156 @@ int qcloud_iot_mqtt_pub_info_proc(Qcloud_IoT_Client *pClient);
  */
 int qcloud_iot_mqtt_sub_info_proc(Qcloud_IoT_Client *pClient);
 
+/**
+ * @brief Add a PUBACK latency to statistics, called with lock_list_pub
+ *
+ * @param pClient    MQTT client
+ * @param latency_ms time from publish sent to PUBACK arrived
+ */
+void qcloud_iot_mqtt_stats_add_latency(Qcloud_IoT_Client *pClient, uint32_t latency_ms);
+
+#ifdef MQTT_OFFLINE_QUEUE_ENABLED
+/**
+ * @brief Open offline queue in MQTT_OFFLINE_QUEUE_DIR, records left by last run are kept for replay
+ *
+ * @param pClient MQTT client
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int qcloud_iot_mqtt_offline_init(Qcloud_IoT_Client *pClient);
+
+/**
+ * @brief Close offline queue, records not replayed yet are kept in storage
+ *
+ * @param pClient MQTT client
+ */
+void qcloud_iot_mqtt_offline_deinit(Qcloud_IoT_Client *pClient);
+
+/**
+ * @brief Check if there are records in offline queue not replayed yet
+ *
+ * New QoS1 publishes should be appended while it is true, to keep them in order
+ *
+ * @param pClient MQTT client
+ * @return true if records are waiting for replay
+ */
+bool qcloud_iot_mqtt_offline_pending(Qcloud_IoT_Client *pClient);
+
+/**
+ * @brief Append a QoS1 publish to offline queue
+ *
+ * @param pClient   MQTT client
+ * @param topicName MQTT topic name
+ * @param pParams   publish parameters
+ * @return QCLOUD_RET_SUCCESS for success, QCLOUD_ERR_BUF_TOO_SHORT if topic and payload exceed Tx buffer of client,
+ *         or err code for failure
+ */
+int qcloud_iot_mqtt_offline_append(Qcloud_IoT_Client *pClient, char *topicName, PublishParams *pParams);
+
+/**
+ * @brief Replay records of offline queue in order, no more than MQTT_OFFLINE_REPLAY_WINDOW waiting for PUBACK
+ *
+ * A segment is removed only after all of its records are acknowledged, it is replayed again if any of them
+ * timed out, so a record may be delivered more than once.
+ *
+ * @param pClient MQTT client
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int qcloud_iot_mqtt_offline_replay(Qcloud_IoT_Client *pClient);
+
+/**
+ * @brief Publish a record of offline queue, as qcloud_iot_mqtt_publish_async but never stored into the queue again
+ *
+ * @param pClient       handle to MQTT client
+ * @param topicName     MQTT topic name
+ * @param pParams       publish parameters
+ * @param on_complete   callback when PUBACK arrived or timeout
+ * @param user_data     user context for on_complete
+ *
+ * @return packet id (>=0) when success, or err code (<0) for failure
+ */
+int qcloud_iot_mqtt_publish_replay(Qcloud_IoT_Client *pClient, char *topicName, PublishParams *pParams,
+                                   OnPublishCompleteHandler on_complete, void *user_data);
+#endif
+
+#ifdef MULTITHREAD_ENABLED
+/**
+ * @brief Start writer task, packets are queued and written by it from now on
+ *
+ * @param pClient  MQTT client
+ * @param priority priority of writer task
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int qcloud_iot_mqtt_tx_start(Qcloud_IoT_Client *pClient, int priority);
+
+/**
+ * @brief Stop writer task, packets not written yet are written before it returns
+ *
+ * If the task does not return in time, it is left to finish its write and the queue is kept,
+ * packets sent meanwhile are written in place after those queued.
+ *
+ * @param pClient MQTT client
+ * @return QCLOUD_RET_SUCCESS for success, or QCLOUD_ERR_FAILURE if the task did not return in time
+ */
+int qcloud_iot_mqtt_tx_stop(Qcloud_IoT_Client *pClient);
+
+/**
+ * @brief Start reader task, which runs yield for the client from now on
+ *
+ * @param pClient  MQTT client
+ * @param priority priority of reader task
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int qcloud_iot_mqtt_rx_start(Qcloud_IoT_Client *pClient, int priority);
+
+/**
+ * @brief Stop reader task after the yield in progress returns
+ *
+ * If the task does not return in time, it is left running to its end and joined by the next call.
+ *
+ * @param pClient MQTT client
+ * @return QCLOUD_RET_SUCCESS for success, or QCLOUD_ERR_FAILURE if the task did not return in time
+ */
+int qcloud_iot_mqtt_rx_stop(Qcloud_IoT_Client *pClient);
+
+/**
+ * @brief Check if packets are to be queued for writer task
+ *
+ * @param pClient MQTT client
+ * @return true if writer task is started and connected
+ */
+bool qcloud_iot_mqtt_tx_active(Qcloud_IoT_Client *pClient);
+
+/**
+ * @brief Copy a packet into the queue of writer task, called with lock_write_buf
+ *
+ * After a stop which timed out, the packet is written in place once the packets queued are written.
+ *
+ * @param pClient MQTT client
+ * @param iov     segments of packet
+ * @param iovcnt  number of segments
+ * @return QCLOUD_RET_SUCCESS for success, QCLOUD_ERR_MQTT_TX_QUEUE_FULL to retry later, or err code for failure
+ */
+int qcloud_iot_mqtt_tx_enqueue(Qcloud_IoT_Client *pClient, const NetIoVec *iov, int iovcnt);
+
+/**
+ * @brief Check if writer task failed to write, then the connection should be dropped
+ *
+ * @param pClient MQTT client
+ * @return true if write failed
+ */
+bool qcloud_iot_mqtt_tx_failed(Qcloud_IoT_Client *pClient);
+
+/**
+ * @brief Stop writing to current connection before it is closed, state is set to NOTCONNECTED
+ *
+ * @param pClient MQTT client
+ * @param drain   wait (no more than command timeout) for queued packets to be written, e.g. DISCONNECT
+ */
+void qcloud_iot_mqtt_tx_flush(Qcloud_IoT_Client *pClient, bool drain);
+#endif
+
 int push_sub_info_to(Qcloud_IoT_Client *c, int len, unsigned short msgId, MessageTypes type,
-								   SubTopicHandle *handler, ListNode **node);
+								   SubTopicHandle *handlers, uint16_t handler_count, ListNode **node);
 
 int serialize_pub_ack_packet(unsigned char *buf, size_t buf_len, MessageTypes packet_type, uint8_t dup,
 							 uint16_t packet_id,
@@ -0,0 +1,138 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef IOT_MQTT_CLIENT_INFLIGHT_H_
+#define IOT_MQTT_CLIENT_INFLIGHT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "qcloud_iot_export_mqtt.h"
+#include "qcloud_iot_import.h"
+#include "utils_timer.h"
+#include "utils_timer_wheel.h"
+
+/* topic publish info */
+typedef struct REPUBLISH_INFO {
+    TimerWheelEntry         timer_entry;        /* timer for puback waiting */
+    uint16_t                msg_id;             /* packet id */
+    uint16_t                next;               /* next free entry */
+    uint32_t                len;                /* msg length */
+    uint32_t                send_time;          /* time when msg is sent, for PUBACK latency */
+    unsigned char          *buf;                /* msg buffer, allocated from slab of inflight table */
+    OnPublishCompleteHandler on_complete;       /* completion callback of async publish, can be NULL */
+    void                   *user_data;          /* user context for on_complete */
+} QcloudIotPubInfo;
+
+/**
+ * @brief table of QoS1 publishes waiting for PUBACK
+ *
+ * Entries are indexed by packet id in an open addressing hash, so PUBACK is matched in O(1).
+ * Their deadlines are registered in the timer wheel of client, so timeout check only touches expired entries.
+ * Copy of each packet is allocated from a preallocated byte ring (slab) instead of heap.
+ */
+typedef struct {
+    uint16_t                window;             /* max number of entries */
+    uint16_t                count;              /* number of entries in use */
+    uint16_t                index_mask;         /* size of index - 1 */
+    uint16_t                free_head;          /* list of free entries */
+    uint16_t               *index;              /* packet id hash -> entry */
+    QcloudIotPubInfo       *entries;
+
+    TimerWheel             *wheel;              /* timer wheel of client */
+    TimerWheelList          expired;            /* entries waiting for PUBACK timeout */
+
+    unsigned char          *slab;               /* ring of packet copies */
+    size_t                  slab_size;
+    size_t                  slab_head;          /* next allocation position */
+    size_t                  slab_tail;          /* oldest allocation position */
+    size_t                  slab_wrap;          /* end of data before slab_head wrapped to 0 */
+    size_t                  slab_used;
+} PubInflightTable;
+
+/**
+ * @brief init inflight table, all memory is allocated here
+ *
+ * @param table      inflight table
+ * @param window     max number of publishes waiting for PUBACK
+ * @param slab_size  size of buffer for packet copies
+ * @param wheel      timer wheel for PUBACK deadlines
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int pub_inflight_init(PubInflightTable *table, uint16_t window, size_t slab_size, TimerWheel *wheel);
+
+/**
+ * @brief release inflight table
+ *
+ * @param table  inflight table
+ */
+void pub_inflight_deinit(PubInflightTable *table);
+
+/**
+ * @brief add a publish waiting for PUBACK, segments of packet are copied into slab as one buffer
+ *
+ * @param table       inflight table
+ * @param msg_id      packet id
+ * @param iov         segments of serialized packet
+ * @param iovcnt      number of segments
+ * @param timeout_ms  time to wait for PUBACK
+ * @return entry added, or NULL if window or slab is full, or packet id exists
+ */
+QcloudIotPubInfo *pub_inflight_add(PubInflightTable *table, uint16_t msg_id, const NetIoVec *iov, int iovcnt,
+                                   uint32_t timeout_ms);
+
+/**
+ * @brief find the publish entry of packet id
+ *
+ * @param table   inflight table
+ * @param msg_id  packet id
+ * @return entry found, or NULL
+ */
+QcloudIotPubInfo *pub_inflight_find(PubInflightTable *table, uint16_t msg_id);
+
+/**
+ * @brief remove an entry and free its packet copy
+ *
+ * @param table  inflight table
+ * @param info   entry returned by add/find/expired
+ */
+void pub_inflight_remove(PubInflightTable *table, QcloudIotPubInfo *info);
+
+/**
+ * @brief get any entry in use, for draining the table
+ *
+ * @param table  inflight table
+ * @return first entry, or NULL if table is empty
+ */
+QcloudIotPubInfo *pub_inflight_first(PubInflightTable *table);
+
+/**
+ * @brief get an entry whose deadline is passed
+ *
+ * @param table  inflight table
+ * @return expired entry, or NULL
+ */
+QcloudIotPubInfo *pub_inflight_expired(PubInflightTable *table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // IOT_MQTT_CLIENT_INFLIGHT_H_
@@ -0,0 +1,135 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef IOT_MQTT_CLIENT_TOPIC_TRIE_H_
+#define IOT_MQTT_CLIENT_TOPIC_TRIE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "qcloud_iot_export_mqtt.h"
+
+/**
+ * @brief data structure for topic subscription handle
+ */
+typedef struct SubTopicHandle {
+    const char              *topic_filter;               // topic name, wildcard filter is supported
+    OnMessageHandler        message_handler;             // callback when msg of this subscription arrives
+    OnSubEventHandler       sub_event_handler;           // callback when event of this subscription happens
+    void                    *handler_user_data;          // user context for callback
+    OnMessageChunkHandler   message_chunk_handler;       // callback for payload chunks of large msg
+    QoS                     qos;                         // QoS
+} SubTopicHandle;
+
+typedef struct TopicTrieNode TopicTrieNode;
+
+/**
+ * @brief subscription trie, one node per topic level
+ *
+ * Literal levels of a node are kept in a sorted child array and looked up by binary search,
+ * '+' and '#' levels have their own child slots, so dispatch cost depends on topic depth
+ * and not on the number of subscriptions.
+ */
+typedef struct {
+    TopicTrieNode           *root;
+    uint32_t                handle_count;                // number of subscription handles
+    uint32_t                next_seq;                    // subscribe order of handles
+} TopicTrie;
+
+/**
+ * @brief callback for each handle in topic trie
+ *
+ * @return 0 to continue, NOT 0 to stop
+ */
+typedef int (*TopicTrieVisitor)(SubTopicHandle *handle, void *user_data);
+
+/**
+ * @brief init topic trie
+ *
+ * @param trie  topic trie
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int topic_trie_init(TopicTrie *trie);
+
+/**
+ * @brief remove all handles and release topic trie
+ *
+ * topic_filter of each handle is freed after on_remove is called
+ *
+ * @param trie       topic trie
+ * @param on_remove  called for each handle before it is freed, can be NULL
+ * @param user_data  user data for on_remove
+ */
+void topic_trie_deinit(TopicTrie *trie, TopicTrieVisitor on_remove, void *user_data);
+
+/**
+ * @brief add a subscription handle
+ *
+ * topic_filter of handle is owned by trie on success. If an identical handle (same filter
+ * and callbacks) exists, its user data is updated and topic_filter of handle is freed.
+ *
+ * @param trie    topic trie
+ * @param handle  subscription handle
+ * @return QCLOUD_RET_SUCCESS for new handle, 1 for identical handle, or err code for failure
+ */
+int topic_trie_insert(TopicTrie *trie, SubTopicHandle *handle);
+
+/**
+ * @brief remove all handles subscribed with topic filter
+ *
+ * @param trie          topic trie
+ * @param topic_filter  topic filter, compared literally
+ * @param on_remove     called for each handle before it is freed, can be NULL
+ * @param user_data     user data for on_remove
+ * @return number of handles removed
+ */
+int topic_trie_remove(TopicTrie *trie, const char *topic_filter, TopicTrieVisitor on_remove, void *user_data);
+
+/**
+ * @brief find the handle to deliver message of topic
+ *
+ * When several filters match, the earliest subscribed handle with message handler or
+ * message chunk handler wins.
+ *
+ * @param trie       topic trie
+ * @param topic      topic name, NOT NULL terminated
+ * @param topic_len  length of topic name
+ * @param handle     copy of matched handle
+ * @return true if matched
+ */
+bool topic_trie_match(TopicTrie *trie, const char *topic, size_t topic_len, SubTopicHandle *handle);
+
+/**
+ * @brief visit all handles in topic trie
+ *
+ * trie must not be modified by visitor
+ *
+ * @param trie       topic trie
+ * @param visitor    callback for each handle
+ * @param user_data  user data for visitor
+ * @return result of the visitor that stops, or 0
+ */
+int topic_trie_foreach(TopicTrie *trie, TopicTrieVisitor visitor, void *user_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // IOT_MQTT_CLIENT_TOPIC_TRIE_H_
@@ -53,12 +53,24 @@ struct Network {
 
     int (*read)(Network *, unsigned char *, size_t, uint32_t, size_t *);
 
+    // read whatever is available (at least 1 byte) up to the given length, optional
+    int (*read_some)(Network *, unsigned char *, size_t, uint32_t, size_t *);
+
     int (*write)(Network *, unsigned char *, size_t, uint32_t, size_t *);
 
+    // write several segments in order without joining them into one buffer, optional
+    int (*write_vec)(Network *, const NetIoVec *, int, uint32_t, size_t *);
+
     void (*disconnect)(Network *);
 
     int (*is_connected)(Network *);
 
+    // socket descriptor to wait for readable, -1 if not available, optional
+    int (*get_fd)(Network *);
+
+    // data already received and buffered below MQTT, which won't make socket readable, optional
+    int (*has_pending)(Network *);
+
     // connetion handle: 
     // for non-AT: 0 = not connected, non-zero = connected
     // for AT: 0 = valid connection, MAX_UNSINGED_INT = invalid
@@ -94,7 +106,10 @@ int 	network_at_tcp_init(Network *pNetwork);
 
 #else 
 int 	network_tcp_read(Network *pNetwork, unsigned char *data, size_t datalen, uint32_t timeout_ms, size_t *read_len);
+int 	network_tcp_read_some(Network *pNetwork, unsigned char *data, size_t datalen, uint32_t timeout_ms, size_t *read_len);
+int 	network_tcp_get_fd(Network *pNetwork);
 int 	network_tcp_write(Network *pNetwork, unsigned char *data, size_t datalen, uint32_t timeout_ms, size_t *written_len);
+int 	network_tcp_writev(Network *pNetwork, const NetIoVec *iov, int iovcnt, uint32_t timeout_ms, size_t *written_len);
 void 	network_tcp_disconnect(Network *pNetwork);
 int 	network_tcp_connect(Network *pNetwork);
 int 	network_tcp_init(Network *pNetwork);
@@ -102,7 +117,11 @@ int 	network_tcp_init(Network *pNetwork);
 
 #ifndef AUTH_WITH_NOTLS
 int     network_tls_read(Network *pNetwork, unsigned char *data, size_t datalen, uint32_t timeout_ms, size_t *read_len);
+int     network_tls_read_some(Network *pNetwork, unsigned char *data, size_t datalen, uint32_t timeout_ms, size_t *read_len);
+int     network_tls_get_fd(Network *pNetwork);
+int     network_tls_has_pending(Network *pNetwork);
 int     network_tls_write(Network *pNetwork, unsigned char *data, size_t datalen, uint32_t timeout_ms, size_t *written_len);
+int     network_tls_writev(Network *pNetwork, const NetIoVec *iov, int iovcnt, uint32_t timeout_ms, size_t *written_len);
 void    network_tls_disconnect(Network *pNetwork);
 int     network_tls_connect(Network *pNetwork);
 int     network_tls_init(Network *pNetwork);
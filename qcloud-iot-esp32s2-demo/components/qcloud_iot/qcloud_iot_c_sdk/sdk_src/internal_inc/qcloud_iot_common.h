@@ -24,8 +24,15 @@
 /* MQTT server domain */
 #define QCLOUD_IOT_MQTT_DIRECT_DOMAIN           "iotcloud.tencentdevices.com"
 
+/* MQTT server host used instead of {product_id}.QCLOUD_IOT_MQTT_DIRECT_DOMAIN, e.g. a local broker */
+//#define QCLOUD_IOT_MQTT_SERVER_HOST             "127.0.0.1"
+
+#ifndef MQTT_SERVER_PORT_TLS
 #define MQTT_SERVER_PORT_TLS                    8883
+#endif
+#ifndef MQTT_SERVER_PORT_NOTLS
 #define MQTT_SERVER_PORT_NOTLS                  1883
+#endif
 
 /* CoAP server domain */
 #define QCLOUD_IOT_COAP_DEIRECT_DOMAIN          "iotcloud.tencentdevices.com"
@@ -0,0 +1,107 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef QCLOUD_IOT_UTILS_NUMBER_H_
+#define QCLOUD_IOT_UTILS_NUMBER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* buffer size for integer formatted, including '\0' */
+#define UTILS_INT_STR_LEN           (12)
+
+/* buffer size for float or double formatted, including '\0' */
+#define UTILS_DOUBLE_STR_LEN        (32)
+
+/*
+ * Number conversion for JSON, independent of locale and without scanf/printf.
+ *
+ * The parsers take a string of len chars which is not necessarily '\0' terminated, and return the
+ * number of chars consumed, or 0 if there is no number at the beginning or the number is out of range.
+ * Leading spaces and '+' are not accepted, as JSON does not allow them.
+ */
+
+/**
+ * @brief parse decimal integer
+ *
+ * @param str    string
+ * @param len    length of string
+ * @param value  value parsed
+ * @return number of chars consumed, 0 for failure
+ */
+int utils_strn_to_int32(const char *str, size_t len, int32_t *value);
+
+/**
+ * @brief parse decimal unsigned integer
+ *
+ * @param str    string
+ * @param len    length of string
+ * @param value  value parsed
+ * @return number of chars consumed, 0 for failure
+ */
+int utils_strn_to_uint32(const char *str, size_t len, uint32_t *value);
+
+/**
+ * @brief parse JSON number, rounded to the nearest double
+ *
+ * The grammar of RFC 8259 is followed: "-.5" and ".5" are not numbers, "1." and "01"
+ * consume only "1" and "0".
+ *
+ * @param str    string
+ * @param len    length of string
+ * @param value  value parsed
+ * @return number of chars consumed, 0 for failure
+ */
+int utils_strn_to_double(const char *str, size_t len, double *value);
+
+/**
+ * @brief format integer, buf should be at least UTILS_INT_STR_LEN
+ *
+ * @return length of string formatted
+ */
+int utils_int32_to_str(int32_t value, char *buf);
+
+/**
+ * @brief format unsigned integer, buf should be at least UTILS_INT_STR_LEN
+ *
+ * @return length of string formatted
+ */
+int utils_uint32_to_str(uint32_t value, char *buf);
+
+/**
+ * @brief format double with the shortest digits which are parsed back to the same value,
+ * buf should be at least UTILS_DOUBLE_STR_LEN. NaN and infinity are formatted as null.
+ *
+ * @return length of string formatted
+ */
+int utils_double_to_str(double value, char *buf);
+
+/**
+ * @brief format float with the shortest digits which are parsed back to the same float,
+ * buf should be at least UTILS_DOUBLE_STR_LEN. NaN and infinity are formatted as null.
+ *
+ * @return length of string formatted
+ */
+int utils_float_to_str(float value, char *buf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //QCLOUD_IOT_UTILS_NUMBER_H_
@@ -0,0 +1,74 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __UTILS_RINGBUFF_MPSC_H__
+#define __UTILS_RINGBUFF_MPSC_H__
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "utils_ringbuff.h"
+
+/*
+ * Bounded ring of fixed size elements for many producers and one consumer, without lock.
+ * Each slot carries a sequence number telling whether it is free for the producer of a position
+ * or filled for the consumer of it, so producers only contend on one compare-and-swap of head,
+ * and a full ring is reported to producer instead of blocking it.
+ */
+typedef struct {
+    _Atomic uint32_t    head;           /* next position to be claimed by producers */
+    uint32_t            tail;           /* next position to be consumed, owned by consumer */
+    uint32_t            mask;           /* number of slots - 1 */
+    uint32_t            elem_size;
+    _Atomic uint32_t    *seq;           /* sequence number of each slot */
+    unsigned char       *data;          /* elements, elem_size each */
+} sMpscRing;
+
+/**
+ * @brief Init ring
+ *
+ * @param ring      ring to init
+ * @param count     number of slots, must be power of 2
+ * @param elem_size size of element
+ * @return RINGBUFF_OK for success, or RINGBUFF_ERR
+ */
+int mpsc_ring_init(sMpscRing *ring, uint32_t count, uint32_t elem_size);
+
+/**
+ * @brief Release memory of ring, elements left are dropped
+ */
+void mpsc_ring_deinit(sMpscRing *ring);
+
+/**
+ * @brief Copy an element into ring, can be called by any producer at the same time, never blocks
+ *
+ * @return RINGBUFF_OK for success, or RINGBUFF_FULL
+ */
+int mpsc_ring_push(sMpscRing *ring, const void *elem);
+
+/**
+ * @brief Copy the oldest element out without removing it, called by consumer only
+ *
+ * @return RINGBUFF_OK for success, or RINGBUFF_EMPTY
+ */
+int mpsc_ring_peek(sMpscRing *ring, void *elem);
+
+/**
+ * @brief Remove the oldest element got by mpsc_ring_peek, called by consumer only
+ */
+void mpsc_ring_pop(sMpscRing *ring);
+
+#endif // __UTILS_RINGBUFF_MPSC_H__
@@ -0,0 +1,131 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef QCLOUD_IOT_UTILS_TIMER_WHEEL_H_
+#define QCLOUD_IOT_UTILS_TIMER_WHEEL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* resolution of timer wheel, deadlines are rounded up to it */
+#define TIMER_WHEEL_TICK_MS         (10)
+#define TIMER_WHEEL_LEVEL_BITS      (6)
+#define TIMER_WHEEL_LEVEL_SIZE      (1 << TIMER_WHEEL_LEVEL_BITS)
+#define TIMER_WHEEL_LEVELS          (4)
+/* longest timeout in ticks, about 46 hours */
+#define TIMER_WHEEL_MAX_TICKS       ((1UL << (TIMER_WHEEL_LEVEL_BITS * TIMER_WHEEL_LEVELS)) - 1)
+
+/* get the struct containing the timer entry */
+#define TIMER_WHEEL_ENTRY(ptr, type, member)    ((type *)((char *)(ptr) - offsetof(type, member)))
+
+/* circular doubly linked list, used for wheel slots and expired queues */
+typedef struct TimerWheelList {
+    struct TimerWheelList  *next;
+    struct TimerWheelList  *prev;
+} TimerWheelList;
+
+/* timer entry embedded in the struct waiting for a deadline */
+typedef struct {
+    TimerWheelList          link;           /* link in wheel slot or expired queue, next is NULL if not pending */
+    uint32_t                expires;        /* deadline tick */
+    bool                    fired;          /* moved into expired queue */
+    TimerWheelList         *expired_list;   /* expired queue of the owner */
+} TimerWheelEntry;
+
+/**
+ * @brief hierarchical timer wheel
+ *
+ * Each subsystem adds entries with its own expired queue. When the wheel advances, expired entries are
+ * moved into the queues of their owners, and only the slots passed are touched. Owners pop entries from
+ * their queue with their own lock held, so no callback is called from the wheel.
+ *
+ * Lock order is owner lock -> wheel lock, the wheel lock is never held while calling out.
+ * Time is measured by unsigned difference of HAL_GetTimeMs, so 32-bit wraparound is handled.
+ */
+typedef struct {
+    void                   *lock;
+    uint32_t                last_ms;        /* HAL_GetTimeMs of the start of current tick */
+    uint32_t                jiffies;        /* current tick */
+    uint32_t                tick;           /* next tick to be processed */
+    uint32_t                count;          /* number of entries in slots */
+    TimerWheelList          slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_LEVEL_SIZE];
+} TimerWheel;
+
+/**
+ * @brief init timer wheel
+ *
+ * @param wheel  timer wheel
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int timer_wheel_init(TimerWheel *wheel);
+
+/**
+ * @brief release timer wheel, entries still pending are dropped
+ *
+ * @param wheel  timer wheel
+ */
+void timer_wheel_deinit(TimerWheel *wheel);
+
+/**
+ * @brief init expired queue of a subsystem
+ *
+ * @param list  expired queue
+ */
+void timer_wheel_list_init(TimerWheelList *list);
+
+/**
+ * @brief init timer entry as not pending
+ *
+ * @param entry  timer entry
+ */
+void timer_wheel_entry_init(TimerWheelEntry *entry);
+
+/**
+ * @brief add entry to expire after timeout_ms, entry pending already is rescheduled
+ *
+ * @param wheel         timer wheel
+ * @param entry         timer entry
+ * @param timeout_ms    timeout in ms
+ * @param expired_list  queue to put entry in when it expires
+ */
+void timer_wheel_add(TimerWheel *wheel, TimerWheelEntry *entry, uint32_t timeout_ms, TimerWheelList *expired_list);
+
+/**
+ * @brief remove entry from wheel or expired queue, it is safe to remove an entry not pending
+ *
+ * @param wheel  timer wheel
+ * @param entry  timer entry
+ */
+void timer_wheel_del(TimerWheel *wheel, TimerWheelEntry *entry);
+
+/**
+ * @brief advance wheel to now and pop one entry from expired queue
+ *
+ * @param wheel         timer wheel
+ * @param expired_list  expired queue of the caller
+ * @return entry expired and not pending any more, or NULL
+ */
+TimerWheelEntry *timer_wheel_pop_expired(TimerWheel *wheel, TimerWheelList *expired_list);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //QCLOUD_IOT_UTILS_TIMER_WHEEL_H_
@@ -262,3 +262,439 @@ char *json_get_value_by_name(char *p_cJsonStr, int iStrLen, char *p_cName, int *
     return stNV.pV;
 }
 
+
+typedef struct {
+    const char     *js;
+    int             len;
+    int             pos;        /* offset of current char */
+    int             toknext;    /* next token to allocate */
+    int             toksuper;   /* current container or key, -1 for none */
+    bool            expect_key; /* at the start of object or after ',' in object */
+    json_token_t   *tokens;
+    int             num_tokens;
+} json_tokenizer_t;
+
+static bool _is_delimiter(char c)
+{
+    return c == '\0' || c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == ',' || c == ']' || c == '}' ||
+           c == ':';
+}
+
+/* true, false, null are case sensitive or all upper case, others are taken as number */
+static int _primitive_type(const char *p, int len)
+{
+    switch (len) {
+        case 4:
+            if (!strncmp(p, "true", 4) || !strncmp(p, "TRUE", 4)) {
+                return JSBOOLEAN;
+            } else if (!strncmp(p, "null", 4) || !strncmp(p, "NULL", 4)) {
+                return JSNULL;
+            }
+            return JSNUMBER;
+        case 5:
+            return (!strncmp(p, "false", 5) || !strncmp(p, "FALSE", 5)) ? JSBOOLEAN : JSNUMBER;
+        default:
+            return JSNUMBER;
+    }
+}
+
+static int _token_alloc(json_tokenizer_t *parser, int type, int start, int end)
+{
+    json_token_t   *tok;
+    json_token_t   *super;
+
+    if (parser->toknext >= parser->num_tokens) {
+        return JSON_TOKEN_ERR_NOMEM;
+    }
+
+    if (parser->toksuper != -1) {
+        super = &parser->tokens[parser->toksuper];
+        /* value of object must follow a key, and a key has only one value */
+        if ((super->type == JSOBJECT && (type != JSSTRING || !parser->expect_key)) ||
+            (super->type == JSSTRING && super->size > 0)) {
+            return JSON_TOKEN_ERR_INVAL;
+        }
+        super->size++;
+        parser->expect_key = false;
+    } else if (parser->toknext > 0) {
+        /* only one root value */
+        return JSON_TOKEN_ERR_INVAL;
+    }
+
+    tok = &parser->tokens[parser->toknext];
+    tok->type = type;
+    tok->start = start;
+    tok->end = end;
+    tok->size = 0;
+    tok->parent = (parser->toksuper == -1) ? JSON_TOKEN_NONE : parser->toksuper;
+    tok->next = parser->toknext + 1;
+
+    return parser->toknext++;
+}
+
+/* value of key is finished, back to the object */
+static int _token_close_key(json_tokenizer_t *parser)
+{
+    json_token_t *key;
+
+    if (parser->toksuper == -1 || parser->tokens[parser->toksuper].type != JSSTRING) {
+        return JSON_RESULT_OK;
+    }
+
+    key = &parser->tokens[parser->toksuper];
+    if (key->size != 1) {
+        return JSON_TOKEN_ERR_INVAL;
+    }
+    key->next = parser->toknext;
+    parser->toksuper = key->parent;
+
+    return JSON_RESULT_OK;
+}
+
+static int _tokenize_string(json_tokenizer_t *parser)
+{
+    int start = ++parser->pos;
+
+    for (; parser->pos < parser->len && parser->js[parser->pos] != '\0'; parser->pos++) {
+        char c = parser->js[parser->pos];
+
+        if (c == '\"') {
+            return _token_alloc(parser, JSSTRING, start, parser->pos);
+        }
+
+        if (c == '\\') {
+            parser->pos++;
+            if (parser->pos >= parser->len || parser->js[parser->pos] == '\0') {
+                break;
+            }
+        }
+    }
+
+    return JSON_TOKEN_ERR_PART;
+}
+
+static int _tokenize_primitive(json_tokenizer_t *parser)
+{
+    int         start = parser->pos;
+    int         type;
+    const char *p;
+
+    for (; parser->pos < parser->len; parser->pos++) {
+        if (_is_delimiter(parser->js[parser->pos])) {
+            break;
+        }
+    }
+
+    p = parser->js + start;
+    type = _primitive_type(p, parser->pos - start);
+
+    if (type == JSNUMBER) {
+        for (; p < parser->js + parser->pos; p++) {
+            if (!((*p >= '0' && *p <= '9') || *p == '-' || *p == '+' || *p == '.' || *p == 'e' || *p == 'E')) {
+                return JSON_TOKEN_ERR_INVAL;
+            }
+        }
+    }
+
+    /* pos is left at the delimiter */
+    parser->pos--;
+    return _token_alloc(parser, type, start, parser->pos + 1);
+}
+
+int json_tokenize(const char *p_cJsonStr, int iStrLen, json_token_t *pTokens, int iTokenNum)
+{
+    json_tokenizer_t    parser;
+    json_token_t       *tok;
+    int                 rc;
+
+    if (p_cJsonStr == NULL || pTokens == NULL || iStrLen <= 0 || iTokenNum <= 0) {
+        return JSON_TOKEN_ERR_INVAL;
+    }
+
+    if (iStrLen > JSON_TOKEN_MAX_LEN || iTokenNum > JSON_TOKEN_MAX_LEN) {
+        Log_e("json string %d or tokens %d too large", iStrLen, iTokenNum);
+        return JSON_TOKEN_ERR_INVAL;
+    }
+
+    parser.js = p_cJsonStr;
+    parser.len = iStrLen;
+    parser.toknext = 0;
+    parser.toksuper = -1;
+    parser.expect_key = false;
+    parser.tokens = pTokens;
+    parser.num_tokens = iTokenNum;
+
+    for (parser.pos = 0; parser.pos < parser.len && p_cJsonStr[parser.pos] != '\0'; parser.pos++) {
+        char c = p_cJsonStr[parser.pos];
+
+        switch (c) {
+            case '{':
+            case '[':
+                rc = _token_alloc(&parser, (c == '{') ? JSOBJECT : JSARRAY, parser.pos, parser.pos);
+                if (rc < 0) {
+                    return rc;
+                }
+                parser.toksuper = rc;
+                parser.expect_key = (c == '{');
+                break;
+
+            case '}':
+            case ']':
+                /* key without value, or ',' before the end of object */
+                if (parser.toksuper != -1 && pTokens[parser.toksuper].type == JSOBJECT &&
+                    pTokens[parser.toksuper].size > 0) {
+                    return JSON_TOKEN_ERR_INVAL;
+                }
+                rc = _token_close_key(&parser);
+                if (rc < 0) {
+                    return rc;
+                }
+                if (parser.toksuper == -1) {
+                    return JSON_TOKEN_ERR_INVAL;
+                }
+                tok = &pTokens[parser.toksuper];
+                if (tok->type != ((c == '}') ? JSOBJECT : JSARRAY)) {
+                    return JSON_TOKEN_ERR_INVAL;
+                }
+                tok->end = parser.pos + 1;
+                tok->next = parser.toknext;
+                parser.toksuper = (tok->parent == JSON_TOKEN_NONE) ? -1 : tok->parent;
+                break;
+
+            case '\"':
+                rc = _tokenize_string(&parser);
+                if (rc < 0) {
+                    return rc;
+                }
+                break;
+
+            case ':':
+                /* the last token is the key of current object */
+                if (parser.toksuper == -1 || pTokens[parser.toksuper].type != JSOBJECT ||
+                    parser.toknext == 0 || pTokens[parser.toknext - 1].type != JSSTRING ||
+                    pTokens[parser.toknext - 1].parent != parser.toksuper) {
+                    return JSON_TOKEN_ERR_INVAL;
+                }
+                parser.toksuper = parser.toknext - 1;
+                break;
+
+            case ',':
+                if (parser.toksuper == -1 || pTokens[parser.toksuper].type == JSOBJECT) {
+                    return JSON_TOKEN_ERR_INVAL;
+                }
+                rc = _token_close_key(&parser);
+                if (rc < 0) {
+                    return rc;
+                }
+                parser.expect_key = (pTokens[parser.toksuper].type == JSOBJECT);
+                break;
+
+            case ' ':
+            case '\t':
+            case '\r':
+            case '\n':
+                break;
+
+            default:
+                rc = _tokenize_primitive(&parser);
+                if (rc < 0) {
+                    return rc;
+                }
+                break;
+        }
+    }
+
+    if (parser.toksuper != -1 || parser.toknext == 0) {
+        return JSON_TOKEN_ERR_PART;
+    }
+
+    return parser.toknext;
+}
+
+int json_token_lookup(const char *p_cJsonStr, const json_token_t *pTokens, int iParent, const char *p_cPath)
+{
+    const char *seg = p_cPath;
+    const char *delim;
+    int         seg_len;
+    int         i, key, n;
+
+    if (p_cJsonStr == NULL || pTokens == NULL || p_cPath == NULL || iParent < 0) {
+        return -1;
+    }
+
+    for (;;) {
+        if (pTokens[iParent].type != JSOBJECT) {
+            return -1;
+        }
+
+        delim = strchr(seg, '.');
+        seg_len = (int)((delim != NULL) ? (size_t)(delim - seg) : strlen(seg));
+
+        /* keys of object, skip the value of each key with next */
+        key = -1;
+        for (i = iParent + 1, n = 0; n < pTokens[iParent].size; i = pTokens[i].next, n++) {
+            if (pTokens[i].end - pTokens[i].start == seg_len &&
+                !strncmp(p_cJsonStr + pTokens[i].start, seg, seg_len)) {
+                key = i;
+                break;
+            }
+        }
+
+        if (key == -1 || pTokens[key].size == 0) {
+            return -1;
+        }
+
+        if (delim == NULL) {
+            return key + 1;
+        }
+
+        iParent = key + 1;
+        seg = delim + 1;
+    }
+}
+
+static const char *_skip_space(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+        p++;
+    }
+    return p;
+}
+
+/* p is at the opening quote, return the closing quote */
+static const char *_scan_string(const char *p, const char *end)
+{
+    for (p++; p < end && *p != '\0'; p++) {
+        if (*p == '\"') {
+            return p;
+        }
+        if (*p == '\\') {
+            p++;
+            if (p >= end || *p == '\0') {
+                break;
+            }
+        }
+    }
+    return NULL;
+}
+
+/* skip a value, return the char after it */
+static const char *_scan_value(const char *p, const char *end, int *type)
+{
+    const char *start = p;
+    int         depth = 0;
+
+    if (p >= end) {
+        return NULL;
+    }
+
+    if (*p == '\"') {
+        *type = JSSTRING;
+        p = _scan_string(p, end);
+        return (p == NULL) ? NULL : p + 1;
+    }
+
+    if (*p != '{' && *p != '[') {
+        while (p < end && !_is_delimiter(*p)) {
+            p++;
+        }
+        if (p == start) {
+            return NULL;
+        }
+        *type = _primitive_type(start, p - start);
+        return p;
+    }
+
+    *type = (*p == '{') ? JSOBJECT : JSARRAY;
+    for (; p < end && *p != '\0'; p++) {
+        if (*p == '\"') {
+            p = _scan_string(p, end);
+            if (p == NULL) {
+                return NULL;
+            }
+        } else if (*p == '{' || *p == '[') {
+            depth++;
+        } else if (*p == '}' || *p == ']') {
+            if (--depth == 0) {
+                return p + 1;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+int json_value_lookup(const char *p_cJsonStr, int iStrLen, const char *p_cPath, const char **p_cValue,
+                      int *p_iValueLen, int *p_iValueType)
+{
+    const char *end = p_cJsonStr + iStrLen;
+    const char *p, *key, *value, *delim;
+    const char *seg = p_cPath;
+    int         key_len, seg_len, type;
+
+    if (p_cJsonStr == NULL || p_cPath == NULL || iStrLen <= 0) {
+        return JSON_RESULT_ERR;
+    }
+
+    p = _skip_space(p_cJsonStr, end);
+    for (;;) {
+        if (p >= end || *p != '{') {
+            return JSON_RESULT_ERR;
+        }
+        p++;
+
+        delim = strchr(seg, '.');
+        seg_len = (int)((delim != NULL) ? (size_t)(delim - seg) : strlen(seg));
+
+        /* scan the keys of object, values not matched are skipped */
+        for (;;) {
+            p = _skip_space(p, end);
+            if (p >= end || *p != '\"') {
+                return JSON_RESULT_ERR;
+            }
+            key = p + 1;
+            p = _scan_string(p, end);
+            if (p == NULL) {
+                return JSON_RESULT_ERR;
+            }
+            key_len = p - key;
+
+            p = _skip_space(p + 1, end);
+            if (p >= end || *p != ':') {
+                return JSON_RESULT_ERR;
+            }
+            value = p = _skip_space(p + 1, end);
+            p = _scan_value(p, end, &type);
+            if (p == NULL) {
+                return JSON_RESULT_ERR;
+            }
+
+            if (key_len == seg_len && !strncmp(key, seg, seg_len)) {
+                break;
+            }
+
+            p = _skip_space(p, end);
+            if (p >= end || *p != ',') {
+                return JSON_RESULT_ERR;
+            }
+            p++;
+        }
+
+        if (delim == NULL) {
+            if (type == JSSTRING) {
+                *p_cValue = value + 1;
+                *p_iValueLen = p - value - 2;
+            } else {
+                *p_cValue = value;
+                *p_iValueLen = p - value;
+            }
+            if (p_iValueType) {
+                *p_iValueType = type;
+            }
+            return JSON_RESULT_OK;
+        }
+
+        p = value;
+        seg = delim + 1;
+    }
+}
@@ -23,62 +23,49 @@
 
 #include "lite-utils.h"
 #include "qcloud_iot_export_error.h"
-
-#ifndef SCNi8
-#define SCNi8 "hhi"
-#endif
-
-#ifndef SCNu8
-#define SCNu8 "hhu"
-#endif
+#include "utils_number.h"
 
 
 char *LITE_json_value_of(char *key, char *src)
 {
-    char       *value = NULL;
-    int         value_len = -1;
+    json_span_t span;
     char       *ret = NULL;
 
-    char       *delim = NULL;
-    char       *key_iter;
-    char       *key_next;
-    int         key_len;
-    char       *src_iter;
-
-    src_iter = src;
-    key_iter = key;
-
-    do {
-        if ((delim = strchr(key_iter, '.')) != NULL) {
-            key_len = delim - key_iter;
-            key_next = HAL_Malloc(key_len + 1);
-            strncpy(key_next, key_iter, key_len);
-            key_next[key_len] = '\0';
-            value = json_get_value_by_name(src_iter, strlen(src_iter), key_next, &value_len, 0);
-
-            if (value == NULL) {
-                HAL_Free(key_next);
-                return NULL;
-            }
-
-            src_iter = value;
-            key_iter = delim + 1;
-            HAL_Free(key_next);
-        }
-    } while (delim);
-
-    value = json_get_value_by_name(src_iter, strlen(src_iter), key_iter, &value_len, 0);
-    if (NULL == value) {
+    if (LITE_json_span_of(key, src, &span) != QCLOUD_RET_SUCCESS) {
         return NULL;
     }
-    ret = HAL_Malloc((value_len + 1) * sizeof(char));
+
+    ret = HAL_Malloc((span.len + 1) * sizeof(char));
     if (NULL == ret) {
         return NULL;
     }
-    HAL_Snprintf(ret, value_len + 1, "%s", value);
+    memcpy(ret, span.str, span.len);
+    ret[span.len] = '\0';
     return ret;
 }
 
+int LITE_json_span_at(const char *key, const char *src, int src_len, json_span_t *span)
+{
+    if (key == NULL || src == NULL || span == NULL) {
+        return QCLOUD_ERR_INVAL;
+    }
+
+    if (JSON_RESULT_OK != json_value_lookup(src, src_len, key, &span->str, &span->len, &span->type)) {
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+int LITE_json_span_of(const char *key, const char *src, json_span_t *span)
+{
+    if (src == NULL) {
+        return QCLOUD_ERR_INVAL;
+    }
+
+    return LITE_json_span_at(key, src, strlen(src), span);
+}
+
 list_head_t *LITE_json_keys_of(char *src, char *prefix)
 {
     static              LIST_HEAD(keylist);
@@ -166,44 +153,122 @@ char *  LITE_json_string_value_strip_transfer(char *key, char *src)
 
 
 
+/* numbers are parsed in decimal from the beginning of src, chars after the number are ignored */
+static const char *_skip_space(const char *src)
+{
+    while (*src == ' ' || *src == '\t' || *src == '\r' || *src == '\n') {
+        src++;
+    }
+    return src;
+}
+
+static int _get_int32(int32_t *value, int32_t min, int32_t max, const char *src)
+{
+    int32_t v;
+
+    if (src == NULL) {
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    src = _skip_space(src);
+    if (utils_strn_to_int32(src, strlen(src), &v) == 0 || v < min || v > max) {
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    *value = v;
+    return QCLOUD_RET_SUCCESS;
+}
+
+static int _get_uint32(uint32_t *value, uint32_t max, const char *src)
+{
+    uint32_t v;
+
+    if (src == NULL) {
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    src = _skip_space(src);
+    if (utils_strn_to_uint32(src, strlen(src), &v) == 0 || v > max) {
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    *value = v;
+    return QCLOUD_RET_SUCCESS;
+}
+
 int LITE_get_int32(int32_t *value, char *src)
 {
-    return (sscanf(src, "%" SCNi32, value) == 1) ? QCLOUD_RET_SUCCESS : QCLOUD_ERR_FAILURE;
+    return _get_int32(value, INT32_MIN, INT32_MAX, src);
 }
 
 int LITE_get_int16(int16_t *value, char *src)
 {
-    return (sscanf(src, "%" SCNi16, value) == 1) ? QCLOUD_RET_SUCCESS : QCLOUD_ERR_FAILURE;
+    int32_t v;
+    int     rc = _get_int32(&v, INT16_MIN, INT16_MAX, src);
+
+    if (rc == QCLOUD_RET_SUCCESS) {
+        *value = (int16_t)v;
+    }
+    return rc;
 }
 
 int LITE_get_int8(int8_t *value, char *src)
 {
-    return (sscanf(src, "%" SCNi8, value) == 1) ? QCLOUD_RET_SUCCESS : QCLOUD_ERR_FAILURE;
+    int32_t v;
+    int     rc = _get_int32(&v, INT8_MIN, INT8_MAX, src);
+
+    if (rc == QCLOUD_RET_SUCCESS) {
+        *value = (int8_t)v;
+    }
+    return rc;
 }
 
 int LITE_get_uint32(uint32_t *value, char *src)
 {
-    return (sscanf(src, "%" SCNu32, value) == 1) ? QCLOUD_RET_SUCCESS : QCLOUD_ERR_FAILURE;
+    return _get_uint32(value, UINT32_MAX, src);
 }
 
 int LITE_get_uint16(uint16_t *value, char *src)
 {
-    return (sscanf(src, "%" SCNu16, value) == 1) ? QCLOUD_RET_SUCCESS : QCLOUD_ERR_FAILURE;
+    uint32_t v;
+    int      rc = _get_uint32(&v, UINT16_MAX, src);
+
+    if (rc == QCLOUD_RET_SUCCESS) {
+        *value = (uint16_t)v;
+    }
+    return rc;
 }
 
 int LITE_get_uint8(uint8_t *value, char *src)
 {
-    return (sscanf(src, "%" SCNu8, value) == 1) ? QCLOUD_RET_SUCCESS : QCLOUD_ERR_FAILURE;
+    uint32_t v;
+    int      rc = _get_uint32(&v, UINT8_MAX, src);
+
+    if (rc == QCLOUD_RET_SUCCESS) {
+        *value = (uint8_t)v;
+    }
+    return rc;
 }
 
 int LITE_get_float(float *value, char *src)
 {
-    return (sscanf(src, "%f", value) == 1) ? QCLOUD_RET_SUCCESS : QCLOUD_ERR_FAILURE;
+    double v;
+    int    rc = LITE_get_double(&v, src);
+
+    if (rc == QCLOUD_RET_SUCCESS) {
+        *value = (float)v;
+    }
+    return rc;
 }
 
 int LITE_get_double(double *value, char *src)
 {
-    return (sscanf(src, "%lf", value) == 1) ? QCLOUD_RET_SUCCESS : QCLOUD_ERR_FAILURE;
+    if (src == NULL) {
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    src = (char *)_skip_space(src);
+    return (utils_strn_to_double(src, strlen(src), value) > 0) ? QCLOUD_RET_SUCCESS : QCLOUD_ERR_FAILURE;
 }
 
 int LITE_get_boolean(bool *value, char *src)
@@ -232,3 +297,186 @@ int LITE_get_string(int8_t        *value, char *src, uint16_t max_len)
 }
 
 
+
+
+static bool _span_is_number(const json_span_t *span)
+{
+    return (span != NULL && span->str != NULL && span->len > 0 && span->type != JSNULL) ? true : false;
+}
+
+/* integer property may be sent in a float form like 1.0 or 1e2, it is taken if the value is integral */
+static int _span_get_integral(double *value, double min, double max, const json_span_t *span)
+{
+    double v;
+
+    if (utils_strn_to_double(span->str, span->len, &v) != span->len || v < min || v > max) {
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    *value = v;
+    return QCLOUD_RET_SUCCESS;
+}
+
+/* parse integer of the whole span, value of JSON string is accepted as well */
+static int _span_get_int32(int32_t *value, int32_t min, int32_t max, const json_span_t *span)
+{
+    int32_t v;
+    double  d;
+
+    if (!_span_is_number(span)) {
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    if (utils_strn_to_int32(span->str, span->len, &v) != span->len) {
+        if (_span_get_integral(&d, min, max, span) != QCLOUD_RET_SUCCESS || (double)(int32_t)d != d) {
+            return QCLOUD_ERR_FAILURE;
+        }
+        v = (int32_t)d;
+    }
+
+    if (v < min || v > max) {
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    *value = v;
+    return QCLOUD_RET_SUCCESS;
+}
+
+static int _span_get_uint32(uint32_t *value, uint32_t max, const json_span_t *span)
+{
+    uint32_t v;
+    double   d;
+
+    if (!_span_is_number(span)) {
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    if (utils_strn_to_uint32(span->str, span->len, &v) != span->len) {
+        if (_span_get_integral(&d, 0, max, span) != QCLOUD_RET_SUCCESS || (double)(uint32_t)d != d) {
+            return QCLOUD_ERR_FAILURE;
+        }
+        v = (uint32_t)d;
+    }
+
+    if (v > max) {
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    *value = v;
+    return QCLOUD_RET_SUCCESS;
+}
+
+int LITE_span_get_int32(int32_t *value, const json_span_t *span)
+{
+    return _span_get_int32(value, INT32_MIN, INT32_MAX, span);
+}
+
+int LITE_span_get_int16(int16_t *value, const json_span_t *span)
+{
+    int32_t v;
+    int     rc = _span_get_int32(&v, INT16_MIN, INT16_MAX, span);
+
+    if (rc == QCLOUD_RET_SUCCESS) {
+        *value = (int16_t)v;
+    }
+    return rc;
+}
+
+int LITE_span_get_int8(int8_t *value, const json_span_t *span)
+{
+    int32_t v;
+    int     rc = _span_get_int32(&v, INT8_MIN, INT8_MAX, span);
+
+    if (rc == QCLOUD_RET_SUCCESS) {
+        *value = (int8_t)v;
+    }
+    return rc;
+}
+
+int LITE_span_get_uint32(uint32_t *value, const json_span_t *span)
+{
+    return _span_get_uint32(value, UINT32_MAX, span);
+}
+
+int LITE_span_get_uint16(uint16_t *value, const json_span_t *span)
+{
+    uint32_t v;
+    int      rc = _span_get_uint32(&v, UINT16_MAX, span);
+
+    if (rc == QCLOUD_RET_SUCCESS) {
+        *value = (uint16_t)v;
+    }
+    return rc;
+}
+
+int LITE_span_get_uint8(uint8_t *value, const json_span_t *span)
+{
+    uint32_t v;
+    int      rc = _span_get_uint32(&v, UINT8_MAX, span);
+
+    if (rc == QCLOUD_RET_SUCCESS) {
+        *value = (uint8_t)v;
+    }
+    return rc;
+}
+
+int LITE_span_get_double(double *value, const json_span_t *span)
+{
+    if (!_span_is_number(span) || utils_strn_to_double(span->str, span->len, value) != span->len) {
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+int LITE_span_get_float(float *value, const json_span_t *span)
+{
+    double v;
+    int    rc = LITE_span_get_double(&v, span);
+
+    if (rc == QCLOUD_RET_SUCCESS) {
+        *value = (float)v;
+    }
+    return rc;
+}
+
+int LITE_span_get_boolean(bool *value, const json_span_t *span)
+{
+    if (span == NULL || span->str == NULL || span->len <= 0 || span->type == JSNULL) {
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    /* data template takes 0 and 1 for bool */
+    if (LITE_span_equal(span, "false") || LITE_span_equal(span, "FALSE") || LITE_span_equal(span, "0")) {
+        *value = false;
+    } else {
+        *value = true;
+    }
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+int LITE_span_get_string(char *value, size_t size, const json_span_t *span)
+{
+    if (value == NULL || span == NULL || span->str == NULL || span->len < 0 || size == 0) {
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    if ((size_t)span->len >= size) {
+        return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
+    }
+
+    memcpy(value, span->str, span->len);
+    value[span->len] = '\0';
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+bool LITE_span_equal(const json_span_t *span, const char *str)
+{
+    if (span == NULL || span->str == NULL || span->len < 0 || str == NULL) {
+        return false;
+    }
+
+    return (strlen(str) == (size_t)span->len && !strncmp(span->str, str, span->len)) ? true : false;
+}
@@ -0,0 +1,275 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "json_writer.h"
+
+#include "qcloud_iot_export_error.h"
+#include "utils_number.h"
+
+static const char sg_hex_digits[] = "0123456789abcdef";
+
+static void _set_error(json_writer_t *writer, int err)
+{
+    if (writer->err == QCLOUD_RET_SUCCESS) {
+        writer->err = err;
+    }
+}
+
+static void _put_mem(json_writer_t *writer, const char *str, size_t len)
+{
+    if (writer->err != QCLOUD_RET_SUCCESS) {
+        return;
+    }
+
+    if (len >= writer->size - writer->len) {
+        _set_error(writer, QCLOUD_ERR_JSON_BUFFER_TRUNCATED);
+        return;
+    }
+
+    memcpy(writer->buf + writer->len, str, len);
+    writer->len += len;
+    writer->buf[writer->len] = '\0';
+}
+
+static void _put_char(json_writer_t *writer, char c)
+{
+    _put_mem(writer, &c, 1);
+}
+
+static void _put_escaped(json_writer_t *writer, const char *str)
+{
+    const char *run = str;
+    char        esc[6];
+
+    _put_char(writer, '"');
+    for (; *str != '\0'; str++) {
+        unsigned char c   = (unsigned char)*str;
+        size_t        len = 2;
+
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+
+        /* flush the run of chars not escaped */
+        _put_mem(writer, run, str - run);
+        run = str + 1;
+
+        esc[0] = '\\';
+        switch (c) {
+            case '"':
+            case '\\':
+                esc[1] = c;
+                break;
+            case '\b':
+                esc[1] = 'b';
+                break;
+            case '\f':
+                esc[1] = 'f';
+                break;
+            case '\n':
+                esc[1] = 'n';
+                break;
+            case '\r':
+                esc[1] = 'r';
+                break;
+            case '\t':
+                esc[1] = 't';
+                break;
+            default:
+                esc[1] = 'u';
+                esc[2] = '0';
+                esc[3] = '0';
+                esc[4] = sg_hex_digits[c >> 4];
+                esc[5] = sg_hex_digits[c & 0xF];
+                len    = 6;
+                break;
+        }
+        _put_mem(writer, esc, len);
+    }
+    _put_mem(writer, run, str - run);
+    _put_char(writer, '"');
+}
+
+/* comma and key before a member */
+static void _put_key(json_writer_t *writer, const char *key)
+{
+    uint32_t bit;
+
+    if (writer->depth > 0) {
+        bit = 1UL << (writer->depth - 1);
+        if (writer->has_member & bit) {
+            _put_char(writer, ',');
+        }
+        writer->has_member |= bit;
+    }
+
+    if (key != NULL) {
+        _put_escaped(writer, key);
+        _put_char(writer, ':');
+    }
+}
+
+static void _begin(json_writer_t *writer, const char *key, char c)
+{
+    _put_key(writer, key);
+    _put_char(writer, c);
+
+    if (writer->depth >= JSON_WRITER_MAX_DEPTH) {
+        _set_error(writer, QCLOUD_ERR_JSON);
+        return;
+    }
+    writer->depth++;
+    writer->has_member &= ~(1UL << (writer->depth - 1));
+}
+
+static void _end(json_writer_t *writer, char c)
+{
+    if (writer->depth == 0) {
+        _set_error(writer, QCLOUD_ERR_JSON);
+        return;
+    }
+    writer->depth--;
+    _put_char(writer, c);
+}
+
+void json_writer_init(json_writer_t *writer, char *buf, size_t size)
+{
+    writer->buf        = buf;
+    writer->size       = size;
+    writer->len        = 0;
+    writer->depth      = 0;
+    writer->has_member = 0;
+    writer->err        = QCLOUD_RET_SUCCESS;
+
+    if (buf == NULL || size == 0) {
+        writer->size = 0;
+        writer->err  = QCLOUD_ERR_JSON_BUFFER_TRUNCATED;
+        return;
+    }
+    buf[0] = '\0';
+}
+
+void json_writer_object_begin(json_writer_t *writer, const char *key)
+{
+    _begin(writer, key, '{');
+}
+
+void json_writer_object_end(json_writer_t *writer)
+{
+    _end(writer, '}');
+}
+
+void json_writer_array_begin(json_writer_t *writer, const char *key)
+{
+    _begin(writer, key, '[');
+}
+
+void json_writer_array_end(json_writer_t *writer)
+{
+    _end(writer, ']');
+}
+
+void json_writer_string(json_writer_t *writer, const char *key, const char *value)
+{
+    if (value == NULL) {
+        json_writer_null(writer, key);
+        return;
+    }
+
+    _put_key(writer, key);
+    _put_escaped(writer, value);
+}
+
+void json_writer_raw(json_writer_t *writer, const char *key, const char *value)
+{
+    if (value == NULL) {
+        json_writer_null(writer, key);
+        return;
+    }
+
+    _put_key(writer, key);
+    _put_mem(writer, value, strlen(value));
+}
+
+void json_writer_int32(json_writer_t *writer, const char *key, int32_t value)
+{
+    char number[UTILS_INT_STR_LEN];
+    int  len = utils_int32_to_str(value, number);
+
+    _put_key(writer, key);
+    _put_mem(writer, number, len);
+}
+
+void json_writer_uint32(json_writer_t *writer, const char *key, uint32_t value)
+{
+    char number[UTILS_INT_STR_LEN];
+    int  len = utils_uint32_to_str(value, number);
+
+    _put_key(writer, key);
+    _put_mem(writer, number, len);
+}
+
+void json_writer_double(json_writer_t *writer, const char *key, double value)
+{
+    char number[UTILS_DOUBLE_STR_LEN];
+    int  len = utils_double_to_str(value, number);
+
+    _put_key(writer, key);
+    _put_mem(writer, number, len);
+}
+
+void json_writer_float(json_writer_t *writer, const char *key, float value)
+{
+    char number[UTILS_DOUBLE_STR_LEN];
+    int  len = utils_float_to_str(value, number);
+
+    _put_key(writer, key);
+    _put_mem(writer, number, len);
+}
+
+void json_writer_bool(json_writer_t *writer, const char *key, bool value)
+{
+    _put_key(writer, key);
+    if (value) {
+        _put_mem(writer, "true", 4);
+    } else {
+        _put_mem(writer, "false", 5);
+    }
+}
+
+void json_writer_null(json_writer_t *writer, const char *key)
+{
+    _put_key(writer, key);
+    _put_mem(writer, "null", 4);
+}
+
+int json_writer_finish(json_writer_t *writer)
+{
+    if (writer->err == QCLOUD_RET_SUCCESS && writer->depth != 0) {
+        writer->err = QCLOUD_ERR_JSON;
+    }
+
+    return writer->err == QCLOUD_RET_SUCCESS ? (int)writer->len : writer->err;
+}
+
+#ifdef __cplusplus
+}
+#endif
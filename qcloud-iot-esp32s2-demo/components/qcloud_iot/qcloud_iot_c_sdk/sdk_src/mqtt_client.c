@@ -32,6 +32,7 @@ extern "C" {
 #include "qcloud_iot_common.h"
 
 #include "utils_base64.h"
+#include "json_writer.h"
 #include "utils_list.h"
 #include "log_upload.h"
 #include "lite-utils.h"
@@ -145,28 +146,57 @@ void* IOT_MQTT_Construct(MQTTInitParams *pParams)
     return mqtt_client;
 }
 
+static int _notify_client_destroy(SubTopicHandle *handle, void *pClient)
+{
+    if (NULL != handle->sub_event_handler)
+        handle->sub_event_handler(pClient, MQTT_EVENT_CLIENT_DESTROY, handle->handler_user_data);
+
+    return 0;
+}
+
 int IOT_MQTT_Destroy(void **pClient)
 {
     POINTER_SANITY_CHECK(*pClient, QCLOUD_ERR_INVAL);
 
     Qcloud_IoT_Client *mqtt_client = (Qcloud_IoT_Client *)(*pClient);
 
-    int rc = qcloud_iot_mqtt_disconnect(mqtt_client);
+    int rc;
 
-    int i = 0;
-    for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i) {
-        /* notify this event to topic subscriber */
-        if (NULL != mqtt_client->sub_handles[i].sub_event_handler)
-            mqtt_client->sub_handles[i].sub_event_handler(mqtt_client,
-                    MQTT_EVENT_CLIENT_DESTROY, mqtt_client->sub_handles[i].handler_user_data);
+#ifdef MULTITHREAD_ENABLED
+    /* a task still running uses the client, which is kept to be destroyed by another call */
+    rc = qcloud_iot_mqtt_rx_stop(mqtt_client);
+    if (QCLOUD_RET_SUCCESS != rc) {
+        return rc;
+    }
+#endif
 
-        if (NULL != mqtt_client->sub_handles[i].topic_filter) {
-            HAL_Free((void *)mqtt_client->sub_handles[i].topic_filter);
-            mqtt_client->sub_handles[i].topic_filter = NULL;
-        }
+    rc = qcloud_iot_mqtt_disconnect(mqtt_client);
 
+#ifdef MULTITHREAD_ENABLED
+    if (QCLOUD_RET_SUCCESS != qcloud_iot_mqtt_tx_stop(mqtt_client)) {
+        return QCLOUD_ERR_FAILURE;
+    }
+#endif
+
+    /* notify this event to topic subscriber and release the subscriptions */
+    topic_trie_deinit(&mqtt_client->sub_trie, _notify_client_destroy, mqtt_client);
+
+    /* notify async publishers whose PUBACK will never arrive */
+    QcloudIotPubInfo *repubInfo;
+    while (NULL != (repubInfo = pub_inflight_first(&mqtt_client->pub_inflight))) {
+        OnPublishCompleteHandler on_complete = repubInfo->on_complete;
+        void *user_data = repubInfo->user_data;
+        uint16_t msg_id = repubInfo->msg_id;
+
+        pub_inflight_remove(&mqtt_client->pub_inflight, repubInfo);
+        if (NULL != on_complete) {
+            on_complete(mqtt_client, msg_id, MQTT_EVENT_CLIENT_DESTROY, user_data);
+        }
     }
 
+    /* and those whose publishes were never taken out of the ring */
+    qcloud_iot_mqtt_deferred_deinit(mqtt_client);
+
 #ifdef MQTT_RMDUP_MSG_ENABLED
     reset_repeat_packet_id_buffer();
 #endif
@@ -176,9 +206,18 @@ int IOT_MQTT_Destroy(void **pClient)
 
     HAL_MutexDestroy(mqtt_client->lock_list_sub);
     HAL_MutexDestroy(mqtt_client->lock_list_pub);
+    HAL_MutexDestroy(mqtt_client->lock_stats);
+
+#ifdef MQTT_OFFLINE_QUEUE_ENABLED
+    qcloud_iot_mqtt_offline_deinit(mqtt_client);
+#endif
 
-    list_destroy(mqtt_client->list_pub_wait_ack);
+    pub_inflight_deinit(&mqtt_client->pub_inflight);
     list_destroy(mqtt_client->list_sub_wait_ack);
+    timer_wheel_deinit(&mqtt_client->timer_wheel);
+
+    HAL_Free(mqtt_client->write_buf);
+    HAL_Free(mqtt_client->read_buf);
 
     HAL_Free(*pClient);
     *pClient = NULL;
@@ -207,6 +246,237 @@ int IOT_MQTT_Yield(void *pClient, uint32_t timeout_ms)
     return rc;
 }
 
+int IOT_MQTT_GetFd(void *pClient)
+{
+    Qcloud_IoT_Client  *mqtt_client = (Qcloud_IoT_Client *)pClient;
+
+    POINTER_SANITY_CHECK(pClient, -1);
+
+    if (!get_client_conn_state(mqtt_client) || NULL == mqtt_client->network_stack.get_fd) {
+        return -1;
+    }
+
+    return mqtt_client->network_stack.get_fd(&(mqtt_client->network_stack));
+}
+
+int IOT_MQTT_ProcessReadable(void *pClient)
+{
+    Qcloud_IoT_Client  *mqtt_client = (Qcloud_IoT_Client *)pClient;
+
+    return qcloud_iot_mqtt_process_readable(mqtt_client);
+}
+
+int IOT_MQTT_ProcessTimers(void *pClient)
+{
+    Qcloud_IoT_Client  *mqtt_client = (Qcloud_IoT_Client *)pClient;
+    int rc = qcloud_iot_mqtt_process_timers(mqtt_client);
+
+#ifdef LOG_UPLOAD
+    /* do instant log uploading if MQTT communication error */
+    if (rc == QCLOUD_RET_SUCCESS)
+        IOT_Log_Upload(false);
+    else
+        IOT_Log_Upload(true);
+#endif
+
+    return rc;
+}
+
+/* data already received from the socket but not handled yet, which select could not see */
+static bool _mqtt_has_pending(Qcloud_IoT_Client *mqtt_client)
+{
+    if (mqtt_client->recv_stream_pos < mqtt_client->recv_stream_len) {
+        return true;
+    }
+
+    return NULL != mqtt_client->network_stack.has_pending &&
+           mqtt_client->network_stack.has_pending(&(mqtt_client->network_stack));
+}
+
+/* context of IOT_MQTT_YieldMulti, the arrays have max_clients entries */
+typedef struct {
+    void     *wait_set;         // sockets of clients, registered with the HAL between calls
+    int      max_clients;
+    int      count;             // clients in the last call
+    void     **clients;         // client at each index in the last call
+    uint32_t *epochs;           // network_epoch of each client when its fd was read
+    int      *fds;              // socket of each client, read again when the client or its epoch changes
+    uint8_t  *changed;
+    uint8_t  *readable;
+    uint8_t  *pending;
+    uint8_t  *processed;        // processed in the last call, so its socket and buffer are looked at again
+    Timer    timers_timer;      // next pass of IOT_MQTT_ProcessTimers over all clients
+} MQTTYieldMulti;
+
+void *IOT_MQTT_YieldMulti_Construct(int max_clients)
+{
+    MQTTYieldMulti *ctx;
+    size_t          size;
+
+    if (max_clients <= 0) {
+        Log_e("invalid max clients: %d", max_clients);
+        return NULL;
+    }
+
+    size = sizeof(MQTTYieldMulti) +
+           max_clients * (sizeof(void *) + sizeof(uint32_t) + sizeof(int) + 4 * sizeof(uint8_t));
+    ctx = (MQTTYieldMulti *)HAL_Malloc(size);
+    if (NULL == ctx) {
+        Log_e("malloc yield multi context failed");
+        return NULL;
+    }
+    memset(ctx, 0, size);
+
+    ctx->wait_set = HAL_Net_WaitSetCreate(max_clients);
+    if (NULL == ctx->wait_set) {
+        HAL_Free(ctx);
+        return NULL;
+    }
+
+    ctx->max_clients = max_clients;
+    ctx->clients = (void **)(ctx + 1);
+    ctx->epochs = (uint32_t *)(ctx->clients + max_clients);
+    ctx->fds = (int *)(ctx->epochs + max_clients);
+    ctx->changed = (uint8_t *)(ctx->fds + max_clients);
+    ctx->readable = ctx->changed + max_clients;
+    ctx->pending = ctx->readable + max_clients;
+    ctx->processed = ctx->pending + max_clients;
+    InitTimer(&ctx->timers_timer);
+
+    return ctx;
+}
+
+void IOT_MQTT_YieldMulti_Destroy(void *pYield)
+{
+    MQTTYieldMulti *ctx = (MQTTYieldMulti *)pYield;
+
+    if (NULL == ctx) {
+        return;
+    }
+
+    HAL_Net_WaitSetDestroy(ctx->wait_set);
+    HAL_Free(ctx);
+}
+
+int IOT_MQTT_YieldMulti(void *pYield, void *clients[], int count, uint32_t timeout_ms)
+{
+    IOT_FUNC_ENTRY;
+
+    MQTTYieldMulti    *ctx = (MQTTYieldMulti *)pYield;
+    Qcloud_IoT_Client *mqtt_client;
+    bool               any_pending = false;
+    bool               timers_due;
+    int                rc = QCLOUD_RET_SUCCESS;
+    int                ret;
+    int                i;
+
+    POINTER_SANITY_CHECK(pYield, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(clients, QCLOUD_ERR_INVAL);
+    if (count <= 0 || count > ctx->max_clients) {
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_INVAL);
+    }
+
+    /* clients dropped from the end are looked at again if they come back */
+    for (i = count; i < ctx->count; i++) {
+        ctx->clients[i] = NULL;
+    }
+    ctx->count = count;
+
+    /*
+     * only clients processed in the last call are looked at, so a wakeup does not touch every client.
+     * a socket is opened and closed in processing of its client, or by the user between calls and then
+     * seen at the next timers pass. the epoch tells a changed socket, even one which got the old fd back.
+     */
+    for (i = 0; i < count; i++) {
+        POINTER_SANITY_CHECK(clients[i], QCLOUD_ERR_INVAL);
+        ctx->changed[i] = 0;
+        ctx->pending[i] = 0;
+        if (ctx->clients[i] != clients[i] || ctx->processed[i]) {
+            mqtt_client = (Qcloud_IoT_Client *)clients[i];
+            if (ctx->clients[i] != clients[i] || ctx->epochs[i] != mqtt_client->network_epoch) {
+                ctx->changed[i] = 1;
+                ctx->clients[i] = clients[i];
+                ctx->epochs[i] = mqtt_client->network_epoch;
+                ctx->fds[i] = NULL == mqtt_client->network_stack.get_fd ?
+                              -1 : mqtt_client->network_stack.get_fd(&(mqtt_client->network_stack));
+            }
+            ctx->pending[i] = ctx->fds[i] >= 0 && _mqtt_has_pending(mqtt_client);
+            any_pending |= ctx->pending[i];
+        }
+    }
+
+    /* buffered data is ready right now, just poll the sockets; the wait ends when timers are due */
+    if (any_pending || expired(&ctx->timers_timer)) {
+        timeout_ms = 0;
+    } else if ((uint32_t)left_ms(&ctx->timers_timer) < timeout_ms) {
+        timeout_ms = left_ms(&ctx->timers_timer);
+    }
+    ret = HAL_Net_WaitReadable(ctx->wait_set, ctx->fds, ctx->changed, ctx->readable, count, timeout_ms);
+    if (ret < 0) {
+        Log_e("wait for network readable failed: %d", ret);
+        memset(ctx->readable, 0, count);
+    }
+
+    /* with many clients the timers of all of them are handled once per interval, not at each wakeup */
+    timers_due = expired(&ctx->timers_timer);
+    if (timers_due) {
+        countdown_ms(&ctx->timers_timer, MQTT_YIELD_MULTI_TIMERS_INTERVAL_MS);
+    }
+
+    for (i = 0; i < count; i++) {
+        ret = QCLOUD_RET_SUCCESS;
+        ctx->processed[i] = ctx->readable[i] || ctx->pending[i] || timers_due;
+        if (ctx->readable[i] || ctx->pending[i]) {
+            ret = IOT_MQTT_ProcessReadable(clients[i]);
+            if (ret == QCLOUD_RET_SUCCESS) {
+                ret = IOT_MQTT_ProcessTimers(clients[i]);
+            }
+        } else if (timers_due) {
+            ret = IOT_MQTT_ProcessTimers(clients[i]);
+        }
+
+        if (rc == QCLOUD_RET_SUCCESS && ret < 0 && ret != QCLOUD_ERR_MQTT_ATTEMPTING_RECONNECT) {
+            rc = ret;
+        }
+    }
+
+    IOT_FUNC_EXIT_RC(rc);
+}
+
+#ifdef MULTITHREAD_ENABLED
+int IOT_MQTT_StartTxTask(void *pClient, int priority)
+{
+    Qcloud_IoT_Client  *mqtt_client = (Qcloud_IoT_Client *)pClient;
+
+    return qcloud_iot_mqtt_tx_start(mqtt_client, priority);
+}
+
+int IOT_MQTT_StopTxTask(void *pClient)
+{
+    Qcloud_IoT_Client  *mqtt_client = (Qcloud_IoT_Client *)pClient;
+
+    POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
+
+    return qcloud_iot_mqtt_tx_stop(mqtt_client);
+}
+
+int IOT_MQTT_StartRxTask(void *pClient, int priority)
+{
+    Qcloud_IoT_Client  *mqtt_client = (Qcloud_IoT_Client *)pClient;
+
+    return qcloud_iot_mqtt_rx_start(mqtt_client, priority);
+}
+
+int IOT_MQTT_StopRxTask(void *pClient)
+{
+    Qcloud_IoT_Client  *mqtt_client = (Qcloud_IoT_Client *)pClient;
+
+    POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
+
+    return qcloud_iot_mqtt_rx_stop(mqtt_client);
+}
+#endif
+
 int IOT_MQTT_Publish(void *pClient, char *topicName, PublishParams *pParams)
 {
     Qcloud_IoT_Client   *mqtt_client = (Qcloud_IoT_Client *)pClient;
@@ -214,6 +484,22 @@ int IOT_MQTT_Publish(void *pClient, char *topicName, PublishParams *pParams)
     return qcloud_iot_mqtt_publish(mqtt_client, topicName, pParams);
 }
 
+int IOT_MQTT_PublishAsync(void *pClient, char *topicName, PublishParams *pParams,
+                          OnPublishCompleteHandler on_complete, void *user_data)
+{
+    Qcloud_IoT_Client   *mqtt_client = (Qcloud_IoT_Client *)pClient;
+
+    return qcloud_iot_mqtt_publish_async(mqtt_client, topicName, pParams, on_complete, user_data);
+}
+
+int IOT_MQTT_PublishDeferred(void *pClient, char *topicName, PublishParams *pParams,
+                             OnPublishCompleteHandler on_complete, void *user_data)
+{
+    Qcloud_IoT_Client   *mqtt_client = (Qcloud_IoT_Client *)pClient;
+
+    return qcloud_iot_mqtt_publish_deferred(mqtt_client, topicName, pParams, on_complete, user_data);
+}
+
 int IOT_MQTT_Subscribe(void *pClient, char *topicFilter, SubscribeParams *pParams)
 {
 
@@ -230,6 +516,108 @@ int IOT_MQTT_Unsubscribe(void *pClient, char *topicFilter)
     return qcloud_iot_mqtt_unsubscribe(mqtt_client, topicFilter);
 }
 
+/* upper bound of the histogram bucket where the count reaches permille of total */
+static uint32_t _stats_percentile(const MQTTStats *stats, uint32_t permille)
+{
+    uint64_t target = ((uint64_t)stats->puback_count * permille + 999) / 1000;
+    uint64_t sum = 0;
+    int i;
+
+    if (0 == stats->puback_count) {
+        return 0;
+    }
+
+    for (i = 0; i < MQTT_STATS_LATENCY_BUCKETS - 1; i++) {
+        sum += stats->puback_latency_hist[i];
+        if (sum >= target) {
+            return Min((uint32_t)1 << i, stats->puback_latency_max_ms);
+        }
+    }
+
+    return stats->puback_latency_max_ms;
+}
+
+int IOT_MQTT_GetStats(void *pClient, MQTTStats *stats)
+{
+    IOT_FUNC_ENTRY;
+
+    POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(stats, QCLOUD_ERR_INVAL);
+
+    Qcloud_IoT_Client *mqtt_client = (Qcloud_IoT_Client *)pClient;
+
+    HAL_MutexLock(mqtt_client->lock_stats);
+    *stats = mqtt_client->stats;
+    stats->elapsed_ms = HAL_GetTimeMs() - mqtt_client->stats_start_time;
+    HAL_MutexUnlock(mqtt_client->lock_stats);
+
+    stats->puback_latency_p50_ms = _stats_percentile(stats, 500);
+    stats->puback_latency_p99_ms = _stats_percentile(stats, 990);
+
+    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+}
+
+int IOT_MQTT_ResetStats(void *pClient)
+{
+    IOT_FUNC_ENTRY;
+
+    POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
+
+    Qcloud_IoT_Client *mqtt_client = (Qcloud_IoT_Client *)pClient;
+
+    HAL_MutexLock(mqtt_client->lock_stats);
+    memset(&mqtt_client->stats, 0, sizeof(MQTTStats));
+    mqtt_client->stats_start_time = HAL_GetTimeMs();
+    HAL_MutexUnlock(mqtt_client->lock_stats);
+
+    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+}
+
+int IOT_MQTT_StatsToJson(const MQTTStats *stats, char *buf, size_t buf_len)
+{
+    IOT_FUNC_ENTRY;
+
+    POINTER_SANITY_CHECK(stats, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(buf, QCLOUD_ERR_INVAL);
+
+    json_writer_t writer;
+    double seconds = stats->elapsed_ms / 1000.0;
+    int i;
+
+    json_writer_init(&writer, buf, buf_len);
+    json_writer_object_begin(&writer, NULL);
+
+    json_writer_uint32(&writer, "elapsed_ms", stats->elapsed_ms);
+    json_writer_uint32(&writer, "pub_count", stats->pub_count);
+    json_writer_uint32(&writer, "pub_bytes", stats->pub_bytes);
+    json_writer_double(&writer, "pub_msgs_per_sec", seconds > 0 ? stats->pub_count / seconds : 0);
+    json_writer_double(&writer, "pub_bytes_per_msg", stats->pub_count ? (double)stats->pub_bytes / stats->pub_count : 0);
+
+    json_writer_uint32(&writer, "puback_count", stats->puback_count);
+    json_writer_uint32(&writer, "puback_timeout", stats->puback_timeout);
+    json_writer_uint32(&writer, "puback_latency_p50_ms", stats->puback_latency_p50_ms);
+    json_writer_uint32(&writer, "puback_latency_p99_ms", stats->puback_latency_p99_ms);
+    json_writer_uint32(&writer, "puback_latency_max_ms", stats->puback_latency_max_ms);
+    json_writer_array_begin(&writer, "puback_latency_hist");
+    for (i = 0; i < MQTT_STATS_LATENCY_BUCKETS; i++) {
+        json_writer_uint32(&writer, NULL, stats->puback_latency_hist[i]);
+    }
+    json_writer_array_end(&writer);
+
+    json_writer_uint32(&writer, "recv_count", stats->recv_count);
+    json_writer_uint32(&writer, "recv_bytes", stats->recv_bytes);
+    json_writer_double(&writer, "recv_msgs_per_sec", seconds > 0 ? stats->recv_count / seconds : 0);
+    json_writer_uint32(&writer, "dispatch_time_ms", stats->dispatch_time_ms);
+
+    json_writer_uint32(&writer, "reconnect_count", stats->reconnect_count);
+    json_writer_uint32(&writer, "reconnect_last_ms", stats->reconnect_last_ms);
+    json_writer_uint32(&writer, "reconnect_max_ms", stats->reconnect_max_ms);
+
+    json_writer_object_end(&writer);
+
+    IOT_FUNC_EXIT_RC(json_writer_finish(&writer));
+}
+
 bool IOT_MQTT_IsConnected(void *pClient)
 {
     IOT_FUNC_ENTRY;
@@ -248,23 +636,20 @@ int qcloud_iot_mqtt_init(Qcloud_IoT_Client *pClient, MQTTInitParams *pParams)
     POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
     POINTER_SANITY_CHECK(pParams, QCLOUD_ERR_INVAL);
 
+    int rc = QCLOUD_ERR_FAILURE;
+
     memset(pClient, 0x0, sizeof(Qcloud_IoT_Client));
+    pClient->stats_start_time = HAL_GetTimeMs();
 
-    //int size = HAL_Snprintf(s_qcloud_iot_host, HOST_STR_LENGTH, "111.230.160.203");
+#ifdef QCLOUD_IOT_MQTT_SERVER_HOST
+    int size = HAL_Snprintf(s_qcloud_iot_host, HOST_STR_LENGTH, "%s", QCLOUD_IOT_MQTT_SERVER_HOST);
+#else
     int size = HAL_Snprintf(s_qcloud_iot_host, HOST_STR_LENGTH, "%s.%s", pParams->product_id, QCLOUD_IOT_MQTT_DIRECT_DOMAIN);
+#endif
     if (size < 0 || size > HOST_STR_LENGTH - 1) {
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
     }
 
-    int i = 0;
-    for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i) {
-        pClient->sub_handles[i].topic_filter = NULL;
-        pClient->sub_handles[i].message_handler = NULL;
-        pClient->sub_handles[i].sub_event_handler = NULL;
-        pClient->sub_handles[i].qos = QOS0;
-        pClient->sub_handles[i].handler_user_data = NULL;
-    }
-
     if (pParams->command_timeout < MIN_COMMAND_TIMEOUT)
         pParams->command_timeout = MIN_COMMAND_TIMEOUT;
     if (pParams->command_timeout > MAX_COMMAND_TIMEOUT)
@@ -273,8 +658,13 @@ int qcloud_iot_mqtt_init(Qcloud_IoT_Client *pClient, MQTTInitParams *pParams)
 
     // packet id, random from [1 - 65536]
     pClient->next_packet_id = _get_random_start_packet_id();
-    pClient->write_buf_size = QCLOUD_IOT_MQTT_TX_BUF_LEN;
-    pClient->read_buf_size = QCLOUD_IOT_MQTT_RX_BUF_LEN;
+    pClient->write_buf_size = pParams->tx_buf_size ? pParams->tx_buf_size : QCLOUD_IOT_MQTT_TX_BUF_LEN;
+    pClient->read_buf_size = pParams->rx_buf_size ? pParams->rx_buf_size : QCLOUD_IOT_MQTT_RX_BUF_LEN;
+    if (pClient->write_buf_size < MIN_MQTT_BUF_LEN || pClient->read_buf_size < MIN_MQTT_BUF_LEN) {
+        Log_e("tx_buf_size %u or rx_buf_size %u less than %d", (unsigned)pClient->write_buf_size,
+              (unsigned)pClient->read_buf_size, MIN_MQTT_BUF_LEN);
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_INVAL);
+    }
     pClient->is_ping_outstanding = 0;
     pClient->was_manually_disconnected = 0;
     pClient->counter_network_disconnected = 0;
@@ -288,6 +678,13 @@ int qcloud_iot_mqtt_init(Qcloud_IoT_Client *pClient, MQTTInitParams *pParams)
 
     set_client_conn_state(pClient, NOTCONNECTED);
 
+    pClient->write_buf = (unsigned char *)HAL_Malloc(pClient->write_buf_size);
+    pClient->read_buf = (unsigned char *)HAL_Malloc(pClient->read_buf_size);
+    if (NULL == pClient->write_buf || NULL == pClient->read_buf) {
+        Log_e("malloc MQTT buffer failed.");
+        goto error;
+    }
+
     if ((pClient->lock_write_buf = HAL_MutexCreate()) == NULL) {
         Log_e("create write buf lock failed.");
         goto error;
@@ -300,18 +697,47 @@ int qcloud_iot_mqtt_init(Qcloud_IoT_Client *pClient, MQTTInitParams *pParams)
         Log_e("create pub list lock failed.");
         goto error;
     }
+    if ((pClient->lock_stats = HAL_MutexCreate()) == NULL) {
+        Log_e("create stats lock failed.");
+        goto error;
+    }
+
+    if (timer_wheel_init(&pClient->timer_wheel) != QCLOUD_RET_SUCCESS) {
+        Log_e("create timer wheel failed.");
+        goto error;
+    }
 
-    if ((pClient->list_pub_wait_ack = list_new()) == NULL) {
-        Log_e("create pub wait list failed.");
+    /* copies of inflight packets scale with Tx buffer when it is set per client */
+    if (pub_inflight_init(&pClient->pub_inflight, pParams->max_inflight ? pParams->max_inflight : QCLOUD_IOT_MQTT_MAX_INFLIGHT,
+                          pParams->tx_buf_size ? 4 * pClient->write_buf_size : QCLOUD_IOT_MQTT_INFLIGHT_BUF_LEN,
+                          &pClient->timer_wheel) != QCLOUD_RET_SUCCESS) {
+        Log_e("create pub wait table failed.");
         goto error;
     }
-    pClient->list_pub_wait_ack->free = HAL_Free;
 
     if ((pClient->list_sub_wait_ack = list_new()) == NULL) {
         Log_e("create sub wait list failed.");
         goto error;
     }
     pClient->list_sub_wait_ack->free = HAL_Free;
+    timer_wheel_list_init(&pClient->sub_expired);
+
+    if (topic_trie_init(&pClient->sub_trie) != QCLOUD_RET_SUCCESS) {
+        Log_e("create subscription trie failed.");
+        goto error;
+    }
+
+    if (qcloud_iot_mqtt_deferred_init(pClient) != QCLOUD_RET_SUCCESS) {
+        Log_e("create deferred publish ring failed.");
+        goto error;
+    }
+
+#ifdef MQTT_OFFLINE_QUEUE_ENABLED
+    /* publishes are not stored if storage is unavailable, it is not fatal */
+    if (qcloud_iot_mqtt_offline_init(pClient) != QCLOUD_RET_SUCCESS) {
+        Log_w("init offline queue failed, offline publishes are not stored.");
+    }
+#endif
 
 #ifndef AUTH_WITH_NOTLS
     // device param for TLS connection
@@ -319,7 +745,8 @@ int qcloud_iot_mqtt_init(Qcloud_IoT_Client *pClient, MQTTInitParams *pParams)
     bool certEmpty = (pParams->cert_file == NULL || pParams->key_file == NULL);
     if (certEmpty) {
         Log_e("cert file or key file is empty!");
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_INVAL);
+        rc = QCLOUD_ERR_INVAL;
+        goto error;
     }
     Log_d("cert file: %s", pParams->cert_file);
     Log_d("key file: %s", pParams->key_file);
@@ -338,12 +765,14 @@ int qcloud_iot_mqtt_init(Qcloud_IoT_Client *pClient, MQTTInitParams *pParams)
         pClient->network_stack.ssl_connect_params.psk_length = len;
     } else {
         Log_e("psk is empty!");
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_INVAL);
+        rc = QCLOUD_ERR_INVAL;
+        goto error;
     }
     pClient->network_stack.ssl_connect_params.psk_id = iot_device_info_get()->client_id;
     if (iot_device_info_get()->client_id == NULL) {
         Log_e("psk id is empty!");
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_INVAL);
+        rc = QCLOUD_ERR_INVAL;
+        goto error;
     }
     pClient->network_stack.ssl_connect_params.ca_crt = NULL; //iot_ca_get();
     pClient->network_stack.ssl_connect_params.ca_crt_len = 0; //strlen(pClient->network_stack.ssl_connect_params.ca_crt);
@@ -369,10 +798,13 @@ int qcloud_iot_mqtt_init(Qcloud_IoT_Client *pClient, MQTTInitParams *pParams)
     IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
 
 error:
-    if (pClient->list_pub_wait_ack) {
-        pClient->list_pub_wait_ack->free(pClient->list_pub_wait_ack);
-        pClient->list_pub_wait_ack = NULL;
-    }
+#ifdef MQTT_OFFLINE_QUEUE_ENABLED
+    qcloud_iot_mqtt_offline_deinit(pClient);
+#endif
+    qcloud_iot_mqtt_deferred_deinit(pClient);
+    topic_trie_deinit(&pClient->sub_trie, NULL, NULL);
+    pub_inflight_deinit(&pClient->pub_inflight);
+    timer_wheel_deinit(&pClient->timer_wheel);
     if (pClient->list_sub_wait_ack) {
         pClient->list_sub_wait_ack->free(pClient->list_sub_wait_ack);
         pClient->list_sub_wait_ack = NULL;
@@ -389,12 +821,24 @@ error:
         HAL_MutexDestroy(pClient->lock_list_pub);
         pClient->lock_list_pub = NULL;
     }
+    if (pClient->lock_stats) {
+        HAL_MutexDestroy(pClient->lock_stats);
+        pClient->lock_stats = NULL;
+    }
     if (pClient->lock_write_buf) {
         HAL_MutexDestroy(pClient->lock_write_buf);
         pClient->lock_write_buf = NULL;
     }
+    if (pClient->write_buf) {
+        HAL_Free(pClient->write_buf);
+        pClient->write_buf = NULL;
+    }
+    if (pClient->read_buf) {
+        HAL_Free(pClient->read_buf);
+        pClient->read_buf = NULL;
+    }
 
-    IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE)
+    IOT_FUNC_EXIT_RC(rc)
 }
 
 int qcloud_iot_mqtt_deinit(Qcloud_IoT_Client *mqtt_client)
@@ -403,14 +847,31 @@ int qcloud_iot_mqtt_deinit(Qcloud_IoT_Client *mqtt_client)
 
     POINTER_SANITY_CHECK(mqtt_client, QCLOUD_ERR_INVAL);
 
+#ifdef MULTITHREAD_ENABLED
+    qcloud_iot_mqtt_rx_stop(mqtt_client);
+    qcloud_iot_mqtt_tx_stop(mqtt_client);
+#endif
+
     HAL_MutexDestroy(mqtt_client->lock_generic);
     HAL_MutexDestroy(mqtt_client->lock_write_buf);
 
     HAL_MutexDestroy(mqtt_client->lock_list_sub);
     HAL_MutexDestroy(mqtt_client->lock_list_pub);
+    HAL_MutexDestroy(mqtt_client->lock_stats);
 
-    list_destroy(mqtt_client->list_pub_wait_ack);
+    pub_inflight_deinit(&mqtt_client->pub_inflight);
     list_destroy(mqtt_client->list_sub_wait_ack);
+    timer_wheel_deinit(&mqtt_client->timer_wheel);
+
+    HAL_Free(mqtt_client->write_buf);
+    HAL_Free(mqtt_client->read_buf);
+
+    topic_trie_deinit(&mqtt_client->sub_trie, NULL, NULL);
+    qcloud_iot_mqtt_deferred_deinit(mqtt_client);
+
+#ifdef MQTT_OFFLINE_QUEUE_ENABLED
+    qcloud_iot_mqtt_offline_deinit(mqtt_client);
+#endif
 
     Log_i("release mqtt client resources");
 
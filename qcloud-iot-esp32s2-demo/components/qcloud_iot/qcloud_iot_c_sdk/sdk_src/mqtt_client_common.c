@@ -31,34 +31,6 @@ extern "C" {
 
 #define MAX_NO_OF_REMAINING_LENGTH_BYTES 4
 
-/* return: 0, identical; NOT 0, different. */
-static int _check_handle_is_identical(SubTopicHandle *sub_handle1, SubTopicHandle *sub_handle2)
-{
-    if (!sub_handle1 || !sub_handle2) {
-        return 1;
-    }
-
-    int topic_name_Len = strlen(sub_handle1->topic_filter);
-
-    if (topic_name_Len != strlen(sub_handle2->topic_filter)) {
-        return 1;
-    }
-
-    if (0 != strncmp(sub_handle1->topic_filter, sub_handle2->topic_filter, topic_name_Len)) {
-        return 1;
-    }
-
-    if (sub_handle1->message_handler != sub_handle2->message_handler) {
-        return 1;
-    }
-
-    if (sub_handle1->sub_event_handler != sub_handle2->sub_event_handler) {
-        return 1;
-    }
-
-    return 0;
-}
-
 uint16_t get_next_packet_id(Qcloud_IoT_Client *pClient)
 {
     IOT_FUNC_ENTRY;
@@ -452,7 +424,7 @@ int deserialize_suback_packet(uint16_t *packet_id, uint32_t max_count, uint32_t
     // read payload
     *count = 0;
     while (curdata < enddata) {
-        if (*count > max_count) {
+        if (*count >= max_count) {
             IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
         }
         grantedQoSs[(*count)++] = (QoS) mqtt_read_char(&curdata);
@@ -540,8 +512,15 @@ int send_mqtt_packet(Qcloud_IoT_Client *pClient, size_t length, Timer *timer)
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_BUF_TOO_SHORT);
     }
 
+#ifdef MULTITHREAD_ENABLED
+    if (qcloud_iot_mqtt_tx_active(pClient)) {
+        NetIoVec iov = {pClient->write_buf, length};
+        IOT_FUNC_EXIT_RC(qcloud_iot_mqtt_tx_enqueue(pClient, &iov, 1));
+    }
+#endif
+
     while (sent < length && !expired(timer)) {
-        rc = pClient->network_stack.write(&(pClient->network_stack), &pClient->write_buf[sent], length, left_ms(timer), &sentLen);
+        rc = pClient->network_stack.write(&(pClient->network_stack), &pClient->write_buf[sent], length - sent, left_ms(timer), &sentLen);
         if (rc != QCLOUD_RET_SUCCESS) {
             /* there was an error writing the data */
             break;
@@ -558,6 +537,174 @@ int send_mqtt_packet(Qcloud_IoT_Client *pClient, size_t length, Timer *timer)
     IOT_FUNC_EXIT_RC(rc);
 }
 
+/**
+ * @brief get the segments of data from offset on, the first one may be a part of segment
+ *
+ * @return number of segments
+ */
+static int _iov_from_offset(const NetIoVec *iov, int iovcnt, size_t offset, NetIoVec *out)
+{
+    int i, cnt = 0;
+
+    for (i = 0; i < iovcnt; i++) {
+        if (offset >= iov[i].len) {
+            offset -= iov[i].len;
+            continue;
+        }
+        out[cnt].data = iov[i].data + offset;
+        out[cnt].len = iov[i].len - offset;
+        offset = 0;
+        cnt++;
+    }
+
+    return cnt;
+}
+
+int write_mqtt_packet_vec(Qcloud_IoT_Client *pClient, const NetIoVec *iov, int iovcnt, Timer *timer)
+{
+    IOT_FUNC_ENTRY;
+
+    POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(iov, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(timer, QCLOUD_ERR_INVAL);
+
+    int rc = QCLOUD_RET_SUCCESS;
+    int i, cnt;
+    size_t sentLen = 0, sent = 0, length = 0;
+    NetIoVec left[NET_IOV_MAX];
+
+    if (iovcnt <= 0 || iovcnt > NET_IOV_MAX) {
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_INVAL);
+    }
+
+    for (i = 0; i < iovcnt; i++) {
+        length += iov[i].len;
+    }
+
+    while (sent < length && !expired(timer)) {
+        cnt = _iov_from_offset(iov, iovcnt, sent, left);
+        if (NULL != pClient->network_stack.write_vec) {
+            rc = pClient->network_stack.write_vec(&(pClient->network_stack), left, cnt, left_ms(timer), &sentLen);
+        } else {
+            /* no vectored write on this network, send segment by segment */
+            rc = pClient->network_stack.write(&(pClient->network_stack), (unsigned char *)left[0].data, left[0].len,
+                                              left_ms(timer), &sentLen);
+        }
+        if (rc != QCLOUD_RET_SUCCESS) {
+            /* there was an error writing the data */
+            break;
+        }
+        sent = sent + sentLen;
+    }
+
+    if (sent == length) {
+        IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+    }
+
+    IOT_FUNC_EXIT_RC(rc);
+}
+
+int send_mqtt_packet_vec(Qcloud_IoT_Client *pClient, const NetIoVec *iov, int iovcnt, Timer *timer)
+{
+#ifdef MULTITHREAD_ENABLED
+    /* payload is copied, as user buffer may be reused once publish returns */
+    if (NULL != pClient && NULL != iov && qcloud_iot_mqtt_tx_active(pClient)) {
+        if (iovcnt <= 0 || iovcnt > NET_IOV_MAX) {
+            return QCLOUD_ERR_INVAL;
+        }
+        return qcloud_iot_mqtt_tx_enqueue(pClient, iov, iovcnt);
+    }
+#endif
+
+    return write_mqtt_packet_vec(pClient, iov, iovcnt, timer);
+}
+
+
+void reset_recv_stream(Qcloud_IoT_Client *pClient)
+{
+    pClient->recv_stream_pos = 0;
+    pClient->recv_stream_len = 0;
+    pClient->recv_payload_left = 0;
+}
+
+/**
+ * @brief Read data through the network input buffer
+ *
+ * Data already buffered is consumed first. A short read refills the buffer with
+ * whatever the network has in one call, so the header, remaining length and small
+ * packets following each other are deframed from memory. A read larger than the
+ * buffer goes to network directly.
+ *
+ * @param pClient        MQTT Client
+ * @param data           destination buffer
+ * @param len            length of data to read
+ * @param timeout_ms     timeout value (unit: ms)
+ * @return QCLOUD_RET_SUCCESS when len bytes are read, or err code for failure
+ */
+static int _read_from_stream(Qcloud_IoT_Client *pClient, unsigned char *data, size_t len, uint32_t timeout_ms)
+{
+    int rc = QCLOUD_RET_SUCCESS;
+    size_t copied = 0, read_len = 0, buffered;
+    int left;
+    Timer timer;
+
+    InitTimer(&timer);
+    countdown_ms(&timer, timeout_ms);
+
+    while (copied < len) {
+        buffered = pClient->recv_stream_len - pClient->recv_stream_pos;
+        if (buffered > 0) {
+            buffered = Min(buffered, len - copied);
+            memcpy(data + copied, pClient->recv_stream_buf + pClient->recv_stream_pos, buffered);
+            pClient->recv_stream_pos += buffered;
+            copied += buffered;
+            continue;
+        }
+
+        if (copied > 0 && expired(&timer)) {
+            rc = QCLOUD_ERR_MQTT_NOTHING_TO_READ;
+            break;
+        }
+
+        left = left_ms(&timer);
+        if (left <= 0) {
+            left = 1;
+        }
+
+        read_len = 0;
+        if (NULL == pClient->network_stack.read_some || (len - copied) >= sizeof(pClient->recv_stream_buf)) {
+            rc = pClient->network_stack.read(&(pClient->network_stack), data + copied, len - copied, left, &read_len);
+            copied += read_len;
+        } else {
+            /* payload of a chunked PUBLISH may be in the middle of reading, recv_payload_left is kept */
+            pClient->recv_stream_pos = 0;
+            pClient->recv_stream_len = 0;
+            rc = pClient->network_stack.read_some(&(pClient->network_stack), pClient->recv_stream_buf,
+                                                  sizeof(pClient->recv_stream_buf), left, &read_len);
+            pClient->recv_stream_len = read_len;
+        }
+
+        if (rc != QCLOUD_RET_SUCCESS) {
+            break;
+        }
+    }
+
+    if (copied == len) {
+        return QCLOUD_RET_SUCCESS;
+    }
+
+    if (copied > 0) {
+        /* partial data read, the stream is broken */
+        if (rc == QCLOUD_ERR_SSL_NOTHING_TO_READ || rc == QCLOUD_ERR_SSL_READ_TIMEOUT) {
+            rc = QCLOUD_ERR_SSL_READ_TIMEOUT;
+        } else if (rc == QCLOUD_ERR_TCP_NOTHING_TO_READ || rc == QCLOUD_ERR_TCP_READ_TIMEOUT ||
+                   rc == QCLOUD_ERR_MQTT_NOTHING_TO_READ) {
+            rc = QCLOUD_ERR_TCP_READ_TIMEOUT;
+        }
+    }
+
+    return rc;
+}
 
 static int _decode_packet_rem_len_with_net_read(Qcloud_IoT_Client *pClient, uint32_t *value, uint32_t timeout)
 {
@@ -569,7 +716,6 @@ static int _decode_packet_rem_len_with_net_read(Qcloud_IoT_Client *pClient, uint
     unsigned char i;
     uint32_t multiplier = 1;
     uint32_t len = 0;
-    size_t read_len = 0;
 
     *value = 0;
 
@@ -579,8 +725,7 @@ static int _decode_packet_rem_len_with_net_read(Qcloud_IoT_Client *pClient, uint
             IOT_FUNC_EXIT_RC(QCLOUD_ERR_MQTT_PACKET_READ)
         }
 
-        if ((pClient->network_stack.read(&(pClient->network_stack), &i, 1, timeout, &read_len)) !=
-            QCLOUD_RET_SUCCESS) {
+        if (_read_from_stream(pClient, &i, 1, timeout) != QCLOUD_RET_SUCCESS) {
             /* The value argument is the important value. len is just used temporarily
              * and never used by the calling function for anything else */
             IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
@@ -595,6 +740,57 @@ static int _decode_packet_rem_len_with_net_read(Qcloud_IoT_Client *pClient, uint
     IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
 }
 
+/**
+ * @brief read the variable header of a PUBLISH packet which is too large for read_buf,
+ * and leave its payload in network to be delivered chunk by chunk
+ *
+ * @param pClient
+ * @param len           length of fixed header in read_buf
+ * @param rem_len       remaining length of packet
+ * @param timeout_ms
+ * @param read_len      length of packet read from network after fixed header
+ * @return QCLOUD_RET_SUCCESS, QCLOUD_ERR_BUF_TOO_SHORT if variable header is too large, or err code
+ */
+static int _read_publish_header(Qcloud_IoT_Client *pClient, uint32_t len, uint32_t rem_len, uint32_t timeout_ms,
+                                uint32_t *read_len)
+{
+    uint8_t qos = (pClient->read_buf[0] & MQTT_HEADER_QOS_MASK) >> MQTT_HEADER_QOS_SHIFT;
+    uint32_t header_len;
+    unsigned char *ptr;
+    int rc;
+
+    *read_len = 0;
+    if (rem_len < 2) {
+        return QCLOUD_ERR_BUF_TOO_SHORT;
+    }
+
+    // topic length
+    rc = _read_from_stream(pClient, pClient->read_buf + len, 2, timeout_ms);
+    if (QCLOUD_RET_SUCCESS != rc) {
+        return rc;
+    }
+    *read_len = 2;
+
+    ptr = pClient->read_buf + len;
+    header_len = 2 + mqtt_read_uint16_t(&ptr) + (qos > 0 ? 2 : 0);
+
+    // keep at least one byte for payload chunk besides the spare byte
+    if (header_len > rem_len || (len + header_len + 1) >= pClient->read_buf_size) {
+        return QCLOUD_ERR_BUF_TOO_SHORT;
+    }
+
+    // topic name and packet id
+    rc = _read_from_stream(pClient, pClient->read_buf + len + 2, header_len - 2, timeout_ms);
+    if (QCLOUD_RET_SUCCESS != rc) {
+        return rc;
+    }
+    *read_len = header_len;
+
+    pClient->recv_payload_left = rem_len - header_len;
+
+    return QCLOUD_RET_SUCCESS;
+}
+
 /**
  * @brief Read MQTT packet from network stack
  *
@@ -616,7 +812,6 @@ static int _read_mqtt_packet(Qcloud_IoT_Client *pClient, Timer *timer, uint8_t *
 
     uint32_t len = 0;
     uint32_t rem_len = 0;
-    size_t read_len = 0;
     int rc;
     int timer_left_ms = left_ms(timer);
 
@@ -625,7 +820,7 @@ static int _read_mqtt_packet(Qcloud_IoT_Client *pClient, Timer *timer, uint8_t *
     }
 
     // 1. read 1st byte in fixed header and check if valid
-    rc = pClient->network_stack.read(&(pClient->network_stack), pClient->read_buf, 1, timer_left_ms, &read_len);
+    rc = _read_from_stream(pClient, pClient->read_buf, 1, timer_left_ms);
     if (rc == QCLOUD_ERR_SSL_NOTHING_TO_READ || rc == QCLOUD_ERR_TCP_NOTHING_TO_READ) {
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_MQTT_NOTHING_TO_READ);
     } else if (rc != QCLOUD_RET_SUCCESS) {
@@ -646,11 +841,13 @@ static int _read_mqtt_packet(Qcloud_IoT_Client *pClient, Timer *timer, uint8_t *
         IOT_FUNC_EXIT_RC(rc);
     }
 
-    // if read buffer is not enough to read the remaining length, discard the packet
-    if (rem_len >= pClient->read_buf_size) {
-        size_t total_bytes_read = 0;
+    len += mqtt_write_packet_rem_len(pClient->read_buf + 1, rem_len);
+
+    // if read buffer is not enough to read the remaining length, discard the packet except PUBLISH
+    // one byte is reserved to terminate the payload of PUBLISH in place
+    if ((len + rem_len) >= pClient->read_buf_size) {
+        uint32_t total_bytes_read = 0;
         size_t bytes_to_be_read;
-        int32_t ret_val = 0;
 
         timer_left_ms = left_ms(timer);
         if (timer_left_ms <= 0) {
@@ -658,49 +855,40 @@ static int _read_mqtt_packet(Qcloud_IoT_Client *pClient, Timer *timer, uint8_t *
         }
         timer_left_ms += QCLOUD_IOT_MQTT_MAX_REMAIN_WAIT_MS;
 
-        bytes_to_be_read = pClient->read_buf_size;
-        do {
-            ret_val = pClient->network_stack.read(&(pClient->network_stack), pClient->read_buf, bytes_to_be_read, timer_left_ms,
-                                                  &read_len);
-            if (ret_val == QCLOUD_RET_SUCCESS) {
-                total_bytes_read += read_len;
-                if ((rem_len - total_bytes_read) >= pClient->read_buf_size) {
-                    bytes_to_be_read = pClient->read_buf_size;
-                } else {
-                    bytes_to_be_read = rem_len - total_bytes_read;
-                }
+        // PUBLISH payload is left in network and delivered chunk by chunk in _handle_publish_packet
+        if (PUBLISH == (pClient->read_buf[0] & MQTT_HEADER_TYPE_MASK) >> MQTT_HEADER_TYPE_SHIFT) {
+            rc = _read_publish_header(pClient, len, rem_len, timer_left_ms, &total_bytes_read);
+            if (QCLOUD_RET_SUCCESS == rc) {
+                *packet_type = PUBLISH;
+                IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+            } else if (QCLOUD_ERR_BUF_TOO_SHORT != rc) {
+                IOT_FUNC_EXIT_RC(rc);
             }
-        } while (total_bytes_read < rem_len && ret_val == QCLOUD_RET_SUCCESS);
+            rc = QCLOUD_RET_SUCCESS;
+        }
 
-        Log_e("MQTT Recv buffer not enough: %d < %d", pClient->read_buf_size, rem_len);
+        while (total_bytes_read < rem_len && rc == QCLOUD_RET_SUCCESS) {
+            bytes_to_be_read = Min(rem_len - total_bytes_read, pClient->read_buf_size);
+            rc = _read_from_stream(pClient, pClient->read_buf, bytes_to_be_read, timer_left_ms);
+            if (rc == QCLOUD_RET_SUCCESS) {
+                total_bytes_read += bytes_to_be_read;
+            }
+        }
+
+        Log_e("MQTT Recv buffer not enough: %d < %d", pClient->read_buf_size, len + rem_len);
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_BUF_TOO_SHORT);
     }
 
-    len += mqtt_write_packet_rem_len(pClient->read_buf + 1, rem_len);
-
     // 3. read payload according to remaining length
-    if (rem_len > 0 && ((len + rem_len) > pClient->read_buf_size)) {
-
+    if (rem_len > 0) {
         timer_left_ms = left_ms(timer);
         if (timer_left_ms <= 0) {
             timer_left_ms = 1;
         }
         timer_left_ms += QCLOUD_IOT_MQTT_MAX_REMAIN_WAIT_MS;
-
-        pClient->network_stack.read(&(pClient->network_stack), pClient->read_buf, rem_len, timer_left_ms, &read_len);
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_BUF_TOO_SHORT);
-    } else {
-        if (rem_len > 0) {
-
-            timer_left_ms = left_ms(timer);
-            if (timer_left_ms <= 0) {
-                timer_left_ms = 1;
-            }
-            timer_left_ms += QCLOUD_IOT_MQTT_MAX_REMAIN_WAIT_MS;
-            rc = pClient->network_stack.read(&(pClient->network_stack), pClient->read_buf + len, rem_len, timer_left_ms, &read_len);
-            if (rc != QCLOUD_RET_SUCCESS) {
-                IOT_FUNC_EXIT_RC(rc);
-            }
+        rc = _read_from_stream(pClient, pClient->read_buf + len, rem_len, timer_left_ms);
+        if (rc != QCLOUD_RET_SUCCESS) {
+            IOT_FUNC_EXIT_RC(rc);
         }
     }
 
@@ -710,136 +898,163 @@ static int _read_mqtt_packet(Qcloud_IoT_Client *pClient, Timer *timer, uint8_t *
 }
 
 /**
- * @brief Check if two topic equals
- *
- * @param topic_filter
- * @param topicName
- * @return
- */
-static uint8_t _is_topic_equals(char *topic_filter, char *topicName)
-{
-    return (uint8_t) (strlen(topic_filter) == strlen(topicName) && !strcmp(topic_filter, topicName));
-}
-
-/**
- * @brief Check if topic match
+ * @brief deliver the message to user callback
  *
- * assume topic filter and name is in correct format
- * # can only be at end
- * + and # can only be next to separator
+ * topic name and payload point into read_buf of client, no copy is made
  *
- * @param topic_filter  topic name filter, wildcard is supported
- * @param topicName     topic name, no wildcard
+ * @param pClient
+ * @param topicName     topic name, NOT NULL terminated
  * @param topicNameLen  length of topic name
+ * @param message
+ * @param handler_ms    time spent in handler is added to it
  * @return
  */
-static uint8_t _is_topic_matched(char *topic_filter, char *topicName, uint16_t topicNameLen)
+static int _deliver_message(Qcloud_IoT_Client *pClient, const char *topicName, uint16_t topicNameLen, MQTTMessage *message,
+                            uint32_t *handler_ms)
 {
-    char *curf;
-    char *curn;
-    char *curn_end;
-
-    curf = topic_filter;
-    curn = topicName;
-    curn_end = curn + topicNameLen;
+    IOT_FUNC_ENTRY;
 
-    while (*curf && (curn < curn_end)) {
+    POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(topicName, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(message, QCLOUD_ERR_INVAL);
 
-        if (*curf == '+' && *curn == '/') {
-            curf++;
-            continue;
-        }
+    message->ptopic = topicName;
+    message->topic_len = (size_t)topicNameLen;
 
-        if (*curn == '/' && *curf != '/') {
-            break;
-        }
+    SubTopicHandle sub_handle;
+    bool flag_matched;
+    uint32_t start;
 
-        if (*curf != '+' && *curf != '#' && *curf != *curn) {
-            break;
-        }
+    HAL_MutexLock(pClient->lock_generic);
+    flag_matched = topic_trie_match(&pClient->sub_trie, topicName, topicNameLen, &sub_handle);
+    HAL_MutexUnlock(pClient->lock_generic);
 
-        if (*curf == '+') {
-            /* skip until we meet the next separator, or end of string */
-            char *nextpos = curn + 1;
-            while (nextpos < curn_end && *nextpos != '/')
-                nextpos = ++curn + 1;
-        } else if (*curf == '#') {
-            /* skip until end of string */
-            curn = curn_end - 1;
+    start = HAL_GetTimeMs();
+    if (flag_matched) {
+        if (NULL != sub_handle.message_handler) {
+            sub_handle.message_handler(pClient, message, sub_handle.handler_user_data);
+        } else {
+            /* whole payload as the only chunk */
+            sub_handle.message_chunk_handler(pClient, message, 0, message->payload_len, sub_handle.handler_user_data);
         }
+        *handler_ms += HAL_GetTimeMs() - start;
+        IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+    }
 
-        curf++;
-        curn++;
-    };
+    /* Message handler not found for topic */
+    /* May be we do not care  change FAILURE  use SUCCESS*/
+    Log_d("no matching any topic, call default handle function");
 
-    if (*curf == '\0') {
-        return (uint8_t) (curn == curn_end);
-    } else {
-        return (uint8_t) ((*curf == '#') || *(curf + 1) == '#' || (*curf == '+' && *(curn - 1) == '/'));
+    if (NULL != pClient->event_handle.h_fp) {
+        MQTTEventMsg msg;
+        msg.event_type = MQTT_EVENT_PUBLISH_RECVEIVED;
+        msg.msg = message;
+        pClient->event_handle.h_fp(pClient, pClient->event_handle.context, &msg);
+        *handler_ms += HAL_GetTimeMs() - start;
     }
+
+    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
 }
 
 /**
- * @brief deliver the message to user callback
+ * @brief read payload of a large PUBLISH left in network, and deliver it to message chunk handler chunk by chunk
+ *
+ * Chunks are read into read_buf after the packet headers, so topic name stays valid. The payload is
+ * dropped if it is not to be delivered or no message chunk handler is subscribed for the topic.
  *
  * @param pClient
- * @param topicName
- * @param message
+ * @param topicName     topic name, NOT NULL terminated
+ * @param topicNameLen  length of topic name
+ * @param message       payload points to the first byte after packet headers
+ * @param deliver       false to drop the payload
+ * @param timer
+ * @param handler_ms    time spent in handler is added to it, reading chunks is not counted
  * @return
  */
-static int _deliver_message(Qcloud_IoT_Client *pClient, char *topicName, uint16_t topicNameLen, MQTTMessage *message)
+static int _deliver_message_chunks(Qcloud_IoT_Client *pClient, const char *topicName, uint16_t topicNameLen,
+                                   MQTTMessage *message, bool deliver, Timer *timer, uint32_t *handler_ms)
 {
     IOT_FUNC_ENTRY;
 
-    POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
-    POINTER_SANITY_CHECK(topicName, QCLOUD_ERR_INVAL);
-    POINTER_SANITY_CHECK(message, QCLOUD_ERR_INVAL);
+    unsigned char *chunk = (unsigned char *)message->payload;
+    size_t chunk_size = (size_t)(pClient->read_buf + pClient->read_buf_size - 1 - chunk);
+    size_t total_len = pClient->recv_payload_left;
+    size_t offset = 0, chunk_len;
+    SubTopicHandle sub_handle;
+    bool flag_matched = false;
+    int timer_left_ms;
+    uint32_t start;
+    int rc = QCLOUD_RET_SUCCESS;
 
     message->ptopic = topicName;
     message->topic_len = (size_t)topicNameLen;
 
-    uint32_t i;
-    int flag_matched = 0;
+    if (deliver) {
+        HAL_MutexLock(pClient->lock_generic);
+        flag_matched = topic_trie_match(&pClient->sub_trie, topicName, topicNameLen, &sub_handle);
+        HAL_MutexUnlock(pClient->lock_generic);
 
-    HAL_MutexLock(pClient->lock_generic);
-    for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i) {
-        if ((pClient->sub_handles[i].topic_filter != NULL)
-            && (_is_topic_equals(topicName, (char *) pClient->sub_handles[i].topic_filter) ||
-                _is_topic_matched((char *) pClient->sub_handles[i].topic_filter, topicName, topicNameLen))) {
-            HAL_MutexUnlock(pClient->lock_generic);
-            if (pClient->sub_handles[i].message_handler != NULL) {
-                pClient->sub_handles[i].message_handler(pClient, message, pClient->sub_handles[i].handler_user_data);
-                flag_matched = 1;
-                IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
-            }
-            HAL_MutexLock(pClient->lock_generic);
+        if (flag_matched && NULL == sub_handle.message_chunk_handler) {
+            flag_matched = false;
+        }
+        if (!flag_matched) {
+            Log_e("MQTT Recv buffer not enough and no chunk handler, drop %u bytes of topic %.*s",
+                  (unsigned)total_len, topicNameLen, topicName);
         }
     }
 
-    /* Message handler not found for topic */
-    /* May be we do not care  change FAILURE  use SUCCESS*/
-    HAL_MutexUnlock(pClient->lock_generic);
+    while (offset < total_len) {
+        chunk_len = Min(total_len - offset, chunk_size);
 
-    if (0 == flag_matched) {
-        Log_d("no matching any topic, call default handle function");
+        timer_left_ms = left_ms(timer);
+        if (timer_left_ms <= 0) {
+            timer_left_ms = 1;
+        }
+        timer_left_ms += QCLOUD_IOT_MQTT_MAX_REMAIN_WAIT_MS;
 
-        if (NULL != pClient->event_handle.h_fp) {
-            MQTTEventMsg msg;
-            msg.event_type = MQTT_EVENT_PUBLISH_RECVEIVED;
-            msg.msg = message;
-            pClient->event_handle.h_fp(pClient, pClient->event_handle.context, &msg);
+        rc = _read_from_stream(pClient, chunk, chunk_len, timer_left_ms);
+        if (QCLOUD_RET_SUCCESS != rc) {
+            break;
+        }
+        pClient->recv_payload_left -= chunk_len;
+
+        if (flag_matched) {
+            chunk[chunk_len] = '\0';
+            message->payload = chunk;
+            message->payload_len = chunk_len;
+            start = HAL_GetTimeMs();
+            sub_handle.message_chunk_handler(pClient, message, offset, total_len, sub_handle.handler_user_data);
+            *handler_ms += HAL_GetTimeMs() - start;
         }
+        offset += chunk_len;
     }
 
-    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+    IOT_FUNC_EXIT_RC(rc);
+}
+
+void qcloud_iot_mqtt_stats_add_latency(Qcloud_IoT_Client *pClient, uint32_t latency_ms)
+{
+    uint32_t bucket = 0;
+
+    /* bucket of 2^(i-1) <= latency < 2^i, the last bucket takes all larger ones */
+    while (latency_ms >> bucket && bucket < MQTT_STATS_LATENCY_BUCKETS - 1) {
+        bucket++;
+    }
+
+    HAL_MutexLock(pClient->lock_stats);
+    pClient->stats.puback_count++;
+    pClient->stats.puback_latency_hist[bucket]++;
+    pClient->stats.puback_latency_max_ms = Max(pClient->stats.puback_latency_max_ms, latency_ms);
+    HAL_MutexUnlock(pClient->lock_stats);
 }
 
 /**
- * @brief remove node signed with msgId from publish ACK wait list
+ * @brief remove entry of msgId from publish ACK wait table, and return its completion callback
  *
  * @return 0, success; NOT 0, fail;
  */
-static int _mask_pubInfo_from(Qcloud_IoT_Client *c, uint16_t msgId)
+static int _mask_pubInfo_from(Qcloud_IoT_Client *c, uint16_t msgId, OnPublishCompleteHandler *on_complete,
+                              void **user_data)
 {
     IOT_FUNC_ENTRY;
 
@@ -848,35 +1063,12 @@ static int _mask_pubInfo_from(Qcloud_IoT_Client *c, uint16_t msgId)
     }
 
     HAL_MutexLock(c->lock_list_pub);
-    if (c->list_pub_wait_ack->len) {
-        ListIterator *iter;
-        ListNode *node = NULL;
-        QcloudIotPubInfo *repubInfo = NULL;
-
-        if (NULL == (iter = list_iterator_new(c->list_pub_wait_ack, LIST_TAIL))) {
-            HAL_MutexUnlock(c->lock_list_pub);
-            return QCLOUD_RET_SUCCESS;
-        }
-
-        for (;;) {
-            node = list_iterator_next(iter);
-
-            if (NULL == node) {
-                break;
-            }
-
-            repubInfo = (QcloudIotPubInfo *) node->val;
-            if (NULL == repubInfo) {
-                Log_e("node's value is invalid!");
-                continue;
-            }
-
-            if (repubInfo->msg_id == msgId) {
-                repubInfo->node_state = MQTT_NODE_STATE_INVALID; /* set as invalid node */
-            }
-        }
-
-        list_iterator_destroy(iter);
+    QcloudIotPubInfo *repubInfo = pub_inflight_find(&c->pub_inflight, msgId);
+    if (NULL != repubInfo) {
+        *on_complete = repubInfo->on_complete;
+        *user_data = repubInfo->user_data;
+        qcloud_iot_mqtt_stats_add_latency(c, HAL_GetTimeMs() - repubInfo->send_time);
+        pub_inflight_remove(&c->pub_inflight, repubInfo);
     }
     HAL_MutexUnlock(c->lock_list_pub);
 
@@ -884,16 +1076,18 @@ static int _mask_pubInfo_from(Qcloud_IoT_Client *c, uint16_t msgId)
 }
 
 /**
- * @brief remove node signed with msgId from subscribe ACK wait list, and return the msg handler
+ * @brief remove node signed with msgId from subscribe ACK wait list, and return its sub info
  *
- * @return 0, success; NOT 0, fail;
+ * @return sub info to be freed by caller, or NULL if not found
  */
-static int _mask_sub_info_from(Qcloud_IoT_Client *c, unsigned int msgId, SubTopicHandle *messageHandler)
+static QcloudIotSubInfo *_mask_sub_info_from(Qcloud_IoT_Client *c, unsigned int msgId)
 {
     IOT_FUNC_ENTRY;
 
-    if (NULL == c || NULL == messageHandler) {
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
+    QcloudIotSubInfo *found = NULL;
+
+    if (NULL == c) {
+        IOT_FUNC_EXIT_RC(NULL);
     }
 
     HAL_MutexLock(c->lock_list_sub);
@@ -904,7 +1098,7 @@ static int _mask_sub_info_from(Qcloud_IoT_Client *c, unsigned int msgId, SubTopi
 
         if (NULL == (iter = list_iterator_new(c->list_sub_wait_ack, LIST_TAIL))) {
             HAL_MutexUnlock(c->lock_list_sub);
-            IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+            IOT_FUNC_EXIT_RC(NULL);
         }
 
         for (;;) {
@@ -919,17 +1113,23 @@ static int _mask_sub_info_from(Qcloud_IoT_Client *c, unsigned int msgId, SubTopi
                 continue;
             }
 
-            if (sub_info->msg_id == msgId) {
-                *messageHandler = sub_info->handler; /* return handle */
-                sub_info->node_state = MQTT_NODE_STATE_INVALID; /* mark as invalid node */
+            if (sub_info->msg_id == msgId && MQTT_NODE_STATE_NORMANL == sub_info->node_state) {
+                found = sub_info;
+                node->val = NULL; /* take over sub info before node is freed */
+                break;
             }
         }
 
         list_iterator_destroy(iter);
+
+        if (NULL != found) {
+            timer_wheel_del(&c->timer_wheel, &found->timer_entry);
+            list_remove(c->list_sub_wait_ack, node);
+        }
     }
     HAL_MutexUnlock(c->lock_list_sub);
 
-    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+    IOT_FUNC_EXIT_RC(found);
 }
 
 
@@ -941,6 +1141,8 @@ static int _handle_puback_packet(Qcloud_IoT_Client *pClient, Timer *timer)
 
     uint16_t packet_id;
     uint8_t dup, type;
+    OnPublishCompleteHandler on_complete = NULL;
+    void *user_data = NULL;
     int rc;
 
     rc = deserialize_ack_packet(&type, &dup, &packet_id, pClient->read_buf, pClient->read_buf_size);
@@ -948,7 +1150,11 @@ static int _handle_puback_packet(Qcloud_IoT_Client *pClient, Timer *timer)
         IOT_FUNC_EXIT_RC(rc);
     }
 
-    (void)_mask_pubInfo_from(pClient, packet_id);
+    (void)_mask_pubInfo_from(pClient, packet_id, &on_complete, &user_data);
+
+    if (NULL != on_complete) {
+        on_complete(pClient, packet_id, MQTT_EVENT_PUBLISH_SUCCESS, user_data);
+    }
 
     /* notify this event to user callback */
     if (NULL != pClient->event_handle.h_fp) {
@@ -970,107 +1176,77 @@ static int _handle_suback_packet(Qcloud_IoT_Client *pClient, Timer *timer, QoS q
     POINTER_SANITY_CHECK(timer, QCLOUD_ERR_INVAL);
 
     uint32_t count = 0;
+    uint32_t i;
     uint16_t packet_id = 0;
-    QoS grantedQoS[3] = {QOS0, QOS0, QOS0};
+    QoS grantedQoS[MAX_TOPICS_PER_SUBSCRIBE];
+    QcloudIotSubInfo *sub_info;
+    SubTopicHandle *sub_handle;
+    MQTTEventType event_type;
     int rc;
     bool sub_nack = false;
 
-    rc = deserialize_suback_packet(&packet_id, 1, &count, grantedQoS, pClient->read_buf, pClient->read_buf_size);
+    rc = deserialize_suback_packet(&packet_id, MAX_TOPICS_PER_SUBSCRIBE, &count, grantedQoS, pClient->read_buf, pClient->read_buf_size);
     if (QCLOUD_RET_SUCCESS != rc) {
         IOT_FUNC_EXIT_RC(rc);
     }
 
-    int flag_dup = 0, i_free = -1;
-    // check return code in SUBACK packet: 0x00(QOS0, SUCCESS),0x01(QOS1, SUCCESS),0x02(QOS2, SUCCESS),0x80(Failure)
-    if (grantedQoS[0] == 0x80) {
-        MQTTEventMsg msg;
-
-        msg.event_type = MQTT_EVENT_SUBCRIBE_NACK;
-        msg.msg = (void *)(uintptr_t)packet_id;
-        pClient->event_handle.h_fp(pClient, pClient->event_handle.context, &msg);
-
-        sub_nack = true;
-    }
-
-    HAL_MutexLock(pClient->lock_generic);
-
-    SubTopicHandle sub_handle;
-    memset(&sub_handle, 0, sizeof(SubTopicHandle));
-    (void)_mask_sub_info_from(pClient, (unsigned int)packet_id, &sub_handle);
-
-    if (/*(NULL == sub_handle.message_handler) || */(NULL == sub_handle.topic_filter)) {
-        Log_e("sub_handle is illegal, topic is null");
-        HAL_MutexUnlock(pClient->lock_generic);
+    sub_info = _mask_sub_info_from(pClient, (unsigned int)packet_id);
+    if (NULL == sub_info) {
+        Log_e("no subscribe request waiting for SUBACK, packet_id: %u", packet_id);
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_MQTT_SUB);
     }
 
-    if (sub_nack) {
-        HAL_MutexUnlock(pClient->lock_generic);
-        Log_e("MQTT SUBSCRIBE failed, packet_id: %u topic: %s", packet_id, sub_handle.topic_filter);
-        /* notify this event to topic subscriber */
-        if (NULL != sub_handle.sub_event_handler)
-            sub_handle.sub_event_handler(pClient, MQTT_EVENT_SUBCRIBE_NACK, sub_handle.handler_user_data);
-
-        HAL_Free((void *)sub_handle.topic_filter);
-        sub_handle.topic_filter = NULL;
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_MQTT_SUB);
+    if (count != sub_info->handler_count) {
+        Log_e("SUBACK has %u return codes for %u topics, packet_id: %u", count, sub_info->handler_count, packet_id);
     }
 
-    int i;
-    for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i) {
-        if ((NULL != pClient->sub_handles[i].topic_filter)) {
-            if (0 == _check_handle_is_identical(&pClient->sub_handles[i], &sub_handle)) {
-                flag_dup = 1;
-                Log_w("Identical topic found: %s", sub_handle.topic_filter);
-                if (pClient->sub_handles[i].handler_user_data != sub_handle.handler_user_data) {
-                    Log_w("Update handler_user_data %p -> %p!",
-                          pClient->sub_handles[i].handler_user_data, sub_handle.handler_user_data);
-                    pClient->sub_handles[i].handler_user_data = sub_handle.handler_user_data;
-                }
-                HAL_Free((void *)sub_handle.topic_filter);
-                sub_handle.topic_filter = NULL;
-                break;
-            }
+    // return codes in SUBACK packet are in the order of topics in SUBSCRIBE packet
+    // 0x00(QOS0, SUCCESS),0x01(QOS1, SUCCESS),0x02(QOS2, SUCCESS),0x80(Failure)
+    for (i = 0; i < sub_info->handler_count; i++) {
+        sub_handle = &sub_info->handlers[i];
+
+        if (i >= count || grantedQoS[i] == 0x80) {
+            Log_e("MQTT SUBSCRIBE failed, packet_id: %u topic: %s", packet_id, sub_handle->topic_filter);
+            HAL_Free((void *)sub_handle->topic_filter);
+            event_type = MQTT_EVENT_SUBCRIBE_NACK;
         } else {
-            if (-1 == i_free) {
-                i_free = i; /* record available element */
+            /* identical handle only updates its user data */
+            HAL_MutexLock(pClient->lock_generic);
+            rc = topic_trie_insert(&pClient->sub_trie, sub_handle);
+            HAL_MutexUnlock(pClient->lock_generic);
+
+            if (rc < 0) {
+                Log_e("add subscription failed: %d, topic: %s", rc, sub_handle->topic_filter);
+                HAL_Free((void *)sub_handle->topic_filter);
+                event_type = MQTT_EVENT_SUBCRIBE_NACK;
+            } else {
+                event_type = MQTT_EVENT_SUBCRIBE_SUCCESS;
             }
         }
-    }
+        sub_handle->topic_filter = NULL;
 
-    if (0 == flag_dup) {
-        if (-1 == i_free) {
-            Log_e("NO more @sub_handles space!");
-            HAL_MutexUnlock(pClient->lock_generic);
-            IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
-        } else {
-            pClient->sub_handles[i_free].topic_filter = sub_handle.topic_filter;
-            pClient->sub_handles[i_free].message_handler = sub_handle.message_handler;
-            pClient->sub_handles[i_free].sub_event_handler = sub_handle.sub_event_handler;
-            pClient->sub_handles[i_free].qos = sub_handle.qos;
-            pClient->sub_handles[i_free].handler_user_data = sub_handle.handler_user_data;
+        if (MQTT_EVENT_SUBCRIBE_NACK == event_type) {
+            sub_nack = true;
         }
+
+        /* notify this event to topic subscriber */
+        if (NULL != sub_handle->sub_event_handler)
+            sub_handle->sub_event_handler(pClient, event_type, sub_handle->handler_user_data);
     }
 
-    HAL_MutexUnlock(pClient->lock_generic);
+    HAL_Free(sub_info);
 
-    /* notify this event to user callback */
+    /* notify this event to user callback, NACK if any topic failed */
     if (NULL != pClient->event_handle.h_fp) {
         MQTTEventMsg msg;
-        msg.event_type = MQTT_EVENT_SUBCRIBE_SUCCESS;
+        msg.event_type = sub_nack ? MQTT_EVENT_SUBCRIBE_NACK : MQTT_EVENT_SUBCRIBE_SUCCESS;
         msg.msg = (void *)(uintptr_t)packet_id;
-        if (pClient->event_handle.h_fp != NULL)
-            pClient->event_handle.h_fp(pClient, pClient->event_handle.context, &msg);
+        pClient->event_handle.h_fp(pClient, pClient->event_handle.context, &msg);
     }
 
-    /* notify this event to topic subscriber */
-    if (NULL != sub_handle.sub_event_handler)
-        sub_handle.sub_event_handler(pClient, MQTT_EVENT_SUBCRIBE_SUCCESS, sub_handle.handler_user_data);
-
-    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+    IOT_FUNC_EXIT_RC(sub_nack ? QCLOUD_ERR_MQTT_SUB : QCLOUD_RET_SUCCESS);
 }
 
-
 static int _handle_unsuback_packet(Qcloud_IoT_Client *pClient, Timer *timer)
 {
     IOT_FUNC_ENTRY;
@@ -1085,30 +1261,20 @@ static int _handle_unsuback_packet(Qcloud_IoT_Client *pClient, Timer *timer)
         IOT_FUNC_EXIT_RC(rc);
     }
 
-    SubTopicHandle messageHandler;
-    (void)_mask_sub_info_from(pClient, packet_id, &messageHandler);
+    QcloudIotSubInfo *sub_info = _mask_sub_info_from(pClient, packet_id);
+    uint16_t i;
 
     /* Remove from message handler array */
     HAL_MutexLock(pClient->lock_generic);
 
-    /* actually below code is nonsense as unsub handle is different with sub handle even the same topic_filter*/
-#if 0
-    int i;
-    for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i) {
-        if ((pClient->sub_handles[i].topic_filter != NULL)
-            && (0 == _check_handle_is_identical(&pClient->sub_handles[i], &messageHandler))) {
-            memset(&pClient->sub_handles[i], 0, sizeof(SubTopicHandle));
-
-            /* NOTE: in case of more than one register(subscribe) with different callback function,
-             *       so we must keep continuously searching related message handle. */
-        }
-    }
-#endif
+    /* handles were removed from subscription trie in qcloud_iot_mqtt_unsubscribe */
 
     /* Free the topic filter malloced in qcloud_iot_mqtt_unsubscribe */
-    if (messageHandler.topic_filter) {
-        HAL_Free((void *)messageHandler.topic_filter);
-        messageHandler.topic_filter = NULL;
+    if (NULL != sub_info) {
+        for (i = 0; i < sub_info->handler_count; i++) {
+            HAL_Free((void *)sub_info->handlers[i].topic_filter);
+        }
+        HAL_Free(sub_info);
     }
 
     if (NULL != pClient->event_handle.h_fp) {
@@ -1172,46 +1338,58 @@ static int _handle_publish_packet(Qcloud_IoT_Client *pClient, Timer *timer)
     MQTTMessage msg;
     int rc;
     uint32_t len = 0;
+    uint32_t recv_len, handler_ms = 0;
+    bool deliver = true;
+    bool is_stream = (0 != pClient->recv_payload_left);
 
     rc = deserialize_publish_packet(&msg.dup, &msg.qos, &msg.retained, &msg.id, &topic_name, &topic_len, (unsigned char **) &msg.payload,
                                     &msg.payload_len, pClient->read_buf, pClient->read_buf_size);
     if (QCLOUD_RET_SUCCESS != rc) {
+        if (is_stream) {
+            /* drop the payload left in network to keep packets in order */
+            msg.payload = pClient->read_buf;
+            (void)_deliver_message_chunks(pClient, "", 0, &msg, false, timer, &handler_ms);
+        }
         IOT_FUNC_EXIT_RC(rc);
     }
 
-    // topicName from packet is NOT null terminated
-    char fix_topic[MAX_SIZE_OF_CLOUD_TOPIC] = {0};
-
-    if (topic_len > MAX_SIZE_OF_CLOUD_TOPIC) {
-        topic_len = MAX_SIZE_OF_CLOUD_TOPIC - 1;
-        Log_e("topic len exceed buffer len");
+    // topicName from packet is NOT null terminated and is delivered in place with its length.
+    // payload is the tail of packet and one spare byte is kept in read_buf by _read_mqtt_packet,
+    // so it is terminated in place for handlers to parse it as a string
+    if (!is_stream) {
+        ((char *)msg.payload)[msg.payload_len] = '\0';
     }
-    memcpy(fix_topic, topic_name, topic_len);
 
-    if (QOS0 == msg.qos) {
-        rc = _deliver_message(pClient, fix_topic, topic_len, &msg);
-        if (QCLOUD_RET_SUCCESS != rc)
-            IOT_FUNC_EXIT_RC(rc);
+#ifdef MQTT_RMDUP_MSG_ENABLED
+    // check if packet_id has been received before
+    if (QOS0 != msg.qos && _get_packet_id_in_repeat_buf(msg.id) >= 0) {
+        deliver = false;
+    }
+#endif
 
-        /* No further processing required for QOS0 */
+    // deliver to msg callback, payload of stream is not read yet and all of it is left in network
+    recv_len = is_stream ? pClient->recv_payload_left : (uint32_t)msg.payload_len;
+    if (is_stream) {
+        rc = _deliver_message_chunks(pClient, topic_name, topic_len, &msg, deliver, timer, &handler_ms);
+    } else if (deliver) {
+        rc = _deliver_message(pClient, topic_name, topic_len, &msg, &handler_ms);
+    }
+    HAL_MutexLock(pClient->lock_stats);
+    pClient->stats.recv_count++;
+    pClient->stats.recv_bytes += recv_len;
+    pClient->stats.dispatch_time_ms += handler_ms;
+    HAL_MutexUnlock(pClient->lock_stats);
+    if (QCLOUD_RET_SUCCESS != rc)
         IOT_FUNC_EXIT_RC(rc);
 
-    } else {
-#ifdef MQTT_RMDUP_MSG_ENABLED
-        // check if packet_id has been received before
-        int repeat_id = _get_packet_id_in_repeat_buf(msg.id);
+    /* No further processing required for QOS0 */
+    if (QOS0 == msg.qos) {
+        IOT_FUNC_EXIT_RC(rc);
+    }
 
-        // deliver to msg callback
-        if (repeat_id < 0) {
-#endif
-            rc = _deliver_message(pClient, fix_topic, topic_len, &msg);
-            if (QCLOUD_RET_SUCCESS != rc)
-                IOT_FUNC_EXIT_RC(rc);
 #ifdef MQTT_RMDUP_MSG_ENABLED
-        }
-        _add_packet_id_to_repeat_buf(msg.id);
+    _add_packet_id_to_repeat_buf(msg.id);
 #endif
-    }
 
     HAL_MutexLock(pClient->lock_write_buf);
     if (QOS1 == msg.qos) {
@@ -1401,10 +1579,10 @@ uint8_t get_client_conn_state(Qcloud_IoT_Client *pClient)
  * return: 0, success; NOT 0, fail;
  */
 int push_sub_info_to(Qcloud_IoT_Client *c, int len, unsigned short msgId, MessageTypes type,
-                     SubTopicHandle *handler, ListNode **node)
+                     SubTopicHandle *handlers, uint16_t handler_count, ListNode **node)
 {
     IOT_FUNC_ENTRY;
-    if (!c || !handler || !node) {
+    if (!c || !handlers || !handler_count || !node) {
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_INVAL);
     }
 
@@ -1417,8 +1595,8 @@ int push_sub_info_to(Qcloud_IoT_Client *c, int len, unsigned short msgId, Messag
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_MQTT_MAX_SUBSCRIPTIONS);
     }
 
-    QcloudIotSubInfo *sub_info = (QcloudIotSubInfo *)HAL_Malloc(sizeof(
-                                     QcloudIotSubInfo) + len);
+    QcloudIotSubInfo *sub_info = (QcloudIotSubInfo *)HAL_Malloc(sizeof(QcloudIotSubInfo) +
+                                 handler_count * sizeof(SubTopicHandle) + len);
     if (NULL == sub_info) {
         HAL_MutexUnlock(c->lock_list_sub);
         Log_e("malloc failed!");
@@ -1429,23 +1607,27 @@ int push_sub_info_to(Qcloud_IoT_Client *c, int len, unsigned short msgId, Messag
     sub_info->msg_id = msgId;
     sub_info->len = len;
 
-    InitTimer(&sub_info->sub_start_time);
-    countdown_ms(&sub_info->sub_start_time, c->command_timeout_ms);
-
     sub_info->type = type;
-    sub_info->handler = *handler;
-    sub_info->buf = (unsigned char *)sub_info + sizeof(QcloudIotSubInfo);
+    sub_info->handler_count = handler_count;
+    sub_info->handlers = (SubTopicHandle *)(sub_info + 1);
+    memcpy(sub_info->handlers, handlers, handler_count * sizeof(SubTopicHandle));
+    sub_info->buf = (unsigned char *)(sub_info->handlers + handler_count);
 
     memcpy(sub_info->buf, c->write_buf, len);
 
     *node = list_node_new(sub_info);
     if (NULL == *node) {
         HAL_MutexUnlock(c->lock_list_sub);
+        HAL_Free(sub_info);
         Log_e("list_node_new failed!");
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
     }
 
     list_rpush(c->list_sub_wait_ack, *node);
+    sub_info->node = *node;
+
+    timer_wheel_entry_init(&sub_info->timer_entry);
+    timer_wheel_add(&c->timer_wheel, &sub_info->timer_entry, c->command_timeout_ms, &c->sub_expired);
 
     HAL_MutexUnlock(c->lock_list_sub);
 
@@ -315,6 +315,10 @@ static int _mqtt_connect(Qcloud_IoT_Client *pClient, MQTTConnectParams *options)
     if (QCLOUD_RET_SUCCESS != rc) {
         IOT_FUNC_EXIT_RC(rc);
     }
+    pClient->network_epoch++;
+
+    // drop data left by last connection
+    reset_recv_stream(pClient);
 
     HAL_MutexLock(pClient->lock_write_buf);
     // serialize CONNECT packet
@@ -376,6 +380,7 @@ int qcloud_iot_mqtt_connect(Qcloud_IoT_Client *pClient, MQTTConnectParams *pPara
     // disconnect network if connect fail
     if (rc != QCLOUD_RET_SUCCESS) {
         pClient->network_stack.disconnect(&(pClient->network_stack));
+        pClient->network_epoch++;
     }
 
     IOT_FUNC_EXIT_RC(rc);
@@ -443,7 +448,13 @@ int qcloud_iot_mqtt_disconnect(Qcloud_IoT_Client *pClient)
     }
     HAL_MutexUnlock(pClient->lock_write_buf);
 
+#ifdef MULTITHREAD_ENABLED
+    /* let writer task send DISCONNECT out before closing */
+    qcloud_iot_mqtt_tx_flush(pClient, true);
+#endif
+
     pClient->network_stack.disconnect(&(pClient->network_stack));
+    pClient->network_epoch++;
     set_client_conn_state(pClient, NOTCONNECTED);
     pClient->was_manually_disconnected = 1;
 
@@ -0,0 +1,326 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "mqtt_client_inflight.h"
+
+#include "qcloud_iot_import.h"
+#include "qcloud_iot_export_error.h"
+#include "qcloud_iot_export_log.h"
+#include "utils_param_check.h"
+
+/* invalid entry index */
+#define INFLIGHT_NIL                (0xFFFF)
+
+#define SLAB_ALIGN(x)               (((x) + 3) & ~((size_t)3))
+
+/* header of each allocation in slab */
+typedef struct {
+    uint32_t    size;       /* size of chunk including header */
+    uint32_t    in_use;
+} SlabChunk;
+
+static void *_slab_alloc(PubInflightTable *table, uint32_t len)
+{
+    size_t need = SLAB_ALIGN(sizeof(SlabChunk) + len);
+    SlabChunk *chunk;
+
+    if (0 == table->slab_used) {
+        table->slab_head = table->slab_tail = 0;
+        table->slab_wrap = table->slab_size;
+    }
+
+    if (table->slab_head > table->slab_tail || 0 == table->slab_used) {
+        /* data is [tail, head), free space is [head, size) and [0, tail) */
+        if (need > table->slab_size - table->slab_head) {
+            if (need > table->slab_tail) {
+                return NULL;
+            }
+            table->slab_wrap = table->slab_head;
+            table->slab_head = 0;
+        }
+    } else if (need > table->slab_tail - table->slab_head) {
+        /* data is [tail, wrap) and [0, head), free space is [head, tail) */
+        return NULL;
+    }
+
+    chunk = (SlabChunk *)(table->slab + table->slab_head);
+    chunk->size = (uint32_t)need;
+    chunk->in_use = 1;
+    table->slab_head += need;
+    table->slab_used += need;
+
+    return chunk + 1;
+}
+
+static void _slab_free(PubInflightTable *table, void *ptr)
+{
+    SlabChunk *chunk = (SlabChunk *)ptr - 1;
+
+    chunk->in_use = 0;
+
+    /* reclaim from the oldest allocation, chunks freed out of order wait until they become the oldest */
+    while (table->slab_used > 0) {
+        if (table->slab_tail == table->slab_wrap) {
+            table->slab_tail = 0;
+            table->slab_wrap = table->slab_size;
+        }
+
+        chunk = (SlabChunk *)(table->slab + table->slab_tail);
+        if (chunk->in_use) {
+            break;
+        }
+
+        table->slab_tail += chunk->size;
+        table->slab_used -= chunk->size;
+    }
+}
+
+static uint16_t _index_slot(PubInflightTable *table, uint16_t msg_id)
+{
+    return msg_id & table->index_mask;
+}
+
+/* return the index slot of packet id, or INFLIGHT_NIL */
+static uint16_t _index_lookup(PubInflightTable *table, uint16_t msg_id)
+{
+    uint16_t slot = _index_slot(table, msg_id);
+
+    while (INFLIGHT_NIL != table->index[slot]) {
+        if (table->entries[table->index[slot]].msg_id == msg_id) {
+            return slot;
+        }
+        slot = (slot + 1) & table->index_mask;
+    }
+
+    return INFLIGHT_NIL;
+}
+
+/* delete slot of linear probing index, shifting back the entries after it */
+static void _index_delete(PubInflightTable *table, uint16_t slot)
+{
+    uint16_t next = slot, home;
+
+    for (;;) {
+        next = (next + 1) & table->index_mask;
+        if (INFLIGHT_NIL == table->index[next]) {
+            break;
+        }
+
+        home = _index_slot(table, table->entries[table->index[next]].msg_id);
+        /* move the entry back if its home slot is not in (slot, next] */
+        if ((slot < next) ? (home <= slot || home > next) : (home <= slot && home > next)) {
+            table->index[slot] = table->index[next];
+            slot = next;
+        }
+    }
+
+    table->index[slot] = INFLIGHT_NIL;
+}
+
+int pub_inflight_init(PubInflightTable *table, uint16_t window, size_t slab_size, TimerWheel *wheel)
+{
+    uint32_t index_size = 1;
+    uint16_t i;
+
+    POINTER_SANITY_CHECK(table, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(wheel, QCLOUD_ERR_INVAL);
+    NUMBERIC_SANITY_CHECK(window, QCLOUD_ERR_INVAL);
+
+    memset(table, 0, sizeof(PubInflightTable));
+
+    /* keep load factor of index under 0.5 */
+    while (index_size < 2 * (uint32_t)window) {
+        index_size <<= 1;
+    }
+    if (index_size > INFLIGHT_NIL) {
+        Log_e("inflight window %u is too large", window);
+        return QCLOUD_ERR_INVAL;
+    }
+
+    table->index = (uint16_t *)HAL_Malloc(index_size * sizeof(uint16_t));
+    table->entries = (QcloudIotPubInfo *)HAL_Malloc(window * sizeof(QcloudIotPubInfo));
+    table->slab = (unsigned char *)HAL_Malloc(slab_size);
+    if (NULL == table->index || NULL == table->entries || NULL == table->slab) {
+        Log_e("malloc inflight table failed");
+        pub_inflight_deinit(table);
+        return QCLOUD_ERR_MALLOC;
+    }
+
+    memset(table->index, 0xFF, index_size * sizeof(uint16_t));
+    memset(table->entries, 0, window * sizeof(QcloudIotPubInfo));
+    for (i = 0; i < window; i++) {
+        table->entries[i].next = (i + 1 < window) ? i + 1 : INFLIGHT_NIL;
+    }
+
+    table->window = window;
+    table->index_mask = (uint16_t)(index_size - 1);
+    table->free_head = 0;
+    table->wheel = wheel;
+    timer_wheel_list_init(&table->expired);
+    table->slab_size = slab_size;
+    table->slab_wrap = slab_size;
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+void pub_inflight_deinit(PubInflightTable *table)
+{
+    if (NULL == table) {
+        return;
+    }
+
+    HAL_Free(table->index);
+    HAL_Free(table->entries);
+    HAL_Free(table->slab);
+    memset(table, 0, sizeof(PubInflightTable));
+}
+
+QcloudIotPubInfo *pub_inflight_add(PubInflightTable *table, uint16_t msg_id, const NetIoVec *iov, int iovcnt,
+                                   uint32_t timeout_ms)
+{
+    QcloudIotPubInfo *info;
+    uint16_t idx, slot;
+    uint32_t len = 0, copied = 0;
+    int i;
+
+    if (NULL == table || NULL == table->entries || NULL == iov) {
+        return NULL;
+    }
+
+    for (i = 0; i < iovcnt; i++) {
+        len += iov[i].len;
+    }
+
+    if (table->count >= table->window) {
+        Log_e("more than %u publishes waiting for PUBACK!", table->count);
+        return NULL;
+    }
+
+    if (INFLIGHT_NIL != _index_lookup(table, msg_id)) {
+        Log_e("packet id %u is waiting for PUBACK already", msg_id);
+        return NULL;
+    }
+
+    idx = table->free_head;
+    info = &table->entries[idx];
+
+    info->buf = (unsigned char *)_slab_alloc(table, len);
+    if (NULL == info->buf) {
+        Log_e("no space for publish copy of %u bytes, %u bytes in use", len, (unsigned)table->slab_used);
+        return NULL;
+    }
+    for (i = 0; i < iovcnt; i++) {
+        memcpy(info->buf + copied, iov[i].data, iov[i].len);
+        copied += iov[i].len;
+    }
+
+    table->free_head = info->next;
+    info->msg_id = msg_id;
+    info->len = len;
+    info->on_complete = NULL;
+    info->user_data = NULL;
+
+    /* insert into index */
+    slot = _index_slot(table, msg_id);
+    while (INFLIGHT_NIL != table->index[slot]) {
+        slot = (slot + 1) & table->index_mask;
+    }
+    table->index[slot] = idx;
+
+    timer_wheel_entry_init(&info->timer_entry);
+    timer_wheel_add(table->wheel, &info->timer_entry, timeout_ms, &table->expired);
+
+    table->count++;
+
+    return info;
+}
+
+QcloudIotPubInfo *pub_inflight_find(PubInflightTable *table, uint16_t msg_id)
+{
+    uint16_t slot;
+
+    if (NULL == table || 0 == table->count) {
+        return NULL;
+    }
+
+    slot = _index_lookup(table, msg_id);
+    return (INFLIGHT_NIL == slot) ? NULL : &table->entries[table->index[slot]];
+}
+
+void pub_inflight_remove(PubInflightTable *table, QcloudIotPubInfo *info)
+{
+    uint16_t idx, slot;
+
+    if (NULL == table || NULL == info) {
+        return;
+    }
+
+    slot = _index_lookup(table, info->msg_id);
+    if (INFLIGHT_NIL == slot) {
+        return;
+    }
+    idx = table->index[slot];
+    _index_delete(table, slot);
+
+    timer_wheel_del(table->wheel, &info->timer_entry);
+
+    _slab_free(table, info->buf);
+    info->buf = NULL;
+    info->len = 0;
+
+    info->next = table->free_head;
+    table->free_head = idx;
+    table->count--;
+}
+
+QcloudIotPubInfo *pub_inflight_first(PubInflightTable *table)
+{
+    uint16_t slot;
+
+    if (NULL == table || 0 == table->count) {
+        return NULL;
+    }
+
+    for (slot = 0; slot <= table->index_mask; slot++) {
+        if (INFLIGHT_NIL != table->index[slot]) {
+            return &table->entries[table->index[slot]];
+        }
+    }
+
+    return NULL;
+}
+
+QcloudIotPubInfo *pub_inflight_expired(PubInflightTable *table)
+{
+    TimerWheelEntry *entry;
+
+    if (NULL == table || 0 == table->count) {
+        return NULL;
+    }
+
+    entry = timer_wheel_pop_expired(table->wheel, &table->expired);
+
+    return (NULL == entry) ? NULL : TIMER_WHEEL_ENTRY(entry, QcloudIotPubInfo, timer_entry);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,649 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "mqtt_client.h"
+
+#ifdef MQTT_OFFLINE_QUEUE_ENABLED
+
+/*
+ * QoS1 publishes made while offline are appended to a log of segment files <dir>/mq<seq>.log.
+ * Each record is: crc32 | topic len (2) | flags (2) | payload len (4) | topic | payload,
+ * integers in little endian, crc32 covers everything after itself. A record torn by power loss
+ * fails the crc and ends its segment.
+ * Sequence number of the oldest and the newest segment is kept in two index files written in turn,
+ * the valid one with larger generation is used, so a torn index write leaves the previous one.
+ */
+
+#define OFFLINE_INDEX_MAGIC             (0x514F514D)    /* "MQOQ" */
+#define OFFLINE_PATH_LEN                (64)
+#define OFFLINE_RECORD_HEAD_LEN         (12)
+#define OFFLINE_FLAG_RETAINED           (0x04)
+#define OFFLINE_FLAG_QOS_MASK           (0x03)
+
+typedef struct {
+    uint32_t    magic;
+    uint32_t    generation;
+    uint32_t    head_seq;
+    uint32_t    tail_seq;
+    uint32_t    crc;
+} OfflineIndex;
+
+typedef struct {
+    void            *lock;
+    void            *append_fp;             /* tail segment opened for append, NULL if not opened yet */
+
+    uint32_t        generation;             /* generation of index written last */
+    uint32_t        head_seq;               /* oldest segment */
+    uint32_t        tail_seq;               /* segment being appended */
+    uint32_t        tail_size;              /* valid bytes of tail segment */
+
+    uint32_t        read_seq;               /* segment being replayed */
+    uint32_t        read_off;               /* offset of next record to replay */
+    bool            read_end;               /* no more valid record in segment being replayed */
+    bool            replay_failed;          /* a replayed record timed out, replay the segment again */
+    bool            replaying;              /* a task is in replay, the lock is released while it publishes */
+    uint16_t        outstanding;            /* replayed publishes waiting for PUBACK */
+
+    uint32_t        dropped_segments;       /* segments evicted before replayed */
+
+    /* topic and payload of record being replayed, each terminated by '\0' */
+    unsigned char   *record;
+    uint32_t        record_size;            /* max length of topic + payload, the same as MQTT Tx buffer of client */
+} OfflineQueue;
+
+static uint32_t _crc32(uint32_t crc, const unsigned char *buf, size_t len)
+{
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+    }
+
+    return ~crc;
+}
+
+static void _put_u16(unsigned char *p, uint16_t v)
+{
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+static void _put_u32(unsigned char *p, uint32_t v)
+{
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static uint16_t _get_u16(const unsigned char *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t _get_u32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void _segment_path(char *path, uint32_t seq)
+{
+    HAL_Snprintf(path, OFFLINE_PATH_LEN, "%s/mq%u.log", MQTT_OFFLINE_QUEUE_DIR, (unsigned)seq);
+}
+
+static void _index_path(char *path, uint32_t generation)
+{
+    HAL_Snprintf(path, OFFLINE_PATH_LEN, "%s/mq%u.idx", MQTT_OFFLINE_QUEUE_DIR, (unsigned)(generation & 1));
+}
+
+/**
+ * @brief read one record at current position of fp into queue->record
+ *
+ * @return length of record, or 0 if end of file or record is invalid
+ */
+static uint32_t _read_record(OfflineQueue *queue, void *fp, uint16_t *topic_len, uint32_t *payload_len, uint16_t *flags)
+{
+    unsigned char head[OFFLINE_RECORD_HEAD_LEN];
+    uint32_t crc;
+
+    if (HAL_FileRead(head, 1, sizeof(head), fp) != sizeof(head)) {
+        return 0;
+    }
+
+    *topic_len = _get_u16(head + 4);
+    *flags = _get_u16(head + 6);
+    *payload_len = _get_u32(head + 8);
+    if (0 == *topic_len || *topic_len > MAX_SIZE_OF_CLOUD_TOPIC || *payload_len > queue->record_size ||
+        *topic_len + *payload_len > queue->record_size) {
+        return 0;
+    }
+
+    if (HAL_FileRead(queue->record, 1, *topic_len, fp) != *topic_len) {
+        return 0;
+    }
+    queue->record[*topic_len] = '\0';
+
+    if (HAL_FileRead(queue->record + *topic_len + 1, 1, *payload_len, fp) != *payload_len) {
+        return 0;
+    }
+    queue->record[*topic_len + 1 + *payload_len] = '\0';
+
+    crc = _crc32(0, head + 4, OFFLINE_RECORD_HEAD_LEN - 4);
+    crc = _crc32(crc, queue->record, *topic_len);
+    crc = _crc32(crc, queue->record + *topic_len + 1, *payload_len);
+    if (crc != _get_u32(head)) {
+        return 0;
+    }
+
+    return OFFLINE_RECORD_HEAD_LEN + *topic_len + *payload_len;
+}
+
+static int _save_index(OfflineQueue *queue)
+{
+    char path[OFFLINE_PATH_LEN];
+    unsigned char buf[sizeof(OfflineIndex)];
+    uint32_t generation = queue->generation + 1;
+    void *fp;
+    size_t written;
+
+    _put_u32(buf, OFFLINE_INDEX_MAGIC);
+    _put_u32(buf + 4, generation);
+    _put_u32(buf + 8, queue->head_seq);
+    _put_u32(buf + 12, queue->tail_seq);
+    _put_u32(buf + 16, _crc32(0, buf, 16));
+
+    _index_path(path, generation);
+    fp = HAL_FileOpen(path, "wb");
+    if (NULL == fp) {
+        Log_e("open %s failed", path);
+        return QCLOUD_ERR_FAILURE;
+    }
+    written = HAL_FileWrite(buf, 1, sizeof(buf), fp);
+    HAL_FileFlush(fp);
+    HAL_FileClose(fp);
+    if (written != sizeof(buf)) {
+        Log_e("write %s failed", path);
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    queue->generation = generation;
+    return QCLOUD_RET_SUCCESS;
+}
+
+static bool _load_index_file(uint32_t slot, OfflineIndex *index)
+{
+    char path[OFFLINE_PATH_LEN];
+    unsigned char buf[sizeof(OfflineIndex)];
+    void *fp;
+    size_t read_len;
+
+    _index_path(path, slot);
+    fp = HAL_FileOpen(path, "rb");
+    if (NULL == fp) {
+        return false;
+    }
+    read_len = HAL_FileRead(buf, 1, sizeof(buf), fp);
+    HAL_FileClose(fp);
+
+    if (read_len != sizeof(buf) || _get_u32(buf) != OFFLINE_INDEX_MAGIC || _get_u32(buf + 16) != _crc32(0, buf, 16)) {
+        return false;
+    }
+
+    index->generation = _get_u32(buf + 4);
+    index->head_seq = _get_u32(buf + 8);
+    index->tail_seq = _get_u32(buf + 12);
+
+    /* the segment window can never exceed the limit, reject an index out of range */
+    return index->tail_seq - index->head_seq < MQTT_OFFLINE_MAX_SEGMENTS;
+}
+
+static void _load_index(OfflineQueue *queue)
+{
+    OfflineIndex index[2];
+    bool valid[2];
+    int i;
+
+    valid[0] = _load_index_file(0, &index[0]);
+    valid[1] = _load_index_file(1, &index[1]);
+
+    if (!valid[0] && !valid[1]) {
+        queue->generation = 0;
+        queue->head_seq = queue->tail_seq = 0;
+        return;
+    }
+
+    if (valid[0] && valid[1]) {
+        i = (int32_t)(index[1].generation - index[0].generation) > 0 ? 1 : 0;
+    } else {
+        i = valid[0] ? 0 : 1;
+    }
+
+    queue->generation = index[i].generation;
+    queue->head_seq = index[i].head_seq;
+    queue->tail_seq = index[i].tail_seq;
+}
+
+/* length of valid records at the beginning of tail segment, *file_size gets the whole size */
+static uint32_t _scan_tail_segment(OfflineQueue *queue, long *file_size)
+{
+    char path[OFFLINE_PATH_LEN];
+    uint16_t topic_len, flags;
+    uint32_t payload_len, len;
+    uint32_t valid_len = 0;
+    void *fp;
+
+    *file_size = 0;
+    _segment_path(path, queue->tail_seq);
+    fp = HAL_FileOpen(path, "rb");
+    if (NULL == fp) {
+        return 0;
+    }
+
+    while ((len = _read_record(queue, fp, &topic_len, &payload_len, &flags)) > 0) {
+        valid_len += len;
+    }
+
+    if (0 == HAL_FileSeek(fp, 0, SEEK_END)) {
+        *file_size = HAL_FileTell(fp);
+    }
+    HAL_FileClose(fp);
+
+    return valid_len;
+}
+
+static void _close_append_file(OfflineQueue *queue)
+{
+    if (NULL != queue->append_fp) {
+        HAL_FileClose(queue->append_fp);
+        queue->append_fp = NULL;
+    }
+}
+
+/* start a new tail segment, drop the oldest ones if the number of segments exceeds the limit */
+static int _roll_segment(OfflineQueue *queue)
+{
+    char path[OFFLINE_PATH_LEN];
+
+    _close_append_file(queue);
+    queue->tail_seq++;
+    queue->tail_size = 0;
+
+    while (queue->tail_seq - queue->head_seq >= MQTT_OFFLINE_MAX_SEGMENTS) {
+        _segment_path(path, queue->head_seq);
+        HAL_FileRemove(path);
+        Log_w("offline queue is full, segment %u dropped", (unsigned)queue->head_seq);
+
+        if (queue->read_seq == queue->head_seq) {
+            queue->read_seq++;
+            queue->read_off = 0;
+            queue->read_end = false;
+            queue->replay_failed = false;
+        }
+        queue->head_seq++;
+        queue->dropped_segments++;
+    }
+
+    return _save_index(queue);
+}
+
+/* records not replayed, or replayed and not acknowledged yet */
+static bool _has_pending(OfflineQueue *queue)
+{
+    return queue->read_seq != queue->tail_seq || queue->read_off < queue->tail_size || queue->outstanding > 0 ||
+           queue->replay_failed;
+}
+
+int qcloud_iot_mqtt_offline_init(Qcloud_IoT_Client *pClient)
+{
+    IOT_FUNC_ENTRY;
+
+    POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
+
+    OfflineQueue *queue;
+    long file_size;
+
+    queue = (OfflineQueue *)HAL_Malloc(sizeof(OfflineQueue));
+    if (NULL == queue) {
+        Log_e("malloc offline queue failed");
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_MALLOC);
+    }
+    memset(queue, 0, sizeof(OfflineQueue));
+
+    /* a record is published from Tx buffer, so it is no longer than that */
+    queue->record_size = pClient->write_buf_size;
+    queue->record = (unsigned char *)HAL_Malloc(queue->record_size + 2);
+    if (NULL == queue->record) {
+        Log_e("malloc offline record buffer failed");
+        HAL_Free(queue);
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_MALLOC);
+    }
+
+    queue->lock = HAL_MutexCreate();
+    if (NULL == queue->lock) {
+        HAL_Free(queue->record);
+        HAL_Free(queue);
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
+    }
+
+    _load_index(queue);
+
+    queue->tail_size = _scan_tail_segment(queue, &file_size);
+    if (file_size > (long)queue->tail_size) {
+        /* torn record at the end, keep the valid ones for replay and append to a new segment */
+        Log_w("offline segment %u is truncated at %u", (unsigned)queue->tail_seq, (unsigned)queue->tail_size);
+        _roll_segment(queue);
+    }
+
+    queue->read_seq = queue->head_seq;
+    queue->read_off = 0;
+
+    if (_has_pending(queue)) {
+        Log_i("offline queue has segment %u - %u to replay", (unsigned)queue->head_seq, (unsigned)queue->tail_seq);
+    }
+
+    pClient->offline_queue = queue;
+
+    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+}
+
+void qcloud_iot_mqtt_offline_deinit(Qcloud_IoT_Client *pClient)
+{
+    OfflineQueue *queue = (OfflineQueue *)pClient->offline_queue;
+
+    if (NULL == queue) {
+        return;
+    }
+
+    _close_append_file(queue);
+    HAL_MutexDestroy(queue->lock);
+    HAL_Free(queue->record);
+    HAL_Free(queue);
+    pClient->offline_queue = NULL;
+}
+
+bool qcloud_iot_mqtt_offline_pending(Qcloud_IoT_Client *pClient)
+{
+    OfflineQueue *queue = (OfflineQueue *)pClient->offline_queue;
+    bool pending;
+
+    if (NULL == queue) {
+        return false;
+    }
+
+    HAL_MutexLock(queue->lock);
+    pending = _has_pending(queue);
+    HAL_MutexUnlock(queue->lock);
+
+    return pending;
+}
+
+int qcloud_iot_mqtt_offline_append(Qcloud_IoT_Client *pClient, char *topicName, PublishParams *pParams)
+{
+    IOT_FUNC_ENTRY;
+
+    OfflineQueue *queue = (OfflineQueue *)pClient->offline_queue;
+    char path[OFFLINE_PATH_LEN];
+    unsigned char head[OFFLINE_RECORD_HEAD_LEN];
+    size_t topic_len = strlen(topicName);
+    uint32_t rec_len;
+    uint32_t crc;
+    int rc = QCLOUD_RET_SUCCESS;
+
+    POINTER_SANITY_CHECK(queue, QCLOUD_ERR_INVAL);
+
+    if (topic_len + pParams->payload_len > queue->record_size) {
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_BUF_TOO_SHORT);
+    }
+    rec_len = OFFLINE_RECORD_HEAD_LEN + topic_len + pParams->payload_len;
+
+    _put_u16(head + 4, (uint16_t)topic_len);
+    _put_u16(head + 6, (uint16_t)((pParams->qos & OFFLINE_FLAG_QOS_MASK) | (pParams->retained ? OFFLINE_FLAG_RETAINED : 0)));
+    _put_u32(head + 8, (uint32_t)pParams->payload_len);
+    crc = _crc32(0, head + 4, OFFLINE_RECORD_HEAD_LEN - 4);
+    crc = _crc32(crc, (const unsigned char *)topicName, topic_len);
+    crc = _crc32(crc, (const unsigned char *)pParams->payload, pParams->payload_len);
+    _put_u32(head, crc);
+
+    HAL_MutexLock(queue->lock);
+
+    if (queue->tail_size > 0 && queue->tail_size + rec_len > MQTT_OFFLINE_SEGMENT_SIZE) {
+        _roll_segment(queue);
+    }
+
+    if (NULL == queue->append_fp) {
+        _segment_path(path, queue->tail_seq);
+        queue->append_fp = HAL_FileOpen(path, "ab");
+        if (NULL == queue->append_fp) {
+            Log_e("open %s failed", path);
+            HAL_MutexUnlock(queue->lock);
+            IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
+        }
+    }
+
+    if (HAL_FileWrite(head, 1, sizeof(head), queue->append_fp) != sizeof(head) ||
+        HAL_FileWrite(topicName, 1, topic_len, queue->append_fp) != topic_len ||
+        HAL_FileWrite(pParams->payload, 1, pParams->payload_len, queue->append_fp) != pParams->payload_len ||
+        0 != HAL_FileFlush(queue->append_fp)) {
+        /* partial record fails crc and ends the segment, so append the next one to a new segment */
+        Log_e("write offline segment %u failed", (unsigned)queue->tail_seq);
+        _roll_segment(queue);
+        rc = QCLOUD_ERR_FAILURE;
+    } else {
+        queue->tail_size += rec_len;
+    }
+
+    HAL_MutexUnlock(queue->lock);
+
+    IOT_FUNC_EXIT_RC(rc);
+}
+
+static void _offline_on_complete(void *pClient, uint16_t packet_id, MQTTEventType result, void *pUserData)
+{
+    OfflineQueue *queue = (OfflineQueue *)((Qcloud_IoT_Client *)pClient)->offline_queue;
+
+    /* the queue replayed from is closed */
+    if (NULL == queue || queue != pUserData) {
+        return;
+    }
+
+    HAL_MutexLock(queue->lock);
+    if (queue->outstanding > 0) {
+        queue->outstanding--;
+    }
+    if (MQTT_EVENT_PUBLISH_SUCCESS != result) {
+        Log_w("replayed publish %u failed: %d", packet_id, result);
+        queue->replay_failed = true;
+    }
+    HAL_MutexUnlock(queue->lock);
+}
+
+/* handle end of segment being replayed, return true if there are more records to replay */
+static bool _finish_segment(OfflineQueue *queue)
+{
+    char path[OFFLINE_PATH_LEN];
+
+    if (queue->replay_failed) {
+        Log_w("replay offline segment %u again", (unsigned)queue->read_seq);
+        queue->replay_failed = false;
+        queue->read_off = 0;
+        queue->read_end = false;
+        return true;
+    }
+
+    _segment_path(path, queue->read_seq);
+
+    if (queue->read_seq == queue->tail_seq) {
+        if (0 == queue->tail_size) {
+            return false;
+        }
+        /* all acknowledged, start over the tail segment from empty */
+        _close_append_file(queue);
+        HAL_FileRemove(path);
+        queue->tail_size = 0;
+        queue->read_off = 0;
+        queue->read_end = false;
+        Log_i("offline queue is replayed, %u segments dropped", (unsigned)queue->dropped_segments);
+        return false;
+    }
+
+    HAL_FileRemove(path);
+    queue->read_seq++;
+    queue->read_off = 0;
+    queue->read_end = false;
+    queue->head_seq = queue->read_seq;
+    _save_index(queue);
+
+    return true;
+}
+
+int qcloud_iot_mqtt_offline_replay(Qcloud_IoT_Client *pClient)
+{
+    IOT_FUNC_ENTRY;
+
+    OfflineQueue *queue = (OfflineQueue *)pClient->offline_queue;
+    char path[OFFLINE_PATH_LEN];
+    PublishParams params;
+    uint16_t topic_len, flags;
+    uint32_t payload_len, rec_len, read_seq, read_off;
+    void *fp = NULL;
+    int count = 0;
+    int rc = QCLOUD_RET_SUCCESS;
+
+    if (NULL == queue) {
+        IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+    }
+
+    HAL_MutexLock(queue->lock);
+
+    /* replayed by another task, queue->record is in use */
+    if (queue->replaying) {
+        HAL_MutexUnlock(queue->lock);
+        IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+    }
+    queue->replaying = true;
+
+    while (queue->outstanding < MQTT_OFFLINE_REPLAY_WINDOW && count < MQTT_OFFLINE_REPLAY_WINDOW) {
+        /* records after a lost one would overtake it, hold them until the segment is replayed again */
+        if (queue->replay_failed || queue->read_end ||
+            (queue->read_seq == queue->tail_seq && queue->read_off >= queue->tail_size)) {
+            /* segment is removed only after all of its records are acknowledged */
+            if (queue->outstanding > 0 || !_finish_segment(queue)) {
+                break;
+            }
+            if (NULL != fp) {
+                HAL_FileClose(fp);
+                fp = NULL;
+            }
+            continue;
+        }
+
+        if (NULL == fp) {
+            _segment_path(path, queue->read_seq);
+            fp = HAL_FileOpen(path, "rb");
+            if (NULL != fp && 0 != HAL_FileSeek(fp, queue->read_off, SEEK_SET)) {
+                HAL_FileClose(fp);
+                fp = NULL;
+            }
+        }
+
+        rec_len = (NULL != fp) ? _read_record(queue, fp, &topic_len, &payload_len, &flags) : 0;
+        if (0 == rec_len) {
+            if (NULL != fp) {
+                HAL_FileClose(fp);
+                fp = NULL;
+            }
+            queue->read_end = true;
+            if (queue->read_seq == queue->tail_seq) {
+                /* storage corrupted under tail segment, append new records elsewhere */
+                Log_e("invalid record in offline segment %u at %u", (unsigned)queue->read_seq, (unsigned)queue->read_off);
+                _roll_segment(queue);
+            }
+            continue;
+        }
+
+        memset(&params, 0, sizeof(PublishParams));
+        params.qos = (QoS)(flags & OFFLINE_FLAG_QOS_MASK);
+        params.retained = (flags & OFFLINE_FLAG_RETAINED) ? 1 : 0;
+        params.payload = queue->record + topic_len + 1;
+        params.payload_len = payload_len;
+
+        /* publish may block on network or complete at once, so it is made without the lock.
+         * it is counted before, as PUBACK could be handled by another task before publish returns */
+        read_seq = queue->read_seq;
+        read_off = queue->read_off;
+        queue->outstanding++;
+        HAL_MutexUnlock(queue->lock);
+
+        rc = qcloud_iot_mqtt_publish_replay(pClient, (char *)queue->record, &params, _offline_on_complete, queue);
+
+        HAL_MutexLock(queue->lock);
+        if (rc < 0 && queue->outstanding > 0) {
+            queue->outstanding--;
+        }
+        if (read_seq != queue->read_seq || read_off != queue->read_off) {
+            /* segment is dropped for new records meanwhile, go on from where it is now */
+            if (NULL != fp) {
+                HAL_FileClose(fp);
+                fp = NULL;
+            }
+            rc = QCLOUD_RET_SUCCESS;
+            continue;
+        }
+
+        if (rc == QCLOUD_ERR_BUF_TOO_SHORT || rc == QCLOUD_ERR_MAX_TOPIC_LENGTH) {
+            Log_e("offline record dropped, rc: %d", rc);
+        } else if (rc < 0) {
+            /* try the same record next time */
+            if (rc == QCLOUD_ERR_MQTT_INFLIGHT_FULL) {
+                rc = QCLOUD_RET_SUCCESS;
+            } else if (queue->outstanding > 0) {
+                /* link is lost, records replayed before may be lost with it */
+                queue->replay_failed = true;
+            }
+            break;
+        }
+
+        queue->read_off += rec_len;
+        count++;
+        rc = QCLOUD_RET_SUCCESS;
+    }
+
+    if (NULL != fp) {
+        HAL_FileClose(fp);
+    }
+
+    queue->replaying = false;
+    HAL_MutexUnlock(queue->lock);
+
+    IOT_FUNC_EXIT_RC(rc);
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -29,9 +29,11 @@ extern "C" {
  * @param mqttstring the MQTTString structure into which the data is to be read
  * @param pptr pointer to the output buffer - incremented by the number of bytes used & returned
  * @param enddata pointer to the end of the data: do not read beyond
+ * @param max_len size of the receive buffer of the client, the string must fit in it
  * @return SUCCESS if successful, FAILURE if not
  */
-static int _read_string_with_len(char **string, uint16_t *stringLen, unsigned char **pptr, unsigned char *enddata)
+static int _read_string_with_len(char **string, uint16_t *stringLen, unsigned char **pptr, unsigned char *enddata,
+                                 size_t max_len)
 {
     int rc = QCLOUD_ERR_FAILURE;
 
@@ -40,8 +42,8 @@ static int _read_string_with_len(char **string, uint16_t *stringLen, unsigned ch
     if (enddata - (*pptr) > 1) {
         *stringLen = mqtt_read_uint16_t(pptr); /* increments pptr to point past length */
 
-        if (*stringLen > QCLOUD_IOT_MQTT_RX_BUF_LEN) {
-            Log_e("stringLen exceed QCLOUD_IOT_MQTT_RX_BUF_LEN");
+        if (*stringLen > max_len) {
+            Log_e("stringLen %u exceed read buffer size %u", *stringLen, (unsigned)max_len);
             IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
         }
 
@@ -73,56 +75,29 @@ static uint32_t _get_publish_packet_len(uint8_t qos, char *topicName, size_t pay
     return (uint32_t) len;
 }
 
-static int _mask_push_pubInfo_to(Qcloud_IoT_Client *c, int len, unsigned short msgId, ListNode **node)
+static int _mask_push_pubInfo_to(Qcloud_IoT_Client *c, const NetIoVec *iov, int iovcnt, unsigned short msgId,
+                                 OnPublishCompleteHandler on_complete, void *user_data)
 {
     IOT_FUNC_ENTRY;
 
-    if (!c || !node) {
+    if (!c || !iov) {
         Log_e("invalid parameters!");
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_MQTT_PUSH_TO_LIST_FAILED);
     }
 
-    if ((len < 0) || (len > c->write_buf_size)) {
-        Log_e("the param of len is error!");
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
-    }
-
     HAL_MutexLock(c->lock_list_pub);
-
-    if (c->list_pub_wait_ack->len >= MAX_REPUB_NUM) {
-        HAL_MutexUnlock(c->lock_list_pub);
-        Log_e("more than %u elements in republish list. List overflow!", c->list_pub_wait_ack->len);
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
+    QcloudIotPubInfo *repubInfo = pub_inflight_add(&c->pub_inflight, msgId, iov, iovcnt, c->command_timeout_ms);
+    if (NULL != repubInfo) {
+        repubInfo->on_complete = on_complete;
+        repubInfo->user_data = user_data;
+        repubInfo->send_time = HAL_GetTimeMs();
     }
+    HAL_MutexUnlock(c->lock_list_pub);
 
-    QcloudIotPubInfo *repubInfo = (QcloudIotPubInfo *)HAL_Malloc(sizeof(QcloudIotPubInfo) + len);
     if (NULL == repubInfo) {
-        HAL_MutexUnlock(c->lock_list_pub);
-        Log_e("memory malloc failed!");
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
-    }
-
-    repubInfo->node_state = MQTT_NODE_STATE_NORMANL;
-    repubInfo->msg_id = msgId;
-    repubInfo->len = len;
-    InitTimer(&repubInfo->pub_start_time);
-    countdown_ms(&repubInfo->pub_start_time, c->command_timeout_ms);
-
-    repubInfo->buf = (unsigned char *)repubInfo + sizeof(QcloudIotPubInfo);
-
-    memcpy(repubInfo->buf, c->write_buf, len);
-
-    *node = list_node_new(repubInfo);
-    if (NULL == *node) {
-        HAL_MutexUnlock(c->lock_list_pub);
-        Log_e("list_node_new failed!");
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_MQTT_PUSH_TO_LIST_FAILED);
     }
 
-    list_rpush(c->list_pub_wait_ack, *node);
-
-    HAL_MutexUnlock(c->lock_list_pub);
-
     IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
 }
 
@@ -136,7 +111,7 @@ static int _mask_push_pubInfo_to(Qcloud_IoT_Client *c, int len, unsigned short m
   * @param payload returned byte buffer - the MQTT publish payload
   * @param payload_len returned integer - the length of the MQTT payload
   * @param buf the raw buffer data, of the correct length determined by the remaining length field
-  * @param buf_len the length in bytes of the data in the supplied buffer
+  * @param buf_len the length in bytes of the data in the supplied buffer, read_buf_size of the client
   * @return error code.  1 is success
   */
 int deserialize_publish_packet(uint8_t *dup, QoS *qos, uint8_t *retained, uint16_t *packet_id, char **topicName,
@@ -185,7 +160,7 @@ int deserialize_publish_packet(uint8_t *dup, QoS *qos, uint8_t *retained, uint16
     enddata = curdata + decodedLen;
 
     /* do we have enough data to read the protocol version byte? */
-    if (QCLOUD_RET_SUCCESS != _read_string_with_len(topicName, topicNameLen, &curdata, enddata) || (0 > (enddata - curdata))) {
+    if (QCLOUD_RET_SUCCESS != _read_string_with_len(topicName, topicNameLen, &curdata, enddata, buf_len) || (0 > (enddata - curdata))) {
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
     }
 
@@ -241,27 +216,25 @@ int serialize_pub_ack_packet(unsigned char *buf, size_t buf_len, MessageTypes pa
 
 
 /**
-  * Serializes the supplied publish data into the supplied buffer, ready for sending
-  * @param buf the buffer into which the packet will be serialized
+  * Serializes the fixed header and variable header of publish packet into the supplied buffer,
+  * the payload is sent from the user buffer as the next segment
+  * @param buf the buffer into which the headers will be serialized
   * @param buf_len the length in bytes of the supplied buffer
   * @param dup integer - the MQTT dup flag
   * @param qos integer - the MQTT QoS value
   * @param retained integer - the MQTT retained flag
   * @param packet_id integer - the MQTT packet identifier
   * @param topicName MQTTString - the MQTT topic in the publish
-  * @param payload byte buffer - the MQTT publish payload
   * @param payload_len integer - the length of the MQTT payload
-  * @return the length of the serialized data.  <= 0 indicates error
+  * @return the length of the serialized headers.  <= 0 indicates error
   */
-static int _serialize_publish_packet(unsigned char *buf, size_t buf_len, uint8_t dup, QoS qos, uint8_t retained,
-                                     uint16_t packet_id,
-                                     char *topicName, unsigned char *payload, size_t payload_len,
+static int _serialize_publish_header(unsigned char *buf, size_t buf_len, uint8_t dup, QoS qos, uint8_t retained,
+                                     uint16_t packet_id, char *topicName, size_t payload_len,
                                      uint32_t *serialized_len)
 {
     IOT_FUNC_ENTRY;
     POINTER_SANITY_CHECK(buf, QCLOUD_ERR_INVAL);
     POINTER_SANITY_CHECK(serialized_len, QCLOUD_ERR_INVAL);
-    POINTER_SANITY_CHECK(payload, QCLOUD_ERR_INVAL);
 
     unsigned char *ptr = buf;
     unsigned char header = 0;
@@ -269,7 +242,7 @@ static int _serialize_publish_packet(unsigned char *buf, size_t buf_len, uint8_t
     int rc;
 
     rem_len = _get_publish_packet_len(qos, topicName, payload_len);
-    if (get_mqtt_packet_len(rem_len) > buf_len) {
+    if (get_mqtt_packet_len(rem_len) - payload_len > buf_len) {
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_BUF_TOO_SHORT);
     }
 
@@ -288,15 +261,13 @@ static int _serialize_publish_packet(unsigned char *buf, size_t buf_len, uint8_t
         mqtt_write_uint_16(&ptr, packet_id);  /* Variable Header: Topic Name */
     }
 
-    memcpy(ptr, payload, payload_len);
-    ptr += payload_len;
-
     *serialized_len = (uint32_t) (ptr - buf);
 
     IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
 }
 
-int qcloud_iot_mqtt_publish(Qcloud_IoT_Client *pClient, char *topicName, PublishParams *pParams)
+static int _mqtt_publish(Qcloud_IoT_Client *pClient, char *topicName, PublishParams *pParams,
+                         OnPublishCompleteHandler on_complete, void *user_data, bool from_offline_queue)
 {
     IOT_FUNC_ENTRY;
 
@@ -304,12 +275,13 @@ int qcloud_iot_mqtt_publish(Qcloud_IoT_Client *pClient, char *topicName, Publish
     POINTER_SANITY_CHECK(pParams, QCLOUD_ERR_INVAL);
     STRING_PTR_SANITY_CHECK(topicName, QCLOUD_ERR_INVAL);
 
+    POINTER_SANITY_CHECK(pParams->payload, QCLOUD_ERR_INVAL);
+
     Timer timer;
     uint32_t len = 0;
+    NetIoVec iov[2];
     int rc;
 
-    ListNode *node = NULL;
-
     size_t topicLen = strlen(topicName);
     if (topicLen > MAX_SIZE_OF_CLOUD_TOPIC) {
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_MAX_TOPIC_LENGTH);
@@ -320,10 +292,35 @@ int qcloud_iot_mqtt_publish(Qcloud_IoT_Client *pClient, char *topicName, Publish
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_MQTT_QOS_NOT_SUPPORT);
     }
 
+#ifdef MQTT_OFFLINE_QUEUE_ENABLED
+    /* store QoS1 publish while offline, and keep later ones behind it until it is replayed */
+    if (pParams->qos == QOS1 && !from_offline_queue && NULL != pClient->offline_queue &&
+        (!get_client_conn_state(pClient) || qcloud_iot_mqtt_offline_pending(pClient))) {
+        /* callback and user context could not be stored, so a publish with callback is refused, not let ahead */
+        if (NULL != on_complete) {
+            IOT_FUNC_EXIT_RC(get_client_conn_state(pClient) ? QCLOUD_ERR_MQTT_OFFLINE_PENDING : QCLOUD_ERR_MQTT_NO_CONN);
+        }
+        rc = qcloud_iot_mqtt_offline_append(pClient, topicName, pParams);
+        IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS == rc ? 0 : rc);
+    }
+#else
+    (void)from_offline_queue;
+#endif
+
     if (!get_client_conn_state(pClient)) {
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_MQTT_NO_CONN);
     }
 
+    if (pParams->qos == QOS1) {
+        /* checked again when the publish is added to the table, this one avoids a wasted packet id */
+        HAL_MutexLock(pClient->lock_list_pub);
+        bool is_full = pClient->pub_inflight.count >= pClient->pub_inflight.window;
+        HAL_MutexUnlock(pClient->lock_list_pub);
+        if (is_full) {
+            IOT_FUNC_EXIT_RC(QCLOUD_ERR_MQTT_INFLIGHT_FULL);
+        }
+    }
+
     InitTimer(&timer);
     countdown_ms(&timer, pClient->command_timeout_ms);
 
@@ -343,15 +340,21 @@ int qcloud_iot_mqtt_publish(Qcloud_IoT_Client *pClient, char *topicName, Publish
         }
     }
 
-    rc = _serialize_publish_packet(pClient->write_buf, pClient->write_buf_size, 0, pParams->qos, pParams->retained, pParams->id,
-                                   topicName, (unsigned char *) pParams->payload, pParams->payload_len, &len);
+    rc = _serialize_publish_header(pClient->write_buf, pClient->write_buf_size, 0, pParams->qos, pParams->retained, pParams->id,
+                                   topicName, pParams->payload_len, &len);
     if (QCLOUD_RET_SUCCESS != rc) {
         HAL_MutexUnlock(pClient->lock_write_buf);
         IOT_FUNC_EXIT_RC(rc);
     }
 
+    /* headers from write buffer, payload from user buffer */
+    iov[0].data = pClient->write_buf;
+    iov[0].len = len;
+    iov[1].data = (const unsigned char *)pParams->payload;
+    iov[1].len = pParams->payload_len;
+
     if (pParams->qos > QOS0) {
-        rc = _mask_push_pubInfo_to(pClient, len, pParams->id, &node);
+        rc = _mask_push_pubInfo_to(pClient, iov, 2, pParams->id, on_complete, user_data);
         if (QCLOUD_RET_SUCCESS != rc) {
             Log_e("push publish into to pubInfolist failed!");
             HAL_MutexUnlock(pClient->lock_write_buf);
@@ -360,11 +363,11 @@ int qcloud_iot_mqtt_publish(Qcloud_IoT_Client *pClient, char *topicName, Publish
     }
 
     /* send the publish packet */
-    rc = send_mqtt_packet(pClient, len, &timer);
+    rc = send_mqtt_packet_vec(pClient, iov, 2, &timer);
     if (QCLOUD_RET_SUCCESS != rc) {
         if (pParams->qos > QOS0) {
             HAL_MutexLock(pClient->lock_list_pub);
-            list_remove(pClient->list_pub_wait_ack, node);
+            pub_inflight_remove(&pClient->pub_inflight, pub_inflight_find(&pClient->pub_inflight, pParams->id));
             HAL_MutexUnlock(pClient->lock_list_pub);
         }
 
@@ -374,9 +377,161 @@ int qcloud_iot_mqtt_publish(Qcloud_IoT_Client *pClient, char *topicName, Publish
 
     HAL_MutexUnlock(pClient->lock_write_buf);
 
+    HAL_MutexLock(pClient->lock_stats);
+    pClient->stats.pub_count++;
+    pClient->stats.pub_bytes += len + pParams->payload_len;
+    HAL_MutexUnlock(pClient->lock_stats);
+
+    /* no PUBACK for QoS0, it is completed once sent */
+    if (pParams->qos == QOS0 && NULL != on_complete) {
+        on_complete(pClient, pParams->id, MQTT_EVENT_PUBLISH_SUCCESS, user_data);
+    }
+
     IOT_FUNC_EXIT_RC(pParams->id);
 }
 
+int qcloud_iot_mqtt_publish(Qcloud_IoT_Client *pClient, char *topicName, PublishParams *pParams)
+{
+    return _mqtt_publish(pClient, topicName, pParams, NULL, NULL, false);
+}
+
+int qcloud_iot_mqtt_publish_async(Qcloud_IoT_Client *pClient, char *topicName, PublishParams *pParams,
+                                  OnPublishCompleteHandler on_complete, void *user_data)
+{
+    return _mqtt_publish(pClient, topicName, pParams, on_complete, user_data, false);
+}
+
+#ifdef MQTT_OFFLINE_QUEUE_ENABLED
+int qcloud_iot_mqtt_publish_replay(Qcloud_IoT_Client *pClient, char *topicName, PublishParams *pParams,
+                                   OnPublishCompleteHandler on_complete, void *user_data)
+{
+    return _mqtt_publish(pClient, topicName, pParams, on_complete, user_data, true);
+}
+#endif
+
+/* publish made by other tasks, topic and payload are referenced until on_complete */
+typedef struct {
+    char                        *topic;
+    PublishParams               params;
+    OnPublishCompleteHandler    on_complete;
+    void                        *user_data;
+} DeferredPublish;
+
+int qcloud_iot_mqtt_deferred_init(Qcloud_IoT_Client *pClient)
+{
+    if (RINGBUFF_OK != mpsc_ring_init(&pClient->deferred_pub, QCLOUD_IOT_MQTT_DEFERRED_PUB_LEN, sizeof(DeferredPublish))) {
+        return QCLOUD_ERR_MALLOC;
+    }
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+void qcloud_iot_mqtt_deferred_deinit(Qcloud_IoT_Client *pClient)
+{
+    DeferredPublish req;
+
+    if (NULL == pClient->deferred_pub.seq) {
+        return;
+    }
+
+    while (RINGBUFF_OK == mpsc_ring_peek(&pClient->deferred_pub, &req)) {
+        mpsc_ring_pop(&pClient->deferred_pub);
+        if (NULL != req.on_complete) {
+            req.on_complete(pClient, 0, MQTT_EVENT_CLIENT_DESTROY, req.user_data);
+        }
+    }
+
+    mpsc_ring_deinit(&pClient->deferred_pub);
+}
+
+int qcloud_iot_mqtt_publish_deferred(Qcloud_IoT_Client *pClient, char *topicName, PublishParams *pParams,
+                                     OnPublishCompleteHandler on_complete, void *user_data)
+{
+    IOT_FUNC_ENTRY;
+
+    POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
+    STRING_PTR_SANITY_CHECK(topicName, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(pParams, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(pParams->payload, QCLOUD_ERR_INVAL);
+
+    DeferredPublish req;
+
+    if (strlen(topicName) > MAX_SIZE_OF_CLOUD_TOPIC) {
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_MAX_TOPIC_LENGTH);
+    }
+
+    if (pParams->qos == QOS2) {
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_MQTT_QOS_NOT_SUPPORT);
+    }
+
+    if (NULL == pClient->deferred_pub.seq) {
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
+    }
+
+    req.topic = topicName;
+    req.params = *pParams;
+    req.on_complete = on_complete;
+    req.user_data = user_data;
+
+    /* no lock is taken, caller may not afford to wait */
+    if (RINGBUFF_OK != mpsc_ring_push(&pClient->deferred_pub, &req)) {
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_MQTT_DEFERRED_FULL);
+    }
+
+    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+}
+
+/* the publish may go through later: room in inflight window or tx queue, offline queue replayed,
+ * or connection back by auto reconnect */
+static bool _deferred_retryable(Qcloud_IoT_Client *pClient, int rc)
+{
+    if (rc == QCLOUD_ERR_MQTT_INFLIGHT_FULL || rc == QCLOUD_ERR_MQTT_TX_QUEUE_FULL ||
+        rc == QCLOUD_ERR_MQTT_OFFLINE_PENDING) {
+        return true;
+    }
+
+    return rc == QCLOUD_ERR_MQTT_NO_CONN && pClient->options.auto_connect_enable &&
+           !pClient->was_manually_disconnected;
+}
+
+void qcloud_iot_mqtt_deferred_drain(Qcloud_IoT_Client *pClient)
+{
+    DeferredPublish req;
+    int i, rc;
+
+    if (NULL == pClient->deferred_pub.seq) {
+        return;
+    }
+
+    for (i = 0; i < QCLOUD_IOT_MQTT_DEFERRED_PUB_BATCH; i++) {
+        if (RINGBUFF_OK != mpsc_ring_peek(&pClient->deferred_pub, &req)) {
+            break;
+        }
+
+        rc = qcloud_iot_mqtt_publish_async(pClient, req.topic, &req.params, req.on_complete, req.user_data);
+        if (_deferred_retryable(pClient, rc)) {
+            if (!pClient->deferred_waiting) {
+                InitTimer(&pClient->deferred_timer);
+                countdown_ms(&pClient->deferred_timer, pClient->command_timeout_ms);
+                pClient->deferred_waiting = 1;
+            }
+            /* kept in ring and tried again by next yield, until command timeout */
+            if (!expired(&pClient->deferred_timer)) {
+                break;
+            }
+        }
+
+        mpsc_ring_pop(&pClient->deferred_pub);
+        pClient->deferred_waiting = 0;
+        if (rc < 0) {
+            Log_e("deferred publish to %s failed: %d", req.topic, rc);
+            if (NULL != req.on_complete) {
+                req.on_complete(pClient, 0, MQTT_EVENT_PUBLISH_FAIL, req.user_data);
+            }
+        }
+    }
+}
+
 #ifdef __cplusplus
 }
 #endif
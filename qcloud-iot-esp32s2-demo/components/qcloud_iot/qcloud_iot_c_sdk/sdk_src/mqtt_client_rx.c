@@ -0,0 +1,126 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdatomic.h>
+#include <string.h>
+
+#include "mqtt_client.h"
+
+#ifdef MULTITHREAD_ENABLED
+
+/*
+ * A reader task runs the yield loop for the client: it reads, deframes and dispatches inbound packets,
+ * and keeps the connection alive. Together with the writer task of mqtt_client_tx.c, threads of the
+ * application only serialize and queue outbound packets, they never wait for the socket.
+ */
+
+#define RX_TASK_ERROR_WAIT_MS       (1000)
+
+typedef struct {
+    void            *thread;
+    atomic_bool     running;                /* cleared to ask the task to leave its loop */
+} RxTask;
+
+static void *_rx_task(void *arg)
+{
+    Qcloud_IoT_Client *pClient = (Qcloud_IoT_Client *)arg;
+    RxTask *t = (RxTask *)pClient->rx_task;
+    int rc;
+
+    Log_d("mqtt rx task start ...");
+
+    while (atomic_load(&t->running)) {
+        rc = qcloud_iot_mqtt_yield(pClient, MQTT_RX_TASK_YIELD_MS);
+        if (QCLOUD_RET_SUCCESS == rc || QCLOUD_RET_MQTT_RECONNECTED == rc) {
+            continue;
+        }
+
+        /* yield returns at once when there is no connection, do not spin on it */
+        if (QCLOUD_ERR_MQTT_ATTEMPTING_RECONNECT != rc) {
+            Log_e("mqtt rx task yield failed: %d", rc);
+        }
+        HAL_SleepMs(QCLOUD_ERR_MQTT_ATTEMPTING_RECONNECT == rc ? 1 : RX_TASK_ERROR_WAIT_MS);
+    }
+
+    Log_d("mqtt rx task exit");
+
+    return NULL;
+}
+
+int qcloud_iot_mqtt_rx_start(Qcloud_IoT_Client *pClient, int priority)
+{
+    IOT_FUNC_ENTRY;
+
+    POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
+
+    RxTask *t;
+
+    if (NULL != pClient->rx_task) {
+        IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+    }
+
+    t = (RxTask *)HAL_Malloc(sizeof(RxTask));
+    if (NULL == t) {
+        Log_e("malloc mqtt rx task failed");
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_MALLOC);
+    }
+    memset(t, 0, sizeof(RxTask));
+
+    atomic_init(&t->running, true);
+    pClient->rx_task = t;
+
+    t->thread = HAL_ThreadCreate(MQTT_RX_TASK_STACK_SIZE, priority, "mqtt_rx_task", _rx_task, pClient);
+    if (NULL == t->thread) {
+        Log_e("create mqtt rx task failed");
+        pClient->rx_task = NULL;
+        HAL_Free(t);
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
+    }
+
+    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+}
+
+int qcloud_iot_mqtt_rx_stop(Qcloud_IoT_Client *pClient)
+{
+    RxTask *t = (RxTask *)pClient->rx_task;
+
+    if (NULL == t) {
+        return QCLOUD_RET_SUCCESS;
+    }
+
+    /* the task finishes the yield in progress, which may be reconnecting, and returns */
+    atomic_store(&t->running, false);
+
+    if (QCLOUD_RET_SUCCESS != HAL_ThreadJoin(t->thread, MQTT_RX_TASK_YIELD_MS + 2 * pClient->command_timeout_ms)) {
+        /* the task still uses the client, it is joined by the next stop */
+        Log_e("mqtt rx task not exited in time");
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    pClient->rx_task = NULL;
+    HAL_Free(t);
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -22,19 +22,28 @@ extern "C" {
 
 #include "mqtt_client.h"
 
+/* topics of SUBSCRIBE packets sent during resubscription */
+typedef struct {
+    Qcloud_IoT_Client *client;
+    uint16_t           count;
+    uint32_t           rem_len;
+    int                rc;
+    SubTopicHandle     handles[MAX_TOPICS_PER_SUBSCRIBE];
+} ResubscribeBatch;
+
 /**
   * Determines the length of the MQTT subscribe packet that would be produced using the supplied parameters
-  * @param count the number of topic filter strings in topicFilters
-  * @param topicFilters the array of topic filter strings to be used in the publish
+  * @param count the number of topic filters in handles
+  * @param handles the array of topic handles to be used in the subscribe
   * @return the length of buffer needed to contain the serialized version of the packet
   */
-static uint32_t _get_subscribe_packet_rem_len(uint32_t count, char **topicFilters)
+static uint32_t _get_subscribe_packet_rem_len(uint32_t count, SubTopicHandle *handles)
 {
     size_t i;
     size_t len = 2; /* packetid */
 
     for (i = 0; i < count; ++i) {
-        len += 2 + strlen(*topicFilters + i) + 1; /* length + topic + req_qos */
+        len += 2 + strlen(handles[i].topic_filter) + 1; /* length + topic + req_qos */
     }
 
     return (uint32_t) len;
@@ -46,17 +55,17 @@ static uint32_t _get_subscribe_packet_rem_len(uint32_t count, char **topicFilter
   * @param buf_len the length in bytes of the supplied bufferr
   * @param dup integer - the MQTT dup flag
   * @param packet_id integer - the MQTT packet identifier
-  * @param count - number of members in the topicFilters and reqQos arrays
-  * @param topicFilters - array of topic filter names
-  * @param requestedQoSs - array of requested QoS
+  * @param count - number of members in the handles array
+  * @param handles - array of topic handles, with topic filter name and requested QoS
   * @return the length of the serialized data.  <= 0 indicates error
   */
 static int _serialize_subscribe_packet(unsigned char *buf, size_t buf_len, uint8_t dup, uint16_t packet_id, uint32_t count,
-                                       char **topicFilters, QoS *requestedQoSs, uint32_t *serialized_len)
+                                       SubTopicHandle *handles, uint32_t *serialized_len)
 {
     IOT_FUNC_ENTRY;
 
     POINTER_SANITY_CHECK(buf, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(handles, QCLOUD_ERR_INVAL);
     POINTER_SANITY_CHECK(serialized_len, QCLOUD_ERR_INVAL);
 
     unsigned char *ptr = buf;
@@ -66,7 +75,7 @@ static int _serialize_subscribe_packet(unsigned char *buf, size_t buf_len, uint8
     int rc;
 
     // remaining length of SUBSCRIBE packet = packet type(2 byte) + count * (remaining length(2 byte) + topicLen + qos(1 byte))
-    rem_len = _get_subscribe_packet_rem_len(count, topicFilters);
+    rem_len = _get_subscribe_packet_rem_len(count, handles);
     if (get_mqtt_packet_len(rem_len) > buf_len) {
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_BUF_TOO_SHORT);
     }
@@ -83,8 +92,8 @@ static int _serialize_subscribe_packet(unsigned char *buf, size_t buf_len, uint8
     mqtt_write_uint_16(&ptr, packet_id);
     // payload
     for (i = 0; i < count; ++i) {
-        mqtt_write_utf8_string(&ptr, *topicFilters + i);
-        mqtt_write_char(&ptr, (unsigned char) requestedQoSs[i]);
+        mqtt_write_utf8_string(&ptr, (char *)handles[i].topic_filter);
+        mqtt_write_char(&ptr, (unsigned char) handles[i].qos);
     }
 
     *serialized_len = (uint32_t) (ptr - buf);
@@ -92,6 +101,68 @@ static int _serialize_subscribe_packet(unsigned char *buf, size_t buf_len, uint8
     IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
 }
 
+/**
+  * Send one SUBSCRIBE packet carrying all the handles, and add it into sub ack wait list
+  * Topic filters of handles are owned by the wait list on success, and freed on failure
+  * @return packet id of SUBSCRIBE packet, or err code for failure
+  */
+static int _send_subscribe_packet(Qcloud_IoT_Client *pClient, SubTopicHandle *handles, uint16_t count)
+{
+    IOT_FUNC_ENTRY;
+
+    Timer timer;
+    uint32_t len = 0;
+    uint16_t packet_id = 0;
+    uint16_t i;
+    int rc;
+
+    ListNode *node = NULL;
+
+    InitTimer(&timer);
+    countdown_ms(&timer, pClient->command_timeout_ms);
+
+    HAL_MutexLock(pClient->lock_write_buf);
+    packet_id = get_next_packet_id(pClient);
+    Log_d("topicName=%s|count=%u|packet_id=%d", handles[0].topic_filter, count, packet_id);
+
+    rc = _serialize_subscribe_packet(pClient->write_buf, pClient->write_buf_size, 0, packet_id, count, handles, &len);
+    if (QCLOUD_RET_SUCCESS != rc) {
+        HAL_MutexUnlock(pClient->lock_write_buf);
+        goto exit;
+    }
+
+    /* add node into sub ack wait list */
+    rc = push_sub_info_to(pClient, len, (unsigned int)packet_id, SUBSCRIBE, handles, count, &node);
+    if (QCLOUD_RET_SUCCESS != rc) {
+        Log_e("push publish into to pubInfolist failed!");
+        HAL_MutexUnlock(pClient->lock_write_buf);
+        goto exit;
+    }
+
+    // send SUBSCRIBE packet
+    rc = send_mqtt_packet(pClient, len, &timer);
+    if (QCLOUD_RET_SUCCESS != rc) {
+        HAL_MutexLock(pClient->lock_list_sub);
+        timer_wheel_del(&pClient->timer_wheel, &((QcloudIotSubInfo *)node->val)->timer_entry);
+        list_remove(pClient->list_sub_wait_ack, node);
+        HAL_MutexUnlock(pClient->lock_list_sub);
+
+        HAL_MutexUnlock(pClient->lock_write_buf);
+        goto exit;
+    }
+
+    HAL_MutexUnlock(pClient->lock_write_buf);
+
+    IOT_FUNC_EXIT_RC(packet_id);
+
+exit:
+    for (i = 0; i < count; i++) {
+        HAL_Free((void *)handles[i].topic_filter);
+    }
+
+    IOT_FUNC_EXIT_RC(rc);
+}
+
 int qcloud_iot_mqtt_subscribe(Qcloud_IoT_Client *pClient, char *topicFilter, SubscribeParams *pParams)
 {
 
@@ -103,12 +174,6 @@ int qcloud_iot_mqtt_subscribe(Qcloud_IoT_Client *pClient, char *topicFilter, Sub
     // POINTER_SANITY_CHECK(pParams->on_message_handler, QCLOUD_ERR_INVAL);
     STRING_PTR_SANITY_CHECK(topicFilter, QCLOUD_ERR_INVAL);
 
-    Timer timer;
-    uint32_t len = 0;
-    uint16_t packet_id = 0;
-
-    ListNode *node = NULL;
-
     size_t topicLen = strlen(topicFilter);
     if (topicLen > MAX_SIZE_OF_CLOUD_TOPIC) {
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_MAX_TOPIC_LENGTH);
@@ -133,91 +198,147 @@ int qcloud_iot_mqtt_subscribe(Qcloud_IoT_Client *pClient, char *topicFilter, Sub
     strcpy(topic_filter_stored, topicFilter);
     topic_filter_stored[topicLen] = 0;
 
-    InitTimer(&timer);
-    countdown_ms(&timer, pClient->command_timeout_ms);
-
-    HAL_MutexLock(pClient->lock_write_buf);
-    packet_id = get_next_packet_id(pClient);
-    Log_d("topicName=%s|packet_id=%d", topic_filter_stored, packet_id);
-
-    rc = _serialize_subscribe_packet(pClient->write_buf, pClient->write_buf_size, 0, packet_id, 1, &topic_filter_stored,
-                                     &pParams->qos, &len);
-    if (QCLOUD_RET_SUCCESS != rc) {
-        HAL_MutexUnlock(pClient->lock_write_buf);
-        HAL_Free(topic_filter_stored);
-        IOT_FUNC_EXIT_RC(rc);
-    }
-
-    /* add node into sub ack wait list */
     SubTopicHandle sub_handle;
     sub_handle.topic_filter = topic_filter_stored;
     sub_handle.message_handler = pParams->on_message_handler;
+    sub_handle.message_chunk_handler = pParams->on_message_chunk_handler;
     sub_handle.sub_event_handler = pParams->on_sub_event_handler;
     sub_handle.qos = pParams->qos;
     sub_handle.handler_user_data = pParams->user_data;
 
-    rc = push_sub_info_to(pClient, len, (unsigned int)packet_id, SUBSCRIBE, &sub_handle, &node);
-    if (QCLOUD_RET_SUCCESS != rc) {
-        Log_e("push publish into to pubInfolist failed!");
-        HAL_MutexUnlock(pClient->lock_write_buf);
-        HAL_Free(topic_filter_stored);
-        IOT_FUNC_EXIT_RC(rc);
+    rc = _send_subscribe_packet(pClient, &sub_handle, 1);
+
+    IOT_FUNC_EXIT_RC(rc);
+}
+
+static int _resubscribe_flush(ResubscribeBatch *batch)
+{
+    int rc;
+
+    if (0 == batch->count) {
+        return 0;
     }
 
-    // send SUBSCRIBE packet
-    rc = send_mqtt_packet(pClient, len, &timer);
-    if (QCLOUD_RET_SUCCESS != rc) {
-        HAL_MutexLock(pClient->lock_list_sub);
-        list_remove(pClient->list_sub_wait_ack, node);
-        HAL_MutexUnlock(pClient->lock_list_sub);
+    rc = _send_subscribe_packet(batch->client, batch->handles, batch->count);
+    if (rc < 0) {
+        Log_e("resubscribe failed %d, %u topics from: %s", rc, batch->count, batch->handles[0].topic_filter);
+        batch->rc = rc;
+    }
 
-        HAL_MutexUnlock(pClient->lock_write_buf);
-        HAL_Free(topic_filter_stored);
-        IOT_FUNC_EXIT_RC(rc);
+    batch->count = 0;
+    batch->rem_len = 2; /* packetid */
+
+    return rc < 0 ? rc : 0;
+}
+
+/* copies of subscription handles taken under lock_generic, so no network IO happens with the trie locked */
+typedef struct {
+    SubTopicHandle *handles;
+    uint32_t        count;
+    uint32_t        size;
+    int             rc;
+} ResubscribeSnapshot;
+
+static int _snapshot_handle(SubTopicHandle *handle, void *user)
+{
+    ResubscribeSnapshot *snapshot = (ResubscribeSnapshot *)user;
+    size_t topic_len = strlen(handle->topic_filter);
+    char *topic_filter_stored;
+
+    if (snapshot->count >= snapshot->size) {
+        return 1;
     }
 
-    HAL_MutexUnlock(pClient->lock_write_buf);
+    /* handle in trie is kept until SUBACK, the wait list needs its own copy of topic filter */
+    topic_filter_stored = HAL_Malloc(topic_len + 1);
+    if (NULL == topic_filter_stored) {
+        Log_e("malloc failed, topic: %s", handle->topic_filter);
+        snapshot->rc = QCLOUD_ERR_MALLOC;
+        return 1;
+    }
+    memcpy(topic_filter_stored, handle->topic_filter, topic_len + 1);
 
-    IOT_FUNC_EXIT_RC(packet_id);
+    snapshot->handles[snapshot->count] = *handle;
+    snapshot->handles[snapshot->count].topic_filter = topic_filter_stored;
+    snapshot->count++;
+
+    return 0;
+}
+
+/* topic_filter of handle is owned by batch from now on */
+static void _resubscribe_add(ResubscribeBatch *batch, SubTopicHandle *handle)
+{
+    uint32_t entry_len = 2 + strlen(handle->topic_filter) + 1; /* length + topic + req_qos */
+
+    /* send the pending topics first if this one does not fit into the same packet */
+    if (batch->count >= MAX_TOPICS_PER_SUBSCRIBE ||
+        (batch->count > 0 && get_mqtt_packet_len(batch->rem_len + entry_len) > batch->client->write_buf_size)) {
+        _resubscribe_flush(batch);
+    }
+
+    batch->handles[batch->count] = *handle;
+    batch->count++;
+    batch->rem_len += entry_len;
 }
 
 int qcloud_iot_mqtt_resubscribe(Qcloud_IoT_Client *pClient)
 {
     IOT_FUNC_ENTRY;
     int rc;
+    uint32_t i;
+    ResubscribeSnapshot snapshot = {NULL, 0, 0, QCLOUD_RET_SUCCESS};
 
     POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
 
-    uint32_t itr = 0;
-    char *topic = NULL;
-    SubscribeParams temp_param;
+    if (!get_client_conn_state(pClient)) {
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_MQTT_NO_CONN);
+    }
 
-    if (NULL == pClient) {
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_INVAL);
+    ResubscribeBatch *batch = (ResubscribeBatch *)HAL_Malloc(sizeof(ResubscribeBatch));
+    if (NULL == batch) {
+        Log_e("malloc failed");
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_MALLOC);
     }
 
-    if (!get_client_conn_state(pClient)) {
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_MQTT_NO_CONN);
+    batch->client = pClient;
+    batch->count = 0;
+    batch->rem_len = 2; /* packetid */
+    batch->rc = QCLOUD_RET_SUCCESS;
+
+    /* the trie may be changed by SUBACK/unsubscribe of other threads, walk it locked and send from the copy */
+    HAL_MutexLock(pClient->lock_generic);
+    snapshot.size = pClient->sub_trie.handle_count;
+    if (snapshot.size > 0) {
+        snapshot.handles = (SubTopicHandle *)HAL_Malloc(snapshot.size * sizeof(SubTopicHandle));
+        if (NULL == snapshot.handles) {
+            snapshot.rc = QCLOUD_ERR_MALLOC;
+        } else {
+            topic_trie_foreach(&pClient->sub_trie, _snapshot_handle, &snapshot);
+        }
     }
+    HAL_MutexUnlock(pClient->lock_generic);
 
-    for (itr = 0; itr < MAX_MESSAGE_HANDLERS; itr++) {
-        topic = (char *) pClient->sub_handles[itr].topic_filter;
-        if (topic == NULL) {
-            continue;
+    rc = snapshot.rc;
+    if (QCLOUD_RET_SUCCESS == rc) {
+        /* topics are packed into as few SUBSCRIBE packets as write_buf allows */
+        for (i = 0; i < snapshot.count; i++) {
+            _resubscribe_add(batch, &snapshot.handles[i]);
         }
-        temp_param.on_message_handler = pClient->sub_handles[itr].message_handler;
-        temp_param.on_sub_event_handler = pClient->sub_handles[itr].sub_event_handler;
-        temp_param.qos = pClient->sub_handles[itr].qos;
-        temp_param.user_data = pClient->sub_handles[itr].handler_user_data;
-
-        rc = qcloud_iot_mqtt_subscribe(pClient, topic, &temp_param);
-        if (rc < 0) {
-            Log_e("resubscribe failed %d, topic: %s", rc, topic);
-            IOT_FUNC_EXIT_RC(rc);
+        _resubscribe_flush(batch);
+        rc = batch->rc;
+    } else {
+        Log_e("malloc failed, %u topics not resubscribed", snapshot.size);
+        for (i = 0; i < snapshot.count; i++) {
+            HAL_Free((void *)snapshot.handles[i].topic_filter);
         }
     }
 
-    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+    if (snapshot.handles) {
+        HAL_Free(snapshot.handles);
+    }
+    HAL_Free(batch);
+
+    IOT_FUNC_EXIT_RC(rc);
 }
 
 #ifdef __cplusplus
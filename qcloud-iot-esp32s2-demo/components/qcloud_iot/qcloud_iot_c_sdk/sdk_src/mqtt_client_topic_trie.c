@@ -0,0 +1,481 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "mqtt_client_topic_trie.h"
+
+#include "qcloud_iot_import.h"
+#include "qcloud_iot_export_error.h"
+#include "qcloud_iot_export_log.h"
+#include "utils_param_check.h"
+
+/* initial capacity of literal child array */
+#define TOPIC_TRIE_MIN_CHILD_CAP        (4)
+
+typedef struct TopicTrieHandle {
+    struct TopicTrieHandle  *next;
+    uint32_t                seq;            // subscribe order, smaller is earlier
+    SubTopicHandle          handle;
+} TopicTrieHandle;
+
+struct TopicTrieNode {
+    TopicTrieNode           *parent;
+    TopicTrieNode           **children;     // literal levels, sorted by level name
+    uint16_t                child_num;
+    uint16_t                child_cap;
+    TopicTrieNode           *plus_child;    // level of single-level wildcard '+'
+    TopicTrieNode           *hash_child;    // level of multi-level wildcard '#'
+    TopicTrieHandle         *handles;       // handles subscribed with filter ending at this node
+    uint16_t                level_len;
+    char                    *level;         // level name, NOT NULL terminated
+};
+
+static int _level_cmp(const char *a, size_t a_len, const char *b, size_t b_len)
+{
+    int rc = memcmp(a, b, a_len < b_len ? a_len : b_len);
+    if (rc != 0) {
+        return rc;
+    }
+
+    return (a_len < b_len) ? -1 : ((a_len > b_len) ? 1 : 0);
+}
+
+/* return the position of child in sorted array, or the position to insert it if not found */
+static int _find_child_pos(TopicTrieNode *node, const char *level, size_t level_len, bool *found)
+{
+    int low = 0, high = (int)node->child_num - 1, mid, rc;
+
+    *found = false;
+    while (low <= high) {
+        mid = (low + high) / 2;
+        rc = _level_cmp(node->children[mid]->level, node->children[mid]->level_len, level, level_len);
+        if (rc == 0) {
+            *found = true;
+            return mid;
+        } else if (rc < 0) {
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    return low;
+}
+
+static TopicTrieNode *_find_child(TopicTrieNode *node, const char *level, size_t level_len)
+{
+    bool found;
+    int pos;
+
+    if (0 == node->child_num) {
+        return NULL;
+    }
+
+    pos = _find_child_pos(node, level, level_len, &found);
+    return found ? node->children[pos] : NULL;
+}
+
+static TopicTrieNode *_new_node(TopicTrieNode *parent, const char *level, size_t level_len)
+{
+    TopicTrieNode *node = (TopicTrieNode *)HAL_Malloc(sizeof(TopicTrieNode) + level_len);
+    if (NULL == node) {
+        return NULL;
+    }
+
+    memset(node, 0, sizeof(TopicTrieNode));
+    node->parent = parent;
+    node->level_len = (uint16_t)level_len;
+    node->level = (char *)(node + 1);
+    memcpy(node->level, level, level_len);
+
+    return node;
+}
+
+static TopicTrieNode *_get_or_add_child(TopicTrieNode *node, const char *level, size_t level_len)
+{
+    TopicTrieNode *child;
+    bool found;
+    int pos;
+
+    if (1 == level_len && '+' == level[0]) {
+        if (NULL == node->plus_child) {
+            node->plus_child = _new_node(node, level, level_len);
+        }
+        return node->plus_child;
+    }
+
+    if (1 == level_len && '#' == level[0]) {
+        if (NULL == node->hash_child) {
+            node->hash_child = _new_node(node, level, level_len);
+        }
+        return node->hash_child;
+    }
+
+    pos = _find_child_pos(node, level, level_len, &found);
+    if (found) {
+        return node->children[pos];
+    }
+
+    if (node->child_num == node->child_cap) {
+        uint16_t new_cap = node->child_cap ? node->child_cap * 2 : TOPIC_TRIE_MIN_CHILD_CAP;
+        TopicTrieNode **new_children = (TopicTrieNode **)HAL_Malloc(new_cap * sizeof(TopicTrieNode *));
+        if (NULL == new_children) {
+            return NULL;
+        }
+
+        if (node->children) {
+            memcpy(new_children, node->children, node->child_num * sizeof(TopicTrieNode *));
+            HAL_Free(node->children);
+        }
+        node->children = new_children;
+        node->child_cap = new_cap;
+    }
+
+    child = _new_node(node, level, level_len);
+    if (NULL == child) {
+        return NULL;
+    }
+
+    memmove(&node->children[pos + 1], &node->children[pos], (node->child_num - pos) * sizeof(TopicTrieNode *));
+    node->children[pos] = child;
+    node->child_num++;
+
+    return child;
+}
+
+static bool _node_is_empty(TopicTrieNode *node)
+{
+    return (NULL == node->handles && 0 == node->child_num && NULL == node->plus_child && NULL == node->hash_child);
+}
+
+/* free the empty nodes from node up to root */
+static void _prune(TopicTrieNode *node)
+{
+    TopicTrieNode *parent;
+    bool found;
+    int pos;
+
+    while (NULL != node->parent && _node_is_empty(node)) {
+        parent = node->parent;
+
+        if (parent->plus_child == node) {
+            parent->plus_child = NULL;
+        } else if (parent->hash_child == node) {
+            parent->hash_child = NULL;
+        } else {
+            pos = _find_child_pos(parent, node->level, node->level_len, &found);
+            if (found) {
+                parent->child_num--;
+                memmove(&parent->children[pos], &parent->children[pos + 1],
+                        (parent->child_num - pos) * sizeof(TopicTrieNode *));
+            }
+
+            if (0 == parent->child_num) {
+                HAL_Free(parent->children);
+                parent->children = NULL;
+                parent->child_cap = 0;
+            }
+        }
+
+        HAL_Free(node);
+        node = parent;
+    }
+}
+
+/* find the node of topic filter, levels are compared literally */
+static TopicTrieNode *_find_filter_node(TopicTrie *trie, const char *topic_filter)
+{
+    TopicTrieNode *node = trie->root;
+    const char *pos = topic_filter;
+    const char *end;
+
+    for (;;) {
+        end = strchr(pos, '/');
+        if (NULL == end) {
+            end = pos + strlen(pos);
+        }
+
+        if (1 == end - pos && '+' == *pos) {
+            node = node->plus_child;
+        } else if (1 == end - pos && '#' == *pos) {
+            node = node->hash_child;
+        } else {
+            node = _find_child(node, pos, end - pos);
+        }
+
+        if (NULL == node || '\0' == *end) {
+            return node;
+        }
+
+        pos = end + 1;
+    }
+}
+
+static void _pick_handle(TopicTrieHandle *handles, TopicTrieHandle **best)
+{
+    for (; NULL != handles; handles = handles->next) {
+        if ((NULL != handles->handle.message_handler || NULL != handles->handle.message_chunk_handler) &&
+            (NULL == *best || handles->seq < (*best)->seq)) {
+            *best = handles;
+        }
+    }
+}
+
+/* match the levels of topic from pos, pos beyond topic_len means all levels are matched */
+static void _match_node(TopicTrieNode *node, const char *topic, size_t topic_len, size_t pos, TopicTrieHandle **best)
+{
+    TopicTrieNode *child;
+    size_t end;
+
+    // '#' also matches the parent level
+    if (NULL != node->hash_child) {
+        _pick_handle(node->hash_child->handles, best);
+    }
+
+    if (pos > topic_len) {
+        _pick_handle(node->handles, best);
+        return;
+    }
+
+    for (end = pos; end < topic_len && topic[end] != '/'; end++);
+
+    child = _find_child(node, topic + pos, end - pos);
+    if (NULL != child) {
+        _match_node(child, topic, topic_len, end + 1, best);
+    }
+
+    if (NULL != node->plus_child) {
+        _match_node(node->plus_child, topic, topic_len, end + 1, best);
+    }
+}
+
+static void _free_handles(TopicTrie *trie, TopicTrieNode *node, TopicTrieVisitor on_remove, void *user_data)
+{
+    TopicTrieHandle *item;
+
+    while (NULL != (item = node->handles)) {
+        node->handles = item->next;
+
+        if (NULL != on_remove) {
+            on_remove(&item->handle, user_data);
+        }
+        HAL_Free((void *)item->handle.topic_filter);
+        HAL_Free(item);
+        trie->handle_count--;
+    }
+}
+
+static int _foreach_node(TopicTrieNode *node, TopicTrieVisitor visitor, void *user_data)
+{
+    TopicTrieHandle *item;
+    uint16_t i;
+    int rc;
+
+    for (item = node->handles; NULL != item; item = item->next) {
+        if (0 != (rc = visitor(&item->handle, user_data))) {
+            return rc;
+        }
+    }
+
+    for (i = 0; i < node->child_num; i++) {
+        if (0 != (rc = _foreach_node(node->children[i], visitor, user_data))) {
+            return rc;
+        }
+    }
+
+    if (NULL != node->plus_child && 0 != (rc = _foreach_node(node->plus_child, visitor, user_data))) {
+        return rc;
+    }
+
+    if (NULL != node->hash_child && 0 != (rc = _foreach_node(node->hash_child, visitor, user_data))) {
+        return rc;
+    }
+
+    return 0;
+}
+
+static void _destroy_node(TopicTrie *trie, TopicTrieNode *node, TopicTrieVisitor on_remove, void *user_data)
+{
+    uint16_t i;
+
+    _free_handles(trie, node, on_remove, user_data);
+
+    for (i = 0; i < node->child_num; i++) {
+        _destroy_node(trie, node->children[i], on_remove, user_data);
+    }
+
+    if (NULL != node->plus_child) {
+        _destroy_node(trie, node->plus_child, on_remove, user_data);
+    }
+
+    if (NULL != node->hash_child) {
+        _destroy_node(trie, node->hash_child, on_remove, user_data);
+    }
+
+    HAL_Free(node->children);
+    HAL_Free(node);
+}
+
+int topic_trie_init(TopicTrie *trie)
+{
+    POINTER_SANITY_CHECK(trie, QCLOUD_ERR_INVAL);
+
+    memset(trie, 0, sizeof(TopicTrie));
+    trie->root = _new_node(NULL, "", 0);
+    if (NULL == trie->root) {
+        Log_e("malloc topic trie root failed");
+        return QCLOUD_ERR_MALLOC;
+    }
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+void topic_trie_deinit(TopicTrie *trie, TopicTrieVisitor on_remove, void *user_data)
+{
+    if (NULL == trie || NULL == trie->root) {
+        return;
+    }
+
+    _destroy_node(trie, trie->root, on_remove, user_data);
+    trie->root = NULL;
+}
+
+int topic_trie_insert(TopicTrie *trie, SubTopicHandle *handle)
+{
+    TopicTrieNode *node, *parent;
+    TopicTrieHandle *item, **tail;
+    const char *pos, *end;
+
+    POINTER_SANITY_CHECK(trie, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(trie->root, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(handle, QCLOUD_ERR_INVAL);
+    STRING_PTR_SANITY_CHECK(handle->topic_filter, QCLOUD_ERR_INVAL);
+
+    node = trie->root;
+    pos = handle->topic_filter;
+    for (;;) {
+        end = strchr(pos, '/');
+        if (NULL == end) {
+            end = pos + strlen(pos);
+        }
+
+        // '#' must be the last level
+        if (NULL != node->parent && node == node->parent->hash_child) {
+            _prune(node);
+            Log_e("invalid topic filter: %s", handle->topic_filter);
+            return QCLOUD_ERR_INVAL;
+        }
+
+        parent = node;
+        if (end - pos > UINT16_MAX || NULL == (node = _get_or_add_child(parent, pos, end - pos))) {
+            // release the nodes created for this filter
+            _prune(parent);
+            Log_e("malloc topic trie node failed");
+            return QCLOUD_ERR_MALLOC;
+        }
+
+        if ('\0' == *end) {
+            break;
+        }
+        pos = end + 1;
+    }
+
+    for (tail = &node->handles; NULL != *tail; tail = &(*tail)->next) {
+        item = *tail;
+        if (item->handle.message_handler == handle->message_handler &&
+            item->handle.message_chunk_handler == handle->message_chunk_handler &&
+            item->handle.sub_event_handler == handle->sub_event_handler) {
+            Log_w("Identical topic found: %s", handle->topic_filter);
+            if (item->handle.handler_user_data != handle->handler_user_data) {
+                Log_w("Update handler_user_data %p -> %p!", item->handle.handler_user_data, handle->handler_user_data);
+                item->handle.handler_user_data = handle->handler_user_data;
+            }
+            HAL_Free((void *)handle->topic_filter);
+            handle->topic_filter = NULL;
+            return 1;
+        }
+    }
+
+    item = (TopicTrieHandle *)HAL_Malloc(sizeof(TopicTrieHandle));
+    if (NULL == item) {
+        _prune(node);
+        Log_e("malloc topic trie handle failed");
+        return QCLOUD_ERR_MALLOC;
+    }
+
+    item->next = NULL;
+    item->seq = trie->next_seq++;
+    item->handle = *handle;
+    *tail = item;
+    trie->handle_count++;
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+int topic_trie_remove(TopicTrie *trie, const char *topic_filter, TopicTrieVisitor on_remove, void *user_data)
+{
+    TopicTrieNode *node;
+    uint32_t count;
+
+    if (NULL == trie || NULL == trie->root || NULL == topic_filter) {
+        return 0;
+    }
+
+    node = _find_filter_node(trie, topic_filter);
+    if (NULL == node || NULL == node->handles) {
+        return 0;
+    }
+
+    count = trie->handle_count;
+    _free_handles(trie, node, on_remove, user_data);
+    _prune(node);
+
+    return (int)(count - trie->handle_count);
+}
+
+bool topic_trie_match(TopicTrie *trie, const char *topic, size_t topic_len, SubTopicHandle *handle)
+{
+    TopicTrieHandle *best = NULL;
+
+    if (NULL == trie || NULL == trie->root || NULL == topic || NULL == handle) {
+        return false;
+    }
+
+    _match_node(trie->root, topic, topic_len, 0, &best);
+    if (NULL == best) {
+        return false;
+    }
+
+    *handle = best->handle;
+    return true;
+}
+
+int topic_trie_foreach(TopicTrie *trie, TopicTrieVisitor visitor, void *user_data)
+{
+    if (NULL == trie || NULL == trie->root || NULL == visitor) {
+        return 0;
+    }
+
+    return _foreach_node(trie->root, visitor, user_data);
+}
+
+#ifdef __cplusplus
+}
+#endif
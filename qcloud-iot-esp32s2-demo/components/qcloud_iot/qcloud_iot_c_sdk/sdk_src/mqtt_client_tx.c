@@ -0,0 +1,420 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdatomic.h>
+#include <string.h>
+
+#include "mqtt_client.h"
+
+#ifdef MULTITHREAD_ENABLED
+
+/*
+ * In dual-task mode the thread calling IOT_MQTT_Yield only reads and dispatches inbound packets,
+ * and a writer task owns the socket for writing. Other threads (and ACKs from the reader) serialize
+ * into write_buf as before, but the packet is copied into a FIFO instead of being written in place,
+ * so lock_write_buf is held for serialization only and never across a network write.
+ * Senders hold lock_write_buf while they use the queue, so the queue is started and stopped under it.
+ */
+
+#define TX_TASK_STOP_WAIT_MS        (1000)    /* on top of command_timeout_ms of the write in progress */
+#define TX_TASK_IDLE_WAIT_MS        (200)
+
+typedef struct _TxPacket {
+    struct _TxPacket    *next;
+    size_t              len;
+    unsigned char       data[1];
+} TxPacket;
+
+typedef struct {
+    void            *lock;                  /* for packet FIFO */
+    void            *lock_socket;           /* held by writer task while writing network */
+    void            *sem;                   /* posted once for each packet queued */
+    void            *thread;
+
+    TxPacket        *head;
+    TxPacket        *tail;
+    size_t          bytes;                  /* bytes of packets queued */
+
+    atomic_bool     running;                /* writer task is accepting packets, changed with lock_write_buf */
+    volatile bool   write_failed;           /* network write failed, connection to be dropped by reader */
+} TxQueue;
+
+static TxPacket *_pop_packet(TxQueue *q)
+{
+    TxPacket *pkt;
+
+    HAL_MutexLock(q->lock);
+    pkt = q->head;
+    if (NULL != pkt) {
+        q->head = pkt->next;
+        if (NULL == q->head) {
+            q->tail = NULL;
+        }
+        q->bytes -= pkt->len;
+    }
+    HAL_MutexUnlock(q->lock);
+
+    return pkt;
+}
+
+/* called with lock_socket, packets of a connection already dropped are discarded */
+static int _write_locked(Qcloud_IoT_Client *pClient, TxQueue *q, const NetIoVec *iov, int iovcnt)
+{
+    Timer timer;
+    int rc;
+
+    if (q->write_failed || !get_client_conn_state(pClient)) {
+        return QCLOUD_ERR_MQTT_NO_CONN;
+    }
+
+    InitTimer(&timer);
+    countdown_ms(&timer, pClient->command_timeout_ms);
+
+    rc = write_mqtt_packet_vec(pClient, iov, iovcnt, &timer);
+    if (QCLOUD_RET_SUCCESS != rc) {
+        Log_e("mqtt tx write failed: %d", rc);
+        q->write_failed = true;
+    }
+
+    return rc;
+}
+
+/* the packet is popped with lock_socket, so an empty queue means nothing is being written either */
+static bool _write_next(Qcloud_IoT_Client *pClient, TxQueue *q)
+{
+    TxPacket *pkt;
+    NetIoVec iov;
+
+    HAL_MutexLock(q->lock_socket);
+    pkt = _pop_packet(q);
+    if (NULL != pkt) {
+        iov.data = pkt->data;
+        iov.len = pkt->len;
+        _write_locked(pClient, q, &iov, 1);
+    }
+    HAL_MutexUnlock(q->lock_socket);
+
+    if (NULL == pkt) {
+        return false;
+    }
+    HAL_Free(pkt);
+
+    return true;
+}
+
+static void _drop_packets(TxQueue *q)
+{
+    TxPacket *pkt;
+
+    HAL_MutexLock(q->lock);
+    while (NULL != (pkt = q->head)) {
+        q->head = pkt->next;
+        HAL_Free(pkt);
+    }
+    q->tail = NULL;
+    q->bytes = 0;
+    HAL_MutexUnlock(q->lock);
+}
+
+static bool _is_empty(TxQueue *q)
+{
+    bool empty;
+
+    HAL_MutexLock(q->lock);
+    empty = (NULL == q->head);
+    HAL_MutexUnlock(q->lock);
+
+    return empty;
+}
+
+static void *_tx_task(void *arg)
+{
+    Qcloud_IoT_Client *pClient = (Qcloud_IoT_Client *)arg;
+    TxQueue *q = (TxQueue *)pClient->tx_queue;
+
+    Log_d("mqtt tx task start ...");
+
+    /* packets left when stopped are written by qcloud_iot_mqtt_tx_stop, or by the next sender */
+    while (atomic_load(&q->running)) {
+        /* wakes up for new packets, or periodically to check if stopped */
+        HAL_SemaphoreWait(q->sem, TX_TASK_IDLE_WAIT_MS);
+
+        while (atomic_load(&q->running) && _write_next(pClient, q)) {
+        }
+    }
+
+    Log_d("mqtt tx task exit");
+
+    return NULL;
+}
+
+int qcloud_iot_mqtt_tx_start(Qcloud_IoT_Client *pClient, int priority)
+{
+    IOT_FUNC_ENTRY;
+
+    POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
+
+    TxQueue *q;
+
+    HAL_MutexLock(pClient->lock_write_buf);
+    if (NULL != pClient->tx_queue) {
+        HAL_MutexUnlock(pClient->lock_write_buf);
+        IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+    }
+
+    q = (TxQueue *)HAL_Malloc(sizeof(TxQueue));
+    if (NULL == q) {
+        HAL_MutexUnlock(pClient->lock_write_buf);
+        Log_e("malloc mqtt tx queue failed");
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_MALLOC);
+    }
+    memset(q, 0, sizeof(TxQueue));
+
+    q->lock = HAL_MutexCreate();
+    q->lock_socket = HAL_MutexCreate();
+    q->sem = HAL_SemaphoreCreate();
+    if (NULL == q->lock || NULL == q->lock_socket || NULL == q->sem) {
+        Log_e("create mqtt tx queue lock failed");
+        goto error;
+    }
+
+    atomic_init(&q->running, true);
+    pClient->tx_queue = q;
+
+    q->thread = HAL_ThreadCreate(MQTT_TX_TASK_STACK_SIZE, priority, "mqtt_tx_task", _tx_task, pClient);
+    if (NULL == q->thread) {
+        Log_e("create mqtt tx task failed");
+        pClient->tx_queue = NULL;
+        goto error;
+    }
+    HAL_MutexUnlock(pClient->lock_write_buf);
+
+    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+
+error:
+    HAL_MutexUnlock(pClient->lock_write_buf);
+    if (NULL != q->sem) {
+        HAL_SemaphoreDestroy(q->sem);
+    }
+    if (NULL != q->lock_socket) {
+        HAL_MutexDestroy(q->lock_socket);
+    }
+    if (NULL != q->lock) {
+        HAL_MutexDestroy(q->lock);
+    }
+    HAL_Free(q);
+
+    IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
+}
+
+int qcloud_iot_mqtt_tx_stop(Qcloud_IoT_Client *pClient)
+{
+    TxQueue *q;
+
+    /* no sender uses the queue until it is freed, packets after that are written directly */
+    HAL_MutexLock(pClient->lock_write_buf);
+    q = (TxQueue *)pClient->tx_queue;
+    if (NULL == q) {
+        HAL_MutexUnlock(pClient->lock_write_buf);
+        return QCLOUD_RET_SUCCESS;
+    }
+
+    /* the task finishes the packet it is writing and returns */
+    atomic_store(&q->running, false);
+    HAL_SemaphorePost(q->sem);
+
+    if (QCLOUD_RET_SUCCESS != HAL_ThreadJoin(q->thread, pClient->command_timeout_ms + TX_TASK_STOP_WAIT_MS)) {
+        /* the queue stays, senders write after the packet in progress, see qcloud_iot_mqtt_tx_enqueue */
+        Log_e("mqtt tx task not exited in time");
+        HAL_MutexUnlock(pClient->lock_write_buf);
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    /* packets not written by the task go out in order, ahead of those written directly later */
+    while (_write_next(pClient, q)) {
+    }
+
+    pClient->tx_queue = NULL;
+    HAL_SemaphoreDestroy(q->sem);
+    HAL_MutexDestroy(q->lock_socket);
+    HAL_MutexDestroy(q->lock);
+    HAL_Free(q);
+    HAL_MutexUnlock(pClient->lock_write_buf);
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+bool qcloud_iot_mqtt_tx_active(Qcloud_IoT_Client *pClient)
+{
+    TxQueue *q = (TxQueue *)pClient->tx_queue;
+
+    /* CONNECT is written directly, as nothing else could be sent before connected */
+    return NULL != q && get_client_conn_state(pClient);
+}
+
+/* called with lock_write_buf, so no packet is queued while waiting */
+static int _write_direct(Qcloud_IoT_Client *pClient, TxQueue *q, const NetIoVec *iov, int iovcnt)
+{
+    Timer timer;
+    int rc;
+
+    InitTimer(&timer);
+    countdown_ms(&timer, pClient->command_timeout_ms);
+
+    HAL_MutexLock(q->lock_socket);
+    while (!_is_empty(q)) {
+        HAL_MutexUnlock(q->lock_socket);
+        if (expired(&timer)) {
+            Log_w("mqtt tx queue not drained for a large packet");
+            return QCLOUD_ERR_MQTT_TX_QUEUE_FULL;
+        }
+        HAL_SleepMs(1);
+        HAL_MutexLock(q->lock_socket);
+    }
+    rc = _write_locked(pClient, q, iov, iovcnt);
+    HAL_MutexUnlock(q->lock_socket);
+
+    return rc;
+}
+
+/* called with lock_write_buf after a stop timed out, the packets left by the task go out first */
+static int _write_after_queued(Qcloud_IoT_Client *pClient, TxQueue *q, const NetIoVec *iov, int iovcnt)
+{
+    int rc;
+
+    while (_write_next(pClient, q)) {
+    }
+
+    HAL_MutexLock(q->lock_socket);
+    rc = _write_locked(pClient, q, iov, iovcnt);
+    HAL_MutexUnlock(q->lock_socket);
+
+    return rc;
+}
+
+int qcloud_iot_mqtt_tx_enqueue(Qcloud_IoT_Client *pClient, const NetIoVec *iov, int iovcnt)
+{
+    IOT_FUNC_ENTRY;
+
+    TxQueue *q = (TxQueue *)pClient->tx_queue;
+    TxPacket *pkt;
+    size_t len = 0, off = 0;
+    int i;
+
+    /* the task is not joined yet, it writes no more packets once the one in progress is out */
+    if (!atomic_load(&q->running)) {
+        IOT_FUNC_EXIT_RC(_write_after_queued(pClient, q, iov, iovcnt));
+    }
+
+    for (i = 0; i < iovcnt; i++) {
+        len += iov[i].len;
+    }
+
+    /* it would never fit in the queue, write it in place once the packets ahead of it are out */
+    if (len > MQTT_TX_QUEUE_MAX_BYTES) {
+        IOT_FUNC_EXIT_RC(_write_direct(pClient, q, iov, iovcnt));
+    }
+
+    HAL_MutexLock(q->lock);
+    if (q->bytes + len > MQTT_TX_QUEUE_MAX_BYTES) {
+        HAL_MutexUnlock(q->lock);
+        Log_w("mqtt tx queue full, %u bytes queued", (unsigned)q->bytes);
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_MQTT_TX_QUEUE_FULL);
+    }
+    /* reserve the room before copying */
+    q->bytes += len;
+    HAL_MutexUnlock(q->lock);
+
+    pkt = (TxPacket *)HAL_Malloc(sizeof(TxPacket) + len);
+    if (NULL == pkt) {
+        HAL_MutexLock(q->lock);
+        q->bytes -= len;
+        HAL_MutexUnlock(q->lock);
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_MALLOC);
+    }
+
+    for (i = 0; i < iovcnt; i++) {
+        memcpy(pkt->data + off, iov[i].data, iov[i].len);
+        off += iov[i].len;
+    }
+    pkt->len = len;
+    pkt->next = NULL;
+
+    HAL_MutexLock(q->lock);
+    if (NULL == q->tail) {
+        q->head = pkt;
+    } else {
+        q->tail->next = pkt;
+    }
+    q->tail = pkt;
+    HAL_MutexUnlock(q->lock);
+
+    HAL_SemaphorePost(q->sem);
+
+    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+}
+
+bool qcloud_iot_mqtt_tx_failed(Qcloud_IoT_Client *pClient)
+{
+    TxQueue *q;
+    bool failed;
+
+    HAL_MutexLock(pClient->lock_write_buf);
+    q = (TxQueue *)pClient->tx_queue;
+    failed = NULL != q && q->write_failed;
+    HAL_MutexUnlock(pClient->lock_write_buf);
+
+    return failed;
+}
+
+void qcloud_iot_mqtt_tx_flush(Qcloud_IoT_Client *pClient, bool drain)
+{
+    TxQueue *q;
+    Timer timer;
+
+    /* no packet is queued meanwhile, and the queue is not stopped under us */
+    HAL_MutexLock(pClient->lock_write_buf);
+    q = (TxQueue *)pClient->tx_queue;
+    if (NULL == q) {
+        HAL_MutexUnlock(pClient->lock_write_buf);
+        return;
+    }
+
+    if (drain) {
+        InitTimer(&timer);
+        countdown_ms(&timer, pClient->command_timeout_ms);
+        while (atomic_load(&q->running) && !q->write_failed && !_is_empty(q) && !expired(&timer)) {
+            HAL_SleepMs(10);
+        }
+    }
+
+    /* waits for the packet being written, after that the writer leaves the socket alone */
+    HAL_MutexLock(q->lock_socket);
+    set_client_conn_state(pClient, NOTCONNECTED);
+    _drop_packets(q);
+    q->write_failed = false;
+    HAL_MutexUnlock(q->lock_socket);
+    HAL_MutexUnlock(pClient->lock_write_buf);
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -91,6 +91,15 @@ static int _serialize_unsubscribe_packet(unsigned char *buf, size_t buf_len,
     IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
 }
 
+static int _notify_unsubscribe(SubTopicHandle *handle, void *pClient)
+{
+    /* notify this event to topic subscriber */
+    if (NULL != handle->sub_event_handler)
+        handle->sub_event_handler(pClient, MQTT_EVENT_UNSUBSCRIBE, handle->handler_user_data);
+
+    return 0;
+}
+
 int qcloud_iot_mqtt_unsubscribe(Qcloud_IoT_Client *pClient, char *topicFilter)
 {
     IOT_FUNC_ENTRY;
@@ -99,7 +108,6 @@ int qcloud_iot_mqtt_unsubscribe(Qcloud_IoT_Client *pClient, char *topicFilter)
     POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
     STRING_PTR_SANITY_CHECK(topicFilter, QCLOUD_ERR_INVAL);
 
-    int i = 0;
     Timer timer;
     uint32_t len = 0;
     uint16_t packet_id = 0;
@@ -112,25 +120,9 @@ int qcloud_iot_mqtt_unsubscribe(Qcloud_IoT_Client *pClient, char *topicFilter)
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_MAX_TOPIC_LENGTH);
     }
 
-    /* Remove from message handler array */
+    /* Remove from subscription trie, all the handles registered with this topic filter are removed */
     HAL_MutexLock(pClient->lock_generic);
-    for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i) {
-        if ((pClient->sub_handles[i].topic_filter != NULL && !strcmp(pClient->sub_handles[i].topic_filter, topicFilter))
-            || strstr(topicFilter, "/#") != NULL || strstr(topicFilter, "/+") != NULL) {
-            /* notify this event to topic subscriber */
-            if (NULL != pClient->sub_handles[i].sub_event_handler)
-                pClient->sub_handles[i].sub_event_handler(
-                    pClient, MQTT_EVENT_UNSUBSCRIBE, pClient->sub_handles[i].handler_user_data);
-
-            /* Free the topic filter malloced in qcloud_iot_mqtt_subscribe */
-            HAL_Free((void *)pClient->sub_handles[i].topic_filter);
-            pClient->sub_handles[i].topic_filter = NULL;
-
-            /* We don't want to break here, if the same topic is registered
-             * with 2 callbacks. Unlikely scenario */
-            suber_exists = true;
-        }
-    }
+    suber_exists = topic_trie_remove(&pClient->sub_trie, topicFilter, _notify_unsubscribe, pClient) > 0;
     HAL_MutexUnlock(pClient->lock_generic);
 
     if (suber_exists == false) {
@@ -168,9 +160,10 @@ int qcloud_iot_mqtt_unsubscribe(Qcloud_IoT_Client *pClient, char *topicFilter)
     sub_handle.topic_filter = topic_filter_stored;
     sub_handle.sub_event_handler = NULL;
     sub_handle.message_handler = NULL;
+    sub_handle.message_chunk_handler = NULL;
     sub_handle.handler_user_data = NULL;
 
-    rc = push_sub_info_to(pClient, len, (unsigned int)packet_id, UNSUBSCRIBE, &sub_handle, &node);
+    rc = push_sub_info_to(pClient, len, (unsigned int)packet_id, UNSUBSCRIBE, &sub_handle, 1, &node);
     if (QCLOUD_RET_SUCCESS != rc) {
         Log_e("push publish into to pubInfolist failed: %d", rc);
         HAL_MutexUnlock(pClient->lock_write_buf);
@@ -182,6 +175,7 @@ int qcloud_iot_mqtt_unsubscribe(Qcloud_IoT_Client *pClient, char *topicFilter)
     rc = send_mqtt_packet(pClient, len, &timer);
     if (QCLOUD_RET_SUCCESS != rc) {
         HAL_MutexLock(pClient->lock_list_sub);
+        timer_wheel_del(&pClient->timer_wheel, &((QcloudIotSubInfo *)node->val)->timer_entry);
         list_remove(pClient->list_sub_wait_ack, node);
         HAL_MutexUnlock(pClient->lock_list_sub);
 
@@ -72,7 +72,11 @@ static int _handle_disconnect(Qcloud_IoT_Client *pClient)
     rc = qcloud_iot_mqtt_disconnect(pClient);
     // disconnect network stack by force
     if (rc != QCLOUD_RET_SUCCESS) {
+#ifdef MULTITHREAD_ENABLED
+        qcloud_iot_mqtt_tx_flush(pClient, false);
+#endif
         pClient->network_stack.disconnect(&(pClient->network_stack));
+        pClient->network_epoch++;
         set_client_conn_state(pClient, NOTCONNECTED);
     }
 
@@ -110,6 +114,13 @@ static int _handle_reconnect(Qcloud_IoT_Client *pClient)
     if (isPhysicalLayerConnected) {
         rc = qcloud_iot_mqtt_attempt_reconnect(pClient);
         if (rc == QCLOUD_RET_MQTT_RECONNECTED) {
+            uint32_t reconnect_time = HAL_GetTimeMs() - pClient->disconnect_time;
+
+            HAL_MutexLock(pClient->lock_stats);
+            pClient->stats.reconnect_count++;
+            pClient->stats.reconnect_last_ms = reconnect_time;
+            pClient->stats.reconnect_max_ms = Max(pClient->stats.reconnect_max_ms, reconnect_time);
+            HAL_MutexUnlock(pClient->lock_stats);
             Log_e("attempt to reconnect success.");
             _reconnect_callback(pClient);
 #ifdef LOG_UPLOAD
@@ -153,6 +164,14 @@ static int _mqtt_keep_alive(Qcloud_IoT_Client *pClient)
     Timer timer;
     uint32_t serialized_len = 0;
 
+#ifdef MULTITHREAD_ENABLED
+    if (qcloud_iot_mqtt_tx_failed(pClient)) {
+        Log_e("Fail to send MQTT msg in writer task. Something wrong with the connection.");
+        rc = _handle_disconnect(pClient);
+        IOT_FUNC_EXIT_RC(rc);
+    }
+#endif
+
     if (0 == pClient->options.keep_alive_interval) {
         IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
     }
@@ -203,6 +222,28 @@ static int _mqtt_keep_alive(Qcloud_IoT_Client *pClient)
     IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
 }
 
+/**
+ * @brief account for a lost connection and arm the reconnect delay timer
+ *
+ * @param pClient
+ * @return QCLOUD_ERR_MQTT_ATTEMPTING_RECONNECT if auto reconnect is enabled, or QCLOUD_ERR_MQTT_NO_CONN
+ */
+static int _handle_no_conn(Qcloud_IoT_Client *pClient)
+{
+    pClient->counter_network_disconnected++;
+    pClient->disconnect_time = HAL_GetTimeMs();
+
+    if (pClient->options.auto_connect_enable == 1) {
+        pClient->current_reconnect_wait_interval = _get_random_interval();
+        countdown_ms(&(pClient->reconnect_delay_timer), pClient->current_reconnect_wait_interval);
+
+        // reconnect timeout
+        return QCLOUD_ERR_MQTT_ATTEMPTING_RECONNECT;
+    }
+
+    return QCLOUD_ERR_MQTT_NO_CONN;
+}
+
 /**
  * @brief Check connection and keep alive state, read/handle MQTT message in synchronized way
  *
@@ -254,6 +295,14 @@ int qcloud_iot_mqtt_yield(Qcloud_IoT_Client *pClient, uint32_t timeout_ms)
             /* check list of wait publish ACK to remove node that is ACKED or timeout */
             qcloud_iot_mqtt_pub_info_proc(pClient);
 
+#ifdef MQTT_OFFLINE_QUEUE_ENABLED
+            /* replay publishes stored while offline, no more than a window waiting for PUBACK */
+            qcloud_iot_mqtt_offline_replay(pClient);
+#endif
+
+            /* publish those pushed by other tasks without lock */
+            qcloud_iot_mqtt_deferred_drain(pClient);
+
             /* check list of wait subscribe(or unsubscribe) ACK to remove node that is ACKED or timeout */
             qcloud_iot_mqtt_sub_info_proc(pClient);
 
@@ -265,15 +314,8 @@ int qcloud_iot_mqtt_yield(Qcloud_IoT_Client *pClient, uint32_t timeout_ms)
         }
 
         if (rc == QCLOUD_ERR_MQTT_NO_CONN) {
-            pClient->counter_network_disconnected++;
-
-            if (pClient->options.auto_connect_enable == 1) {
-                pClient->current_reconnect_wait_interval = _get_random_interval();
-                countdown_ms(&(pClient->reconnect_delay_timer), pClient->current_reconnect_wait_interval);
-
-                // reconnect timeout
-                rc = QCLOUD_ERR_MQTT_ATTEMPTING_RECONNECT;
-            } else {
+            rc = _handle_no_conn(pClient);
+            if (rc == QCLOUD_ERR_MQTT_NO_CONN) {
                 break;
             }
         } else if (rc != QCLOUD_RET_SUCCESS) {
@@ -285,196 +327,232 @@ int qcloud_iot_mqtt_yield(Qcloud_IoT_Client *pClient, uint32_t timeout_ms)
 }
 
 /**
- * @brief puback waiting timeout process
+ * @brief Handle MQTT packets already arrived, without waiting for network
  *
- * @param pClient reference to MQTTClient
+ * @param pClient    handle to MQTT client
  *
+ * @return QCLOUD_RET_SUCCESS when success, QCLOUD_ERR_MQTT_ATTEMPTING_RECONNECT when try reconnecing, or err code for failure
  */
-int qcloud_iot_mqtt_pub_info_proc(Qcloud_IoT_Client *pClient)
+int qcloud_iot_mqtt_process_readable(Qcloud_IoT_Client *pClient)
 {
+#define MQTT_READABLE_MAX_PACKETS   16
+
     IOT_FUNC_ENTRY;
 
+    int rc = QCLOUD_RET_SUCCESS;
+    int i;
+    Timer timer;
+    uint8_t packet_type;
+
     POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
 
+    if (!get_client_conn_state(pClient)) {
+        IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+    }
 
-    HAL_MutexLock(pClient->lock_list_pub);
-    do {
-        if (0 == pClient->list_pub_wait_ack->len) {
-            break;
-        }
+    /* bounded, so that one busy client could not starve the others in the same loop */
+    for (i = 0; i < MQTT_READABLE_MAX_PACKETS; i++) {
+        InitTimer(&timer);
+        countdown_ms(&timer, 1);
 
-        ListIterator *iter;
-        ListNode *node = NULL;
-        ListNode *temp_node = NULL;
+        packet_type = 0;
+        rc = cycle_for_read(pClient, &timer, &packet_type, QOS0);
+        if (rc == QCLOUD_ERR_SSL_READ_TIMEOUT || rc == QCLOUD_ERR_SSL_READ ||
+            rc == QCLOUD_ERR_TCP_PEER_SHUTDOWN || rc == QCLOUD_ERR_TCP_READ_FAIL) {
+            Log_e("network read failed, rc: %d. MQTT Disconnect.", rc);
+            rc = _handle_disconnect(pClient);
+        }
 
-        if (NULL == (iter = list_iterator_new(pClient->list_pub_wait_ack, LIST_TAIL))) {
-            Log_e("new list failed");
+        if (rc == QCLOUD_ERR_MQTT_NO_CONN) {
+            rc = _handle_no_conn(pClient);
+            break;
+        } else if (rc != QCLOUD_RET_SUCCESS || 0 == packet_type) {
             break;
         }
 
-        for (;;) {
-            node = list_iterator_next(iter);
+        if (pClient->recv_stream_pos < pClient->recv_stream_len) {
+            continue;
+        }
+        if (NULL == pClient->network_stack.has_pending ||
+            !pClient->network_stack.has_pending(&(pClient->network_stack))) {
+            break;
+        }
+    }
 
-            if (NULL != temp_node) {
-                list_remove(pClient->list_pub_wait_ack, temp_node);
-                temp_node = NULL;
-            }
+    IOT_FUNC_EXIT_RC(rc);
 
-            if (NULL == node) {
-                break; /* end of list */
-            }
+#undef MQTT_READABLE_MAX_PACKETS
+}
 
-            QcloudIotPubInfo *repubInfo = (QcloudIotPubInfo *) node->val;
-            if (NULL == repubInfo) {
-                Log_e("node's value is invalid!");
-                temp_node = node;
-                continue;
-            }
+/**
+ * @brief Handle reconnect, ACK timeout, offline replay and keep alive, without reading network
+ *
+ * @param pClient    handle to MQTT client
+ *
+ * @return QCLOUD_RET_SUCCESS when success, QCLOUD_ERR_MQTT_ATTEMPTING_RECONNECT when try reconnecing, or err code for failure
+ */
+int qcloud_iot_mqtt_process_timers(Qcloud_IoT_Client *pClient)
+{
+    IOT_FUNC_ENTRY;
 
-            /* remove invalid node */
-            if (MQTT_NODE_STATE_INVALID == repubInfo->node_state) {
-                temp_node = node;
-                continue;
-            }
+    int rc;
 
-            if (!pClient->is_connected) {
-                continue;
-            }
+    POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
 
-            /* check the request if timeout or not */
-            if (left_ms(&repubInfo->pub_start_time) > 0) {
-                continue;
-            }
+    if (!get_client_conn_state(pClient)) {
+        if (pClient->was_manually_disconnected == 1) {
+            IOT_FUNC_EXIT_RC(QCLOUD_RET_MQTT_MANUALLY_DISCONNECTED);
+        }
+        if (pClient->options.auto_connect_enable == 0) {
+            IOT_FUNC_EXIT_RC(QCLOUD_ERR_MQTT_NO_CONN);
+        }
+        if (pClient->current_reconnect_wait_interval > MAX_RECONNECT_WAIT_INTERVAL) {
+            IOT_FUNC_EXIT_RC(QCLOUD_ERR_MQTT_RECONNECT_TIMEOUT);
+        }
 
-            HAL_MutexUnlock(pClient->lock_list_pub);
-            /* If wait ACK timeout, remove the node from list */
-            /* It is up to user to do republishing or not */
-            temp_node = node;
+        rc = _handle_reconnect(pClient);
+        IOT_FUNC_EXIT_RC(rc);
+    }
 
-            countdown_ms(&repubInfo->pub_start_time, pClient->command_timeout_ms);
-            HAL_MutexLock(pClient->lock_list_pub);
+    qcloud_iot_mqtt_pub_info_proc(pClient);
 
-            /* notify timeout event */
-            if (NULL != pClient->event_handle.h_fp) {
-                MQTTEventMsg msg;
-                msg.event_type = MQTT_EVENT_PUBLISH_TIMEOUT;
-                msg.msg = (void *)(uintptr_t)repubInfo->msg_id;
-                pClient->event_handle.h_fp(pClient, pClient->event_handle.context, &msg);
-            }
-        }
+#ifdef MQTT_OFFLINE_QUEUE_ENABLED
+    qcloud_iot_mqtt_offline_replay(pClient);
+#endif
 
-        list_iterator_destroy(iter);
+    qcloud_iot_mqtt_deferred_drain(pClient);
 
-    } while (0);
+    qcloud_iot_mqtt_sub_info_proc(pClient);
 
-    HAL_MutexUnlock(pClient->lock_list_pub);
+    rc = _mqtt_keep_alive(pClient);
+    if (rc == QCLOUD_ERR_MQTT_NO_CONN) {
+        rc = _handle_no_conn(pClient);
+    }
 
-    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+    IOT_FUNC_EXIT_RC(rc);
 }
 
 /**
- * @brief suback waiting timeout process
+ * @brief puback waiting timeout process
  *
  * @param pClient reference to MQTTClient
  *
  */
-int qcloud_iot_mqtt_sub_info_proc(Qcloud_IoT_Client *pClient)
+int qcloud_iot_mqtt_pub_info_proc(Qcloud_IoT_Client *pClient)
 {
     IOT_FUNC_ENTRY;
-    int rc = QCLOUD_RET_SUCCESS;
 
-    if (!pClient) {
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_INVAL);
-    }
+    POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
 
-    HAL_MutexLock(pClient->lock_list_sub);
-    do {
-        if (0 == pClient->list_sub_wait_ack->len) {
-            break;
-        }
+    QcloudIotPubInfo *repubInfo;
+    OnPublishCompleteHandler on_complete;
+    void *user_data;
+    uint16_t msg_id;
 
-        ListIterator *iter;
-        ListNode *node = NULL;
-        ListNode *temp_node = NULL;
-        uint16_t packet_id = 0;
-        MessageTypes msg_type;
+    if (!pClient->is_connected) {
+        IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+    }
 
-        if (NULL == (iter = list_iterator_new(pClient->list_sub_wait_ack, LIST_TAIL))) {
-            Log_e("new list failed");
-            HAL_MutexUnlock(pClient->lock_list_sub);
-            IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+    /* only entries whose deadline is passed are visited */
+    HAL_MutexLock(pClient->lock_list_pub);
+    while (NULL != (repubInfo = pub_inflight_expired(&pClient->pub_inflight))) {
+        /* If wait ACK timeout, remove the node from list */
+        /* It is up to user to do republishing or not */
+        msg_id = repubInfo->msg_id;
+        on_complete = repubInfo->on_complete;
+        user_data = repubInfo->user_data;
+        pub_inflight_remove(&pClient->pub_inflight, repubInfo);
+        HAL_MutexUnlock(pClient->lock_list_pub);
+
+        HAL_MutexLock(pClient->lock_stats);
+        pClient->stats.puback_timeout++;
+        HAL_MutexUnlock(pClient->lock_stats);
+
+        if (NULL != on_complete) {
+            on_complete(pClient, msg_id, MQTT_EVENT_PUBLISH_TIMEOUT, user_data);
         }
 
-        for (;;) {
-            node = list_iterator_next(iter);
-
-            if (NULL != temp_node) {
-                list_remove(pClient->list_sub_wait_ack, temp_node);
-                temp_node = NULL;
-            }
-
-            if (NULL == node) {
-                break; /* end of list */
-            }
-
-            QcloudIotSubInfo *sub_info = (QcloudIotSubInfo *) node->val;
-            if (NULL == sub_info) {
-                Log_e("node's value is invalid!");
-                temp_node = node;
-                continue;
-            }
-
-            /* remove invalid node */
-            if (MQTT_NODE_STATE_INVALID == sub_info->node_state) {
-                temp_node = node;
-                continue;
-            }
+        /* notify timeout event */
+        if (NULL != pClient->event_handle.h_fp) {
+            MQTTEventMsg msg;
+            msg.event_type = MQTT_EVENT_PUBLISH_TIMEOUT;
+            msg.msg = (void *)(uintptr_t)msg_id;
+            pClient->event_handle.h_fp(pClient, pClient->event_handle.context, &msg);
+        }
 
-            if (pClient->is_connected <= 0) {
-                continue;
-            }
+        HAL_MutexLock(pClient->lock_list_pub);
+    }
+    HAL_MutexUnlock(pClient->lock_list_pub);
 
-            /* check the request if timeout or not */
-            if (left_ms(&sub_info->sub_start_time) > 0) {
-                continue;
-            }
+    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+}
 
-            /* When arrive here, it means timeout to wait ACK */
-            packet_id = sub_info->msg_id;
-            msg_type = sub_info->type;
+/**
+ * @brief suback waiting timeout process
+ *
+ * @param pClient reference to MQTTClient
+ *
+ */
+int qcloud_iot_mqtt_sub_info_proc(Qcloud_IoT_Client *pClient)
+{
+    IOT_FUNC_ENTRY;
+    int rc = QCLOUD_RET_SUCCESS;
 
-            /* Wait MQTT SUBSCRIBE ACK timeout */
-            if (NULL != pClient->event_handle.h_fp) {
-                MQTTEventMsg msg;
+    if (!pClient) {
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_INVAL);
+    }
 
-                if (SUBSCRIBE == msg_type) {
-                    /* subscribe timeout */
-                    msg.event_type = MQTT_EVENT_SUBCRIBE_TIMEOUT;
-                    msg.msg = (void *)(uintptr_t)packet_id;
+    TimerWheelEntry *entry;
+    QcloudIotSubInfo *sub_info;
+    uint16_t packet_id = 0;
+    uint16_t i;
+    MessageTypes msg_type;
 
-                    /* notify this event to topic subscriber */
-                    if (NULL != sub_info->handler.sub_event_handler)
-                        sub_info->handler.sub_event_handler(pClient,
-                                                            MQTT_EVENT_SUBCRIBE_TIMEOUT, sub_info->handler.handler_user_data);
+    if (pClient->is_connected <= 0) {
+        IOT_FUNC_EXIT_RC(rc);
+    }
 
-                } else {
-                    /* unsubscribe timeout */
-                    msg.event_type = MQTT_EVENT_UNSUBCRIBE_TIMEOUT;
-                    msg.msg = (void *)(uintptr_t)packet_id;
+    /* only requests whose deadline is passed are visited */
+    HAL_MutexLock(pClient->lock_list_sub);
+    while (NULL != (entry = timer_wheel_pop_expired(&pClient->timer_wheel, &pClient->sub_expired))) {
+        sub_info = TIMER_WHEEL_ENTRY(entry, QcloudIotSubInfo, timer_entry);
+
+        /* When arrive here, it means timeout to wait ACK */
+        packet_id = sub_info->msg_id;
+        msg_type = sub_info->type;
+
+        /* Wait MQTT SUBSCRIBE ACK timeout */
+        if (NULL != pClient->event_handle.h_fp) {
+            MQTTEventMsg msg;
+
+            if (SUBSCRIBE == msg_type) {
+                /* subscribe timeout */
+                msg.event_type = MQTT_EVENT_SUBCRIBE_TIMEOUT;
+                msg.msg = (void *)(uintptr_t)packet_id;
+
+                /* notify this event to topic subscribers */
+                for (i = 0; i < sub_info->handler_count; i++) {
+                    if (NULL != sub_info->handlers[i].sub_event_handler)
+                        sub_info->handlers[i].sub_event_handler(pClient, MQTT_EVENT_SUBCRIBE_TIMEOUT,
+                                                                sub_info->handlers[i].handler_user_data);
                 }
 
-                pClient->event_handle.h_fp(pClient, pClient->event_handle.context, &msg);
+            } else {
+                /* unsubscribe timeout */
+                msg.event_type = MQTT_EVENT_UNSUBCRIBE_TIMEOUT;
+                msg.msg = (void *)(uintptr_t)packet_id;
             }
 
-            if (NULL != sub_info->handler.topic_filter)
-                HAL_Free((void *)(sub_info->handler.topic_filter));
-
-            temp_node = node;
+            pClient->event_handle.h_fp(pClient, pClient->event_handle.context, &msg);
         }
 
-        list_iterator_destroy(iter);
+        for (i = 0; i < sub_info->handler_count; i++) {
+            if (NULL != sub_info->handlers[i].topic_filter)
+                HAL_Free((void *)(sub_info->handlers[i].topic_filter));
+        }
 
-    } while (0);
+        list_remove(pClient->list_sub_wait_ack, sub_info->node);
+    }
 
     HAL_MutexUnlock(pClient->lock_list_sub);
 
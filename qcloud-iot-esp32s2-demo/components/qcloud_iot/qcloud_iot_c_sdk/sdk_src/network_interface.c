@@ -48,17 +48,25 @@ int network_init(Network *pNetwork)
             pNetwork->init = network_at_tcp_init;
             pNetwork->connect = network_at_tcp_connect;
             pNetwork->read = network_at_tcp_read;
+            pNetwork->read_some = NULL;
             pNetwork->write = network_at_tcp_write;
+            pNetwork->write_vec = NULL;
             pNetwork->disconnect = network_at_tcp_disconnect;
             pNetwork->is_connected = is_network_at_connected;
+            pNetwork->get_fd = NULL;
+            pNetwork->has_pending = NULL;
             pNetwork->handle = AT_NO_CONNECTED_FD;
 #else
             pNetwork->init = network_tcp_init;
             pNetwork->connect = network_tcp_connect;
             pNetwork->read = network_tcp_read;
+            pNetwork->read_some = network_tcp_read_some;
             pNetwork->write = network_tcp_write;
+            pNetwork->write_vec = network_tcp_writev;
             pNetwork->disconnect = network_tcp_disconnect;
             pNetwork->is_connected = is_network_connected;
+            pNetwork->get_fd = network_tcp_get_fd;
+            pNetwork->has_pending = NULL;
             pNetwork->handle = 0;
 #endif
             break;
@@ -68,9 +76,13 @@ int network_init(Network *pNetwork)
             pNetwork->init = network_tls_init;
             pNetwork->connect = network_tls_connect;
             pNetwork->read = network_tls_read;
+            pNetwork->read_some = network_tls_read_some;
             pNetwork->write = network_tls_write;
+            pNetwork->write_vec = network_tls_writev;
             pNetwork->disconnect = network_tls_disconnect;
             pNetwork->is_connected = is_network_connected;
+            pNetwork->get_fd = network_tls_get_fd;
+            pNetwork->has_pending = network_tls_has_pending;
             pNetwork->handle = 0;
             break;
 #endif
@@ -81,9 +93,13 @@ int network_init(Network *pNetwork)
             pNetwork->init = network_udp_init;
             pNetwork->connect = network_udp_connect;
             pNetwork->read = network_udp_read;
+            pNetwork->read_some = NULL;
             pNetwork->write = network_udp_write;
+            pNetwork->write_vec = NULL;
             pNetwork->disconnect = network_udp_disconnect;
             pNetwork->is_connected = is_network_connected;
+            pNetwork->get_fd = NULL;
+            pNetwork->has_pending = NULL;
             pNetwork->handle = 0;
             break;
 #else
@@ -91,9 +107,13 @@ int network_init(Network *pNetwork)
             pNetwork->init = network_dtls_init;
             pNetwork->connect = network_dtls_connect;
             pNetwork->read = network_dtls_read;
+            pNetwork->read_some = NULL;
             pNetwork->write = network_dtls_write;
+            pNetwork->write_vec = NULL;
             pNetwork->disconnect = network_dtls_disconnect;
             pNetwork->is_connected = is_network_connected;
+            pNetwork->get_fd = NULL;
+            pNetwork->has_pending = NULL;
             pNetwork->handle = 0;
             break;
 #endif
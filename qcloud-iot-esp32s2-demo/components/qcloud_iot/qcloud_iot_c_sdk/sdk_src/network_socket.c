@@ -50,6 +50,28 @@ int network_tcp_read(Network *pNetwork, unsigned char *data, size_t datalen, uin
     return rc;
 }
 
+int network_tcp_read_some(Network *pNetwork, unsigned char *data, size_t datalen, uint32_t timeout_ms, size_t *read_len)
+{
+    POINTER_SANITY_CHECK(pNetwork, QCLOUD_ERR_INVAL);
+
+    int rc = 0;
+
+    rc = HAL_TCP_ReadSome(pNetwork->handle, data, (uint32_t)datalen, timeout_ms, read_len);
+
+    return rc;
+}
+
+int network_tcp_get_fd(Network *pNetwork)
+{
+    POINTER_SANITY_CHECK(pNetwork, -1);
+
+    if (0 == pNetwork->handle) {
+        return -1;
+    }
+
+    return HAL_TCP_GetFd(pNetwork->handle);
+}
+
 int network_tcp_write(Network *pNetwork, unsigned char *data, size_t datalen, uint32_t timeout_ms, size_t *written_len)
 {
     POINTER_SANITY_CHECK(pNetwork, QCLOUD_ERR_INVAL);
@@ -61,6 +83,17 @@ int network_tcp_write(Network *pNetwork, unsigned char *data, size_t datalen, ui
     return rc;
 }
 
+int network_tcp_writev(Network *pNetwork, const NetIoVec *iov, int iovcnt, uint32_t timeout_ms, size_t *written_len)
+{
+    POINTER_SANITY_CHECK(pNetwork, QCLOUD_ERR_INVAL);
+
+    int rc = 0;
+
+    rc = HAL_TCP_Writev(pNetwork->handle, iov, iovcnt, timeout_ms, written_len);
+
+    return rc;
+}
+
 void network_tcp_disconnect(Network *pNetwork)
 {
     POINTER_SANITY_CHECK_RTN(pNetwork);
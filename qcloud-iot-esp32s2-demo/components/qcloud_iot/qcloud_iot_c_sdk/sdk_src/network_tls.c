@@ -51,6 +51,33 @@ int network_tls_read(Network *pNetwork, unsigned char *data, size_t datalen, uin
     return rc;
 }
 
+int network_tls_read_some(Network *pNetwork, unsigned char *data, size_t datalen, uint32_t timeout_ms, size_t *read_len)
+{
+    POINTER_SANITY_CHECK(pNetwork, QCLOUD_ERR_INVAL);
+
+    int rc = HAL_TLS_ReadSome(pNetwork->handle, data, datalen, timeout_ms, read_len);
+
+    return rc;
+}
+
+int network_tls_get_fd(Network *pNetwork)
+{
+    POINTER_SANITY_CHECK(pNetwork, -1);
+
+    if (0 == pNetwork->handle) {
+        return -1;
+    }
+
+    return HAL_TLS_GetFd(pNetwork->handle);
+}
+
+int network_tls_has_pending(Network *pNetwork)
+{
+    POINTER_SANITY_CHECK(pNetwork, 0);
+
+    return 0 != pNetwork->handle && HAL_TLS_HasPending(pNetwork->handle);
+}
+
 int network_tls_write(Network *pNetwork, unsigned char *data, size_t datalen, uint32_t timeout_ms, size_t *written_len)
 {
     POINTER_SANITY_CHECK(pNetwork, QCLOUD_ERR_INVAL);
@@ -60,6 +87,15 @@ int network_tls_write(Network *pNetwork, unsigned char *data, size_t datalen, ui
     return rc;
 }
 
+int network_tls_writev(Network *pNetwork, const NetIoVec *iov, int iovcnt, uint32_t timeout_ms, size_t *written_len)
+{
+    POINTER_SANITY_CHECK(pNetwork, QCLOUD_ERR_INVAL);
+
+    int rc = HAL_TLS_Writev(pNetwork->handle, iov, iovcnt, timeout_ms, written_len);
+
+    return rc;
+}
+
 void network_tls_disconnect(Network *pNetwork)
 {
     POINTER_SANITY_CHECK_RTN(pNetwork);
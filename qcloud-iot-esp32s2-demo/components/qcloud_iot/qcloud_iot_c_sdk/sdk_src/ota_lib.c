@@ -38,47 +38,17 @@ static int _qcloud_otalib_get_firmware_fixlen_para(const char *json_doc, const c
     IOT_FUNC_ENTRY;
 
     int ret = QCLOUD_RET_SUCCESS;
+    json_span_t value;
 
-    char* key_bak = HAL_Malloc(strlen(key) + 1);
-    if (key_bak == NULL) {
-        Log_e("not enough memory for malloc key");
-        ret = IOT_OTA_ERR_FAIL;
-        IOT_FUNC_EXIT_RC(ret);
-    }
-
-    char* json_doc_bak = HAL_Malloc(strlen(json_doc) + 1);
-    if (json_doc_bak == NULL) {
-        Log_e("not enough memory for malloc json");
-        HAL_Free(key_bak);
-        ret = IOT_OTA_ERR_FAIL;
-        IOT_FUNC_EXIT_RC(ret);
-    }
-
-    strcpy(key_bak, key);
-    strcpy(json_doc_bak, json_doc);
-
-    char* value = LITE_json_value_of(key_bak, json_doc_bak);
-    if (value == NULL) {
+    if (LITE_json_span_of(key, json_doc, &value) != QCLOUD_RET_SUCCESS) {
         Log_e("Not '%s' key in json doc of OTA", key);
         ret = IOT_OTA_ERR_FAIL;
+    } else if (value.len < 0 || (size_t)value.len > dest_len) {
+        Log_e("value length of the key is too long");
+        ret = IOT_OTA_ERR_FAIL;
     } else {
-        uint32_t val_len = strlen(value);
-        if (val_len > dest_len) {
-            Log_e("value length of the key is too long");
-            ret = IOT_OTA_ERR_FAIL;
-        } else {
-            memcpy(dest, value, val_len);
-            ret = QCLOUD_RET_SUCCESS;
-        }
-
-        HAL_Free(value);
-    }
-
-    if (key_bak != NULL) {
-        HAL_Free(key_bak);
-    }
-    if (json_doc_bak != NULL) {
-        HAL_Free(json_doc_bak);
+        memcpy(dest, value.str, value.len);
+        ret = QCLOUD_RET_SUCCESS;
     }
 
     IOT_FUNC_EXIT_RC(ret);
@@ -89,46 +59,25 @@ static int _qcloud_otalib_get_firmware_fixlen_para(const char *json_doc, const c
 /* 0, successful; -1, failed */
 static int _qcloud_otalib_get_firmware_varlen_para(const char *json_doc, const char *key, char **dest)
 {
-#define OTA_FIRMWARE_JSON_VALUE_MAX_LENGTH (64)
-
     IOT_FUNC_ENTRY;
 
-    int ret = QCLOUD_RET_SUCCESS;
-
-    char* key_bak = HAL_Malloc(strlen(key) + 1);
-    if (key_bak == NULL) {
-        Log_e("not enough memory for malloc key");
-        ret = IOT_OTA_ERR_FAIL;
-        IOT_FUNC_EXIT_RC(ret);
-    }
+    json_span_t value;
 
-    char* json_doc_bak = HAL_Malloc(strlen(json_doc) + 1);
-    if (json_doc_bak == NULL) {
-        Log_e("not enough memory for malloc json");
-        HAL_Free(key_bak);
-        ret = IOT_OTA_ERR_FAIL;
-        IOT_FUNC_EXIT_RC(ret);
+    if (LITE_json_span_of(key, json_doc, &value) != QCLOUD_RET_SUCCESS) {
+        Log_e("Not '%s' key in json '%s' doc of OTA", key, json_doc);
+        IOT_FUNC_EXIT_RC(IOT_OTA_ERR_FAIL);
     }
 
-    strcpy(key_bak, key);
-    strcpy(json_doc_bak, json_doc);
-
-    *dest = LITE_json_value_of(key_bak, json_doc_bak);
+    /* the value is kept by OTA handle after the message is released */
+    *dest = HAL_Malloc(value.len + 1);
     if (*dest == NULL) {
-        Log_e("Not '%s' key in json '%s' doc of OTA", key_bak, json_doc_bak);
-        ret = IOT_OTA_ERR_FAIL;
-    }
-
-    if (key_bak != NULL) {
-        HAL_Free(key_bak);
-    }
-    if (json_doc_bak != NULL) {
-        HAL_Free(json_doc_bak);
+        Log_e("not enough memory for malloc value of %s", key);
+        IOT_FUNC_EXIT_RC(IOT_OTA_ERR_FAIL);
     }
+    memcpy(*dest, value.str, value.len);
+    (*dest)[value.len] = '\0';
 
-    IOT_FUNC_EXIT_RC(ret);
-
-#undef OTA_FIRMWARE_JSON_VALUE_MAX_LENGTH
+    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
 }
 
 void *qcloud_otalib_md5_init(void)
@@ -178,26 +127,22 @@ int qcloud_otalib_get_report_version_result(const char *json)
 {
     IOT_FUNC_ENTRY;
 
-    char *result_code = NULL;
+    json_span_t result_code;
 
-    int rc = _qcloud_otalib_get_firmware_varlen_para(json, RESULT_FIELD, &result_code);
-    if ( rc != QCLOUD_RET_SUCCESS || strcmp(result_code, "0") != 0) {
-        if (NULL != result_code) HAL_Free(result_code);
+    int rc = LITE_json_span_of(RESULT_FIELD, json, &result_code);
+    if ( rc != QCLOUD_RET_SUCCESS || !LITE_span_equal(&result_code, "0")) {
         IOT_FUNC_EXIT_RC(IOT_OTA_ERR_FAIL);
     }
 
-    if (NULL != result_code) HAL_Free(result_code);
     IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
 }
 
 int qcloud_otalib_get_params(const char *json, char **type, char **url, char **version, char *md5,
                              uint32_t *fileSize)
 {
-#define OTA_FILESIZE_STR_LEN    (16)
-
     IOT_FUNC_ENTRY;
 
-    char file_size_str[OTA_FILESIZE_STR_LEN + 1] = {0};
+    json_span_t file_size;
 
     /* get type */
     if (0 != _qcloud_otalib_get_firmware_varlen_para(json, TYPE_FIELD, type)) {
@@ -224,17 +169,13 @@ int qcloud_otalib_get_params(const char *json, char **type, char **url, char **v
     }
 
     /* get file size */
-    if (0 != _qcloud_otalib_get_firmware_fixlen_para(json, FILESIZE_FIELD, file_size_str, OTA_FILESIZE_STR_LEN)) {
+    if (QCLOUD_RET_SUCCESS != LITE_json_span_of(FILESIZE_FIELD, json, &file_size) ||
+        QCLOUD_RET_SUCCESS != LITE_span_get_uint32(fileSize, &file_size)) {
         Log_e("get value of size key failed");
         IOT_FUNC_EXIT_RC(IOT_OTA_ERR_FAIL);
     }
 
-    file_size_str[OTA_FILESIZE_STR_LEN] = '\0';
-    *fileSize = atoi(file_size_str);
-
     IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
-
-#undef OTA_FILESIZE_STR_LEN
 }
 
 int qcloud_otalib_gen_info_msg(char *buf, size_t bufLen, uint32_t id, const char *version)
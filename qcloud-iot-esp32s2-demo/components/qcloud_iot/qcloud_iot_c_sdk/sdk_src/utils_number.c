@@ -0,0 +1,733 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils_number.h"
+
+/* significant digits kept for the slow path of parsing, the rest only affect rounding */
+#define NUMBER_MAX_DIGITS           (40)
+
+/* largest exponent handled, numbers out of it are 0 or infinity anyway */
+#define NUMBER_MAX_EXPONENT         (9999)
+
+/* numbers are formatted in fixed notation if position of decimal point in (MIN, MAX], as JavaScript does */
+#define NUMBER_FIXED_MIN_EXP        (-6)
+#define NUMBER_FIXED_MAX_EXP        (21)
+
+static bool _is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+/* parse digits with optional '-', magnitude no larger than limit */
+static int _strn_to_magnitude(const char *str, size_t len, bool allow_neg, uint32_t limit, bool *neg,
+                              uint32_t *value)
+{
+    size_t   i = 0;
+    uint32_t v = 0;
+
+    *neg = false;
+    if (allow_neg && len > 0 && str[0] == '-') {
+        *neg = true;
+        i++;
+    }
+
+    if (i >= len || !_is_digit(str[i])) {
+        return 0;
+    }
+
+    for (; i < len && _is_digit(str[i]); i++) {
+        uint32_t d = str[i] - '0';
+        if (v > (limit - d) / 10) {
+            return 0;
+        }
+        v = v * 10 + d;
+    }
+
+    *value = v;
+    return (int)i;
+}
+
+int utils_strn_to_int32(const char *str, size_t len, int32_t *value)
+{
+    bool     neg;
+    uint32_t v = 0;
+    int      n;
+
+    if (str == NULL || value == NULL) {
+        return 0;
+    }
+
+    n = _strn_to_magnitude(str, len, true, (uint32_t)INT32_MAX + 1, &neg, &v);
+    if (n == 0 || (!neg && v > INT32_MAX)) {
+        return 0;
+    }
+
+    *value = neg ? (int32_t)(0 - v) : (int32_t)v;
+    return n;
+}
+
+int utils_strn_to_uint32(const char *str, size_t len, uint32_t *value)
+{
+    bool neg;
+
+    if (str == NULL || value == NULL) {
+        return 0;
+    }
+
+    return _strn_to_magnitude(str, len, false, UINT32_MAX, &neg, value);
+}
+
+/* powers of ten exactly representable by double */
+static const double sg_exact_pow10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+#define NUMBER_MAX_EXACT_POW10      (22)
+#define NUMBER_MAX_EXACT_MANTISSA   (1ULL << 53)
+
+int utils_strn_to_double(const char *str, size_t len, double *value)
+{
+    char     digits[NUMBER_MAX_DIGITS + 1 + UTILS_INT_STR_LEN + 1];
+    int      digit_count = 0;
+    bool     sticky      = false;
+    bool     neg         = false;
+    uint64_t mantissa    = 0;
+    int      exp10       = 0;
+    size_t   i           = 0;
+    double   v;
+
+    if (str == NULL || value == NULL) {
+        return 0;
+    }
+
+    if (i < len && str[i] == '-') {
+        neg = true;
+        i++;
+    }
+
+    /* number = [ minus ] int [ frac ] [ exp ] of RFC 8259, int = zero / ( digit1-9 *DIGIT ) */
+    if (i >= len || !_is_digit(str[i])) {
+        return 0;
+    }
+
+    if (str[i] == '0') {
+        i++;
+    } else {
+        for (; i < len && _is_digit(str[i]); i++) {
+            if (digit_count < NUMBER_MAX_DIGITS) {
+                digits[digit_count++] = str[i];
+            } else {
+                sticky = sticky || str[i] != '0';
+                exp10++;
+            }
+        }
+    }
+
+    /* frac = "." 1*DIGIT, the point is not consumed if no digit follows */
+    if (i + 1 < len && str[i] == '.' && _is_digit(str[i + 1])) {
+        i++;
+        for (; i < len && _is_digit(str[i]); i++) {
+            if (digit_count == 0 && str[i] == '0') {
+                exp10--;
+                continue;
+            }
+            if (digit_count < NUMBER_MAX_DIGITS) {
+                digits[digit_count++] = str[i];
+                exp10--;
+            } else {
+                sticky = sticky || str[i] != '0';
+            }
+        }
+    }
+
+    /* exponent is consumed only if it has digits */
+    if (i < len && (str[i] == 'e' || str[i] == 'E')) {
+        size_t j       = i + 1;
+        bool   exp_neg = false;
+        int    e       = 0;
+
+        if (j < len && (str[j] == '+' || str[j] == '-')) {
+            exp_neg = (str[j] == '-');
+            j++;
+        }
+        if (j < len && _is_digit(str[j])) {
+            for (; j < len && _is_digit(str[j]); j++) {
+                if (e < NUMBER_MAX_EXPONENT) {
+                    e = e * 10 + (str[j] - '0');
+                }
+            }
+            exp10 += exp_neg ? -e : e;
+            i = j;
+        }
+    }
+
+    if (digit_count == 0) {
+        *value = neg ? -0.0 : 0.0;
+        return (int)i;
+    }
+
+    /* fast path: both mantissa and power of ten are exact, so a single rounding is correct */
+    if (digit_count <= 19 && !sticky && exp10 >= -NUMBER_MAX_EXACT_POW10 && exp10 <= NUMBER_MAX_EXACT_POW10) {
+        int k;
+        for (k = 0; k < digit_count; k++) {
+            mantissa = mantissa * 10 + (digits[k] - '0');
+        }
+        if (mantissa <= NUMBER_MAX_EXACT_MANTISSA) {
+            v      = (double)mantissa;
+            v      = exp10 < 0 ? v / sg_exact_pow10[-exp10] : v * sg_exact_pow10[exp10];
+            *value = neg ? -v : v;
+            return (int)i;
+        }
+    }
+
+    /* slow path: hand the digits to strtod, with an integer mantissa and no decimal point it does not
+     * depend on locale. A nonzero digit dropped is kept as a trailing 1 for rounding. */
+    if (sticky) {
+        digits[digit_count++] = '1';
+        exp10--;
+    }
+    if (exp10 < -NUMBER_MAX_EXPONENT) {
+        exp10 = -NUMBER_MAX_EXPONENT;
+    } else if (exp10 > NUMBER_MAX_EXPONENT) {
+        exp10 = NUMBER_MAX_EXPONENT;
+    }
+    digits[digit_count++] = 'e';
+    digit_count += utils_int32_to_str(exp10, digits + digit_count);
+
+    v      = strtod(digits, NULL);
+    *value = neg ? -v : v;
+    return (int)i;
+}
+
+int utils_uint32_to_str(uint32_t value, char *buf)
+{
+    char tmp[UTILS_INT_STR_LEN];
+    int  n = 0;
+    int  i;
+
+    do {
+        tmp[n++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+
+    for (i = 0; i < n; i++) {
+        buf[i] = tmp[n - 1 - i];
+    }
+    buf[n] = '\0';
+
+    return n;
+}
+
+int utils_int32_to_str(int32_t value, char *buf)
+{
+    if (value < 0) {
+        buf[0] = '-';
+        return 1 + utils_uint32_to_str(0 - (uint32_t)value, buf + 1);
+    }
+
+    return utils_uint32_to_str((uint32_t)value, buf);
+}
+
+/*
+ * Shortest round-trip formatting by the Grisu2 algorithm of Florian Loitsch,
+ * "Printing Floating-Point Numbers Quickly and Accurately with Integers", PLDI 2010.
+ * The digits are the shortest in almost all cases, and always parsed back to the same value.
+ */
+
+typedef struct {
+    uint64_t f;
+    int      e;
+} diy_fp_t;
+
+typedef struct {
+    uint64_t f;
+    int      e;
+    int      k;
+} cached_power_t;
+
+/* binary exponent range of the scaled value, so that its integer part fits in 32 bits */
+#define GRISU_ALPHA                 (-60)
+#define GRISU_GAMMA                 (-32)
+
+#define CACHED_POWER_MIN_DEC_EXP    (-300)
+#define CACHED_POWER_DEC_EXP_STEP   (8)
+
+/* normalized 10^k for k in [-300, 340] with step 8 */
+static const cached_power_t sg_cached_powers[] = {
+    { 0xAB70FE17C79AC6CAULL, -1060, -300 },
+    { 0xFF77B1FCBEBCDC4FULL, -1034, -292 },
+    { 0xBE5691EF416BD60CULL, -1007, -284 },
+    { 0x8DD01FAD907FFC3CULL,  -980, -276 },
+    { 0xD3515C2831559A83ULL,  -954, -268 },
+    { 0x9D71AC8FADA6C9B5ULL,  -927, -260 },
+    { 0xEA9C227723EE8BCBULL,  -901, -252 },
+    { 0xAECC49914078536DULL,  -874, -244 },
+    { 0x823C12795DB6CE57ULL,  -847, -236 },
+    { 0xC21094364DFB5637ULL,  -821, -228 },
+    { 0x9096EA6F3848984FULL,  -794, -220 },
+    { 0xD77485CB25823AC7ULL,  -768, -212 },
+    { 0xA086CFCD97BF97F4ULL,  -741, -204 },
+    { 0xEF340A98172AACE5ULL,  -715, -196 },
+    { 0xB23867FB2A35B28EULL,  -688, -188 },
+    { 0x84C8D4DFD2C63F3BULL,  -661, -180 },
+    { 0xC5DD44271AD3CDBAULL,  -635, -172 },
+    { 0x936B9FCEBB25C996ULL,  -608, -164 },
+    { 0xDBAC6C247D62A584ULL,  -582, -156 },
+    { 0xA3AB66580D5FDAF6ULL,  -555, -148 },
+    { 0xF3E2F893DEC3F126ULL,  -529, -140 },
+    { 0xB5B5ADA8AAFF80B8ULL,  -502, -132 },
+    { 0x87625F056C7C4A8BULL,  -475, -124 },
+    { 0xC9BCFF6034C13053ULL,  -449, -116 },
+    { 0x964E858C91BA2655ULL,  -422, -108 },
+    { 0xDFF9772470297EBDULL,  -396, -100 },
+    { 0xA6DFBD9FB8E5B88FULL,  -369,  -92 },
+    { 0xF8A95FCF88747D94ULL,  -343,  -84 },
+    { 0xB94470938FA89BCFULL,  -316,  -76 },
+    { 0x8A08F0F8BF0F156BULL,  -289,  -68 },
+    { 0xCDB02555653131B6ULL,  -263,  -60 },
+    { 0x993FE2C6D07B7FACULL,  -236,  -52 },
+    { 0xE45C10C42A2B3B06ULL,  -210,  -44 },
+    { 0xAA242499697392D3ULL,  -183,  -36 },
+    { 0xFD87B5F28300CA0EULL,  -157,  -28 },
+    { 0xBCE5086492111AEBULL,  -130,  -20 },
+    { 0x8CBCCC096F5088CCULL,  -103,  -12 },
+    { 0xD1B71758E219652CULL,   -77,   -4 },
+    { 0x9C40000000000000ULL,   -50,    4 },
+    { 0xE8D4A51000000000ULL,   -24,   12 },
+    { 0xAD78EBC5AC620000ULL,     3,   20 },
+    { 0x813F3978F8940984ULL,    30,   28 },
+    { 0xC097CE7BC90715B3ULL,    56,   36 },
+    { 0x8F7E32CE7BEA5C70ULL,    83,   44 },
+    { 0xD5D238A4ABE98068ULL,   109,   52 },
+    { 0x9F4F2726179A2245ULL,   136,   60 },
+    { 0xED63A231D4C4FB27ULL,   162,   68 },
+    { 0xB0DE65388CC8ADA8ULL,   189,   76 },
+    { 0x83C7088E1AAB65DBULL,   216,   84 },
+    { 0xC45D1DF942711D9AULL,   242,   92 },
+    { 0x924D692CA61BE758ULL,   269,  100 },
+    { 0xDA01EE641A708DEAULL,   295,  108 },
+    { 0xA26DA3999AEF774AULL,   322,  116 },
+    { 0xF209787BB47D6B85ULL,   348,  124 },
+    { 0xB454E4A179DD1877ULL,   375,  132 },
+    { 0x865B86925B9BC5C2ULL,   402,  140 },
+    { 0xC83553C5C8965D3DULL,   428,  148 },
+    { 0x952AB45CFA97A0B3ULL,   455,  156 },
+    { 0xDE469FBD99A05FE3ULL,   481,  164 },
+    { 0xA59BC234DB398C25ULL,   508,  172 },
+    { 0xF6C69A72A3989F5CULL,   534,  180 },
+    { 0xB7DCBF5354E9BECEULL,   561,  188 },
+    { 0x88FCF317F22241E2ULL,   588,  196 },
+    { 0xCC20CE9BD35C78A5ULL,   614,  204 },
+    { 0x98165AF37B2153DFULL,   641,  212 },
+    { 0xE2A0B5DC971F303AULL,   667,  220 },
+    { 0xA8D9D1535CE3B396ULL,   694,  228 },
+    { 0xFB9B7CD9A4A7443CULL,   720,  236 },
+    { 0xBB764C4CA7A44410ULL,   747,  244 },
+    { 0x8BAB8EEFB6409C1AULL,   774,  252 },
+    { 0xD01FEF10A657842CULL,   800,  260 },
+    { 0x9B10A4E5E9913129ULL,   827,  268 },
+    { 0xE7109BFBA19C0C9DULL,   853,  276 },
+    { 0xAC2820D9623BF429ULL,   880,  284 },
+    { 0x80444B5E7AA7CF85ULL,   907,  292 },
+    { 0xBF21E44003ACDD2DULL,   933,  300 },
+    { 0x8E679C2F5E44FF8FULL,   960,  308 },
+    { 0xD433179D9C8CB841ULL,   986,  316 },
+    { 0x9E19DB92B4E31BA9ULL,  1013,  324 },
+    { 0xEB96BF6EBADF77D9ULL,  1039,  332 },
+    { 0xAF87023B9BF0EE6BULL,  1066,  340 },
+};
+
+static diy_fp_t _diy_fp_sub(diy_fp_t x, diy_fp_t y)
+{
+    diy_fp_t r = {x.f - y.f, x.e};
+    return r;
+}
+
+/* product rounded to 64 bits */
+static diy_fp_t _diy_fp_mul(diy_fp_t x, diy_fp_t y)
+{
+    uint64_t x_lo = x.f & 0xFFFFFFFFU;
+    uint64_t x_hi = x.f >> 32;
+    uint64_t y_lo = y.f & 0xFFFFFFFFU;
+    uint64_t y_hi = y.f >> 32;
+
+    uint64_t p0 = x_lo * y_lo;
+    uint64_t p1 = x_lo * y_hi;
+    uint64_t p2 = x_hi * y_lo;
+    uint64_t p3 = x_hi * y_hi;
+
+    uint64_t mid = (p0 >> 32) + (p1 & 0xFFFFFFFFU) + (p2 & 0xFFFFFFFFU) + (1U << 31);
+
+    diy_fp_t r = {p3 + (p1 >> 32) + (p2 >> 32) + (mid >> 32), x.e + y.e + 64};
+    return r;
+}
+
+static diy_fp_t _diy_fp_normalize(diy_fp_t x)
+{
+    while ((x.f >> 63) == 0) {
+        x.f <<= 1;
+        x.e--;
+    }
+    return x;
+}
+
+static diy_fp_t _diy_fp_normalize_to(diy_fp_t x, int e)
+{
+    x.f <<= (x.e - e);
+    x.e = e;
+    return x;
+}
+
+/*
+ * Value v = f * 2^e and the boundaries m- and m+ of its rounding interval, for an IEEE number of
+ * precision bits including the hidden bit, biased exponent and fraction.
+ */
+static void _compute_boundaries(uint64_t fraction, int biased_exp, int precision, int bias, diy_fp_t *w,
+                                diy_fp_t *w_minus, diy_fp_t *w_plus)
+{
+    uint64_t hidden_bit = 1ULL << (precision - 1);
+    diy_fp_t v, m_minus, m_plus;
+    bool     lower_is_closer;
+
+    if (biased_exp == 0) {
+        v.f = fraction;
+        v.e = 1 - bias;
+    } else {
+        v.f = fraction + hidden_bit;
+        v.e = biased_exp - bias;
+    }
+
+    /* the lower boundary is closer if v is a power of two, except for the smallest normal */
+    lower_is_closer = (fraction == 0 && biased_exp > 1);
+
+    m_plus.f = 2 * v.f + 1;
+    m_plus.e = v.e - 1;
+    if (lower_is_closer) {
+        m_minus.f = 4 * v.f - 1;
+        m_minus.e = v.e - 2;
+    } else {
+        m_minus.f = 2 * v.f - 1;
+        m_minus.e = v.e - 1;
+    }
+
+    *w_plus  = _diy_fp_normalize(m_plus);
+    *w_minus = _diy_fp_normalize_to(m_minus, w_plus->e);
+    *w       = _diy_fp_normalize(v);
+}
+
+/* cached power c = 10^-k, so that the binary exponent of w * c is in [GRISU_ALPHA, GRISU_GAMMA] */
+static cached_power_t _get_cached_power(int e)
+{
+    int f = GRISU_ALPHA - e - 1;
+    int k = (f * 78913) / (1 << 18) + (f > 0);
+    int index = (-CACHED_POWER_MIN_DEC_EXP + k + (CACHED_POWER_DEC_EXP_STEP - 1)) / CACHED_POWER_DEC_EXP_STEP;
+
+    return sg_cached_powers[index];
+}
+
+/* largest power of ten not greater than n, n > 0, returns number of digits */
+static int _find_largest_pow10(uint32_t n, uint32_t *pow10)
+{
+    int      digits = 1;
+    uint32_t p      = 1;
+
+    while (digits < 10 && n / p >= 10) {
+        p *= 10;
+        digits++;
+    }
+
+    *pow10 = p;
+    return digits;
+}
+
+/* move the last digit closer to w, while it stays in the rounding interval */
+static void _grisu_round(char *buf, int len, uint64_t dist, uint64_t delta, uint64_t rest, uint64_t ten_k)
+{
+    while (rest < dist && delta - rest >= ten_k && (rest + ten_k < dist || dist - rest > rest + ten_k - dist)) {
+        buf[len - 1]--;
+        rest += ten_k;
+    }
+}
+
+/*
+ * generate the shortest digits of a number in [M-, M+], moved close to w if round, or the digits of M+.
+ * maybe_shorter is set if a digit before the last would have ended the digits of the interval widened by
+ * 2 units at each end, i.e. the interval shrunk by 1 ulp and widened by 1 ulp.
+ */
+static void _grisu_digit_gen(char *buf, int *len, int *dec_exp, diy_fp_t m_minus, diy_fp_t w, diy_fp_t m_plus,
+                             bool round, bool *maybe_shorter)
+{
+    uint64_t delta = _diy_fp_sub(m_plus, m_minus).f;
+    uint64_t dist  = _diy_fp_sub(m_plus, w).f;
+    int      shift = -m_plus.e;
+    uint64_t one   = 1ULL << shift;
+    uint32_t p1    = (uint32_t)(m_plus.f >> shift);
+    uint64_t p2    = m_plus.f & (one - 1);
+    uint64_t err   = 2;
+    uint32_t pow10;
+    int      n = _find_largest_pow10(p1, &pow10);
+    int      m = 0;
+
+    *maybe_shorter = false;
+
+    /* integral part */
+    while (n > 0) {
+        uint64_t rest;
+
+        buf[(*len)++] = '0' + p1 / pow10;
+        p1 %= pow10;
+        n--;
+
+        rest = ((uint64_t)p1 << shift) + p2;
+        if (rest <= delta) {
+            *dec_exp += n;
+            if (round) {
+                _grisu_round(buf, *len, dist, delta, rest, (uint64_t)pow10 << shift);
+            }
+            return;
+        }
+        if (rest <= delta + err || rest + err >= ((uint64_t)pow10 << shift)) {
+            *maybe_shorter = true;
+        }
+        pow10 /= 10;
+    }
+
+    /* fractional part */
+    for (;;) {
+        p2 *= 10;
+        buf[(*len)++] = '0' + (char)(p2 >> shift);
+        p2 &= one - 1;
+        m++;
+
+        delta *= 10;
+        dist *= 10;
+        err *= 10;
+        if (p2 <= delta) {
+            break;
+        }
+        if (p2 <= delta + err || p2 + err >= one) {
+            *maybe_shorter = true;
+        }
+    }
+
+    *dec_exp -= m;
+    if (round) {
+        _grisu_round(buf, *len, dist, delta, p2, one);
+    }
+}
+
+/*
+ * digits of value = digits * 10^dec_exp, returns number of digits. The interval is widened by ulp ulps of
+ * the multiplication, a negative ulp shrinks it so that the digits are always inside.
+ */
+static int _grisu2(char *buf, int *dec_exp, diy_fp_t w, diy_fp_t w_minus, diy_fp_t w_plus, int ulp,
+                   bool *maybe_shorter)
+{
+    cached_power_t cached = _get_cached_power(w_plus.e);
+    diy_fp_t       c      = {cached.f, cached.e};
+    diy_fp_t       m_minus, m_plus;
+    int            len = 0;
+
+    w       = _diy_fp_mul(w, c);
+    m_minus = _diy_fp_mul(w_minus, c);
+    m_plus  = _diy_fp_mul(w_plus, c);
+
+    m_minus.f -= ulp;
+    m_plus.f += ulp;
+
+    *dec_exp = -cached.k;
+    _grisu_digit_gen(buf, &len, dec_exp, m_minus, w, m_plus, ulp < 0, maybe_shorter);
+    return len;
+}
+
+/* digits * 10^dec_exp is parsed back to the IEEE number of bits, float if precision is 24 */
+static bool _digits_round_trip(const char *digits, int len, int dec_exp, uint64_t bits, int precision)
+{
+    char str[UTILS_DOUBLE_STR_LEN + 8];
+
+    /* integer mantissa and no decimal point, as the slow path of parsing, does not depend on locale */
+    memcpy(str, digits, len);
+    str[len] = 'e';
+    utils_int32_to_str(dec_exp, str + len + 1);
+
+    if (precision == 24) {
+        float    f = strtof(str, NULL);
+        uint32_t f_bits;
+        memcpy(&f_bits, &f, sizeof(f_bits));
+        return f_bits == (uint32_t)bits;
+    } else {
+        double   d = strtod(str, NULL);
+        uint64_t d_bits;
+        memcpy(&d_bits, &d, sizeof(d_bits));
+        return d_bits == bits;
+    }
+}
+
+/*
+ * The interval shrunk for the error of multiplication makes Grisu2 miss the shortest digits in about
+ * 0.1% of numbers, when one end of the interval is that close to a shorter number. For those only, the
+ * digits of the widened interval are generated, and a shorter number is parsed back to check it is inside.
+ * Such a number is the upper end of the widened interval truncated, or one unit less.
+ */
+static int _grisu2_shortest(char *buf, int *dec_exp, diy_fp_t w, diy_fp_t w_minus, diy_fp_t w_plus,
+                            uint64_t bits, int precision)
+{
+    char shorter[UTILS_DOUBLE_STR_LEN];
+    int  shorter_exp;
+    int  shorter_len;
+    bool maybe_shorter;
+    int  len = _grisu2(buf, dec_exp, w, w_minus, w_plus, -1, &maybe_shorter);
+
+    if (!maybe_shorter) {
+        return len;
+    }
+
+    shorter_len = _grisu2(shorter, &shorter_exp, w, w_minus, w_plus, 1, &maybe_shorter);
+    if (shorter_len >= len) {
+        return len;
+    }
+
+    if (!_digits_round_trip(shorter, shorter_len, shorter_exp, bits, precision)) {
+        /* the last digit of M+ is not 0, otherwise the digit before would have been the end */
+        shorter[shorter_len - 1]--;
+        if (!_digits_round_trip(shorter, shorter_len, shorter_exp, bits, precision)) {
+            return len;
+        }
+        while (shorter_len > 1 && shorter[shorter_len - 1] == '0') {
+            shorter_len--;
+            shorter_exp++;
+        }
+    }
+
+    memcpy(buf, shorter, shorter_len);
+    *dec_exp = shorter_exp;
+    return shorter_len;
+}
+
+/* format digits * 10^dec_exp in buf, which holds the digits at the beginning */
+static int _format_digits(char *buf, int len, int dec_exp)
+{
+    int n = len + dec_exp;  /* position of decimal point */
+
+    if (len <= n && n <= NUMBER_FIXED_MAX_EXP) {
+        /* integer, e.g. 1234e2 -> 123400 */
+        memset(buf + len, '0', n - len);
+        buf[n] = '\0';
+        return n;
+    }
+
+    if (0 < n && n <= NUMBER_FIXED_MAX_EXP) {
+        /* e.g. 1234e-2 -> 12.34 */
+        memmove(buf + n + 1, buf + n, len - n);
+        buf[n] = '.';
+        buf[len + 1] = '\0';
+        return len + 1;
+    }
+
+    if (NUMBER_FIXED_MIN_EXP < n && n <= 0) {
+        /* e.g. 1234e-6 -> 0.001234 */
+        memmove(buf + 2 - n, buf, len);
+        buf[0] = '0';
+        buf[1] = '.';
+        memset(buf + 2, '0', -n);
+        buf[2 - n + len] = '\0';
+        return 2 - n + len;
+    }
+
+    /* scientific, e.g. 1234e30 -> 1.234e+33 */
+    if (len > 1) {
+        memmove(buf + 2, buf + 1, len - 1);
+        buf[1] = '.';
+        len++;
+    }
+    buf[len++] = 'e';
+    if (n - 1 >= 0) {
+        buf[len++] = '+';
+    }
+    len += utils_int32_to_str(n - 1, buf + len);
+    return len;
+}
+
+static int _format_ieee(bool neg, uint64_t fraction, int biased_exp, int precision, int bias, char *buf)
+{
+    diy_fp_t w, w_minus, w_plus;
+    int      dec_exp = 0;
+    int      len;
+    char    *p = buf;
+
+    if (neg) {
+        *p++ = '-';
+    }
+
+    if (fraction == 0 && biased_exp == 0) {
+        p[0] = '0';
+        p[1] = '\0';
+        return (int)(p - buf) + 1;
+    }
+
+    _compute_boundaries(fraction, biased_exp, precision, bias, &w, &w_minus, &w_plus);
+    len = _grisu2_shortest(p, &dec_exp, w, w_minus, w_plus, ((uint64_t)biased_exp << (precision - 1)) | fraction,
+                           precision);
+
+    return (int)(p - buf) + _format_digits(p, len, dec_exp);
+}
+
+static int _format_null(char *buf)
+{
+    memcpy(buf, "null", 5);
+    return 4;
+}
+
+int utils_double_to_str(double value, char *buf)
+{
+    uint64_t bits;
+    int      biased_exp;
+
+    memcpy(&bits, &value, sizeof(bits));
+    biased_exp = (int)((bits >> 52) & 0x7FF);
+    if (biased_exp == 0x7FF) {
+        return _format_null(buf);
+    }
+
+    return _format_ieee((bits >> 63) != 0, bits & ((1ULL << 52) - 1), biased_exp, 53, 1075, buf);
+}
+
+int utils_float_to_str(float value, char *buf)
+{
+    uint32_t bits;
+    int      biased_exp;
+
+    memcpy(&bits, &value, sizeof(bits));
+    biased_exp = (int)((bits >> 23) & 0xFF);
+    if (biased_exp == 0xFF) {
+        return _format_null(buf);
+    }
+
+    /* boundaries of float, so that the digits are the shortest for float rather than double */
+    return _format_ieee((bits >> 31) != 0, bits & ((1U << 23) - 1), biased_exp, 24, 150, buf);
+}
+
+#ifdef __cplusplus
+}
+#endif
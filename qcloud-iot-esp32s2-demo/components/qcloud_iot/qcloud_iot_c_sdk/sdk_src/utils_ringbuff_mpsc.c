@@ -0,0 +1,127 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "qcloud_iot_import.h"
+#include "utils_ringbuff_mpsc.h"
+
+/*
+ * Slot i serves positions i, i + count, i + 2 * count...
+ * seq == pos:      free, position pos may be claimed by producer
+ * seq == pos + 1:  filled, element of position pos may be consumed
+ * After consumed, seq is set to pos + count for the producer one lap later.
+ * Positions and sequence numbers wrap around, they are compared by signed difference.
+ */
+
+int mpsc_ring_init(sMpscRing *ring, uint32_t count, uint32_t elem_size)
+{
+    uint32_t i;
+
+    if (0 == count || 0 != (count & (count - 1)) || 0 == elem_size) {
+        return RINGBUFF_ERR;
+    }
+
+    ring->seq = (_Atomic uint32_t *)HAL_Malloc(count * sizeof(_Atomic uint32_t));
+    ring->data = (unsigned char *)HAL_Malloc(count * elem_size);
+    if (NULL == ring->seq || NULL == ring->data) {
+        HAL_Free(ring->seq);
+        HAL_Free(ring->data);
+        ring->seq = NULL;
+        ring->data = NULL;
+        return RINGBUFF_ERR;
+    }
+
+    for (i = 0; i < count; i++) {
+        atomic_init(&ring->seq[i], i);
+    }
+    atomic_init(&ring->head, 0);
+    ring->tail = 0;
+    ring->mask = count - 1;
+    ring->elem_size = elem_size;
+
+    return RINGBUFF_OK;
+}
+
+void mpsc_ring_deinit(sMpscRing *ring)
+{
+    HAL_Free(ring->seq);
+    HAL_Free(ring->data);
+    ring->seq = NULL;
+    ring->data = NULL;
+}
+
+int mpsc_ring_push(sMpscRing *ring, const void *elem)
+{
+    uint32_t pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t slot, seq;
+    int32_t diff;
+
+    for (;;) {
+        slot = pos & ring->mask;
+        seq = atomic_load_explicit(&ring->seq[slot], memory_order_acquire);
+        diff = (int32_t)(seq - pos);
+
+        if (0 == diff) {
+            /* on failure pos is reloaded with the current head */
+            if (atomic_compare_exchange_weak_explicit(&ring->head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            /* slot still holds the element of last lap */
+            return RINGBUFF_FULL;
+        } else {
+            /* claimed by another producer */
+            pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        }
+    }
+
+    memcpy(ring->data + slot * ring->elem_size, elem, ring->elem_size);
+    atomic_store_explicit(&ring->seq[slot], pos + 1, memory_order_release);
+
+    return RINGBUFF_OK;
+}
+
+int mpsc_ring_peek(sMpscRing *ring, void *elem)
+{
+    uint32_t slot = ring->tail & ring->mask;
+    uint32_t seq = atomic_load_explicit(&ring->seq[slot], memory_order_acquire);
+
+    /* not filled yet, or the producer claimed it is still copying */
+    if ((int32_t)(seq - (ring->tail + 1)) < 0) {
+        return RINGBUFF_EMPTY;
+    }
+
+    memcpy(elem, ring->data + slot * ring->elem_size, ring->elem_size);
+
+    return RINGBUFF_OK;
+}
+
+void mpsc_ring_pop(sMpscRing *ring)
+{
+    uint32_t slot = ring->tail & ring->mask;
+
+    atomic_store_explicit(&ring->seq[slot], ring->tail + ring->mask + 1, memory_order_release);
+    ring->tail++;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,324 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "utils_timer_wheel.h"
+
+#include "qcloud_iot_import.h"
+#include "qcloud_iot_export_error.h"
+#include "qcloud_iot_export_log.h"
+#include "utils_param_check.h"
+
+#define TIMER_WHEEL_LEVEL_MASK      (TIMER_WHEEL_LEVEL_SIZE - 1)
+
+static void _list_init(TimerWheelList *list)
+{
+    list->next = list;
+    list->prev = list;
+}
+
+static bool _list_empty(TimerWheelList *list)
+{
+    return list->next == list;
+}
+
+static void _list_add_tail(TimerWheelList *list, TimerWheelList *node)
+{
+    node->prev = list->prev;
+    node->next = list;
+    list->prev->next = node;
+    list->prev = node;
+}
+
+static void _list_unlink(TimerWheelList *node)
+{
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->next = NULL;
+    node->prev = NULL;
+}
+
+/* move all nodes of list to the head of empty list */
+static void _list_splice(TimerWheelList *list, TimerWheelList *head)
+{
+    _list_init(head);
+    if (_list_empty(list)) {
+        return;
+    }
+
+    head->next = list->next;
+    head->prev = list->prev;
+    head->next->prev = head;
+    head->prev->next = head;
+    _list_init(list);
+}
+
+static void _entry_fire(TimerWheelEntry *entry)
+{
+    entry->fired = true;
+    _list_add_tail(entry->expired_list, &entry->link);
+}
+
+/* put entry into the slot of its deadline, relative to the next tick to be processed */
+static void _internal_add(TimerWheel *wheel, TimerWheelEntry *entry)
+{
+    uint32_t idx = entry->expires - wheel->tick;
+    int level;
+
+    /* deadline is passed already */
+    if ((int32_t)idx < 0) {
+        _entry_fire(entry);
+        return;
+    }
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS - 1; level++) {
+        if (idx < (1UL << ((level + 1) * TIMER_WHEEL_LEVEL_BITS))) {
+            break;
+        }
+    }
+
+    entry->fired = false;
+    _list_add_tail(&wheel->slots[level][(entry->expires >> (level * TIMER_WHEEL_LEVEL_BITS)) & TIMER_WHEEL_LEVEL_MASK],
+                   &entry->link);
+    wheel->count++;
+}
+
+/* move entries of upper level slot down to lower levels */
+static int _cascade(TimerWheel *wheel, int level, int index)
+{
+    TimerWheelList head;
+    TimerWheelEntry *entry;
+
+    _list_splice(&wheel->slots[level][index], &head);
+    while (!_list_empty(&head)) {
+        entry = TIMER_WHEEL_ENTRY(head.next, TimerWheelEntry, link);
+        _list_unlink(&entry->link);
+        wheel->count--;
+        _internal_add(wheel, entry);
+    }
+
+    return index;
+}
+
+static void _expire_slot(TimerWheel *wheel, TimerWheelList *slot)
+{
+    TimerWheelEntry *entry;
+
+    while (!_list_empty(slot)) {
+        entry = TIMER_WHEEL_ENTRY(slot->next, TimerWheelEntry, link);
+        _list_unlink(&entry->link);
+        wheel->count--;
+        _entry_fire(entry);
+    }
+}
+
+/* take all entries out of the slots and add them again relative to current tick, the ones due are fired */
+static void _rehash(TimerWheel *wheel)
+{
+    TimerWheelList head;
+    TimerWheelList *slot;
+    TimerWheelEntry *entry;
+    int level, index;
+
+    _list_init(&head);
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (index = 0; index < TIMER_WHEEL_LEVEL_SIZE; index++) {
+            slot = &wheel->slots[level][index];
+            while (!_list_empty(slot)) {
+                entry = TIMER_WHEEL_ENTRY(slot->next, TimerWheelEntry, link);
+                _list_unlink(&entry->link);
+                _list_add_tail(&head, &entry->link);
+            }
+        }
+    }
+
+    wheel->count = 0;
+    wheel->tick = wheel->jiffies + 1;
+    while (!_list_empty(&head)) {
+        entry = TIMER_WHEEL_ENTRY(head.next, TimerWheelEntry, link);
+        _list_unlink(&entry->link);
+        _internal_add(wheel, entry);
+    }
+}
+
+/* advance current tick to now, and process all the ticks passed */
+static void _run(TimerWheel *wheel)
+{
+    uint32_t elapsed = HAL_GetTimeMs() - wheel->last_ms;
+    uint32_t ticks = elapsed / TIMER_WHEEL_TICK_MS;
+    int level, index;
+
+    wheel->jiffies += ticks;
+    wheel->last_ms += ticks * TIMER_WHEEL_TICK_MS;
+
+    /* stepping is O(elapsed ticks), after a long gap re-add all pending entries at once instead */
+    if (wheel->count > 0 && (int32_t)(wheel->jiffies - wheel->tick) >= TIMER_WHEEL_LEVEL_SIZE) {
+        _rehash(wheel);
+    }
+
+    while (wheel->count > 0 && (int32_t)(wheel->jiffies - wheel->tick) >= 0) {
+        index = wheel->tick & TIMER_WHEEL_LEVEL_MASK;
+        if (0 == index) {
+            for (level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+                if (0 != _cascade(wheel, level,
+                                  (wheel->tick >> (level * TIMER_WHEEL_LEVEL_BITS)) & TIMER_WHEEL_LEVEL_MASK)) {
+                    break;
+                }
+            }
+        }
+
+        _expire_slot(wheel, &wheel->slots[0][index]);
+        wheel->tick++;
+    }
+
+    /* nothing to process in empty wheel, skip the idle ticks */
+    if (0 == wheel->count) {
+        wheel->tick = wheel->jiffies + 1;
+    }
+}
+
+int timer_wheel_init(TimerWheel *wheel)
+{
+    int level, index;
+
+    POINTER_SANITY_CHECK(wheel, QCLOUD_ERR_INVAL);
+
+    memset(wheel, 0, sizeof(TimerWheel));
+
+    wheel->lock = HAL_MutexCreate();
+    if (NULL == wheel->lock) {
+        Log_e("create timer wheel lock failed");
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (index = 0; index < TIMER_WHEEL_LEVEL_SIZE; index++) {
+            _list_init(&wheel->slots[level][index]);
+        }
+    }
+
+    wheel->last_ms = HAL_GetTimeMs();
+    wheel->jiffies = 0;
+    wheel->tick = 1;
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+void timer_wheel_deinit(TimerWheel *wheel)
+{
+    if (NULL == wheel || NULL == wheel->lock) {
+        return;
+    }
+
+    HAL_MutexDestroy(wheel->lock);
+    wheel->lock = NULL;
+    wheel->count = 0;
+}
+
+void timer_wheel_list_init(TimerWheelList *list)
+{
+    _list_init(list);
+}
+
+void timer_wheel_entry_init(TimerWheelEntry *entry)
+{
+    memset(entry, 0, sizeof(TimerWheelEntry));
+}
+
+static void _del(TimerWheel *wheel, TimerWheelEntry *entry)
+{
+    if (NULL == entry->link.next) {
+        return;
+    }
+
+    _list_unlink(&entry->link);
+    if (!entry->fired) {
+        wheel->count--;
+    }
+    entry->fired = false;
+}
+
+void timer_wheel_add(TimerWheel *wheel, TimerWheelEntry *entry, uint32_t timeout_ms, TimerWheelList *expired_list)
+{
+    uint32_t ticks;
+
+    if (NULL == wheel || NULL == entry || NULL == expired_list) {
+        return;
+    }
+
+    HAL_MutexLock(wheel->lock);
+
+    _del(wheel, entry);
+    _run(wheel);
+
+    /* round up, part of current tick passed is counted in */
+    ticks = timeout_ms / TIMER_WHEEL_TICK_MS +
+            (HAL_GetTimeMs() - wheel->last_ms + timeout_ms % TIMER_WHEEL_TICK_MS + TIMER_WHEEL_TICK_MS - 1) /
+            TIMER_WHEEL_TICK_MS;
+    if (ticks > TIMER_WHEEL_MAX_TICKS) {
+        Log_w("timeout %u ms is too long for timer wheel, cut to %lu ms", timeout_ms,
+              TIMER_WHEEL_MAX_TICKS * TIMER_WHEEL_TICK_MS);
+        ticks = TIMER_WHEEL_MAX_TICKS;
+    }
+
+    entry->expires = wheel->jiffies + ticks;
+    entry->expired_list = expired_list;
+    _internal_add(wheel, entry);
+
+    HAL_MutexUnlock(wheel->lock);
+}
+
+void timer_wheel_del(TimerWheel *wheel, TimerWheelEntry *entry)
+{
+    if (NULL == wheel || NULL == entry) {
+        return;
+    }
+
+    HAL_MutexLock(wheel->lock);
+    _del(wheel, entry);
+    HAL_MutexUnlock(wheel->lock);
+}
+
+TimerWheelEntry *timer_wheel_pop_expired(TimerWheel *wheel, TimerWheelList *expired_list)
+{
+    TimerWheelEntry *entry = NULL;
+
+    if (NULL == wheel || NULL == expired_list) {
+        return NULL;
+    }
+
+    HAL_MutexLock(wheel->lock);
+
+    _run(wheel);
+
+    if (!_list_empty(expired_list)) {
+        entry = TIMER_WHEEL_ENTRY(expired_list->next, TimerWheelEntry, link);
+        _list_unlink(&entry->link);
+        entry->fired = false;
+    }
+
+    HAL_MutexUnlock(wheel->lock);
+
+    return entry;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,249 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "qcloud_iot_export.h"
+#include "qcloud_iot_import.h"
+#include "test_broker.h"
+#include "test_util.h"
+
+/*
+ * Contention of sensor tasks publishing while another task yields under inbound QoS1 load.
+ * "direct" calls IOT_MQTT_Publish, which takes lock_write_buf and writes the socket, so the sensor
+ * tasks wait for each other and for the ACKs written by yield. "deferred" pushes into the lock-free
+ * ring with IOT_MQTT_PublishDeferred. Time spent in the call by the sensor tasks goes to stdout as JSON.
+ */
+
+#define TEST_PRODUCT_ID     "TESTPRD001"
+#define TEST_DEVICE_NAME    "dev_bench"
+#define TEST_DEVICE_SECRET  "dGVzdC1kZXZpY2Utc2VjcmV0"
+#define FLOOD_TOPIC         TEST_PRODUCT_ID "/" TEST_DEVICE_NAME "/control"
+#define UP_TOPIC            TEST_PRODUCT_ID "/" TEST_DEVICE_NAME "/data"
+
+#define SENSORS             4
+#define REPORTS_PER_SENSOR  2000
+#define REPORT_INTERVAL_US  1000
+#define REPORT_LEN          64
+#define FLOOD_BURST         16          /* messages each millisecond */
+#define FLOOD_PAYLOAD_LEN   512
+
+typedef struct {
+    const char  *mode;
+    uint64_t    call_ns[SENSORS * REPORTS_PER_SENSOR];
+    int         full_retries;           /* deferred ring found full */
+    int         failed;
+    int         arrived;
+} BenchRun;
+
+static BenchRun         sg_runs[2];
+static BenchRun         *sg_run;
+static TestBroker       *sg_broker;
+static void             *sg_client;
+static bool             sg_deferred;
+static volatile bool    sg_running;
+static volatile bool    sg_subscribed;
+static pthread_mutex_t  sg_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* deferred publishes are not copied, each report keeps its own buffer */
+static char             sg_reports[SENSORS][REPORTS_PER_SENSOR][REPORT_LEN];
+
+static void _on_publish(TestBroker *broker, const char *topic, const char *payload, size_t len, void *context)
+{
+    if (!strcmp(topic, UP_TOPIC)) {
+        pthread_mutex_lock(&sg_lock);
+        sg_run->arrived++;
+        pthread_mutex_unlock(&sg_lock);
+    }
+}
+
+static void _on_message(void *pClient, MQTTMessage *message, void *pUserData)
+{
+}
+
+static void _on_sub_event(void *pClient, MQTTEventType event_type, void *pUserData)
+{
+    if (event_type == MQTT_EVENT_SUBCRIBE_SUCCESS) {
+        sg_subscribed = true;
+    }
+}
+
+static void *_sensor(void *arg)
+{
+    int sensor = (int)(intptr_t)arg;
+    PublishParams params = DEFAULT_PUB_PARAMS;
+    uint64_t start_ns, next_ns = test_now_ns();
+    int full_retries = 0, failed = 0;
+    int i, rc;
+
+    params.qos = QOS0;
+    for (i = 0; i < REPORTS_PER_SENSOR; i++) {
+        while (test_now_ns() < next_ns) {
+            usleep(50);
+        }
+        next_ns += REPORT_INTERVAL_US * 1000ull;
+
+        memset(sg_reports[sensor][i], 'r', REPORT_LEN);
+        params.payload = sg_reports[sensor][i];
+        params.payload_len = REPORT_LEN;
+
+        start_ns = test_now_ns();
+        if (sg_deferred) {
+            while ((rc = IOT_MQTT_PublishDeferred(sg_client, UP_TOPIC, &params, NULL, NULL)) ==
+                   QCLOUD_ERR_MQTT_DEFERRED_FULL) {
+                full_retries++;
+                usleep(100);
+                start_ns = test_now_ns();
+            }
+        } else {
+            rc = IOT_MQTT_Publish(sg_client, UP_TOPIC, &params);
+        }
+        sg_run->call_ns[sensor * REPORTS_PER_SENSOR + i] = test_now_ns() - start_ns;
+        if (rc < 0) {
+            failed++;
+        }
+    }
+
+    pthread_mutex_lock(&sg_lock);
+    sg_run->full_retries += full_retries;
+    sg_run->failed += failed;
+    pthread_mutex_unlock(&sg_lock);
+    return NULL;
+}
+
+static void *_flood_thread(void *arg)
+{
+    static char payload[FLOOD_PAYLOAD_LEN];
+    int i;
+
+    memset(payload, 'f', sizeof(payload));
+    while (sg_running) {
+        for (i = 0; i < FLOOD_BURST; i++) {
+            test_broker_publish(sg_broker, FLOOD_TOPIC, payload, sizeof(payload), 1);
+        }
+        usleep(1000);
+    }
+    return NULL;
+}
+
+static void *_yield_thread(void *arg)
+{
+    while (sg_running) {
+        IOT_MQTT_Yield(sg_client, 10);
+    }
+    return NULL;
+}
+
+static int _cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int _run(BenchRun *run, bool deferred)
+{
+    MQTTInitParams init_params = DEFAULT_MQTTINIT_PARAMS;
+    SubscribeParams sub_params = DEFAULT_SUB_PARAMS;
+    pthread_t sensors[SENSORS], flood, yield;
+    int i;
+
+    sg_run = run;
+    sg_deferred = deferred;
+    run->mode = deferred ? "deferred" : "direct";
+    sg_subscribed = false;
+
+    init_params.product_id = TEST_PRODUCT_ID;
+    init_params.device_name = TEST_DEVICE_NAME;
+    init_params.device_secret = TEST_DEVICE_SECRET;
+    init_params.command_timeout = 2000;
+    sg_client = IOT_MQTT_Construct(&init_params);
+    TEST_ASSERT(sg_client != NULL);
+
+    sub_params.qos = QOS1;
+    sub_params.on_message_handler = _on_message;
+    sub_params.on_sub_event_handler = _on_sub_event;
+    TEST_ASSERT(IOT_MQTT_Subscribe(sg_client, FLOOD_TOPIC, &sub_params) >= 0);
+    for (i = 0; i < 500 && !sg_subscribed; i++) {
+        IOT_MQTT_Yield(sg_client, 10);
+    }
+    TEST_ASSERT(sg_subscribed);
+
+    sg_running = true;
+    TEST_ASSERT_EQ(0, pthread_create(&yield, NULL, _yield_thread, NULL));
+    TEST_ASSERT_EQ(0, pthread_create(&flood, NULL, _flood_thread, NULL));
+    for (i = 0; i < SENSORS; i++) {
+        TEST_ASSERT_EQ(0, pthread_create(&sensors[i], NULL, _sensor, (void *)(intptr_t)i));
+    }
+    for (i = 0; i < SENSORS; i++) {
+        pthread_join(sensors[i], NULL);
+    }
+
+    /* deferred ones still in ring are published by the yield thread */
+    for (i = 0; i < 300 && run->arrived + run->failed < SENSORS * REPORTS_PER_SENSOR; i++) {
+        usleep(10000);
+    }
+    sg_running = false;
+    pthread_join(flood, NULL);
+    pthread_join(yield, NULL);
+    IOT_MQTT_Destroy(&sg_client);
+
+    TEST_ASSERT_EQ(0, run->failed);
+    TEST_ASSERT_EQ(SENSORS * REPORTS_PER_SENSOR, run->arrived);
+    qsort(run->call_ns, SENSORS * REPORTS_PER_SENSOR, sizeof(uint64_t), _cmp_u64);
+    return 0;
+}
+
+static void _print_run(const BenchRun *run, bool last)
+{
+    int n = SENSORS * REPORTS_PER_SENSOR;
+
+    printf("{\"mode\":\"%s\",\"full_retries\":%d,\"call\":{\"p50_us\":%.2f,\"p99_us\":%.2f,\"max_us\":%.1f}}%s",
+           run->mode, run->full_retries, run->call_ns[n / 2] / 1e3, run->call_ns[n * 99 / 100] / 1e3,
+           run->call_ns[n - 1] / 1e3, last ? "" : ",");
+}
+
+static int bench_deferred_publish(void)
+{
+    TestBrokerParams broker_params = {MQTT_SERVER_PORT_NOTLS, _on_publish, NULL, NULL, 0};
+
+    sg_broker = test_broker_start(&broker_params);
+    TEST_ASSERT(sg_broker != NULL);
+
+    TEST_ASSERT_EQ(0, _run(&sg_runs[0], false));
+    TEST_ASSERT_EQ(0, _run(&sg_runs[1], true));
+    test_broker_stop(sg_broker);
+
+    printf("{\"bench\":\"mqtt_deferred_publish\",\"sensors\":%d,\"reports_per_sensor\":%d,\"interval_us\":%d,"
+           "\"flood\":{\"msgs_per_ms\":%d,\"payload_len\":%d},\"runs\":[",
+           SENSORS, REPORTS_PER_SENSOR, REPORT_INTERVAL_US, FLOOD_BURST, FLOOD_PAYLOAD_LEN);
+    _print_run(&sg_runs[0], false);
+    _print_run(&sg_runs[1], true);
+    printf("]}\n");
+
+    return 0;
+}
+
+int main(void)
+{
+    IOT_Log_Set_Level(eLOG_ERROR);
+    alarm(120);
+
+    TEST_RUN(bench_deferred_publish);
+    return 0;
+}
@@ -0,0 +1,179 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "qcloud_iot_export_log.h"
+#include "lite-utils.h"
+#include "data_template_client.h"
+#include "data_template_client_json.h"
+#include "test_util.h"
+
+/*
+ * Parsing of representative control, get_status reply and action messages: one tokenize and the parse_*
+ * helpers on the token index, against one LITE_json_value_of scan and copy per field, as it was before.
+ */
+
+#define ROUNDS  20000
+
+static const char sg_control[] =
+    "{\"method\":\"control\",\"clientToken\":\"AAAAAAAAAA-1234\",\"params\":{\"power_switch\":1,\"color\":2,"
+    "\"brightness\":73,\"name\":\"living room\",\"temperature\":21.5,\"mode\":{\"auto\":true,\"level\":3}}}";
+
+static const char sg_reply[] =
+    "{\"method\":\"get_status_reply\",\"clientToken\":\"AAAAAAAAAA-1235\",\"code\":0,\"status\":\"success\","
+    "\"data\":{\"reported\":{\"power_switch\":0,\"color\":1,\"brightness\":50,\"name\":\"bedroom\"},"
+    "\"control\":{\"power_switch\":1,\"color\":2,\"brightness\":73,\"name\":\"living room\"}}}";
+
+static const char sg_action[] =
+    "{\"method\":\"action\",\"clientToken\":\"AAAAAAAAAA-1236\",\"actionId\":\"light_blink\","
+    "\"timestamp\":1602915123,\"params\":{\"time\":5,\"color\":\"red\",\"total_time\":30}}";
+
+typedef struct {
+    const char *name;
+    const char *json;
+    /* fields looked up by the downstream handler of the message */
+    const char *fields[5];
+} ParseCase;
+
+static const ParseCase sg_cases[] = {
+    {"control", sg_control, {METHOD_FIELD, CLIENT_TOKEN_FIELD, CMD_CONTROL_PARA, NULL}},
+    {"reply", sg_reply, {METHOD_FIELD, CLIENT_TOKEN_FIELD, REPLY_CODE, REPLY_STATUS, GET_CONTROL_PARA}},
+    {"action", sg_action, {CLIENT_TOKEN_FIELD, ACTION_ID_FIELD, TIME_STAMP_FIELD, CMD_CONTROL_PARA, NULL}},
+};
+
+#define CASE_COUNT (sizeof(sg_cases) / sizeof(sg_cases[0]))
+
+/* the parse_* calls of the downstream handlers, on a message tokenized once */
+static int _parse_by_tokens(TemplateJsonDoc *pDoc, char *json, int kind)
+{
+    char        method[32], token[MAX_SIZE_OF_CLIENT_TOKEN + 1], action_id[32];
+    int32_t     code, timestamp;
+    json_span_t status;
+    int         object;
+
+    if (template_json_parse(pDoc, json) != QCLOUD_RET_SUCCESS) {
+        return 1;
+    }
+
+    switch (kind) {
+        case 0:
+            return !(parse_template_method_type(pDoc, method, sizeof(method)) &&
+                     parse_client_token(pDoc, token, sizeof(token)) && parse_template_cmd_control(pDoc, &object));
+        case 1:
+            return !(parse_template_method_type(pDoc, method, sizeof(method)) &&
+                     parse_client_token(pDoc, token, sizeof(token)) && parse_code_return(pDoc, &code) &&
+                     parse_status_return(pDoc, &status) && parse_template_get_control(pDoc, &object));
+        default:
+            return !(parse_client_token(pDoc, token, sizeof(token)) &&
+                     parse_action_id(pDoc, action_id, sizeof(action_id)) && parse_time_stamp(pDoc, &timestamp) &&
+                     parse_action_input(pDoc, &object));
+    }
+}
+
+/* one scan from the start of the message and one allocated copy per field */
+static int _parse_per_field(const ParseCase *pCase, char *json)
+{
+    char *value;
+    int   i;
+
+    for (i = 0; i < 5 && pCase->fields[i] != NULL; i++) {
+        value = LITE_json_value_of((char *)pCase->fields[i], json);
+        if (value == NULL) {
+            return 1;
+        }
+        HAL_Free(value);
+    }
+
+    return 0;
+}
+
+static int test_parse_fields(void)
+{
+    static TemplateJsonDoc doc;
+    char        json[512], token[MAX_SIZE_OF_CLIENT_TOKEN + 1], action_id[32];
+    int32_t     code, timestamp;
+    json_span_t status;
+    int         object;
+
+    strcpy(json, sg_reply);
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, template_json_parse(&doc, json));
+    TEST_ASSERT(parse_code_return(&doc, &code));
+    TEST_ASSERT_EQ(0, code);
+    TEST_ASSERT(parse_status_return(&doc, &status));
+    TEST_ASSERT(status.len == 7 && !strncmp(status.str, "success", 7));
+    TEST_ASSERT(parse_template_get_control(&doc, &object));
+    TEST_ASSERT_EQ(4, doc.tokens[object].size);
+
+    strcpy(json, sg_action);
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, template_json_parse(&doc, json));
+    TEST_ASSERT(parse_client_token(&doc, token, sizeof(token)));
+    TEST_ASSERT(!strcmp(token, "AAAAAAAAAA-1236"));
+    TEST_ASSERT(parse_action_id(&doc, action_id, sizeof(action_id)));
+    TEST_ASSERT(!strcmp(action_id, "light_blink"));
+    TEST_ASSERT(parse_time_stamp(&doc, &timestamp));
+    TEST_ASSERT_EQ(1602915123, timestamp);
+    TEST_ASSERT(parse_action_input(&doc, &object));
+    TEST_ASSERT_EQ(3, doc.tokens[object].size);
+
+    /* the message is not modified by parsing */
+    TEST_ASSERT(!strcmp(json, sg_action));
+    return 0;
+}
+
+static int bench_parse(void)
+{
+    static TemplateJsonDoc doc;
+    char        json[512];
+    double      tokens_us[CASE_COUNT], per_field_us[CASE_COUNT];
+    uint64_t    t0, t1, t2;
+    int         round, k;
+
+    for (k = 0; k < (int)CASE_COUNT; k++) {
+        strcpy(json, sg_cases[k].json);
+
+        t0 = test_now_ns();
+        for (round = 0; round < ROUNDS; round++) {
+            TEST_ASSERT_EQ(0, _parse_by_tokens(&doc, json, k));
+        }
+        t1 = test_now_ns();
+        for (round = 0; round < ROUNDS; round++) {
+            TEST_ASSERT_EQ(0, _parse_per_field(&sg_cases[k], json));
+        }
+        t2 = test_now_ns();
+
+        tokens_us[k]    = (double)(t1 - t0) / 1000.0 / ROUNDS;
+        per_field_us[k] = (double)(t2 - t1) / 1000.0 / ROUNDS;
+    }
+
+    printf("{\"bench\":\"json_parse\",\"rounds\":%d,\"results\":[", ROUNDS);
+    for (k = 0; k < (int)CASE_COUNT; k++) {
+        printf("%s{\"message\":\"%s\",\"len\":%d,\"tokens_us\":%.3f,\"per_field_us\":%.3f}", k ? "," : "",
+               sg_cases[k].name, (int)strlen(sg_cases[k].json), tokens_us[k], per_field_us[k]);
+    }
+    printf("]}\n");
+    return 0;
+}
+
+int main(void)
+{
+    IOT_Log_Set_Level(eLOG_WARN);
+
+    TEST_RUN(test_parse_fields);
+    TEST_RUN(bench_parse);
+    return 0;
+}
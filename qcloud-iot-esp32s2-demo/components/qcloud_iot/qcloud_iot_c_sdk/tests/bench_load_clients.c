@@ -0,0 +1,246 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <malloc.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "qcloud_iot_export.h"
+#include "qcloud_iot_import.h"
+#include "test_broker.h"
+#include "test_util.h"
+
+/*
+ * Load generator: many devices in one process, all served by one thread through IOT_MQTT_YieldMulti.
+ * Each device publishes QoS1 at a fixed interval. Heap and RSS growth per client and CPU time per client are printed as JSON.
+ *
+ *   bench_load_clients [clients=1000] [seconds=3] [buf_size=1024] [interval_ms=1000]
+ *
+ * The broker runs in a child process, so the client sockets alone count against RLIMIT_NOFILE.
+ */
+
+#define TEST_PRODUCT_ID     "TESTPRD001"
+#define TEST_DEVICE_SECRET  "dGVzdC1kZXZpY2Utc2VjcmV0"
+#define PAYLOAD_LEN         64
+
+typedef struct {
+    uint64_t    next_pub_ns;
+    char        topic[128];
+} LoadClient;
+
+static pid_t _start_broker_process(int *ctl_fd)
+{
+    int ready[2], ctl[2];
+    char c;
+    pid_t pid;
+
+    if (pipe(ready) || pipe(ctl)) {
+        return -1;
+    }
+    if ((pid = fork()) == 0) {
+        TestBrokerParams params = {MQTT_SERVER_PORT_NOTLS, NULL, NULL, NULL, 0};
+        TestBroker *broker;
+
+        close(ready[0]);
+        close(ctl[1]);
+        broker = test_broker_start(&params);
+        c = broker ? 1 : 0;
+        if (write(ready[1], &c, 1) != 1 || !broker) {
+            _exit(1);
+        }
+        /* runs until the parent closes the control pipe */
+        while (read(ctl[0], &c, 1) > 0) {
+        }
+        test_broker_stop(broker);
+        _exit(0);
+    }
+
+    close(ready[1]);
+    close(ctl[0]);
+    if (pid < 0 || read(ready[0], &c, 1) != 1 || c != 1) {
+        close(ready[0]);
+        close(ctl[1]);
+        return -1;
+    }
+    close(ready[0]);
+    *ctl_fd = ctl[1];
+    return pid;
+}
+
+static size_t _heap_used(void)
+{
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+static size_t _rss_bytes(void)
+{
+    unsigned long size = 0, resident = 0;
+    FILE *fp = fopen("/proc/self/statm", "r");
+
+    if (fp != NULL) {
+        if (fscanf(fp, "%lu %lu", &size, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(fp);
+    }
+    return resident * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+static uint64_t _cpu_ns(void)
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    return (uint64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000000ull +
+           (uint64_t)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000ull;
+}
+
+static int _publish(void *client, LoadClient *lc)
+{
+    char payload[PAYLOAD_LEN + 1];
+    PublishParams params = DEFAULT_PUB_PARAMS;
+
+    memset(payload, 'x', PAYLOAD_LEN);
+    payload[PAYLOAD_LEN] = '\0';
+    params.qos = QOS1;
+    params.payload = payload;
+    params.payload_len = PAYLOAD_LEN;
+    return IOT_MQTT_Publish(client, lc->topic, &params);
+}
+
+int main(int argc, char **argv)
+{
+    int count = argc > 1 ? atoi(argv[1]) : 1000;
+    int seconds = argc > 2 ? atoi(argv[2]) : 3;
+    uint32_t buf_size = argc > 3 ? (uint32_t)atoi(argv[3]) : 1024;
+    uint32_t interval_ms = argc > 4 ? (uint32_t)atoi(argv[4]) : 1000;
+
+    struct rlimit limit;
+    MQTTInitParams init_params = DEFAULT_MQTTINIT_PARAMS;
+    MQTTStats stats;
+    LoadClient *clients;
+    void **handles, *yield;
+    char device_name[MAX_SIZE_OF_DEVICE_NAME + 1];
+    size_t heap_before, rss_before, heap_per_client, rss_per_client;
+    uint64_t start_ns, end_ns, now_ns, cpu_start, cpu_ns, connect_ns;
+    uint64_t published = 0, pub_failed = 0, acked = 0, timeouts = 0;
+    int ctl_fd, i;
+    pid_t broker_pid;
+
+    IOT_Log_Set_Level(eLOG_WARN);
+    alarm(seconds + 120);
+
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    if ((rlim_t)count + 64 > limit.rlim_cur) {
+        printf("%d clients need more fds than RLIMIT_NOFILE %lu\n", count, (unsigned long)limit.rlim_cur);
+        return 1;
+    }
+
+    broker_pid = _start_broker_process(&ctl_fd);
+    TEST_ASSERT(broker_pid > 0);
+    TEST_ASSERT((yield = IOT_MQTT_YieldMulti_Construct(count)) != NULL);
+    TEST_ASSERT((clients = calloc(count, sizeof(LoadClient))) != NULL);
+    TEST_ASSERT((handles = calloc(count, sizeof(void *))) != NULL);
+
+    /* connect all, memory growth of this part is what the clients take */
+    init_params.product_id = TEST_PRODUCT_ID;
+    init_params.device_secret = TEST_DEVICE_SECRET;
+    init_params.device_name = device_name;
+    init_params.command_timeout = 5000;
+    init_params.tx_buf_size = buf_size;
+    init_params.rx_buf_size = buf_size;
+    heap_before = _heap_used();
+    rss_before = _rss_bytes();
+    start_ns = test_now_ns();
+    for (i = 0; i < count; i++) {
+        snprintf(device_name, sizeof(device_name), "load%05d", i);
+        snprintf(clients[i].topic, sizeof(clients[i].topic), "%s/%s/data", TEST_PRODUCT_ID, device_name);
+        handles[i] = IOT_MQTT_Construct(&init_params);
+        if (handles[i] == NULL) {
+            printf("client %d failed to connect\n", i);
+            return 1;
+        }
+    }
+    connect_ns = test_now_ns() - start_ns;
+    heap_per_client = (_heap_used() - heap_before) / count;
+    rss_per_client = (_rss_bytes() - rss_before) / count;
+
+    /* steady load, publishes spread over the interval */
+    start_ns = test_now_ns();
+    for (i = 0; i < count; i++) {
+        clients[i].next_pub_ns = start_ns + (uint64_t)interval_ms * 1000000ull * i / count;
+        IOT_MQTT_ResetStats(handles[i]);
+    }
+    cpu_start = _cpu_ns();
+    end_ns = start_ns + (uint64_t)seconds * 1000000000ull;
+    while ((now_ns = test_now_ns()) < end_ns) {
+        IOT_MQTT_YieldMulti(yield, handles, count, 1);
+        for (i = 0; i < count; i++) {
+            if (clients[i].next_pub_ns > now_ns) {
+                continue;
+            }
+            clients[i].next_pub_ns += (uint64_t)interval_ms * 1000000ull;
+            if (_publish(handles[i], &clients[i]) >= 0) {
+                published++;
+            } else {
+                pub_failed++;
+            }
+        }
+    }
+    cpu_ns = _cpu_ns() - cpu_start;
+    now_ns = test_now_ns();
+
+    for (i = 0; i < count; i++) {
+        IOT_MQTT_GetStats(handles[i], &stats);
+        acked += stats.puback_count;
+        timeouts += stats.puback_timeout;
+    }
+
+    printf("{\"bench\":\"load_clients\",\"clients\":%d,\"buf_size\":%u,\"interval_ms\":%u,\"seconds\":%.2f,"
+           "\"connect_ms\":%.1f,\"heap_bytes_per_client\":%zu,\"rss_bytes_per_client\":%zu,"
+           "\"published\":%llu,\"publish_failed\":%llu,\"acked\":%llu,\"puback_timeout\":%llu,"
+           "\"cpu_ms\":%.1f,\"cpu_util\":%.3f,\"cpu_us_per_client_sec\":%.2f,\"cpu_us_per_publish\":%.2f}\n",
+           count, buf_size, interval_ms, (now_ns - start_ns) / 1e9, connect_ns / 1e6, heap_per_client,
+           rss_per_client, (unsigned long long)published, (unsigned long long)pub_failed,
+           (unsigned long long)acked, (unsigned long long)timeouts, cpu_ns / 1e6,
+           (double)cpu_ns / (now_ns - start_ns), cpu_ns / 1e3 / count / ((now_ns - start_ns) / 1e9),
+           published ? cpu_ns / 1e3 / published : 0.0);
+
+    for (i = 0; i < count; i++) {
+        IOT_MQTT_Destroy(&handles[i]);
+    }
+    IOT_MQTT_YieldMulti_Destroy(yield);
+    free(handles);
+    free(clients);
+    close(ctl_fd);
+    waitpid(broker_pid, NULL, 0);
+
+    TEST_ASSERT_EQ(0, pub_failed);
+    TEST_ASSERT(published >= (uint64_t)count);
+    TEST_ASSERT_EQ(0, timeouts);
+    /* the last publish of each client may still wait for PUBACK */
+    TEST_ASSERT(acked + count >= published);
+    return 0;
+}
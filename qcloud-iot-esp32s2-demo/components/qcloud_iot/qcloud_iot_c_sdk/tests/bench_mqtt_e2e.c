@@ -0,0 +1,197 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "qcloud_iot_export.h"
+#include "qcloud_iot_import.h"
+#include "utils_base64.h"
+#include "test_broker.h"
+#include "test_util.h"
+
+/*
+ * End to end over the localhost broker, TCP or TLS as the SDK library linked: the client publishes
+ * QoS1 to a topic it subscribes, round trip of one message at a time, then throughput with a window
+ * of publishes in flight. The result and the client statistics go to stdout as one JSON object.
+ */
+
+#define TEST_PRODUCT_ID     "TESTPRD001"
+#define TEST_DEVICE_NAME    "dev_bench"
+#define TEST_DEVICE_SECRET  "dGVzdC1kZXZpY2Utc2VjcmV0"
+#define TEST_TOPIC          TEST_PRODUCT_ID "/" TEST_DEVICE_NAME "/data"
+
+#define PAYLOAD_LEN         256
+#define RTT_COUNT           500
+#define THROUGHPUT_COUNT    5000
+#define THROUGHPUT_WINDOW   16
+
+#ifdef AUTH_WITH_NOTLS
+#define BENCH_TRANSPORT     "tcp"
+#define BENCH_PORT          MQTT_SERVER_PORT_NOTLS
+#else
+#define BENCH_TRANSPORT     "tls"
+#define BENCH_PORT          MQTT_SERVER_PORT_TLS
+#endif
+
+static uint64_t sg_rtt_ns[RTT_COUNT];
+static int      sg_received;
+static bool     sg_subscribed;
+
+static void _on_message(void *pClient, MQTTMessage *message, void *pUserData)
+{
+    char stamp[24];
+    size_t len = message->payload_len < sizeof(stamp) - 1 ? message->payload_len : sizeof(stamp) - 1;
+    unsigned long long sent_ns;
+    int seq;
+
+    memcpy(stamp, message->payload, len);
+    stamp[len] = '\0';
+    if (sscanf(stamp, "%d:%llu", &seq, &sent_ns) != 2) {
+        return;
+    }
+    if (seq >= 0 && seq < RTT_COUNT) {
+        sg_rtt_ns[seq] = test_now_ns() - sent_ns;
+    }
+    sg_received++;
+}
+
+static void _on_sub_event(void *pClient, MQTTEventType event_type, void *pUserData)
+{
+    if (event_type == MQTT_EVENT_SUBCRIBE_SUCCESS) {
+        sg_subscribed = true;
+    }
+}
+
+static int _publish(void *client, int seq)
+{
+    static char payload[PAYLOAD_LEN + 1];
+    PublishParams params = DEFAULT_PUB_PARAMS;
+    int len = snprintf(payload, sizeof(payload), "%d:%llu:", seq, (unsigned long long)test_now_ns());
+
+    memset(payload + len, 'x', PAYLOAD_LEN - len);
+    payload[PAYLOAD_LEN] = '\0';
+
+    params.qos = QOS1;
+    params.payload = payload;
+    params.payload_len = PAYLOAD_LEN;
+    return IOT_MQTT_Publish(client, TEST_TOPIC, &params);
+}
+
+static int _wait_received(void *client, int count)
+{
+    uint64_t deadline = test_now_ns() + 10000000000ull;
+
+    while (sg_received < count && test_now_ns() < deadline) {
+        IOT_MQTT_Yield(client, 1);
+    }
+    return sg_received >= count ? 0 : -1;
+}
+
+static int _cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int bench_e2e(void)
+{
+    MQTTInitParams init_params = DEFAULT_MQTTINIT_PARAMS;
+    SubscribeParams sub_params = DEFAULT_SUB_PARAMS;
+    TestBrokerParams broker_params = {BENCH_PORT, NULL, NULL, NULL, 0};
+    TestBroker *broker;
+    MQTTStats stats;
+    char stats_json[1024];
+    uint64_t start_ns, elapsed_ns;
+    void *client;
+    int sent, i;
+
+#ifndef AUTH_WITH_NOTLS
+    static unsigned char psk[64];
+    size_t psk_len = 0;
+
+    TEST_ASSERT_EQ(0, qcloud_iot_utils_base64decode(psk, sizeof(psk), &psk_len, (const unsigned char *)TEST_DEVICE_SECRET,
+                                                    strlen(TEST_DEVICE_SECRET)));
+    broker_params.psk = psk;
+    broker_params.psk_len = psk_len;
+#endif
+    broker = test_broker_start(&broker_params);
+    TEST_ASSERT(broker != NULL);
+
+    init_params.product_id = TEST_PRODUCT_ID;
+    init_params.device_name = TEST_DEVICE_NAME;
+    init_params.device_secret = TEST_DEVICE_SECRET;
+    init_params.command_timeout = 2000;
+    client = IOT_MQTT_Construct(&init_params);
+    TEST_ASSERT(client != NULL);
+
+    sub_params.qos = QOS1;
+    sub_params.on_message_handler = _on_message;
+    sub_params.on_sub_event_handler = _on_sub_event;
+    TEST_ASSERT(IOT_MQTT_Subscribe(client, TEST_TOPIC, &sub_params) >= 0);
+    for (i = 0; i < 500 && !sg_subscribed; i++) {
+        IOT_MQTT_Yield(client, 10);
+    }
+    TEST_ASSERT(sg_subscribed);
+
+    /* round trip, one message at a time */
+    for (sent = 0; sent < RTT_COUNT; sent++) {
+        TEST_ASSERT(_publish(client, sent) > 0);
+        TEST_ASSERT_EQ(0, _wait_received(client, sent + 1));
+    }
+    qsort(sg_rtt_ns, RTT_COUNT, sizeof(uint64_t), _cmp_u64);
+
+    /* throughput, statistics cover this part only */
+    IOT_MQTT_ResetStats(client);
+    sg_received = 0;
+    start_ns = test_now_ns();
+    for (sent = 0; sent < THROUGHPUT_COUNT || sg_received < THROUGHPUT_COUNT;) {
+        if (sent < THROUGHPUT_COUNT && sent - sg_received < THROUGHPUT_WINDOW) {
+            TEST_ASSERT(_publish(client, RTT_COUNT + sent) > 0);
+            sent++;
+            continue;
+        }
+        IOT_MQTT_Yield(client, 1);
+        TEST_ASSERT(test_now_ns() - start_ns < 60000000000ull);
+    }
+    elapsed_ns = test_now_ns() - start_ns;
+
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, IOT_MQTT_GetStats(client, &stats));
+    TEST_ASSERT(IOT_MQTT_StatsToJson(&stats, stats_json, sizeof(stats_json)) > 0);
+    TEST_ASSERT(stats.recv_count >= THROUGHPUT_COUNT);
+
+    printf("{\"bench\":\"mqtt_e2e\",\"transport\":\"%s\",\"payload_len\":%d,"
+           "\"rtt\":{\"count\":%d,\"p50_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f},"
+           "\"throughput\":{\"messages\":%d,\"window\":%d,\"elapsed_ms\":%.1f,\"msgs_per_sec\":%.0f},"
+           "\"client_stats\":%s}\n",
+           BENCH_TRANSPORT, PAYLOAD_LEN, RTT_COUNT, sg_rtt_ns[RTT_COUNT / 2] / 1e3,
+           sg_rtt_ns[RTT_COUNT * 99 / 100] / 1e3, sg_rtt_ns[RTT_COUNT - 1] / 1e3, THROUGHPUT_COUNT,
+           THROUGHPUT_WINDOW, elapsed_ns / 1e6, THROUGHPUT_COUNT / (elapsed_ns / 1e9), stats_json);
+
+    IOT_MQTT_Destroy(&client);
+    test_broker_stop(broker);
+    return 0;
+}
+
+int main(void)
+{
+    IOT_Log_Set_Level(eLOG_WARN);
+    alarm(120);
+
+    TEST_RUN(bench_e2e);
+    return 0;
+}
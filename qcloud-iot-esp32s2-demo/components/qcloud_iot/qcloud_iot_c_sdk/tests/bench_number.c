@@ -0,0 +1,132 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils_number.h"
+#include "test_util.h"
+
+/*
+ * Number conversions of JSON reports and controls: utils_number against the libc calls used before,
+ * snprintf for formatting and sscanf/strtod for parsing. Half of the values are readings with 3 decimals,
+ * the rest random doubles.
+ */
+
+#define VALUE_COUNT 1024
+#define ROUNDS      200
+
+static double  sg_doubles[VALUE_COUNT];
+static float   sg_floats[VALUE_COUNT];
+static int32_t sg_ints[VALUE_COUNT];
+static char    sg_double_strs[VALUE_COUNT][UTILS_DOUBLE_STR_LEN];
+static char    sg_int_strs[VALUE_COUNT][UTILS_INT_STR_LEN];
+
+/* results are stored so that the conversions are not optimized out */
+static volatile double sg_sink_double;
+static volatile long   sg_sink_long;
+
+static uint64_t sg_seed = 88172645463325252ULL;
+
+static uint64_t _rand64(void)
+{
+    sg_seed ^= sg_seed << 13;
+    sg_seed ^= sg_seed >> 7;
+    sg_seed ^= sg_seed << 17;
+    return sg_seed;
+}
+
+static void _init_values(void)
+{
+    int i;
+
+    for (i = 0; i < VALUE_COUNT; i++) {
+        if (i % 2) {
+            sg_doubles[i] = (double)(int64_t)(_rand64() % 2000000 - 1000000) / 1000.0;
+        } else {
+            /* random mantissa, exponent in a range of readings */
+            sg_doubles[i] = ((double)(_rand64() >> 11) / (double)(1ULL << 53)) * (double)(1 << (_rand64() % 40));
+        }
+        sg_floats[i] = (float)sg_doubles[i];
+        sg_ints[i]   = (int32_t)_rand64();
+        utils_double_to_str(sg_doubles[i], sg_double_strs[i]);
+        utils_int32_to_str(sg_ints[i], sg_int_strs[i]);
+    }
+}
+
+/* ns per value of the loop, the sum keeps the results alive */
+#define BENCH_LOOP(ns, stmt)                                        \
+    do {                                                            \
+        uint64_t _t0 = test_now_ns();                               \
+        int _round, i;                                              \
+        for (_round = 0; _round < ROUNDS; _round++) {               \
+            for (i = 0; i < VALUE_COUNT; i++) {                     \
+                stmt;                                               \
+            }                                                       \
+        }                                                           \
+        ns = (double)(test_now_ns() - _t0) / ROUNDS / VALUE_COUNT;  \
+    } while (0)
+
+static int bench_number(void)
+{
+    char     buf[UTILS_DOUBLE_STR_LEN];
+    double   d, sum = 0;
+    int32_t  n;
+    long     check = 0;
+    double   double_fmt, double_fmt_libc, float_fmt, float_fmt_libc, int_fmt, int_fmt_libc;
+    double   double_parse, double_parse_libc, int_parse, int_parse_libc;
+
+    _init_values();
+
+    BENCH_LOOP(double_fmt, check += utils_double_to_str(sg_doubles[i], buf));
+    BENCH_LOOP(double_fmt_libc, check += snprintf(buf, sizeof(buf), "%.17g", sg_doubles[i]));
+    BENCH_LOOP(float_fmt, check += utils_float_to_str(sg_floats[i], buf));
+    BENCH_LOOP(float_fmt_libc, check += snprintf(buf, sizeof(buf), "%.9g", sg_floats[i]));
+    BENCH_LOOP(int_fmt, check += utils_int32_to_str(sg_ints[i], buf));
+    BENCH_LOOP(int_fmt_libc, check += snprintf(buf, sizeof(buf), "%" PRIi32, sg_ints[i]));
+
+    BENCH_LOOP(double_parse, {
+        utils_strn_to_double(sg_double_strs[i], strlen(sg_double_strs[i]), &d);
+        sum += d;
+    });
+    BENCH_LOOP(double_parse_libc, sum += strtod(sg_double_strs[i], NULL));
+    BENCH_LOOP(int_parse, {
+        utils_strn_to_int32(sg_int_strs[i], strlen(sg_int_strs[i]), &n);
+        check += n;
+    });
+    BENCH_LOOP(int_parse_libc, {
+        sscanf(sg_int_strs[i], "%" SCNi32, &n);
+        check += n;
+    });
+
+    sg_sink_double = sum;
+    sg_sink_long   = check;
+
+    printf("{\"bench\":\"number\",\"values\":%d,\"ns_per_value\":{", VALUE_COUNT);
+    printf("\"format_double\":%.1f,\"format_double_snprintf\":%.1f,", double_fmt, double_fmt_libc);
+    printf("\"format_float\":%.1f,\"format_float_snprintf\":%.1f,", float_fmt, float_fmt_libc);
+    printf("\"format_int32\":%.1f,\"format_int32_snprintf\":%.1f,", int_fmt, int_fmt_libc);
+    printf("\"parse_double\":%.1f,\"parse_double_strtod\":%.1f,", double_parse, double_parse_libc);
+    printf("\"parse_int32\":%.1f,\"parse_int32_sscanf\":%.1f}}\n", int_parse, int_parse_libc);
+    return 0;
+}
+
+int main(void)
+{
+    TEST_RUN(bench_number);
+    return 0;
+}
@@ -0,0 +1,199 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "qcloud_iot_export_log.h"
+#include "data_template_client.h"
+#include "data_template_client_common.h"
+#include "data_template_client_json.h"
+#include "test_util.h"
+
+/*
+ * Dispatch of a control message on a 64-property template: sorted property index, as _handle_control does,
+ * against one lookup in the control object per registered property, as it was before the index.
+ */
+
+#define PROPERTY_COUNT  64
+/* QCLOUD_IOT_TEMPLATE_MAX_JSON_TOKENS leaves room for 60 properties in one control message */
+#define CONTROL_COUNT   60
+#define ROUNDS          20000
+
+static char             sg_keys[PROPERTY_COUNT][16];
+static int32_t          sg_values[PROPERTY_COUNT];
+static DeviceProperty   sg_props[PROPERTY_COUNT];
+static int              sg_calls;
+
+static void _on_property(void *pClient, const char *pJsonValueBuffer, uint32_t valueLength, DeviceProperty *pProperty)
+{
+    sg_calls++;
+}
+
+static int _init_template(Qcloud_IoT_Template *pTemplate)
+{
+    int i;
+
+    memset(pTemplate, 0, sizeof(Qcloud_IoT_Template));
+    pTemplate->mutex = HAL_MutexCreate();
+    pTemplate->inner_data.property_handle_list = list_new();
+    TEST_ASSERT(pTemplate->mutex != NULL && pTemplate->inner_data.property_handle_list != NULL);
+    pTemplate->inner_data.property_handle_list->free = HAL_Free;
+
+    /* registered in an order unrelated to the keys */
+    for (i = 0; i < PROPERTY_COUNT; i++) {
+        snprintf(sg_keys[i], sizeof(sg_keys[i]), "prop_%02d", (i * 37) % PROPERTY_COUNT);
+        sg_props[i].key = sg_keys[i];
+        sg_props[i].data = &sg_values[i];
+        sg_props[i].type = JINT32;
+        TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, template_common_register_property_on_delta(pTemplate, &sg_props[i], _on_property));
+    }
+
+    return 0;
+}
+
+static int test_index(void)
+{
+    Qcloud_IoT_Template template;
+    PropertyHandler **handlers;
+    int i;
+
+    if (_init_template(&template)) {
+        return 1;
+    }
+
+    TEST_ASSERT_EQ(PROPERTY_COUNT, template.inner_data.property_count);
+    for (i = 1; i < template.inner_data.property_count; i++) {
+        TEST_ASSERT(strcmp(template.inner_data.property_index[i - 1]->property->key,
+                           template.inner_data.property_index[i]->property->key) < 0);
+    }
+
+    TEST_ASSERT(template_common_check_property_existence(&template, &sg_props[5]));
+    /* key is not '\0' terminated in JSON */
+    TEST_ASSERT_EQ(1, template_common_find_property(&template, "prop_10\"", 7, &handlers));
+    TEST_ASSERT(!strcmp(handlers[0]->property->key, "prop_10"));
+    TEST_ASSERT_EQ(0, template_common_find_property(&template, "prop_1", 6, &handlers));
+    TEST_ASSERT_EQ(0, template_common_find_property(&template, "prop_100", 8, &handlers));
+
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, template_common_remove_property(&template, &sg_props[5]));
+    TEST_ASSERT(template_common_remove_property(&template, &sg_props[5]) != QCLOUD_RET_SUCCESS);
+    TEST_ASSERT(!template_common_check_property_existence(&template, &sg_props[5]));
+    TEST_ASSERT_EQ(PROPERTY_COUNT - 1, template.inner_data.property_count);
+    TEST_ASSERT_EQ(PROPERTY_COUNT - 1, template.inner_data.property_handle_list->len);
+
+    return 0;
+}
+
+static int _build_control(char *buf, size_t size)
+{
+    int i, n = 0;
+
+    n += snprintf(buf + n, size - n, "{\"method\":\"control\",\"clientToken\":\"abc-1\",\"params\":{");
+    for (i = 0; i < CONTROL_COUNT; i++) {
+        n += snprintf(buf + n, size - n, "%s\"prop_%02d\":%d", i ? "," : "", i, i * 3);
+    }
+    n += snprintf(buf + n, size - n, "}}");
+    return n;
+}
+
+/* the loop of _handle_control */
+static void _dispatch_by_index(Qcloud_IoT_Template *pTemplate, TemplateJsonDoc *pDoc, int control)
+{
+    json_token_t *tokens = pDoc->tokens;
+    PropertyHandler **handlers;
+    json_span_t value;
+    int key, count, i, n;
+
+    for (key = control + 1, n = 0; n < tokens[control].size; key = tokens[key].next, n++) {
+        count = template_common_find_property(pTemplate, pDoc->json + tokens[key].start,
+                                              tokens[key].end - tokens[key].start, &handlers);
+        value.str = pDoc->json + tokens[key + 1].start;
+        value.len = tokens[key + 1].end - tokens[key + 1].start;
+        value.type = tokens[key + 1].type;
+        for (i = 0; i < count; i++) {
+            update_property_value(&value, handlers[i]->property);
+            handlers[i]->callback(pTemplate, NULL, 0, handlers[i]->property);
+        }
+    }
+}
+
+/* one scan of the control object per registered property */
+static void _dispatch_per_property(Qcloud_IoT_Template *pTemplate, const char *control, int control_len)
+{
+    ListIterator *iter = list_iterator_new(pTemplate->inner_data.property_handle_list, LIST_TAIL);
+    ListNode *node;
+    json_span_t value;
+
+    while ((node = list_iterator_next(iter)) != NULL) {
+        PropertyHandler *handler = (PropertyHandler *)node->val;
+        if (LITE_json_span_at(handler->property->key, control, control_len, &value) == QCLOUD_RET_SUCCESS) {
+            update_property_value(&value, handler->property);
+            handler->callback(pTemplate, NULL, 0, handler->property);
+        }
+    }
+    list_iterator_destroy(iter);
+}
+
+static int bench_dispatch(void)
+{
+    static char json[4096];
+    static TemplateJsonDoc doc;
+    Qcloud_IoT_Template template;
+    json_span_t control;
+    uint64_t t0, t1, t2;
+    int control_index, round, i;
+
+    if (_init_template(&template)) {
+        return 1;
+    }
+    _build_control(json, sizeof(json));
+
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, template_json_parse(&doc, json));
+    TEST_ASSERT(parse_template_cmd_control(&doc, &control_index));
+    TEST_ASSERT(template_json_span_of(&doc, 0, "params", &control));
+
+    sg_calls = 0;
+    t0 = test_now_ns();
+    for (round = 0; round < ROUNDS; round++) {
+        _dispatch_by_index(&template, &doc, control_index);
+    }
+    t1 = test_now_ns();
+    TEST_ASSERT_EQ(ROUNDS * CONTROL_COUNT, sg_calls);
+    for (i = 0; i < PROPERTY_COUNT; i++) {
+        int key = (i * 37) % PROPERTY_COUNT;
+        TEST_ASSERT_EQ(key < CONTROL_COUNT ? key * 3 : 0, sg_values[i]);
+    }
+
+    sg_calls = 0;
+    for (round = 0; round < ROUNDS; round++) {
+        _dispatch_per_property(&template, control.str, control.len);
+    }
+    t2 = test_now_ns();
+    TEST_ASSERT_EQ(ROUNDS * CONTROL_COUNT, sg_calls);
+
+    printf("  %d properties, control of %d keys: index %.2f us, per-property lookup %.2f us\n", PROPERTY_COUNT,
+           CONTROL_COUNT, (double)(t1 - t0) / 1000.0 / ROUNDS, (double)(t2 - t1) / 1000.0 / ROUNDS);
+    return 0;
+}
+
+int main(void)
+{
+    IOT_Log_Set_Level(eLOG_WARN);
+
+    TEST_RUN(test_index);
+    TEST_RUN(bench_dispatch);
+    return 0;
+}
@@ -0,0 +1,146 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "qcloud_iot_export.h"
+#include "qcloud_iot_import.h"
+#include "test_broker.h"
+#include "test_util.h"
+
+/*
+ * QoS1 throughput of IOT_MQTT_PublishAsync over the localhost broker with an inflight window of 1, 8 and 32.
+ * The client publishes until the window is full, then waits for PUBACKs with IOT_MQTT_YieldMulti, which
+ * returns as soon as the socket was served. Results go to stdout as one JSON object.
+ */
+
+#define TEST_PRODUCT_ID     "TESTPRD001"
+#define TEST_DEVICE_NAME    "dev_bench"
+#define TEST_DEVICE_SECRET  "dGVzdC1kZXZpY2Utc2VjcmV0"
+#define TEST_TOPIC          TEST_PRODUCT_ID "/" TEST_DEVICE_NAME "/data"
+
+/* 32 copies of it fit in the default inflight buffer, so the window is the limit and not the buffer */
+#define PAYLOAD_LEN         128
+#define MESSAGE_COUNT       10000
+
+static const uint16_t sg_windows[] = {1, 8, 32};
+
+typedef struct {
+    int success;
+    int failed;
+} BenchResult;
+
+static void _on_complete(void *pClient, uint16_t packet_id, MQTTEventType result, void *pUserData)
+{
+    BenchResult *res = (BenchResult *)pUserData;
+
+    if (result == MQTT_EVENT_PUBLISH_SUCCESS) {
+        res->success++;
+    } else {
+        res->failed++;
+    }
+}
+
+static int _run_window(uint16_t window, double *msgs_per_sec)
+{
+    MQTTInitParams init_params = DEFAULT_MQTTINIT_PARAMS;
+    PublishParams pub_params = DEFAULT_PUB_PARAMS;
+    static char payload[PAYLOAD_LEN];
+    BenchResult res = {0, 0};
+    uint64_t start_ns, elapsed_ns;
+    void *client, *yield;
+    int sent = 0, rc;
+
+    init_params.product_id = TEST_PRODUCT_ID;
+    init_params.device_name = TEST_DEVICE_NAME;
+    init_params.device_secret = TEST_DEVICE_SECRET;
+    init_params.command_timeout = 5000;
+    init_params.max_inflight = window;
+    client = IOT_MQTT_Construct(&init_params);
+    TEST_ASSERT(client != NULL);
+    yield = IOT_MQTT_YieldMulti_Construct(1);
+    TEST_ASSERT(yield != NULL);
+
+    memset(payload, 'x', sizeof(payload));
+    pub_params.qos = QOS1;
+    pub_params.payload = payload;
+    pub_params.payload_len = sizeof(payload);
+
+    start_ns = test_now_ns();
+    while (res.success + res.failed < MESSAGE_COUNT) {
+        if (sent < MESSAGE_COUNT) {
+            rc = IOT_MQTT_PublishAsync(client, TEST_TOPIC, &pub_params, _on_complete, &res);
+            if (rc > 0) {
+                sent++;
+                continue;
+            }
+            TEST_ASSERT_EQ(QCLOUD_ERR_MQTT_INFLIGHT_FULL, rc);
+            /* never more than the window waiting for PUBACK */
+            TEST_ASSERT_EQ(window, sent - res.success - res.failed);
+        }
+        TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, IOT_MQTT_YieldMulti(yield, &client, 1, 100));
+        TEST_ASSERT(test_now_ns() - start_ns < 60000000000ull);
+    }
+    elapsed_ns = test_now_ns() - start_ns;
+
+    TEST_ASSERT_EQ(MESSAGE_COUNT, res.success);
+    *msgs_per_sec = MESSAGE_COUNT / (elapsed_ns / 1e9);
+
+    IOT_MQTT_YieldMulti_Destroy(yield);
+    IOT_MQTT_Destroy(&client);
+    return 0;
+}
+
+static int bench_publish_window(void)
+{
+    TestBrokerParams broker_params = {MQTT_SERVER_PORT_NOTLS, NULL, NULL, NULL, 0};
+    double msgs_per_sec[sizeof(sg_windows) / sizeof(sg_windows[0])];
+    TestBroker *broker;
+    size_t i;
+
+    broker = test_broker_start(&broker_params);
+    TEST_ASSERT(broker != NULL);
+
+    for (i = 0; i < sizeof(sg_windows) / sizeof(sg_windows[0]); i++) {
+        if (_run_window(sg_windows[i], &msgs_per_sec[i])) {
+            test_broker_stop(broker);
+            return 1;
+        }
+    }
+    test_broker_stop(broker);
+
+    printf("{\"bench\":\"publish_window\",\"payload_len\":%d,\"messages\":%d,\"results\":[", PAYLOAD_LEN,
+           MESSAGE_COUNT);
+    for (i = 0; i < sizeof(sg_windows) / sizeof(sg_windows[0]); i++) {
+        printf("%s{\"window\":%u,\"msgs_per_sec\":%.0f}", i ? "," : "", sg_windows[i], msgs_per_sec[i]);
+    }
+    printf("]}\n");
+
+    /* a window of 1 waits a round trip for every message */
+    TEST_ASSERT(msgs_per_sec[2] > msgs_per_sec[0]);
+    return 0;
+}
+
+int main(void)
+{
+    IOT_Log_Set_Level(eLOG_WARN);
+    alarm(120);
+
+    TEST_RUN(bench_publish_window);
+    return 0;
+}
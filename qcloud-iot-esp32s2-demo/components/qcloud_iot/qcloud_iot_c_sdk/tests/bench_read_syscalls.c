@@ -0,0 +1,254 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "qcloud_iot_export.h"
+#include "qcloud_iot_import.h"
+#include "mqtt_client.h"
+#include "utils_base64.h"
+#include "test_broker.h"
+#include "test_util.h"
+
+/*
+ * Transport reads and system calls made by the client to take in a burst of small PUBLISH packets.
+ * Transport reads are counted by wrapping the read functions of the client's network, system calls
+ * by wrapping recv/read/poll of libc for the thread calling IOT_MQTT_Yield only (not the broker thread).
+ * Over TLS the broker sends a record for each packet, and a record costs the same system calls
+ * either way, so there the saving shows in transport reads (each a TLS read) rather than syscalls.
+ * "exact_reads" clears read_some of the network, which is how the header byte, every byte of remaining
+ * length and the body were read before the input buffer: one transport read (poll + recv) each.
+ * "buffered" reads whatever the socket has and deframes packets from memory.
+ */
+
+#define TEST_PRODUCT_ID     "TESTPRD001"
+#define TEST_DEVICE_NAME    "dev_bench"
+#define TEST_DEVICE_SECRET  "dGVzdC1kZXZpY2Utc2VjcmV0"
+#define TEST_TOPIC          TEST_PRODUCT_ID "/" TEST_DEVICE_NAME "/control"
+
+#define BURST_COUNT         5000
+#define PAYLOAD_LEN         32
+
+#ifdef AUTH_WITH_NOTLS
+#define BENCH_TRANSPORT     "tcp"
+#define BENCH_PORT          MQTT_SERVER_PORT_NOTLS
+#else
+#define BENCH_TRANSPORT     "tls"
+#define BENCH_PORT          MQTT_SERVER_PORT_TLS
+#endif
+
+typedef struct {
+    const char  *mode;
+    uint64_t    transport_reads;
+    uint64_t    recv_calls;
+    uint64_t    poll_calls;
+    double      elapsed_ms;
+} BenchRun;
+
+static __thread bool    sg_counting;
+static uint64_t         sg_transport_reads;
+static uint64_t         sg_recv_calls;
+static uint64_t         sg_poll_calls;
+static int              sg_received;
+static bool             sg_subscribed;
+
+/* the executable's definitions win over libc, the real ones are looked up next */
+ssize_t recv(int fd, void *buf, size_t len, int flags)
+{
+    static ssize_t (*real_recv)(int, void *, size_t, int);
+
+    if (NULL == real_recv) {
+        real_recv = (ssize_t (*)(int, void *, size_t, int))dlsym(RTLD_NEXT, "recv");
+    }
+    if (sg_counting) {
+        sg_recv_calls++;
+    }
+    return real_recv(fd, buf, len, flags);
+}
+
+ssize_t read(int fd, void *buf, size_t len)
+{
+    static ssize_t (*real_read)(int, void *, size_t);
+
+    if (NULL == real_read) {
+        real_read = (ssize_t (*)(int, void *, size_t))dlsym(RTLD_NEXT, "read");
+    }
+    if (sg_counting) {
+        sg_recv_calls++;
+    }
+    return real_read(fd, buf, len);
+}
+
+int poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    static int (*real_poll)(struct pollfd *, nfds_t, int);
+
+    if (NULL == real_poll) {
+        real_poll = (int (*)(struct pollfd *, nfds_t, int))dlsym(RTLD_NEXT, "poll");
+    }
+    if (sg_counting) {
+        sg_poll_calls++;
+    }
+    return real_poll(fds, nfds, timeout);
+}
+
+static int (*sg_real_read)(Network *, unsigned char *, size_t, uint32_t, size_t *);
+static int (*sg_real_read_some)(Network *, unsigned char *, size_t, uint32_t, size_t *);
+
+static int _count_read(Network *pNetwork, unsigned char *data, size_t datalen, uint32_t timeout_ms, size_t *read_len)
+{
+    sg_transport_reads++;
+    return sg_real_read(pNetwork, data, datalen, timeout_ms, read_len);
+}
+
+static int _count_read_some(Network *pNetwork, unsigned char *data, size_t datalen, uint32_t timeout_ms,
+                            size_t *read_len)
+{
+    sg_transport_reads++;
+    return sg_real_read_some(pNetwork, data, datalen, timeout_ms, read_len);
+}
+
+static void _on_message(void *pClient, MQTTMessage *message, void *pUserData)
+{
+    sg_received++;
+}
+
+static void _on_sub_event(void *pClient, MQTTEventType event_type, void *pUserData)
+{
+    if (event_type == MQTT_EVENT_SUBCRIBE_SUCCESS) {
+        sg_subscribed = true;
+    }
+}
+
+static int _run(TestBroker *broker, BenchRun *run, bool buffered)
+{
+    MQTTInitParams init_params = DEFAULT_MQTTINIT_PARAMS;
+    SubscribeParams sub_params = DEFAULT_SUB_PARAMS;
+    char payload[PAYLOAD_LEN];
+    uint64_t start_ns, deadline;
+    Qcloud_IoT_Client *client;
+    int i;
+
+    run->mode = buffered ? "buffered" : "exact_reads";
+    sg_subscribed = false;
+    sg_received = 0;
+
+    init_params.product_id = TEST_PRODUCT_ID;
+    init_params.device_name = TEST_DEVICE_NAME;
+    init_params.device_secret = TEST_DEVICE_SECRET;
+    init_params.command_timeout = 2000;
+    client = (Qcloud_IoT_Client *)IOT_MQTT_Construct(&init_params);
+    TEST_ASSERT(client != NULL);
+    sg_real_read = client->network_stack.read;
+    sg_real_read_some = client->network_stack.read_some;
+    client->network_stack.read = _count_read;
+    client->network_stack.read_some = buffered ? _count_read_some : NULL;
+
+    sub_params.qos = QOS0;
+    sub_params.on_message_handler = _on_message;
+    sub_params.on_sub_event_handler = _on_sub_event;
+    TEST_ASSERT(IOT_MQTT_Subscribe(client, TEST_TOPIC, &sub_params) >= 0);
+    for (i = 0; i < 500 && !sg_subscribed; i++) {
+        IOT_MQTT_Yield(client, 10);
+    }
+    TEST_ASSERT(sg_subscribed);
+
+    /* the whole burst is queued by the broker before the client starts reading */
+    memset(payload, 'p', sizeof(payload));
+    for (i = 0; i < BURST_COUNT; i++) {
+        test_broker_publish(broker, TEST_TOPIC, payload, sizeof(payload), 0);
+    }
+    usleep(200000);
+
+    sg_transport_reads = 0;
+    sg_recv_calls = 0;
+    sg_poll_calls = 0;
+    start_ns = test_now_ns();
+    deadline = start_ns + 30000000000ull;
+    sg_counting = true;
+    while (sg_received < BURST_COUNT && test_now_ns() < deadline) {
+        IOT_MQTT_Yield(client, 10);
+    }
+    sg_counting = false;
+    run->elapsed_ms = (test_now_ns() - start_ns) / 1e6;
+    run->transport_reads = sg_transport_reads;
+    run->recv_calls = sg_recv_calls;
+    run->poll_calls = sg_poll_calls;
+
+    TEST_ASSERT_EQ(BURST_COUNT, sg_received);
+    IOT_MQTT_Destroy((void **)&client);
+    return 0;
+}
+
+static void _print_run(const BenchRun *run, bool last)
+{
+    printf("{\"mode\":\"%s\",\"transport_reads\":%llu,\"recv_calls\":%llu,\"poll_calls\":%llu,"
+           "\"reads_per_packet\":%.3f,\"syscalls_per_packet\":%.3f,\"elapsed_ms\":%.1f}%s",
+           run->mode, (unsigned long long)run->transport_reads, (unsigned long long)run->recv_calls,
+           (unsigned long long)run->poll_calls, (double)run->transport_reads / BURST_COUNT,
+           (double)(run->recv_calls + run->poll_calls) / BURST_COUNT, run->elapsed_ms, last ? "" : ",");
+}
+
+static int bench_read_syscalls(void)
+{
+    TestBrokerParams broker_params = {BENCH_PORT, NULL, NULL, NULL, 0};
+    BenchRun runs[2];
+    TestBroker *broker;
+
+#ifndef AUTH_WITH_NOTLS
+    static unsigned char psk[64];
+    size_t psk_len = 0;
+
+    TEST_ASSERT_EQ(0, qcloud_iot_utils_base64decode(psk, sizeof(psk), &psk_len, (const unsigned char *)TEST_DEVICE_SECRET,
+                                                    strlen(TEST_DEVICE_SECRET)));
+    broker_params.psk = psk;
+    broker_params.psk_len = psk_len;
+#endif
+    broker = test_broker_start(&broker_params);
+    TEST_ASSERT(broker != NULL);
+
+    TEST_ASSERT_EQ(0, _run(broker, &runs[0], false));
+    TEST_ASSERT_EQ(0, _run(broker, &runs[1], true));
+    test_broker_stop(broker);
+
+    printf("{\"bench\":\"mqtt_read_syscalls\",\"transport\":\"%s\",\"packets\":%d,\"payload_len\":%d,\"runs\":[",
+           BENCH_TRANSPORT, BURST_COUNT, PAYLOAD_LEN);
+    _print_run(&runs[0], false);
+    _print_run(&runs[1], true);
+    printf("]}\n");
+
+    /* the point of the input buffer */
+    TEST_ASSERT(runs[1].transport_reads < runs[0].transport_reads);
+#ifdef AUTH_WITH_NOTLS
+    TEST_ASSERT(runs[1].recv_calls + runs[1].poll_calls < runs[0].recv_calls + runs[0].poll_calls);
+#endif
+    return 0;
+}
+
+int main(void)
+{
+    IOT_Log_Set_Level(eLOG_WARN);
+    alarm(120);
+
+    TEST_RUN(bench_read_syscalls);
+    return 0;
+}
@@ -0,0 +1,182 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "qcloud_iot_export.h"
+#include "qcloud_iot_import.h"
+#include "mqtt_client.h"
+#include "test_broker.h"
+#include "test_util.h"
+
+/*
+ * Time to fully subscribed after reconnect: the broker cuts the link of a client with FILTER_COUNT topic
+ * filters, and the time from the new network connection to the SUBACK of the last filter is measured.
+ * SUBSCRIBE packets written are counted at the network write of the client. The result goes to stdout
+ * as one JSON object.
+ */
+
+#define TEST_PRODUCT_ID     "TESTPRD001"
+#define TEST_DEVICE_NAME    "dev_bench"
+#define TEST_DEVICE_SECRET  "dGVzdC1kZXZpY2Utc2VjcmV0"
+
+/* more than MAX_MESSAGE_HANDLERS requests waiting for SUBACK */
+#define FILTER_COUNT        40
+#define ROUNDS              5
+
+/* first byte of SUBSCRIBE fixed header */
+#define SUBSCRIBE_HEADER    0x82
+
+static int      sg_suback_count;
+static int      sg_received;
+static int      sg_subscribe_packets;
+static uint64_t sg_connect_ns;
+static uint64_t sg_subscribed_ns;
+
+static int (*sg_real_connect)(Network *);
+static int (*sg_real_write)(Network *, unsigned char *, size_t, uint32_t, size_t *);
+
+static int _counting_connect(Network *pNetwork)
+{
+    sg_connect_ns = test_now_ns();
+    return sg_real_connect(pNetwork);
+}
+
+static int _counting_write(Network *pNetwork, unsigned char *data, size_t len, uint32_t timeout_ms,
+                           size_t *written_len)
+{
+    if (len > 0 && SUBSCRIBE_HEADER == data[0]) {
+        sg_subscribe_packets++;
+    }
+    return sg_real_write(pNetwork, data, len, timeout_ms, written_len);
+}
+
+static void _on_message(void *pClient, MQTTMessage *message, void *pUserData)
+{
+    sg_received++;
+}
+
+static void _on_sub_event(void *pClient, MQTTEventType event_type, void *pUserData)
+{
+    if (event_type == MQTT_EVENT_SUBCRIBE_SUCCESS) {
+        if (++sg_suback_count % FILTER_COUNT == 0) {
+            sg_subscribed_ns = test_now_ns();
+        }
+    }
+}
+
+static int _wait(void *client, int *counter, int expected)
+{
+    uint64_t deadline = test_now_ns() + 10000000000ull;
+
+    while (*counter < expected && test_now_ns() < deadline) {
+        IOT_MQTT_Yield(client, 1);
+    }
+    TEST_ASSERT_EQ(expected, *counter);
+    return 0;
+}
+
+static int _cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int bench_resubscribe(void)
+{
+    MQTTInitParams init_params = DEFAULT_MQTTINIT_PARAMS;
+    SubscribeParams sub_params = DEFAULT_SUB_PARAMS;
+    TestBrokerParams broker_params = {MQTT_SERVER_PORT_NOTLS, NULL, NULL, NULL, 0};
+    static char topics[FILTER_COUNT][64];
+    uint64_t elapsed_ns[ROUNDS];
+    int packets[ROUNDS];
+    Qcloud_IoT_Client *mqtt;
+    TestBroker *broker;
+    void *client;
+    int i, round;
+
+    broker = test_broker_start(&broker_params);
+    TEST_ASSERT(broker != NULL);
+
+    init_params.product_id = TEST_PRODUCT_ID;
+    init_params.device_name = TEST_DEVICE_NAME;
+    init_params.device_secret = TEST_DEVICE_SECRET;
+    init_params.command_timeout = 2000;
+    client = IOT_MQTT_Construct(&init_params);
+    TEST_ASSERT(client != NULL);
+
+    mqtt = (Qcloud_IoT_Client *)client;
+    sg_real_connect = mqtt->network_stack.connect;
+    sg_real_write = mqtt->network_stack.write;
+    mqtt->network_stack.connect = _counting_connect;
+    mqtt->network_stack.write = _counting_write;
+
+    /* one by one at first, as an application would */
+    sub_params.qos = QOS1;
+    sub_params.on_message_handler = _on_message;
+    sub_params.on_sub_event_handler = _on_sub_event;
+    for (i = 0; i < FILTER_COUNT; i++) {
+        snprintf(topics[i], sizeof(topics[i]), "%s/%s/filter%02d", TEST_PRODUCT_ID, TEST_DEVICE_NAME, i);
+        TEST_ASSERT(IOT_MQTT_Subscribe(client, topics[i], &sub_params) >= 0);
+        if (_wait(client, &sg_suback_count, i + 1)) {
+            return 1;
+        }
+    }
+    TEST_ASSERT_EQ(FILTER_COUNT, sg_subscribe_packets);
+
+    for (round = 0; round < ROUNDS; round++) {
+        sg_subscribe_packets = 0;
+        test_broker_drop_clients(broker);
+        if (_wait(client, &sg_suback_count, FILTER_COUNT * (round + 2))) {
+            return 1;
+        }
+        elapsed_ns[round] = sg_subscribed_ns - sg_connect_ns;
+        packets[round] = sg_subscribe_packets;
+
+        /* every filter is routed again by the broker */
+        TEST_ASSERT_EQ(0, test_broker_publish(broker, topics[round % FILTER_COUNT], "x", 1, 0));
+        TEST_ASSERT_EQ(0, test_broker_publish(broker, topics[FILTER_COUNT - 1], "x", 1, 0));
+        if (_wait(client, &sg_received, 2 * (round + 1))) {
+            return 1;
+        }
+    }
+    qsort(elapsed_ns, ROUNDS, sizeof(uint64_t), _cmp_u64);
+
+    printf("{\"bench\":\"resubscribe\",\"filters\":%d,\"rounds\":%d,\"subscribe_packets\":%d,"
+           "\"time_to_subscribed\":{\"min_us\":%.1f,\"median_us\":%.1f,\"max_us\":%.1f}}\n",
+           FILTER_COUNT, ROUNDS, packets[0], elapsed_ns[0] / 1e3, elapsed_ns[ROUNDS / 2] / 1e3,
+           elapsed_ns[ROUNDS - 1] / 1e3);
+
+    /* batched, not one packet per filter */
+    for (round = 0; round < ROUNDS; round++) {
+        TEST_ASSERT(packets[round] < FILTER_COUNT / 4);
+    }
+
+    IOT_MQTT_Destroy(&client);
+    test_broker_stop(broker);
+    return 0;
+}
+
+int main(void)
+{
+    IOT_Log_Set_Level(eLOG_ERROR);
+    alarm(120);
+
+    TEST_RUN(bench_resubscribe);
+    return 0;
+}
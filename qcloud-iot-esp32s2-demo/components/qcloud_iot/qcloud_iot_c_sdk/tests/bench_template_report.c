@@ -0,0 +1,204 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "qcloud_iot_export.h"
+#include "qcloud_iot_import.h"
+#include "data_template_client.h"
+#include "data_template_client_json.h"
+#include "json_parser.h"
+#include "test_util.h"
+
+/*
+ * Construction of a report of 64 properties of the template types by IOT_Template_JSON_ConstructReportArray
+ * with the JSON writer, against the snprintf at strlen of the buffer per key and value, as it was before.
+ */
+
+#define PROPERTY_COUNT  64
+#define REPORT_LEN      4096
+#define ROUNDS          20000
+
+static char           sg_keys[PROPERTY_COUNT][24];
+static int32_t        sg_ints[PROPERTY_COUNT];
+static float          sg_floats[PROPERTY_COUNT];
+static int8_t         sg_bools[PROPERTY_COUNT];
+static uint32_t       sg_times[PROPERTY_COUNT];
+static char           sg_strings[PROPERTY_COUNT][32];
+static DeviceProperty sg_props[PROPERTY_COUNT];
+static DeviceProperty *sg_prop_list[PROPERTY_COUNT];
+
+static void _init_properties(void)
+{
+    int i;
+
+    for (i = 0; i < PROPERTY_COUNT; i++) {
+        snprintf(sg_keys[i], sizeof(sg_keys[i]), "property_%02d", i);
+        sg_props[i].key = sg_keys[i];
+        switch (i % 5) {
+            case 0:
+                sg_ints[i] = i * 1000 - 7;
+                sg_props[i].data = &sg_ints[i];
+                sg_props[i].type = TYPE_TEMPLATE_INT;
+                break;
+            case 1:
+                sg_floats[i] = i * 1.25f + 0.1f;
+                sg_props[i].data = &sg_floats[i];
+                sg_props[i].type = TYPE_TEMPLATE_FLOAT;
+                break;
+            case 2:
+                sg_bools[i] = i & 1;
+                sg_props[i].data = &sg_bools[i];
+                sg_props[i].type = TYPE_TEMPLATE_BOOL;
+                break;
+            case 3:
+                sg_times[i] = 1602915123 + i;
+                sg_props[i].data = &sg_times[i];
+                sg_props[i].type = TYPE_TEMPLATE_TIME;
+                break;
+            default:
+                snprintf(sg_strings[i], sizeof(sg_strings[i]), "value of %d", i);
+                sg_props[i].data = sg_strings[i];
+                sg_props[i].data_buff_len = sizeof(sg_strings[i]);
+                sg_props[i].type = TYPE_TEMPLATE_STRING;
+                break;
+        }
+        sg_prop_list[i] = &sg_props[i];
+    }
+}
+
+/* put_json_node before the writer, each snprintf at strlen of the buffer */
+static int _put_json_node_strlen(char *jsonBuffer, size_t sizeOfBuffer, DeviceProperty *pProperty)
+{
+    size_t remain_size;
+    int    rc;
+
+    if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
+        return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
+    }
+    rc = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "\"%s\":", pProperty->key);
+    if (rc < 0 || (size_t)rc >= remain_size) {
+        return QCLOUD_ERR_JSON_BUFFER_TRUNCATED;
+    }
+
+    if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
+        return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
+    }
+    switch (pProperty->type) {
+        case JINT32:
+            rc = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "%" PRIi32 ",",
+                              *(int32_t *)pProperty->data);
+            break;
+        case JINT8:
+            rc = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "%" PRIi8 ",",
+                              *(int8_t *)pProperty->data);
+            break;
+        case JUINT32:
+            rc = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "%" PRIu32 ",",
+                              *(uint32_t *)pProperty->data);
+            break;
+        case JFLOAT:
+            rc = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "%f,", *(float *)pProperty->data);
+            break;
+        default:
+            rc = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "\"%s\",", (char *)pProperty->data);
+            break;
+    }
+
+    return (rc < 0 || (size_t)rc >= remain_size) ? QCLOUD_ERR_JSON_BUFFER_TRUNCATED : QCLOUD_RET_SUCCESS;
+}
+
+/* IOT_Template_JSON_ConstructReportArray before the writer */
+static int _construct_report_strlen(Qcloud_IoT_Template *pTemplate, char *jsonBuffer, size_t sizeOfBuffer)
+{
+    size_t remain_size;
+    int    rc, i;
+
+    HAL_Snprintf(jsonBuffer, sizeOfBuffer, "{\"clientToken\":\"%s-%u\"}", iot_device_info_get()->product_id,
+                 pTemplate->inner_data.token_num++);
+    remain_size = sizeOfBuffer - strlen(jsonBuffer);
+    HAL_Snprintf(jsonBuffer + strlen(jsonBuffer) - 1, remain_size, ", \"params\":{");
+
+    for (i = 0; i < PROPERTY_COUNT; i++) {
+        rc = _put_json_node_strlen(jsonBuffer, sizeOfBuffer, sg_prop_list[i]);
+        if (rc != QCLOUD_RET_SUCCESS) {
+            return rc;
+        }
+    }
+
+    if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
+        return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
+    }
+    HAL_Snprintf(jsonBuffer + strlen(jsonBuffer) - 1, remain_size, "}}");
+    return QCLOUD_RET_SUCCESS;
+}
+
+/* report is an object with params of all the properties */
+static int _check_report(const char *report)
+{
+    static json_token_t tokens[2 * PROPERTY_COUNT + 8];
+    int params;
+
+    TEST_ASSERT(json_tokenize(report, strlen(report), tokens, sizeof(tokens) / sizeof(tokens[0])) > 0);
+    params = json_token_lookup(report, tokens, 0, "params");
+    TEST_ASSERT(params > 0);
+    TEST_ASSERT_EQ(PROPERTY_COUNT, tokens[params].size);
+    return 0;
+}
+
+static int bench_report(void)
+{
+    static char         report[REPORT_LEN];
+    Qcloud_IoT_Template template;
+    uint64_t            t0, t1, t2;
+    size_t              writer_len, strlen_len;
+    int                 round;
+
+    memset(&template, 0, sizeof(template));
+    _init_properties();
+
+    t0 = test_now_ns();
+    for (round = 0; round < ROUNDS; round++) {
+        TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, IOT_Template_JSON_ConstructReportArray(&template, report, sizeof(report),
+                                                                                   PROPERTY_COUNT, sg_prop_list));
+    }
+    t1 = test_now_ns();
+    writer_len = strlen(report);
+    TEST_ASSERT_EQ(0, _check_report(report));
+
+    for (round = 0; round < ROUNDS; round++) {
+        TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, _construct_report_strlen(&template, report, sizeof(report)));
+    }
+    t2 = test_now_ns();
+    strlen_len = strlen(report);
+    TEST_ASSERT_EQ(0, _check_report(report));
+
+    printf("{\"bench\":\"template_report\",\"properties\":%d,\"writer_len\":%u,\"writer_us\":%.2f,"
+           "\"strlen_len\":%u,\"strlen_us\":%.2f}\n",
+           PROPERTY_COUNT, (unsigned)writer_len, (double)(t1 - t0) / 1000.0 / ROUNDS, (unsigned)strlen_len,
+           (double)(t2 - t1) / 1000.0 / ROUNDS);
+    return 0;
+}
+
+int main(void)
+{
+    IOT_Log_Set_Level(eLOG_WARN);
+
+    TEST_RUN(bench_report);
+    return 0;
+}
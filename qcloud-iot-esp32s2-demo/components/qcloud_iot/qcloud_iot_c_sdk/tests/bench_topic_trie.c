@@ -0,0 +1,201 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "qcloud_iot_export_log.h"
+#include "mqtt_client_topic_trie.h"
+#include "test_util.h"
+
+/*
+ * Topic trie vs the linear matcher it replaced: dispatch of 10k topics against 1k filters.
+ * Also checks that the trie picks the same handle as a scan of the filters in subscribe order.
+ */
+
+#define FILTER_COUNT    1000
+#define TOPIC_COUNT     10000
+#define TRIE_ROUNDS     10
+
+/* topic matcher of the subscription array, before the trie */
+static int _linear_match(const char *topic_filter, const char *topicName, size_t topicNameLen)
+{
+    const char *curf = topic_filter;
+    const char *curn = topicName;
+    const char *curn_end = curn + topicNameLen;
+
+    if (strlen(topic_filter) == topicNameLen && !memcmp(topic_filter, topicName, topicNameLen)) {
+        return 1;
+    }
+
+    while (*curf && (curn < curn_end)) {
+        if (*curf == '+' && *curn == '/') {
+            curf++;
+            continue;
+        }
+        if (*curn == '/' && *curf != '/') {
+            break;
+        }
+        if (*curf != '+' && *curf != '#' && *curf != *curn) {
+            break;
+        }
+        if (*curf == '+') {
+            const char *nextpos = curn + 1;
+            while (nextpos < curn_end && *nextpos != '/') {
+                nextpos = ++curn + 1;
+            }
+        } else if (*curf == '#') {
+            curn = curn_end - 1;
+        }
+        curf++;
+        curn++;
+    }
+
+    if (*curf == '\0') {
+        return curn == curn_end;
+    }
+
+    return (*curf == '#') || *(curf + 1) == '#' || (*curf == '+' && *(curn - 1) == '/');
+}
+
+static void _on_message(void *pClient, MQTTMessage *message, void *pUserData)
+{
+    (void)pClient;
+    (void)message;
+    (void)pUserData;
+}
+
+static char *_dup(const char *s)
+{
+    char *p = malloc(strlen(s) + 1);
+    strcpy(p, s);
+    return p;
+}
+
+static int _insert(TopicTrie *trie, const char *filter, long id)
+{
+    SubTopicHandle handle = {_dup(filter), _on_message, NULL, (void *)id, NULL, QOS0};
+    return topic_trie_insert(trie, &handle);
+}
+
+static long _trie_lookup(TopicTrie *trie, const char *topic)
+{
+    SubTopicHandle handle;
+    return topic_trie_match(trie, topic, strlen(topic), &handle) ? (long)handle.handler_user_data : 0;
+}
+
+static int test_same_result_as_linear_match(void)
+{
+    static const char *filters[] = {"a/b", "a/+", "a/#", "+/b/c", "#", "$thing/down/property/P/D", "x/+/z", "x/y/+", "q"};
+    static const char *topics[] = {"a/b", "a/c", "a", "a/b/c", "z/b/c", "$thing/down/property/P/D",
+                                   "x/y/z", "x/q/z", "q", "r", "a/", "/b/c"
+                                  };
+    int filter_count = sizeof(filters) / sizeof(filters[0]);
+    TopicTrie trie;
+    unsigned k;
+    int i;
+
+    TEST_ASSERT_EQ(0, topic_trie_init(&trie));
+    for (i = 0; i < filter_count; i++) {
+        TEST_ASSERT_EQ(0, _insert(&trie, filters[i], i + 1));
+    }
+    /* identical handle only updates the user data */
+    TEST_ASSERT_EQ(1, _insert(&trie, "a/b", 1));
+
+    for (k = 0; k < sizeof(topics) / sizeof(topics[0]); k++) {
+        long expected = 0;
+        for (i = 0; i < filter_count; i++) {
+            if (_linear_match(filters[i], topics[k], strlen(topics[k]))) {
+                expected = i + 1;
+                break;
+            }
+        }
+        printf("  %-28s linear=%ld trie=%ld\n", topics[k], expected, _trie_lookup(&trie, topics[k]));
+        TEST_ASSERT_EQ(expected, _trie_lookup(&trie, topics[k]));
+    }
+
+    TEST_ASSERT_EQ(1, topic_trie_remove(&trie, "a/+", NULL, NULL));
+    TEST_ASSERT_EQ(0, topic_trie_remove(&trie, "a/zz", NULL, NULL));
+    TEST_ASSERT_EQ(filter_count - 1, trie.handle_count);
+
+    topic_trie_deinit(&trie, NULL, NULL);
+    return 0;
+}
+
+static void _make_topic(char *buf, size_t len, int i, bool filter)
+{
+    static const char *methods[] = {"property", "event", "action"};
+
+    if (i % 10 == 0) {
+        snprintf(buf, len, filter ? "$gateway/dev%d/+" : "$gateway/dev%d/x", i);
+    } else {
+        snprintf(buf, len, "$thing/down/%s/prod%d/dev%d", methods[i % 3], i % 17, i);
+    }
+}
+
+static int bench_dispatch(void)
+{
+    static char filters[FILTER_COUNT][96];
+    static char topics[TOPIC_COUNT][96];
+    TopicTrie trie;
+    uint64_t t0, t1, t2;
+    long trie_hits = 0, linear_hits = 0;
+    int i, f, round;
+
+    TEST_ASSERT_EQ(0, topic_trie_init(&trie));
+    for (i = 0; i < FILTER_COUNT; i++) {
+        _make_topic(filters[i], sizeof(filters[i]), i, true);
+        TEST_ASSERT_EQ(0, _insert(&trie, filters[i], i + 1));
+    }
+    for (i = 0; i < TOPIC_COUNT; i++) {
+        _make_topic(topics[i], sizeof(topics[i]), i % FILTER_COUNT, false);
+    }
+
+    t0 = test_now_ns();
+    for (round = 0; round < TRIE_ROUNDS; round++) {
+        for (i = 0; i < TOPIC_COUNT; i++) {
+            trie_hits += _trie_lookup(&trie, topics[i]) ? 1 : 0;
+        }
+    }
+    t1 = test_now_ns();
+    for (i = 0; i < TOPIC_COUNT; i++) {
+        for (f = 0; f < FILTER_COUNT; f++) {
+            if (_linear_match(filters[f], topics[i], strlen(topics[i]))) {
+                linear_hits++;
+                break;
+            }
+        }
+    }
+    t2 = test_now_ns();
+
+    printf("  filters=%d topics=%d trie: %.2f us/topic, linear: %.2f us/topic\n", FILTER_COUNT, TOPIC_COUNT,
+           (double)(t1 - t0) / 1000.0 / (TOPIC_COUNT * TRIE_ROUNDS), (double)(t2 - t1) / 1000.0 / TOPIC_COUNT);
+
+    TEST_ASSERT_EQ(TOPIC_COUNT * TRIE_ROUNDS, trie_hits);
+    TEST_ASSERT_EQ(TOPIC_COUNT, linear_hits);
+
+    topic_trie_deinit(&trie, NULL, NULL);
+    return 0;
+}
+
+int main(void)
+{
+    IOT_Log_Set_Level(eLOG_WARN);
+
+    TEST_RUN(test_same_result_as_linear_match);
+    TEST_RUN(bench_dispatch);
+    return 0;
+}
@@ -0,0 +1,274 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "qcloud_iot_export.h"
+#include "qcloud_iot_import.h"
+#include "utils_base64.h"
+#include "test_broker.h"
+#include "test_util.h"
+
+/*
+ * Publish latency under concurrent inbound load, the application publishing QoS1 at a fixed rate
+ * while the broker floods the client with QoS1 messages whose handler does some work.
+ * "yield_thread" is the way before dual-task mode: a thread of the application calls IOT_MQTT_Yield
+ * and publishing threads write the socket themselves. "rx_tx_tasks" runs the reader and writer tasks.
+ * Latency of the publish call, and from the call until the broker got the message, go to stdout as JSON.
+ */
+
+#define TEST_PRODUCT_ID     "TESTPRD001"
+#define TEST_DEVICE_NAME    "dev_bench"
+#define TEST_DEVICE_SECRET  "dGVzdC1kZXZpY2Utc2VjcmV0"
+#define FLOOD_TOPIC         TEST_PRODUCT_ID "/" TEST_DEVICE_NAME "/control"
+#define UP_TOPIC            TEST_PRODUCT_ID "/" TEST_DEVICE_NAME "/data"
+
+#define PUB_COUNT           2000
+#define PUB_INTERVAL_US     500
+#define PUB_PAYLOAD_LEN     128
+#define FLOOD_PAYLOAD_LEN   512
+#define FLOOD_BURST         16          /* messages each millisecond */
+#define HANDLER_WORK_NS     20000
+
+#ifdef AUTH_WITH_NOTLS
+#define BENCH_TRANSPORT     "tcp"
+#define BENCH_PORT          MQTT_SERVER_PORT_NOTLS
+#else
+#define BENCH_TRANSPORT     "tls"
+#define BENCH_PORT          MQTT_SERVER_PORT_TLS
+#endif
+
+typedef struct {
+    const char  *mode;
+    uint64_t    call_ns[PUB_COUNT];         /* time spent in IOT_MQTT_Publish */
+    uint64_t    arrive_ns[PUB_COUNT];       /* from publish called to broker received */
+    int         arrived;
+    int         failed;
+    uint64_t    flood_sent;
+    uint32_t    flood_received;
+} BenchRun;
+
+static BenchRun         sg_runs[2];
+static BenchRun         *sg_run;
+static TestBroker       *sg_broker;
+static volatile bool    sg_subscribed;
+static volatile bool    sg_running;
+static volatile uint32_t sg_flood_received;
+
+static void _on_publish(TestBroker *broker, const char *topic, const char *payload, size_t len, void *context)
+{
+    uint64_t now_ns = test_now_ns();
+    char stamp[24];
+    unsigned long long sent_ns;
+    int seq;
+
+    if (strcmp(topic, UP_TOPIC)) {
+        return;
+    }
+    len = len < sizeof(stamp) - 1 ? len : sizeof(stamp) - 1;
+    memcpy(stamp, payload, len);
+    stamp[len] = '\0';
+    if (sscanf(stamp, "%d:%llu", &seq, &sent_ns) != 2 || seq < 0 || seq >= PUB_COUNT) {
+        return;
+    }
+    sg_run->arrive_ns[seq] = now_ns - sent_ns;
+    sg_run->arrived++;
+}
+
+static void _on_message(void *pClient, MQTTMessage *message, void *pUserData)
+{
+    uint64_t until_ns = test_now_ns() + HANDLER_WORK_NS;
+
+    /* stands for parsing and acting on the message */
+    while (test_now_ns() < until_ns) {
+    }
+    sg_flood_received++;
+}
+
+static void _on_sub_event(void *pClient, MQTTEventType event_type, void *pUserData)
+{
+    if (event_type == MQTT_EVENT_SUBCRIBE_SUCCESS) {
+        sg_subscribed = true;
+    }
+}
+
+static void *_flood_thread(void *arg)
+{
+    static char payload[FLOOD_PAYLOAD_LEN];
+    int i;
+
+    memset(payload, 'f', sizeof(payload));
+    while (sg_running) {
+        for (i = 0; i < FLOOD_BURST; i++) {
+            test_broker_publish(sg_broker, FLOOD_TOPIC, payload, sizeof(payload), 1);
+            sg_run->flood_sent++;
+        }
+        usleep(1000);
+    }
+    return NULL;
+}
+
+static void *_yield_thread(void *client)
+{
+    while (sg_running) {
+        IOT_MQTT_Yield(client, 10);
+    }
+    return NULL;
+}
+
+static int _cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int _run(BenchRun *run, bool tasks)
+{
+    MQTTInitParams init_params = DEFAULT_MQTTINIT_PARAMS;
+    SubscribeParams sub_params = DEFAULT_SUB_PARAMS;
+    PublishParams pub_params = DEFAULT_PUB_PARAMS;
+    char payload[PUB_PAYLOAD_LEN + 1];
+    pthread_t flood, yield;
+    uint64_t start_ns, next_ns;
+    void *client;
+    int len, i;
+
+    sg_run = run;
+    run->mode = tasks ? "rx_tx_tasks" : "yield_thread";
+    sg_subscribed = false;
+    sg_flood_received = 0;
+
+    init_params.product_id = TEST_PRODUCT_ID;
+    init_params.device_name = TEST_DEVICE_NAME;
+    init_params.device_secret = TEST_DEVICE_SECRET;
+    init_params.command_timeout = 2000;
+    client = IOT_MQTT_Construct(&init_params);
+    TEST_ASSERT(client != NULL);
+
+    sg_running = true;
+    if (tasks) {
+        TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, IOT_MQTT_StartRxTask(client, 3));
+        TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, IOT_MQTT_StartTxTask(client, 3));
+    } else {
+        TEST_ASSERT_EQ(0, pthread_create(&yield, NULL, _yield_thread, client));
+    }
+
+    sub_params.qos = QOS1;
+    sub_params.on_message_handler = _on_message;
+    sub_params.on_sub_event_handler = _on_sub_event;
+    TEST_ASSERT(IOT_MQTT_Subscribe(client, FLOOD_TOPIC, &sub_params) >= 0);
+    for (i = 0; i < 500 && !sg_subscribed; i++) {
+        usleep(10000);
+    }
+    TEST_ASSERT(sg_subscribed);
+
+    TEST_ASSERT_EQ(0, pthread_create(&flood, NULL, _flood_thread, NULL));
+    usleep(100000);
+
+    pub_params.qos = QOS1;
+    pub_params.payload = payload;
+    pub_params.payload_len = PUB_PAYLOAD_LEN;
+    next_ns = test_now_ns();
+    for (i = 0; i < PUB_COUNT; i++) {
+        while (test_now_ns() < next_ns) {
+            usleep(50);
+        }
+        next_ns += PUB_INTERVAL_US * 1000ull;
+
+        start_ns = test_now_ns();
+        len = snprintf(payload, sizeof(payload), "%d:%llu:", i, (unsigned long long)start_ns);
+        memset(payload + len, 'x', PUB_PAYLOAD_LEN - len);
+        if (IOT_MQTT_Publish(client, UP_TOPIC, &pub_params) < 0) {
+            run->failed++;
+        }
+        run->call_ns[i] = test_now_ns() - start_ns;
+    }
+
+    for (i = 0; i < 300 && run->arrived + run->failed < PUB_COUNT; i++) {
+        usleep(10000);
+    }
+    sg_running = false;
+    pthread_join(flood, NULL);
+    if (!tasks) {
+        pthread_join(yield, NULL);
+    }
+    run->flood_received = sg_flood_received;
+
+    /* stops the tasks as well */
+    IOT_MQTT_Destroy(&client);
+
+    TEST_ASSERT_EQ(PUB_COUNT, run->arrived + run->failed);
+    qsort(run->call_ns, PUB_COUNT, sizeof(uint64_t), _cmp_u64);
+    /* publishes failed were never stamped, they sort first as 0 */
+    qsort(run->arrive_ns, PUB_COUNT, sizeof(uint64_t), _cmp_u64);
+    return 0;
+}
+
+static void _print_run(const BenchRun *run, bool last)
+{
+    const uint64_t *arrive = run->arrive_ns + run->failed;
+    int n = run->arrived;
+
+    printf("{\"mode\":\"%s\",\"failed\":%d,\"flood_sent\":%llu,\"flood_received\":%u,"
+           "\"publish_call\":{\"p50_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f},"
+           "\"to_broker\":{\"p50_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f}}%s",
+           run->mode, run->failed, (unsigned long long)run->flood_sent, run->flood_received,
+           run->call_ns[PUB_COUNT / 2] / 1e3, run->call_ns[PUB_COUNT * 99 / 100] / 1e3,
+           run->call_ns[PUB_COUNT - 1] / 1e3, arrive[n / 2] / 1e3, arrive[n * 99 / 100] / 1e3,
+           arrive[n - 1] / 1e3, last ? "" : ",");
+}
+
+static int bench_tx_task(void)
+{
+    TestBrokerParams broker_params = {BENCH_PORT, _on_publish, NULL, NULL, 0};
+
+#ifndef AUTH_WITH_NOTLS
+    static unsigned char psk[64];
+    size_t psk_len = 0;
+
+    TEST_ASSERT_EQ(0, qcloud_iot_utils_base64decode(psk, sizeof(psk), &psk_len, (const unsigned char *)TEST_DEVICE_SECRET,
+                                                    strlen(TEST_DEVICE_SECRET)));
+    broker_params.psk = psk;
+    broker_params.psk_len = psk_len;
+#endif
+    sg_broker = test_broker_start(&broker_params);
+    TEST_ASSERT(sg_broker != NULL);
+
+    TEST_ASSERT_EQ(0, _run(&sg_runs[0], false));
+    TEST_ASSERT_EQ(0, _run(&sg_runs[1], true));
+    test_broker_stop(sg_broker);
+
+    printf("{\"bench\":\"mqtt_tx_task\",\"transport\":\"%s\",\"publishes\":%d,\"interval_us\":%d,"
+           "\"flood\":{\"msgs_per_ms\":%d,\"payload_len\":%d,\"handler_us\":%d},\"runs\":[",
+           BENCH_TRANSPORT, PUB_COUNT, PUB_INTERVAL_US, FLOOD_BURST, FLOOD_PAYLOAD_LEN, HANDLER_WORK_NS / 1000);
+    _print_run(&sg_runs[0], false);
+    _print_run(&sg_runs[1], true);
+    printf("]}\n");
+
+    return 0;
+}
+
+int main(void)
+{
+    IOT_Log_Set_Level(eLOG_ERROR);
+    alarm(120);
+
+    TEST_RUN(bench_tx_task);
+    return 0;
+}
@@ -0,0 +1,29 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "qcloud_iot_export.h"
+#include "qcloud_iot_demo.h"
+
+/*
+ * Runs one of main/samples on host, as the demo task of main/main.c does on the device.
+ * SAMPLE_DEMO is the eDemoType of the sample linked in, device info comes from HAL_Device_freertos.c.
+ */
+
+int main(void)
+{
+    IOT_Log_Set_Level(eLOG_DEBUG);
+
+    return qcloud_iot_explorer_demo(SAMPLE_DEMO) == QCLOUD_RET_SUCCESS ? 0 : 1;
+}
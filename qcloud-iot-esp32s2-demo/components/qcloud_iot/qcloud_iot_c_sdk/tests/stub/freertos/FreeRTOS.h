@@ -0,0 +1,27 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef QCLOUD_IOT_TEST_STUB_FREERTOS_H_
+#define QCLOUD_IOT_TEST_STUB_FREERTOS_H_
+
+/* just enough of FreeRTOS for platform/HAL_Timer_freertos.c on host, the tick count is set by the test */
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+
+#define portTICK_PERIOD_MS  ((TickType_t)10)
+
+#endif  // QCLOUD_IOT_TEST_STUB_FREERTOS_H_
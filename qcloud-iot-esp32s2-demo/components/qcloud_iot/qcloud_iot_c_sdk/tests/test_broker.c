@@ -0,0 +1,841 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include "test_broker.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#define BROKER_MAX_PACKET       (1024 * 1024)
+#define BROKER_MAX_OUT          (16 * 1024 * 1024)
+#define BROKER_EVENTS           64
+
+typedef struct BrokerConn {
+    struct BrokerConn   *prev, *next;
+    int                 fd;
+    SSL                 *ssl;           // NULL for plain TCP
+    bool                ready;          // TLS handshake done, always true for plain TCP
+    bool                dead;           // closed at the end of the loop round
+    unsigned char       *in;
+    size_t              in_len, in_size;
+    unsigned char       *out;
+    size_t              out_len, out_size;
+    bool                want_out;       // EPOLLOUT is armed
+    char                **filters;      // subscriptions
+    uint8_t             *qos;
+    int                 filter_count, filter_size;
+    uint16_t            next_id;
+} BrokerConn;
+
+struct TestBroker {
+    TestBrokerParams    params;
+    pthread_t           thread;
+    pthread_mutex_t     lock;           // recursive, publish hook calls back in
+    int                 listen_fd;
+    int                 epoll_fd;
+    int                 wake_fd;
+    SSL_CTX             *ssl_ctx;       // NULL for plain TCP
+    bool                stop;
+    bool                refuse;
+    BrokerConn          *conns;
+    int                 subscribers;    // connections with any subscription, routing stops after them
+    TestBrokerStats     stats;
+};
+
+static int _set_nonblock(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    return (flags < 0) ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static int _reserve(unsigned char **buf, size_t *size, size_t need)
+{
+    size_t new_size = *size ? *size : 256;
+    unsigned char *p;
+
+    if (need <= *size) {
+        return 0;
+    }
+    while (new_size < need) {
+        new_size *= 2;
+    }
+    if ((p = realloc(*buf, new_size)) == NULL) {
+        return -1;
+    }
+    *buf = p;
+    *size = new_size;
+    return 0;
+}
+
+/* bytes moved, 0 if it would block, -1 if the connection is broken */
+static ssize_t _conn_io_recv(BrokerConn *conn, void *buf, size_t len)
+{
+    ssize_t n;
+    int err;
+
+    if (conn->ssl != NULL) {
+        n = SSL_read(conn->ssl, buf, (int)len);
+        if (n > 0) {
+            return n;
+        }
+        err = SSL_get_error(conn->ssl, (int)n);
+        return (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) ? 0 : -1;
+    }
+
+    do {
+        n = recv(conn->fd, buf, len, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n > 0) {
+        return n;
+    }
+    return (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) ? 0 : -1;
+}
+
+static ssize_t _conn_io_send(BrokerConn *conn, const void *buf, size_t len)
+{
+    ssize_t n;
+    int err;
+
+    if (conn->ssl != NULL) {
+        n = SSL_write(conn->ssl, buf, (int)len);
+        if (n > 0) {
+            return n;
+        }
+        err = SSL_get_error(conn->ssl, (int)n);
+        return (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) ? 0 : -1;
+    }
+
+    do {
+        n = send(conn->fd, buf, len, MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+    if (n > 0) {
+        return n;
+    }
+    return (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) ? 0 : -1;
+}
+
+static void _conn_kill(BrokerConn *conn)
+{
+    if (!conn->dead) {
+        conn->dead = true;
+        shutdown(conn->fd, SHUT_RDWR);
+    }
+}
+
+static void _conn_arm_out(TestBroker *broker, BrokerConn *conn, bool want)
+{
+    struct epoll_event ev;
+
+    if (conn->want_out == want) {
+        return;
+    }
+    conn->want_out = want;
+    ev.events = EPOLLIN | (want ? EPOLLOUT : 0);
+    ev.data.ptr = conn;
+    epoll_ctl(broker->epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev);
+}
+
+static void _conn_flush(TestBroker *broker, BrokerConn *conn)
+{
+    size_t sent = 0;
+    ssize_t n;
+
+    while (sent < conn->out_len) {
+        n = _conn_io_send(conn, conn->out + sent, conn->out_len - sent);
+        if (n > 0) {
+            sent += n;
+        } else if (n == 0) {
+            break;
+        } else {
+            _conn_kill(conn);
+            return;
+        }
+    }
+
+    memmove(conn->out, conn->out + sent, conn->out_len - sent);
+    conn->out_len -= sent;
+    _conn_arm_out(broker, conn, conn->out_len > 0);
+}
+
+static void _conn_send(TestBroker *broker, BrokerConn *conn, const void *head, size_t head_len, const void *body,
+                       size_t body_len)
+{
+    if (conn->dead) {
+        return;
+    }
+    if (conn->out_len + head_len + body_len > BROKER_MAX_OUT ||
+        _reserve(&conn->out, &conn->out_size, conn->out_len + head_len + body_len)) {
+        _conn_kill(conn);
+        return;
+    }
+    memcpy(conn->out + conn->out_len, head, head_len);
+    memcpy(conn->out + conn->out_len + head_len, body, body_len);
+    conn->out_len += head_len + body_len;
+
+    if (conn->ready && !conn->want_out) {
+        _conn_flush(broker, conn);
+    }
+}
+
+static void _send_ack(TestBroker *broker, BrokerConn *conn, unsigned char type, uint16_t id)
+{
+    unsigned char ack[4] = {type, 2, (unsigned char)(id >> 8), (unsigned char)id};
+    _conn_send(broker, conn, ack, sizeof(ack), NULL, 0);
+}
+
+static size_t _put_remaining_len(unsigned char *p, size_t len)
+{
+    size_t n = 0;
+
+    do {
+        p[n] = len % 128;
+        len /= 128;
+        if (len) {
+            p[n] |= 0x80;
+        }
+        n++;
+    } while (len);
+
+    return n;
+}
+
+static bool _topic_match(const char *filter, const char *topic)
+{
+    while (*filter) {
+        if (*filter == '#') {
+            return true;
+        }
+        if (*filter == '+') {
+            while (*topic && *topic != '/') {
+                topic++;
+            }
+            filter++;
+            continue;
+        }
+        if (*filter != *topic) {
+            /* "a/#" matches "a" too */
+            return *topic == '\0' && filter[0] == '/' && filter[1] == '#' && filter[2] == '\0';
+        }
+        filter++;
+        topic++;
+    }
+
+    return *topic == '\0';
+}
+
+static void _deliver(TestBroker *broker, BrokerConn *conn, const char *topic, const void *payload, size_t len,
+                     int qos)
+{
+    size_t topic_len = strlen(topic), n;
+    size_t remaining = 2 + topic_len + (qos ? 2 : 0) + len;
+    unsigned char *p;
+
+    /* fixed header, topic and packet id go in one piece, payload in another */
+    unsigned char *packet = malloc(1 + 4 + 2 + topic_len + 2);
+    if (packet == NULL) {
+        _conn_kill(conn);
+        return;
+    }
+    p = packet;
+    *p++ = 0x30 | (qos << 1);
+    p += _put_remaining_len(p, remaining);
+    *p++ = (unsigned char)(topic_len >> 8);
+    *p++ = (unsigned char)topic_len;
+    memcpy(p, topic, topic_len);
+    p += topic_len;
+    if (qos) {
+        if (++conn->next_id == 0) {
+            conn->next_id = 1;
+        }
+        *p++ = (unsigned char)(conn->next_id >> 8);
+        *p++ = (unsigned char)conn->next_id;
+    }
+    n = p - packet;
+
+    _conn_send(broker, conn, packet, n, payload, len);
+    free(packet);
+    broker->stats.publish_out++;
+}
+
+static void _route(TestBroker *broker, const char *topic, const void *payload, size_t len, int qos)
+{
+    BrokerConn *conn;
+    int i, sub_qos, seen = 0;
+
+    for (conn = broker->conns; conn != NULL && seen < broker->subscribers; conn = conn->next) {
+        if (conn->filter_count == 0) {
+            continue;
+        }
+        seen++;
+        if (conn->dead) {
+            continue;
+        }
+        for (i = 0, sub_qos = -1; i < conn->filter_count; i++) {
+            if (conn->qos[i] > sub_qos && _topic_match(conn->filters[i], topic)) {
+                sub_qos = conn->qos[i];
+            }
+        }
+        if (sub_qos >= 0) {
+            _deliver(broker, conn, topic, payload, len, qos < sub_qos ? qos : sub_qos);
+        }
+    }
+}
+
+static void _subscribe(TestBroker *broker, BrokerConn *conn, const char *filter, size_t filter_len, uint8_t qos)
+{
+    int i;
+
+    for (i = 0; i < conn->filter_count; i++) {
+        if (strlen(conn->filters[i]) == filter_len && !memcmp(conn->filters[i], filter, filter_len)) {
+            conn->qos[i] = qos;
+            return;
+        }
+    }
+
+    if (conn->filter_count == conn->filter_size) {
+        int size = conn->filter_size ? conn->filter_size * 2 : 8;
+        char **filters = realloc(conn->filters, size * sizeof(char *));
+        uint8_t *qoses;
+        if (filters == NULL) {
+            return;
+        }
+        conn->filters = filters;
+        if ((qoses = realloc(conn->qos, size)) == NULL) {
+            return;
+        }
+        conn->qos = qoses;
+        conn->filter_size = size;
+    }
+
+    conn->filters[conn->filter_count] = strndup(filter, filter_len);
+    if (conn->filters[conn->filter_count] != NULL) {
+        conn->qos[conn->filter_count++] = qos;
+        broker->subscribers += (conn->filter_count == 1);
+    }
+}
+
+static void _unsubscribe(TestBroker *broker, BrokerConn *conn, const char *filter, size_t filter_len)
+{
+    int i;
+
+    for (i = 0; i < conn->filter_count; i++) {
+        if (strlen(conn->filters[i]) == filter_len && !memcmp(conn->filters[i], filter, filter_len)) {
+            free(conn->filters[i]);
+            conn->filters[i] = conn->filters[conn->filter_count - 1];
+            conn->qos[i] = conn->qos[conn->filter_count - 1];
+            conn->filter_count--;
+            broker->subscribers -= (conn->filter_count == 0);
+            return;
+        }
+    }
+}
+
+static void _handle_publish(TestBroker *broker, BrokerConn *conn, unsigned char flags, const unsigned char *p,
+                            size_t len)
+{
+    int qos = (flags >> 1) & 3;
+    size_t topic_len, pos;
+    uint16_t id = 0;
+    char *topic;
+
+    if (len < 2 || (topic_len = (p[0] << 8) | p[1]) + 2 + (qos ? 2 : 0) > len) {
+        _conn_kill(conn);
+        return;
+    }
+    pos = 2 + topic_len;
+    if (qos) {
+        id = (p[pos] << 8) | p[pos + 1];
+        pos += 2;
+    }
+    if ((topic = strndup((const char *)p + 2, topic_len)) == NULL) {
+        _conn_kill(conn);
+        return;
+    }
+
+    broker->stats.publish_in++;
+    if (qos == 1) {
+        _send_ack(broker, conn, 0x40, id);
+    } else if (qos == 2) {
+        _send_ack(broker, conn, 0x50, id);
+    }
+
+    if (broker->params.on_publish != NULL) {
+        broker->params.on_publish(broker, topic, (const char *)p + pos, len - pos, broker->params.context);
+    }
+    _route(broker, topic, p + pos, len - pos, qos);
+    free(topic);
+}
+
+static void _handle_subscribe(TestBroker *broker, BrokerConn *conn, const unsigned char *p, size_t len,
+                              bool subscribe)
+{
+    unsigned char codes[256];
+    unsigned char head[8];
+    size_t pos = 2, filter_len, count = 0, n;
+
+    if (len < 2) {
+        _conn_kill(conn);
+        return;
+    }
+    while (pos + 2 <= len) {
+        filter_len = (p[pos] << 8) | p[pos + 1];
+        if (pos + 2 + filter_len + (subscribe ? 1 : 0) > len || count == sizeof(codes)) {
+            _conn_kill(conn);
+            return;
+        }
+        if (subscribe) {
+            uint8_t qos = p[pos + 2 + filter_len] & 3;
+            qos = qos > 1 ? 1 : qos;
+            _subscribe(broker, conn, (const char *)p + pos + 2, filter_len, qos);
+            codes[count++] = qos;
+            pos += 3 + filter_len;
+        } else {
+            _unsubscribe(broker, conn, (const char *)p + pos + 2, filter_len);
+            pos += 2 + filter_len;
+        }
+    }
+
+    if (!subscribe) {
+        _send_ack(broker, conn, 0xB0, (p[0] << 8) | p[1]);
+        return;
+    }
+    head[0] = 0x90;
+    n = 1 + _put_remaining_len(head + 1, 2 + count);
+    head[n++] = p[0];
+    head[n++] = p[1];
+    _conn_send(broker, conn, head, n, codes, count);
+}
+
+static void _handle_packet(TestBroker *broker, BrokerConn *conn, unsigned char header, const unsigned char *p,
+                           size_t len)
+{
+    static const unsigned char connack[] = {0x20, 2, 0, 0};
+    static const unsigned char pingresp[] = {0xD0, 0};
+
+    switch (header >> 4) {
+        case 1:
+            broker->stats.connects++;
+            _conn_send(broker, conn, connack, sizeof(connack), NULL, 0);
+            break;
+        case 3:
+            _handle_publish(broker, conn, header & 0x0F, p, len);
+            break;
+        case 6:
+            if (len >= 2) {
+                _send_ack(broker, conn, 0x70, (p[0] << 8) | p[1]);
+            }
+            break;
+        case 8:
+            _handle_subscribe(broker, conn, p, len, true);
+            break;
+        case 10:
+            _handle_subscribe(broker, conn, p, len, false);
+            break;
+        case 12:
+            _conn_send(broker, conn, pingresp, sizeof(pingresp), NULL, 0);
+            break;
+        case 14:
+            _conn_kill(conn);
+            break;
+        default:
+            /* PUBACK, PUBREC and PUBCOMP of deliveries, nothing is retransmitted */
+            break;
+    }
+}
+
+static void _conn_read(TestBroker *broker, BrokerConn *conn)
+{
+    size_t pos, len, hdr, mult;
+    ssize_t n;
+
+    for (;;) {
+        if (_reserve(&conn->in, &conn->in_size, conn->in_len + 4096)) {
+            _conn_kill(conn);
+            return;
+        }
+        n = _conn_io_recv(conn, conn->in + conn->in_len, conn->in_size - conn->in_len);
+        if (n > 0) {
+            conn->in_len += n;
+        } else if (n == 0) {
+            break;
+        } else {
+            _conn_kill(conn);
+            return;
+        }
+    }
+
+    pos = 0;
+    while (!conn->dead && conn->in_len - pos >= 2) {
+        len = 0;
+        mult = 1;
+        for (hdr = 1; hdr < 5; hdr++) {
+            if (pos + hdr >= conn->in_len) {
+                break;
+            }
+            len += (conn->in[pos + hdr] & 0x7F) * mult;
+            mult *= 128;
+            if (!(conn->in[pos + hdr] & 0x80)) {
+                break;
+            }
+        }
+        if (hdr == 5 || len > BROKER_MAX_PACKET) {
+            _conn_kill(conn);
+            return;
+        }
+        if (pos + hdr >= conn->in_len || pos + hdr + 1 + len > conn->in_len) {
+            break;
+        }
+        _handle_packet(broker, conn, conn->in[pos], conn->in + pos + hdr + 1, len);
+        pos += hdr + 1 + len;
+    }
+
+    memmove(conn->in, conn->in + pos, conn->in_len - pos);
+    conn->in_len -= pos;
+}
+
+static void _conn_handshake(TestBroker *broker, BrokerConn *conn)
+{
+    int rc = SSL_accept(conn->ssl);
+
+    if (rc == 1) {
+        conn->ready = true;
+        _conn_arm_out(broker, conn, conn->out_len > 0);
+        _conn_read(broker, conn);
+        return;
+    }
+
+    switch (SSL_get_error(conn->ssl, rc)) {
+        case SSL_ERROR_WANT_READ:
+            _conn_arm_out(broker, conn, false);
+            break;
+        case SSL_ERROR_WANT_WRITE:
+            _conn_arm_out(broker, conn, true);
+            break;
+        default:
+            _conn_kill(conn);
+            break;
+    }
+}
+
+static void _conn_free(TestBroker *broker, BrokerConn *conn)
+{
+    int i;
+
+    if (conn->prev) {
+        conn->prev->next = conn->next;
+    } else {
+        broker->conns = conn->next;
+    }
+    if (conn->next) {
+        conn->next->prev = conn->prev;
+    }
+    broker->stats.clients--;
+    broker->subscribers -= (conn->filter_count > 0);
+
+    epoll_ctl(broker->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    if (conn->ssl != NULL) {
+        SSL_free(conn->ssl);
+    }
+    close(conn->fd);
+    for (i = 0; i < conn->filter_count; i++) {
+        free(conn->filters[i]);
+    }
+    free(conn->filters);
+    free(conn->qos);
+    free(conn->in);
+    free(conn->out);
+    free(conn);
+}
+
+static void _accept(TestBroker *broker)
+{
+    struct epoll_event ev;
+    BrokerConn *conn;
+    int fd, one = 1;
+
+    while ((fd = accept4(broker->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        if (broker->refuse || (conn = calloc(1, sizeof(BrokerConn))) == NULL) {
+            close(fd);
+            continue;
+        }
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        conn->fd = fd;
+        conn->ready = (broker->ssl_ctx == NULL);
+        if (broker->ssl_ctx != NULL) {
+            if ((conn->ssl = SSL_new(broker->ssl_ctx)) == NULL || SSL_set_fd(conn->ssl, fd) != 1) {
+                SSL_free(conn->ssl);
+                close(fd);
+                free(conn);
+                continue;
+            }
+            SSL_set_accept_state(conn->ssl);
+        }
+        ev.events = EPOLLIN;
+        ev.data.ptr = conn;
+        if (epoll_ctl(broker->epoll_fd, EPOLL_CTL_ADD, fd, &ev)) {
+            SSL_free(conn->ssl);
+            close(fd);
+            free(conn);
+            continue;
+        }
+        conn->next = broker->conns;
+        if (broker->conns) {
+            broker->conns->prev = conn;
+        }
+        broker->conns = conn;
+        broker->stats.clients++;
+    }
+}
+
+static void *_broker_thread(void *arg)
+{
+    TestBroker *broker = (TestBroker *)arg;
+    struct epoll_event events[BROKER_EVENTS];
+    BrokerConn *conn, *next;
+    uint64_t value;
+    int i, n;
+
+    for (;;) {
+        n = epoll_wait(broker->epoll_fd, events, BROKER_EVENTS, -1);
+
+        pthread_mutex_lock(&broker->lock);
+        if (broker->stop) {
+            pthread_mutex_unlock(&broker->lock);
+            break;
+        }
+        for (i = 0; i < n; i++) {
+            if (events[i].data.ptr == NULL) {
+                _accept(broker);
+            } else if (events[i].data.ptr == (void *)broker) {
+                if (read(broker->wake_fd, &value, sizeof(value)) < 0) {
+                    /* nothing to read, woken for reap */
+                }
+            } else {
+                conn = (BrokerConn *)events[i].data.ptr;
+                if (conn->dead) {
+                    continue;
+                }
+                if (!conn->ready) {
+                    _conn_handshake(broker, conn);
+                    continue;
+                }
+                if (events[i].events & EPOLLOUT) {
+                    _conn_flush(broker, conn);
+                }
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    _conn_read(broker, conn);
+                }
+            }
+        }
+        for (conn = broker->conns; conn != NULL; conn = next) {
+            next = conn->next;
+            if (conn->dead) {
+                _conn_free(broker, conn);
+            }
+        }
+        pthread_mutex_unlock(&broker->lock);
+    }
+
+    return NULL;
+}
+
+static unsigned int _psk_server_cb(SSL *ssl, const char *identity, unsigned char *psk, unsigned int max_psk_len)
+{
+    TestBroker *broker = (TestBroker *)SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+
+    /* any identity, every client is a device of the same secret */
+    if (broker->params.psk_len > max_psk_len) {
+        return 0;
+    }
+    memcpy(psk, broker->params.psk, broker->params.psk_len);
+    return (unsigned int)broker->params.psk_len;
+}
+
+static SSL_CTX *_ssl_ctx_new(TestBroker *broker)
+{
+    SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+
+    if (ctx == NULL) {
+        return NULL;
+    }
+    SSL_CTX_set_max_proto_version(ctx, TLS1_2_VERSION);
+    SSL_CTX_set_security_level(ctx, 0);
+    /* out buffer is moved and grown between retries of a partial write */
+    SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+    if (SSL_CTX_set_cipher_list(ctx, "PSK") != 1) {
+        SSL_CTX_free(ctx);
+        return NULL;
+    }
+    SSL_CTX_set_app_data(ctx, broker);
+    SSL_CTX_set_psk_server_callback(ctx, _psk_server_cb);
+
+    return ctx;
+}
+
+static void _wake(TestBroker *broker)
+{
+    uint64_t one = 1;
+
+    if (write(broker->wake_fd, &one, sizeof(one)) < 0) {
+        /* counter is full, the loop is woken anyway */
+    }
+}
+
+TestBroker *test_broker_start(const TestBrokerParams *pParams)
+{
+    struct sockaddr_in addr;
+    struct epoll_event ev;
+    pthread_mutexattr_t attr;
+    TestBroker *broker;
+    int one = 1;
+
+    if ((broker = calloc(1, sizeof(TestBroker))) == NULL) {
+        return NULL;
+    }
+    broker->params = *pParams;
+    broker->listen_fd = broker->epoll_fd = broker->wake_fd = -1;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&broker->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    if (pParams->psk_len > 0 && (broker->ssl_ctx = _ssl_ctx_new(broker)) == NULL) {
+        ERR_print_errors_fp(stderr);
+        goto error;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(pParams->port);
+
+    broker->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (broker->listen_fd < 0 || setsockopt(broker->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) ||
+        bind(broker->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(broker->listen_fd, 4096) ||
+        _set_nonblock(broker->listen_fd)) {
+        perror("test broker listen");
+        goto error;
+    }
+
+    if ((broker->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0 ||
+        (broker->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+        goto error;
+    }
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    epoll_ctl(broker->epoll_fd, EPOLL_CTL_ADD, broker->listen_fd, &ev);
+    ev.data.ptr = broker;
+    epoll_ctl(broker->epoll_fd, EPOLL_CTL_ADD, broker->wake_fd, &ev);
+
+    if (pthread_create(&broker->thread, NULL, _broker_thread, broker)) {
+        goto error;
+    }
+
+    return broker;
+
+error:
+    if (broker->listen_fd >= 0) {
+        close(broker->listen_fd);
+    }
+    if (broker->epoll_fd >= 0) {
+        close(broker->epoll_fd);
+    }
+    if (broker->wake_fd >= 0) {
+        close(broker->wake_fd);
+    }
+    if (broker->ssl_ctx != NULL) {
+        SSL_CTX_free(broker->ssl_ctx);
+    }
+    pthread_mutex_destroy(&broker->lock);
+    free(broker);
+    return NULL;
+}
+
+void test_broker_stop(TestBroker *broker)
+{
+    if (broker == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&broker->lock);
+    broker->stop = true;
+    _wake(broker);
+    pthread_mutex_unlock(&broker->lock);
+    pthread_join(broker->thread, NULL);
+
+    while (broker->conns != NULL) {
+        _conn_free(broker, broker->conns);
+    }
+    close(broker->listen_fd);
+    close(broker->epoll_fd);
+    close(broker->wake_fd);
+    if (broker->ssl_ctx != NULL) {
+        SSL_CTX_free(broker->ssl_ctx);
+    }
+    pthread_mutex_destroy(&broker->lock);
+    free(broker);
+}
+
+int test_broker_publish(TestBroker *broker, const char *topic, const void *payload, size_t len, int qos)
+{
+    pthread_mutex_lock(&broker->lock);
+    _route(broker, topic, payload, len, qos > 1 ? 1 : qos);
+    _wake(broker);
+    pthread_mutex_unlock(&broker->lock);
+
+    return 0;
+}
+
+void test_broker_drop_clients(TestBroker *broker)
+{
+    BrokerConn *conn;
+
+    pthread_mutex_lock(&broker->lock);
+    for (conn = broker->conns; conn != NULL; conn = conn->next) {
+        _conn_kill(conn);
+    }
+    _wake(broker);
+    pthread_mutex_unlock(&broker->lock);
+}
+
+void test_broker_set_refuse(TestBroker *broker, bool refuse)
+{
+    pthread_mutex_lock(&broker->lock);
+    broker->refuse = refuse;
+    pthread_mutex_unlock(&broker->lock);
+}
+
+void test_broker_get_stats(TestBroker *broker, TestBrokerStats *pStats)
+{
+    pthread_mutex_lock(&broker->lock);
+    *pStats = broker->stats;
+    pthread_mutex_unlock(&broker->lock);
+}
@@ -0,0 +1,83 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef QCLOUD_IOT_TEST_BROKER_H_
+#define QCLOUD_IOT_TEST_BROKER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * MQTT 3.1.1 broker on localhost for host tests and benchmarks, served by one thread.
+ * CONNECT is accepted whatever the credentials, publishes are routed to the subscribers with
+ * QoS up to 1 and not retransmitted. Sessions are not kept across connections.
+ * With a PSK given, connections are TLS 1.2 with the PSK suites used by the devices.
+ */
+
+typedef struct TestBroker TestBroker;
+
+/**
+ * @brief Called in broker thread for every PUBLISH received, before it is routed.
+ *        test_broker_publish can be called from it
+ */
+typedef void (*TestBrokerPublishHook)(TestBroker *broker, const char *topic, const char *payload, size_t len,
+                                      void *context);
+
+typedef struct {
+    uint16_t                port;           // port on 127.0.0.1
+    TestBrokerPublishHook   on_publish;     // hook of publishes received, could be NULL
+    void                    *context;       // context of hook
+    const unsigned char     *psk;           // TLS PSK, the decoded device secret, NULL for plain TCP
+    size_t                  psk_len;        // length of psk
+} TestBrokerParams;
+
+typedef struct {
+    uint32_t    connects;       // CONNECT accepted
+    uint32_t    clients;        // connections open
+    uint64_t    publish_in;     // PUBLISH received
+    uint64_t    publish_out;    // PUBLISH sent to subscribers
+} TestBrokerStats;
+
+TestBroker *test_broker_start(const TestBrokerParams *pParams);
+
+void test_broker_stop(TestBroker *broker);
+
+/**
+ * @brief Publish to the subscribers of topic, as if a client published it
+ */
+int test_broker_publish(TestBroker *broker, const char *topic, const void *payload, size_t len, int qos);
+
+/**
+ * @brief Cut all the connections at once, like a link going down
+ */
+void test_broker_drop_clients(TestBroker *broker);
+
+/**
+ * @brief Close connections right after accept while refusing, like a broker being unreachable
+ */
+void test_broker_set_refuse(TestBroker *broker, bool refuse);
+
+void test_broker_get_stats(TestBroker *broker, TestBrokerStats *pStats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // QCLOUD_IOT_TEST_BROKER_H_
@@ -0,0 +1,177 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "qcloud_iot_export.h"
+#include "qcloud_iot_import.h"
+#include "test_broker.h"
+#include "test_util.h"
+
+/*
+ * Publishes pushed by several tasks through IOT_MQTT_PublishDeferred while another one yields:
+ * each reaches the broker once, in the order of its task, and completes with success.
+ * A publish which could never be sent is failed through on_complete with MQTT_EVENT_PUBLISH_FAIL.
+ */
+
+#define TEST_PRODUCT_ID     "TESTPRD001"
+#define TEST_DEVICE_NAME    "dev_deferred"
+#define TEST_DEVICE_SECRET  "dGVzdC1kZXZpY2Utc2VjcmV0"
+#define TEST_TOPIC          TEST_PRODUCT_ID "/" TEST_DEVICE_NAME "/data"
+
+#define PRODUCERS           4
+#define PUSH_PER_PRODUCER   200
+#define PAYLOAD_LEN         24
+/* larger than all the room for copies of publishes waiting for PUBACK */
+#define HUGE_PAYLOAD_LEN    (QCLOUD_IOT_MQTT_INFLIGHT_BUF_LEN + 1)
+
+static pthread_mutex_t  sg_lock = PTHREAD_MUTEX_INITIALIZER;
+static int              sg_next[PRODUCERS];
+static int              sg_out_of_order;
+static int              sg_arrived;
+
+/* kept until on_complete, as deferred publishes are not copied */
+static char             sg_payloads[PRODUCERS][PUSH_PER_PRODUCER][PAYLOAD_LEN];
+static char             sg_huge_payload[HUGE_PAYLOAD_LEN];
+static void             *sg_client;
+
+/* on_complete runs in the yielding thread only */
+static int              sg_completed;
+static int              sg_succeeded;
+static MQTTEventType    sg_huge_result;
+static int              sg_huge_packet_id = -1;
+
+static void _on_publish(TestBroker *broker, const char *topic, const char *payload, size_t len, void *context)
+{
+    int producer, seq;
+
+    if (strcmp(topic, TEST_TOPIC) != 0 || sscanf(payload, "p=%d;s=%d", &producer, &seq) != 2 || producer < 0 ||
+        producer >= PRODUCERS) {
+        return;
+    }
+
+    pthread_mutex_lock(&sg_lock);
+    if (seq != sg_next[producer]) {
+        sg_out_of_order++;
+    }
+    sg_next[producer] = seq + 1;
+    sg_arrived++;
+    pthread_mutex_unlock(&sg_lock);
+}
+
+static void _on_complete(void *pClient, uint16_t packet_id, MQTTEventType result, void *pUserData)
+{
+    sg_completed++;
+    if (result == MQTT_EVENT_PUBLISH_SUCCESS) {
+        sg_succeeded++;
+    }
+}
+
+static void _on_huge_complete(void *pClient, uint16_t packet_id, MQTTEventType result, void *pUserData)
+{
+    sg_huge_result = result;
+    sg_huge_packet_id = packet_id;
+}
+
+static void *_producer(void *arg)
+{
+    int producer = (int)(intptr_t)arg;
+    PublishParams params = DEFAULT_PUB_PARAMS;
+    int seq, rc;
+
+    params.qos = QOS1;
+    for (seq = 0; seq < PUSH_PER_PRODUCER; seq++) {
+        snprintf(sg_payloads[producer][seq], PAYLOAD_LEN, "p=%d;s=%d;", producer, seq);
+        params.payload = sg_payloads[producer][seq];
+        params.payload_len = strlen(sg_payloads[producer][seq]);
+        while ((rc = IOT_MQTT_PublishDeferred(sg_client, TEST_TOPIC, &params, _on_complete, NULL)) ==
+               QCLOUD_ERR_MQTT_DEFERRED_FULL) {
+            usleep(100);
+        }
+        if (rc != QCLOUD_RET_SUCCESS) {
+            printf("deferred publish failed: %d\n", rc);
+            exit(1);
+        }
+    }
+    return NULL;
+}
+
+static int test_deferred_publish(void)
+{
+    MQTTInitParams init_params = DEFAULT_MQTTINIT_PARAMS;
+    TestBrokerParams broker_params = {MQTT_SERVER_PORT_NOTLS, _on_publish, NULL, NULL, 0};
+    PublishParams params = DEFAULT_PUB_PARAMS;
+    pthread_t threads[PRODUCERS];
+    TestBroker *broker;
+    uint64_t deadline;
+    int i;
+
+    broker = test_broker_start(&broker_params);
+    TEST_ASSERT(broker != NULL);
+
+    init_params.product_id = TEST_PRODUCT_ID;
+    init_params.device_name = TEST_DEVICE_NAME;
+    init_params.device_secret = TEST_DEVICE_SECRET;
+    init_params.command_timeout = 2000;
+    sg_client = IOT_MQTT_Construct(&init_params);
+    TEST_ASSERT(sg_client != NULL);
+
+    for (i = 0; i < PRODUCERS; i++) {
+        TEST_ASSERT_EQ(0, pthread_create(&threads[i], NULL, _producer, (void *)(intptr_t)i));
+    }
+    deadline = test_now_ns() + 20000000000ull;
+    while (sg_completed < PRODUCERS * PUSH_PER_PRODUCER && test_now_ns() < deadline) {
+        IOT_MQTT_Yield(sg_client, 10);
+    }
+    for (i = 0; i < PRODUCERS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    TEST_ASSERT_EQ(PRODUCERS * PUSH_PER_PRODUCER, sg_completed);
+    TEST_ASSERT_EQ(PRODUCERS * PUSH_PER_PRODUCER, sg_succeeded);
+    pthread_mutex_lock(&sg_lock);
+    TEST_ASSERT_EQ(PRODUCERS * PUSH_PER_PRODUCER, sg_arrived);
+    TEST_ASSERT_EQ(0, sg_out_of_order);
+    pthread_mutex_unlock(&sg_lock);
+
+    /* retrying would never help, it fails at once with its own event */
+    memset(sg_huge_payload, 'x', sizeof(sg_huge_payload));
+    params.qos = QOS1;
+    params.payload = sg_huge_payload;
+    params.payload_len = sizeof(sg_huge_payload);
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, IOT_MQTT_PublishDeferred(sg_client, TEST_TOPIC, &params, _on_huge_complete, NULL));
+    for (i = 0; i < 100 && sg_huge_packet_id < 0; i++) {
+        IOT_MQTT_Yield(sg_client, 10);
+    }
+    TEST_ASSERT_EQ(MQTT_EVENT_PUBLISH_FAIL, sg_huge_result);
+    TEST_ASSERT_EQ(0, sg_huge_packet_id);
+
+    IOT_MQTT_Destroy(&sg_client);
+    test_broker_stop(broker);
+    return 0;
+}
+
+int main(void)
+{
+    IOT_Log_Set_Level(eLOG_WARN);
+    alarm(60);
+
+    TEST_RUN(test_deferred_publish);
+    return 0;
+}
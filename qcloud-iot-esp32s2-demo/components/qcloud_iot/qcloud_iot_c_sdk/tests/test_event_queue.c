@@ -0,0 +1,137 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "qcloud_iot_export.h"
+#include "qcloud_iot_import.h"
+#include "qcloud_iot_common.h"
+#include "test_broker.h"
+#include "test_util.h"
+
+/*
+ * Event queue against the local broker, which replies to events_post like the cloud does.
+ * The reply callback queues the next event, so it must not be called with the template mutex held.
+ */
+
+#define TEST_PRODUCT_ID     "TESTPRD001"
+#define TEST_DEVICE_NAME    "dev_event"
+#define TEST_DEVICE_SECRET  "dGVzdC1kZXZpY2Utc2VjcmV0"
+
+static void       *sg_template;
+static int         sg_replies;
+static int         sg_batches;
+
+static void _cloud_reply(TestBroker *broker, const char *topic, const char *payload, size_t len, void *context)
+{
+    const char *token, *end;
+    char reply[256];
+    int n;
+
+    if (strncmp(topic, "$thing/up/event/", strlen("$thing/up/event/")) != 0) {
+        return;
+    }
+    sg_batches++;
+
+    token = memmem(payload, len, "\"clientToken\":\"", strlen("\"clientToken\":\""));
+    if (token == NULL) {
+        return;
+    }
+    token += strlen("\"clientToken\":\"");
+    end = memchr(token, '"', payload + len - token);
+    if (end == NULL) {
+        return;
+    }
+
+    n = snprintf(reply, sizeof(reply), "{\"method\":\"events_reply\",\"clientToken\":\"%.*s\",\"code\":0,\"status\":\"\"}",
+                 (int)(end - token), token);
+    test_broker_publish(broker, "$thing/down/event/" TEST_PRODUCT_ID "/" TEST_DEVICE_NAME, reply, n, 0);
+}
+
+static int _push_event(int value)
+{
+    static int32_t data;
+    static DeviceProperty property = {"level", &data, 0, JINT32};
+    sEvent event = {"status_report", "info", 0, 1, &property};
+
+    data = value;
+    return IOT_Event_Queue_Push(sg_template, &event);
+}
+
+static void _on_batch_reply(void *client, MQTTMessage *msg)
+{
+    /* template APIs are called from the callback */
+    if (++sg_replies == 1) {
+        _push_event(100);
+        IOT_Event_Queue_Flush(client);
+    }
+}
+
+static int test_reply_callback_reenters(void)
+{
+    TemplateInitParams init_params = DEFAULT_TEMPLATE_INIT_PARAMS;
+    EventQueueParams queue_params = DEFAULT_EVENT_QUEUE_PARAMS;
+    uint64_t deadline;
+    int i;
+
+    init_params.product_id = TEST_PRODUCT_ID;
+    init_params.device_name = TEST_DEVICE_NAME;
+    init_params.device_secret = TEST_DEVICE_SECRET;
+    sg_template = IOT_Template_Construct(&init_params, NULL);
+    TEST_ASSERT(sg_template != NULL);
+
+    queue_params.reply_cb = _on_batch_reply;
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, IOT_Event_Queue_Init(sg_template, &queue_params));
+
+    for (i = 0; i < 3; i++) {
+        TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, _push_event(i));
+    }
+    IOT_Event_Queue_Flush(sg_template);
+
+    deadline = test_now_ns() + 5000000000ull;
+    while (sg_replies < 2 && test_now_ns() < deadline) {
+        IOT_Template_Yield(sg_template, 100);
+    }
+
+    TEST_ASSERT_EQ(2, sg_replies);
+    TEST_ASSERT_EQ(2, sg_batches);
+
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, IOT_Template_Destroy(sg_template));
+    return 0;
+}
+
+int main(void)
+{
+    TestBrokerParams params = {MQTT_SERVER_PORT_NOTLS, _cloud_reply, NULL, NULL, 0};
+    TestBroker *broker;
+
+    IOT_Log_Set_Level(eLOG_WARN);
+    /* a deadlock fails the test instead of hanging it */
+    alarm(30);
+
+    broker = test_broker_start(&params);
+    if (broker == NULL) {
+        return 1;
+    }
+
+    TEST_RUN(test_reply_callback_reenters);
+
+    test_broker_stop(broker);
+    return 0;
+}
@@ -0,0 +1,167 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "qcloud_iot_import.h"
+#include "utils_timer.h"
+#include "test_util.h"
+
+/*
+ * Timer of the Linux HAL on a fake clock: clock_gettime and gettimeofday are interposed, so the
+ * monotonic clock can be put right before the 32-bit wrap of HAL_GetTimeMs, and the wall clock can be
+ * stepped as NTP or settimeofday would. Timers must follow the monotonic clock only.
+ */
+
+static bool     sg_fake;
+static uint64_t sg_mono_ms;
+static int64_t  sg_wall_sec;
+
+int clock_gettime(clockid_t clk_id, struct timespec *tp)
+{
+    static int (*real_clock_gettime)(clockid_t, struct timespec *);
+
+    if (sg_fake) {
+        if (CLOCK_MONOTONIC == clk_id) {
+            tp->tv_sec = (time_t)(sg_mono_ms / 1000);
+            tp->tv_nsec = (long)(sg_mono_ms % 1000) * 1000000;
+        } else {
+            tp->tv_sec = (time_t)sg_wall_sec;
+            tp->tv_nsec = 0;
+        }
+        return 0;
+    }
+
+    if (NULL == real_clock_gettime) {
+        real_clock_gettime = (int (*)(clockid_t, struct timespec *))dlsym(RTLD_NEXT, "clock_gettime");
+    }
+    return real_clock_gettime(clk_id, tp);
+}
+
+int gettimeofday(struct timeval *tv, void *tz)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    tv->tv_sec = ts.tv_sec;
+    tv->tv_usec = ts.tv_nsec / 1000;
+    return 0;
+}
+
+/* timers and HAL_GetTimeMs across the 32-bit wrap of milliseconds */
+static int test_ms_wrap(void)
+{
+    Timer timer, sdk_timer;
+    uint32_t ms_before;
+
+    sg_fake = true;
+    /* 49.7 days of uptime, 1 s before the wrap */
+    sg_mono_ms = 0xFFFFFFFFull - 999;
+    sg_wall_sec = 1700000000;
+    ms_before = HAL_GetTimeMs();
+
+    HAL_Timer_countdown_ms(&timer, 3000);
+    InitTimer(&sdk_timer);
+    countdown_ms(&sdk_timer, 3000);
+    TEST_ASSERT_EQ(3000, HAL_Timer_remain(&timer));
+
+    sg_mono_ms += 2000;
+    TEST_ASSERT(HAL_GetTimeMs() < ms_before);
+    TEST_ASSERT_EQ(2000, (uint32_t)(HAL_GetTimeMs() - ms_before));
+    TEST_ASSERT(!HAL_Timer_expired(&timer));
+    TEST_ASSERT(!expired(&sdk_timer));
+    TEST_ASSERT_EQ(1000, HAL_Timer_remain(&timer));
+    TEST_ASSERT_EQ(1000, left_ms(&sdk_timer));
+
+    sg_mono_ms += 1000;
+    TEST_ASSERT(HAL_Timer_expired(&timer));
+    TEST_ASSERT(expired(&sdk_timer));
+    TEST_ASSERT_EQ(0, HAL_Timer_remain(&timer));
+    TEST_ASSERT_EQ(0, left_ms(&sdk_timer));
+
+    sg_fake = false;
+    return 0;
+}
+
+/* steps of the wall clock move neither deadlines nor remaining time */
+static int test_wall_clock_step(void)
+{
+    Timer timer;
+
+    sg_fake = true;
+    sg_mono_ms = 123456;
+    sg_wall_sec = 1700000000;
+
+    HAL_Timer_countdown(&timer, 10);
+    TEST_ASSERT_EQ(1700000000, HAL_Timer_current_sec());
+
+    /* SNTP sets the clock back one hour */
+    sg_wall_sec -= 3600;
+    TEST_ASSERT_EQ(1700000000 - 3600, HAL_Timer_current_sec());
+    TEST_ASSERT(!HAL_Timer_expired(&timer));
+    TEST_ASSERT_EQ(10000, HAL_Timer_remain(&timer));
+
+    /* and forward one day */
+    sg_wall_sec += 86400;
+    TEST_ASSERT(!HAL_Timer_expired(&timer));
+    TEST_ASSERT_EQ(10000, HAL_Timer_remain(&timer));
+
+    sg_mono_ms += 9999;
+    TEST_ASSERT(!HAL_Timer_expired(&timer));
+    TEST_ASSERT_EQ(1, HAL_Timer_remain(&timer));
+    sg_mono_ms += 1;
+    TEST_ASSERT(HAL_Timer_expired(&timer));
+
+    sg_fake = false;
+    return 0;
+}
+
+/* remaining time is clamped, not wrapped to negative */
+static int test_long_countdown(void)
+{
+    Timer timer;
+
+    sg_fake = true;
+    sg_mono_ms = 1000;
+
+    HAL_Timer_init(&timer);
+    TEST_ASSERT(HAL_Timer_expired(&timer));
+    TEST_ASSERT_EQ(0, HAL_Timer_remain(&timer));
+
+    HAL_Timer_countdown(&timer, UINT_MAX);
+    TEST_ASSERT(!HAL_Timer_expired(&timer));
+    TEST_ASSERT_EQ(INT_MAX, HAL_Timer_remain(&timer));
+    sg_mono_ms += (uint64_t)UINT_MAX * 1000 - 5;
+    TEST_ASSERT_EQ(5, HAL_Timer_remain(&timer));
+
+    sg_fake = false;
+    return 0;
+}
+
+int main(void)
+{
+    TEST_RUN(test_ms_wrap);
+    TEST_RUN(test_wall_clock_step);
+    TEST_RUN(test_long_countdown);
+    return 0;
+}
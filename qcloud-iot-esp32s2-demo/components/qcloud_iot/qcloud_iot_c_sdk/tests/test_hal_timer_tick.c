@@ -0,0 +1,149 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "qcloud_iot_import.h"
+#include "freertos/task.h"
+#include "test_util.h"
+
+/*
+ * Timer of the FreeRTOS HAL without time functions: the 32-bit tick count is extended to 64 bits,
+ * so timers keep working across its wrap. The tick count is driven by the test.
+ */
+
+static TickType_t sg_ticks;
+static int        sg_suspended;
+
+TickType_t xTaskGetTickCount(void)
+{
+    return sg_ticks;
+}
+
+void vTaskSuspendAll(void)
+{
+    sg_suspended++;
+}
+
+long xTaskResumeAll(void)
+{
+    sg_suspended--;
+    return 0;
+}
+
+static void _advance_ms(uint32_t ms)
+{
+    sg_ticks += ms / portTICK_PERIOD_MS;
+}
+
+/* timers across the wrap of the tick count */
+static int test_tick_wrap(void)
+{
+    Timer timer;
+    uint64_t before, after;
+    uint32_t ms_before;
+
+    /* 1 s before the tick count wraps */
+    sg_ticks = (TickType_t)(0 - 1000 / portTICK_PERIOD_MS);
+    before = HAL_GetTimeMs64();
+    ms_before = HAL_GetTimeMs();
+    TEST_ASSERT_EQ(0, sg_suspended);
+
+    HAL_Timer_countdown_ms(&timer, 5000);
+    TEST_ASSERT(!HAL_Timer_expired(&timer));
+    TEST_ASSERT_EQ(5000, HAL_Timer_remain(&timer));
+
+    /* 2 s later, past the wrap */
+    _advance_ms(2000);
+    TEST_ASSERT(sg_ticks < 1000);
+    after = HAL_GetTimeMs64();
+    TEST_ASSERT_EQ(2000, after - before);
+    /* the low 32 bits still give the elapsed time by unsigned difference */
+    TEST_ASSERT_EQ(2000, (uint32_t)(HAL_GetTimeMs() - ms_before));
+    TEST_ASSERT(!HAL_Timer_expired(&timer));
+    TEST_ASSERT_EQ(3000, HAL_Timer_remain(&timer));
+
+    _advance_ms(2990);
+    TEST_ASSERT(!HAL_Timer_expired(&timer));
+    TEST_ASSERT_EQ(10, HAL_Timer_remain(&timer));
+    _advance_ms(10);
+    TEST_ASSERT(HAL_Timer_expired(&timer));
+    TEST_ASSERT_EQ(0, HAL_Timer_remain(&timer));
+    _advance_ms(60000);
+    TEST_ASSERT(HAL_Timer_expired(&timer));
+    TEST_ASSERT_EQ(0, HAL_Timer_remain(&timer));
+
+    TEST_ASSERT_EQ(0, sg_suspended);
+    return 0;
+}
+
+/* clock read at least once in each wrap period keeps counting up */
+static int test_many_wraps(void)
+{
+    uint64_t start, last, now;
+    int i;
+
+    sg_ticks = 12345;
+    start = last = HAL_GetTimeMs64();
+    for (i = 0; i < 3 * 4; i++) {
+        /* a quarter of the wrap period at a time */
+        sg_ticks += 0x40000000u;
+        now = HAL_GetTimeMs64();
+        TEST_ASSERT(now > last);
+        TEST_ASSERT_EQ((uint64_t)0x40000000u * portTICK_PERIOD_MS, now - last);
+        last = now;
+    }
+    TEST_ASSERT_EQ((uint64_t)3 << 32, (last - start) / portTICK_PERIOD_MS);
+
+    return 0;
+}
+
+/* a countdown in seconds far beyond INT_MAX ms */
+static int test_long_countdown(void)
+{
+    Timer timer;
+
+    HAL_Timer_init(&timer);
+    TEST_ASSERT(HAL_Timer_expired(&timer));
+
+    HAL_Timer_countdown(&timer, UINT_MAX);
+    TEST_ASSERT(!HAL_Timer_expired(&timer));
+    TEST_ASSERT_EQ(INT_MAX, HAL_Timer_remain(&timer));
+
+    /* two tick wraps later, the deadline is still far */
+    sg_ticks += 0x80000000u;
+    HAL_GetTimeMs64();
+    sg_ticks += 0x80000000u;
+    HAL_GetTimeMs64();
+    sg_ticks += 0x80000000u;
+    HAL_GetTimeMs64();
+    sg_ticks += 0x80000000u;
+    TEST_ASSERT(!HAL_Timer_expired(&timer));
+
+    /* without time functions, seconds come from the same clock */
+    TEST_ASSERT_EQ((long)(HAL_GetTimeMs64() / 1000), HAL_Timer_current_sec());
+    return 0;
+}
+
+int main(void)
+{
+    TEST_RUN(test_tick_wrap);
+    TEST_RUN(test_many_wraps);
+    TEST_RUN(test_long_countdown);
+    return 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "qcloud_iot_export_error.h"
+#include "qcloud_iot_export_log.h"
+#include "lite-utils.h"
+#include "json_parser.h"
+#include "test_util.h"
+
+static json_span_t _number(const char *str)
+{
+    json_span_t span = {str, (int)strlen(str), JSNUMBER};
+    return span;
+}
+
+static int test_lookup(void)
+{
+    const char *json = " {\"type\":\"online\",\"payload\":{\"devices\":[{\"result\":-12}]},\"n\":null,"
+                       "\"arr\":[{\"a\":\"}\"}],\"x\":{\"y\":{\"z\":true}}}";
+    json_span_t span;
+
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, LITE_json_span_of("type", json, &span));
+    TEST_ASSERT(LITE_span_equal(&span, "online"));
+    TEST_ASSERT_EQ(JSSTRING, span.type);
+
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, LITE_json_span_of("x.y.z", json, &span));
+    TEST_ASSERT(LITE_span_equal(&span, "true"));
+
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, LITE_json_span_of("n", json, &span));
+    TEST_ASSERT_EQ(JSNULL, span.type);
+
+    TEST_ASSERT(LITE_json_span_of("nope", json, &span) != QCLOUD_RET_SUCCESS);
+    TEST_ASSERT(LITE_json_span_of("a", "{\"a\":", &span) != QCLOUD_RET_SUCCESS);
+    return 0;
+}
+
+static int test_integers(void)
+{
+    json_span_t span;
+    int32_t i32;
+    uint32_t u32;
+    int8_t i8;
+    uint8_t u8;
+
+    span = _number("-12");
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, LITE_span_get_int32(&i32, &span));
+    TEST_ASSERT_EQ(-12, i32);
+
+    span = _number("4294967295");
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, LITE_span_get_uint32(&u32, &span));
+    TEST_ASSERT_EQ(4294967295u, u32);
+    span = _number("4294967296");
+    TEST_ASSERT(LITE_span_get_uint32(&u32, &span) != QCLOUD_RET_SUCCESS);
+
+    /* float forms of integral value are taken, as they were before spans */
+    span = _number("1.0");
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, LITE_span_get_int32(&i32, &span));
+    TEST_ASSERT_EQ(1, i32);
+    span = _number("1e2");
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, LITE_span_get_uint32(&u32, &span));
+    TEST_ASSERT_EQ(100, u32);
+    span = _number("-2.5e1");
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, LITE_span_get_int32(&i32, &span));
+    TEST_ASSERT_EQ(-25, i32);
+    span = _number("2.55e1");
+    TEST_ASSERT(LITE_span_get_int32(&i32, &span) != QCLOUD_RET_SUCCESS);
+
+    /* fractions and out of range values are rejected, not truncated */
+    span = _number("1.5");
+    TEST_ASSERT(LITE_span_get_int32(&i32, &span) != QCLOUD_RET_SUCCESS);
+    span = _number("128");
+    TEST_ASSERT(LITE_span_get_int8(&i8, &span) != QCLOUD_RET_SUCCESS);
+    span = _number("2.56e2");
+    TEST_ASSERT(LITE_span_get_uint8(&u8, &span) != QCLOUD_RET_SUCCESS);
+    span = _number("-1.0");
+    TEST_ASSERT(LITE_span_get_uint32(&u32, &span) != QCLOUD_RET_SUCCESS);
+    span = _number("12abc");
+    TEST_ASSERT(LITE_span_get_int32(&i32, &span) != QCLOUD_RET_SUCCESS);
+    span.type = JSNULL;
+    TEST_ASSERT(LITE_span_get_int32(&i32, &span) != QCLOUD_RET_SUCCESS);
+    return 0;
+}
+
+static int test_string(void)
+{
+    json_span_t span = {"online\"", 6, JSSTRING};
+    char small[6];
+    char fit[7];
+
+    /* no truncation, value and '\0' must fit */
+    TEST_ASSERT_EQ(QCLOUD_ERR_JSON_BUFFER_TOO_SMALL, LITE_span_get_string(small, sizeof(small), &span));
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, LITE_span_get_string(fit, sizeof(fit), &span));
+    TEST_ASSERT(!strcmp(fit, "online"));
+
+    TEST_ASSERT(LITE_span_equal(&span, "online"));
+    TEST_ASSERT(!LITE_span_equal(&span, "onlin"));
+    span.len = -1;
+    TEST_ASSERT(!LITE_span_equal(&span, "online"));
+    return 0;
+}
+
+int main(void)
+{
+    IOT_Log_Set_Level(eLOG_WARN);
+
+    TEST_RUN(test_lookup);
+    TEST_RUN(test_integers);
+    TEST_RUN(test_string);
+    return 0;
+}
@@ -0,0 +1,167 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "qcloud_iot_import.h"
+#include "utils_ringbuff_mpsc.h"
+#include "test_util.h"
+
+/*
+ * Producers push sequenced elements into a small ring as fast as they can while one consumer
+ * pops them: every element arrives once, in the order of its producer, and is not torn.
+ * Rate and the number of pushes found the ring full go to stdout for the contention figures.
+ */
+
+#define PUSH_PER_PRODUCER   200000
+#define MAX_PRODUCERS       8
+
+typedef struct {
+    uint32_t    id;
+    uint32_t    seq;
+    uint64_t    check;          /* derived from id and seq, a torn copy does not match */
+} TestElem;
+
+static sMpscRing            sg_ring;
+static _Atomic uint64_t     sg_full_retries;
+
+static uint64_t _check_of(uint32_t id, uint32_t seq)
+{
+    return (uint64_t)id * 1000003u + seq;
+}
+
+static void *_producer(void *arg)
+{
+    TestElem elem = {(uint32_t)(intptr_t)arg, 0, 0};
+    uint64_t retries = 0;
+    uint32_t i;
+
+    for (i = 0; i < PUSH_PER_PRODUCER; i++) {
+        elem.seq = i;
+        elem.check = _check_of(elem.id, i);
+        while (RINGBUFF_OK != mpsc_ring_push(&sg_ring, &elem)) {
+            retries++;
+            sched_yield();
+        }
+    }
+    atomic_fetch_add(&sg_full_retries, retries);
+    return NULL;
+}
+
+static int _stress(int producers, uint32_t slots)
+{
+    uint32_t next[MAX_PRODUCERS] = {0};
+    pthread_t threads[MAX_PRODUCERS];
+    uint64_t total = (uint64_t)producers * PUSH_PER_PRODUCER, got = 0;
+    uint64_t start_ns, elapsed_ns;
+    TestElem elem;
+    int i;
+
+    TEST_ASSERT_EQ(RINGBUFF_OK, mpsc_ring_init(&sg_ring, slots, sizeof(TestElem)));
+    atomic_store(&sg_full_retries, 0);
+
+    start_ns = test_now_ns();
+    for (i = 0; i < producers; i++) {
+        TEST_ASSERT_EQ(0, pthread_create(&threads[i], NULL, _producer, (void *)(intptr_t)i));
+    }
+    while (got < total) {
+        if (RINGBUFF_OK != mpsc_ring_peek(&sg_ring, &elem)) {
+            sched_yield();
+            continue;
+        }
+        mpsc_ring_pop(&sg_ring);
+        TEST_ASSERT(elem.id < (uint32_t)producers);
+        TEST_ASSERT_EQ(next[elem.id], elem.seq);
+        TEST_ASSERT_EQ(_check_of(elem.id, elem.seq), elem.check);
+        next[elem.id]++;
+        got++;
+    }
+    for (i = 0; i < producers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    elapsed_ns = test_now_ns() - start_ns;
+
+    TEST_ASSERT_EQ(RINGBUFF_EMPTY, mpsc_ring_peek(&sg_ring, &elem));
+    mpsc_ring_deinit(&sg_ring);
+
+    printf("{\"producers\":%d,\"slots\":%u,\"elements\":%llu,\"ns_per_element\":%.1f,\"full_retries\":%llu}\n",
+           producers, slots, (unsigned long long)got, (double)elapsed_ns / got,
+           (unsigned long long)atomic_load(&sg_full_retries));
+    return 0;
+}
+
+static int test_init_and_bounds(void)
+{
+    sMpscRing ring;
+    TestElem elem = {0, 0, 0};
+    uint32_t i;
+
+    memset(&ring, 0, sizeof(ring));
+    TEST_ASSERT_EQ(RINGBUFF_ERR, mpsc_ring_init(&ring, 12, sizeof(TestElem)));
+    TEST_ASSERT_EQ(RINGBUFF_ERR, mpsc_ring_init(&ring, 0, sizeof(TestElem)));
+
+    TEST_ASSERT_EQ(RINGBUFF_OK, mpsc_ring_init(&ring, 4, sizeof(TestElem)));
+    TEST_ASSERT_EQ(RINGBUFF_EMPTY, mpsc_ring_peek(&ring, &elem));
+
+    /* full ring is reported, not waited on, and wraps around after the consumer moved */
+    for (i = 0; i < 4; i++) {
+        elem.seq = i;
+        TEST_ASSERT_EQ(RINGBUFF_OK, mpsc_ring_push(&ring, &elem));
+    }
+    TEST_ASSERT_EQ(RINGBUFF_FULL, mpsc_ring_push(&ring, &elem));
+    for (i = 0; i < 10; i++) {
+        TEST_ASSERT_EQ(RINGBUFF_OK, mpsc_ring_peek(&ring, &elem));
+        TEST_ASSERT_EQ(i, elem.seq);
+        /* peek does not consume */
+        TEST_ASSERT_EQ(RINGBUFF_OK, mpsc_ring_peek(&ring, &elem));
+        TEST_ASSERT_EQ(i, elem.seq);
+        mpsc_ring_pop(&ring);
+        elem.seq = i + 4;
+        TEST_ASSERT_EQ(RINGBUFF_OK, mpsc_ring_push(&ring, &elem));
+    }
+
+    mpsc_ring_deinit(&ring);
+    return 0;
+}
+
+static int test_single_producer(void)
+{
+    return _stress(1, 16);
+}
+
+static int test_many_producers(void)
+{
+    TEST_ASSERT_EQ(0, _stress(4, 16));
+    return _stress(MAX_PRODUCERS, 16);
+}
+
+static int test_many_producers_large_ring(void)
+{
+    return _stress(MAX_PRODUCERS, 1024);
+}
+
+int main(void)
+{
+    TEST_RUN(test_init_and_bounds);
+    TEST_RUN(test_single_producer);
+    TEST_RUN(test_many_producers);
+    TEST_RUN(test_many_producers_large_ring);
+    return 0;
+}
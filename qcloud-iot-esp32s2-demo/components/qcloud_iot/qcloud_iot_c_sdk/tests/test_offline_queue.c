@@ -0,0 +1,241 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <dirent.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "qcloud_iot_export.h"
+#include "qcloud_iot_import.h"
+#include "mqtt_client.h"
+#include "test_broker.h"
+#include "test_util.h"
+
+/*
+ * Zero loss of QoS1 publishes across link loss: publishes made while the broker is unreachable are
+ * stored, and the link is cut again by the broker in the middle of replay. Every publish must reach
+ * the broker, first arrivals in the order they were made. Publishes with a completion callback are
+ * refused until replay is done instead of overtaking the stored ones.
+ */
+
+#define TEST_PRODUCT_ID     "TESTPRD001"
+#define TEST_DEVICE_NAME    "dev_offline"
+#define TEST_DEVICE_SECRET  "dGVzdC1kZXZpY2Utc2VjcmV0"
+#define TEST_TOPIC          TEST_PRODUCT_ID "/" TEST_DEVICE_NAME "/data"
+
+#define ONLINE_COUNT        20
+#define OFFLINE_COUNT       200
+#define LATE_COUNT          20
+#define TOTAL_COUNT         (ONLINE_COUNT + OFFLINE_COUNT + LATE_COUNT)
+/* longer than QCLOUD_IOT_MQTT_TX_BUF_LEN, the client has a larger Tx buffer */
+#define BIG_SEQ             (ONLINE_COUNT + OFFLINE_COUNT / 3)
+#define BIG_PAYLOAD_LEN     (QCLOUD_IOT_MQTT_TX_BUF_LEN + 1000)
+
+static pthread_mutex_t  sg_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t          sg_seen[TOTAL_COUNT];
+static int              sg_distinct;
+static int              sg_duplicates;
+static int              sg_out_of_order;
+static int              sg_last_first;
+static bool             sg_killed_in_replay;
+static int              sg_async_acked;
+
+static void _on_publish(TestBroker *broker, const char *topic, const char *payload, size_t len, void *context)
+{
+    int seq;
+
+    if (strcmp(topic, TEST_TOPIC) != 0 || sscanf(payload, "seq=%d", &seq) != 1 || seq < 0 || seq >= TOTAL_COUNT) {
+        return;
+    }
+    if (seq == BIG_SEQ && len != BIG_PAYLOAD_LEN) {
+        return;
+    }
+
+    pthread_mutex_lock(&sg_lock);
+    if (sg_seen[seq]) {
+        sg_duplicates++;
+    } else {
+        sg_seen[seq] = 1;
+        if (sg_distinct > 0 && seq < sg_last_first) {
+            sg_out_of_order++;
+        }
+        sg_last_first = seq;
+        sg_distinct++;
+
+        /* the link goes down again with replayed publishes waiting for PUBACK */
+        if (!sg_killed_in_replay && sg_distinct == ONLINE_COUNT + OFFLINE_COUNT / 2) {
+            sg_killed_in_replay = true;
+            test_broker_drop_clients(broker);
+        }
+    }
+    pthread_mutex_unlock(&sg_lock);
+}
+
+static int _distinct(void)
+{
+    int n;
+
+    pthread_mutex_lock(&sg_lock);
+    n = sg_distinct;
+    pthread_mutex_unlock(&sg_lock);
+    return n;
+}
+
+static void _clear_queue_dir(void)
+{
+    char path[300];
+    struct dirent *entry;
+    DIR *dir;
+
+    mkdir(MQTT_OFFLINE_QUEUE_DIR, 0755);
+    if ((dir = opendir(MQTT_OFFLINE_QUEUE_DIR)) == NULL) {
+        return;
+    }
+    while ((entry = readdir(dir)) != NULL) {
+        if (!strncmp(entry->d_name, "mq", 2)) {
+            snprintf(path, sizeof(path), "%s/%s", MQTT_OFFLINE_QUEUE_DIR, entry->d_name);
+            unlink(path);
+        }
+    }
+    closedir(dir);
+}
+
+static void _on_complete(void *pClient, uint16_t packet_id, MQTTEventType result, void *pUserData)
+{
+    if (result == MQTT_EVENT_PUBLISH_SUCCESS) {
+        sg_async_acked++;
+    }
+}
+
+static int _publish(void *client, int seq, bool async)
+{
+    static char payload[BIG_PAYLOAD_LEN + 1];
+    PublishParams params = DEFAULT_PUB_PARAMS;
+    int len = snprintf(payload, sizeof(payload), "seq=%d;", seq);
+
+    /* padded so records span more than one segment */
+    len = (seq == BIG_SEQ) ? BIG_PAYLOAD_LEN : 160;
+    memset(payload + strlen(payload), 'x', len - strlen(payload));
+    payload[len] = '\0';
+
+    params.qos = QOS1;
+    params.payload = payload;
+    params.payload_len = len;
+    return async ? IOT_MQTT_PublishAsync(client, TEST_TOPIC, &params, _on_complete, NULL)
+                 : IOT_MQTT_Publish(client, TEST_TOPIC, &params);
+}
+
+static int test_link_kill_zero_loss(void)
+{
+    MQTTInitParams init_params = DEFAULT_MQTTINIT_PARAMS;
+    TestBroker *broker;
+    TestBrokerParams broker_params = {MQTT_SERVER_PORT_NOTLS, _on_publish, NULL, NULL, 0};
+    void *client;
+    uint64_t deadline;
+    int seq = 0, async_sent = 0, async_refused = 0, rc;
+
+    _clear_queue_dir();
+    broker = test_broker_start(&broker_params);
+    TEST_ASSERT(broker != NULL);
+
+    init_params.product_id = TEST_PRODUCT_ID;
+    init_params.device_name = TEST_DEVICE_NAME;
+    init_params.device_secret = TEST_DEVICE_SECRET;
+    init_params.command_timeout = 1000;
+    init_params.tx_buf_size = 2 * QCLOUD_IOT_MQTT_TX_BUF_LEN;
+    client = IOT_MQTT_Construct(&init_params);
+    TEST_ASSERT(client != NULL);
+
+    /* online, each one acknowledged */
+    for (; seq < ONLINE_COUNT; seq++) {
+        TEST_ASSERT(_publish(client, seq, false) > 0);
+        IOT_MQTT_Yield(client, 10);
+    }
+    deadline = test_now_ns() + 5000000000ull;
+    while (_distinct() < ONLINE_COUNT && test_now_ns() < deadline) {
+        IOT_MQTT_Yield(client, 50);
+    }
+    TEST_ASSERT_EQ(ONLINE_COUNT, _distinct());
+
+    /* link down and broker unreachable, publishes are stored */
+    test_broker_set_refuse(broker, true);
+    test_broker_drop_clients(broker);
+    deadline = test_now_ns() + 5000000000ull;
+    while (IOT_MQTT_IsConnected(client) && test_now_ns() < deadline) {
+        IOT_MQTT_Yield(client, 50);
+    }
+    TEST_ASSERT(!IOT_MQTT_IsConnected(client));
+
+    for (; seq < ONLINE_COUNT + OFFLINE_COUNT; seq++) {
+        TEST_ASSERT_EQ(0, _publish(client, seq, false));
+    }
+    TEST_ASSERT(qcloud_iot_mqtt_offline_pending((Qcloud_IoT_Client *)client));
+    TEST_ASSERT_EQ(ONLINE_COUNT, _distinct());
+
+    /* broker is back, stored ones are replayed, later ones go behind them, every other one with callback */
+    test_broker_set_refuse(broker, false);
+    deadline = test_now_ns() + 60000000000ull;
+    while ((_distinct() < TOTAL_COUNT || qcloud_iot_mqtt_offline_pending((Qcloud_IoT_Client *)client)) &&
+           test_now_ns() < deadline) {
+        if (seq < TOTAL_COUNT) {
+            if (seq % 2) {
+                rc = _publish(client, seq, true);
+                if (rc == QCLOUD_ERR_MQTT_OFFLINE_PENDING) {
+                    TEST_ASSERT(qcloud_iot_mqtt_offline_pending((Qcloud_IoT_Client *)client));
+                    async_refused++;
+                } else if (rc > 0) {
+                    async_sent++;
+                    seq++;
+                } else {
+                    /* link cut in replay */
+                    TEST_ASSERT(rc == QCLOUD_ERR_MQTT_NO_CONN || rc == QCLOUD_ERR_MQTT_INFLIGHT_FULL);
+                }
+            } else {
+                TEST_ASSERT(_publish(client, seq++, false) >= 0);
+            }
+        }
+        IOT_MQTT_Yield(client, 50);
+    }
+
+    printf("  delivered %d of %d, %d duplicates, killed in replay: %d, publishes with callback refused %d times\n",
+           _distinct(), TOTAL_COUNT, sg_duplicates, sg_killed_in_replay, async_refused);
+    TEST_ASSERT(sg_killed_in_replay);
+    TEST_ASSERT_EQ(TOTAL_COUNT, _distinct());
+    TEST_ASSERT_EQ(0, sg_out_of_order);
+    TEST_ASSERT(!qcloud_iot_mqtt_offline_pending((Qcloud_IoT_Client *)client));
+    TEST_ASSERT(async_refused > 0);
+    TEST_ASSERT_EQ(LATE_COUNT / 2, async_sent);
+    while (sg_async_acked < async_sent && test_now_ns() < deadline) {
+        IOT_MQTT_Yield(client, 10);
+    }
+    TEST_ASSERT_EQ(async_sent, sg_async_acked);
+
+    IOT_MQTT_Destroy(&client);
+    test_broker_stop(broker);
+    return 0;
+}
+
+int main(void)
+{
+    IOT_Log_Set_Level(eLOG_WARN);
+    alarm(120);
+
+    TEST_RUN(test_link_kill_zero_loss);
+    return 0;
+}
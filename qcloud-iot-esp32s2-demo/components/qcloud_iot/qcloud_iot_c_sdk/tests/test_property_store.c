@@ -0,0 +1,246 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "qcloud_iot_export.h"
+#include "qcloud_iot_import.h"
+#include "test_broker.h"
+#include "test_util.h"
+
+/*
+ * Bytes of property reports published for a synthetic sensor trace, through the property store with
+ * deadbands, against the same store reporting every change. The local broker replies to reports like
+ * the cloud does, and counts the reports and the keys in them.
+ */
+
+#define TEST_PRODUCT_ID     "TESTPRD001"
+#define TEST_DEVICE_NAME    "dev_store"
+#define TEST_DEVICE_SECRET  "dGVzdC1kZXZpY2Utc2VjcmV0"
+
+#define TRACE_STEPS         400
+#define PROPERTY_COUNT      7
+
+typedef struct {
+    int         reports;
+    size_t      bytes;
+    int         key_reports[PROPERTY_COUNT];
+} ReportStats;
+
+static float          sg_temperature;
+static float          sg_humidity;
+static int32_t        sg_pressure;
+static int32_t        sg_light;
+static int8_t         sg_switch;
+static char           sg_status[16];
+static uint32_t       sg_uptime;
+
+static DeviceProperty sg_props[PROPERTY_COUNT] = {
+    {"temperature", &sg_temperature, 0, TYPE_TEMPLATE_FLOAT},
+    {"humidity", &sg_humidity, 0, TYPE_TEMPLATE_FLOAT},
+    {"pressure", &sg_pressure, 0, TYPE_TEMPLATE_INT},
+    {"light", &sg_light, 0, TYPE_TEMPLATE_INT},
+    {"switch", &sg_switch, 0, TYPE_TEMPLATE_BOOL},
+    {"status", sg_status, sizeof(sg_status), TYPE_TEMPLATE_STRING},
+    {"uptime", &sg_uptime, 0, TYPE_TEMPLATE_TIME},
+};
+
+/* deadbands of the sensors, 0 for properties reported on any change */
+static const float    sg_deadbands[PROPERTY_COUNT] = {0.5f, 1.0f, 3, 0, 0, 0, 30};
+
+static ReportStats    sg_stats;
+static uint64_t       sg_seed = 88172645463325252ULL;
+
+static uint64_t _rand64(void)
+{
+    sg_seed ^= sg_seed << 13;
+    sg_seed ^= sg_seed >> 7;
+    sg_seed ^= sg_seed << 17;
+    return sg_seed;
+}
+
+/* uniform noise in [-amplitude, amplitude] */
+static float _noise(float amplitude)
+{
+    return amplitude * ((float)(_rand64() % 2001) / 1000.0f - 1.0f);
+}
+
+static void _cloud_reply(TestBroker *broker, const char *topic, const char *payload, size_t len, void *context)
+{
+    const char *token, *end;
+    char reply[256], key[32];
+    int n, i;
+
+    if (strncmp(topic, "$thing/up/property/", strlen("$thing/up/property/")) != 0) {
+        return;
+    }
+    sg_stats.reports++;
+    sg_stats.bytes += len;
+    for (i = 0; i < PROPERTY_COUNT; i++) {
+        n = snprintf(key, sizeof(key), "\"%s\":", sg_props[i].key);
+        if (memmem(payload, len, key, n) != NULL) {
+            sg_stats.key_reports[i]++;
+        }
+    }
+
+    token = memmem(payload, len, "\"clientToken\":\"", strlen("\"clientToken\":\""));
+    if (token == NULL) {
+        return;
+    }
+    token += strlen("\"clientToken\":\"");
+    end = memchr(token, '"', payload + len - token);
+    if (end == NULL) {
+        return;
+    }
+
+    n = snprintf(reply, sizeof(reply),
+                 "{\"method\":\"report_reply\",\"clientToken\":\"%.*s\",\"code\":0,\"status\":\"success\"}",
+                 (int)(end - token), token);
+    test_broker_publish(broker, "$thing/down/property/" TEST_PRODUCT_ID "/" TEST_DEVICE_NAME, reply, n, 0);
+}
+
+/* sensor values at step of the trace, changes of the discrete ones are counted */
+static void _trace_step(int step, int changes[PROPERTY_COUNT])
+{
+    sg_temperature = 22.0f + 2.0f * sinf(step / 60.0f) + _noise(0.05f);
+    sg_humidity    = 45.0f + step * 0.01f + _noise(0.2f);
+    sg_pressure    = 1013 + (int32_t)(_rand64() % 3) - 1;
+    sg_uptime      = step;
+    if (step % 50 == 0) {
+        sg_light = (step / 50) * 10;
+        changes[3]++;
+    }
+    if (step % 100 == 0) {
+        sg_switch = !sg_switch;
+        changes[4]++;
+    }
+    if (step % 80 == 0) {
+        strcpy(sg_status, (step / 80) % 2 ? "warn" : "ok");
+        changes[5]++;
+    }
+}
+
+static int _run_trace(bool with_deadband, ReportStats *pStats, int changes[PROPERTY_COUNT])
+{
+    TemplateInitParams init_params = DEFAULT_TEMPLATE_INIT_PARAMS;
+    DeviceProperty *report_list[PROPERTY_COUNT];
+    static char report[1024];
+    void *template, *store;
+    uint64_t deadline;
+    int step, count, i;
+
+    init_params.product_id = TEST_PRODUCT_ID;
+    init_params.device_name = TEST_DEVICE_NAME;
+    init_params.device_secret = TEST_DEVICE_SECRET;
+    template = IOT_Template_Construct(&init_params, NULL);
+    TEST_ASSERT(template != NULL);
+
+    store = IOT_Template_PropertyStore_Create(PROPERTY_COUNT);
+    TEST_ASSERT(store != NULL);
+    for (i = 0; i < PROPERTY_COUNT; i++) {
+        TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, IOT_Template_PropertyStore_Add(store, &sg_props[i],
+                                                                           with_deadband ? sg_deadbands[i] : 0, 0));
+    }
+
+    sg_seed = 88172645463325252ULL;
+    sg_switch = 0;
+    sg_light = 0;
+    strcpy(sg_status, "ok");
+    memset(&sg_stats, 0, sizeof(sg_stats));
+    memset(changes, 0, sizeof(int) * PROPERTY_COUNT);
+
+    for (step = 1; step <= TRACE_STEPS; step++) {
+        _trace_step(step, changes);
+
+        count = IOT_Template_PropertyStore_Collect(store, report_list, PROPERTY_COUNT);
+        TEST_ASSERT(count >= 0);
+        if (count > 0) {
+            TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS,
+                           IOT_Template_JSON_ConstructReportArray(template, report, sizeof(report), count, report_list));
+            TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, IOT_Template_Report(template, report, sizeof(report), NULL, NULL, 5000));
+            IOT_Template_PropertyStore_Reported(store);
+        }
+        IOT_Template_Yield(template, 1);
+    }
+
+    /* replies of the last reports */
+    deadline = test_now_ns() + 200000000ull;
+    while (test_now_ns() < deadline) {
+        IOT_Template_Yield(template, 20);
+    }
+    *pStats = sg_stats;
+
+    IOT_Template_PropertyStore_Destroy(store);
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, IOT_Template_Destroy(template));
+    return 0;
+}
+
+static int test_published_bytes(void)
+{
+    ReportStats every_change, deadband;
+    int changes[PROPERTY_COUNT];
+    int i;
+
+    TEST_ASSERT_EQ(0, _run_trace(false, &every_change, changes));
+    TEST_ASSERT_EQ(0, _run_trace(true, &deadband, changes));
+
+    printf("{\"test\":\"property_store\",\"steps\":%d,\"every_change\":{\"reports\":%d,\"bytes\":%u},"
+           "\"deadband\":{\"reports\":%d,\"bytes\":%u}}\n",
+           TRACE_STEPS, every_change.reports, (unsigned)every_change.bytes, deadband.reports,
+           (unsigned)deadband.bytes);
+
+    /* the noisy temperature is reported at every step without deadband */
+    TEST_ASSERT(every_change.reports >= TRACE_STEPS - 1);
+    TEST_ASSERT(deadband.bytes * 4 < every_change.bytes);
+    TEST_ASSERT(deadband.reports * 4 < every_change.reports);
+
+    /* discrete properties are reported once at first, then at every change, with or without deadband */
+    for (i = 3; i <= 5; i++) {
+        TEST_ASSERT_EQ(1 + changes[i], every_change.key_reports[i]);
+        TEST_ASSERT_EQ(1 + changes[i], deadband.key_reports[i]);
+    }
+    /* uptime moves by 1 per step, its deadband lets one of 31 steps through */
+    TEST_ASSERT_EQ(1 + (TRACE_STEPS - 1) / 31, deadband.key_reports[6]);
+    for (i = 0; i < 3; i++) {
+        TEST_ASSERT(deadband.key_reports[i] > 0);
+        TEST_ASSERT(deadband.key_reports[i] * 4 < every_change.key_reports[i]);
+    }
+
+    return 0;
+}
+
+int main(void)
+{
+    TestBrokerParams params = {MQTT_SERVER_PORT_NOTLS, _cloud_reply, NULL, NULL, 0};
+    TestBroker *broker;
+
+    IOT_Log_Set_Level(eLOG_WARN);
+    alarm(60);
+
+    broker = test_broker_start(&params);
+    if (broker == NULL) {
+        return 1;
+    }
+
+    TEST_RUN(test_published_bytes);
+
+    test_broker_stop(broker);
+    return 0;
+}
@@ -0,0 +1,293 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mqtt_client_inflight.h"
+#include "qcloud_iot_import.h"
+#include "qcloud_iot_export_error.h"
+#include "qcloud_iot_export_log.h"
+#include "test_util.h"
+
+/* the table is linked without the timer HAL, PUBACK timeouts run on a clock driven by the test */
+
+static uint32_t sg_now_ms;
+
+uint32_t HAL_GetTimeMs(void)
+{
+    return sg_now_ms;
+}
+
+void IOT_Log_Gen(const char *file, const char *func, const int line, const int level, const char *fmt, ...)
+{
+}
+
+/* window of 8 gives an index of 16 slots, ids equal modulo 16 share a home slot */
+#define TEST_WINDOW     8
+#define TEST_SLAB_SIZE  256
+
+static unsigned char sg_payload[TEST_SLAB_SIZE];
+
+static QcloudIotPubInfo *_add(PubInflightTable *table, uint16_t msg_id, size_t len, uint32_t timeout_ms)
+{
+    /* header and body as the publish path passes them */
+    NetIoVec iov[2];
+
+    memset(sg_payload, msg_id & 0xFF, len);
+    iov[0].data = sg_payload;
+    iov[0].len  = len / 2;
+    iov[1].data = sg_payload + len / 2;
+    iov[1].len  = len - len / 2;
+
+    return pub_inflight_add(table, msg_id, iov, 2, timeout_ms);
+}
+
+static int _check_copy(QcloudIotPubInfo *info, uint16_t msg_id, size_t len)
+{
+    size_t i;
+
+    TEST_ASSERT(info != NULL);
+    TEST_ASSERT_EQ(msg_id, info->msg_id);
+    TEST_ASSERT_EQ(len, info->len);
+    for (i = 0; i < len; i++) {
+        TEST_ASSERT_EQ(msg_id & 0xFF, info->buf[i]);
+    }
+
+    return 0;
+}
+
+/* removing from the middle of a probe run keeps the entries after it reachable */
+static int test_index_backward_shift(void)
+{
+    TimerWheel        wheel;
+    PubInflightTable  table;
+    QcloudIotPubInfo *info;
+    /* 1, 17, 33 collide on slot 1, 2 probes past them, 15 and 31 wrap from slot 15 to slot 0 */
+    static const uint16_t ids[] = {1, 17, 33, 2, 15, 31, 47};
+    /* remove in an order that punches holes at the head, middle and wrapped end of runs */
+    static const uint16_t order[] = {17, 15, 1, 47, 2, 31, 33};
+    size_t            i, j;
+
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, timer_wheel_init(&wheel));
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, pub_inflight_init(&table, TEST_WINDOW, TEST_SLAB_SIZE, &wheel));
+    TEST_ASSERT_EQ(15, table.index_mask);
+
+    for (i = 0; i < sizeof(ids) / sizeof(ids[0]); i++) {
+        TEST_ASSERT(_add(&table, ids[i], 8, 1000) != NULL);
+    }
+    TEST_ASSERT_EQ(7, table.count);
+
+    /* an id in the table already is refused */
+    TEST_ASSERT(_add(&table, 33, 8, 1000) == NULL);
+    TEST_ASSERT(pub_inflight_find(&table, 49) == NULL);
+
+    for (i = 0; i < sizeof(order) / sizeof(order[0]); i++) {
+        info = pub_inflight_find(&table, order[i]);
+        if (_check_copy(info, order[i], 8)) {
+            return 1;
+        }
+        pub_inflight_remove(&table, info);
+        TEST_ASSERT(pub_inflight_find(&table, order[i]) == NULL);
+
+        /* every id not removed yet is still found */
+        for (j = i + 1; j < sizeof(order) / sizeof(order[0]); j++) {
+            if (_check_copy(pub_inflight_find(&table, order[j]), order[j], 8)) {
+                return 1;
+            }
+        }
+    }
+    TEST_ASSERT_EQ(0, table.count);
+    for (i = 0; i <= table.index_mask; i++) {
+        TEST_ASSERT_EQ(0xFFFF, table.index[i]);
+    }
+
+    pub_inflight_deinit(&table);
+    timer_wheel_deinit(&wheel);
+    return 0;
+}
+
+/* random add/remove against a shadow set, with packet ids confined to a few home slots */
+static int test_index_random(void)
+{
+    TimerWheel        wheel;
+    PubInflightTable  table;
+    QcloudIotPubInfo *info;
+    bool              live[128] = {false};
+    int               step, live_count = 0;
+    uint16_t          id;
+
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, timer_wheel_init(&wheel));
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, pub_inflight_init(&table, TEST_WINDOW, 4096, &wheel));
+    srand(1);
+
+    for (step = 0; step < 100000; step++) {
+        /* 24 ids sharing home slots 1, 3 and 5, so probe runs overlap */
+        id = (uint16_t)((rand() % 8) * 16 + 1 + 2 * (rand() % 3));
+
+        info = pub_inflight_find(&table, id);
+        TEST_ASSERT_EQ(live[id], info != NULL);
+        if (info != NULL) {
+            if (_check_copy(info, id, 16)) {
+                return 1;
+            }
+            pub_inflight_remove(&table, info);
+            live[id] = false;
+            live_count--;
+        } else {
+            info = _add(&table, id, 16, 1000);
+            /* refused only when the window is full */
+            TEST_ASSERT_EQ(live_count < TEST_WINDOW, info != NULL);
+            if (info != NULL) {
+                live[id] = true;
+                live_count++;
+            }
+        }
+        TEST_ASSERT_EQ(live_count, table.count);
+    }
+
+    while ((info = pub_inflight_first(&table)) != NULL) {
+        pub_inflight_remove(&table, info);
+    }
+    TEST_ASSERT_EQ(0, table.count);
+    TEST_ASSERT_EQ(0, table.slab_used);
+
+    pub_inflight_deinit(&table);
+    timer_wheel_deinit(&wheel);
+    return 0;
+}
+
+/* slab allocation wraps to the start, out of order frees are reclaimed once they are the oldest */
+static int test_slab_wrap(void)
+{
+    TimerWheel        wheel;
+    PubInflightTable  table;
+    QcloudIotPubInfo *a, *b, *c, *d, *e, *f;
+
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, timer_wheel_init(&wheel));
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, pub_inflight_init(&table, TEST_WINDOW, TEST_SLAB_SIZE, &wheel));
+
+    /* 56 bytes of packet and 8 bytes of chunk header take 64 bytes each */
+    a = _add(&table, 1, 56, 1000);
+    b = _add(&table, 2, 56, 1000);
+    c = _add(&table, 3, 56, 1000);
+    TEST_ASSERT(a != NULL && b != NULL && c != NULL);
+    TEST_ASSERT_EQ(192, table.slab_used);
+    TEST_ASSERT_EQ(192, table.slab_head);
+
+    /* 64 bytes left at the end and none at the start */
+    TEST_ASSERT(_add(&table, 4, 100, 1000) == NULL);
+
+    pub_inflight_remove(&table, a);
+    TEST_ASSERT_EQ(64, table.slab_tail);
+    /* exactly fills the end */
+    d = _add(&table, 4, 56, 1000);
+    TEST_ASSERT(d != NULL);
+    TEST_ASSERT_EQ(TEST_SLAB_SIZE, table.slab_head);
+
+    pub_inflight_remove(&table, b);
+    TEST_ASSERT_EQ(128, table.slab_tail);
+    /* no room at the end, wraps to the freed space at the start */
+    e = _add(&table, 5, 56, 1000);
+    TEST_ASSERT(e != NULL);
+    TEST_ASSERT(e->buf == table.slab + 8);
+    TEST_ASSERT_EQ(64, table.slab_head);
+    f = _add(&table, 6, 56, 1000);
+    TEST_ASSERT(f != NULL);
+    TEST_ASSERT_EQ(TEST_SLAB_SIZE, table.slab_used);
+    TEST_ASSERT(_add(&table, 7, 8, 1000) == NULL);
+
+    /* d is not the oldest, its space comes back together with c */
+    pub_inflight_remove(&table, d);
+    TEST_ASSERT_EQ(TEST_SLAB_SIZE, table.slab_used);
+    pub_inflight_remove(&table, c);
+    TEST_ASSERT_EQ(128, table.slab_used);
+    TEST_ASSERT_EQ(0, table.slab_tail);
+
+    if (_check_copy(pub_inflight_find(&table, 5), 5, 56) || _check_copy(pub_inflight_find(&table, 6), 6, 56)) {
+        return 1;
+    }
+
+    pub_inflight_remove(&table, e);
+    pub_inflight_remove(&table, f);
+    TEST_ASSERT_EQ(0, table.slab_used);
+    TEST_ASSERT_EQ(0, table.count);
+
+    /* an empty slab starts over at 0 and takes the whole size */
+    a = _add(&table, 8, TEST_SLAB_SIZE - 8, 1000);
+    TEST_ASSERT(a != NULL);
+    TEST_ASSERT(a->buf == table.slab + 8);
+    pub_inflight_remove(&table, a);
+
+    pub_inflight_deinit(&table);
+    timer_wheel_deinit(&wheel);
+    return 0;
+}
+
+/* PUBACK timeouts come out of the wheel in deadline order, removed entries never do */
+static int test_expired(void)
+{
+    TimerWheel        wheel;
+    PubInflightTable  table;
+    QcloudIotPubInfo *info;
+
+    sg_now_ms = 0xFFFFFFFFu - 1000;
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, timer_wheel_init(&wheel));
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, pub_inflight_init(&table, TEST_WINDOW, TEST_SLAB_SIZE, &wheel));
+
+    TEST_ASSERT(_add(&table, 1, 8, 3000) != NULL);
+    TEST_ASSERT(_add(&table, 2, 8, 1000) != NULL);
+    TEST_ASSERT(_add(&table, 3, 8, 2000) != NULL);
+    TEST_ASSERT(_add(&table, 4, 8, 1500) != NULL);
+    pub_inflight_remove(&table, pub_inflight_find(&table, 4));
+
+    TEST_ASSERT(pub_inflight_expired(&table) == NULL);
+
+    /* across the wrap of the 32-bit clock */
+    sg_now_ms += 1000 + TIMER_WHEEL_TICK_MS;
+    info = pub_inflight_expired(&table);
+    TEST_ASSERT(info != NULL);
+    TEST_ASSERT_EQ(2, info->msg_id);
+    pub_inflight_remove(&table, info);
+    TEST_ASSERT(pub_inflight_expired(&table) == NULL);
+
+    sg_now_ms += 2000;
+    info = pub_inflight_expired(&table);
+    TEST_ASSERT(info != NULL);
+    TEST_ASSERT_EQ(3, info->msg_id);
+    pub_inflight_remove(&table, info);
+    info = pub_inflight_expired(&table);
+    TEST_ASSERT(info != NULL);
+    TEST_ASSERT_EQ(1, info->msg_id);
+    pub_inflight_remove(&table, info);
+
+    TEST_ASSERT(pub_inflight_expired(&table) == NULL);
+    TEST_ASSERT_EQ(0, table.count);
+    TEST_ASSERT_EQ(0, wheel.count);
+
+    pub_inflight_deinit(&table);
+    timer_wheel_deinit(&wheel);
+    return 0;
+}
+
+int main(void)
+{
+    TEST_RUN(test_index_backward_shift);
+    TEST_RUN(test_index_random);
+    TEST_RUN(test_slab_wrap);
+    TEST_RUN(test_expired);
+    return 0;
+}
@@ -0,0 +1,219 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "qcloud_iot_export.h"
+#include "qcloud_iot_import.h"
+#include "test_broker.h"
+#include "test_util.h"
+
+/*
+ * PUBLISH larger than the Rx buffer of the client: payload must reach the chunk handler in order,
+ * each chunk at the offset following the one before and NUL terminated, the last one ending at the
+ * total length. Packets after it are read in sync, whether the large one was delivered or dropped.
+ */
+
+#define TEST_PRODUCT_ID     "TESTPRD001"
+#define TEST_DEVICE_NAME    "dev_chunks"
+#define TEST_DEVICE_SECRET  "dGVzdC1kZXZpY2Utc2VjcmV0"
+/* chunk handler and message handler */
+#define TEST_TOPIC_BOTH     TEST_PRODUCT_ID "/" TEST_DEVICE_NAME "/both"
+/* chunk handler only, gets small messages as one chunk too */
+#define TEST_TOPIC_CHUNK    TEST_PRODUCT_ID "/" TEST_DEVICE_NAME "/chunk"
+/* message handler only, large messages are dropped */
+#define TEST_TOPIC_MSG      TEST_PRODUCT_ID "/" TEST_DEVICE_NAME "/msg"
+
+#define RX_BUF_SIZE         1024
+#define MAX_PAYLOAD_LEN     (64 * 1024)
+
+typedef struct {
+    unsigned char   data[MAX_PAYLOAD_LEN];
+    size_t          total_len;
+    size_t          next_offset;
+    int             chunks;
+    int             complete;
+    int             errors;
+    int             messages;
+    size_t          last_message_len;
+} Receiver;
+
+static Receiver sg_both, sg_chunk, sg_msg;
+static int      sg_subscribed;
+
+static void _fill(unsigned char *buf, size_t len, unsigned seed)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        buf[i] = (unsigned char)('a' + (seed + i * 7 + (i >> 10)) % 26);
+    }
+}
+
+static void _on_chunk(void *pClient, MQTTMessage *message, size_t offset, size_t total_len, void *pUserData)
+{
+    Receiver *r = (Receiver *)pUserData;
+
+    if (0 == offset) {
+        r->total_len = total_len;
+        r->next_offset = 0;
+        r->chunks = 0;
+    }
+    /* in order, no gap, within the Rx buffer, NUL terminated, and the same total every time */
+    if (offset != r->next_offset || total_len != r->total_len || 0 == message->payload_len ||
+        message->payload_len >= RX_BUF_SIZE || offset + message->payload_len > total_len ||
+        ((char *)message->payload)[message->payload_len] != '\0') {
+        r->errors++;
+        return;
+    }
+
+    memcpy(r->data + offset, message->payload, message->payload_len);
+    r->next_offset = offset + message->payload_len;
+    r->chunks++;
+    if (r->next_offset == total_len) {
+        r->complete++;
+    }
+}
+
+static void _on_message(void *pClient, MQTTMessage *message, void *pUserData)
+{
+    Receiver *r = (Receiver *)pUserData;
+
+    r->messages++;
+    r->last_message_len = message->payload_len;
+}
+
+static void _on_sub_event(void *pClient, MQTTEventType event_type, void *pUserData)
+{
+    if (event_type == MQTT_EVENT_SUBCRIBE_SUCCESS) {
+        sg_subscribed++;
+    }
+}
+
+static int _subscribe(void *client, const char *topic, Receiver *r, bool message, bool chunk)
+{
+    SubscribeParams sub_params = DEFAULT_SUB_PARAMS;
+
+    sub_params.qos = QOS1;
+    sub_params.on_message_handler = message ? _on_message : NULL;
+    sub_params.on_message_chunk_handler = chunk ? _on_chunk : NULL;
+    sub_params.on_sub_event_handler = _on_sub_event;
+    sub_params.user_data = r;
+    TEST_ASSERT(IOT_MQTT_Subscribe(client, (char *)topic, &sub_params) >= 0);
+    return 0;
+}
+
+static int _wait(void *client, int *counter, int expected)
+{
+    uint64_t deadline = test_now_ns() + 5000000000ull;
+
+    while (*counter < expected && test_now_ns() < deadline) {
+        IOT_MQTT_Yield(client, 10);
+    }
+    TEST_ASSERT_EQ(expected, *counter);
+    return 0;
+}
+
+static int test_large_publish_chunks(void)
+{
+    MQTTInitParams init_params = DEFAULT_MQTTINIT_PARAMS;
+    TestBrokerParams broker_params = {MQTT_SERVER_PORT_NOTLS, NULL, NULL, NULL, 0};
+    static unsigned char payload[MAX_PAYLOAD_LEN];
+    /* around multiples of the chunk size, and the largest */
+    static const size_t sizes[] = {RX_BUF_SIZE, 3000, 4 * RX_BUF_SIZE, 4 * RX_BUF_SIZE + 1, MAX_PAYLOAD_LEN};
+    TestBroker *broker;
+    void *client;
+    size_t i;
+    int qos;
+
+    broker = test_broker_start(&broker_params);
+    TEST_ASSERT(broker != NULL);
+
+    init_params.product_id = TEST_PRODUCT_ID;
+    init_params.device_name = TEST_DEVICE_NAME;
+    init_params.device_secret = TEST_DEVICE_SECRET;
+    init_params.command_timeout = 2000;
+    init_params.rx_buf_size = RX_BUF_SIZE;
+    client = IOT_MQTT_Construct(&init_params);
+    TEST_ASSERT(client != NULL);
+
+    if (_subscribe(client, TEST_TOPIC_BOTH, &sg_both, true, true) ||
+        _subscribe(client, TEST_TOPIC_CHUNK, &sg_chunk, false, true) ||
+        _subscribe(client, TEST_TOPIC_MSG, &sg_msg, true, false) || _wait(client, &sg_subscribed, 3)) {
+        return 1;
+    }
+
+    for (qos = 0; qos <= 1; qos++) {
+        for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            int complete = sg_both.complete, messages = sg_both.messages;
+
+            _fill(payload, sizes[i], (unsigned)i);
+            /* small ones right before and behind it */
+            TEST_ASSERT_EQ(0, test_broker_publish(broker, TEST_TOPIC_BOTH, "head", 4, qos));
+            TEST_ASSERT_EQ(0, test_broker_publish(broker, TEST_TOPIC_BOTH, payload, sizes[i], qos));
+            TEST_ASSERT_EQ(0, test_broker_publish(broker, TEST_TOPIC_BOTH, "tail", 4, qos));
+            if (_wait(client, &sg_both.messages, messages + 2)) {
+                return 1;
+            }
+
+            TEST_ASSERT_EQ(0, sg_both.errors);
+            TEST_ASSERT_EQ(complete + 1, sg_both.complete);
+            TEST_ASSERT_EQ(sizes[i], sg_both.total_len);
+            TEST_ASSERT(sg_both.chunks > 1);
+            TEST_ASSERT(!memcmp(sg_both.data, payload, sizes[i]));
+            TEST_ASSERT_EQ(4, sg_both.last_message_len);
+        }
+    }
+
+    /* small messages come to a chunk handler without message handler as one final chunk */
+    TEST_ASSERT_EQ(0, test_broker_publish(broker, TEST_TOPIC_CHUNK, "small", 5, 1));
+    if (_wait(client, &sg_chunk.complete, 1)) {
+        return 1;
+    }
+    TEST_ASSERT_EQ(1, sg_chunk.chunks);
+    TEST_ASSERT_EQ(5, sg_chunk.total_len);
+    _fill(payload, 10000, 9);
+    TEST_ASSERT_EQ(0, test_broker_publish(broker, TEST_TOPIC_CHUNK, payload, 10000, 1));
+    if (_wait(client, &sg_chunk.complete, 2)) {
+        return 1;
+    }
+    TEST_ASSERT_EQ(0, sg_chunk.errors);
+    TEST_ASSERT(!memcmp(sg_chunk.data, payload, 10000));
+
+    /* without chunk handler the large one is dropped, and the next one is still read in sync */
+    TEST_ASSERT_EQ(0, test_broker_publish(broker, TEST_TOPIC_MSG, payload, 10000, 1));
+    TEST_ASSERT_EQ(0, test_broker_publish(broker, TEST_TOPIC_MSG, "after", 5, 1));
+    if (_wait(client, &sg_msg.messages, 1)) {
+        return 1;
+    }
+    TEST_ASSERT_EQ(5, sg_msg.last_message_len);
+    TEST_ASSERT(IOT_MQTT_IsConnected(client));
+
+    IOT_MQTT_Destroy(&client);
+    test_broker_stop(broker);
+    return 0;
+}
+
+int main(void)
+{
+    IOT_Log_Set_Level(eLOG_WARN);
+    alarm(60);
+
+    TEST_RUN(test_large_publish_chunks);
+    return 0;
+}
@@ -0,0 +1,241 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "qcloud_iot_export.h"
+#include "qcloud_iot_import.h"
+#include "data_template_client.h"
+#include "test_util.h"
+
+/*
+ * Token bucket of the report scheduler, linked without the rest of the template client. Reports go to a
+ * stub which fails on demand, and the bucket refills on a clock driven by the test.
+ */
+
+static uint32_t            sg_now_ms;
+static int                 sg_report_rc;
+static int                 sg_report_calls;
+/* template whose scheduler runs again inside the next report, as a yield of another thread would */
+static Qcloud_IoT_Template *sg_reenter_template;
+
+static int32_t        sg_value;
+static DeviceProperty sg_property = {"level", &sg_value, 0, JINT32};
+static DeviceProperty *sg_property_list[] = {&sg_property};
+
+uint32_t HAL_GetTimeMs(void)
+{
+    return sg_now_ms;
+}
+
+void IOT_Log_Gen(const char *file, const char *func, const int line, const int level, const char *fmt, ...)
+{
+}
+
+int IOT_Template_JSON_ConstructReportArray(void *handle, char *jsonBuffer, size_t sizeOfBuffer, uint8_t count,
+                                           DeviceProperty *pDeviceProperties[])
+{
+    return QCLOUD_RET_SUCCESS;
+}
+
+int IOT_Template_Report(void *handle, char *pJsonDoc, size_t sizeOfBuffer, OnReplyCallback callback,
+                        void *userContext, uint32_t timeout_ms)
+{
+    Qcloud_IoT_Template *pTemplate = sg_reenter_template;
+
+    sg_report_calls++;
+    if (pTemplate != NULL) {
+        sg_reenter_template = NULL;
+        /* refills the bucket during the report, without sending as the reply list is full */
+        sg_now_ms += 3600 * 1000;
+        pTemplate->inner_data.reply_count = MAX_APPENDING_REQUEST_AT_ANY_GIVEN_TIME;
+        IOT_Template_Report_Schedule(pTemplate, 1, sg_property_list);
+        handle_template_report_sched(pTemplate);
+        pTemplate->inner_data.reply_count = 0;
+    }
+    return sg_report_rc;
+}
+
+static int _init_sched(Qcloud_IoT_Template *pTemplate, uint16_t rate_per_min, uint16_t burst)
+{
+    ReportSchedParams params = DEFAULT_REPORT_SCHED_PARAMS;
+
+    memset(pTemplate, 0, sizeof(Qcloud_IoT_Template));
+    pTemplate->mutex = HAL_MutexCreate();
+    TEST_ASSERT(pTemplate->mutex != NULL);
+
+    params.window_ms    = 0;
+    params.rate_per_min = rate_per_min;
+    params.burst        = burst;
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, IOT_Template_ReportSched_Init(pTemplate, &params));
+
+    sg_report_rc    = QCLOUD_RET_SUCCESS;
+    sg_report_calls = 0;
+    return 0;
+}
+
+static void _deinit_sched(Qcloud_IoT_Template *pTemplate)
+{
+    template_report_sched_deinit(pTemplate);
+    HAL_MutexDestroy(pTemplate->mutex);
+}
+
+/* schedule the property and run the scheduler once, returns number of reports sent */
+static int _schedule_and_handle(Qcloud_IoT_Template *pTemplate)
+{
+    int calls = sg_report_calls;
+
+    if (IOT_Template_Report_Schedule(pTemplate, 1, sg_property_list) != QCLOUD_RET_SUCCESS) {
+        return -1;
+    }
+    handle_template_report_sched(pTemplate);
+    return sg_report_calls - calls;
+}
+
+/* burst goes out back to back, then one report per 60000 / rate_per_min ms */
+static int test_refill(void)
+{
+    Qcloud_IoT_Template template;
+    ReportSchedStats    stats;
+
+    sg_now_ms = 0xFFFFF000U;
+    TEST_ASSERT_EQ(0, _init_sched(&template, 60, 2));
+
+    TEST_ASSERT_EQ(1, _schedule_and_handle(&template));
+    TEST_ASSERT_EQ(1, _schedule_and_handle(&template));
+    TEST_ASSERT_EQ(0, _schedule_and_handle(&template));
+
+    /* refill goes across the wrap of the clock */
+    sg_now_ms += 999;
+    TEST_ASSERT_EQ(0, _schedule_and_handle(&template));
+    sg_now_ms += 1;
+    TEST_ASSERT_EQ(1, _schedule_and_handle(&template));
+    sg_now_ms += 1000;
+    TEST_ASSERT_EQ(1, _schedule_and_handle(&template));
+    TEST_ASSERT_EQ(0, _schedule_and_handle(&template));
+
+    /* a long pause fills the bucket up to the burst only */
+    sg_now_ms += 3600 * 1000;
+    TEST_ASSERT_EQ(1, _schedule_and_handle(&template));
+    TEST_ASSERT_EQ(1, _schedule_and_handle(&template));
+    TEST_ASSERT_EQ(0, _schedule_and_handle(&template));
+
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, IOT_Template_ReportSched_GetStats(&template, &stats));
+    TEST_ASSERT_EQ(6, stats.reports);
+    TEST_ASSERT_EQ(4, stats.throttled);
+    /* the property throttled waits in the queue, later changes are merged into it */
+    TEST_ASSERT_EQ(1, stats.queue_depth);
+    TEST_ASSERT_EQ(3, stats.merged);
+
+    _deinit_sched(&template);
+    return 0;
+}
+
+/* refills shorter than a token keep their part, so frequent yields at a low rate still refill */
+static int test_refill_fraction(void)
+{
+    Qcloud_IoT_Template template;
+    uint32_t            start;
+    int                 sent = 0;
+
+    sg_now_ms = 1000;
+    /* a token per 60000 / 7 = 8571.4 ms */
+    TEST_ASSERT_EQ(0, _init_sched(&template, 7, 2));
+    TEST_ASSERT_EQ(1, _schedule_and_handle(&template));
+    TEST_ASSERT_EQ(1, _schedule_and_handle(&template));
+
+    start = sg_now_ms;
+    while (!sent && sg_now_ms - start < 20000) {
+        sg_now_ms++;
+        sent = _schedule_and_handle(&template);
+        TEST_ASSERT(sent >= 0);
+    }
+    TEST_ASSERT_EQ(1, sent);
+    TEST_ASSERT_EQ(8572, sg_now_ms - start);
+
+    /* the part left over is carried into the next token: 2 * 8571.4 ms from start */
+    while (_schedule_and_handle(&template) == 0) {
+        sg_now_ms++;
+    }
+    TEST_ASSERT_EQ(17143, sg_now_ms - start);
+
+    /* nothing is carried past a full bucket */
+    sg_now_ms += 2 * 8572 + 4000;
+    TEST_ASSERT_EQ(1, _schedule_and_handle(&template));
+    TEST_ASSERT_EQ(1, _schedule_and_handle(&template));
+    start = sg_now_ms;
+    while (_schedule_and_handle(&template) == 0) {
+        sg_now_ms++;
+    }
+    TEST_ASSERT_EQ(8572, sg_now_ms - start);
+
+    _deinit_sched(&template);
+    return 0;
+}
+
+/* a failed report gives its token back and keeps the properties waiting, never above the burst */
+static int test_refund(void)
+{
+    Qcloud_IoT_Template template;
+    ReportSchedStats    stats;
+    int                 i;
+
+    sg_now_ms = 5000;
+    TEST_ASSERT_EQ(0, _init_sched(&template, 60, 2));
+
+    sg_report_rc = QCLOUD_ERR_MQTT_NO_CONN;
+    for (i = 0; i < 10; i++) {
+        TEST_ASSERT_EQ(1, _schedule_and_handle(&template));
+    }
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, IOT_Template_ReportSched_GetStats(&template, &stats));
+    TEST_ASSERT_EQ(0, stats.reports);
+    TEST_ASSERT_EQ(0, stats.throttled);
+    TEST_ASSERT_EQ(1, stats.queue_depth);
+
+    /* bucket is full as before the failures, and not fuller */
+    sg_report_rc = QCLOUD_RET_SUCCESS;
+    handle_template_report_sched(&template);
+    TEST_ASSERT_EQ(11, sg_report_calls);
+    TEST_ASSERT_EQ(1, _schedule_and_handle(&template));
+    TEST_ASSERT_EQ(0, _schedule_and_handle(&template));
+
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, IOT_Template_ReportSched_GetStats(&template, &stats));
+    TEST_ASSERT_EQ(2, stats.reports);
+    TEST_ASSERT_EQ(1, stats.throttled);
+
+    /* a refund after the bucket refilled meanwhile does not raise it above the burst */
+    sg_now_ms += 1000;
+    sg_reenter_template = &template;
+    sg_report_rc = QCLOUD_ERR_MQTT_NO_CONN;
+    TEST_ASSERT_EQ(1, _schedule_and_handle(&template));
+    TEST_ASSERT(sg_reenter_template == NULL);
+    sg_report_rc = QCLOUD_RET_SUCCESS;
+    TEST_ASSERT_EQ(1, _schedule_and_handle(&template));
+    TEST_ASSERT_EQ(1, _schedule_and_handle(&template));
+    TEST_ASSERT_EQ(0, _schedule_and_handle(&template));
+
+    _deinit_sched(&template);
+    return 0;
+}
+
+int main(void)
+{
+    TEST_RUN(test_refill);
+    TEST_RUN(test_refill_fraction);
+    TEST_RUN(test_refund);
+    return 0;
+}
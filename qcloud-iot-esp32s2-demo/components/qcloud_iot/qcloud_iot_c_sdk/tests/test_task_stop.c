@@ -0,0 +1,125 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "qcloud_iot_export.h"
+#include "qcloud_iot_import.h"
+#include "test_broker.h"
+#include "test_util.h"
+
+/*
+ * Stop of the reader and writer tasks. A stop joins the task, and one which does not return in time
+ * is reported and left running: here a message handler holds the reader task past the wait.
+ */
+
+#define TEST_PRODUCT_ID     "TESTPRD001"
+#define TEST_DEVICE_NAME    "dev_stop"
+#define TEST_DEVICE_SECRET  "dGVzdC1kZXZpY2Utc2VjcmV0"
+#define TEST_TOPIC          TEST_PRODUCT_ID "/" TEST_DEVICE_NAME "/data"
+#define TEST_COMMAND_MS     500     /* the least command timeout */
+/* wait of a reader task stop, the handler outlasts two of them */
+#define TEST_STOP_WAIT_MS   (MQTT_RX_TASK_YIELD_MS + 2 * TEST_COMMAND_MS)
+#define TEST_HANDLER_MS     (2 * TEST_STOP_WAIT_MS + 1000)
+
+static volatile int sg_handler_entered;
+static volatile int sg_handler_left;
+
+static void _on_message(void *pClient, MQTTMessage *message, void *pUserData)
+{
+    sg_handler_entered++;
+    HAL_SleepMs(TEST_HANDLER_MS);
+    sg_handler_left++;
+}
+
+static int _publish(void *client)
+{
+    PublishParams pub_params = DEFAULT_PUB_PARAMS;
+
+    pub_params.qos = QOS0;
+    pub_params.payload = "ping";
+    pub_params.payload_len = 4;
+    return IOT_MQTT_Publish(client, TEST_TOPIC, &pub_params);
+}
+
+static int test_stop_timeout(void)
+{
+    MQTTInitParams init_params = DEFAULT_MQTTINIT_PARAMS;
+    SubscribeParams sub_params = DEFAULT_SUB_PARAMS;
+    uint64_t deadline;
+    void *client;
+
+    init_params.product_id = TEST_PRODUCT_ID;
+    init_params.device_name = TEST_DEVICE_NAME;
+    init_params.device_secret = TEST_DEVICE_SECRET;
+    init_params.command_timeout = TEST_COMMAND_MS;
+    client = IOT_MQTT_Construct(&init_params);
+    TEST_ASSERT(client != NULL);
+
+    sub_params.qos = QOS0;
+    sub_params.on_message_handler = _on_message;
+    TEST_ASSERT(IOT_MQTT_Subscribe(client, TEST_TOPIC, &sub_params) > 0);
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, IOT_MQTT_StartTxTask(client, 0));
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, IOT_MQTT_StartRxTask(client, 0));
+    HAL_SleepMs(200);
+
+    /* the handler holds the reader task past the wait of the stop */
+    TEST_ASSERT(_publish(client) >= 0);
+    deadline = test_now_ns() + 5000000000ull;
+    while (!sg_handler_entered && test_now_ns() < deadline) {
+        HAL_SleepMs(10);
+    }
+    TEST_ASSERT_EQ(1, sg_handler_entered);
+    TEST_ASSERT_EQ(QCLOUD_ERR_FAILURE, IOT_MQTT_StopRxTask(client));
+    TEST_ASSERT_EQ(QCLOUD_ERR_FAILURE, IOT_MQTT_Destroy(&client));
+    TEST_ASSERT(client != NULL);
+
+    /* the task was left to finish the handler, then the next stop joins it */
+    TEST_ASSERT_EQ(0, sg_handler_left);
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, IOT_MQTT_StopRxTask(client));
+    TEST_ASSERT_EQ(1, sg_handler_left);
+
+    /* writer task is idle, it returns at once */
+    TEST_ASSERT(_publish(client) >= 0);
+    deadline = test_now_ns() + 1000000000ull;
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, IOT_MQTT_StopTxTask(client));
+    TEST_ASSERT(test_now_ns() < deadline);
+    TEST_ASSERT(_publish(client) >= 0);
+
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, IOT_MQTT_Destroy(&client));
+    TEST_ASSERT(client == NULL);
+    return 0;
+}
+
+int main(void)
+{
+    TestBrokerParams params = {MQTT_SERVER_PORT_NOTLS, NULL, NULL, NULL, 0};
+    TestBroker *broker;
+
+    IOT_Log_Set_Level(eLOG_DISABLE);
+    alarm(30);
+
+    broker = test_broker_start(&params);
+    if (broker == NULL) {
+        return 1;
+    }
+
+    TEST_RUN(test_stop_timeout);
+
+    test_broker_stop(broker);
+    return 0;
+}
@@ -0,0 +1,241 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "qcloud_iot_export.h"
+#include "qcloud_iot_import.h"
+#include "data_template_client.h"
+#include "test_broker.h"
+#include "test_util.h"
+
+/*
+ * Reply slots of the data template client against the local broker, which replies to reports unless
+ * told not to. Requests time out and give their slots back, and sequential clientTokens that share a
+ * home slot with a request still waiting are probed past it.
+ */
+
+#define TEST_PRODUCT_ID     "TESTPRD001"
+#define TEST_DEVICE_NAME    "dev_reply"
+#define TEST_DEVICE_SECRET  "dGVzdC1kZXZpY2Utc2VjcmV0"
+#define TEST_REPLY_TOPIC    "$thing/down/property/" TEST_PRODUCT_ID "/" TEST_DEVICE_NAME
+
+/* MAX_APPENDING_REQUEST_AT_ANY_GIVEN_TIME of the client */
+#define MAX_WAITING         10
+#define REQUEST_COUNT       40
+
+typedef struct {
+    int         calls;
+    ReplyAck    ack;
+} ReplyResult;
+
+static TestBroker    *sg_broker;
+static volatile bool  sg_reply_enabled;
+/* token the broker does not reply to, empty for none */
+static char           sg_held_token[MAX_SIZE_OF_CLIENT_TOKEN];
+static ReplyResult    sg_results[REQUEST_COUNT];
+
+static int _reply_to(const char *token, int token_len)
+{
+    char reply[256];
+    int n = snprintf(reply, sizeof(reply),
+                     "{\"method\":\"report_reply\",\"clientToken\":\"%.*s\",\"code\":0,\"status\":\"success\"}",
+                     token_len, token);
+
+    return test_broker_publish(sg_broker, TEST_REPLY_TOPIC, reply, n, 0);
+}
+
+static void _cloud_reply(TestBroker *broker, const char *topic, const char *payload, size_t len, void *context)
+{
+    const char *token, *end;
+
+    if (!sg_reply_enabled || strncmp(topic, "$thing/up/property/", strlen("$thing/up/property/")) != 0) {
+        return;
+    }
+
+    token = memmem(payload, len, "\"clientToken\":\"", strlen("\"clientToken\":\""));
+    if (token == NULL) {
+        return;
+    }
+    token += strlen("\"clientToken\":\"");
+    end = memchr(token, '"', payload + len - token);
+    if (end == NULL) {
+        return;
+    }
+    if (strlen(sg_held_token) == (size_t)(end - token) && !strncmp(token, sg_held_token, end - token)) {
+        return;
+    }
+
+    _reply_to(token, end - token);
+}
+
+static void _on_reply(void *pClient, Method method, ReplyAck replyAck, const char *pJsonDocument, void *pUserdata)
+{
+    /* user data of reply callback is the request, as IOT_Template_Report_Sync expects */
+    ReplyResult *result = (ReplyResult *)((Request *)pUserdata)->user_context;
+
+    result->calls++;
+    result->ack = replyAck;
+}
+
+static void *_construct_template(void)
+{
+    TemplateInitParams init_params = DEFAULT_TEMPLATE_INIT_PARAMS;
+
+    init_params.product_id = TEST_PRODUCT_ID;
+    init_params.device_name = TEST_DEVICE_NAME;
+    init_params.device_secret = TEST_DEVICE_SECRET;
+    return IOT_Template_Construct(&init_params, NULL);
+}
+
+/* report with reply to result, the clientToken generated goes to token if not NULL */
+static int _report(void *template, ReplyResult *result, char *token, uint32_t timeout_ms)
+{
+    static int32_t value;
+    static DeviceProperty property = {"level", &value, 0, JINT32};
+    DeviceProperty *list[] = {&property};
+    char doc[256];
+    const char *start;
+    int rc;
+
+    rc = IOT_Template_JSON_ConstructReportArray(template, doc, sizeof(doc), 1, list);
+    if (rc != QCLOUD_RET_SUCCESS) {
+        return rc;
+    }
+    if (token != NULL) {
+        start = strstr(doc, "\"clientToken\":\"") + strlen("\"clientToken\":\"");
+        memcpy(token, start, strchr(start, '"') - start);
+        token[strchr(start, '"') - start] = '\0';
+    }
+
+    return IOT_Template_Report(template, doc, sizeof(doc), _on_reply, result, timeout_ms);
+}
+
+/* yield until the callbacks of results [first, last) are called calls times each, or timeout */
+static int _wait_replies(void *template, int first, int last, int calls, uint32_t timeout_ms)
+{
+    uint64_t deadline = test_now_ns() + (uint64_t)timeout_ms * 1000000;
+    int i, done;
+
+    do {
+        IOT_Template_Yield(template, 10);
+        for (i = first, done = 0; i < last; i++) {
+            done += sg_results[i].calls >= calls;
+        }
+    } while (done < last - first && test_now_ns() < deadline);
+
+    return done;
+}
+
+/* slots are all taken without reply, then given back by timeout and taken again */
+static int test_timeout_and_reuse(void)
+{
+    void *template = _construct_template();
+    ReplyResult extra = {0, ACK_NONE};
+    int i;
+
+    TEST_ASSERT(template != NULL);
+    memset(sg_results, 0, sizeof(sg_results));
+    sg_held_token[0] = '\0';
+
+    sg_reply_enabled = false;
+    for (i = 0; i < MAX_WAITING; i++) {
+        TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, _report(template, &sg_results[i], NULL, 1000));
+    }
+    TEST_ASSERT_EQ(QCLOUD_ERR_MAX_APPENDING_REQUEST, _report(template, &extra, NULL, 1000));
+
+    TEST_ASSERT_EQ(MAX_WAITING, _wait_replies(template, 0, MAX_WAITING, 1, 3000));
+    for (i = 0; i < MAX_WAITING; i++) {
+        TEST_ASSERT_EQ(1, sg_results[i].calls);
+        TEST_ASSERT_EQ(ACK_TIMEOUT, sg_results[i].ack);
+    }
+    TEST_ASSERT_EQ(0, extra.calls);
+
+    /* all slots are free again */
+    sg_reply_enabled = true;
+    for (i = 0; i < MAX_WAITING; i++) {
+        TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, _report(template, &sg_results[i], NULL, 1000));
+    }
+    TEST_ASSERT_EQ(MAX_WAITING, _wait_replies(template, 0, MAX_WAITING, 2, 3000));
+    for (i = 0; i < MAX_WAITING; i++) {
+        TEST_ASSERT_EQ(2, sg_results[i].calls);
+        TEST_ASSERT_EQ(ACK_ACCEPTED, sg_results[i].ack);
+    }
+
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, IOT_Template_Destroy(template));
+    return 0;
+}
+
+/* a request left waiting shares its home slot with every 16th token after it, the replies still match */
+static int test_reuse_around_waiting(void)
+{
+    void *template = _construct_template();
+    int i;
+
+    TEST_ASSERT(template != NULL);
+    memset(sg_results, 0, sizeof(sg_results));
+
+    sg_reply_enabled = true;
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, _report(template, &sg_results[0], sg_held_token, 3000));
+
+    for (i = 1; i < REQUEST_COUNT; i++) {
+        TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, _report(template, &sg_results[i], NULL, 1000));
+        /* a few in flight at once, so probing runs past slots of requests not replied yet too */
+        if (i % 4 == 0) {
+            _wait_replies(template, 1, i + 1, 1, 1000);
+        }
+    }
+    _wait_replies(template, 1, REQUEST_COUNT, 1, 1000);
+
+    TEST_ASSERT_EQ(0, sg_results[0].calls);
+    for (i = 1; i < REQUEST_COUNT; i++) {
+        TEST_ASSERT_EQ(1, sg_results[i].calls);
+        TEST_ASSERT_EQ(ACK_ACCEPTED, sg_results[i].ack);
+    }
+
+    /* the request held times out once, and its late reply finds no slot */
+    TEST_ASSERT_EQ(1, _wait_replies(template, 0, 1, 1, 4000));
+    TEST_ASSERT_EQ(ACK_TIMEOUT, sg_results[0].ack);
+    TEST_ASSERT_EQ(0, _reply_to(sg_held_token, strlen(sg_held_token)));
+    _wait_replies(template, 0, 1, 2, 200);
+    TEST_ASSERT_EQ(1, sg_results[0].calls);
+
+    sg_held_token[0] = '\0';
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, IOT_Template_Destroy(template));
+    return 0;
+}
+
+int main(void)
+{
+    TestBrokerParams params = {MQTT_SERVER_PORT_NOTLS, _cloud_reply, NULL, NULL, 0};
+
+    IOT_Log_Set_Level(eLOG_WARN);
+    alarm(60);
+
+    sg_broker = test_broker_start(&params);
+    if (sg_broker == NULL) {
+        return 1;
+    }
+
+    TEST_RUN(test_timeout_and_reuse);
+    TEST_RUN(test_reuse_around_waiting);
+
+    test_broker_stop(sg_broker);
+    return 0;
+}
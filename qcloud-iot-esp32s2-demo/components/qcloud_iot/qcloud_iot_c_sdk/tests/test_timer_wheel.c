@@ -0,0 +1,168 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "qcloud_iot_import.h"
+#include "qcloud_iot_export_error.h"
+#include "qcloud_iot_export_log.h"
+#include "utils_timer_wheel.h"
+#include "test_util.h"
+
+/* the wheel is linked without the timer HAL, time is driven by the test */
+
+static uint32_t sg_now_ms;
+
+uint32_t HAL_GetTimeMs(void)
+{
+    return sg_now_ms;
+}
+
+void IOT_Log_Gen(const char *file, const char *func, const int line, const int level, const char *fmt, ...)
+{
+}
+
+#define ENTRY_COUNT     500
+#define RANDOM_STEPS    200000
+
+typedef struct {
+    TimerWheelEntry entry;
+    uint32_t        deadline;
+    bool            live;
+} TestTimer;
+
+static TestTimer sg_timers[ENTRY_COUNT];
+
+static int _drain(TimerWheel *wheel, TimerWheelList *expired, int *fired)
+{
+    TimerWheelEntry *entry;
+
+    while ((entry = timer_wheel_pop_expired(wheel, expired)) != NULL) {
+        TestTimer *timer = TIMER_WHEEL_ENTRY(entry, TestTimer, entry);
+        TEST_ASSERT(timer->live);
+        /* never early, never later than one tick after the time it was due */
+        TEST_ASSERT((int32_t)(sg_now_ms - timer->deadline) >= 0);
+        timer->live = false;
+        (*fired)++;
+    }
+
+    return 0;
+}
+
+/* random add/del/advance across the 32-bit wrap of HAL_GetTimeMs */
+static int test_random_schedule(void)
+{
+    TimerWheel wheel;
+    TimerWheelList expired;
+    int step, i, fired = 0, live = 0;
+
+    sg_now_ms = 0xFFFFFFFFu - 500000;
+    srand(1);
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, timer_wheel_init(&wheel));
+    timer_wheel_list_init(&expired);
+    for (i = 0; i < ENTRY_COUNT; i++) {
+        timer_wheel_entry_init(&sg_timers[i].entry);
+        sg_timers[i].live = false;
+    }
+
+    for (step = 0; step < RANDOM_STEPS; step++) {
+        int r = rand() % 100;
+        TestTimer *timer = &sg_timers[rand() % ENTRY_COUNT];
+
+        if (r < 10 && !timer->live) {
+            uint32_t timeout = (rand() % 4 == 0) ? rand() % 3000000 : rand() % 20000;
+            timer_wheel_add(&wheel, &timer->entry, timeout, &expired);
+            timer->deadline = sg_now_ms + timeout;
+            timer->live = true;
+        } else if (r < 13 && timer->live) {
+            timer_wheel_del(&wheel, &timer->entry);
+            timer->live = false;
+        } else {
+            /* mostly small steps, sometimes a long gap */
+            sg_now_ms += rand() % (r < 99 ? 50 : 200000);
+            if (_drain(&wheel, &expired, &fired)) {
+                return 1;
+            }
+        }
+    }
+
+    for (i = 0; i < ENTRY_COUNT; i++) {
+        live += sg_timers[i].live ? 1 : 0;
+    }
+    sg_now_ms += 3000100;
+    fired = 0;
+    if (_drain(&wheel, &expired, &fired)) {
+        return 1;
+    }
+    TEST_ASSERT_EQ(live, fired);
+    TEST_ASSERT_EQ(0, wheel.count);
+
+    timer_wheel_deinit(&wheel);
+    return 0;
+}
+
+/* a gap of many ticks is caught up at once instead of tick by tick */
+static int test_long_gap(void)
+{
+    TimerWheel wheel;
+    TimerWheelList expired;
+    TestTimer *near = &sg_timers[0], *far = &sg_timers[1];
+    uint64_t t0, cost_ns;
+    int fired = 0;
+
+    sg_now_ms = 1000;
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, timer_wheel_init(&wheel));
+    timer_wheel_list_init(&expired);
+    timer_wheel_entry_init(&near->entry);
+    timer_wheel_entry_init(&far->entry);
+
+    /* 30 minutes and 45 hours */
+    timer_wheel_add(&wheel, &near->entry, 30 * 60 * 1000, &expired);
+    near->deadline = sg_now_ms + 30 * 60 * 1000;
+    near->live = true;
+    timer_wheel_add(&wheel, &far->entry, 45 * 3600 * 1000, &expired);
+    far->deadline = sg_now_ms + 45 * 3600 * 1000;
+    far->live = true;
+
+    /* 40 hours without polling the wheel, about 14M ticks */
+    sg_now_ms += 40 * 3600 * 1000;
+    t0 = test_now_ns();
+    TEST_ASSERT(timer_wheel_pop_expired(&wheel, &expired) == &near->entry);
+    cost_ns = test_now_ns() - t0;
+    near->live = false;
+    printf("  catch-up of 40 hours took %.1f us\n", cost_ns / 1000.0);
+    TEST_ASSERT(cost_ns < 5 * 1000 * 1000);
+
+    TEST_ASSERT(timer_wheel_pop_expired(&wheel, &expired) == NULL);
+    sg_now_ms = far->deadline - 20;
+    TEST_ASSERT(timer_wheel_pop_expired(&wheel, &expired) == NULL);
+    sg_now_ms = far->deadline + TIMER_WHEEL_TICK_MS;
+    if (_drain(&wheel, &expired, &fired)) {
+        return 1;
+    }
+    TEST_ASSERT_EQ(1, fired);
+
+    timer_wheel_deinit(&wheel);
+    return 0;
+}
+
+int main(void)
+{
+    TEST_RUN(test_random_schedule);
+    TEST_RUN(test_long_gap);
+    return 0;
+}
@@ -0,0 +1,68 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef QCLOUD_IOT_TEST_UTIL_H_
+#define QCLOUD_IOT_TEST_UTIL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+/* host tests are plain executables, a non-zero exit status fails the ctest case */
+
+#define TEST_ASSERT(cond)                                                                 \
+    do {                                                                                  \
+        if (!(cond)) {                                                                    \
+            printf("%s:%d: assertion failed: %s\n", __FILE__, __LINE__, #cond);           \
+            return 1;                                                                     \
+        }                                                                                 \
+    } while (0)
+
+#define TEST_ASSERT_EQ(expected, actual)                                                  \
+    do {                                                                                  \
+        long long _e = (long long)(expected), _a = (long long)(actual);                   \
+        if (_e != _a) {                                                                   \
+            printf("%s:%d: %s == %s failed: expected %lld, got %lld\n", __FILE__, __LINE__, \
+                   #expected, #actual, _e, _a);                                           \
+            return 1;                                                                     \
+        }                                                                                 \
+    } while (0)
+
+#define TEST_RUN(test)                                                                    \
+    do {                                                                                  \
+        printf("[ RUN  ] %s\n", #test);                                                   \
+        if (test()) {                                                                     \
+            printf("[ FAIL ] %s\n", #test);                                               \
+            return 1;                                                                     \
+        }                                                                                 \
+        printf("[  OK  ] %s\n", #test);                                                   \
+    } while (0)
+
+static inline uint64_t test_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // QCLOUD_IOT_TEST_UTIL_H_
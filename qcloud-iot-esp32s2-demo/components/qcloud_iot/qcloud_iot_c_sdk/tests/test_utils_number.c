@@ -0,0 +1,275 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "utils_number.h"
+#include "test_util.h"
+
+#define ROUND_TRIP_COUNT    300000
+#define DECIMAL_COUNT       300000
+
+static uint64_t sg_seed = 88172645463325252ULL;
+
+static uint64_t _rand64(void)
+{
+    sg_seed ^= sg_seed << 13;
+    sg_seed ^= sg_seed >> 7;
+    sg_seed ^= sg_seed << 17;
+    return sg_seed;
+}
+
+static int _parse(const char *str, double *value)
+{
+    return utils_strn_to_double(str, strlen(str), value);
+}
+
+/* number of significant digits of a formatted number, leading and trailing zeros excluded */
+static int _significant_digits(const char *str)
+{
+    int first = -1, last = -1, i;
+
+    for (i = 0; str[i] != '\0' && str[i] != 'e'; i++) {
+        if (str[i] >= '1' && str[i] <= '9') {
+            if (first < 0) {
+                first = i;
+            }
+            last = i;
+        }
+    }
+    if (first < 0) {
+        return 0;
+    }
+
+    /* digits in between, the decimal point is not one */
+    return last - first + 1 - (memchr(str + first, '.', last - first) != NULL);
+}
+
+/* digits of the shortest "%.*e" which strtod parses back to d, i.e. "%.17g" reduced as far as it round-trips */
+static int _shortest_digits(double d)
+{
+    char buf[40];
+    int precision;
+
+    for (precision = 1; precision <= 17; precision++) {
+        snprintf(buf, sizeof(buf), "%.*e", precision - 1, d);
+        if (strtod(buf, NULL) == d) {
+            break;
+        }
+    }
+
+    return _significant_digits(buf);
+}
+
+static int _shortest_float_digits(float f)
+{
+    char buf[40];
+    int precision;
+
+    for (precision = 1; precision <= 9; precision++) {
+        snprintf(buf, sizeof(buf), "%.*e", precision - 1, (double)f);
+        if (strtof(buf, NULL) == f) {
+            break;
+        }
+    }
+
+    return _significant_digits(buf);
+}
+
+/*
+ * format is the shortest repr which is parsed back to the same bits, by both strtod and the SDK. When there
+ * are several of the shortest, any of them is accepted.
+ */
+static int test_double_round_trip(void)
+{
+    char buf[UTILS_DOUBLE_STR_LEN];
+    double d, parsed;
+    uint64_t bits;
+    int i, n, shortest;
+
+    for (i = 0; i < ROUND_TRIP_COUNT; i++) {
+        bits = _rand64();
+        memcpy(&d, &bits, sizeof(d));
+        if (i % 3 == 0) {
+            d = (double)(int64_t)(_rand64() % 2000000) / 1000.0;
+        }
+        if (isnan(d) || isinf(d)) {
+            continue;
+        }
+
+        n = utils_double_to_str(d, buf);
+        TEST_ASSERT_EQ(strlen(buf), n);
+        TEST_ASSERT_EQ(n, utils_strn_to_double(buf, n, &parsed));
+        TEST_ASSERT(!memcmp(&parsed, &d, sizeof(d)));
+        TEST_ASSERT(strtod(buf, NULL) == d);
+        shortest = _shortest_digits(d);
+        if (_significant_digits(buf) != shortest) {
+            printf("  %s is not the shortest of %.17g\n", buf, d);
+        }
+        TEST_ASSERT_EQ(shortest, _significant_digits(buf));
+    }
+
+    return 0;
+}
+
+/* float has its own shortest repr, 0.1f is "0.1" rather than the digits of (double)0.1f */
+static int test_float_round_trip(void)
+{
+    static const struct {
+        float       value;
+        const char *str;
+    } cases[] = {
+        {0.1f, "0.1"}, {-1.5f, "-1.5"}, {3.4028235e38f, "3.4028235e+38"}, {1e-45f, "1e-45"},
+        {16777216.0f, "16777216"}, {1e21f, "1e+21"}, {0.0f, "0"}, {1e-6f, "0.000001"}, {1e-7f, "1e-7"},
+    };
+    char buf[UTILS_DOUBLE_STR_LEN];
+    double parsed;
+    uint32_t bits;
+    float f;
+    size_t k;
+    int i, n, shortest;
+
+    for (k = 0; k < sizeof(cases) / sizeof(cases[0]); k++) {
+        n = utils_float_to_str(cases[k].value, buf);
+        if (strcmp(buf, cases[k].str)) {
+            printf("  %.9g formatted as %s, expected %s\n", cases[k].value, buf, cases[k].str);
+        }
+        TEST_ASSERT(!strcmp(buf, cases[k].str));
+        TEST_ASSERT_EQ(strlen(buf), n);
+    }
+    TEST_ASSERT_EQ(4, utils_float_to_str(NAN, buf));
+    TEST_ASSERT(!strcmp(buf, "null"));
+
+    for (i = 0; i < ROUND_TRIP_COUNT; i++) {
+        bits = (uint32_t)_rand64();
+        memcpy(&f, &bits, sizeof(f));
+        if (i % 3 == 0) {
+            f = (float)(int32_t)(_rand64() % 2000000) / 1000.0f;
+        }
+        if (isnan(f) || isinf(f)) {
+            continue;
+        }
+
+        n = utils_float_to_str(f, buf);
+        TEST_ASSERT_EQ(strlen(buf), n);
+        TEST_ASSERT_EQ(n, utils_strn_to_double(buf, n, &parsed));
+        TEST_ASSERT((float)parsed == f);
+        TEST_ASSERT(strtof(buf, NULL) == f);
+        shortest = _shortest_float_digits(f);
+        if (_significant_digits(buf) != shortest) {
+            printf("  %s is not the shortest of %.9g\n", buf, f);
+        }
+        TEST_ASSERT_EQ(shortest, _significant_digits(buf));
+    }
+
+    return 0;
+}
+
+/* random decimal strings of the JSON grammar are rounded exactly as strtod does */
+static int test_decimal_vs_strtod(void)
+{
+    char str[96];
+    char *end;
+    double parsed, expected;
+    int i, j, k, len;
+
+    for (i = 0; i < DECIMAL_COUNT; i++) {
+        j = 0;
+        if (_rand64() % 2) {
+            str[j++] = '-';
+        }
+        len = 1 + _rand64() % 30;
+        str[j++] = (len == 1) ? '0' + _rand64() % 10 : '1' + _rand64() % 9;
+        for (k = 1; k < len; k++) {
+            str[j++] = '0' + _rand64() % 10;
+        }
+        if (_rand64() % 2) {
+            str[j++] = '.';
+            len = 1 + _rand64() % 25;
+            for (k = 0; k < len; k++) {
+                str[j++] = '0' + _rand64() % 10;
+            }
+        }
+        if (_rand64() % 2) {
+            j += sprintf(str + j, "e%d", (int)(_rand64() % 700) - 350);
+        }
+        str[j] = '\0';
+
+        expected = strtod(str, &end);
+        TEST_ASSERT_EQ(end - str, _parse(str, &parsed));
+        TEST_ASSERT(!memcmp(&parsed, &expected, sizeof(parsed)));
+    }
+
+    return 0;
+}
+
+/* the number of chars consumed follows RFC 8259, callers reject a span not consumed entirely */
+static int test_grammar(void)
+{
+    static const struct {
+        const char *str;
+        int         consumed;
+    } cases[] = {
+        {"0", 1}, {"-0", 2}, {"0.5", 3}, {"-1.25e-3", 8}, {"1E+2", 4}, {"1e22", 4},
+        /* a point or exponent without digits is not part of the number */
+        {"1.", 1}, {"1.e5", 1}, {"1e", 1}, {"1e+", 1}, {"2e-", 1},
+        /* int part is required and has no leading zeros */
+        {"-.5", 0}, {".5", 0}, {".", 0}, {"-", 0}, {"+1", 0}, {"01", 1}, {"-00.1", 2}, {" 1", 0},
+    };
+    double value;
+    size_t i;
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        int consumed = _parse(cases[i].str, &value);
+        if (consumed != cases[i].consumed) {
+            printf("  \"%s\": consumed %d, expected %d\n", cases[i].str, consumed, cases[i].consumed);
+        }
+        TEST_ASSERT_EQ(cases[i].consumed, consumed);
+    }
+
+    TEST_ASSERT_EQ(3, _parse("0.5", &value));
+    TEST_ASSERT(value == 0.5);
+    TEST_ASSERT_EQ(2, _parse("-0", &value));
+    TEST_ASSERT(value == 0.0 && signbit(value));
+    return 0;
+}
+
+static int test_integers(void)
+{
+    int32_t i32;
+    uint32_t u32;
+
+    TEST_ASSERT_EQ(11, utils_strn_to_int32("-2147483648", 11, &i32));
+    TEST_ASSERT_EQ(INT32_MIN, i32);
+    TEST_ASSERT_EQ(0, utils_strn_to_int32("2147483648", 10, &i32));
+    TEST_ASSERT_EQ(10, utils_strn_to_uint32("4294967295,", 11, &u32));
+    TEST_ASSERT_EQ(UINT32_MAX, u32);
+    TEST_ASSERT_EQ(0, utils_strn_to_uint32("4294967296", 10, &u32));
+    TEST_ASSERT_EQ(0, utils_strn_to_uint32("-1", 2, &u32));
+    return 0;
+}
+
+int main(void)
+{
+    TEST_RUN(test_double_round_trip);
+    TEST_RUN(test_float_round_trip);
+    TEST_RUN(test_decimal_vs_strtod);
+    TEST_RUN(test_grammar);
+    TEST_RUN(test_integers);
+    return 0;
+}
@@ -0,0 +1,226 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "qcloud_iot_export.h"
+#include "qcloud_iot_import.h"
+#include "mqtt_client.h"
+#include "test_util.h"
+
+/*
+ * Vectored write of a packet whose header and payload are separate segments, when the network takes
+ * only part of it each time: the rest must go out from the right offset, a segment left half sent
+ * included, and the bytes on the wire must be the segments back to back.
+ */
+
+/* the HAL takes fd with this offset, see HAL_TCP_linux.c */
+#define LINUX_SOCKET_FD_SHIFT   3
+
+#define CAPTURE_SIZE            (64 * 1024)
+
+static unsigned char sg_captured[CAPTURE_SIZE];
+static size_t        sg_captured_len;
+static size_t        sg_max_write;
+static int           sg_write_calls;
+static int           sg_zero_every;
+
+static size_t _take(const unsigned char *data, size_t len, size_t budget)
+{
+    size_t n = len < budget ? len : budget;
+
+    memcpy(sg_captured + sg_captured_len, data, n);
+    sg_captured_len += n;
+    return n;
+}
+
+/* accept up to sg_max_write bytes, and nothing at all every sg_zero_every calls */
+static int _fake_write_vec(Network *pNetwork, const NetIoVec *iov, int iovcnt, uint32_t timeout_ms,
+                           size_t *written_len)
+{
+    size_t budget = sg_max_write, n;
+    int i;
+
+    *written_len = 0;
+    sg_write_calls++;
+    if (sg_zero_every && 0 == sg_write_calls % sg_zero_every) {
+        return QCLOUD_RET_SUCCESS;
+    }
+
+    for (i = 0; i < iovcnt && budget > 0; i++) {
+        n = _take(iov[i].data, iov[i].len, budget);
+        budget -= n;
+        *written_len += n;
+    }
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+static int _fake_write(Network *pNetwork, unsigned char *data, size_t datalen, uint32_t timeout_ms,
+                       size_t *written_len)
+{
+    sg_write_calls++;
+    *written_len = _take(data, datalen, sg_max_write);
+    return QCLOUD_RET_SUCCESS;
+}
+
+static void _fill(unsigned char *buf, size_t len, unsigned seed)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        buf[i] = (unsigned char)(seed + i * 31 + (i >> 8));
+    }
+}
+
+static int _write_and_check(Qcloud_IoT_Client *client, size_t max_write, int zero_every)
+{
+    static unsigned char header[5], payload[20000], trailer[3];
+    NetIoVec iov[3] = {{header, sizeof(header)}, {payload, sizeof(payload)}, {trailer, sizeof(trailer)}};
+    Timer timer;
+
+    _fill(header, sizeof(header), 1);
+    _fill(payload, sizeof(payload), 2);
+    _fill(trailer, sizeof(trailer), 3);
+
+    sg_captured_len = 0;
+    sg_write_calls = 0;
+    sg_max_write = max_write;
+    sg_zero_every = zero_every;
+
+    InitTimer(&timer);
+    countdown_ms(&timer, 5000);
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, write_mqtt_packet_vec(client, iov, 3, &timer));
+
+    TEST_ASSERT_EQ(sizeof(header) + sizeof(payload) + sizeof(trailer), sg_captured_len);
+    TEST_ASSERT(!memcmp(sg_captured, header, sizeof(header)));
+    TEST_ASSERT(!memcmp(sg_captured + sizeof(header), payload, sizeof(payload)));
+    TEST_ASSERT(!memcmp(sg_captured + sizeof(header) + sizeof(payload), trailer, sizeof(trailer)));
+    return 0;
+}
+
+/* resume offsets inside and across segments of write_mqtt_packet_vec */
+static int test_packet_partial_writes(void)
+{
+    static Qcloud_IoT_Client client;
+    static const size_t sizes[] = {1, 3, 4, 5, 6, 7, 1000, 19999, 20005, 100000};
+    size_t i;
+
+    memset(&client, 0, sizeof(client));
+    client.network_stack.write_vec = _fake_write_vec;
+    client.network_stack.write = _fake_write;
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        if (_write_and_check(&client, sizes[i], 0)) {
+            printf("  write_vec taking %zu bytes a call\n", sizes[i]);
+            return 1;
+        }
+        TEST_ASSERT_EQ((20008 + sizes[i] - 1) / sizes[i], sg_write_calls);
+    }
+
+    /* a call sending nothing is not an error, it is tried again */
+    if (_write_and_check(&client, 777, 4)) {
+        return 1;
+    }
+
+    /* network without vectored write, segment by segment */
+    client.network_stack.write_vec = NULL;
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        if (_write_and_check(&client, sizes[i], 0)) {
+            printf("  write taking %zu bytes a call\n", sizes[i]);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+typedef struct {
+    int             fd;
+    unsigned char  *buf;
+    size_t          len;
+} Reader;
+
+static void *_reader(void *arg)
+{
+    Reader *reader = (Reader *)arg;
+    ssize_t n;
+
+    while (reader->len < CAPTURE_SIZE * 8) {
+        /* small reads with pauses so the sender keeps finding the socket buffer full */
+        n = read(reader->fd, reader->buf + reader->len, 1500);
+        if (n <= 0) {
+            break;
+        }
+        reader->len += n;
+        usleep(50);
+    }
+    return NULL;
+}
+
+/* sendmsg of the Linux HAL taking part of the segments on a non-blocking socket */
+static int test_hal_tcp_writev_partial(void)
+{
+    static unsigned char header[5], payload[CAPTURE_SIZE * 8 - 12], trailer[7];
+    NetIoVec iov[3] = {{header, sizeof(header)}, {payload, sizeof(payload)}, {trailer, sizeof(trailer)}};
+    Reader reader = {0, NULL, 0};
+    pthread_t thread;
+    int fds[2], sndbuf = 4096;
+    size_t written = 0;
+
+    _fill(header, sizeof(header), 4);
+    _fill(payload, sizeof(payload), 5);
+    _fill(trailer, sizeof(trailer), 6);
+
+    TEST_ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    TEST_ASSERT_EQ(0, setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf)));
+    TEST_ASSERT_EQ(0, fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK));
+
+    reader.fd = fds[1];
+    reader.buf = (unsigned char *)malloc(CAPTURE_SIZE * 8);
+    TEST_ASSERT(reader.buf != NULL);
+    TEST_ASSERT_EQ(0, pthread_create(&thread, NULL, _reader, &reader));
+
+    TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS,
+                   HAL_TCP_Writev((uintptr_t)fds[0] + LINUX_SOCKET_FD_SHIFT, iov, 3, 10000, &written));
+    TEST_ASSERT_EQ(CAPTURE_SIZE * 8, written);
+
+    pthread_join(thread, NULL);
+    TEST_ASSERT_EQ(CAPTURE_SIZE * 8, reader.len);
+    TEST_ASSERT(!memcmp(reader.buf, header, sizeof(header)));
+    TEST_ASSERT(!memcmp(reader.buf + sizeof(header), payload, sizeof(payload)));
+    TEST_ASSERT(!memcmp(reader.buf + sizeof(header) + sizeof(payload), trailer, sizeof(trailer)));
+
+    free(reader.buf);
+    close(fds[0]);
+    close(fds[1]);
+    return 0;
+}
+
+int main(void)
+{
+    IOT_Log_Set_Level(eLOG_WARN);
+    alarm(60);
+
+    TEST_RUN(test_packet_partial_writes);
+    TEST_RUN(test_hal_tcp_writev_partial);
+    return 0;
+}
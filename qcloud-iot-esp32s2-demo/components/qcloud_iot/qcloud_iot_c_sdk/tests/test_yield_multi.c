@@ -0,0 +1,229 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "qcloud_iot_export.h"
+#include "qcloud_iot_import.h"
+#include "test_broker.h"
+#include "test_util.h"
+
+/*
+ * IOT_MQTT_YieldMulti serving more clients than fit a fixed array, through a link drop where the
+ * reconnected sockets get the fds of the closed ones back, and with the clients reordered between calls.
+ * Every client must get the message it published to its own topic after each of these.
+ *
+ * The broker runs in a child process, so the fds of this process are the client sockets alone.
+ */
+
+#define TEST_PRODUCT_ID     "TESTPRD001"
+#define TEST_DEVICE_SECRET  "dGVzdC1kZXZpY2Utc2VjcmV0"
+#define CLIENT_COUNT        20
+
+static int   sg_broker_ctl = -1;
+static void *sg_clients[CLIENT_COUNT];
+static int   sg_received[CLIENT_COUNT];
+static char  sg_topics[CLIENT_COUNT][128];
+
+/* broker in a child process, a 'd' on the control pipe drops all clients, closing it stops the broker */
+static pid_t _start_broker_process(void)
+{
+    int ready[2], ctl[2];
+    char c;
+    pid_t pid;
+
+    if (pipe(ready) || pipe(ctl)) {
+        return -1;
+    }
+    if ((pid = fork()) == 0) {
+        TestBrokerParams params = {MQTT_SERVER_PORT_NOTLS, NULL, NULL, NULL, 0};
+        TestBroker *broker;
+
+        close(ready[0]);
+        close(ctl[1]);
+        broker = test_broker_start(&params);
+        c = broker ? 1 : 0;
+        if (write(ready[1], &c, 1) != 1 || !broker) {
+            _exit(1);
+        }
+        while (read(ctl[0], &c, 1) > 0) {
+            if (c == 'd') {
+                test_broker_drop_clients(broker);
+            }
+        }
+        test_broker_stop(broker);
+        _exit(0);
+    }
+
+    close(ready[1]);
+    close(ctl[0]);
+    if (pid < 0 || read(ready[0], &c, 1) != 1 || c != 1) {
+        close(ready[0]);
+        close(ctl[1]);
+        return -1;
+    }
+    close(ready[0]);
+    sg_broker_ctl = ctl[1];
+    return pid;
+}
+
+static void _on_message(void *pClient, MQTTMessage *message, void *pUserData)
+{
+    (*(int *)pUserData)++;
+}
+
+static int _received_by_all(int expected)
+{
+    int i;
+
+    for (i = 0; i < CLIENT_COUNT; i++) {
+        if (sg_received[i] < expected) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int _connected_count(void)
+{
+    int i, n = 0;
+
+    for (i = 0; i < CLIENT_COUNT; i++) {
+        n += IOT_MQTT_IsConnected(sg_clients[i]);
+    }
+    return n;
+}
+
+/* every client publishes to its own topic, then all are served until each got its message back */
+static int _publish_round(void *yield, void **order, int expected)
+{
+    PublishParams pub_params = DEFAULT_PUB_PARAMS;
+    uint64_t deadline = test_now_ns() + 5000000000ull;
+    int i;
+
+    pub_params.qos = QOS0;
+    pub_params.payload = "ping";
+    pub_params.payload_len = 4;
+    for (i = 0; i < CLIENT_COUNT; i++) {
+        TEST_ASSERT(IOT_MQTT_Publish(sg_clients[i], sg_topics[i], &pub_params) >= 0);
+    }
+    while (!_received_by_all(expected) && test_now_ns() < deadline) {
+        TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, IOT_MQTT_YieldMulti(yield, order, CLIENT_COUNT, 50));
+    }
+    for (i = 0; i < CLIENT_COUNT; i++) {
+        TEST_ASSERT_EQ(expected, sg_received[i]);
+    }
+    return 0;
+}
+
+/* serve the clients for a while, for SUBACKs */
+static int _serve(void *yield, int times)
+{
+    while (times-- > 0) {
+        TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, IOT_MQTT_YieldMulti(yield, sg_clients, CLIENT_COUNT, 20));
+    }
+    return 0;
+}
+
+static int test_yield_multi(void)
+{
+    MQTTInitParams init_params = DEFAULT_MQTTINIT_PARAMS;
+    SubscribeParams sub_params = DEFAULT_SUB_PARAMS;
+    char device_name[MAX_SIZE_OF_DEVICE_NAME + 1];
+    void *reversed[CLIENT_COUNT];
+    int fds[CLIENT_COUNT];
+    uint64_t deadline;
+    void *yield;
+    int i, j, reused = 0;
+
+    yield = IOT_MQTT_YieldMulti_Construct(CLIENT_COUNT);
+    TEST_ASSERT(yield != NULL);
+    TEST_ASSERT_EQ(QCLOUD_ERR_INVAL, IOT_MQTT_YieldMulti(yield, sg_clients, CLIENT_COUNT + 1, 0));
+
+    init_params.product_id = TEST_PRODUCT_ID;
+    init_params.device_secret = TEST_DEVICE_SECRET;
+    init_params.device_name = device_name;
+    init_params.command_timeout = 2000;
+    sub_params.qos = QOS0;
+    sub_params.on_message_handler = _on_message;
+    for (i = 0; i < CLIENT_COUNT; i++) {
+        snprintf(device_name, sizeof(device_name), "multi%02d", i);
+        snprintf(sg_topics[i], sizeof(sg_topics[i]), "%s/%s/data", TEST_PRODUCT_ID, device_name);
+        sg_clients[i] = IOT_MQTT_Construct(&init_params);
+        TEST_ASSERT(sg_clients[i] != NULL);
+
+        sub_params.user_data = &sg_received[i];
+        TEST_ASSERT(IOT_MQTT_Subscribe(sg_clients[i], sg_topics[i], &sub_params) > 0);
+    }
+    TEST_ASSERT_EQ(0, _serve(yield, 10));
+    TEST_ASSERT_EQ(0, _publish_round(yield, sg_clients, 1));
+
+    /* link down, the new sockets take the lowest fds, those of the closed ones */
+    for (i = 0; i < CLIENT_COUNT; i++) {
+        fds[i] = IOT_MQTT_GetFd(sg_clients[i]);
+    }
+    TEST_ASSERT_EQ(1, write(sg_broker_ctl, "d", 1));
+    deadline = test_now_ns() + 10000000000ull;
+    while (_connected_count() > 0 && test_now_ns() < deadline) {
+        TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, IOT_MQTT_YieldMulti(yield, sg_clients, CLIENT_COUNT, 50));
+    }
+    while (_connected_count() < CLIENT_COUNT && test_now_ns() < deadline) {
+        TEST_ASSERT_EQ(QCLOUD_RET_SUCCESS, IOT_MQTT_YieldMulti(yield, sg_clients, CLIENT_COUNT, 50));
+    }
+    TEST_ASSERT_EQ(CLIENT_COUNT, _connected_count());
+    for (i = 0; i < CLIENT_COUNT; i++) {
+        for (j = 0; j < CLIENT_COUNT; j++) {
+            reused += (IOT_MQTT_GetFd(sg_clients[i]) == fds[j]);
+        }
+    }
+    TEST_ASSERT_EQ(CLIENT_COUNT, reused);
+    TEST_ASSERT_EQ(0, _serve(yield, 10));
+    TEST_ASSERT_EQ(0, _publish_round(yield, sg_clients, 2));
+
+    /* every client at another index */
+    for (i = 0; i < CLIENT_COUNT; i++) {
+        reversed[i] = sg_clients[CLIENT_COUNT - 1 - i];
+    }
+    TEST_ASSERT_EQ(0, _publish_round(yield, reversed, 3));
+
+    IOT_MQTT_YieldMulti_Destroy(yield);
+    for (i = 0; i < CLIENT_COUNT; i++) {
+        IOT_MQTT_Destroy(&sg_clients[i]);
+    }
+    return 0;
+}
+
+int main(void)
+{
+    pid_t broker_pid;
+
+    /* the link drop logs errors for every client */
+    IOT_Log_Set_Level(eLOG_DISABLE);
+    alarm(60);
+
+    broker_pid = _start_broker_process();
+    if (broker_pid < 0) {
+        return 1;
+    }
+
+    TEST_RUN(test_yield_multi);
+
+    close(sg_broker_ctl);
+    waitpid(broker_pid, NULL, 0);
+    return 0;
+}
@@ -51,6 +51,7 @@ size_t sg_data_report_buffersize = sizeof(sg_data_report_buffer) / sizeof(sg_dat
 #define MAX_STR_NAME_LEN    (64)
 
 static sDataPoint    sg_DataTemplate[TOTAL_PROPERTY_COUNT];
+static void          *sg_property_store;     // tracks changed properties for report
 
 typedef enum {
     eCOLOR_RED = 0,
@@ -399,6 +400,12 @@ static int _register_data_template_property(void *pTemplate_client)
 {
     int i, rc;
 
+    sg_property_store = IOT_Template_PropertyStore_Create(TOTAL_PROPERTY_COUNT);
+    if (sg_property_store == NULL) {
+        Log_e("create property store failed");
+        return QCLOUD_ERR_MALLOC;
+    }
+
     for (i = 0; i < TOTAL_PROPERTY_COUNT; i++) {
         rc = IOT_Template_Register_Property(pTemplate_client, &sg_DataTemplate[i].data_property, OnControlMsgCallback);
         if (rc != QCLOUD_RET_SUCCESS) {
@@ -408,6 +415,13 @@ static int _register_data_template_property(void *pTemplate_client)
         } else {
             Log_i("data template property=%s registered.", sg_DataTemplate[i].data_property.key);
         }
+
+        // report any change at once, set deadband and min interval here for sensor data
+        rc = IOT_Template_PropertyStore_Add(sg_property_store, &sg_DataTemplate[i].data_property, 0, 0);
+        if (rc != QCLOUD_RET_SUCCESS) {
+            Log_e("add property=%s to store failed, err: %d", sg_DataTemplate[i].data_property.key, rc);
+            return rc;
+        }
     }
 
     return QCLOUD_RET_SUCCESS;
@@ -477,6 +491,7 @@ static void deal_down_stream_user_logic(void *client, ProductDataDefine *light)
 
         //switch state changed set EVENT0 flag, the events will be posted by eventPostCheck
         IOT_Event_setFlag(client, FLAG_EVENT0);
+        set_propery_state(&light->power_switch, eNOCHANGE);
     }
 #endif
 
@@ -487,25 +502,9 @@ static void deal_down_stream_user_logic(void *client, ProductDataDefine *light)
 /*example for cycle report, you can delete this for your needs*/
 static void cycle_report(Timer *reportTimer)
 {
-    int i;
-
     if (expired(reportTimer)) {
-        for (i = 0; i < TOTAL_PROPERTY_COUNT; i++) {
-            DeviceProperty *pReportData = &(sg_DataTemplate[i].data_property);
-            /* simulate brightness changes */
-            // if (0 == strcmp(pReportData->key, "brightness")) {
-            //     int *brightness = (int *)pReportData->data;
-            //     *brightness += 5;
-            //     if (*brightness > 100)
-            //         *brightness = 0;
-
-            //     set_propery_state(pReportData->data, eCHANGED);
-            // } else {
-                set_propery_state(&(sg_DataTemplate[i].data_property.data), eCHANGED);
-            // }
-
-            countdown_ms(reportTimer, 10000);
-        }
+        IOT_Template_PropertyStore_SetAllChanged(sg_property_store);
+        countdown_ms(reportTimer, 10000);
     }
 }
 
@@ -520,18 +519,11 @@ static void _refresh_local_property(void)
 /* demo for up-stream code */
 static int deal_up_stream_user_logic(DeviceProperty *pReportDataList[], int *pCount)
 {
-    int i, j;
-
     //refresh local property
     _refresh_local_property();
 
-    for (i = 0, j = 0; i < TOTAL_PROPERTY_COUNT; i++) {
-        if (eCHANGED == sg_DataTemplate[i].state) {
-            pReportDataList[j++] = &(sg_DataTemplate[i].data_property);
-            sg_DataTemplate[i].state = eNOCHANGE;
-        }
-    }
-    *pCount = j;
+    //only the properties changed since last report
+    *pCount = IOT_Template_PropertyStore_Collect(sg_property_store, pReportDataList, TOTAL_PROPERTY_COUNT);
 
     return (*pCount > 0) ? QCLOUD_RET_SUCCESS : QCLOUD_ERR_FAILURE;
 }
@@ -713,7 +705,7 @@ int qcloud_iot_explorer_demo(eDemoType eType)
                 rc = IOT_Template_Report(client, sg_data_report_buffer, sg_data_report_buffersize,
                                          OnReportReplyCallback, NULL, QCLOUD_IOT_MQTT_COMMAND_TIMEOUT);
                 if (rc == QCLOUD_RET_SUCCESS) {
-
+                    IOT_Template_PropertyStore_Reported(sg_property_store);
                     Log_i("data template report success");
                 } else {
                     Log_e("data template report failed, err: %d", rc);
@@ -742,6 +734,8 @@ exit:
 #endif
 
     rc = IOT_Template_Destroy(client);
+    IOT_Template_PropertyStore_Destroy(sg_property_store);
+    sg_property_store = NULL;
 
     return rc;
 }
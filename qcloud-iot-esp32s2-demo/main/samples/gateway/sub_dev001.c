@@ -42,6 +42,7 @@ size_t sg_data_report_buffersize = sizeof(sg_data_report_buffer) / sizeof(sg_dat
 #define MAX_STR_NAME_LEN    (64)
 
 static sDataPoint    sg_DataTemplate[TOTAL_PROPERTY_COUNT];
+static void          *sg_property_store;     // tracks changed properties for report
 
 typedef enum {
     eCOLOR_RED = 0,
@@ -366,6 +367,12 @@ static int _register_data_template_property(void *pTemplate_client)
 {
     int i, rc;
 
+    sg_property_store = IOT_Template_PropertyStore_Create(TOTAL_PROPERTY_COUNT);
+    if (sg_property_store == NULL) {
+        Log_e("create property store failed");
+        return QCLOUD_ERR_MALLOC;
+    }
+
     for (i = 0; i < TOTAL_PROPERTY_COUNT; i++) {
         rc = IOT_Template_Register_Property(pTemplate_client, &sg_DataTemplate[i].data_property, OnControlMsgCallback);
         if (rc != QCLOUD_RET_SUCCESS) {
@@ -375,6 +382,13 @@ static int _register_data_template_property(void *pTemplate_client)
         } else {
             Log_i("data template property=%s registered.", sg_DataTemplate[i].data_property.key);
         }
+
+        // report any change at once, set deadband and min interval here for sensor data
+        rc = IOT_Template_PropertyStore_Add(sg_property_store, &sg_DataTemplate[i].data_property, 0, 0);
+        if (rc != QCLOUD_RET_SUCCESS) {
+            Log_e("add property=%s to store failed, err: %d", sg_DataTemplate[i].data_property.key, rc);
+            return rc;
+        }
     }
 
     return QCLOUD_RET_SUCCESS;
@@ -478,19 +492,16 @@ static void deal_down_stream_user_logic(void *client, ProductDataDefine *light)
 #else
         Log_d("light switch state changed");
 #endif
+        set_propery_state(&light->m_light_switch, eNOCHANGE);
     }
 }
 
 /*example for cycle report, you can delete this for your needs 周期性汇报*/
 static void cycle_report(Timer *reportTimer)
 {
-    int i;
-
     if (expired(reportTimer)) {
-        for (i = 0; i < TOTAL_PROPERTY_COUNT; i++) {
-            set_propery_state(sg_DataTemplate[i].data_property.data, eCHANGED);
-            countdown_ms(reportTimer, 5000);
-        }
+        IOT_Template_PropertyStore_SetAllChanged(sg_property_store);
+        countdown_ms(reportTimer, 5000);
     }
 }
 
@@ -501,28 +512,14 @@ static void _refresh_local_property(void)
     cycle_report(&sg_reportTimer);
 }
 
-static int find_wait_report_property(DeviceProperty *pReportDataList[])
-{
-    int i, j;
-
-    for (i = 0, j = 0; i < TOTAL_PROPERTY_COUNT; i++) {
-        if (eCHANGED == sg_DataTemplate[i].state) {
-            pReportDataList[j++] = &(sg_DataTemplate[i].data_property);
-            sg_DataTemplate[i].state = eNOCHANGE;
-        }
-    }
-
-    return j;
-}
-
 /* demo for up-stream code */
 static int deal_up_stream_user_logic(DeviceProperty *pReportDataList[], int *pCount)
 {
     //refresh local property
     _refresh_local_property();
 
-    /*find propery need report*/
-    *pCount = find_wait_report_property(pReportDataList);
+    /*find propery changed since last report*/
+    *pCount = IOT_Template_PropertyStore_Collect(sg_property_store, pReportDataList, TOTAL_PROPERTY_COUNT);
 
     return (*pCount > 0) ? QCLOUD_RET_SUCCESS : QCLOUD_ERR_FAILURE;
 }
@@ -662,7 +659,7 @@ void* sub_dev1_thread(void *ptr, char *product_id, char *device_name)
                 rc = IOT_Template_Report(client, sg_data_report_buffer, sg_data_report_buffersize,
                                          OnReportReplyCallback, NULL, QCLOUD_IOT_MQTT_COMMAND_TIMEOUT);
                 if (rc == QCLOUD_RET_SUCCESS) {
-
+                    IOT_Template_PropertyStore_Reported(sg_property_store);
                     Log_i("data template reporte success");
                 } else {
                     Log_e("data template reporte failed, err: %d", rc);
@@ -681,5 +678,7 @@ void* sub_dev1_thread(void *ptr, char *product_id, char *device_name)
     }
 
     rc = IOT_Template_Destroy_Except_MQTT(client);
+    IOT_Template_PropertyStore_Destroy(sg_property_store);
+    sg_property_store = NULL;
     return NULL;
 }
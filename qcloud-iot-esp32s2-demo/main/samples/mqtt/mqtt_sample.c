@@ -107,21 +107,10 @@ static void on_message_callback(void *pClient, MQTTMessage *message, void *userD
         return;
     }
 
-    Log_d("recv msg topic: %s", message->ptopic);
+    Log_d("recv msg topic: %.*s", (int) message->topic_len, message->ptopic);
 
-    uint32_t msg_topic_len = message->payload_len + 4;
-    char *buf = (char *)HAL_Malloc(msg_topic_len);
-    if (buf == NULL) {
-        Log_e("malloc %u bytes failed, topic: %s", msg_topic_len, message->ptopic);
-        return;
-    }
-
-    memset(buf, 0, msg_topic_len);
-    memcpy(buf, message->payload, message->payload_len);
-
-    Log_d("msg payload: %s", buf);
-
-    HAL_Free(buf);
+    // payload is null terminated and only valid inside the callback
+    Log_d("msg payload: %s", (char *) message->payload);
 }
 
 
@@ -184,30 +173,6 @@ static int _register_subscribe_topics(void *client, char *key_word, int qos)
     return IOT_MQTT_Subscribe(client, topic_name, &sub_params);
 }
 
-#ifdef MULTITHREAD_ENABLED
-#define YEILD_THREAD_STACK_SIZE     2048
-#define THREAD_SLEEP_INTERVAL_MS    1
-static bool sg_yield_thread_running = true;
-
-static void *mqtt_yield_thread(void *ptr)
-{
-    int rc = QCLOUD_RET_SUCCESS;
-    void *pClient = ptr;
-    Log_d("template yield thread start ...");
-    while (sg_yield_thread_running) {
-        rc = IOT_MQTT_Yield(pClient, 200);
-        if (rc == QCLOUD_ERR_MQTT_ATTEMPTING_RECONNECT) {
-            HAL_SleepMs(THREAD_SLEEP_INTERVAL_MS);
-            continue;
-        } else if (rc != QCLOUD_RET_SUCCESS && rc != QCLOUD_RET_MQTT_RECONNECTED) {
-            Log_e("Something goes error: %d", rc);
-        }
-        HAL_SleepMs(THREAD_SLEEP_INTERVAL_MS);
-    }
-    return NULL;
-}
-#endif
-
 int qcloud_iot_hub_demo(void)
 {
     int rc;
@@ -215,6 +180,8 @@ int qcloud_iot_hub_demo(void)
     int pub_interval = 2;
     bool loop = true;
     int pub_qos = QOS0, sub_qos = QOS0;
+    MQTTStats stats;
+    char stats_json[1024];
 
     // init connection parameters
     MQTTInitParams init_params = DEFAULT_MQTTINIT_PARAMS;
@@ -257,10 +224,16 @@ int qcloud_iot_hub_demo(void)
     }
 
 #ifdef MULTITHREAD_ENABLED
-    TaskHandle_t yield_thread_t = NULL;
-    yield_thread_t = HAL_ThreadCreate(YEILD_THREAD_STACK_SIZE, 3, "mqtt_yield_thread", mqtt_yield_thread, client);
-    if (yield_thread_t == NULL) {
-        Log_e("create yield thread fail");
+    // rx task reads and dispatches, network is written by tx task, publish below never waits for socket
+    rc = IOT_MQTT_StartRxTask(client, 3);
+    if (rc != QCLOUD_RET_SUCCESS) {
+        Log_e("create rx task fail");
+        goto exit;
+    }
+
+    rc = IOT_MQTT_StartTxTask(client, 3);
+    if (rc != QCLOUD_RET_SUCCESS) {
+        Log_e("create tx task fail");
         goto exit;
     }
 #endif
@@ -293,6 +266,11 @@ int qcloud_iot_hub_demo(void)
 
 exit:
 
+    if (QCLOUD_RET_SUCCESS == IOT_MQTT_GetStats(client, &stats) &&
+        IOT_MQTT_StatsToJson(&stats, stats_json, sizeof(stats_json)) > 0) {
+        Log_i("mqtt stats: %s", stats_json);
+    }
+
     rc = IOT_MQTT_Destroy(&client);
 
     return rc;
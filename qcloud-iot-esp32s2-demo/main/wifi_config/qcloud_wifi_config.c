@@ -79,7 +79,7 @@ static void _mqtt_event_handler(void *pclient, void *handle_context, MQTTEventMs
             break;
 
         case MQTT_EVENT_PUBLISH_RECVEIVED:
-            Log_i("unhandled msg arrived: topic=%s", mqtt_messge->ptopic);
+            Log_i("unhandled msg arrived: topic=%.*s", (int) mqtt_messge->topic_len, mqtt_messge->ptopic);
             break;
 
         case MQTT_EVENT_SUBCRIBE_SUCCESS:
@@ -131,7 +131,7 @@ static void _on_message_callback(void *pClient, MQTTMessage *message, void *user
         return;
     }
 
-    Log_i("recv msg topic: %s", message->ptopic);
+    Log_i("recv msg topic: %.*s", (int) message->topic_len, message->ptopic);
 
     uint32_t msg_topic_len = message->payload_len + 4;
     char *buf = (char *)HAL_Malloc(msg_topic_len);